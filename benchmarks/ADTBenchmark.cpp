@@ -0,0 +1,134 @@
+//===-- ADTBenchmark.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/DiscretePDF.h"
+#include "klee/Internal/ADT/ImmutableBTreeMap.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/TreeStream.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+/// The keys 0 to n-1 in a fixed random order.
+std::vector<unsigned> shuffledKeys(unsigned n) {
+  std::vector<unsigned> keys(n);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+  return keys;
+}
+
+template <class Map> void BM_MapInsert(benchmark::State &state) {
+  std::vector<unsigned> keys = shuffledKeys(state.range(0));
+  for (auto _ : state) {
+    Map m;
+    for (unsigned k : keys)
+      m = m.insert(std::make_pair(k, k));
+    benchmark::DoNotOptimize(m.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_MapInsert, ImmutableMap<unsigned, unsigned>)
+    ->Arg(64)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_MapInsert, ImmutableBTreeMap<unsigned, unsigned>)
+    ->Arg(64)->Arg(4096);
+
+template <class Map> void BM_MapLookup(benchmark::State &state) {
+  std::vector<unsigned> keys = shuffledKeys(state.range(0));
+  Map m;
+  for (unsigned k : keys)
+    m = m.insert(std::make_pair(k, k));
+  for (auto _ : state)
+    for (unsigned k : keys)
+      benchmark::DoNotOptimize(m.lookup(k));
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_MapLookup, ImmutableMap<unsigned, unsigned>)
+    ->Arg(64)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_MapLookup, ImmutableBTreeMap<unsigned, unsigned>)
+    ->Arg(64)->Arg(4096);
+
+/// Replaces one entry of a map shared with a copy, as a write to an object
+/// shared with a forked state does.
+template <class Map> void BM_MapReplaceShared(benchmark::State &state) {
+  std::vector<unsigned> keys = shuffledKeys(state.range(0));
+  Map m;
+  for (unsigned k : keys)
+    m = m.insert(std::make_pair(k, k));
+  unsigned i = 0;
+  for (auto _ : state) {
+    Map copy = m.replace(std::make_pair(keys[i], i));
+    benchmark::DoNotOptimize(copy.size());
+    i = (i + 1) % keys.size();
+  }
+}
+BENCHMARK_TEMPLATE(BM_MapReplaceShared, ImmutableMap<unsigned, unsigned>)
+    ->Arg(64)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_MapReplaceShared, ImmutableBTreeMap<unsigned, unsigned>)
+    ->Arg(64)->Arg(4096);
+
+void BM_DiscretePDFChoose(benchmark::State &state) {
+  DiscretePDF<unsigned> pdf;
+  for (unsigned i = 0; i < state.range(0); ++i)
+    pdf.insert(i, 1.0 / (1 + i % 16));
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> p(0, 1);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(pdf.choose(p(rng)));
+}
+BENCHMARK(BM_DiscretePDFChoose)->Arg(64)->Arg(65536);
+
+void BM_DiscretePDFUpdate(benchmark::State &state) {
+  DiscretePDF<unsigned> pdf;
+  for (unsigned i = 0; i < state.range(0); ++i)
+    pdf.insert(i, 1.0);
+  std::vector<unsigned> items = shuffledKeys(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    pdf.update(items[i], 1.0 / (1 + i % 16));
+    i = (i + 1) % items.size();
+  }
+}
+BENCHMARK(BM_DiscretePDFUpdate)->Arg(64)->Arg(65536);
+
+/// Appends records of range(0) bytes to the streams of a path and its
+/// forks, as the path and symbolic path files are written.
+void BM_TreeStreamWrite(benchmark::State &state) {
+  llvm::SmallString<128> path;
+  if (llvm::sys::fs::createTemporaryFile("klee-benchmark", "ptree", path)) {
+    state.SkipWithError("cannot create a temporary file");
+    return;
+  }
+  std::vector<char> record(state.range(0), 'x');
+  {
+    TreeStreamWriter writer(path.str().str());
+    TreeOStream stream = writer.open();
+    unsigned writes = 0;
+    for (auto _ : state) {
+      stream.write(record.data(), record.size());
+      // fork every few writes
+      if (++writes % 8 == 0)
+        stream = writer.open(stream);
+    }
+    writer.flush();
+  }
+  llvm::sys::fs::remove(path);
+  state.SetBytesProcessed(state.iterations() * record.size());
+}
+BENCHMARK(BM_TreeStreamWrite)->Arg(1)->Arg(64);
+}
@@ -0,0 +1,214 @@
+//===-- ExprBenchmark.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AssignmentGenerator.h"
+
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/BiasedRefCount.h"
+#include "klee/util/ExprHashMap.h"
+#include "klee/util/Ref.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+ArrayCache arrays;
+
+const Array *getArray() {
+  static const Array *array = arrays.CreateArray("arr", 4096);
+  return array;
+}
+
+ref<Expr> readByte(unsigned index) {
+  return ReadExpr::create(UpdateList(getArray(), 0),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+/// A chain of \a depth additions over distinct reads, built anew on each
+/// call so that two chains are equal without being the same node.
+ref<Expr> addChain(unsigned depth) {
+  ref<Expr> e = ZExtExpr::create(readByte(0), Expr::Int32);
+  for (unsigned i = 1; i < depth; ++i)
+    e = AddExpr::create(e, ZExtExpr::create(readByte(i), Expr::Int32));
+  return e;
+}
+
+void BM_ExprCreate(benchmark::State &state) {
+  ref<Expr> x = ZExtExpr::create(readByte(0), Expr::Int32);
+  ref<Expr> y = ZExtExpr::create(readByte(1), Expr::Int32);
+  ref<ConstantExpr> c = ConstantExpr::create(42, Expr::Int32);
+  for (auto _ : state) {
+    ref<Expr> e =
+        UltExpr::create(AddExpr::create(x, c), MulExpr::create(y, c));
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_ExprCreate);
+
+void BM_ExprCreateConstantFolded(benchmark::State &state) {
+  ref<ConstantExpr> a = ConstantExpr::create(7, Expr::Int64);
+  ref<ConstantExpr> b = ConstantExpr::create(35, Expr::Int64);
+  for (auto _ : state) {
+    ref<Expr> e = AddExpr::create(MulExpr::create(a, b), b);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_ExprCreateConstantFolded);
+
+void BM_ExprCompare(benchmark::State &state) {
+  ref<Expr> a = addChain(state.range(0));
+  ref<Expr> b = addChain(state.range(0));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(a->compare(*b));
+}
+BENCHMARK(BM_ExprCompare)->Arg(4)->Arg(64);
+
+void BM_ExprHashMapInsert(benchmark::State &state) {
+  std::vector<ref<Expr> > keys;
+  for (unsigned i = 0; i < state.range(0); ++i)
+    keys.push_back(readByte(i));
+  for (auto _ : state) {
+    ExprHashMap<unsigned> map;
+    for (unsigned i = 0; i < keys.size(); ++i)
+      map[keys[i]] = i;
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_ExprHashMapInsert)->Arg(64)->Arg(4096);
+
+void BM_ExprHashMapFind(benchmark::State &state) {
+  std::vector<ref<Expr> > keys;
+  ExprHashMap<unsigned> map;
+  for (unsigned i = 0; i < state.range(0); ++i) {
+    keys.push_back(readByte(i));
+    map[keys.back()] = i;
+  }
+  for (auto _ : state)
+    for (const ref<Expr> &key : keys)
+      benchmark::DoNotOptimize(map.find(key));
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_ExprHashMapFind)->Arg(64)->Arg(4096);
+
+/// Reads an index which the \a range(0) writes of the update list do not
+/// touch, which is the worst case of resolving a read.
+void BM_UpdateListRead(benchmark::State &state) {
+  UpdateList updates(getArray(), 0);
+  for (unsigned i = 0; i < state.range(0); ++i)
+    updates.extend(ConstantExpr::create(1 + i % 1024, Expr::Int32),
+                   ConstantExpr::create(i & 0xff, Expr::Int8));
+  ref<Expr> index = ConstantExpr::create(0, Expr::Int32);
+  for (auto _ : state) {
+    ref<Expr> e = ReadExpr::create(updates, index);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_UpdateListRead)->Arg(16)->Arg(1024);
+
+void BM_UpdateListReadSymbolic(benchmark::State &state) {
+  UpdateList updates(getArray(), 0);
+  for (unsigned i = 0; i < state.range(0); ++i)
+    updates.extend(ConstantExpr::create(i, Expr::Int32),
+                   ConstantExpr::create(i & 0xff, Expr::Int8));
+  ref<Expr> index = ZExtExpr::create(readByte(0), Expr::Int32);
+  for (auto _ : state) {
+    ref<Expr> e = ReadExpr::create(updates, index);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_UpdateListReadSymbolic)->Arg(16)->Arg(1024);
+
+/// \a range(0) expressions x_i + 1 == i over 16 bit words x_i of the
+/// array, with as many arrays of 64 bytes as they need.
+std::vector<AssignmentGenerator::Target> getAssignmentTargets(unsigned n) {
+  static std::vector<const Array *> words;
+  std::vector<AssignmentGenerator::Target> targets;
+  for (unsigned i = 0; i < n; ++i) {
+    if (i / 32 == words.size())
+      words.push_back(arrays.CreateArray("w" + std::to_string(i / 32), 64));
+    UpdateList updates(words[i / 32], 0);
+    unsigned index = (i % 32) * 2;
+    ref<Expr> x = ConcatExpr::create(
+        ReadExpr::create(updates, ConstantExpr::create(index + 1, Expr::Int32)),
+        ReadExpr::create(updates, ConstantExpr::create(index, Expr::Int32)));
+    targets.push_back(std::make_pair(
+        AddExpr::create(ConstantExpr::create(1, Expr::Int16), x),
+        ConstantExpr::create(i, Expr::Int16)));
+  }
+  return targets;
+}
+
+/// One expression at a time, each on an assignment of its own, as the
+/// array optimizer used to.
+void BM_AssignmentGeneratorPartial(benchmark::State &state) {
+  std::vector<AssignmentGenerator::Target> targets =
+      getAssignmentTargets(state.range(0));
+  for (auto _ : state) {
+    for (const AssignmentGenerator::Target &target : targets) {
+      Assignment *a = new Assignment();
+      ref<Expr> val = target.second;
+      benchmark::DoNotOptimize(
+          AssignmentGenerator::generatePartialAssignment(target.first, val, a));
+      delete a;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * targets.size());
+}
+BENCHMARK(BM_AssignmentGeneratorPartial)->Arg(1)->Arg(64);
+
+/// All the expressions at once, written in place in a reused assignment.
+void BM_AssignmentGeneratorBatch(benchmark::State &state) {
+  std::vector<AssignmentGenerator::Target> targets =
+      getAssignmentTargets(state.range(0));
+  Assignment a;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        AssignmentGenerator::generateAssignment(targets, a));
+  state.SetItemsProcessed(state.iterations() * targets.size());
+}
+BENCHMARK(BM_AssignmentGeneratorBatch)->Arg(1)->Arg(64);
+
+struct PlainCounted {
+  unsigned refCount = 0;
+};
+
+struct BiasedCounted {
+  BiasedRefCount refCount;
+};
+
+/// Copies and releases a reference, the pattern of passing expressions
+/// around by value, with the plain and the biased counter.
+template <class T> void BM_RefCopy(benchmark::State &state) {
+  ref<T> r(new T());
+  for (auto _ : state) {
+    ref<T> copy(r);
+    benchmark::DoNotOptimize(copy.get());
+  }
+}
+BENCHMARK_TEMPLATE(BM_RefCopy, PlainCounted);
+BENCHMARK_TEMPLATE(BM_RefCopy, BiasedCounted);
+
+/// The same with the counter shared, as it is once published to a thread.
+void BM_RefCopySharedBiased(benchmark::State &state) {
+  ref<BiasedCounted> r(new BiasedCounted());
+  r->refCount.makeShared();
+  for (auto _ : state) {
+    ref<BiasedCounted> copy(r);
+    benchmark::DoNotOptimize(copy.get());
+  }
+}
+BENCHMARK(BM_RefCopySharedBiased);
+}
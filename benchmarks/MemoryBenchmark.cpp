@@ -0,0 +1,156 @@
+//===-- MemoryBenchmark.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AddressSpace.h"
+#include "Context.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+ArrayCache arrays;
+
+void initializeContext() {
+  static bool initialized = false;
+  if (!initialized)
+    Context::initialize(true, Expr::Int64);
+  initialized = true;
+}
+
+/// The objects are not allocations of their parent, which only creates the
+/// arrays of their symbolic contents.
+MemoryObject *createObject(uint64_t address, unsigned size) {
+  static MemoryManager memory(&arrays);
+  return new MemoryObject(address, size, false, false, true, nullptr, &memory);
+}
+
+void BM_ObjectStateWriteConcrete(benchmark::State &state) {
+  initializeContext();
+  unsigned size = state.range(0);
+  ObjectState os(createObject(0x10000, size));
+  os.initializeToZero();
+  unsigned offset = 0;
+  for (auto _ : state) {
+    os.write32(offset, offset);
+    offset = (offset + 4) % size;
+  }
+}
+BENCHMARK(BM_ObjectStateWriteConcrete)->Arg(64)->Arg(65536);
+
+void BM_ObjectStateReadConcrete(benchmark::State &state) {
+  initializeContext();
+  unsigned size = state.range(0);
+  ObjectState os(createObject(0x10000, size));
+  os.initializeToZero();
+  unsigned offset = 0;
+  for (auto _ : state) {
+    ref<Expr> e = os.read(offset, Expr::Int32);
+    benchmark::DoNotOptimize(e.get());
+    offset = (offset + 4) % size;
+  }
+}
+BENCHMARK(BM_ObjectStateReadConcrete)->Arg(64)->Arg(65536);
+
+/// Writes symbolic bytes at concrete offsets, then reads them back.
+void BM_ObjectStateSymbolicByte(benchmark::State &state) {
+  initializeContext();
+  unsigned size = state.range(0);
+  ObjectState os(createObject(0x10000, size));
+  os.initializeToZero();
+  const Array *input = arrays.CreateArray("input", 1);
+  ref<Expr> value = ReadExpr::create(UpdateList(input, 0),
+                                     ConstantExpr::alloc(0, Expr::Int32));
+  unsigned offset = 0;
+  for (auto _ : state) {
+    os.write(offset, value);
+    ref<Expr> e = os.read8(offset);
+    benchmark::DoNotOptimize(e.get());
+    offset = (offset + 1) % size;
+  }
+}
+BENCHMARK(BM_ObjectStateSymbolicByte)->Arg(64)->Arg(65536);
+
+/// Reads at a symbolic offset, which goes through the update list.
+void BM_ObjectStateReadSymbolicOffset(benchmark::State &state) {
+  initializeContext();
+  unsigned size = state.range(0);
+  ObjectState os(createObject(0x10000, size));
+  os.initializeToZero();
+  const Array *index = arrays.CreateArray("index", 4);
+  ref<Expr> offset = URemExpr::create(
+      Expr::createTempRead(index, Expr::Int32),
+      ConstantExpr::create(size, Expr::Int32));
+  for (auto _ : state) {
+    ref<Expr> e = os.read(offset, Expr::Int8);
+    benchmark::DoNotOptimize(e.get());
+  }
+}
+BENCHMARK(BM_ObjectStateReadSymbolicOffset)->Arg(64)->Arg(4096);
+
+/// An address space of range(0) objects spread out like heap allocations.
+class AddressSpaceFixture {
+public:
+  AddressSpace space;
+  std::vector<uint64_t> addresses;
+
+  explicit AddressSpaceFixture(unsigned n) {
+    initializeContext();
+    for (unsigned i = 0; i < n; ++i) {
+      uint64_t address = 0x100000 + 128 * i;
+      MemoryObject *mo = createObject(address, 16 + i % 64);
+      ObjectState *os = new ObjectState(mo);
+      os->initializeToZero();
+      space.bindObject(mo, os);
+      addresses.push_back(address + i % 16);
+    }
+    std::shuffle(addresses.begin(), addresses.end(), std::mt19937(1));
+  }
+};
+
+void BM_AddressSpaceResolveOne(benchmark::State &state) {
+  AddressSpaceFixture fixture(state.range(0));
+  std::vector<ref<ConstantExpr> > addresses;
+  for (uint64_t a : fixture.addresses)
+    addresses.push_back(ConstantExpr::create(a, Expr::Int64));
+  unsigned i = 0;
+  for (auto _ : state) {
+    ObjectPair op;
+    benchmark::DoNotOptimize(fixture.space.resolveOne(addresses[i], op));
+    i = (i + 1) % addresses.size();
+  }
+}
+BENCHMARK(BM_AddressSpaceResolveOne)->Arg(16)->Arg(4096);
+
+/// Forks the address space and writes to one object of the fork, which
+/// copies its state on write.
+void BM_AddressSpaceForkWrite(benchmark::State &state) {
+  AddressSpaceFixture fixture(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    AddressSpace fork(fixture.space);
+    ObjectPair op;
+    fork.resolveOne(ConstantExpr::create(fixture.addresses[i], Expr::Int64),
+                    op);
+    ObjectState *os = fork.getWriteable(op.first, op.second);
+    os->write8(0, 1);
+    i = (i + 1) % fixture.addresses.size();
+  }
+}
+BENCHMARK(BM_AddressSpaceForkWrite)->Arg(16)->Arg(4096);
+}
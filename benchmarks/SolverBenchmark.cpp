@@ -0,0 +1,117 @@
+//===-- SolverBenchmark.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ArrayCache.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+ArrayCache arrays;
+
+/// Answers every query with the all zero assignment, without solving, so
+/// that only the time spent in the caches is measured.
+class ZeroSolverImpl : public SolverImpl {
+public:
+  unsigned queries = 0;
+
+  bool computeTruth(const Query &, bool &isValid) {
+    ++queries;
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &, ref<Expr> &result) {
+    ++queries;
+    result = ConstantExpr::create(0, Expr::Int8);
+    return true;
+  }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    ++queries;
+    values.clear();
+    for (const Array *array : objects)
+      values.push_back(std::vector<unsigned char>(array->size, 0));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+/// A path condition of range(0) constraints on distinct bytes, which the
+/// zero assignment satisfies, and a branch condition it does not decide.
+struct PathCondition {
+  const Array *array;
+  std::vector<ref<Expr> > constraints;
+
+  explicit PathCondition(unsigned n) {
+    array = arrays.CreateArray("pc" + std::to_string(n), n + 1);
+    for (unsigned i = 0; i < n; ++i)
+      constraints.push_back(
+          UltExpr::create(byte(i), ConstantExpr::create(16, Expr::Int8)));
+  }
+
+  ref<Expr> byte(unsigned i) const {
+    return ReadExpr::create(UpdateList(array, 0),
+                            ConstantExpr::create(i, Expr::Int32));
+  }
+};
+
+/// A query whose answer the counterexample cache finds in an assignment it
+/// already holds.
+void BM_CexCacheHit(benchmark::State &state) {
+  PathCondition pc(state.range(0));
+  ConstraintManager constraints(pc.constraints);
+  ZeroSolverImpl *impl = new ZeroSolverImpl();
+  std::unique_ptr<Solver> solver(createCexCachingSolver(new Solver(impl)));
+  ref<Expr> branch = EqExpr::create(pc.byte(state.range(0)),
+                                    ConstantExpr::create(1, Expr::Int8));
+  bool result;
+  solver->mayBeTrue(Query(constraints, branch), result); // fill the cache
+  unsigned misses = impl->queries;
+  for (auto _ : state) {
+    solver->mustBeTrue(Query(constraints, branch), result);
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["misses"] = impl->queries - misses;
+}
+BENCHMARK(BM_CexCacheHit)->Arg(8)->Arg(128);
+
+/// Queries under growing path conditions, each a subset of the next and
+/// cached in turn, as along one path.
+void BM_CexCacheGrowingPath(benchmark::State &state) {
+  unsigned n = state.range(0);
+  PathCondition pc(n);
+  for (auto _ : state) {
+    state.PauseTiming();
+    ZeroSolverImpl *impl = new ZeroSolverImpl();
+    std::unique_ptr<Solver> solver(createCexCachingSolver(new Solver(impl)));
+    state.ResumeTiming();
+    ConstraintManager constraints;
+    for (unsigned i = 0; i < n; ++i) {
+      bool result;
+      solver->mayBeTrue(Query(constraints, pc.constraints[i]), result);
+      constraints.addConstraint(pc.constraints[i]);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_CexCacheGrowingPath)->Arg(8)->Arg(128);
+}
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# -*- encoding: utf-8 -*-
+
+# ===-- compare.py --------------------------------------------------------===##
+#
+#                      The KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+
+"""Compare two benchmarks.json files written by klee-benchmarks.
+
+Prints the change of the CPU time of each benchmark and exits with status 1
+if any is slower than in the baseline by more than the threshold. With
+--benchmark_repetitions, the medians are compared.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        report = json.load(f)
+    times = {}
+    medians = {}
+    for b in report['benchmarks']:
+        if b.get('run_type') == 'aggregate':
+            if b.get('aggregate_name') == 'median':
+                medians[b['run_name']] = b['cpu_time']
+        elif 'error_occurred' not in b:
+            times.setdefault(b.get('run_name', b['name']), b['cpu_time'])
+    times.update(medians)
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('baseline', help='results of the baseline')
+    parser.add_argument('current', help='results to check')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='largest slowdown accepted, as a fraction of the '
+                        'baseline time (default: 0.1)')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = []
+    width = max([len(name) for name in current] + [9])
+    for name in sorted(current):
+        if name not in baseline or baseline[name] == 0:
+            print('{:<{}}  (new)'.format(name, width))
+            continue
+        change = current[name] / baseline[name] - 1
+        flag = ''
+        if change > args.threshold:
+            regressions.append(name)
+            flag = '  REGRESSION'
+        print('{:<{}}  {:+7.1%}{}'.format(name, width, change, flag))
+    for name in sorted(set(baseline) - set(current)):
+        print('{:<{}}  (missing)'.format(name, width))
+
+    if regressions:
+        print('{} benchmark(s) slower by more than {:.0%}'.format(
+            len(regressions), args.threshold), file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,323 @@
+#!/usr/bin/env python3
+# -*- encoding: utf-8 -*-
+
+# ===-- programs.py -------------------------------------------------------===##
+#
+#                      The KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+
+"""Run KLEE on a corpus of programs and compare the throughput of two runs.
+
+"run" explores each program of the corpus (programs/corpus.json by
+default) for a fixed number of instructions. The seed of the searchers and
+the addresses of the allocations are fixed too, so two runs of the same
+KLEE explore the same paths. It writes results.json with the throughput of
+each program, its peak memory and its coverage over the instructions.
+
+"compare" prints the changes between two results.json and exits with
+status 1 if any program got slower, or used more memory, by more than the
+threshold.
+
+A corpus entry names a C source, which is compiled with clang, or a
+bitcode file, with the arguments of KLEE and of the program:
+
+  {"name": "echo", "bitcode": "/path/to/echo.bc",
+   "klee-args": ["--libc=uclibc", "--posix-runtime"],
+   "args": ["--sym-args", "0", "2", "4"]}
+"""
+
+import argparse
+import json
+import os
+import shutil
+import sqlite3
+import subprocess
+import sys
+import time
+
+ScriptDir = os.path.dirname(os.path.abspath(__file__))
+
+# The metrics of a program which compare reports, with whether more is
+# better.
+Metrics = [
+    ('instructions_per_second', 'Instrs/s', True),
+    ('queries_per_second', 'Queries/s', True),
+    ('states_per_second', 'States/s', True),
+    ('peak_rss_kib', 'PeakRSS(KiB)', False),
+    ('covered_instructions', 'Covered', True),
+]
+
+
+def compileProgram(entry, corpusDir, outputDir, args):
+    if 'bitcode' in entry:
+        return os.path.join(corpusDir, entry['bitcode'])
+    bitcode = os.path.join(outputDir, entry['name'] + '.bc')
+    cmd = [args.clang, '-emit-llvm', '-c', '-g', '-O0', '-Xclang',
+           '-disable-O0-optnone', '-I', args.include]
+    cmd += entry.get('cflags', [])
+    cmd += [os.path.join(corpusDir, entry['source']), '-o', bitcode]
+    if subprocess.call(cmd) != 0:
+        return None
+    return bitcode
+
+
+def runKlee(entry, bitcode, outputDir, args):
+    """Runs KLEE once and returns its process wall time and peak RSS."""
+    if os.path.exists(outputDir):
+        shutil.rmtree(outputDir)
+    cmd = [args.klee,
+           '--output-dir=' + outputDir,
+           '--rng-seed=%d' % args.rng_seed,
+           '--allocate-determ',
+           '--max-instructions=%d' % args.max_instructions,
+           '--max-time=' + args.max_time,
+           # sample the coverage by instructions rather than time, so that
+           # the curves of two runs line up
+           '--stats-write-interval=0s',
+           '--stats-write-after-instructions=%d' %
+           max(1, args.max_instructions // args.samples)]
+    cmd += entry.get('klee-args', []) + args.klee_args
+    cmd += [bitcode] + entry.get('args', [])
+    with open(os.path.join(os.path.dirname(outputDir),
+                           os.path.basename(outputDir) + '.log'), 'w') as log:
+        start = time.monotonic()
+        process = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+        _, status, usage = os.wait4(process.pid, 0)
+        wallTime = time.monotonic() - start
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        return None
+    # ru_maxrss is in KiB on Linux
+    return wallTime, usage.ru_maxrss
+
+
+def readExploredPaths(outputDir):
+    with open(os.path.join(outputDir, 'info')) as f:
+        for line in f:
+            if line.startswith('KLEE: done: explored paths = '):
+                return int(line.split('=')[1])
+    return 0
+
+
+def readStats(outputDir):
+    connection = sqlite3.connect(os.path.join(outputDir, 'run.stats'))
+    rows = connection.execute(
+        'SELECT Instructions, WallTime, CoveredInstructions, '
+        'UncoveredInstructions, NumQueries FROM stats ORDER BY rowid').fetchall()
+    connection.close()
+    return rows
+
+
+def measure(entry, bitcode, runDir, args):
+    """Returns the results of the median run of a program, by wall time."""
+    runs = []
+    for i in range(args.repetitions):
+        outputDir = os.path.join(runDir, '%s.klee-out' % entry['name'])
+        if args.repetitions > 1:
+            outputDir = os.path.join(runDir,
+                                     '%s-%d.klee-out' % (entry['name'], i))
+        measured = runKlee(entry, bitcode, outputDir, args)
+        if measured is None:
+            return None
+        wallTime, peakRSS = measured
+        rows = readStats(outputDir)
+        if not rows:
+            return None
+        instructions, _, covered, uncovered, queries = rows[-1]
+        paths = readExploredPaths(outputDir)
+        runs.append({
+            'wall_time': wallTime,
+            'instructions': instructions,
+            'queries': queries,
+            'explored_paths': paths,
+            'instructions_per_second': instructions / wallTime,
+            'queries_per_second': queries / wallTime,
+            'states_per_second': paths / wallTime,
+            'peak_rss_kib': peakRSS,
+            'covered_instructions': covered,
+            'total_instructions': covered + uncovered,
+            # coverage over time: (instructions, wall time, covered)
+            'coverage': [[r[0], r[1], r[2]] for r in rows],
+        })
+    runs.sort(key=lambda r: r['wall_time'])
+    result = runs[len(runs) // 2]
+    if len(runs) > 1:
+        result['wall_times'] = [r['wall_time'] for r in runs]
+    return result
+
+
+def kleeVersion(klee):
+    try:
+        output = subprocess.check_output([klee, '--version'],
+                                         stderr=subprocess.STDOUT)
+        return output.decode(errors='replace').strip().splitlines()[0]
+    except (OSError, subprocess.CalledProcessError, IndexError):
+        return 'unknown'
+
+
+def run(args):
+    with open(args.corpus) as f:
+        corpus = json.load(f)
+    corpusDir = os.path.dirname(os.path.abspath(args.corpus))
+    if args.programs:
+        unknown = set(args.programs) - set(e['name'] for e in corpus)
+        if unknown:
+            print('unknown programs: ' + ', '.join(sorted(unknown)),
+                  file=sys.stderr)
+            return 1
+        corpus = [e for e in corpus if e['name'] in args.programs]
+    os.makedirs(args.output, exist_ok=True)
+
+    results = {
+        'context': {
+            'klee': kleeVersion(args.klee),
+            'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+            'max_instructions': args.max_instructions,
+            'rng_seed': args.rng_seed,
+            'repetitions': args.repetitions,
+        },
+        'programs': {},
+        'failed': [],
+    }
+    for entry in corpus:
+        name = entry['name']
+        bitcode = compileProgram(entry, corpusDir, args.output, args)
+        result = bitcode and measure(entry, bitcode, args.output, args)
+        if not result:
+            print('{}: failed, see {}'.format(
+                name, os.path.join(args.output, name + '.klee-out.log')
+                if bitcode else 'the compiler output'), file=sys.stderr)
+            results['failed'].append(name)
+            continue
+        results['programs'][name] = result
+        print('{}: {:.0f} instructions/s, {:.1f} queries/s, {:.1f} states/s, '
+              '{} KiB, {}/{} instructions covered'.format(
+                  name, result['instructions_per_second'],
+                  result['queries_per_second'], result['states_per_second'],
+                  result['peak_rss_kib'], result['covered_instructions'],
+                  result['total_instructions']))
+
+    path = os.path.join(args.output, 'results.json')
+    with open(path, 'w') as f:
+        json.dump(results, f, indent=2)
+    print('wrote ' + path)
+    return 1 if results['failed'] else 0
+
+
+def timeToCover(result, covered):
+    """The wall time at which a run covered at least `covered` instructions."""
+    for _, wallTime, c in result['coverage']:
+        if c >= covered:
+            return wallTime
+    return None
+
+
+def compare(args):
+    with open(args.baseline) as f:
+        baseline = json.load(f)['programs']
+    with open(args.current) as f:
+        current = json.load(f)['programs']
+
+    regressions = []
+    header = ['Program'] + [m[1] for m in Metrics] + ['TimeToCover']
+    table = [header]
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline or name not in current:
+            table.append([name, 'missing in ' +
+                          ('baseline' if name not in baseline else 'current')])
+            continue
+        b, c = baseline[name], current[name]
+        row = [name]
+        for key, _, moreIsBetter in Metrics:
+            if not b[key]:
+                row.append('-')
+                continue
+            change = c[key] / b[key] - 1
+            worse = -change if moreIsBetter else change
+            cell = '{:+.1%}'.format(change)
+            if worse > args.threshold and key != 'covered_instructions':
+                regressions.append('{} {}'.format(name, key))
+                cell += '!'
+            row.append(cell)
+        # when the current run reached the final coverage of the baseline
+        t = timeToCover(c, b['covered_instructions'])
+        bt = timeToCover(b, b['covered_instructions'])
+        row.append('{:.2f}s/{:.2f}s'.format(t, bt) if t is not None else
+                   'never')
+        if b['instructions'] != c['instructions']:
+            row[0] += '*'
+        table.append(row)
+
+    widths = [max(len(r[i]) for r in table if i < len(r))
+              for i in range(len(header))]
+    for r in table:
+        print('  '.join(cell.rjust(widths[i]) if i else cell.ljust(widths[i])
+                        for i, cell in enumerate(r)))
+    if any(r[0].endswith('*') for r in table[1:]):
+        print('* executed a different number of instructions, so explored '
+              'different paths')
+    print('TimeToCover: when the current run reached the final coverage of '
+          'the baseline, against the baseline')
+
+    if regressions:
+        print('{} regression(s) of more than {:.0%}: {}'.format(
+            len(regressions), args.threshold, ', '.join(regressions)),
+            file=sys.stderr)
+        return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest='command')
+    commands.required = True
+
+    runParser = commands.add_parser('run', help='run the corpus')
+    runParser.add_argument('--output', required=True,
+                           help='directory of the results')
+    runParser.add_argument('--klee', default='klee', help='KLEE to run')
+    runParser.add_argument('--clang', default='clang',
+                           help='clang to compile the programs with')
+    runParser.add_argument('--include',
+                           default=os.path.join(ScriptDir, '..', 'include'),
+                           help='directory of klee/klee.h')
+    runParser.add_argument('--corpus',
+                           default=os.path.join(ScriptDir, 'programs',
+                                                'corpus.json'),
+                           help='the programs to run')
+    runParser.add_argument('--max-instructions', type=int, default=2000000,
+                           help='instructions to explore each program for '
+                           '(default: 2000000)')
+    runParser.add_argument('--max-time', default='10min',
+                           help='time limit of each run (default: 10min)')
+    runParser.add_argument('--rng-seed', type=int, default=5489,
+                           help='seed of the searchers (default: 5489)')
+    runParser.add_argument('--repetitions', type=int, default=1,
+                           help='runs of each program, of which the median '
+                           'is kept (default: 1)')
+    runParser.add_argument('--samples', type=int, default=100,
+                           help='points of the coverage curves (default: 100)')
+    runParser.add_argument('--klee-args', nargs=argparse.REMAINDER,
+                           default=[],
+                           help='more arguments of KLEE, for all programs')
+    runParser.add_argument('programs', nargs='*',
+                           help='programs of the corpus to run (default: all)')
+
+    compareParser = commands.add_parser('compare',
+                                        help='compare two results.json')
+    compareParser.add_argument('baseline', help='results of the baseline')
+    compareParser.add_argument('current', help='results to check')
+    compareParser.add_argument('--threshold', type=float, default=0.1,
+                               help='largest change for the worse accepted, '
+                               'as a fraction of the baseline (default: 0.1)')
+
+    args = parser.parse_args()
+    return run(args) if args.command == 'run' else compare(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,62 @@
+//===-- base64.c ----------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Decodes a symbolic base64 input, like base64 -d, rejecting malformed
+// input.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/klee.h"
+
+#define SIZE 8
+
+static int decodeChar(char c) {
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+')
+    return 62;
+  if (c == '/')
+    return 63;
+  return -1;
+}
+
+int main(void) {
+  char input[SIZE];
+  unsigned char output[SIZE / 4 * 3];
+  unsigned n = 0;
+
+  klee_make_symbolic(input, sizeof(input), "input");
+  for (unsigned i = 0; i < SIZE; i += 4) {
+    int v[4];
+    unsigned padding = 0;
+    for (unsigned j = 0; j < 4; ++j) {
+      if (input[i + j] == '=' && j >= 2 && i + 4 == SIZE) {
+        ++padding;
+        v[j] = 0;
+        continue;
+      }
+      if (padding)
+        return 1; // data after padding
+      v[j] = decodeChar(input[i + j]);
+      if (v[j] < 0)
+        return 1;
+    }
+    unsigned bits = (v[0] << 18) | (v[1] << 12) | (v[2] << 6) | v[3];
+    output[n++] = bits >> 16;
+    if (padding < 2)
+      output[n++] = bits >> 8;
+    if (padding < 1)
+      output[n++] = bits;
+  }
+  return output[0] == 'K' && n > 4;
+}
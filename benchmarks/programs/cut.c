@@ -0,0 +1,67 @@
+//===-- cut.c -------------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Parses a symbolic list of fields such as "1-3,5" and selects them from
+// a symbolic line of comma separated fields, like cut -d, -f.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/klee.h"
+
+#define LIST_SIZE 5
+#define LINE_SIZE 8
+#define MAX_FIELD 8
+
+int main(void) {
+  char list[LIST_SIZE], line[LINE_SIZE];
+  int selected[MAX_FIELD + 1] = {0};
+  unsigned from = 0, number = 0, i = 0;
+  int inRange = 0;
+
+  klee_make_symbolic(list, sizeof(list), "list");
+  klee_make_symbolic(line, sizeof(line), "line");
+
+  // the field list
+  for (;; ++i) {
+    char c = i < LIST_SIZE ? list[i] : 0;
+    if (c >= '1' && c <= '0' + MAX_FIELD) {
+      number = number * 10 + (c - '0');
+      if (number > MAX_FIELD)
+        return 1;
+    } else if (c == '-' && !inRange) {
+      from = number ? number : 1;
+      number = 0;
+      inRange = 1;
+    } else if (c == ',' || c == 0) {
+      unsigned to = number ? number : (inRange ? MAX_FIELD : 0);
+      if (!inRange)
+        from = number;
+      if (!from || from > to)
+        return 1;
+      for (unsigned f = from; f <= to; ++f)
+        selected[f] = 1;
+      if (!c)
+        break;
+      number = 0;
+      inRange = 0;
+    } else {
+      return 1;
+    }
+  }
+
+  // the selected fields of the line
+  unsigned field = 1, out = 0;
+  for (i = 0; i < LINE_SIZE && line[i] && line[i] != '\n'; ++i) {
+    if (line[i] == ',')
+      ++field;
+    else if (field <= MAX_FIELD && selected[field])
+      ++out;
+  }
+  return out == 3;
+}
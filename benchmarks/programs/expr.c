@@ -0,0 +1,83 @@
+//===-- expr.c ------------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Evaluates a symbolic arithmetic expression with a recursive descent
+// parser, like expr, which builds symbolic values through the memory of
+// its stack.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/klee.h"
+
+#define SIZE 7
+
+static const char *p;
+static int error;
+
+static int sum(void);
+
+static int primary(void) {
+  if (*p >= '0' && *p <= '9') {
+    int v = 0;
+    while (*p >= '0' && *p <= '9')
+      v = v * 10 + (*p++ - '0');
+    return v;
+  }
+  if (*p == '(') {
+    ++p;
+    int v = sum();
+    if (*p != ')')
+      error = 1;
+    else
+      ++p;
+    return v;
+  }
+  if (*p == '-') {
+    ++p;
+    return -primary();
+  }
+  error = 1;
+  return 0;
+}
+
+static int product(void) {
+  int v = primary();
+  while (!error && (*p == '*' || *p == '/' || *p == '%')) {
+    char op = *p++;
+    int w = primary();
+    if (op != '*' && w == 0) {
+      error = 1;
+      break;
+    }
+    v = op == '*' ? v * w : op == '/' ? v / w : v % w;
+  }
+  return v;
+}
+
+static int sum(void) {
+  int v = product();
+  while (!error && (*p == '+' || *p == '-')) {
+    char op = *p++;
+    int w = product();
+    v = op == '+' ? v + w : v - w;
+  }
+  return v;
+}
+
+int main(void) {
+  char input[SIZE + 1];
+
+  klee_make_symbolic(input, SIZE, "input");
+  input[SIZE] = 0;
+  p = input;
+  int v = sum();
+  if (error || *p)
+    return 2;
+  return v == 42;
+}
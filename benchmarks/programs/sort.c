@@ -0,0 +1,43 @@
+//===-- sort.c ------------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Sorts symbolic numbers with an insertion sort and removes duplicates,
+// like sort -u, which forks on every comparison.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+#define N 6
+
+int main(void) {
+  int a[N];
+  unsigned n = N;
+
+  klee_make_symbolic(a, sizeof(a), "a");
+  for (unsigned i = 1; i < N; ++i) {
+    int v = a[i];
+    unsigned j = i;
+    for (; j > 0 && a[j - 1] > v; --j)
+      a[j] = a[j - 1];
+    a[j] = v;
+  }
+
+  unsigned k = 0;
+  for (unsigned i = 1; i < n; ++i)
+    if (a[i] != a[k])
+      a[++k] = a[i];
+  n = k + 1;
+
+  for (unsigned i = 1; i < n; ++i)
+    assert(a[i - 1] < a[i]);
+  return n;
+}
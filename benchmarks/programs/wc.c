@@ -0,0 +1,41 @@
+//===-- wc.c --------------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Counts the lines, words and bytes of a symbolic input, like wc.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/klee.h"
+
+#define SIZE 12
+
+static int isspace_(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+         c == '\f';
+}
+
+int main(void) {
+  char input[SIZE];
+  unsigned lines = 0, words = 0, bytes = 0;
+  int inWord = 0;
+
+  klee_make_symbolic(input, sizeof(input), "input");
+  for (unsigned i = 0; i < SIZE && input[i]; ++i) {
+    ++bytes;
+    if (input[i] == '\n')
+      ++lines;
+    if (isspace_(input[i])) {
+      inWord = 0;
+    } else if (!inWord) {
+      inWord = 1;
+      ++words;
+    }
+  }
+  return lines + words + bytes > 2 * SIZE;
+}
@@ -0,0 +1,42 @@
+#===------------------------------------------------------------------------===#
+#
+#                     The KLEE Symbolic Virtual Machine
+#
+# This file is distributed under the University of Illinois Open Source
+# License. See LICENSE.TXT for details.
+#
+#===------------------------------------------------------------------------===#
+# CaDiCaL: The user can pass `-DCADICAL_INCLUDE_DIR=` and
+# `-DCADICAL_LIBRARY=` to force a particular installation.
+find_path(CADICAL_INCLUDE_DIR cadical.hpp)
+find_library(CADICAL_LIBRARY cadical)
+
+# Set the default so that if the following is true:
+# * CaDiCaL was found
+# * ENABLE_SOLVER_CADICAL is not already set as a cache variable
+#
+# then the default is set to `ON`. Otherwise set the default to `OFF`.
+if (CADICAL_INCLUDE_DIR AND CADICAL_LIBRARY)
+  set(ENABLE_SOLVER_CADICAL_DEFAULT ON)
+else()
+  set(ENABLE_SOLVER_CADICAL_DEFAULT OFF)
+endif()
+option(ENABLE_SOLVER_CADICAL
+  "Enable the bit-blasting solver backend built on the CaDiCaL SAT solver"
+  ${ENABLE_SOLVER_CADICAL_DEFAULT})
+
+if (ENABLE_SOLVER_CADICAL)
+  message(STATUS "CaDiCaL solver support enabled")
+  if (CADICAL_INCLUDE_DIR AND CADICAL_LIBRARY)
+    message(STATUS "Found CaDiCaL: ${CADICAL_LIBRARY}")
+    set(ENABLE_CADICAL 1) # For config.h
+    list(APPEND KLEE_COMPONENT_EXTRA_INCLUDE_DIRS "${CADICAL_INCLUDE_DIR}")
+    list(APPEND KLEE_SOLVER_LIBRARIES "${CADICAL_LIBRARY}")
+  else()
+    message(FATAL_ERROR "CaDiCaL not found. Try setting "
+      "`-DCADICAL_INCLUDE_DIR=/path` and `-DCADICAL_LIBRARY=/path/libcadical.a`")
+  endif()
+else()
+  message(STATUS "CaDiCaL solver support disabled")
+  set(ENABLE_CADICAL 0) # For config.h
+endif()
@@ -7,6 +7,7 @@
 #
 #===------------------------------------------------------------------------===#
 include(CMakePushCheckState)
+include(CheckSymbolExists)
 
 find_package(Z3)
 # Set the default so that if the following is true:
@@ -43,6 +44,21 @@ if (ENABLE_SOLVER_Z3)
     else()
       message(STATUS "Z3_get_error_msg does not require context")
     endif()
+
+    # Lambda terms appeared in Z3 4.8.0
+    cmake_push_check_state()
+    set(CMAKE_REQUIRED_INCLUDES ${CMAKE_REQUIRED_INCLUDES} ${Z3_INCLUDE_DIRS})
+    set(CMAKE_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES} ${Z3_LIBRARIES})
+    check_symbol_exists(Z3_mk_lambda_const "z3.h" HAVE_Z3_MK_LAMBDA)
+    cmake_pop_check_state()
+
+    # Z3_optimize_check() takes assumptions since Z3 4.8.0
+    cmake_push_check_state()
+    set(CMAKE_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES} ${Z3_LIBRARIES})
+    check_prototype_definition(Z3_optimize_check
+      "Z3_lbool Z3_optimize_check(Z3_context c, Z3_optimize o, unsigned num_assumptions, Z3_ast const assumptions[])"
+      "Z3_L_UNDEF" "${Z3_INCLUDE_DIRS}/z3.h" HAVE_Z3_OPTIMIZE_CHECK_ASSUMPTIONS)
+    cmake_pop_check_state()
   else()
     message(FATAL_ERROR "Z3 not found.")
   endif()
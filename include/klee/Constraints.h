@@ -11,6 +11,9 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ChunkedVector.h"
+
+#include <memory>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -18,13 +21,15 @@
 // (ConstraintSet?) which ConstraintManager could embed if it likes.
 namespace klee {
 
+class ConstraintIndependence;
+class ConstraintRanges;
 class ExprVisitor;
   
 class ConstraintManager {
 public:
   typedef std::vector< ref<Expr> > constraints_ty;
-  typedef constraints_ty::iterator iterator;
-  typedef constraints_ty::const_iterator const_iterator;
+  typedef ChunkedVector< ref<Expr> >::const_iterator const_iterator;
+  typedef const_iterator iterator;
 
   ConstraintManager() {}
 
@@ -33,9 +38,19 @@ public:
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
     constraints(_constraints) {}
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  // as above, taking over the storage of the vector
+  explicit ConstraintManager(constraints_ty &&_constraints)
+      : constraints(std::move(_constraints)) {}
+
+  // the independence and range indices are shared with the copy until
+  // either one adds a constraint
+  ConstraintManager(const ConstraintManager &cs)
+      : constraints(cs.constraints), independence(cs.independence),
+        ranges(cs.ranges) {}
 
-  typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
+  ConstraintManager &operator=(const ConstraintManager &cs) = default;
+
+  typedef const_iterator constraint_iterator;
 
   // given a constraint which is known to be valid, attempt to 
   // simplify the existing constraint set
@@ -64,14 +79,56 @@ public:
   bool operator==(const ConstraintManager &other) const {
     return constraints == other.constraints;
   }
+
+  /// Appends to \a result, in order, the constraints that \a e depends on,
+  /// i.e. those that transitively share a read array byte with it.
+  void getIndependentConstraints(ref<Expr> e, constraints_ty &result) const;
+
+  /// Sets \a result to the constraints that \a e depends on. When that is
+  /// all of them, \a result shares the constraints and indices of this
+  /// manager instead of copying them.
+  void getIndependentConstraints(ref<Expr> e, ConstraintManager &result) const;
+
+  /// Partitions the constraints into independent factors. The first factor
+  /// holds the constraints \a e depends on and may be empty; all others are
+  /// non-empty.
+  void getIndependentFactors(ref<Expr> e,
+                             std::vector<constraints_ty> &factors) const;
+
+  /// Drops the constraints in \a dropped, keeping the order of the others.
+  void removeConstraints(const constraints_ty &dropped);
   
 private:
-  std::vector< ref<Expr> > constraints;
+  // Shared in chunks with the copies of this manager, so that forking a
+  // state does not copy its constraints.
+  ChunkedVector< ref<Expr> > constraints;
+
+  // Union-find over the constraints, keyed on the array bytes they read.
+  // Built on first use, then maintained by addConstraint() and shared
+  // copy-on-write with copies of this manager.
+  mutable std::shared_ptr<ConstraintIndependence> independence;
+
+  ConstraintIndependence &getIndependence() const;
+
+  // Bounds of the terms compared with constants, as implied by the
+  // constraints. Built on first use, then maintained like the independence
+  // index.
+  mutable std::shared_ptr<ConstraintRanges> ranges;
+
+  ConstraintRanges &getRanges() const;
+
+  // returns true iff the bound constraint e need not be appended, because it
+  // is implied, is implied to pin its term to a constant, or has replaced a
+  // looser bound of the same kind
+  bool foldBound(ref<Expr> e);
 
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
   void addConstraintInternal(ref<Expr> e);
+
+  // appends e to the constraints, keeping the independence index current
+  void pushConstraint(ref<Expr> e);
 };
 
 }
@@ -12,37 +12,71 @@
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/CopyOnWrite.h"
+#include "klee/Internal/ADT/DecisionHistory.h"
+#include "klee/Internal/ADT/ImmutableSet.h"
 #include "klee/Internal/ADT/TreeStream.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/MergeHandler.h"
 
 // FIXME: We do not want to be exposing these? :(
 #include "../../lib/Core/AddressSpace.h"
+#include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstIterator.h"
 
+#include "llvm/ADT/SparseBitVector.h"
+
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
+#include <tuple>
+#include <unordered_set>
 #include <vector>
 
 namespace klee {
 class Array;
+class Assignment;
 class CallPathNode;
-struct Cell;
 struct KFunction;
 struct KInstruction;
 class MemoryObject;
 class PTreeNode;
+struct SubsumptionEntry;
+struct SummaryRecording;
 struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// What ExecutionState::getContentFingerprint() hashes, kept to tell a
+/// state with the same contents from a collision of the fingerprints.
+struct StateContents {
+  struct Frame {
+    const KInstruction *caller;
+    const KFunction *kf;
+    /// The live registers by number, with their values (null if unset).
+    std::vector<std::pair<unsigned, ref<Expr> > > registers;
+  };
+
+  const KInstruction *pc = nullptr;
+  unsigned incomingBBIndex = 0;
+  bool forkDisabled = false;
+  std::vector<Frame> frames;
+  /// The objects, sharing the nodes of the map of the address space they
+  /// were taken from.
+  MemoryMap objects;
+};
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+
+  /// The values of the registers, shared with the copies of this frame in
+  /// forked states until one of them writes to a register.
+  CopyOnWrite<std::vector<Cell> > locals;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -59,8 +93,58 @@ struct StackFrame {
   MemoryObject *varargs;
 
   StackFrame(KInstIterator caller, KFunction *kf);
-  StackFrame(const StackFrame &s);
-  ~StackFrame();
+
+  /// Return the registers for modification to write the result of \a
+  /// current, an instruction of this frame. If they are shared with another
+  /// frame, only the registers which may still be read are copied.
+  std::vector<Cell> &mutateLocals(const KInstruction *current);
+};
+
+/// @brief The symbolic objects of a state in the order they were made
+/// symbolic, holding a reference to each memory object
+class SymbolicList {
+public:
+  typedef std::pair<const MemoryObject *, const Array *> value_type;
+
+private:
+  std::vector<value_type> objects;
+
+public:
+  SymbolicList() {}
+  SymbolicList(const SymbolicList &b);
+  SymbolicList &operator=(const SymbolicList &b) = delete;
+  ~SymbolicList();
+
+  void push_back(const MemoryObject *mo, const Array *array);
+
+  size_t size() const { return objects.size(); }
+  const value_type &operator[](size_t i) const { return objects[i]; }
+  bool operator==(const SymbolicList &b) const { return objects == b.objects; }
+  bool operator!=(const SymbolicList &b) const { return objects != b.objects; }
+};
+
+/// @brief Approximate number of bytes held by each part of a set of
+/// states. Parts shared between states are counted once.
+struct StateFootprint {
+  std::uint64_t stack = 0;
+  std::uint64_t coveredLines = 0;
+  std::uint64_t arrayNames = 0;
+  std::uint64_t symbolics = 0;
+  std::uint64_t constraints = 0;
+  /// The nodes of the maps from memory objects to their contents.
+  std::uint64_t addressSpace = 0;
+  /// The object states, their concrete and symbolic contents and masks.
+  std::uint64_t objectStates = 0;
+  /// The update lists of the object states.
+  std::uint64_t updates = 0;
+  /// The part of the bytes above held by no other state, which would be
+  /// freed with the states.
+  std::uint64_t exclusive = 0;
+
+  std::uint64_t total() const {
+    return stack + coveredLines + arrayNames + symbolics + constraints +
+           addressSpace + objectStates + updates;
+  }
 };
 
 /// @brief ExecutionState representing a path under exploration
@@ -97,6 +181,35 @@ public:
   /// @brief Constraints collected so far
   ConstraintManager constraints;
 
+  /// @brief Constraints dropped from `constraints` by
+  /// collectDeadConstraints(). They are still part of the path condition
+  /// when generating test cases. Shared with forked states until either of
+  /// them adds to it.
+  CopyOnWrite<std::vector<ref<Expr> > > deadConstraints;
+
+  /// @brief The number of constraints left by the last
+  /// collectDeadConstraints().
+  size_t collectedConstraints = 0;
+
+  /// @brief The join blocks this state went through whose paths from
+  /// there are recorded for --prune-subsumed-states, counting the state
+  /// among their pending descendants.
+  std::vector<std::shared_ptr<SubsumptionEntry> > subsumptionEntries;
+
+  /// @brief The memory accesses proved in bounds, as the id of the object,
+  /// the offset and the number of bytes. They stay in bounds as
+  /// constraints are added. Shared with forked states.
+  ImmutableSet<std::tuple<unsigned, ref<Expr>, unsigned> > inBoundsAccesses;
+
+  /// @brief An assignment to (some of) the symbolic arrays which can be
+  /// extended to satisfy the constraints, if one is known. Arrays it does
+  /// not bind are left symbolic. Shared with forked states.
+  std::shared_ptr<Assignment> model;
+
+  /// @brief Branch condition of a lazy fork, not yet known to be feasible.
+  /// It joins the constraints once the state is selected and shown to be.
+  ref<Expr> lazyCondition;
+
   /// Statistics and information
 
   /// @brief Costs for all queries issued for this state, in seconds
@@ -117,6 +230,9 @@ public:
   /// taken to reach/create this state
   TreeOStream symPathOS;
 
+  /// @brief Branch decisions taken by this state, recorded for checkpoints
+  DecisionHistory decisions;
+
   /// @brief Counts how many instructions were executed since the last new
   /// instruction was covered.
   unsigned instsSinceCovNew;
@@ -127,19 +243,49 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
-  /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  /// @brief Whether this state executed an instruction at a --target
+  bool reachedTarget = false;
+
+  /// @brief The last branch decisions of this state, for the subpath
+  /// searcher: the edges taken, ids as in coveredEdges, in a ring whose
+  /// oldest entry is at subpathNext once full
+  std::vector<std::uint64_t> subpath;
+  unsigned subpathNext = 0;
+  /// @brief Rolling hash of the decisions in subpath, in order
+  std::uint64_t subpathHash = 0;
+  /// @brief Number of the decisions recorded with addBranchDecision()
+  std::uint64_t branchDecisions = 0;
+
+  /// @brief The instructions first covered by this state, by id, shared
+  /// with forked states until either of them changes it
+  CopyOnWrite<llvm::SparseBitVector<> > coveredInstructions;
+
+  /// @brief The control flow edges taken on the path of this state, as the
+  /// ids of the branch and its target, for --dedup-test-cases
+  ImmutableSet<std::uint64_t> coveredEdges;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  /// Shared with forked states until either of them adds to it.
+  CopyOnWrite<SymbolicList> symbolics;
 
-  /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  /// @brief The array names used by this state, by their interned numbers,
+  /// each with the next suffix to try for it.  Used to avoid collisions.
+  /// Shared with forked states until either of them adds to it.
+  CopyOnWrite<std::map<unsigned, unsigned> > arrayNames;
+
+  /// @brief The objects made by --lazy-init, by the arrays of their
+  /// contents, with their depths. Shared with forked states until either
+  /// of them adds to it.
+  CopyOnWrite<std::map<const Array *,
+                       std::pair<const MemoryObject *, unsigned> > >
+      lazyObjects;
+
+  /// @brief The symbolic pointers --lazy-init has bound. Shared with forked
+  /// states until either of them adds to it.
+  CopyOnWrite<std::set<ref<Expr> > > lazyPointers;
 
   // The objects handling the klee_open_merge calls this state ran through
   std::vector<ref<MergeHandler> > openMergeStack;
@@ -147,6 +293,20 @@ public:
   // The numbers of times this state has run through Executor::stepInstruction
   std::uint64_t steppedInstructions;
 
+  // The value of stats::instructions when this state was last stepped
+  std::uint64_t lastStepped;
+
+  /// @brief The call whose effects are being recorded for a function
+  /// summary, if any. Not inherited by forked states.
+  std::shared_ptr<SummaryRecording> summaryRecording;
+
+  /// @brief The position of the state in the StateSet holding it
+  size_t stateSetIndex = ~size_t(0);
+
+  /// @brief The emptied register arrays of popped frames, reused by the
+  /// frames pushed next. Not inherited by forked states.
+  std::vector<CopyOnWrite<std::vector<Cell> > > localsPool;
+
 private:
   ExecutionState() : ptreeNode(0) {}
 
@@ -164,13 +324,53 @@ public:
   ExecutionState *branch();
 
   void pushFrame(KInstIterator caller, KFunction *kf);
+
+  /// Records that the state took the control flow \a edge at a branch,
+  /// keeping the last \a length decisions in subpath.
+  void addBranchDecision(std::uint64_t edge, unsigned length);
   void popFrame();
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
-  void addConstraint(ref<Expr> e) { constraints.addConstraint(e); }
+  /// Adds a constraint, dropping the model unless it satisfies it.
+  void addConstraint(ref<Expr> e);
+
+  /// Moves to `deadConstraints` the independent sets of constraints which
+  /// only read the arrays of symbolic objects no longer bound, when no
+  /// value held by the state refers to these arrays any more.
+  /// \return The number of constraints moved.
+  size_t collectDeadConstraints();
+
+  /// Appends the symbolic arrays which values in memory, in registers or
+  /// held for later refer to.
+  void findLiveArrays(std::vector<const Array *> &arrays) const;
+
+  /// Hashes what the paths from here depend on besides the constraints:
+  /// the pc, the stack with the registers and the memory contents.
+  std::uint64_t getContentFingerprint() const;
+
+  /// Records what getContentFingerprint() hashes in \a contents.
+  void getContents(StateContents &contents) const;
+
+  /// Whether the state has \a contents, taken from a state with the same
+  /// fingerprint. Only the objects whose states the two maps do not share
+  /// are compared byte by byte.
+  bool hasContents(const StateContents &contents) const;
+
+  /// The constraints together with the dead ones.
+  ConstraintManager getPathConstraints() const;
+
+  /// Hashes what merge() requires to be equal: the pc, the shape of the
+  /// stack, the symbolic objects and which memory objects are bound.
+  /// States with different fingerprints cannot be merged.
+  std::uint64_t getMergeFingerprint() const;
 
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
+
+  /// Add the memory held by this state to \a footprint, skipping the parts
+  /// recorded in \a seen and recording the others.
+  void addFootprint(StateFootprint &footprint,
+                    std::unordered_set<const void *> &seen) const;
 };
 }
 
@@ -10,8 +10,13 @@
 #ifndef KLEE_EXPR_H
 #define KLEE_EXPR_H
 
+#include "klee/Config/config.h"
 #include "klee/util/Bits.h"
+#include "klee/util/ExprAllocator.h"
 #include "klee/util/Ref.h"
+#ifdef ENABLE_BIASED_REFCOUNT
+#include "klee/util/BiasedRefCount.h"
+#endif
 
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/APInt.h"
@@ -24,6 +29,8 @@
 #include <set>
 #include <vector>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 namespace llvm {
   class Type;
@@ -41,6 +48,13 @@ template<class T> class ref;
 
 extern llvm::cl::OptionCategory ExprCat;
 
+/// Reference counter used by Expr and UpdateNode (see Ref.h).
+#ifdef ENABLE_BIASED_REFCOUNT
+typedef BiasedRefCount ExprRefCount;
+#else
+typedef unsigned ExprRefCount;
+#endif
+
 /// Class representing symbolic expressions.
 /**
 
@@ -94,6 +108,14 @@ public:
   static unsigned count;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
+  /// Mixes \a value into the hash \a seed. Unlike xor-ing the hashes of
+  /// the kids, this depends on their order and keeps the bits of deep
+  /// kids, so that hashes tell apart most structurally different
+  /// expressions before compare() has to recurse into them.
+  static unsigned combineHash(unsigned seed, unsigned value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+  }
+
   /// The type of an expression is simply its width, in bits. 
   typedef unsigned Width; 
   
@@ -164,7 +186,12 @@ public:
     Sgt, ///< Not used in canonical form
     Sge, ///< Not used in canonical form
 
-    LastKind=Sge,
+    // Special, after the others so that their numbers are stable
+
+    /// Several consecutive bytes of an array, as one value.
+    WideRead,
+
+    LastKind=WideRead,
 
     CastKindFirst=ZExt,
     CastKindLast=SExt,
@@ -174,7 +201,7 @@ public:
     CmpKindLast=Sge
   };
 
-  unsigned refCount;
+  ExprRefCount refCount;
 
 protected:  
   unsigned hashValue;
@@ -205,7 +232,14 @@ protected:
 
 public:
   Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  virtual ~Expr();
+
+  static void *operator new(std::size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, std::size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -285,6 +319,16 @@ public:
 
   static bool classof(const Expr *) { return true; }
 
+protected:
+  /// Returns the interned expression structurally equal to `e`, registering
+  /// `e` as the canonical node if there is none yet. When interning is
+  /// disabled (see -intern-exprs) `e` is returned unchanged.
+  ///
+  /// Must be called by the `alloc` methods once the hash of `e` has been
+  /// computed. Relies on the kids of `e` being interned already, so that they
+  /// can be compared by address.
+  static ref<Expr> intern(const ref<Expr> &e);
+
 private:
   typedef llvm::DenseSet<std::pair<const Expr *, const Expr *> > ExprEquivSet;
   int compare(const Expr &b, ExprEquivSet &equivs) const;
@@ -417,7 +461,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -451,7 +495,7 @@ public:
 class UpdateNode {
   friend class UpdateList;  
 
-  mutable unsigned refCount;
+  mutable ExprRefCount refCount;
   // cache instead of recalc
   unsigned hashValue;
 
@@ -462,7 +506,20 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
-  
+
+  /// Maps the indices of the updates with concrete indices, from this one
+  /// down to the most recent one with a symbolic index, to the most recent
+  /// update of each. Only built for long runs of such updates. It is held
+  /// by the most recent update of the run only, which hands it on to the
+  /// first update extending it: forks sharing the run share its index
+  /// until one of them writes.
+  struct ConcreteIndex {
+    std::unordered_map<uint64_t, const UpdateNode *> latest;
+    /// The most recent update with a symbolic index, or null.
+    const UpdateNode *rest;
+  };
+  mutable std::unique_ptr<ConcreteIndex> concreteIndex;
+
 public:
   UpdateNode(const UpdateNode *_next, 
              const ref<Expr> &_index, 
@@ -470,6 +527,16 @@ public:
 
   unsigned getSize() const { return size; }
 
+  /// Whether more than one list or update refers to this update.
+  bool isShared() const { return (unsigned)refCount > 1; }
+
+  static void *operator new(std::size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, std::size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
+
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
@@ -482,8 +549,26 @@ private:
 
 class Array {
 public:
+  /// The interned copy of a name and its number.
+  typedef std::pair<const std::string, unsigned> InternedName;
+
+  /// Returns the interned copy of \a name, which lives as long as the
+  /// program, and its number, the same for every array of that name.
+  static const InternedName &internName(const std::string &name);
+
+private:
+  const InternedName &interned;
+
+public:
+  /// A number unique to this array, in the order the arrays were created.
+  const unsigned id;
+
+  /// The number of the name of this array, see internName(). Comparing and
+  /// hashing names goes through it, the name itself is only for output.
+  const unsigned nameId;
+
   // Name of the array
-  const std::string name;
+  const std::string &name;
 
   // FIXME: Not 64-bit clean.
   const unsigned size;
@@ -500,6 +585,8 @@ public:
 private:
   unsigned hashValue;
 
+  static unsigned nextId();
+
   // FIXME: Make =delete when we switch to C++11
   Array(const Array& array);
 
@@ -524,7 +611,7 @@ public:
   bool isSymbolicArray() const { return constantValues.empty(); }
   bool isConstantArray() const { return !isSymbolicArray(); }
 
-  const std::string getName() const { return name; }
+  const std::string &getName() const { return name; }
   unsigned getSize() const { return size; }
   Expr::Width getDomain() const { return domain; }
   Expr::Width getRange() const { return range; }
@@ -557,6 +644,21 @@ public:
   
   void extend(const ref<Expr> &index, const ref<Expr> &value);
 
+  /// Looks up the most recent update of the concrete \a index among the
+  /// most recent updates with concrete indices, if they are indexed.
+  /// \param [out] found - The update, or null if there is none.
+  /// \param [out] rest - The most recent update with a symbolic index, or
+  /// null.
+  /// \return false if the updates are not indexed.
+  bool findConcrete(uint64_t index, const UpdateNode *&found,
+                    const UpdateNode *&rest) const;
+
+  /// Rewrites the list into an equivalent one without the updates of
+  /// concrete indices written again later, with the runs of updates of
+  /// concrete indices rebuilt in the order of their indices. The oldest
+  /// updates up to the first one dropped stay shared.
+  void compact();
+
   int compare(const UpdateList &b) const;
   unsigned hash() const;
 private:
@@ -577,7 +679,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -608,6 +710,82 @@ public:
 };
 
 
+/// Class representing a read of consecutive bytes of an array, the value of
+/// the concatenation of their reads: ReadLSB or ReadMSB in KQuery. It stands
+/// for the whole tree of concatenations, so that multi-byte loads take a
+/// single node to hold, hash and compare.
+///
+/// ConcatExpr::create builds wide reads from the concatenations of reads it
+/// is given, and ExtractExpr::create takes their bytes apart again, so that
+/// they are never built directly.
+class WideReadExpr : public NonConstantExpr {
+public:
+  static const Kind kind = WideRead;
+  static const unsigned numKids = 1;
+
+public:
+  UpdateList updates;
+  /// The index of the byte at the lowest index.
+  ref<Expr> index;
+  Width width;
+  /// Whether the byte at the lowest index is the least significant one.
+  bool isLittleEndian;
+
+public:
+  static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index,
+                         Width w, bool isLittleEndian) {
+    ref<Expr> r(new WideReadExpr(updates, index, w, isLittleEndian));
+    r->computeHash();
+    return intern(r);
+  }
+
+  /// Creates the read of the \a w / range bytes at \a index, or the read of
+  /// the byte if there is a single one.
+  static ref<Expr> create(const UpdateList &updates, ref<Expr> index, Width w,
+                          bool isLittleEndian);
+
+  Width getWidth() const { return width; }
+  Kind getKind() const { return WideRead; }
+
+  unsigned getNumKids() const { return numKids; }
+  ref<Expr> getKid(unsigned i) const { return !i ? index : 0; }
+
+  unsigned getNumBytes() const { return width / updates.root->getRange(); }
+
+  /// The index of the byte \a byte bytes above the least significant one.
+  ref<Expr> getByteIndex(unsigned byte) const;
+
+  /// The read of the byte \a byte bytes above the least significant one.
+  ref<Expr> getByte(unsigned byte) const;
+
+  /// The equivalent concatenation of the reads of the bytes, for the users
+  /// which only handle those.
+  ref<Expr> lower() const;
+
+  int compareContents(const Expr &b) const;
+
+  virtual ref<Expr> rebuild(ref<Expr> kids[]) const {
+    return create(updates, kids[0], width, isLittleEndian);
+  }
+
+  virtual unsigned computeHash();
+
+private:
+  WideReadExpr(const UpdateList &_updates, const ref<Expr> &_index, Width w,
+               bool _isLittleEndian)
+      : updates(_updates), index(_index), width(w),
+        isLittleEndian(_isLittleEndian) {
+    assert(updates.root);
+  }
+
+public:
+  static bool classof(const Expr *E) {
+    return E->getKind() == Expr::WideRead;
+  }
+  static bool classof(const WideReadExpr *) { return true; }
+};
+
+
 /// Class representing an if-then-else expression.
 class SelectExpr : public NonConstantExpr {
 public:
@@ -622,7 +800,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -685,7 +863,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return intern(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -752,7 +930,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -803,7 +981,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -880,7 +1058,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return intern(r);                                          \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -913,7 +1091,7 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return intern(res);                                                      \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Width getWidth() const { return left->getWidth(); }                        \
@@ -962,7 +1140,7 @@ ARITHMETIC_EXPR_CLASS(AShr)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return intern(res);                                                      \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Kind getKind() const { return _class_kind; }                               \
@@ -1064,12 +1242,30 @@ public:
   static ref<Expr> fromMemory(void *address, Width w);
   void toMemory(void *address);
 
-  static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+private:
+  /// Returns the shared constant for \a v, or null if \a v is not small.
+  static ConstantExpr *getSmall(const llvm::APInt &v);
+
+  static ref<ConstantExpr> allocUncached(const llvm::APInt &v) {
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return cast<ConstantExpr>(intern(r));
   }
 
+public:
+
+  static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    // Small values of the common widths are shared, so that concrete
+    // instructions mostly do not allocate their results.
+    if (ConstantExpr *small = getSmall(v))
+      return small;
+    return allocUncached(v);
+  }
+
+  /// Sets \a dst to the constant \a v. A constant only \a dst refers to is
+  /// overwritten in place instead of being replaced by a new node.
+  static void assign(ref<Expr> &dst, const llvm::APInt &v);
+
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
     return alloc(f.bitcastToAPInt());
   }
@@ -89,6 +89,8 @@ class StagedSolverImpl : public SolverImpl {
 private:
   IncompleteSolver *primary;
   Solver *secondary;
+  // whether the last computeInitialValues was answered by the secondary
+  bool secondaryAnswered;
   
 public:
   StagedSolverImpl(IncompleteSolver *_primary, Solver *_secondary);
@@ -97,10 +99,17 @@ public:
   bool computeTruth(const Query&, bool &isValid);
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeValue(const Query&, ref<Expr> &result);
+  bool computeBound(const Query&, bool maximize, ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query&,
+                          const std::vector<const Array*> &objects,
+                          std::vector< std::vector<unsigned char> > &values,
+                          std::vector< std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
   bool computeInitialValues(const Query&,
                             const std::vector<const Array*> &objects,
                             std::vector< std::vector<unsigned char> > &values,
                             bool &hasSolution);
+  bool getUnsatCore(std::vector<ref<Expr> > &core);
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(time::Span timeout);
@@ -0,0 +1,91 @@
+//===-- BranchPath.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BRANCHPATH_H
+#define KLEE_BRANCHPATH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace klee {
+
+  /// BranchPath - A sequence of branch decisions, packed eight to a byte,
+  /// with long stretches of the same decision run length encoded.
+  ///
+  /// It is encoded as records, each a LEB128 header h: if h is odd, it is
+  /// followed by a literal of h >> 1 decisions, lowest bit first; if h is
+  /// even, it stands for a run of h >> 2 decisions which all are
+  /// (h >> 1) & 1.
+  class BranchPath {
+    /// Runs shorter than this go into literals.
+    static const unsigned minRun = 32;
+    /// Literals are ended at this many decisions.
+    static const unsigned maxLiteral = 4096;
+
+    /// The complete records.
+    std::vector<unsigned char> data;
+    /// The decisions after them: the literal being built, then the run.
+    std::vector<unsigned char> literal;
+    unsigned literalSize;
+    bool runValue;
+    std::uint64_t runSize;
+
+    std::uint64_t count;
+
+    void endRun();
+    void appendLiteral(bool decision);
+    void endLiteral();
+    static void appendHeader(std::vector<unsigned char> &out,
+                             std::uint64_t header);
+
+  public:
+    BranchPath();
+
+    void push_back(bool decision);
+
+    /// The number of decisions.
+    std::uint64_t size() const { return count; }
+
+    /// Cursor - Reads the decisions of a path in order, without unpacking
+    /// them. The path must not change while read.
+    class Cursor {
+      const BranchPath *path;
+      size_t position;
+      /// 0 while reading the complete records, 1 for the pending literal,
+      /// 2 for the pending run.
+      unsigned phase;
+      std::uint64_t consumed;
+
+      bool isRun, value;
+      std::uint64_t left;
+      const unsigned char *bits;
+      std::uint64_t bit;
+
+      void load();
+
+    public:
+      Cursor() : path(0), consumed(0) {}
+      explicit Cursor(const BranchPath &path);
+
+      bool atEnd() const { return !path || consumed == path->size(); }
+      bool next();
+    };
+
+    /// Writes the path as read() reads it.
+    void write(std::ostream &os) const;
+
+    /// Reads a path written by write(), returning false if the stream does
+    /// not hold one.
+    static bool read(std::istream &is, BranchPath &path);
+  };
+}
+
+#endif
@@ -0,0 +1,259 @@
+//===-- ChunkedVector.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHUNKEDVECTOR_H
+#define KLEE_CHUNKEDVECTOR_H
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace klee {
+
+/// Sequence of elements kept in reference counted chunks, which copies of
+/// the sequence share. Copying one thus costs a reference count increment
+/// per chunk instead of a copy of every element, and the copies keep
+/// sharing the prefix they had in common at the time.
+///
+/// Appending goes to the last chunk in place while no copy shares it, and
+/// opens a new chunk otherwise. The new chunk takes over the elements of
+/// the chunks before it that are no longer than it, like a binary counter,
+/// so that a sequence which is copied before every append still has a
+/// number of chunks logarithmic in its size and each element is copied a
+/// logarithmic number of times.
+///
+/// Iteration walks the chunks in order, so that it stays a linear scan of
+/// contiguous memory but for one jump per chunk.
+template <class T> class ChunkedVector {
+  /// The elements [begin, end) of the sequence, held in a prefix of chunk.
+  /// The last span is an empty sentinel, whose begin is the size.
+  struct Span {
+    std::shared_ptr<std::vector<T>> chunk;
+    const T *data;
+    size_t begin, end;
+
+    size_t length() const { return end - begin; }
+  };
+
+  llvm::SmallVector<Span, 4> spans;
+
+  Span &sentinel() { return spans.back(); }
+
+  void setSentinel(size_t size) {
+    Span &s = sentinel();
+    s.begin = s.end = size;
+  }
+
+  void pushSpan(std::shared_ptr<std::vector<T>> chunk) {
+    size_t begin = size();
+    const T *data = chunk->data();
+    size_t end = begin + chunk->size();
+    spans.insert(spans.end() - 1, Span{std::move(chunk), data, begin, end});
+    setSentinel(end);
+  }
+
+  /// Returns the span holding the element at \a index.
+  const Span *find(size_t index) const {
+    assert(index < size() && "index out of range");
+    return std::upper_bound(spans.begin(), spans.end() - 1, index,
+                            [](size_t i, const Span &s) { return i < s.end; });
+  }
+
+public:
+  class const_iterator {
+    friend class ChunkedVector;
+
+    /// The span holding the element, or the sentinel at the end.
+    const Span *span;
+    size_t index;
+
+    const_iterator(const Span *span, size_t index)
+        : span(span), index(index) {}
+
+    void seek() {
+      while (index >= span->end && span->length())
+        ++span;
+      while (index < span->begin)
+        --span;
+    }
+
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef const T &reference;
+
+    const_iterator() : span(nullptr), index(0) {}
+
+    reference operator*() const { return span->data[index - span->begin]; }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    const_iterator &operator++() {
+      if (++index == span->end)
+        ++span;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+    const_iterator &operator--() {
+      if (index == span->begin)
+        --span;
+      --index;
+      return *this;
+    }
+    const_iterator operator--(int) {
+      const_iterator old = *this;
+      --*this;
+      return old;
+    }
+
+    const_iterator &operator+=(difference_type n) {
+      index += n;
+      seek();
+      return *this;
+    }
+    const_iterator &operator-=(difference_type n) { return *this += -n; }
+    const_iterator operator+(difference_type n) const {
+      const_iterator i = *this;
+      return i += n;
+    }
+    friend const_iterator operator+(difference_type n, const_iterator i) {
+      return i += n;
+    }
+    const_iterator operator-(difference_type n) const {
+      const_iterator i = *this;
+      return i -= n;
+    }
+    difference_type operator-(const const_iterator &other) const {
+      return difference_type(index) - difference_type(other.index);
+    }
+
+    bool operator==(const const_iterator &o) const { return index == o.index; }
+    bool operator!=(const const_iterator &o) const { return index != o.index; }
+    bool operator<(const const_iterator &o) const { return index < o.index; }
+    bool operator>(const const_iterator &o) const { return index > o.index; }
+    bool operator<=(const const_iterator &o) const { return index <= o.index; }
+    bool operator>=(const const_iterator &o) const { return index >= o.index; }
+  };
+
+  ChunkedVector() { spans.push_back(Span{nullptr, nullptr, 0, 0}); }
+
+  template <class Iterator>
+  ChunkedVector(Iterator first, Iterator last) : ChunkedVector() {
+    assign(first, last);
+  }
+
+  explicit ChunkedVector(const std::vector<T> &elements)
+      : ChunkedVector(elements.begin(), elements.end()) {}
+
+  /// Takes over the storage of \a elements as the only chunk.
+  explicit ChunkedVector(std::vector<T> &&elements) : ChunkedVector() {
+    if (!elements.empty())
+      pushSpan(std::make_shared<std::vector<T>>(std::move(elements)));
+  }
+
+  size_t size() const { return spans.back().begin; }
+  bool empty() const { return size() == 0; }
+
+  /// The number of chunks the elements are spread over.
+  size_t chunks() const { return spans.size() - 1; }
+
+  const_iterator begin() const { return const_iterator(spans.begin(), 0); }
+  const_iterator end() const {
+    return const_iterator(spans.end() - 1, size());
+  }
+
+  const T &operator[](size_t index) const {
+    const Span *s = find(index);
+    return s->data[index - s->begin];
+  }
+
+  const T &back() const {
+    assert(!empty() && "back() of an empty vector");
+    const Span &s = spans[spans.size() - 2];
+    return s.data[s.length() - 1];
+  }
+
+  void clear() {
+    spans.clear();
+    spans.push_back(Span{nullptr, nullptr, 0, 0});
+  }
+
+  template <class Iterator> void assign(Iterator first, Iterator last) {
+    clear();
+    if (first != last)
+      pushSpan(std::make_shared<std::vector<T>>(first, last));
+  }
+
+  void push_back(const T &e) {
+    if (chunks()) {
+      Span &last = spans[spans.size() - 2];
+      if (last.chunk.use_count() == 1) {
+        // chunks only grow while unshared, so nothing follows this span
+        assert(last.length() == last.chunk->size());
+        last.chunk->push_back(e);
+        last.data = last.chunk->data();
+        setSentinel(++last.end);
+        return;
+      }
+    }
+
+    // take over the chunks no longer than the new one
+    size_t length = 1, absorbed = 0;
+    while (absorbed < chunks()) {
+      const Span &s = spans[spans.size() - 2 - absorbed];
+      if (s.length() > length)
+        break;
+      length += s.length();
+      ++absorbed;
+    }
+    auto chunk = std::make_shared<std::vector<T>>();
+    chunk->reserve(length);
+    for (auto s = spans.end() - 1 - absorbed, se = spans.end() - 1; s != se;
+         ++s)
+      chunk->insert(chunk->end(), s->data, s->data + s->length());
+    chunk->push_back(e);
+    spans.erase(spans.end() - 1 - absorbed, spans.end() - 1);
+    setSentinel(chunks() ? spans[spans.size() - 2].end : 0);
+    pushSpan(std::move(chunk));
+  }
+
+  /// Replaces the element at \a index, copying its chunk first if it is
+  /// shared.
+  void set(size_t index, const T &e) {
+    Span &s = spans[find(index) - spans.begin()];
+    if (s.chunk.use_count() != 1) {
+      s.chunk = std::make_shared<std::vector<T>>(s.data, s.data + s.length());
+      s.data = s.chunk->data();
+    }
+    (*s.chunk)[index - s.begin] = e;
+  }
+
+  bool operator==(const ChunkedVector &other) const {
+    return size() == other.size() &&
+           std::equal(begin(), end(), other.begin());
+  }
+  bool operator!=(const ChunkedVector &other) const {
+    return !(*this == other);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_CHUNKEDVECTOR_H */
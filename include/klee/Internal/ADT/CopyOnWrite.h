@@ -0,0 +1,67 @@
+//===-- CopyOnWrite.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COPYONWRITE_H
+#define KLEE_COPYONWRITE_H
+
+#include <memory>
+
+namespace klee {
+
+  /// CopyOnWrite - A value which is shared by all copies of the holder
+  /// until one of them modifies it through mutate().
+  ///
+  /// An empty holder does not allocate, and reads as a default constructed
+  /// value.
+  template <class T>
+  class CopyOnWrite {
+    std::shared_ptr<T> value;
+
+    static const T &empty() {
+      static const T e;
+      return e;
+    }
+
+  public:
+    const T &operator*() const { return value ? *value : empty(); }
+    const T *operator->() const { return &**this; }
+
+    /// mutate - Return the value for modification, copying it first if it is
+    /// shared with another holder.
+    T &mutate() {
+      if (!value)
+        value = std::make_shared<T>();
+      else if (value.use_count() != 1)
+        value = std::make_shared<T>(*value);
+      return *value;
+    }
+
+    /// mutate - As above, but a shared value is copied as copy(value)
+    /// returns, which may leave out what the copy will not need.
+    template <class Copy> T &mutate(Copy copy) {
+      if (!value)
+        value = std::make_shared<T>();
+      else if (value.use_count() != 1)
+        value = std::make_shared<T>(copy(const_cast<const T &>(*value)));
+      return *value;
+    }
+
+    /// reset - Drop the value, leaving this holder empty.
+    void reset() { value.reset(); }
+
+    /// getIdentity - An address shared by exactly the holders which share
+    /// their value, or null if empty.
+    const void *getIdentity() const { return value.get(); }
+
+    /// isShared - Whether another holder shares the value.
+    bool isShared() const { return value.use_count() > 1; }
+  };
+}
+
+#endif
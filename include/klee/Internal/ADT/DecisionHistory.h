@@ -0,0 +1,79 @@
+//===-- DecisionHistory.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_DECISIONHISTORY_H
+#define KLEE_DECISIONHISTORY_H
+
+namespace klee {
+
+  /// DecisionHistory - The sequence of branch decisions taken by a state,
+  /// stored as a persistent list which shares the common prefix with the
+  /// histories of the states it was forked from and into. Copying and
+  /// appending are O(1).
+  class DecisionHistory {
+  public:
+    class Node {
+      friend class DecisionHistory;
+
+      unsigned refCount;
+      unsigned decision;
+      const Node *parent;
+
+      Node(unsigned decision, const Node *parent)
+          : refCount(1), decision(decision), parent(parent) {}
+
+    public:
+      unsigned getDecision() const { return decision; }
+      /// getParent - The node of the previous decision, or null for the
+      /// first one.
+      const Node *getParent() const { return parent; }
+    };
+
+  private:
+    const Node *last;
+
+    static void retain(const Node *n) {
+      if (n)
+        ++const_cast<Node *>(n)->refCount;
+    }
+
+    // Release iteratively, histories can be very long.
+    static void release(const Node *n) {
+      while (n && --const_cast<Node *>(n)->refCount == 0) {
+        const Node *parent = n->parent;
+        delete n;
+        n = parent;
+      }
+    }
+
+  public:
+    DecisionHistory() : last(0) {}
+    DecisionHistory(const DecisionHistory &b) : last(b.last) { retain(last); }
+    ~DecisionHistory() { release(last); }
+
+    DecisionHistory &operator=(const DecisionHistory &b) {
+      retain(b.last);
+      release(last);
+      last = b.last;
+      return *this;
+    }
+
+    bool empty() const { return !last; }
+
+    /// append - Record \a decision after all previous ones. The new node
+    /// takes over the reference to the previous last node.
+    void append(unsigned decision) { last = new Node(decision, last); }
+
+    /// getLast - The node of the most recent decision, or null if there is
+    /// none. Histories with the same node share all their decisions.
+    const Node *getLast() const { return last; }
+  };
+}
+
+#endif
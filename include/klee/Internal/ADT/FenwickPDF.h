@@ -0,0 +1,69 @@
+//===-- FenwickPDF.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FENWICKPDF_H
+#define KLEE_FENWICKPDF_H
+
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  /// A discrete distribution over items, as DiscretePDF, kept in arrays:
+  /// the weights, and a Fenwick tree of their prefix sums.
+  ///
+  /// Updated weights are applied lazily, when an item is chosen next.
+  /// Then each is added up the tree, or the tree is rebuilt in linear time
+  /// if that is cheaper, so that reweighting all items, as updateAll()
+  /// does, costs O(n) instead of O(n log n).
+  template <class T>
+  class FenwickPDF {
+    typedef double weight_type;
+
+    std::vector<T> items;
+    /// The weights of the items, and those the tree was computed from.
+    std::vector<weight_type> weights, applied;
+    /// The Fenwick tree, where entry i is the sum of the applied weights
+    /// of the items ending with the i-th, as many as the lowest bit of i.
+    std::vector<weight_type> tree;
+    std::unordered_map<T, unsigned> indices;
+
+    /// The items whose weights were updated but not applied, possibly
+    /// with duplicates and removed items.
+    std::vector<T> pending;
+    /// The number of updates added up the tree since it was built, to
+    /// bound the rounding errors they accumulate.
+    unsigned added = 0;
+
+    void add(unsigned index, weight_type delta);
+    weight_type prefix(unsigned count) const;
+    void rebuild();
+    void flush();
+
+  public:
+    bool empty() const { return items.empty(); }
+    unsigned size() const { return items.size(); }
+    void insert(T item, weight_type weight);
+    void update(T item, weight_type newWeight);
+    void remove(T item);
+    bool inTree(T item) const { return indices.count(item); }
+    weight_type getWeight(T item) const;
+
+    /// Sets the weight of every item to \a weigh(item).
+    template <class F> void updateAll(F weigh);
+
+    /* pick an element according to its
+     * weight. p should be in [0,1).
+     */
+    T choose(double p);
+  };
+}
+
+#include "FenwickPDF.inc"
+
+#endif
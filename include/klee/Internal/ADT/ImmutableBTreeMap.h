@@ -0,0 +1,667 @@
+//===-- ImmutableBTreeMap.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLEBTREEMAP_H
+#define KLEE_IMMUTABLEBTREEMAP_H
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+
+namespace klee {
+
+/// Persistent ordered map with the same interface as ImmutableMap, built on
+/// a B+-tree with `B` entries per node instead of a binary tree.
+///
+/// Updates copy the path from the root to the modified leaf and share all
+/// other nodes with the original map, so copies are as cheap as for
+/// ImmutableMap. Entries are stored contiguously in the leaves though, so
+/// lookups touch a handful of cache lines rather than one node per level of
+/// a binary tree.
+///
+/// K and D must be default constructible.
+template <class K, class D, class CMP = std::less<K>, unsigned B = 16>
+class ImmutableBTreeMap {
+  static_assert(B >= 4, "fan-out too small");
+
+public:
+  typedef K key_type;
+  typedef std::pair<K, D> value_type;
+  class iterator;
+
+  static size_t allocated;
+
+private:
+  struct Leaf;
+  struct Inner;
+
+  struct KeyLess {
+    bool operator()(const value_type &a, const K &b) const {
+      return CMP()(a.first, b);
+    }
+    bool operator()(const K &a, const value_type &b) const {
+      return CMP()(a, b.first);
+    }
+  };
+
+  struct Node {
+    unsigned references;
+    unsigned count;
+    bool isLeaf;
+
+    explicit Node(bool _isLeaf) : references(1), count(0), isLeaf(_isLeaf) {
+      ++allocated;
+    }
+    ~Node() { --allocated; }
+
+    Leaf *asLeaf() {
+      assert(isLeaf);
+      return static_cast<Leaf *>(this);
+    }
+    const Leaf *asLeaf() const {
+      assert(isLeaf);
+      return static_cast<const Leaf *>(this);
+    }
+    Inner *asInner() {
+      assert(!isLeaf);
+      return static_cast<Inner *>(this);
+    }
+    const Inner *asInner() const {
+      assert(!isLeaf);
+      return static_cast<const Inner *>(this);
+    }
+
+    Node *incref() {
+      ++references;
+      return this;
+    }
+    void decref() {
+      if (--references)
+        return;
+      if (isLeaf)
+        delete asLeaf();
+      else
+        delete asInner();
+    }
+
+    const K &minKey() const {
+      const Node *n = this;
+      while (!n->isLeaf)
+        n = n->asInner()->children[0];
+      return n->asLeaf()->values[0].first;
+    }
+
+    /// Empty node of the same kind.
+    Node *createEmpty() const {
+      if (isLeaf)
+        return new Leaf();
+      return new Inner();
+    }
+
+    /// Copy of this node.
+    Node *clone() const {
+      Node *n = createEmpty();
+      for (unsigned i = 0; i < count; ++i)
+        n->appendFrom(this, i);
+      return n;
+    }
+
+    /// Append entry (or child) `i` of `b`.
+    void appendFrom(const Node *b, unsigned i) {
+      if (isLeaf) {
+        asLeaf()->values[count++] = b->asLeaf()->values[i];
+      } else {
+        Inner *in = asInner();
+        in->keys[count] = b->asInner()->keys[i];
+        in->children[count++] = b->asInner()->children[i]->incref();
+      }
+    }
+  };
+
+  struct Leaf : Node {
+    value_type values[B];
+
+    Leaf() : Node(true) {}
+
+    unsigned lowerBound(const K &key) const {
+      return std::lower_bound(values, values + this->count, key, KeyLess()) -
+             values;
+    }
+    unsigned upperBound(const K &key) const {
+      return std::upper_bound(values, values + this->count, key, KeyLess()) -
+             values;
+    }
+
+    void insertAt(unsigned pos, const value_type &value) {
+      assert(this->count < B);
+      std::copy_backward(values + pos, values + this->count,
+                         values + this->count + 1);
+      values[pos] = value;
+      ++this->count;
+    }
+  };
+
+  struct Inner : Node {
+    /// Minimum key of each child, kept contiguous for fast search.
+    K keys[B];
+    Node *children[B];
+
+    Inner() : Node(false) {}
+    ~Inner() {
+      for (unsigned i = 0; i < this->count; ++i)
+        children[i]->decref();
+    }
+
+    /// Index of the child that may hold `key`: the last child whose minimum
+    /// key is not greater than `key`, or the first child.
+    unsigned childFor(const K &key) const {
+      return std::upper_bound(keys + 1, keys + this->count, key, CMP()) -
+             keys - 1;
+    }
+
+    /// Appends `child`, taking over the reference.
+    void append(Node *child) {
+      assert(this->count < B);
+      keys[this->count] = child->minKey();
+      children[this->count++] = child;
+    }
+
+    /// Inserts `child` at `pos`, taking over the reference.
+    void insertAt(unsigned pos, Node *child) {
+      assert(this->count < B);
+      std::copy_backward(keys + pos, keys + this->count,
+                         keys + this->count + 1);
+      std::copy_backward(children + pos, children + this->count,
+                         children + this->count + 1);
+      keys[pos] = child->minKey();
+      children[pos] = child;
+      ++this->count;
+    }
+  };
+
+  static const unsigned MaxDepth = 24;
+
+  Node *root;
+  size_t numElements;
+
+  ImmutableBTreeMap(Node *_root, size_t _numElements)
+      : root(_root), numElements(_numElements) {}
+
+  static bool equal(const K &a, const K &b) {
+    return !CMP()(a, b) && !CMP()(b, a);
+  }
+
+  /// Moves the upper half of the full node `n` into a new node, which is
+  /// returned.
+  static Node *splitHalf(Node *n) {
+    Node *upper = n->createEmpty();
+    unsigned half = n->count / 2;
+    for (unsigned i = half; i < n->count; ++i)
+      upper->appendFrom(n, i);
+    for (unsigned i = half; i < n->count; ++i) {
+      // Drop the references held by the moved entries.
+      if (n->isLeaf)
+        n->asLeaf()->values[i] = value_type();
+      else
+        n->asInner()->children[i]->decref();
+    }
+    n->count = half;
+    return upper;
+  }
+
+  /// Returns a new version of `n` with `value` added (or replaced if
+  /// `replace` is set), or null if `n` is unchanged. If the new node had to
+  /// be split, its upper half is returned in `split`.
+  static Node *insert(const Node *n, const value_type &value, bool replace,
+                      Node *&split, bool &added) {
+    split = nullptr;
+    if (n->isLeaf) {
+      const Leaf *leaf = n->asLeaf();
+      unsigned pos = leaf->lowerBound(value.first);
+      if (pos < leaf->count && equal(leaf->values[pos].first, value.first)) {
+        if (!replace)
+          return nullptr;
+        Leaf *res = leaf->clone()->asLeaf();
+        res->values[pos] = value;
+        return res;
+      }
+      added = true;
+      Leaf *res = leaf->clone()->asLeaf();
+      if (res->count == B) {
+        split = splitHalf(res);
+        if (pos > res->count) {
+          split->asLeaf()->insertAt(pos - res->count, value);
+          return res;
+        }
+      }
+      res->insertAt(pos, value);
+      return res;
+    }
+
+    const Inner *inner = n->asInner();
+    unsigned idx = inner->childFor(value.first);
+    Node *childSplit;
+    Node *child =
+        insert(inner->children[idx], value, replace, childSplit, added);
+    if (!child)
+      return nullptr;
+
+    Inner *res = inner->clone()->asInner();
+    res->children[idx]->decref();
+    res->children[idx] = child;
+    res->keys[idx] = child->minKey();
+    if (childSplit) {
+      Inner *target = res;
+      unsigned pos = idx + 1;
+      if (res->count == B) {
+        split = splitHalf(res);
+        if (pos > res->count) {
+          target = split->asInner();
+          pos -= res->count;
+        }
+      }
+      target->insertAt(pos, childSplit);
+    }
+    return res;
+  }
+
+  /// Returns a new version of `n` without `key`, or null if `key` is not in
+  /// `n`. The result may be underfull, or even empty.
+  static Node *remove(const Node *n, const K &key) {
+    if (n->isLeaf) {
+      const Leaf *leaf = n->asLeaf();
+      unsigned pos = leaf->lowerBound(key);
+      if (pos == leaf->count || !equal(leaf->values[pos].first, key))
+        return nullptr;
+      Leaf *res = new Leaf();
+      for (unsigned i = 0; i < leaf->count; ++i)
+        if (i != pos)
+          res->appendFrom(leaf, i);
+      return res;
+    }
+
+    const Inner *inner = n->asInner();
+    unsigned idx = inner->childFor(key);
+    Node *child = remove(inner->children[idx], key);
+    if (!child)
+      return nullptr;
+
+    Inner *res = new Inner();
+    if (child->count >= B / 2 || inner->count == 1) {
+      for (unsigned i = 0; i < idx; ++i)
+        res->appendFrom(inner, i);
+      if (child->count)
+        res->append(child);
+      else
+        child->decref();
+      for (unsigned i = idx + 1; i < inner->count; ++i)
+        res->appendFrom(inner, i);
+      return res;
+    }
+
+    // The child is underfull: rebalance it with a sibling, merging both into
+    // a single node if they fit.
+    unsigned lo = idx + 1 < inner->count ? idx : idx - 1;
+    const Node *a = lo == idx ? child : inner->children[lo];
+    const Node *b = lo == idx ? inner->children[lo + 1] : child;
+    unsigned total = a->count + b->count;
+    unsigned lowerCount = total <= B ? total : total / 2;
+    Node *lower = child->createEmpty(), *upper = nullptr;
+    if (total > B)
+      upper = child->createEmpty();
+    for (unsigned i = 0; i < total; ++i) {
+      Node *target = i < lowerCount ? lower : upper;
+      if (i < a->count)
+        target->appendFrom(a, i);
+      else
+        target->appendFrom(b, i - a->count);
+    }
+    child->decref();
+
+    for (unsigned i = 0; i < lo; ++i)
+      res->appendFrom(inner, i);
+    res->append(lower);
+    if (upper)
+      res->append(upper);
+    for (unsigned i = lo + 2; i < inner->count; ++i)
+      res->appendFrom(inner, i);
+    return res;
+  }
+
+public:
+  ImmutableBTreeMap() : root(nullptr), numElements(0) {}
+  ImmutableBTreeMap(const ImmutableBTreeMap &b)
+      : root(b.root ? b.root->incref() : nullptr),
+        numElements(b.numElements) {}
+  ~ImmutableBTreeMap() {
+    if (root)
+      root->decref();
+  }
+
+  ImmutableBTreeMap &operator=(const ImmutableBTreeMap &b) {
+    if (b.root)
+      b.root->incref();
+    if (root)
+      root->decref();
+    root = b.root;
+    numElements = b.numElements;
+    return *this;
+  }
+
+  bool empty() const { return numElements == 0; }
+  size_t size() const { return numElements; }
+  size_t count(const key_type &key) const { return lookup(key) ? 1 : 0; }
+
+  const value_type *lookup(const key_type &key) const {
+    const value_type *res = lookup_previous(key);
+    return res && equal(res->first, key) ? res : nullptr;
+  }
+
+  /// Find the last value less than or equal to key, or null if no such value
+  /// exists.
+  const value_type *lookup_previous(const key_type &key) const {
+    const Node *n = root;
+    if (!n)
+      return nullptr;
+    while (!n->isLeaf) {
+      const Inner *inner = n->asInner();
+      unsigned idx = inner->childFor(key);
+      if (idx == 0 && CMP()(key, inner->keys[0]))
+        return nullptr;
+      n = inner->children[idx];
+    }
+    const Leaf *leaf = n->asLeaf();
+    unsigned pos = leaf->upperBound(key);
+    return pos ? &leaf->values[pos - 1] : nullptr;
+  }
+
+  const value_type &min() const { return *begin(); }
+  const value_type &max() const { return *--end(); }
+
+  ImmutableBTreeMap insert(const value_type &value) const {
+    return update(value, false);
+  }
+  ImmutableBTreeMap replace(const value_type &value) const {
+    return update(value, true);
+  }
+
+  ImmutableBTreeMap remove(const key_type &key) const {
+    if (!root)
+      return *this;
+    Node *n = remove(root, key);
+    if (!n)
+      return *this;
+    // Shrink the tree when the root is left with a single child.
+    while (!n->isLeaf && n->count == 1) {
+      Node *child = n->asInner()->children[0]->incref();
+      n->decref();
+      n = child;
+    }
+    if (n->count == 0) {
+      n->decref();
+      n = nullptr;
+    }
+    return ImmutableBTreeMap(n, numElements - 1);
+  }
+
+  ImmutableBTreeMap popMin(value_type &valueOut) const {
+    valueOut = min();
+    return remove(valueOut.first);
+  }
+  ImmutableBTreeMap popMax(value_type &valueOut) const {
+    valueOut = max();
+    return remove(valueOut.first);
+  }
+
+  iterator begin() const {
+    iterator it(root);
+    if (root)
+      it.descend(root, true);
+    return it;
+  }
+  iterator end() const { return iterator(root); }
+
+  iterator find(const key_type &key) const {
+    iterator it = lower_bound(key);
+    if (it != end() && equal(it->first, key))
+      return it;
+    return end();
+  }
+
+  iterator lower_bound(const key_type &key) const {
+    return bound(key, false);
+  }
+  iterator upper_bound(const key_type &key) const {
+    return bound(key, true);
+  }
+
+  static size_t getAllocated() { return allocated; }
+
+  /// Calls \a f(node, bytes, exclusive, values, count) on the nodes of the
+  /// tree, where exclusive tells whether no other map shares the node, and
+  /// values and count are the entries of a leaf (null for inner nodes).
+  /// The nodes below one are only visited if \a f returns true for it.
+  template <class F> void forEachNode(F f) const {
+    if (root)
+      visit(root, true, f);
+  }
+
+  /// Calls \a f(a, b) on the entries of this map and \a b at the same
+  /// position, in order, except those in the subtrees the two maps share,
+  /// until \a f returns false. The cost is that of the entries outside the
+  /// shared subtrees. Returns false if \a f does, or if the maps differ in
+  /// size.
+  template <class F>
+  bool forEachUnshared(const ImmutableBTreeMap &b, F f) const {
+    if (numElements != b.numElements)
+      return false;
+    if (root == b.root)
+      return true;
+    iterator ia = begin(), ib = b.begin();
+    while (ia.depth && ib.depth) {
+      if (!ia.skipShared(ib)) {
+        if (!f(*ia, *ib))
+          return false;
+        ++ia;
+        ++ib;
+      }
+    }
+    return true;
+  }
+
+private:
+  template <class F> static void visit(const Node *n, bool exclusive, F &f) {
+    exclusive = exclusive && n->references == 1;
+    if (n->isLeaf) {
+      f(static_cast<const void *>(n), sizeof(Leaf), exclusive,
+        n->asLeaf()->values, n->count);
+      return;
+    }
+    if (!f(static_cast<const void *>(n), sizeof(Inner), exclusive,
+           (const value_type *)nullptr, 0u))
+      return;
+    for (unsigned i = 0; i < n->count; ++i)
+      visit(n->asInner()->children[i], exclusive, f);
+  }
+
+  ImmutableBTreeMap update(const value_type &value, bool replace) const {
+    if (!root) {
+      Leaf *n = new Leaf();
+      n->insertAt(0, value);
+      return ImmutableBTreeMap(n, 1);
+    }
+    Node *split;
+    bool added = false;
+    Node *n = insert(root, value, replace, split, added);
+    if (!n)
+      return *this;
+    if (split) {
+      Inner *newRoot = new Inner();
+      newRoot->append(n);
+      newRoot->append(split);
+      n = newRoot;
+    }
+    return ImmutableBTreeMap(n, numElements + (added ? 1 : 0));
+  }
+
+  iterator bound(const key_type &key, bool upper) const {
+    iterator it(root);
+    if (!root)
+      return it;
+    Node *n = root;
+    while (!n->isLeaf) {
+      unsigned idx = n->asInner()->childFor(key);
+      it.push(n, idx);
+      n = n->asInner()->children[idx];
+    }
+    Leaf *leaf = n->asLeaf();
+    unsigned pos = upper ? leaf->upperBound(key) : leaf->lowerBound(key);
+    if (pos < leaf->count) {
+      it.push(leaf, pos);
+    } else {
+      it.push(leaf, leaf->count - 1);
+      ++it;
+    }
+    return it;
+  }
+
+public:
+  class iterator {
+    friend class ImmutableBTreeMap;
+
+    Node *root; // so can back up from end
+    Node *nodes[MaxDepth];
+    unsigned positions[MaxDepth];
+    unsigned depth;
+
+    explicit iterator(Node *_root)
+        : root(_root ? _root->incref() : nullptr), depth(0) {}
+
+    void push(Node *n, unsigned pos) {
+      assert(depth < MaxDepth && "tree too deep");
+      nodes[depth] = n;
+      positions[depth++] = pos;
+    }
+
+    /// Moves past the outermost subtree which starts at the current entry
+    /// in both this iterator and `b`, if there is one. A shared node has
+    /// the same height in both trees.
+    bool skipShared(iterator &b) {
+      unsigned lowest = depth;
+      while (lowest && positions[lowest - 1] == 0)
+        --lowest;
+      unsigned lowestB = b.depth;
+      while (lowestB && b.positions[lowestB - 1] == 0)
+        --lowestB;
+      for (unsigned i = lowest; i < depth; ++i) {
+        unsigned j = i + b.depth - depth;
+        if (j < lowestB || j >= b.depth || nodes[i] != b.nodes[j])
+          continue;
+        skip(i);
+        b.skip(j);
+        return true;
+      }
+      return false;
+    }
+
+    /// Moves past the subtree `nodes[level]`, which starts at the current
+    /// entry.
+    void skip(unsigned level) {
+      depth = level;
+      while (depth && positions[depth - 1] + 1 == nodes[depth - 1]->count)
+        --depth;
+      if (depth) {
+        unsigned pos = ++positions[depth - 1];
+        Node *n = nodes[depth - 1];
+        if (!n->isLeaf)
+          descend(n->asInner()->children[pos], true);
+      }
+    }
+
+    /// Descend from `n` to its first (or last) entry.
+    void descend(Node *n, bool first) {
+      for (;;) {
+        unsigned pos = first ? 0 : n->count - 1;
+        push(n, pos);
+        if (n->isLeaf)
+          break;
+        n = n->asInner()->children[pos];
+      }
+    }
+
+  public:
+    iterator(const iterator &b) : root(b.root ? b.root->incref() : nullptr),
+                                  depth(b.depth) {
+      std::copy(b.nodes, b.nodes + depth, nodes);
+      std::copy(b.positions, b.positions + depth, positions);
+    }
+    ~iterator() {
+      if (root)
+        root->decref();
+    }
+
+    iterator &operator=(const iterator &b) {
+      if (b.root)
+        b.root->incref();
+      if (root)
+        root->decref();
+      root = b.root;
+      depth = b.depth;
+      std::copy(b.nodes, b.nodes + depth, nodes);
+      std::copy(b.positions, b.positions + depth, positions);
+      return *this;
+    }
+
+    const value_type &operator*() const {
+      assert(depth && "dereferencing end iterator");
+      return nodes[depth - 1]->asLeaf()->values[positions[depth - 1]];
+    }
+    const value_type *operator->() const { return &**this; }
+
+    bool operator==(const iterator &b) const {
+      if (depth != b.depth)
+        return false;
+      return !depth || (nodes[depth - 1] == b.nodes[depth - 1] &&
+                        positions[depth - 1] == b.positions[depth - 1]);
+    }
+    bool operator!=(const iterator &b) const { return !(*this == b); }
+
+    iterator &operator++() {
+      assert(depth && "incrementing end iterator");
+      // past the entry, as if it were a subtree below the leaf
+      skip(depth);
+      return *this;
+    }
+
+    iterator &operator--() {
+      if (!depth) {
+        if (root)
+          descend(root, false);
+        return *this;
+      }
+      while (depth && positions[depth - 1] == 0)
+        --depth;
+      if (depth) {
+        unsigned pos = --positions[depth - 1];
+        Node *n = nodes[depth - 1];
+        if (!n->isLeaf)
+          descend(n->asInner()->children[pos], false);
+      }
+      return *this;
+    }
+  };
+};
+
+template <class K, class D, class CMP, unsigned B>
+size_t ImmutableBTreeMap<K, D, CMP, B>::allocated = 0;
+
+} // End klee namespace
+
+#endif /* KLEE_IMMUTABLEBTREEMAP_H */
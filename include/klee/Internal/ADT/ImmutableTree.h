@@ -11,6 +11,7 @@
 #define __UTIL_IMMUTABLETREE_H__
 
 #include <cassert>
+#include <cstddef>
 #include <vector>
 
 namespace klee {
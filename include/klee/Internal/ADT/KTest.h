@@ -55,6 +55,42 @@ extern "C" {
 
   void  kTest_free(KTest *);
 
+
+  /* A .ktests container holds many test cases in one append-only file.
+     Object names are stored once and referenced by the tests, and each test
+     may be compressed. A container cut short by a crash keeps all of its
+     complete tests. */
+  typedef struct KTestWriter KTestWriter;
+  typedef struct KTestReader KTestReader;
+
+  /* return true iff file at path matches the container header */
+  int   kTest_isKTestContainer(const char *path);
+
+  /* opens a container for appending, creating it if needed and dropping a
+     torn last record; compress is ignored without zlib. returns NULL on
+     (unspecified) error */
+  KTestWriter* kTestWriter_open(const char *path, int compress);
+
+  /* returns 1 on success, 0 on (unspecified) error */
+  int   kTestWriter_append(KTestWriter *, KTest *, unsigned id);
+
+  void  kTestWriter_close(KTestWriter *);
+
+  /* maps a container for reading, returns NULL on (unspecified) error */
+  KTestReader* kTestReader_open(const char *path);
+
+  unsigned kTestReader_numTests(KTestReader *);
+
+  /* returns the id the test was appended with */
+  unsigned kTestReader_getId(KTestReader *, unsigned index);
+
+  /* returns NULL on (unspecified) error. The test is owned by the reader
+     and its names and bytes point into the mapped file: it must not be
+     passed to kTest_free, and stays valid until kTestReader_close. */
+  KTest* kTestReader_get(KTestReader *, unsigned index);
+
+  void  kTestReader_close(KTestReader *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,312 @@
+//===-- PagedArray.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAGEDARRAY_H
+#define KLEE_PAGEDARRAY_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace klee {
+
+/// Fixed-size array split into reference counted pages that are shared
+/// between copies and copied lazily on the first write through a copy.
+///
+/// Copying a PagedArray thus costs one reference count increment per page,
+/// and writing one element after a copy duplicates only the page holding
+/// it, which matters for large objects in states that keep forking.
+///
+/// Pages that were never written are left unallocated and read as the fill
+/// value given on construction.
+template <typename T, unsigned PageElements = 4096 / sizeof(T)>
+class PagedArray {
+  static_assert((PageElements & (PageElements - 1)) == 0,
+                "page size must be a power of two");
+
+  struct Page {
+    unsigned refCount;
+    unsigned count;
+
+    T *data() { return reinterpret_cast<T *>(this + 1); }
+  };
+  static_assert(sizeof(Page) % alignof(T) == 0, "misaligned page contents");
+
+  /// Pages covering the array; the last one may be partial. Arrays smaller
+  /// than a page, the common case, need no extra allocation for this vector.
+  llvm::SmallVector<Page *, 1> pages;
+  T fill;
+  unsigned size;
+
+  unsigned pageCount(unsigned index) const {
+    unsigned rest = size - index * PageElements;
+    return rest < PageElements ? rest : PageElements;
+  }
+
+  Page *createPage(unsigned count, T *src) const {
+    void *mem = ::operator new(sizeof(Page) + count * sizeof(T));
+    Page *p = new (mem) Page;
+    p->refCount = 1;
+    p->count = count;
+    T *data = p->data();
+    for (unsigned i = 0; i < count; i++)
+      new (data + i) T(src ? src[i] : fill);
+    return p;
+  }
+
+  static void release(Page *p) {
+    if (!p || --p->refCount)
+      return;
+    T *data = p->data();
+    for (unsigned i = 0; i < p->count; i++)
+      data[i].~T();
+    ::operator delete(p);
+  }
+
+  /// Returns the page holding `index`, making sure it is exclusively owned.
+  Page *getWritablePage(unsigned index) {
+    Page *&p = pages[index / PageElements];
+    if (!p) {
+      p = createPage(pageCount(index / PageElements), nullptr);
+    } else if (p->refCount > 1) {
+      Page *copy = createPage(p->count, p->data());
+      --p->refCount;
+      p = copy;
+    }
+    return p;
+  }
+
+public:
+  PagedArray(unsigned _size, const T &_fill = T())
+      : pages((_size + PageElements - 1) / PageElements, nullptr),
+        fill(_fill), size(_size) {}
+
+  PagedArray(const PagedArray &b) : pages(b.pages), fill(b.fill),
+                                    size(b.size) {
+    for (Page *p : pages)
+      if (p)
+        ++p->refCount;
+  }
+
+  /// Shares the pages of `b`, releasing those held so far.
+  PagedArray &operator=(const PagedArray &b) {
+    PagedArray copy(b);
+    std::swap(pages, copy.pages);
+    std::swap(fill, copy.fill);
+    std::swap(size, copy.size);
+    return *this;
+  }
+
+  ~PagedArray() {
+    for (Page *p : pages)
+      release(p);
+  }
+
+  unsigned getSize() const { return size; }
+
+  /// Calls \a f(page, bytes, exclusive) on each allocated page, where
+  /// exclusive tells whether no other copy shares it.
+  template <class F> void forEachPage(F f) const {
+    for (Page *p : pages)
+      if (p)
+        f(static_cast<const void *>(p), sizeof(Page) + p->count * sizeof(T),
+          p->refCount == 1);
+  }
+
+  const T &get(unsigned index) const {
+    assert(index < size && "out of bounds access");
+    Page *p = pages[index / PageElements];
+    return p ? p->data()[index & (PageElements - 1)] : fill;
+  }
+
+  /// Returns a mutable reference to the element at `index`, copying its page
+  /// first if it is shared.
+  T &getMutable(unsigned index) {
+    assert(index < size && "out of bounds access");
+    return getWritablePage(index)->data()[index & (PageElements - 1)];
+  }
+
+  void set(unsigned index, const T &value) { getMutable(index) = value; }
+
+  /// Sets every element to `value`, releasing all pages.
+  void reset(const T &value) {
+    for (Page *&p : pages) {
+      release(p);
+      p = nullptr;
+    }
+    fill = value;
+  }
+
+  /// Copies the `count` elements starting at `begin` to `dst`.
+  void copyTo(unsigned begin, unsigned count, T *dst) const {
+    assert(begin + count <= size && "out of bounds access");
+    while (count) {
+      unsigned offset = begin & (PageElements - 1);
+      unsigned n = PageElements - offset < count ? PageElements - offset : count;
+      Page *p = pages[begin / PageElements];
+      if (p)
+        std::copy(p->data() + offset, p->data() + offset + n, dst);
+      else
+        std::fill(dst, dst + n, fill);
+      begin += n;
+      dst += n;
+      count -= n;
+    }
+  }
+
+  /// Copies `count` elements from `src` to the elements starting at `begin`.
+  void copyFrom(unsigned begin, unsigned count, const T *src) {
+    assert(begin + count <= size && "out of bounds access");
+    while (count) {
+      unsigned offset = begin & (PageElements - 1);
+      unsigned n = PageElements - offset < count ? PageElements - offset : count;
+      std::copy(src, src + n, getWritablePage(begin)->data() + offset);
+      begin += n;
+      src += n;
+      count -= n;
+    }
+  }
+
+  /// Copies all elements to `dst`.
+  void copyTo(T *dst) const {
+    for (unsigned i = 0, e = pages.size(); i != e; ++i, dst += PageElements) {
+      Page *p = pages[i];
+      for (unsigned j = 0, n = pageCount(i); j != n; ++j)
+        dst[j] = p ? p->data()[j] : fill;
+    }
+  }
+
+  /// Copies to `dst` the pages which differ from those of `base`, a copy of
+  /// this array taken when `dst` last held the same elements. A page still
+  /// shared with `base` was not written since, as writes copy shared pages
+  /// first, so `dst` holds it already.
+  void copyChangedTo(const PagedArray &base, T *dst) const {
+    assert(base.size == size && "copy of a different array");
+    for (unsigned i = 0, e = pages.size(); i != e; ++i, dst += PageElements) {
+      Page *p = pages[i];
+      if (p == base.pages[i] && (p || fill == base.fill))
+        continue;
+      for (unsigned j = 0, n = pageCount(i); j != n; ++j)
+        dst[j] = p ? p->data()[j] : fill;
+    }
+  }
+
+  /// Returns true if the elements are equal to the ones in `src`.
+  bool equals(const T *src) const {
+    for (unsigned i = 0, e = pages.size(); i != e; ++i, src += PageElements) {
+      Page *p = pages[i];
+      for (unsigned j = 0, n = pageCount(i); j != n; ++j)
+        if (!(src[j] == (p ? p->data()[j] : fill)))
+          return false;
+    }
+    return true;
+  }
+
+  /// Copies all elements from `src`. Only pages whose contents actually
+  /// change are written, so unchanged pages stay shared.
+  void copyFrom(const T *src) {
+    for (unsigned i = 0, e = pages.size(); i != e; ++i, src += PageElements) {
+      Page *p = pages[i];
+      unsigned n = pageCount(i), j = 0;
+      while (j != n && src[j] == (p ? p->data()[j] : fill))
+        ++j;
+      if (j == n)
+        continue;
+      T *data = getWritablePage(i * PageElements)->data();
+      for (; j != n; ++j)
+        data[j] = src[j];
+    }
+  }
+};
+
+/// Bit array with the same copy-on-write page sharing as PagedArray.
+class PagedBitArray {
+  PagedArray<uint32_t> words;
+
+  static unsigned length(unsigned size) { return (size + 31) / 32; }
+
+public:
+  PagedBitArray(unsigned size, bool value = false)
+      : words(length(size), value ? 0xFFFFFFFF : 0) {}
+
+  template <class F> void forEachPage(F f) const { words.forEachPage(f); }
+
+  bool get(unsigned idx) const {
+    return (bool)((words.get(idx / 32) >> (idx & 0x1F)) & 1);
+  }
+  void set(unsigned idx) {
+    if (!get(idx))
+      words.getMutable(idx / 32) |= 1 << (idx & 0x1F);
+  }
+  void unset(unsigned idx) {
+    if (get(idx))
+      words.getMutable(idx / 32) &= ~(1 << (idx & 0x1F));
+  }
+  void set(unsigned idx, bool value) {
+    if (value)
+      set(idx);
+    else
+      unset(idx);
+  }
+
+  /// Sets the bits in [begin, end) to `value`, a word at a time. Words that
+  /// do not change are not written, so their pages stay shared.
+  void set(unsigned begin, unsigned end, bool value) {
+    for (unsigned w = begin / 32; begin < end; ++w, begin = w * 32) {
+      uint32_t mask = wordMask(begin, end);
+      uint32_t word = words.get(w);
+      uint32_t updated = value ? word | mask : word & ~mask;
+      if (updated != word)
+        words.getMutable(w) = updated;
+    }
+  }
+
+  /// Returns the index of the first bit in [begin, end) that equals `value`,
+  /// or `end` if there is none. Scans a word at a time.
+  unsigned findNext(unsigned begin, unsigned end, bool value) const {
+    for (unsigned w = begin / 32; begin < end; ++w, begin = w * 32) {
+      uint32_t word = words.get(w);
+      uint32_t bits = (value ? word : ~word) & wordMask(begin, end);
+      if (bits)
+        return w * 32 + llvm::countTrailingZeros(bits);
+    }
+    return end;
+  }
+
+  /// Returns true if all bits in [begin, end) equal `value`.
+  bool all(unsigned begin, unsigned end, bool value) const {
+    return findNext(begin, end, !value) == end;
+  }
+
+  /// Returns the number of set bits in [begin, end).
+  unsigned count(unsigned begin, unsigned end) const {
+    unsigned n = 0;
+    for (unsigned w = begin / 32; begin < end; ++w, begin = w * 32)
+      n += llvm::countPopulation(words.get(w) & wordMask(begin, end));
+    return n;
+  }
+
+private:
+  /// Mask of the bits in [begin, end) within the word holding `begin`.
+  static uint32_t wordMask(unsigned begin, unsigned end) {
+    uint32_t mask = ~0u << (begin & 0x1F);
+    if (end - (begin & ~0x1Fu) < 32)
+      mask &= ~(~0u << (end & 0x1F));
+    return mask;
+  }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_PAGEDARRAY_H */
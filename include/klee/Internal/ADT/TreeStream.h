@@ -10,6 +10,7 @@
 #ifndef __UTIL_TREESTREAM_H__
 #define __UTIL_TREESTREAM_H__
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -18,12 +19,31 @@ namespace klee {
   typedef unsigned TreeStreamID;
   class TreeOStream;
 
+  /// TreeStreamWriter - Writes the streams of a tree of states to a file,
+  /// as a sequence of blocks which are compressed if KLEE was built with
+  /// zlib. Which parts of the file make up each stream is indexed in
+  /// memory, so that a stream is read back without scanning the file.
   class TreeStreamWriter {
     static const unsigned bufferSize = 4*4096;
+    static const unsigned blockSize = 64*1024;
 
     friend class TreeOStream;
 
   private:
+    /// A part of a stream, at an offset into the uncompressed records.
+    struct Chunk {
+      std::uint64_t offset;
+      unsigned size;
+    };
+
+    struct Stream {
+      /// The stream this one was opened from, and how many of its chunks
+      /// this one starts with.
+      TreeStreamID parent;
+      size_t forkedAt;
+      std::vector<Chunk> chunks;
+    };
+
     char buffer[bufferSize];
     unsigned lastID, bufferCount;
 
@@ -31,8 +51,26 @@ namespace klee {
     std::ofstream *output;
     unsigned ids;
 
+    /// The streams by id, starting with the empty stream 0.
+    std::vector<Stream> streams;
+
+    /// The records not yet written, which start at blockStart.
+    std::string block;
+    std::uint64_t blockStart;
+
+    /// The start of each written block in the records, and in the file.
+    std::vector<std::pair<std::uint64_t, std::uint64_t> > blocks;
+    std::uint64_t fileSize;
+
+    /// The last written block read back, uncompressed.
+    std::string cachedBlock;
+    size_t cachedIndex;
+
     void write(TreeOStream &os, const char *s, unsigned size);
     void flushBuffer();
+    void append(TreeStreamID id, unsigned tag, const char *s, unsigned size);
+    void writeBlock();
+    bool readChunk(const Chunk &chunk, std::vector<unsigned char> &out);
 
   public:
     TreeStreamWriter(const std::string &_path);
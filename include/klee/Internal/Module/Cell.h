@@ -17,6 +17,11 @@ namespace klee {
 
   struct Cell {
     ref<Expr> value;
+
+    /// Sets the value to the constant \a v, reusing the constant held so far
+    /// if nothing else refers to it. Concrete values recomputed over and over,
+    /// such as addresses, then do not allocate.
+    void setConstant(const llvm::APInt &v) { ConstantExpr::assign(value, v); }
   };
 }
 
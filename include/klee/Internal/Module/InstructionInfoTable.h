@@ -10,15 +10,17 @@
 #ifndef KLEE_LIB_INSTRUCTIONINFOTABLE_H
 #define KLEE_LIB_INSTRUCTIONINFOTABLE_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
-#include <vector>
+#include <unordered_set>
 
 namespace llvm {
   class Function;
   class Instruction;
   class Module; 
+  class raw_ostream;
 }
 
 namespace klee {
@@ -56,16 +58,30 @@ namespace klee {
     FunctionInfo(FunctionInfo &&) = default;
   };
 
+  /// Debug information of the instructions and functions of a module. The
+  /// information of a function is extracted when first asked for, and the
+  /// assembly lines when the first function is.
   class InstructionInfoTable {
-    std::unordered_map<const llvm::Instruction *,
-                       std::unique_ptr<InstructionInfo>>
+    const llvm::Module &module;
+    unsigned maxID;
+
+    // Node based, so that references to the items stay valid
+    mutable std::unordered_map<const llvm::Instruction *, InstructionInfo>
         infos;
-    std::unordered_map<const llvm::Function *, std::unique_ptr<FunctionInfo>>
+    mutable std::unordered_map<const llvm::Function *, FunctionInfo>
         functionInfos;
-    std::vector<std::unique_ptr<std::string>> internedStrings;
+    mutable std::unordered_set<std::string> internedStrings;
+    mutable std::unordered_map<uintptr_t, uint64_t> lineTable;
+    mutable unsigned nextID = 0;
+
+    void addFunction(const llvm::Function &f) const;
 
   public:
-    InstructionInfoTable(const llvm::Module &m);
+    explicit InstructionInfoTable(const llvm::Module &m);
+
+    /// Print the assembly of the module to \a os, recording the assembly
+    /// lines on the way so that the module need not be printed again.
+    void printAssembly(llvm::raw_ostream &os) const;
 
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction &) const;
@@ -13,13 +13,16 @@
 #include "klee/Config/Version.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 
+#include "llvm/ADT/APInt.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <vector>
 
 namespace llvm {
+  class BasicBlock;
   class Instruction;
+  class SwitchInst;
 }
 
 namespace klee {
@@ -41,6 +44,20 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// The opcode of inst, so that dispatch does not touch the LLVM
+    /// instruction.
+    unsigned opcode;
+    /// Width in bits of the result of inst, or 0 if its type is unsized.
+    unsigned width;
+    /// Whether inst is a load or store which was proved in bounds when
+    /// the module was prepared, see --prove-in-bounds.
+    bool provedInBounds;
+    /// Whether inst is a division or remainder whose divisor has to be
+    /// checked for zero, see --check-div-zero.
+    bool checkDivZero;
+    /// Whether inst is a shift whose amount has to be checked against the
+    /// width, see --check-overshift.
+    bool checkOvershift;
 
   public:
     virtual ~KInstruction();
@@ -59,6 +76,36 @@ namespace klee {
     /// instruction.
     uint64_t offset;
   };
+
+  /// KSwitchInstruction - A switch, with its cases grouped by successor so
+  /// that executing it on a symbolic value costs a condition per distinct
+  /// successor rather than per case.
+  struct KSwitchInstruction : KInstruction {
+    /// The case values from low to high, inclusive and in unsigned order,
+    /// which all lead to targets[target].
+    struct CaseRange {
+      llvm::APInt low, high;
+      unsigned target;
+    };
+
+    /// The distinct successors of the switch, the default destination last.
+    std::vector<llvm::BasicBlock *> targets;
+
+    /// The case values as disjoint ranges sorted in unsigned order, leaving
+    /// out the values leading to the default destination.
+    std::vector<CaseRange> ranges;
+
+    /// The index into targets of the successor of every value from
+    /// tableBase on, when the case values are dense enough for it to pay.
+    std::vector<unsigned> table;
+    uint64_t tableBase;
+
+    /// Fill in the targets, ranges and table of \a si.
+    void initialize(llvm::SwitchInst *si);
+
+    /// Returns the index into targets of the successor of \a value.
+    unsigned getTarget(const llvm::APInt &value) const;
+  };
 }
 
 #endif
@@ -11,13 +11,18 @@
 #define KLEE_KMODULE_H
 
 #include "klee/Config/Version.h"
+#include "klee/Internal/Module/Cell.h"
 #include "klee/Interpreter.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -30,7 +35,6 @@ namespace llvm {
 }
 
 namespace klee {
-  struct Cell;
   class Executor;
   class Expr;
   class InterpreterHandler;
@@ -53,6 +57,11 @@ namespace klee {
     /// "coverable" for statistics and search heuristics.
     bool trackCoverage;
 
+    /// The regions whose states are merged without klee_open_merge() and
+    /// klee_close_merge() calls (see --auto-merge-max-blocks), mapping the
+    /// block whose branch opens a region to the instruction closing it.
+    std::map<llvm::BasicBlock*, KInstruction*> mergeRegions;
+
   public:
     explicit KFunction(llvm::Function*, KModule *);
     KFunction(const KFunction &) = delete;
@@ -61,6 +70,20 @@ namespace klee {
     ~KFunction();
 
     unsigned getArgRegister(unsigned index) { return index; }
+
+    /// Set \a live to the registers which may be read from the execution of
+    /// \a ki, an instruction of this function, on: its result and the
+    /// registers live before it.
+    void getLiveRegisters(const KInstruction *ki, llvm::BitVector &live);
+
+  private:
+    void findMergeRegions(unsigned maxBlocks);
+    void computeLiveness();
+
+    /// The registers live at the end of each block, computed on first use.
+    /// The incoming values of phi nodes count as read at the start of their
+    /// block.
+    std::map<llvm::BasicBlock*, llvm::BitVector> liveOut;
   };
 
 
@@ -99,7 +122,8 @@ namespace klee {
     std::map<const llvm::Constant *, std::unique_ptr<KConstant>> constantMap;
     KConstant* getKConstant(const llvm::Constant *c);
 
-    std::unique_ptr<Cell[]> constantTable;
+    /// The values of the constants, growing as functions are manifested.
+    std::deque<Cell> constantTable;
 
     // Functions which are part of KLEE runtime
     std::set<const llvm::Function*> internalFunctions;
@@ -108,6 +132,8 @@ namespace klee {
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    void addInternalFunctions(const Interpreter::ModuleOptions &opts);
+
   public:
     KModule() = default;
 
@@ -121,9 +147,15 @@ namespace klee {
     ///
     /// @param ih
     /// @param forceSourceOutput true if assembly.ll should be created
+    /// @param lazyFunctions true if the KFunctions are only created by
+    /// manifestFunction(), once their functions are called
     ///
     // FIXME: ihandler should not be here
-    void manifest(InterpreterHandler *ih, bool forceSourceOutput);
+    void manifest(InterpreterHandler *ih, bool forceSourceOutput,
+                  bool lazyFunctions = false);
+
+    /// Create the KFunction of the defined function \a f.
+    KFunction *manifestFunction(llvm::Function *f);
 
     /// Link the provided modules together as one KLEE module.
     ///
@@ -141,12 +173,42 @@ namespace klee {
 
     void instrument(const Interpreter::ModuleOptions &opts);
 
+    /// Return the path in opts.CacheDir under which the module prepared from
+    /// the given modules is kept.
+    static std::string
+    getPreparedPath(const std::vector<std::unique_ptr<llvm::Module>> &modules,
+                    const Interpreter::ModuleOptions &opts);
+
+    /// Take the module prepared by an earlier run from \a path, in place of
+    /// linking, instrumenting and preparing it.
+    ///
+    /// @return false if there is no usable module at \a path
+    bool loadPrepared(const std::string &path, llvm::LLVMContext &ctx,
+                      const Interpreter::ModuleOptions &opts);
+
+    /// Keep the prepared module at \a path for loadPrepared().
+    void storePrepared(const std::string &path);
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
 
     /// Run passes that check if module is valid LLVM IR and if invariants
     /// expected by KLEE's Executor hold.
     void checkModule();
+
+    /// The distances of the instructions, by id, to a target of setTargets()
+    /// without returning from their function, and to the return of their
+    /// function. They count the instructions executed, the callees' on the
+    /// shortest path through them: 1 at a target or a return, 0 if there
+    /// is none on the way.
+    std::vector<std::uint64_t> targetDistances, returnDistances;
+
+    /// Compute the distances to the instructions at the \a targets, each
+    /// given as file:line, the file possibly a suffix of the path.
+    ///
+    /// @return false, with \a error set, if a target has no instructions
+    bool setTargets(const std::vector<std::string> &targets,
+                    std::string &error);
   };
 } // End klee namespace
 
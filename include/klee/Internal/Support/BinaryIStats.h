@@ -0,0 +1,149 @@
+//===-- BinaryIStats.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The binary instruction level statistics (run.istats.bin), an append-only
+// alternative to the callgrind file which is rewritten on every dump.
+//
+// After an 8 byte magic, the file is a sequence of records, each a kind
+// byte, the LEB128 length of its payload and the payload. Numbers in
+// payloads are LEB128 encoded, strings are interned by a string record
+// and referred to by index. The functions and instructions are described
+// once, then each dump appends a record with the values which changed
+// since the previous one, as zigzag encoded differences. A record cut
+// short by an interrupted run ends the file.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYISTATS_H
+#define KLEE_BINARYISTATS_H
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace klee {
+namespace istats {
+  enum RecordKind : uint8_t {
+    StringRecord = 'S',
+    HeaderRecord = 'H',
+    FunctionRecord = 'F',
+    InstructionRecord = 'I',
+    /// The instruction values which changed in one dump.
+    ValuesRecord = 'V',
+    /// The call site values which changed in one dump.
+    CallsRecord = 'C'
+  };
+
+  extern const char Magic[8];
+
+  /// Appends the records of run.istats.bin to an output stream.
+  class BinaryWriter {
+    std::unique_ptr<llvm::raw_fd_ostream> os;
+    std::unordered_map<std::string, unsigned> strings;
+    unsigned numEvents = 0;
+    /// The payload of the record being built.
+    std::string payload;
+    unsigned entries = 0;
+    unsigned lastID = 0;
+
+    void record(RecordKind kind);
+    unsigned string(const std::string &s);
+    void number(uint64_t n);
+    void difference(uint64_t value, uint64_t last);
+    /// Appends \a id, then the mask and differences of the \a n values
+    /// which changed from \a last, which are updated. Returns false and
+    /// appends nothing if none did.
+    bool changes(uint64_t id, const uint64_t *values, uint64_t *last,
+                 unsigned n);
+
+  public:
+    explicit BinaryWriter(std::unique_ptr<llvm::raw_fd_ostream> os);
+
+    /// Starts the file, with the short and long names of the events.
+    void writeHeader(uint64_t pid, const std::string &cmd,
+                     const std::string &object,
+                     const std::vector<std::pair<std::string, std::string> >
+                         &events);
+    void writeFunction(unsigned id, const std::string &name,
+                       const std::string &file, unsigned line,
+                       unsigned assemblyLine);
+    /// Describes the instructions, which the converter prints in the order
+    /// they are described in, after their function.
+    void writeInstruction(unsigned id, unsigned function,
+                          const std::string &file, unsigned line,
+                          unsigned assemblyLine);
+
+    /// Appends the values of instruction \a id, in increasing order of id
+    /// within a dump, if they changed from \a last.
+    void addValues(unsigned id, const uint64_t *values, uint64_t *last);
+    void endValues();
+    /// Appends the number of calls and values of a call site, in increasing
+    /// order of caller within a dump, if they changed from \a last, which
+    /// has one more entry than there are events, for the calls.
+    void addCall(unsigned caller, unsigned callee, uint64_t calls,
+                 const uint64_t *values, uint64_t *last);
+    void endCalls();
+
+    void flush() { os->flush(); }
+  };
+
+  /// The contents of a run.istats.bin file, as they were at its last dump.
+  class BinaryReader {
+  public:
+    struct Function {
+      unsigned id;
+      std::string name, file;
+      unsigned line, assemblyLine;
+    };
+    struct Instruction {
+      unsigned id, function;
+      std::string file;
+      unsigned line, assemblyLine;
+    };
+    struct Call {
+      uint64_t calls = 0;
+      std::vector<uint64_t> values;
+    };
+
+    uint64_t pid = 0;
+    std::string cmd, object;
+    std::vector<std::pair<std::string, std::string> > events;
+    std::vector<Function> functions;
+    std::vector<Instruction> instructions;
+    std::unordered_map<unsigned, std::vector<uint64_t> > values;
+    /// By caller instruction and callee function.
+    std::map<std::pair<unsigned, unsigned>, Call> calls;
+    /// The number of dumps read.
+    unsigned dumps = 0;
+
+  private:
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    std::vector<std::string> strings;
+
+    bool parse(RecordKind kind, const uint8_t *p, const uint8_t *end);
+
+  public:
+    /// Maps \a path and reads it. Returns false and sets \a error if it is
+    /// not a binary istats file.
+    bool read(const std::string &path, std::string &error);
+
+    /// Prints the contents in the callgrind format of run.istats.
+    void writeCallgrind(llvm::raw_ostream &os) const;
+  };
+}
+}
+
+#endif
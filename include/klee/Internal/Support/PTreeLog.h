@@ -0,0 +1,130 @@
+//===-- PTreeLog.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The process tree log (ptree.bin), the splits and removals of the leaves
+// of the process tree as they happen, so that the tree can be analysed
+// without dumping it.
+//
+// After an 8 byte magic, the file is a sequence of events, each a kind
+// byte and LEB128 encoded numbers. Nodes are numbered in the order they
+// are created, from 0: the root of a tree, then the two children of each
+// split. Events refer to a leaf by how far back from the next number it
+// is, which is small when states are explored depth first. Each event
+// counts the instructions executed since the previous one. A fork site is
+// described by a site event before the first split at it. An event cut
+// short by an interrupted run ends the file.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PTREELOG_H
+#define KLEE_PTREELOG_H
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace klee {
+namespace ptreelog {
+  enum EventKind : uint8_t {
+    /// A new tree, whose root is a leaf: instructions.
+    TreeEvent = 'T',
+    /// A leaf split in two: leaf, site, instructions.
+    SplitEvent = 'S',
+    /// A leaf removed: leaf, instructions.
+    RemoveEvent = 'R',
+    /// The source of a fork site: site, function, file, line, with the
+    /// strings as their LEB128 length and bytes.
+    SiteEvent = 'I'
+  };
+
+  extern const char Magic[8];
+
+  /// Appends the events of ptree.bin to an output stream. Leaves are
+  /// identified by the address of their node, which may be reused once it
+  /// is split or removed.
+  class Writer {
+    std::unique_ptr<llvm::raw_fd_ostream> os;
+    /// The number of each leaf.
+    std::unordered_map<const void *, uint64_t> leaves;
+    std::unordered_set<unsigned> described;
+    uint64_t next = 0;
+    uint64_t lastInstructions = 0;
+    std::string event;
+
+    void number(uint64_t n);
+    void string(const std::string &s);
+    /// Appends the distance of \a leaf, which is no longer one.
+    void leaf(const void *leaf);
+    void write(EventKind kind, uint64_t instructions);
+
+  public:
+    explicit Writer(std::unique_ptr<llvm::raw_fd_ostream> os);
+
+    /// Starts a new tree, forgetting the leaves of the previous ones.
+    void tree(const void *root, uint64_t instructions);
+    /// Site 0 stands for none, the others are described with describe()
+    /// before, unless isDescribed() says they have been.
+    void split(const void *leaf, const void *left, const void *right,
+               unsigned site, uint64_t instructions);
+    void remove(const void *leaf, uint64_t instructions);
+
+    bool isDescribed(unsigned site) const { return described.count(site); }
+    void describe(unsigned site, const std::string &function,
+                  const std::string &file, unsigned line);
+
+    void flush() { os->flush(); }
+  };
+
+  /// The shape of the trees of a ptree.bin file, computed while reading it
+  /// without building them.
+  class Reader {
+  public:
+    struct Site {
+      std::string function, file;
+      unsigned line = 0;
+      uint64_t splits = 0;
+      /// The sum of the depths of the leaves split at the site.
+      uint64_t depths = 0;
+    };
+
+    uint64_t trees = 0, splits = 0, removes = 0, instructions = 0;
+    /// The most leaves there were at once.
+    uint64_t maxLeaves = 0;
+    /// The number of leaves split and removed at each depth.
+    std::vector<uint64_t> splitDepths, removeDepths;
+    /// The fork sites by their number, 0 for the splits without one.
+    std::map<unsigned, Site> sites;
+
+  private:
+    /// The depth of each leaf, by number.
+    std::unordered_map<uint64_t, unsigned> leaves;
+    uint64_t next = 0;
+
+  public:
+    /// Reads \a path. Returns false and sets \a error if it is not a process
+    /// tree log or is malformed.
+    bool read(const std::string &path, std::string &error);
+
+    /// The leaves left when the log ends.
+    uint64_t getLeaves() const { return leaves.size(); }
+
+    /// Prints the totals, the depth histograms and the \a top fork sites
+    /// which split the most.
+    void print(llvm::raw_ostream &os, unsigned top) const;
+  };
+}
+}
+
+#endif
@@ -0,0 +1,73 @@
+//===-- Trace.h -------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TRACE_H
+#define KLEE_TRACE_H
+
+#include "klee/Config/config.h"
+
+#include <cstdint>
+#include <string>
+
+/// The klee::trace namespace records where the time of a run goes as scoped
+/// events, kept in a ring buffer per thread, and writes them in the Chrome
+/// trace format read by chrome://tracing and Perfetto. The scopes are only
+/// recorded when KLEE is configured with ENABLE_KLEE_TRACING; otherwise
+/// KLEE_TRACE_SCOPE expands to nothing.
+
+namespace klee {
+  namespace trace {
+
+    /// Returns the time events are recorded with, in nanoseconds.
+    std::uint64_t now();
+
+    /// Records the event \a name from \a start to \a end into the buffer of
+    /// the calling thread, overwriting its oldest event once it is full.
+    /// \a name must outlive the trace.
+    void record(const char *name, std::uint64_t start, std::uint64_t end);
+
+    /// Writes the events recorded so far to \a path. Returns false and sets
+    /// \a error on failure. Events which other threads record meanwhile may
+    /// be torn.
+    bool write(const std::string &path, std::string &error);
+
+    /// Makes the signal \a signum request the trace to be written, which
+    /// the executor checks for between instructions.
+    void writeOnSignal(int signum);
+
+    /// Returns and clears whether the signal was received.
+    bool takeWriteRequest();
+
+    /// Records the lifetime of the scope it is declared in.
+    class Scope {
+      const char *name;
+      std::uint64_t start;
+
+    public:
+      explicit Scope(const char *name) : name(name), start(now()) {}
+      ~Scope() { record(name, start, now()); }
+
+      Scope(const Scope &) = delete;
+      Scope &operator=(const Scope &) = delete;
+    };
+
+  } // trace
+} // klee
+
+#define KLEE_TRACE_CONCAT_(a, b) a##b
+#define KLEE_TRACE_CONCAT(a, b) KLEE_TRACE_CONCAT_(a, b)
+
+#ifdef ENABLE_KLEE_TRACING
+#define KLEE_TRACE_SCOPE(name)                                                 \
+  ::klee::trace::Scope KLEE_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define KLEE_TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+//===-- NUMA.h --------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_NUMA_H
+#define KLEE_NUMA_H
+
+#include <string>
+#include <vector>
+
+namespace klee {
+  namespace numa {
+    /// The CPUs of each NUMA node, read once from sysfs. A machine without
+    /// NUMA, or where the topology cannot be read, has a single node with
+    /// no CPUs listed.
+    const std::vector<std::vector<unsigned> > &getNodes();
+
+    /// Parses a sysfs CPU list such as "0-3,8-11" into \a cpus. Returns
+    /// false if it is malformed.
+    bool parseCPUList(const std::string &list, std::vector<unsigned> &cpus);
+
+    /// The node which worker \a worker is placed on by --numa-placement,
+    /// or -1 if it is not placed.
+    int getWorkerNode(unsigned worker);
+
+    /// Binds the calling process, a freshly forked worker, to the CPUs of
+    /// its node and prefers the memory of that node for what it allocates
+    /// or writes from now on. Does nothing unless --numa-placement is set
+    /// and there are several nodes.
+    void placeWorker(unsigned worker);
+  }
+}
+
+#endif
@@ -36,6 +36,15 @@ namespace klee {
     /// Returns point in time using a monotonic steady clock
     Point getWallTime();
 
+    /// Returns point in time using a monotonic clock which is cheaper to read
+    /// than `getWallTime` but only advances every few milliseconds
+    Point getCoarseTime();
+
+    /// Returns point in time for the time statistics: `getCoarseTime` with
+    /// `--coarse-stat-time`, otherwise `getWallTime`. Only spans between two
+    /// such points are meaningful.
+    Point getStatTime();
+
     struct Point {
       using SteadyTimePoint = std::chrono::steady_clock::time_point;
 
@@ -29,6 +29,7 @@ namespace klee {
 class ExecutionState;
 class Interpreter;
 class TreeStreamWriter;
+class BranchPath;
 
 class InterpreterHandler {
 public:
@@ -57,6 +58,15 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    /// Directory of prepared modules kept across runs, or empty to always
+    /// prepare the module.
+    std::string CacheDir;
+    /// Keys the cached modules together with the loaded bitcode, and has to
+    /// cover every option affecting how the module is prepared.
+    std::string CacheSalt;
+    /// Functions kept as entry points besides EntryPoint, for
+    /// runFunctionsAsMain().
+    std::vector<std::string> ExtraEntryPoints;
 
     ModuleOptions(const std::string &_LibraryDir,
                   const std::string &_EntryPoint, bool _Optimize,
@@ -122,8 +132,12 @@ public:
 
   // supply a list of branch decisions specifying which direction to
   // take on forks. this can be used to drive the interpretation down
-  // a user specified path. use null to reset.
-  virtual void setReplayPath(const std::vector<bool> *path) = 0;
+  // a user specified path. use null to reset. if asPrefix is set, the
+  // decisions only fix the first branches and normal forking resumes
+  // once they are consumed, i.e. the subtree below the prefix is
+  // explored.
+  virtual void setReplayPath(const BranchPath *path,
+                             bool asPrefix = false) = 0;
 
   // supply a set of symbolic bindings that will be used as "seeds"
   // for the search. use null to reset.
@@ -134,6 +148,14 @@ public:
                                  char **argv,
                                  char **envp) = 0;
 
+  /// Explores each of \a fs in turn as runFunctionAsMain() would, taking at
+  /// most three arguments like main. The module is prepared once, and every
+  /// entry point starts from a copy of one state in which argv, envp and
+  /// the globals are already set up, so that an entry point adds no startup
+  /// cost but its own exploration. A halt stops the remaining entry points.
+  virtual void runFunctionsAsMain(const std::vector<llvm::Function *> &fs,
+                                  int argc, char **argv, char **envp) = 0;
+
   /*** Runtime options ***/
 
   virtual void setHaltExecution(bool value) = 0;
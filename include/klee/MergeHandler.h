@@ -71,6 +71,7 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <stdint.h>
 #include "llvm/Support/CommandLine.h"
 
@@ -89,6 +90,7 @@ extern llvm::cl::opt<bool> DebugLogIncompleteMerge;
 
 class Executor;
 class ExecutionState;
+struct KInstruction;
 
 /// @brief Represents one `klee_open_merge()` call. 
 /// Handles merging of states that branched from it
@@ -107,6 +109,10 @@ private:
   /// into a relevant klee_close_merge
   unsigned closedStateCount;
 
+  /// @brief The instruction closing the merge, if it was opened for an
+  /// automatically found merge region rather than by klee_open_merge
+  KInstruction *autoClose;
+
   /// @brief Get distance of state from the openInstruction
   unsigned getInstructionDistance(ExecutionState *es);
 
@@ -119,6 +125,13 @@ private:
   std::map<llvm::Instruction *, std::vector<ExecutionState *> >
       reachedCloseMerge;
 
+  /// @brief The states in 'reachedCloseMerge' by 'klee_close_merge' call and
+  /// merge fingerprint, so that merge partners are found without trying
+  /// every state
+  std::map<llvm::Instruction *,
+           std::unordered_multimap<uint64_t, ExecutionState *> >
+      closedByFingerprint;
+
 public:
 
   /// @brief Called when a state runs into a 'klee_close_merge()' call
@@ -149,7 +162,12 @@ public:
   unsigned refCount;
 
 
-  MergeHandler(Executor *_executor, ExecutionState *es);
+  /// @brief The instruction at which states close the merge without a call
+  /// to klee_close_merge, if any
+  KInstruction *getAutoClose() const { return autoClose; }
+
+  MergeHandler(Executor *_executor, ExecutionState *es,
+               KInstruction *autoClose = nullptr);
   ~MergeHandler();
 };
 }
@@ -0,0 +1,106 @@
+//===-- QueryLog.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYLOG_H
+#define KLEE_QUERYLOG_H
+
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace klee {
+  class ArrayCache;
+  class ExprBuilder;
+
+  /// A query read back from a binary query log, as written with
+  /// --use-query-log=all:bin or solver:bin.
+  struct LoggedQuery {
+    enum Kind {
+      Truth = 'T',
+      Validity = 'V',
+      Value = 'X',
+      InitialValues = 'I'
+    };
+
+    Kind kind;
+    std::uint64_t number;
+    /// The number of instructions executed when the query was issued.
+    std::uint64_t instructions;
+    time::Span elapsed;
+    bool success;
+    SolverImpl::SolverRunStatus status;
+
+    std::vector<ref<Expr> > constraints;
+    ref<Expr> expr;
+    /// The arrays to solve for, of an InitialValues query.
+    std::vector<const Array *> objects;
+
+    /// The result of the query of the kind, when it succeeded.
+    bool isValid;
+    Solver::Validity validity;
+    ref<Expr> value;
+    bool hasSolution;
+    std::vector<std::vector<unsigned char> > values;
+
+    const char *getKindName() const;
+  };
+
+  /// Reads the queries of a binary query log, compressed or not, in the
+  /// order they were logged, decompressing only as much of it as the next
+  /// query needs. The arrays they use are created in the given cache, and
+  /// their expressions with the given builder, if any.
+  class QueryLogReader {
+    struct Inflater;
+
+    llvm::StringRef input;
+    size_t inputPos = 0;
+    bool inputDone = false;
+    std::unique_ptr<Inflater> inflater;
+
+    /// The read part of the log not consumed yet, from pos, which is at
+    /// offset in the log.
+    std::string data;
+    size_t pos = 0;
+    std::uint64_t offset = 0;
+
+    ArrayCache &arrayCache;
+    ExprBuilder *builder;
+    std::string error;
+
+    /// Reads until size bytes are available from pos, if the log has them.
+    bool fill(size_t size);
+    bool readRecord(const std::string &payload, LoggedQuery &query);
+
+  public:
+    QueryLogReader(llvm::StringRef contents, ArrayCache &arrayCache,
+                   ExprBuilder *builder = nullptr);
+    ~QueryLogReader();
+
+    /// Returns whether the contents look like a binary query log rather
+    /// than a KQuery file.
+    static bool isQueryLog(llvm::StringRef contents);
+
+    /// Reads the next query, returning false at the end of the log or if
+    /// it is malformed, in which case getError() is not empty. A log cut
+    /// short by a crash ends after its last complete query.
+    bool next(LoggedQuery &query);
+
+    const std::string &getError() const { return error; }
+  };
+}
+
+#endif
@@ -161,6 +161,24 @@ namespace klee {
     /// \return True on success.
     bool mayBeFalse(const Query&, bool &result);
 
+    /// mayBeTrue - Determine for each of several conditions whether there is
+    /// a valid assignment for the given constraints in which it evaluates to
+    /// true.
+    ///
+    /// This is equivalent to calling mayBeTrue() once per condition, but
+    /// every model the solver produces is evaluated against all undecided
+    /// conditions, and a single unsatisfiable query rules out all of the
+    /// remaining ones. This needs at most one query per feasible condition
+    /// plus one.
+    ///
+    /// \param [out] result - On success, result[i] is true iff conditions[i]
+    /// may be true
+    ///
+    /// \return True on success.
+    bool mayBeTrue(const ConstraintManager &constraints,
+                   const std::vector< ref<Expr> > &conditions,
+                   std::vector<bool> &result);
+
     /// getValue - Compute one possible value for the given expression.
     ///
     /// \param [out] result - On success, a value for the expression in some
@@ -188,6 +206,17 @@ namespace klee {
                           const std::vector<const Array*> &objects,
                           std::vector< std::vector<unsigned char> > &result);
 
+    /// getUniqueValue - Compute a feasible value for the expression, and
+    /// whether it is the only one, in the same solver session where the
+    /// solver supports it.
+    ///
+    /// \param [out] isUnique - On success, true iff the expression must be
+    /// equal to \a result.
+    ///
+    /// \return True on success.
+    bool getUniqueValue(const Query &, ref<ConstantExpr> &result,
+                        bool &isUnique);
+
     /// getRange - Compute a tight range of possible values for a given
     /// expression.
     ///
@@ -215,6 +244,21 @@ namespace klee {
   /// \param oracle - The solver to check query results against.
   Solver *createValidatingSolver(Solver *s, Solver *oracle);
 
+  /// createAsyncValidatingSolver - Create a solver which, like
+  /// createValidatingSolver, validates query results against an oracle, but
+  /// in a separate process without waiting for it: results are returned as
+  /// soon as the primary solver has them, and mismatches are reported as
+  /// warnings when they are found.
+  ///
+  /// \param s - The primary underlying solver to use.
+  /// \param oracle - The solver to check query results against.
+  /// \param sampleRatio - The fraction of the queries to check.
+  /// \param maxBacklog - How many queries may wait to be checked; more are
+  /// not checked.
+  Solver *createAsyncValidatingSolver(Solver *s, Solver *oracle,
+                                      double sampleRatio,
+                                      unsigned maxBacklog);
+
   /// createAssignmentValidatingSolver - Create a solver that when requested
   /// for an assignment will check that the computed assignment satisfies
   /// the Query.
@@ -227,6 +271,42 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCachingSolver(Solver *s);
 
+  /// createCanonicalCachingSolver - Create a solver which will cache the
+  /// results of successful queries in memory, keyed by their contents
+  /// independently of the names of the arrays they read, so that queries on
+  /// arrays created by the same code in different states share results.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createCanonicalCachingSolver(Solver *s);
+
+  /// createPersistentCachingSolver - Create a solver which will cache the
+  /// results of successful queries in an SQLite database at the given path,
+  /// so that they can be reused across runs. Queries are keyed by their
+  /// contents, independently of the names of the arrays they read. Returns
+  /// \a s and warns if the database cannot be opened.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createPersistentCachingSolver(Solver *s, const std::string &path);
+
+  /// createSharedMemoryCachingSolver - Create a solver which will cache the
+  /// results of successful queries in the POSIX shared memory object of the
+  /// given name, so that they can be reused by concurrent runs. The object is
+  /// created with a size of \a sizeMB megabytes if it does not exist yet, and
+  /// persists until it is removed. Returns \a s and warns if the object
+  /// cannot be mapped.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createSharedMemoryCachingSolver(Solver *s, const std::string &name,
+                                          unsigned sizeMB);
+
+  /// createAdaptiveTimeoutSolver - Create a solver which records how queries
+  /// of each shape (their structure, with constants and arrays abstracted
+  /// away) fare, and gives those of shapes which almost always time out only
+  /// a fraction of the core solver timeout.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createAdaptiveTimeoutSolver(Solver *s);
+
   /// createCexCachingSolver - Create a counterexample caching solver. This is a
   /// more sophisticated cache which records counterexamples for a constraint
   /// set and uses subset/superset relations among constraints to try and
@@ -242,6 +322,14 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createFastCexSolver(Solver *s);
 
+  /// createKnownBitsSolver - Create a solver which tries to decide queries by
+  /// propagating the bits of expressions known to be zero or one, e.g. for
+  /// queries over masked flags or checksums. Other queries, and queries for
+  /// an assignment which exists, are passed on.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createKnownBitsSolver(Solver *s);
+
   /// createIndependentSolver - Create a solver which will eliminate any
   /// unnecessary constraints before propogating the query to the underlying
   /// solver.
@@ -261,6 +349,54 @@ namespace klee {
                                     time::Span minQueryTimeToLog,
                                     bool logTimedOut);
 
+  /// createBinaryQueryLoggingSolver - Create a solver which will forward all
+  /// queries after logging them to the given path in a compact binary form,
+  /// compressed and written by a background thread. `kleaver
+  /// --print-query-log` prints such logs as KQuery.
+  Solver *createBinaryQueryLoggingSolver(Solver *s, std::string path,
+                                         time::Span minQueryTimeToLog,
+                                         bool logTimedOut);
+
+
+  /// createWorkerPoolSolver - Create a solver which runs every query of \a s
+  /// in one of \a numWorkers long-lived processes, forked now and handed the
+  /// queries through shared memory. A worker which crashes or exceeds the
+  /// core solver timeout is killed and replaced. Processes forked later solve
+  /// their queries with \a s themselves.
+  ///
+  /// \param s - The underlying solver to use, without its own isolation.
+  ///
+  /// \param maxSpeculative - The number of workers which may be busy with
+  /// speculative queries at once; one worker is always kept for the others.
+  Solver *createWorkerPoolSolver(Solver *s, unsigned numWorkers,
+                                 unsigned maxSpeculative = 0);
+
+  /// SpeculationScope - Marks the queries issued during its lifetime as
+  /// speculative. A worker pool solver starts the core queries reaching it
+  /// on an idle worker and fails them without waiting for the answer, which
+  /// it keeps for when the same query is issued for real. Every solver then
+  /// handles that answer as it would a fresh one, so it ends up in their
+  /// caches. Queries which cannot be started fail at once. Other core
+  /// solvers ignore the scope, so speculative queries should only be issued
+  /// when the core solver is a worker pool.
+  class SpeculationScope {
+    static bool active;
+
+  public:
+    SpeculationScope() { active = true; }
+    ~SpeculationScope() { active = false; }
+
+    static bool isActive() { return active; }
+  };
+
+  /// createPortfolioSolver - Create a solver which runs every query on all of
+  /// the given backends in parallel, in forked processes, and returns the
+  /// first answer. It learns which backend wins for which kind of query and
+  /// then only runs that one.
+  ///
+  /// \param backends - The named core solvers to use, owned by the result.
+  Solver *createPortfolioSolver(
+      const std::vector<std::pair<std::string, Solver *> > &backends);
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
@@ -268,6 +404,17 @@ namespace klee {
 
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
+
+  /// getSolverCacheMemoryUsage - The memory the query caches of all solvers
+  /// hold, as estimated by the caches, in bytes.
+  uint64_t getSolverCacheMemoryUsage();
+
+  /// shrinkSolverCaches - Drop the least recently used generations of the
+  /// query caches of all solvers until about \a bytes are freed, or the
+  /// caches are empty. Returns the bytes freed.
+  ///
+  /// This must not be called while a query is being solved.
+  uint64_t shrinkSolverCaches(uint64_t bytes);
 }
 
 #endif
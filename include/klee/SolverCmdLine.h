@@ -24,22 +24,46 @@ namespace klee {
 
 extern llvm::cl::opt<bool> UseFastCexSolver;
 
+extern llvm::cl::opt<bool> UseKnownBitsSolver;
+
 extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseBranchCache;
 
+extern llvm::cl::opt<bool> UseCanonicalCache;
+
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
+extern llvm::cl::opt<std::string> PersistentQueryCache;
+
+extern llvm::cl::opt<std::string> SharedQueryCache;
+
+extern llvm::cl::opt<unsigned> SharedQueryCacheSize;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
+extern llvm::cl::opt<bool> AsyncCrossCheck;
+
+extern llvm::cl::opt<double> CrossCheckRatio;
+
+extern llvm::cl::opt<unsigned> CrossCheckBacklog;
+
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
 
 extern llvm::cl::opt<bool> LogTimedOutQueries;
 
 extern llvm::cl::opt<std::string> MaxCoreSolverTime;
 
+extern llvm::cl::opt<bool> AdaptiveSolverTimeout;
+
 extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
+extern llvm::cl::opt<unsigned> SolverWorkers;
+
+extern llvm::cl::opt<unsigned> SpeculativeQueries;
+
+extern llvm::cl::opt<unsigned> ConstructCacheSize;
+
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
 extern llvm::cl::opt<bool> UseAssignmentValidatingSolver;
@@ -49,7 +73,9 @@ enum QueryLoggingSolverType {
   ALL_KQUERY,    ///< Log all queries in .kquery (KQuery) format
   ALL_SMTLIB,    ///< Log all queries .smt2 (SMT-LIBv2) format
   SOLVER_KQUERY, ///< Log queries passed to solver in .kquery (KQuery) format
-  SOLVER_SMTLIB  ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  SOLVER_SMTLIB, ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  ALL_BINARY,    ///< Log all queries in the binary .kqlog format
+  SOLVER_BINARY  ///< Log queries passed to solver in the binary .kqlog format
 };
 
 extern llvm::cl::bits<QueryLoggingSolverType> QueryLoggingOptions;
@@ -59,11 +85,15 @@ enum CoreSolverType {
   METASMT_SOLVER,
   DUMMY_SOLVER,
   Z3_SOLVER,
+  CADICAL_SOLVER,
+  PORTFOLIO_SOLVER,
   NO_SOLVER
 };
 
 extern llvm::cl::opt<CoreSolverType> CoreSolverToUse;
 
+extern llvm::cl::list<CoreSolverType> PortfolioSolvers;
+
 extern llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith;
 
 #ifdef ENABLE_METASMT
@@ -94,6 +94,51 @@ namespace klee {
                                         &values,
                                       bool &hasSolution) = 0;
     
+    /// computeUniqueValue - Compute a feasible value for the expression,
+    /// and whether it is the only one. The default implementation asks
+    /// computeInitialValues twice, solvers able to reuse the first check for
+    /// the second should override it.
+    ///
+    /// The query expression is guaranteed to be non-constant, and its
+    /// constraints satisfiable.
+    ///
+    /// \param objects - The objects to compute values for, a superset of
+    /// those the query expression reads.
+    /// \param [out] values - On success, the initial values in a satisfying
+    /// assignment, in which the expression evaluates to its value.
+    /// \param [out] otherValues - On success, if the value is not unique, the
+    /// initial values in a satisfying assignment giving another value.
+    /// \param [out] isUnique - On success, true iff no other value is
+    /// feasible.
+    /// \return True on success
+    virtual bool
+    computeUniqueValue(const Query &query,
+                       const std::vector<const Array *> &objects,
+                       std::vector<std::vector<unsigned char> > &values,
+                       std::vector<std::vector<unsigned char> > &otherValues,
+                       bool &isUnique);
+
+    /// computeBound - Compute the least value of the expression, or the
+    /// greatest if \a maximize, as an unsigned number, with a single query.
+    ///
+    /// The query expression is guaranteed to be non-constant, and its
+    /// constraints satisfiable.
+    ///
+    /// \return True on success. False if the solver failed or cannot
+    /// optimize, in which case Solver::getRange searches for the bound with
+    /// several queries.
+    virtual bool computeBound(const Query &query, bool maximize,
+                              ref<ConstantExpr> &result) {
+      return false;
+    }
+
+    /// getUnsatCore - After computeInitialValues found no solution, get a
+    /// subset of the query constraints and of the query expression, negated,
+    /// which is unsatisfiable by itself.
+    ///
+    /// \return True if the solver extracted such a core for the last query.
+    virtual bool getUnsatCore(std::vector<ref<Expr> > &core) { return false; }
+
     /// getOperationStatusCode - get the status of the last solver operation
     virtual SolverRunStatus getOperationStatusCode() = 0;
 
@@ -19,14 +19,39 @@ namespace stats {
   extern Statistic queries;
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
+  extern Statistic queriesZ3Arrays;
+  extern Statistic queriesZ3BitVector;
+  extern Statistic queriesZ3Large;
+  extern Statistic queriesZ3NonLinear;
   extern Statistic queryCacheHits;
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryCexPoolHits;
+  extern Statistic queryCexCores;
+  extern Statistic queryFactorCacheHits;
+  extern Statistic queryFactorCacheMisses;
+  extern Statistic queryKnownBitsHits;
+  extern Statistic queryKnownBitsMisses;
+  extern Statistic queryCanonicalCacheHits;
+  extern Statistic queryCanonicalCacheMisses;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
+  extern Statistic querySharedCacheHits;
+  extern Statistic querySharedCacheForeignHits;
+  extern Statistic querySharedCacheMisses;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryNodes;
+  extern Statistic queryMaxDepth;
+  extern Statistic queryArrays;
+  extern Statistic queryUpdates;
+  extern Statistic queryConstraints;
   extern Statistic queryTime;
+  extern Statistic queryTimeoutPredictions;
+  extern Statistic speculativeQueries;
+  extern Statistic speculativeQueryHits;
   
 #ifdef KLEE_ARRAY_DEBUG
   extern Statistic arrayHashTime;
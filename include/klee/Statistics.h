@@ -12,12 +12,43 @@
 
 #include "Statistic.h"
 
+#include <atomic>
 #include <vector>
 #include <string>
 #include <string.h>
 
 namespace klee {
   class Statistic;
+
+  /// The global statistic values incremented by one thread. Each shard has
+  /// a single writer, which updates it with plain loads and stores, and
+  /// readers sum all the shards. Its values start on a cache line of their
+  /// own and fill whole lines, so that threads do not write to the same
+  /// lines.
+  class StatisticShard {
+    friend class StatisticManager;
+
+    std::atomic<uint64_t> *values;
+    void *storage;
+    unsigned size;
+    /// The shard created before, the shards forming a list which is only
+    /// ever pushed to.
+    StatisticShard *next;
+
+    explicit StatisticShard(unsigned size);
+    ~StatisticShard();
+    void resize(unsigned newSize);
+
+  public:
+    void increment(unsigned id, uint64_t addend) {
+      values[id].store(values[id].load(std::memory_order_relaxed) + addend,
+                       std::memory_order_relaxed);
+    }
+    uint64_t get(unsigned id) const {
+      return values[id].load(std::memory_order_relaxed);
+    }
+  };
+
   class StatisticRecord {
     friend class StatisticManager;
 
@@ -41,16 +72,47 @@ namespace klee {
   private:
     bool enabled;
     std::vector<Statistic*> stats;
-    uint64_t *globalStats;
-    uint64_t *indexedStats;
+    /// The most recently created shard of the global values.
+    std::atomic<StatisticShard *> shards;
+    /// The shard of the global values incremented by the current thread.
+    static thread_local StatisticShard *localShard;
+    /// The values of each instruction, and those of the context below,
+    /// belong to the thread interpreting the states and are not sharded.
+    ///
+    /// The values of each statistic are kept in pages of IndexedPageSize
+    /// instructions, allocated when a value in them is first set, so that
+    /// those of the statistics which only few instructions have take little
+    /// memory in large modules. Page p of statistic s is indexedPages[s *
+    /// numIndexedPages + p].
+    static const unsigned IndexedPageShift = 10;
+    static const unsigned IndexedPageSize = 1 << IndexedPageShift;
+    uint64_t **indexedPages;
+    unsigned numIndexedPages;
     StatisticRecord *contextStats;
     unsigned index;
 
+    uint64_t *&getIndexedPage(unsigned id, unsigned index) const {
+      return indexedPages[id * numIndexedPages + (index >> IndexedPageShift)];
+    }
+    uint64_t &getIndexedSlot(unsigned id, unsigned index) const {
+      uint64_t *&page = getIndexedPage(id, index);
+      if (!page)
+        page = new uint64_t[IndexedPageSize]();
+      return page[index & (IndexedPageSize - 1)];
+    }
+
   public:
     StatisticManager();
     ~StatisticManager();
 
     void useIndexedStats(unsigned totalIndices);
+    bool hasIndexedStats() const { return indexedPages; }
+
+    /// Returns the shard of the current thread, creating it if needed.
+    StatisticShard &getLocalShard() {
+      return localShard ? *localShard : createLocalShard();
+    }
+    StatisticShard &createLocalShard();
 
     StatisticRecord *getContext();
     void setContext(StatisticRecord *sr); /* null to reset */
@@ -76,9 +138,9 @@ namespace klee {
   inline void StatisticManager::incrementStatistic(Statistic &s, 
                                                    uint64_t addend) {
     if (enabled) {
-      globalStats[s.id] += addend;
-      if (indexedStats) {
-        indexedStats[index*stats.size() + s.id] += addend;
+      getLocalShard().increment(s.id, addend);
+      if (indexedPages) {
+        getIndexedSlot(s.id, index) += addend;
         if (contextStats)
           contextStats->data[s.id] += addend;
       }
@@ -130,24 +192,30 @@ namespace klee {
   }
 
   inline uint64_t StatisticManager::getValue(const Statistic &s) const {
-    return globalStats[s.id];
+    uint64_t value = 0;
+    for (const StatisticShard *shard = shards.load(std::memory_order_acquire);
+         shard; shard = shard->next)
+      value += shard->get(s.id);
+    return value;
   }
 
   inline void StatisticManager::incrementIndexedValue(const Statistic &s, 
                                                       unsigned index,
                                                       uint64_t addend) const {
-    indexedStats[index*stats.size() + s.id] += addend;
+    getIndexedSlot(s.id, index) += addend;
   }
 
   inline uint64_t StatisticManager::getIndexedValue(const Statistic &s, 
                                                     unsigned index) const {
-    return indexedStats[index*stats.size() + s.id];
+    const uint64_t *page = getIndexedPage(s.id, index);
+    return page ? page[index & (IndexedPageSize - 1)] : 0;
   }
 
   inline void StatisticManager::setIndexedValue(const Statistic &s, 
                                                 unsigned index,
                                                 uint64_t value) {
-    indexedStats[index*stats.size() + s.id] = value;
+    if (value || getIndexedPage(s.id, index))
+      getIndexedSlot(s.id, index) = value;
   }
 }
 
@@ -11,22 +11,23 @@
 #define KLEE_TIMERSTATINCREMENTER_H
 
 #include "klee/Statistics.h"
-#include "klee/Internal/Support/Timer.h"
+#include "klee/Internal/System/Time.h"
 
 namespace klee {
   class TimerStatIncrementer {
   private:
-    WallTimer timer;
+    time::Point start;
     Statistic &statistic;
 
   public:
-    TimerStatIncrementer(Statistic &_statistic) : statistic(_statistic) {}
+    TimerStatIncrementer(Statistic &_statistic)
+        : start(time::getStatTime()), statistic(_statistic) {}
     ~TimerStatIncrementer() {
       // record microseconds
-      statistic += timer.check().toMicroseconds();
+      statistic += check().toMicroseconds();
     }
 
-    time::Span check() { return timer.check(); }
+    time::Span check() { return time::getStatTime() - start; }
   };
 }
 
@@ -113,6 +113,11 @@ extern "C" {
   void klee_posix_prefer_cex(void *object, uintptr_t condition);
   void klee_mark_global(void *object);
 
+  /* Copy n bytes from src to dst, as memmove does, directly on the objects
+     if both pointers are constants and the range lies within the objects.
+     Returns 0 without copying anything otherwise. */
+  int klee_copy_memory(void *dst, const void *src, size_t n);
+
   /* Return a possible constant value for the input expression. This
      allows programs to forcibly concretize values on their own. */
 #define KLEE_GET_VALUE_PROTO(suffix, type)	type klee_get_value##suffix(type expr)
@@ -31,7 +31,33 @@ struct EquivArrayCmpFn {
   bool operator()(const Array *array1, const Array *array2) const {
     if (array1 == NULL || array2 == NULL)
       return false;
-    return (array1->size == array2->size) && (array1->name == array2->name);
+    return (array1->size == array2->size) && (array1->nameId == array2->nameId);
+  }
+};
+
+/// Hashes constant arrays by their contents rather than their name.
+struct ConstantArrayHashFn {
+  unsigned operator()(const Array *array) const {
+    unsigned res = array->size;
+    res = (res * Expr::MAGIC_HASH_CONSTANT) + array->getDomain();
+    res = (res * Expr::MAGIC_HASH_CONSTANT) + array->getRange();
+    for (const ref<ConstantExpr> &value : array->constantValues)
+      res = (res * Expr::MAGIC_HASH_CONSTANT) + value->hash();
+    return res;
+  }
+};
+
+struct EquivConstantArrayCmpFn {
+  bool operator()(const Array *array1, const Array *array2) const {
+    if (array1->size != array2->size ||
+        array1->getDomain() != array2->getDomain() ||
+        array1->getRange() != array2->getRange())
+      return false;
+    for (uint64_t i = 0; i != array1->size; ++i)
+      if (array1->constantValues[i]->getAPValue() !=
+          array2->constantValues[i]->getAPValue())
+        return false;
+    return true;
   }
 };
 
@@ -44,7 +70,7 @@ public:
   //
   /// Symbolic Arrays are cached so that only one instance exists. This
   /// provides a limited form of "alpha-renaming". Constant arrays are not
-  /// cached.
+  /// cached, see CreateSharedConstantArray().
   ///
   /// This class retains ownership of Array object so that upon destruction
   /// of this object all allocated Array objects are deleted.
@@ -67,12 +93,26 @@ public:
                            Expr::Width _domain = Expr::Int32,
                            Expr::Width _range = Expr::Int8);
 
+  /// Create a constant Array object, or return one created the same way
+  /// before with the same contents, so that identical tables share one
+  /// instance (and one solver encoding). The array returned may thus carry
+  /// the name it was first created with: this is meant for arrays whose
+  /// name is made up, such as those of the constant writes to an object.
+  const Array *CreateSharedConstantArray(
+      const std::string &_name, uint64_t _size,
+      const ref<ConstantExpr> *constantValuesBegin,
+      const ref<ConstantExpr> *constantValuesEnd,
+      Expr::Width _domain = Expr::Int32, Expr::Width _range = Expr::Int8);
+
 private:
   typedef unordered_set<const Array *, klee::ArrayHashFn,
                         klee::EquivArrayCmpFn> ArrayHashMap;
   ArrayHashMap cachedSymbolicArrays;
   typedef std::vector<const Array *> ArrayPtrVec;
   ArrayPtrVec concreteArrays;
+  typedef unordered_set<const Array *, klee::ConstantArrayHashFn,
+                        klee::EquivConstantArrayCmpFn> ConstantArrayHashMap;
+  ConstantArrayHashMap cachedConstantArrays;
 };
 }
 
@@ -44,6 +44,18 @@ struct UpdateNodeCmpFn {
   }
 };  
 
+/// Hashes and compares update lists structurally, so that separately
+/// allocated but equal sequences of writes to an array share an encoding.
+struct UpdateListHashFn {
+  unsigned operator()(const UpdateList &ul) const { return ul.hash(); }
+};
+
+struct UpdateListCmpFn {
+  bool operator()(const UpdateList &ul1, const UpdateList &ul2) const {
+    return ul1.compare(ul2) == 0;
+  }
+};
+
 template<class T>
 class ArrayExprHash {  
 public:
@@ -12,6 +12,7 @@
 
 #include <map>
 
+#include "klee/util/CompiledExpr.h"
 #include "klee/util/ExprEvaluator.h"
 
 // FIXME: Rename?
@@ -45,11 +46,13 @@ namespace klee {
     }
     
     ref<Expr> evaluate(const Array *mo, unsigned index) const;
-    ref<Expr> evaluate(ref<Expr> e);
+    /// Evaluates \a e, with its program from \a compiled if given.
+    ref<Expr> evaluate(ref<Expr> e, CompiledExprCache *compiled = 0);
     void createConstraintsFromAssignment(std::vector<ref<Expr> > &out) const;
 
     template<typename InputIterator>
-    bool satisfies(InputIterator begin, InputIterator end);
+    bool satisfies(InputIterator begin, InputIterator end,
+                   CompiledExprCache *compiled = 0);
     void dump();
   };
   
@@ -83,17 +86,28 @@ namespace klee {
     }
   }
 
-  inline ref<Expr> Assignment::evaluate(ref<Expr> e) { 
+  inline ref<Expr> Assignment::evaluate(ref<Expr> e,
+                                        CompiledExprCache *compiled) {
+    uint64_t value;
+    if (compiled && compiled->evaluate(e, *this, value))
+      return ConstantExpr::alloc(value, e->getWidth());
     AssignmentEvaluator v(*this);
     return v.visit(e); 
   }
 
   template<typename InputIterator>
-  inline bool Assignment::satisfies(InputIterator begin, InputIterator end) {
+  inline bool Assignment::satisfies(InputIterator begin, InputIterator end,
+                                    CompiledExprCache *compiled) {
     AssignmentEvaluator v(*this);
-    for (; begin!=end; ++begin)
-      if (!v.visit(*begin)->isTrue())
+    for (; begin!=end; ++begin) {
+      uint64_t value;
+      if (compiled && compiled->evaluate(*begin, *this, value)) {
+        if (!value)
+          return false;
+      } else if (!v.visit(*begin)->isTrue()) {
         return false;
+      }
+    }
     return true;
   }
 }
@@ -0,0 +1,117 @@
+//===-- AssignmentPool.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_ASSIGNMENTPOOL_H
+#define KLEE_UTIL_ASSIGNMENTPOOL_H
+
+#include "klee/Expr.h"
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  class Array;
+  class Assignment;
+
+  /// AssignmentPool - A bounded set of recently used assignments, kept in
+  /// most recently used first order, which can be checked against a list of
+  /// constraints all at once.
+  ///
+  /// The byte values of all pooled assignments are laid out in one flat
+  /// table per array, with the values of all assignments for the same index
+  /// next to each other. Constraints are then evaluated once per expression
+  /// node for every assignment in the pool ("lane") instead of once per
+  /// assignment, and lanes are dropped as soon as a constraint fails.
+  ///
+  /// The pool does not own the assignments.
+  class AssignmentPool {
+  public:
+    /// The pool holds at most this many assignments, one per bit of a lane
+    /// mask.
+    enum : unsigned { MaxCapacity = 64 };
+
+  private:
+    typedef std::vector<uint64_t> lanes_ty;
+
+    unsigned capacity;
+    std::vector<Assignment *> assignments;
+
+    /// The flat value table, rebuilt when the pool changed. For an array
+    /// \c A, table[A][index * size() + lane] is the value of A[index] in the
+    /// assignment of that lane.
+    std::map<const Array *, std::vector<uint8_t> > table;
+    bool dirty;
+
+    /// Lane values of the expressions evaluated during a single search.
+    std::unordered_map<const Expr *, lanes_ty> values;
+    /// The expressions evaluated in place of wide reads, kept alive while
+    /// their addresses are in values.
+    std::vector<ref<Expr> > lowered;
+    /// Lanes for which an expression evaluated during this search was
+    /// undefined.
+    uint64_t undefined;
+
+    void rebuildTable();
+    const lanes_ty *evaluate(const ref<Expr> &e);
+    bool evaluateRead(const ReadExpr &re, lanes_ty &result);
+    bool evaluateOperation(const Expr &e, lanes_ty &result);
+
+    /// Starts a search, returning the mask of all lanes.
+    uint64_t beginSearch();
+    /// Drops from \a alive the lanes not satisfying \a c.
+    void narrow(const ref<Expr> &c, uint64_t &alive);
+    /// Ends a search, returning the first lane left alive, if any.
+    Assignment *endSearch(uint64_t alive);
+
+  public:
+    AssignmentPool(unsigned capacity);
+
+    unsigned size() const { return assignments.size(); }
+    bool empty() const { return assignments.empty(); }
+
+    /// add - Insert an assignment as the most recently used one, evicting
+    /// the least recently used one when the pool is full.
+    ///
+    /// The assignment must not allow free values, and must outlive its
+    /// membership in the pool.
+    void add(Assignment *a);
+
+    /// remove - Drop an assignment from the pool, if it is there.
+    void remove(Assignment *a);
+
+    /// findSatisfying - Return the most recently used assignment which
+    /// satisfies all \a constraints, or null if there is none. The returned
+    /// assignment becomes the most recently used one.
+    ///
+    /// Constraints which are most likely to fail should come first.
+    Assignment *findSatisfying(const std::vector< ref<Expr> > &constraints) {
+      return findSatisfying(ref<Expr>(), constraints.begin(),
+                            constraints.end());
+    }
+
+    /// As above, for \a first, unless it is null, followed by the
+    /// constraints in [begin, end), which need not be copied to a vector.
+    template <class Iterator>
+    Assignment *findSatisfying(const ref<Expr> &first, Iterator begin,
+                               Iterator end) {
+      if (assignments.empty())
+        return 0;
+      uint64_t alive = beginSearch();
+      if (!first.isNull())
+        narrow(first, alive);
+      for (; alive && begin != end; ++begin)
+        narrow(*begin, alive);
+      return endSearch(alive);
+    }
+  };
+}
+
+#endif
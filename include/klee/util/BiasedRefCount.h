@@ -0,0 +1,113 @@
+//===-- BiasedRefCount.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BIASEDREFCOUNT_H
+#define KLEE_BIASEDREFCOUNT_H
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+namespace klee {
+
+/// A reference counter that is biased towards the thread that created the
+/// counted object.
+///
+/// As long as an object is confined to its creating (owner) thread, the
+/// counter is a plain, non-atomic integer, i.e. it costs the same as the
+/// default `unsigned` counter apart from one well-predicted branch. Before an
+/// object is published to another thread, the owner has to call makeShared().
+/// From then on every thread, including the owner, takes the slow path and
+/// counts atomically.
+///
+/// The shared flag is only ever written by the owner, before the object is
+/// handed to another thread. Publication already requires synchronisation
+/// (a lock, a queue, thread creation), which orders the write before any
+/// access from the other thread, so the flag itself does not need to be
+/// atomic.
+class BiasedRefCount {
+  /// Count maintained while the object is confined to its owner.
+  unsigned biased;
+
+  /// Whether the object may be referenced from more than one thread.
+  bool shared;
+
+  /// Count maintained once the object is shared.
+  std::atomic<unsigned> sharedCount;
+
+#ifndef NDEBUG
+  std::thread::id owner;
+#endif
+
+  bool isOwner() const {
+#ifndef NDEBUG
+    return owner == std::this_thread::get_id();
+#else
+    return true;
+#endif
+  }
+
+public:
+  BiasedRefCount(unsigned initial = 0)
+      : biased(initial), shared(false), sharedCount(0)
+#ifndef NDEBUG
+        , owner(std::this_thread::get_id())
+#endif
+  {
+  }
+
+  // A copied object is a new object owned by the copying thread.
+  BiasedRefCount(const BiasedRefCount &) : BiasedRefCount() {}
+  BiasedRefCount &operator=(const BiasedRefCount &) { return *this; }
+
+  /// Allow this object to be referenced from other threads. Must be called
+  /// by the owner before the object is published.
+  void makeShared() {
+    if (shared)
+      return;
+    assert(isOwner() && "only the owner can share a confined object");
+    sharedCount.store(biased, std::memory_order_relaxed);
+    biased = 0;
+    shared = true;
+  }
+
+  bool isShared() const { return shared; }
+
+  unsigned getCount() const {
+    return shared ? sharedCount.load(std::memory_order_relaxed) : biased;
+  }
+
+  operator unsigned() const { return getCount(); }
+
+  void inc() {
+    if (!shared) {
+      assert(isOwner() && "confined object referenced from another thread");
+      ++biased;
+      return;
+    }
+    sharedCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// Returns true if this was the last reference.
+  bool dec() {
+    if (!shared) {
+      assert(isOwner() && "confined object released from another thread");
+      return --biased == 0;
+    }
+    return sharedCount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+};
+
+inline void refCountInc(BiasedRefCount &count) { count.inc(); }
+
+inline bool refCountDec(BiasedRefCount &count) { return count.dec(); }
+
+} // namespace klee
+
+#endif /* KLEE_BIASEDREFCOUNT_H */
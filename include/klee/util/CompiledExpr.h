@@ -0,0 +1,153 @@
+//===-- CompiledExpr.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_COMPILEDEXPR_H
+#define KLEE_UTIL_COMPILEDEXPR_H
+
+#include "klee/Expr.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace klee {
+  class Array;
+  class Assignment;
+
+  /// CompiledExpr - An expression compiled to a linear program over 64-bit
+  /// registers, for evaluating it quickly under many concrete assignments.
+  ///
+  /// Every node of the expression DAG is computed once into its own
+  /// register, in an order where operands come first, so evaluation is a
+  /// single loop over the instructions without recursion, virtual calls or
+  /// memoization. Reads look up their arrays in the assignment once per
+  /// evaluation.
+  ///
+  /// Only expressions where every node is at most 64 bits wide can be
+  /// compiled. Evaluation fails if the result would not be a constant for
+  /// ExprEvaluator, e.g. when dividing by zero or reading an array the
+  /// assignment does not bind while it allows free values; callers then
+  /// fall back to the visitor.
+  class CompiledExpr {
+  public:
+    struct Instruction {
+      Expr::Kind kind;
+      Expr::Width width;
+      /// The width of the operands, for sign extensions and signed
+      /// comparisons.
+      Expr::Width operandWidth;
+      /// Operand registers. The result goes to the register with the same
+      /// number as the instruction.
+      unsigned a, b, c;
+      /// Constant value, shift amount for Concat, offset for Extract, or
+      /// index into reads for Read.
+      uint64_t imm;
+    };
+
+    struct Read {
+      const Array *root;
+      /// Index into arrays.
+      unsigned array;
+      /// (index register, value register) of each update, newest first.
+      std::vector<std::pair<unsigned, unsigned> > updates;
+    };
+
+  private:
+    std::vector<Instruction> instructions;
+    std::vector<Read> reads;
+    std::vector<const Array *> arrays;
+    unsigned resultRegister;
+
+    // Scratch space for run(), kept to avoid allocating per evaluation.
+    mutable std::vector<uint64_t> registers;
+    mutable std::vector<const std::vector<unsigned char> *> bindings;
+
+    CompiledExpr() : resultRegister(0) {}
+
+    /// Look up the binding of each array of the program in \a a.
+    void bind(const Assignment &a,
+              const std::vector<unsigned char> **bindings) const;
+
+    /// Run instruction \a pc on the registers \a r.
+    ///
+    /// \return False if it cannot be evaluated.
+    bool execute(unsigned pc, uint64_t *r,
+                 const std::vector<unsigned char> *const *bindings,
+                 bool allowFreeValues) const;
+
+  public:
+    ~CompiledExpr();
+
+    /// compile - Compile \a e, or return null if it cannot be compiled.
+    static CompiledExpr *compile(const ref<Expr> &e);
+
+    /// getMemoryUsage - The bytes the program takes.
+    uint64_t getMemoryUsage() const;
+
+    /// run - Evaluate the program under \a a.
+    ///
+    /// \return True if the program could be evaluated to \a result.
+    bool run(const Assignment &a, uint64_t &result) const;
+
+    /// runAll - Evaluate the program under each of \a as in a single pass
+    /// over the instructions, as evaluateAll() does.
+    void runAll(const std::vector<const Assignment *> &as,
+                std::vector<uint64_t> &results,
+                std::vector<char> &evaluated) const;
+  };
+
+  /// CompiledExprCache - The compiled programs of the expressions some owner
+  /// evaluates repeatedly, so the cost of compiling is paid once. The cache
+  /// lives and is accounted for with its owner, e.g. a solver cache which
+  /// drops it along with the assignments it evaluates.
+  class CompiledExprCache {
+    struct Entry {
+      // Keeps the expression, and thereby its address, alive.
+      ref<Expr> expr;
+      std::unique_ptr<CompiledExpr> program;
+    };
+    std::unordered_map<const Expr *, Entry> cache;
+    uint64_t bytes;
+
+  public:
+    /// The cache is cleared when it holds this many programs.
+    enum : unsigned { MaxSize = 1 << 14 };
+
+    CompiledExprCache() : bytes(0) {}
+
+    /// get - Return the compiled program for \a e, or null if it cannot be
+    /// compiled.
+    const CompiledExpr *get(const ref<Expr> &e);
+
+    /// evaluate - Evaluate \a e under \a a using its cached compiled program.
+    ///
+    /// \return True if \a e could be evaluated to \a result this way.
+    bool evaluate(const ref<Expr> &e, const Assignment &a, uint64_t &result);
+
+    /// evaluateAll - Evaluate \a e under each of \a as using its cached
+    /// compiled program, setting results[k] to its value under as[k] where
+    /// evaluated[k] is true.
+    void evaluateAll(const ref<Expr> &e,
+                     const std::vector<const Assignment *> &as,
+                     std::vector<uint64_t> &results,
+                     std::vector<char> &evaluated);
+
+    /// getMemoryUsage - The bytes taken by the cached programs.
+    uint64_t getMemoryUsage() const { return bytes; }
+
+    void clear() {
+      cache.clear();
+      bytes = 0;
+    }
+  };
+}
+
+#endif
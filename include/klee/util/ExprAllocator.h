@@ -0,0 +1,44 @@
+//===-- ExprAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRALLOCATOR_H
+#define KLEE_EXPRALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace klee {
+
+/// Allocator backing the class-specific `operator new`/`operator delete` of
+/// Expr and UpdateNode.
+///
+/// By default nodes come from the global heap. With -expr-arena, nodes are
+/// carved out of large slabs instead and freed nodes are kept on per-thread,
+/// per-size free lists for reuse, which avoids allocator overhead and heap
+/// fragmentation for the millions of small, fixed-size nodes created during
+/// a run. Slabs are never returned to the system.
+class ExprAllocator {
+public:
+  static void *allocate(std::size_t size);
+  static void deallocate(void *p, std::size_t size);
+
+  /// Returns true if nodes are currently allocated from slabs.
+  static bool isArenaEnabled();
+
+  /// Total number of bytes reserved for slabs, over all threads.
+  static uint64_t getReservedBytes();
+
+  /// Number of bytes of slab memory currently handed out to live nodes, over
+  /// all threads.
+  static uint64_t getLiveBytes();
+};
+
+} // End klee namespace
+
+#endif /* KLEE_EXPRALLOCATOR_H */
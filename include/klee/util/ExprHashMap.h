@@ -12,18 +12,9 @@
 
 #include "klee/Expr.h"
 
-#include <ciso646>
-#ifdef _LIBCPP_VERSION
-#include <unordered_map>
-#include <unordered_set>
-#define unordered_map std::unordered_map
-#define unordered_set std::unordered_set
-#else
-#include <tr1/unordered_map>
-#include <tr1/unordered_set>
-#define unordered_map std::tr1::unordered_map
-#define unordered_set std::tr1::unordered_set
-#endif
+#include <cstddef>
+#include <utility>
+#include <vector>
 
 namespace klee {
 
@@ -33,30 +24,184 @@ namespace klee {
         return e->hash();
       }
     };
-    
+
     struct ExprCmp {
       bool operator()(const ref<Expr> &a, const ref<Expr> &b) const {
         return a==b;
       }
     };
+
+    struct PairKey {
+      template <class V> static const ref<Expr> &get(const V &v) {
+        return v.first;
+      }
+    };
+
+    struct SelfKey {
+      static const ref<Expr> &get(const ref<Expr> &v) { return v; }
+    };
   }
-  
-  template<class T> 
-  class ExprHashMap : 
-
-    public unordered_map<ref<Expr>,
-                         T,
-                         klee::util::ExprHash,
-                         klee::util::ExprCmp> {
+
+  /// A hash table of entries keyed by structurally compared expressions,
+  /// stored inline in a single array with linear probing, using the hash
+  /// cached in each expression. An empty bucket holds a null key.
+  ///
+  /// Unlike for the standard containers, inserting may move the other
+  /// entries, invalidating iterators and references to them.
+  template <class V, class KeyOf> class ExprHashTable {
+  public:
+    typedef V value_type;
+
+    template <class E> class Iterator {
+      friend class ExprHashTable;
+      E *ptr, *end;
+
+      Iterator(E *ptr, E *end) : ptr(ptr), end(end) { skip(); }
+      void skip() {
+        while (ptr != end && KeyOf::get(*ptr).isNull())
+          ++ptr;
+      }
+
+    public:
+      Iterator() : ptr(0), end(0) {}
+      template <class F>
+      Iterator(const Iterator<F> &it) : ptr(it.ptr), end(it.end) {}
+
+      E &operator*() const { return *ptr; }
+      E *operator->() const { return ptr; }
+      Iterator &operator++() {
+        ++ptr;
+        skip();
+        return *this;
+      }
+      template <class F> bool operator==(const Iterator<F> &b) const {
+        return ptr == b.ptr;
+      }
+      template <class F> bool operator!=(const Iterator<F> &b) const {
+        return ptr != b.ptr;
+      }
+
+      template <class F> friend class Iterator;
+    };
+
+    typedef Iterator<V> iterator;
+    typedef Iterator<const V> const_iterator;
+
+  private:
+    std::vector<V> buckets;
+    size_t entries;
+
+    size_t home(const ref<Expr> &key) const {
+      unsigned h = key->hash();
+      h ^= h >> 16;
+      h *= 0x45d9f3b;
+      h ^= h >> 16;
+      return h & (buckets.size() - 1);
+    }
+
+    /// Returns the bucket holding \a key, or the empty one it would go into.
+    size_t lookup(const ref<Expr> &key) const {
+      size_t mask = buckets.size() - 1;
+      for (size_t i = home(key);; i = (i + 1) & mask) {
+        const ref<Expr> &k = KeyOf::get(buckets[i]);
+        if (k.isNull() || k == key)
+          return i;
+      }
+    }
+
+    void grow() {
+      std::vector<V> old(buckets.size() ? 2 * buckets.size() : 16);
+      old.swap(buckets);
+      for (V &v : old)
+        if (!KeyOf::get(v).isNull())
+          buckets[lookup(KeyOf::get(v))] = v;
+    }
+
+    iterator at(size_t i) {
+      return iterator(&buckets[0] + i, &buckets[0] + buckets.size());
+    }
+
+  public:
+    ExprHashTable() : entries(0) {}
+
+    iterator begin() {
+      return iterator(buckets.data(), buckets.data() + buckets.size());
+    }
+    iterator end() {
+      return iterator(buckets.data() + buckets.size(),
+                      buckets.data() + buckets.size());
+    }
+    const_iterator begin() const {
+      return const_iterator(buckets.data(), buckets.data() + buckets.size());
+    }
+    const_iterator end() const {
+      return const_iterator(buckets.data() + buckets.size(),
+                            buckets.data() + buckets.size());
+    }
+
+    size_t size() const { return entries; }
+    bool empty() const { return entries == 0; }
+
+    iterator find(const ref<Expr> &key) {
+      if (!entries)
+        return end();
+      size_t i = lookup(key);
+      return KeyOf::get(buckets[i]).isNull() ? end() : at(i);
+    }
+    const_iterator find(const ref<Expr> &key) const {
+      return const_cast<ExprHashTable *>(this)->find(key);
+    }
+    size_t count(const ref<Expr> &key) const { return find(key) != end(); }
+
+    std::pair<iterator, bool> insert(const V &v) {
+      // at most three quarters full
+      if (4 * (entries + 1) > 3 * buckets.size())
+        grow();
+      size_t i = lookup(KeyOf::get(v));
+      if (!KeyOf::get(buckets[i]).isNull())
+        return std::make_pair(at(i), false);
+      buckets[i] = v;
+      ++entries;
+      return std::make_pair(at(i), true);
+    }
+
+    size_t erase(const ref<Expr> &key) {
+      if (!entries)
+        return 0;
+      size_t i = lookup(key), mask = buckets.size() - 1;
+      if (KeyOf::get(buckets[i]).isNull())
+        return 0;
+      // Shift back the entries after it which would no longer be found.
+      for (size_t j = (i + 1) & mask; !KeyOf::get(buckets[j]).isNull();
+           j = (j + 1) & mask) {
+        size_t h = home(KeyOf::get(buckets[j]));
+        if ((j > i && (h <= i || h > j)) || (j < i && h <= i && h > j)) {
+          buckets[i] = buckets[j];
+          i = j;
+        }
+      }
+      buckets[i] = V();
+      --entries;
+      return 1;
+    }
+
+    void clear() {
+      std::vector<V>().swap(buckets);
+      entries = 0;
+    }
   };
-  
-  typedef unordered_set<ref<Expr>,
-                        klee::util::ExprHash,
-                        klee::util::ExprCmp> ExprHashSet;
 
-}
+  template <class T>
+  class ExprHashMap
+      : public ExprHashTable<std::pair<ref<Expr>, T>, util::PairKey> {
+  public:
+    T &operator[](const ref<Expr> &key) {
+      return this->insert(std::make_pair(key, T())).first->second;
+    }
+  };
 
-#undef unordered_map
-#undef unordered_set
+  typedef ExprHashTable<ref<Expr>, util::SelfKey> ExprHashSet;
+
+}
 
 #endif
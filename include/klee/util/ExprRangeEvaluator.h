@@ -12,6 +12,7 @@
 
 #include "klee/Expr.h"
 #include "klee/util/Bits.h"
+#include "klee/util/ExprHashMap.h"
 
 namespace klee {
 
@@ -54,9 +55,19 @@ public:
 
 template<class T>
 class ExprRangeEvaluator {
+  /// The ranges of the expressions evaluated so far, which only depend on
+  /// the expressions and the initial read ranges.
+  ExprHashMap<T> cache;
+
+  T evaluateActual(const ref<Expr> &e);
+
 protected:
   /// getInitialReadRange - Return a range for the initial value of the given
   /// array (which may be constant), for the given range of indices.
+  ///
+  /// Evaluated ranges are cached, so implementations whose result changes
+  /// over time (e.g. when the possible values of an array are narrowed)
+  /// must call clearCache() when it does.
   virtual T getInitialReadRange(const Array &os, T index) = 0;
 
   T evalRead(const UpdateList &ul, T index);
@@ -66,6 +77,10 @@ public:
   virtual ~ExprRangeEvaluator() {}
 
   T evaluate(const ref<Expr> &e);
+
+  /// Forgets the ranges evaluated so far.
+  void clearCache() { cache.clear(); }
+  size_t getCacheSize() const { return cache.size(); }
 };
 
 template<class T>
@@ -91,6 +106,19 @@ T ExprRangeEvaluator<T>::evalRead(const UpdateList &ul,
 
 template<class T>
 T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
+  if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e))
+    return T(ce);
+
+  typename ExprHashMap<T>::iterator it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+  T res = evaluateActual(e);
+  cache.insert(std::make_pair(e, res));
+  return res;
+}
+
+template<class T>
+T ExprRangeEvaluator<T>::evaluateActual(const ref<Expr> &e) {
   switch (e->getKind()) {
   case Expr::Constant:
     return T(cast<ConstantExpr>(e));
@@ -107,6 +135,9 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     return evalRead(re->updates, index);
   }
 
+  case Expr::WideRead:
+    return evaluate(cast<WideReadExpr>(e)->lower());
+
   case Expr::Select: {
     const SelectExpr *se = cast<SelectExpr>(e);
     T cond = evaluate(se->cond);
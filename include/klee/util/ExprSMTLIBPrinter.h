@@ -113,7 +113,9 @@ public:
   enum AbbreviationMode {
     ABBR_NONE, ///< Do not abbreviate.
     ABBR_LET,  ///< Abbreviate with let.
-    ABBR_NAMED ///< Abbreviate with :named annotations.
+    ABBR_NAMED, ///< Abbreviate with :named annotations.
+    ABBR_DEFINE ///< Abbreviate with define-fun commands printed before the
+                ///< assert first using them.
   };
 
   /// Different supported SMTLIBv2 sorts (a.k.a type) in QF_AUFBV
@@ -216,6 +218,10 @@ protected:
   /// Set of expressions seen during scan.
   std::set<ref<Expr> > seenExprs;
 
+  /// The selects of the bytes of each wide read met, built once per print
+  /// so that the scan, the bindings and the printing all see the same tree.
+  std::map<ref<Expr>, ref<Expr> > loweredWideReads;
+
   typedef std::map<const ref<Expr>, int> BindingMap;
 
   /// Let expression binding number map. Under the :named abbreviation mode,
@@ -228,6 +234,11 @@ protected:
   /// Exprs in orderedBindings[0] have no dependencies.
   std::vector<BindingMap> orderedBindings;
 
+  /// Under the define-fun abbreviation mode, the update nodes scanned so far
+  /// and the binding numbers of those already defined.
+  std::set<const UpdateNode *> scannedUpdates;
+  std::map<const UpdateNode *, int> updateBindings;
+
   /// Output stream to write to
   llvm::raw_ostream *o;
 
@@ -292,11 +303,20 @@ protected:
   /// the usedArrays vector.
   void scan(const ref<Expr> &e);
 
+  /// Returns the lowered form of \a e, a wide read, see loweredWideReads.
+  const ref<Expr> &lower(const ref<Expr> &e);
+
   /// Scan bindings for expression intra-dependencies. The result is written
   /// to the orderedBindings vector that is later used for nested expression
   /// printing in the let abbreviation mode.
   void scanBindingExprDeps();
 
+  /// Print a define-fun command for each binding and update node e uses
+  /// which was not defined yet, dependencies first, under the define-fun
+  /// abbreviation mode.
+  void printDefinitions(const ref<Expr> &e);
+  void printUpdateDefinitions(const UpdateNode *un, const Array *root);
+
   /* Rules of recursion for "Special Expression handlers" and
    *printSortArgsExpr()
    *
@@ -11,12 +11,18 @@
 #define KLEE_EXPRUTIL_H
 
 #include "klee/util/ExprVisitor.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace klee {
   class Array;
   class Expr;
   class ReadExpr;
+  class UpdateList;
+  class UpdateNode;
   template<typename T> class ref;
 
   /// Find all ReadExprs used in the expression DAG. If visitUpdates
@@ -40,11 +46,55 @@ namespace klee {
                            std::vector<const Array*> &results);
 
   class ConstantArrayFinder : public ExprVisitor {
+  protected:
+    ExprVisitor::Action visitRead(const ReadExpr &re);
+    ExprVisitor::Action visitWideRead(const WideReadExpr &wre);
+
+  public:
+    std::set<const Array *> results;
+  };
+
+  /// Finds the symbolic arrays which are only read at constant indices,
+  /// through at most maxUpdates writes, so that their bytes can be encoded
+  /// as separate variables rather than with the theory of arrays.
+  class ScalarArrayFinder : public ExprVisitor {
+    unsigned maxUpdates;
+    std::set<const Array *> excluded;
+
   protected:
     ExprVisitor::Action visitRead(const ReadExpr &re);
 
   public:
     std::set<const Array *> results;
+
+    explicit ScalarArrayFinder(unsigned maxUpdates) : maxUpdates(maxUpdates) {}
+  };
+
+  /// Measures the size and shape of a set of expressions, such as the
+  /// constraints and the expression of a query, sharing the nodes common
+  /// to several of them.
+  class ExprShapeMeasurer {
+    /// The depth of each expression node, other than constants, seen.
+    std::unordered_map<const Expr *, uint64_t> depths;
+    /// The depth of the updates from each update node to the array.
+    std::unordered_map<const UpdateNode *, uint64_t> updateDepths;
+    std::unordered_set<const Array *> arrays;
+    uint64_t depth = 0;
+
+    uint64_t measure(const ref<Expr> &e);
+    uint64_t measure(const UpdateList &ul);
+
+  public:
+    void add(const ref<Expr> &e);
+
+    /// The distinct nodes, other than constants, of the expressions.
+    uint64_t getNodes() const { return depths.size(); }
+    /// The longest chain of nodes, through the updates of the reads.
+    uint64_t getDepth() const { return depth; }
+    /// The distinct arrays read.
+    uint64_t getArrays() const { return arrays.size(); }
+    /// The distinct updates of the arrays read.
+    uint64_t getUpdates() const { return updateDepths.size(); }
   };
 }
 
@@ -12,6 +12,11 @@
 
 #include "ExprHashMap.h"
 
+#include "llvm/ADT/DenseMap.h"
+
+#include <utility>
+#include <vector>
+
 namespace klee {
   class ExprVisitor {
   protected:
@@ -50,6 +55,9 @@ namespace klee {
 
     virtual Action visitNotOptimized(const NotOptimizedExpr&);
     virtual Action visitRead(const ReadExpr&);
+    /// By default, visits the concatenation of the reads of the bytes, and
+    /// keeps the wide read unless that changed.
+    virtual Action visitWideRead(const WideReadExpr&);
     virtual Action visitSelect(const SelectExpr&);
     virtual Action visitConcat(const ConcatExpr&);
     virtual Action visitExtract(const ExtractExpr&);
@@ -81,11 +89,38 @@ namespace klee {
     virtual Action visitSge(const SgeExpr&);
 
   private:
-    typedef ExprHashMap< ref<Expr> > visited_ty;
+    /// An expression whose children are being visited.
+    struct Frame {
+      ref<Expr> e;
+      /// The visited children, at most those of a SelectExpr.
+      ref<Expr> kids[3];
+      /// The number of children visited so far.
+      unsigned next;
+      bool rebuild;
+      /// Whether the children are done and the rebuilt expression is being
+      /// visited again (only for recursive visitors).
+      bool revisiting;
+
+      explicit Frame(const ref<Expr> &_e)
+          : e(_e), next(0), rebuild(false), revisiting(false) {}
+    };
+
+    /// The results of visiting each expression, keyed by its address. The
+    /// visited expression is kept alongside, so that the address cannot be
+    /// reused while the entry exists.
+    typedef llvm::DenseMap<const Expr *, std::pair<ref<Expr>, ref<Expr> > >
+        visited_ty;
     visited_ty visited;
     bool recursive;
+    /// The expressions being visited; visits from visit hooks push above
+    /// the frames of the visit they are nested in.
+    std::vector<Frame> stack;
 
-    ref<Expr> visitActual(const ref<Expr> &e);
+    /// Starts visiting \a e: returns true with the result in \a result if
+    /// it is known without visiting children, otherwise pushes a frame.
+    bool enter(const ref<Expr> &e, ref<Expr> &result);
+    /// Ends visiting the expression of the top frame, and pops it.
+    ref<Expr> leave(ref<Expr> e);
     
   public:
     // apply the visitor to the expression and return a possibly
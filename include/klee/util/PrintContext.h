@@ -11,6 +11,7 @@
 #define PRINTCONTEXT_H_
 
 #include "klee/Expr.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
 #include <sstream>
 #include <string>
@@ -80,17 +81,18 @@ public:
 
   /// write - Output a string to the stream and update the
   /// position. The stream should not have any newlines.
-  void write(const std::string &s) {
+  void write(llvm::StringRef s) {
     os << s;
-    pos += s.length();
+    pos += s.size();
   }
 
+  /// Print elt straight to the stream, counting the characters it took
+  /// rather than formatting it into a temporary string first.
   template <typename T>
-  PrintContext &operator<<(T elt) {
-    std::string str;
-    llvm::raw_string_ostream ss(str);
-    ss << elt;
-    write(ss.str());
+  PrintContext &operator<<(const T &elt) {
+    uint64_t start = os.tell();
+    os << elt;
+    pos += os.tell() - start;
     return *this;
   }
 
@@ -26,6 +26,21 @@ namespace llvm {
 
 namespace klee {
 
+/// Reference counting policy hooks used by ref<T>.
+///
+/// ref<T> never touches T::refCount directly. Instead it calls
+/// refCountInc() and refCountDec(), which are overloaded on the type of the
+/// counter, so a class selects its counting scheme by the type of its
+/// refCount member. Plain integers count non-atomically (the object must
+/// then stay confined to a single thread); see BiasedRefCount.h for a
+/// counter that can be shared across threads.
+template <typename Count> inline void refCountInc(Count &count) { ++count; }
+
+/// Decrement \p count and return true if the referenced object is dead.
+template <typename Count> inline bool refCountDec(Count &count) {
+  return --count == 0;
+}
+
 template<class T>
 class ref {
   T *ptr;
@@ -38,11 +53,11 @@ public:
 private:
   void inc() const {
     if (ptr)
-      ++ptr->refCount;
+      refCountInc(ptr->refCount);
   }
 
   void dec() const {
-    if (ptr && --ptr->refCount == 0)
+    if (ptr && refCountDec(ptr->refCount))
       delete ptr;
   }
 
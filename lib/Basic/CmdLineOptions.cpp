@@ -42,6 +42,12 @@ cl::opt<bool> UseFastCexSolver(
     cl::desc("Enable an experimental range-based solver (default=false)"),
     cl::cat(SolvingCat));
 
+cl::opt<bool> UseKnownBitsSolver(
+    "use-known-bits-solver", cl::init(true),
+    cl::desc("Try to decide queries by propagating the known bits of their "
+             "expressions before the counterexample cache (default=true)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> UseCexCache("use-cex-cache", cl::init(true),
                           cl::desc("Use the counterexample cache (default=true)"),
                           cl::cat(SolvingCat));
@@ -50,17 +56,64 @@ cl::opt<bool> UseBranchCache("use-branch-cache", cl::init(true),
                              cl::desc("Use the branch cache (default=true)"),
                              cl::cat(SolvingCat));
 
+cl::opt<bool> UseCanonicalCache(
+    "use-canonical-cache", cl::init(false),
+    cl::desc("Cache query results in memory independently of the names of "
+             "the arrays, below the branch cache, so that queries on arrays "
+             "made symbolic by the same code share results (default=false)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     UseIndependentSolver("use-independent-solver", cl::init(true),
                          cl::desc("Use constraint independence (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<std::string> PersistentQueryCache(
+    "persistent-query-cache",
+    cl::desc("Cache the results of queries reaching the core solver in the "
+             "given SQLite database, which can be shared by concurrent and "
+             "subsequent runs (default=off)"),
+    cl::value_desc("path"), cl::cat(SolvingCat));
+
+cl::opt<std::string> SharedQueryCache(
+    "shared-query-cache",
+    cl::desc("Share the results of queries reaching the core solver with the "
+             "concurrent runs using the POSIX shared memory object of the "
+             "given name (default=off)"),
+    cl::value_desc("name"), cl::cat(SolvingCat));
+
+cl::opt<unsigned> SharedQueryCacheSize(
+    "shared-query-cache-size", cl::init(64),
+    cl::desc("Size of the shared query cache in MB, if this run creates it "
+             "(default=64)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
              "with the results of the core solver (default=false)"),
     cl::cat(SolvingCat));
 
+cl::opt<bool> AsyncCrossCheck(
+    "async-crosscheck", cl::init(false),
+    cl::desc("Crosscheck the solver for --debug-validate-solver and "
+             "--debug-crosscheck-core-solver in a separate process, without "
+             "waiting for its answers (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<double> CrossCheckRatio(
+    "crosscheck-ratio", cl::init(1.0),
+    cl::desc("Fraction of the queries crosschecked with --async-crosscheck "
+             "(default=1.0)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CrossCheckBacklog(
+    "crosscheck-backlog", cl::init(64),
+    cl::desc("Maximum number of queries waiting to be crosschecked with "
+             "--async-crosscheck; queries beyond it are not checked "
+             "(default=64)"),
+    cl::cat(SolvingCat));
+
 cl::opt<std::string> MinQueryTimeToLog(
     "min-query-time-to-log",
     cl::desc("Set time threshold for queries logged in files. "
@@ -78,11 +131,41 @@ cl::opt<std::string> MaxCoreSolverTime(
              "Enables --use-forked-solver"),
     cl::cat(SolvingCat));
 
+cl::opt<bool> AdaptiveSolverTimeout(
+    "adaptive-solver-timeout", cl::init(false),
+    cl::desc("Give queries whose shape (their structure, ignoring constants "
+             "and array names) almost always timed out only a fraction of "
+             "--max-solver-time (default=false)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> UseForkedCoreSolver(
     "use-forked-solver",
     cl::desc("Run the core SMT solver in a forked process (default=true)"),
     cl::init(true), cl::cat(SolvingCat));
 
+cl::opt<unsigned> SolverWorkers(
+    "solver-workers",
+    cl::desc("Number of long-lived processes running the forked core solver, "
+             "which are replaced when a query times out or crashes; 0 forks "
+             "a process per query (default=2)"),
+    cl::init(2), cl::cat(SolvingCat));
+
+cl::opt<unsigned> SpeculativeQueries(
+    "speculative-queries",
+    cl::desc("Number of solver workers which may solve queries the executor "
+             "is likely to issue later, such as the branch condition a state "
+             "stopped at when another one is selected, while the executor "
+             "runs; one worker is always kept for the other queries "
+             "(default=0)"),
+    cl::init(0), cl::cat(SolvingCat));
+
+cl::opt<unsigned> ConstructCacheSize(
+    "construct-cache-size",
+    cl::desc("Number of expressions whose encoding for the core SMT solver "
+             "is kept across queries, or 0 to discard the encodings after "
+             "each query (default=0)"),
+    cl::init(0), cl::cat(SolvingCat));
+
 cl::opt<bool> CoreSolverOptimizeDivides(
     "solver-optimize-divides",
     cl::desc("Optimize constant divides into add/shift/multiplies before "
@@ -103,7 +186,13 @@ cl::bits<QueryLoggingSolverType> QueryLoggingOptions(
             "All queries reaching the solver in .kquery (KQuery) format"),
         clEnumValN(
             SOLVER_SMTLIB, "solver:smt2",
-            "All queries reaching the solver in .smt2 (SMT-LIBv2) format")
+            "All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY, "all:bin",
+                   "All queries in the binary .kqlog format, printed by "
+                   "kleaver --print-query-log"),
+        clEnumValN(SOLVER_BINARY, "solver:bin",
+                   "All queries reaching the solver in the binary .kqlog "
+                   "format")
             KLEE_LLVM_CL_VAL_END),
     cl::CommaSeparated, cl::cat(SolvingCat));
 
@@ -197,10 +286,25 @@ cl::opt<CoreSolverType> CoreSolverToUse(
                clEnumValN(METASMT_SOLVER, "metasmt",
                           "metaSMT" METASMT_IS_DEFAULT_STR),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
-               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR)
+               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+               clEnumValN(CADICAL_SOLVER, "cadical",
+                          "Bit-blasting to the CaDiCaL SAT solver"),
+               clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                          "Race the backends given by --portfolio-solvers")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(DEFAULT_CORE_SOLVER), cl::cat(SolvingCat));
 
+cl::list<CoreSolverType> PortfolioSolvers(
+    "portfolio-solvers",
+    cl::desc("Specify the backends raced by --solver-backend=portfolio, "
+             "separated by a comma (default=all available)"),
+    cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+               clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+               clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(CADICAL_SOLVER, "cadical", "CaDiCaL")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::CommaSeparated, cl::cat(SolvingCat));
+
 cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
     "debug-crosscheck-core-solver",
     cl::desc(
@@ -209,6 +313,7 @@ cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
                clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(CADICAL_SOLVER, "cadical", "CaDiCaL"),
                clEnumValN(NO_SOLVER, "none", "Do not crosscheck (default)")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(NO_SOLVER), cl::cat(SolvingCat));
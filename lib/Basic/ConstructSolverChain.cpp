@@ -22,10 +22,15 @@ Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             std::string queryBinaryLogPath,
+                             std::string baseSolverQueryBinaryLogPath) {
   Solver *solver = coreSolver;
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
+  if (AdaptiveSolverTimeout)
+    solver = createAdaptiveTimeoutSolver(solver);
+
   if (QueryLoggingOptions.isSet(SOLVER_KQUERY)) {
     solver = createKQueryLoggingSolver(solver, baseSolverQueryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries);
     klee_message("Logging queries that reach solver in .kquery format to %s\n",
@@ -38,6 +43,26 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (QueryLoggingOptions.isSet(SOLVER_BINARY)) {
+    solver = createBinaryQueryLoggingSolver(solver, baseSolverQueryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries);
+    klee_message("Logging queries that reach solver in .kqlog format to %s\n",
+                 baseSolverQueryBinaryLogPath.c_str());
+  }
+
+  if (!PersistentQueryCache.empty()) {
+    solver = createPersistentCachingSolver(solver, PersistentQueryCache);
+    klee_message("Using persistent query cache %s\n",
+                 PersistentQueryCache.c_str());
+  }
+
+  if (!SharedQueryCache.empty()) {
+    solver = createSharedMemoryCachingSolver(solver, SharedQueryCache,
+                                             SharedQueryCacheSize);
+    klee_message("Using shared query cache %s\n", SharedQueryCache.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
@@ -47,6 +72,12 @@ Solver *constructSolverChain(Solver *coreSolver,
   if (UseCexCache)
     solver = createCexCachingSolver(solver);
 
+  if (UseKnownBitsSolver)
+    solver = createKnownBitsSolver(solver);
+
+  if (UseCanonicalCache)
+    solver = createCanonicalCachingSolver(solver);
+
   if (UseBranchCache)
     solver = createCachingSolver(solver);
 
@@ -54,7 +85,11 @@ Solver *constructSolverChain(Solver *coreSolver,
     solver = createIndependentSolver(solver);
 
   if (DebugValidateSolver)
-    solver = createValidatingSolver(solver, coreSolver);
+    solver = AsyncCrossCheck
+                 ? createAsyncValidatingSolver(solver, coreSolver,
+                                               CrossCheckRatio,
+                                               CrossCheckBacklog)
+                 : createValidatingSolver(solver, coreSolver);
 
   if (QueryLoggingOptions.isSet(ALL_KQUERY)) {
     solver = createKQueryLoggingSolver(solver, queryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries);
@@ -67,9 +102,24 @@ Solver *constructSolverChain(Solver *coreSolver,
     klee_message("Logging all queries in .smt2 format to %s\n",
                  querySMT2LogPath.c_str());
   }
+
+  if (QueryLoggingOptions.isSet(ALL_BINARY)) {
+    solver = createBinaryQueryLoggingSolver(solver, queryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries);
+    klee_message("Logging all queries in .kqlog format to %s\n",
+                 queryBinaryLogPath.c_str());
+  }
+
   if (DebugCrossCheckCoreSolverWith != NO_SOLVER) {
     Solver *oracleSolver = createCoreSolver(DebugCrossCheckCoreSolverWith);
-    solver = createValidatingSolver(/*s=*/solver, /*oracle=*/oracleSolver);
+    solver = AsyncCrossCheck
+                 ? createAsyncValidatingSolver(/*s=*/solver,
+                                               /*oracle=*/oracleSolver,
+                                               CrossCheckRatio,
+                                               CrossCheckBacklog)
+                 : createValidatingSolver(/*s=*/solver,
+                                          /*oracle=*/oracleSolver);
   }
 
   return solver;
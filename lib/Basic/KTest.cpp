@@ -9,9 +9,23 @@
 
 #include "klee/Internal/ADT/KTest.h"
 
+#include "klee/Config/config.h"
+
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
 
 #define KTEST_VERSION 3
 #define KTEST_MAGIC_SIZE 5
@@ -238,3 +252,382 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+
+/***/
+
+// A container is its header followed by records, each a kind byte and the
+// size of its payload:
+//   'N': name id, name         - an object name, given before its first use
+//   'T': test id, test         - a test case
+//   'Z': test id, size, data   - a test case compressed with zlib
+// where a test is laid out as in a .ktest file, except that strings keep
+// their terminator and objects refer to their names by id, so that readers
+// can point into the mapped file.
+
+#define KTESTS_VERSION 1
+#define KTESTS_MAGIC_SIZE 6
+#define KTESTS_MAGIC "KTESTS"
+#define KTESTS_HEADER_SIZE (KTESTS_MAGIC_SIZE + 4)
+#define KTESTS_RECORD_HEADER_SIZE 5
+
+static unsigned get_uint32(const unsigned char *data) {
+  return (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
+}
+
+static void put_uint32(std::vector<unsigned char> &out, unsigned value) {
+  out.push_back(value>>24);
+  out.push_back(value>>16);
+  out.push_back(value>> 8);
+  out.push_back(value>> 0);
+}
+
+static void put_string(std::vector<unsigned char> &out, const char *value) {
+  unsigned len = strlen(value) + 1;
+  put_uint32(out, len);
+  out.insert(out.end(), value, value + len);
+}
+
+namespace {
+  /// Reads the fields of a record payload, failing past its end.
+  struct Cursor {
+    unsigned char *pos, *end;
+
+    bool uint32(unsigned &value) {
+      if (end - pos < 4)
+        return false;
+      value = get_uint32(pos);
+      pos += 4;
+      return true;
+    }
+
+    bool bytes(unsigned n, unsigned char *&value) {
+      if ((size_t) (end - pos) < n)
+        return false;
+      value = pos;
+      pos += n;
+      return true;
+    }
+
+    bool string(char *&value) {
+      unsigned len;
+      unsigned char *data;
+      if (!uint32(len) || !len || !bytes(len, data) || data[len - 1])
+        return false;
+      value = (char*) data;
+      return true;
+    }
+  };
+}
+
+static int kTests_checkHeader(const unsigned char *data, size_t size) {
+  return size >= KTESTS_HEADER_SIZE &&
+         !memcmp(data, KTESTS_MAGIC, KTESTS_MAGIC_SIZE) &&
+         get_uint32(data + KTESTS_MAGIC_SIZE) <= KTESTS_VERSION;
+}
+
+/// Calls visit(kind, payload) on each complete record of a mapped container
+/// and returns where they end.
+template <class Visit>
+static size_t kTests_scan(unsigned char *data, size_t size, Visit visit) {
+  size_t pos = KTESTS_HEADER_SIZE;
+  while (size - pos >= KTESTS_RECORD_HEADER_SIZE) {
+    size_t len = get_uint32(data + pos + 1);
+    if (size - pos - KTESTS_RECORD_HEADER_SIZE < len)
+      break;
+    Cursor payload = {data + pos + KTESTS_RECORD_HEADER_SIZE,
+                      data + pos + KTESTS_RECORD_HEADER_SIZE + len};
+    visit(data[pos], payload);
+    pos += KTESTS_RECORD_HEADER_SIZE + len;
+  }
+  return pos;
+}
+
+/// Registers the name of an 'N' record in names.
+template <class Names>
+static void kTests_addName(Cursor payload, Names &names) {
+  unsigned id;
+  char *name;
+  if (payload.uint32(id) && payload.string(name))
+    names[id] = name;
+}
+
+int kTest_isKTestContainer(const char *path) {
+  FILE *f = fopen(path, "rb");
+  unsigned char header[KTESTS_HEADER_SIZE];
+  int res;
+
+  if (!f)
+    return 0;
+  res = fread(header, KTESTS_HEADER_SIZE, 1, f)==1 &&
+        kTests_checkHeader(header, KTESTS_HEADER_SIZE);
+  fclose(f);
+
+  return res;
+}
+
+struct KTestWriter {
+  FILE *f;
+  int compress;
+  std::map<std::string, unsigned> names;
+};
+
+static int kTests_writeRecord(FILE *f, unsigned char kind,
+                              const std::vector<unsigned char> &payload) {
+  return fputc(kind, f)!=EOF && write_uint32(f, payload.size()) &&
+         (payload.empty() || fwrite(payload.data(), payload.size(), 1, f)==1);
+}
+
+KTestWriter *kTestWriter_open(const char *path, int compress) {
+  int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  struct stat st;
+  KTestWriter *w;
+
+  if (fd < 0)
+    return 0;
+  if (fstat(fd, &st) < 0)
+    goto error;
+
+  w = new KTestWriter();
+  w->compress = compress;
+  if (st.st_size == 0) {
+    unsigned char header[KTESTS_HEADER_SIZE];
+    memcpy(header, KTESTS_MAGIC, KTESTS_MAGIC_SIZE);
+    for (unsigned i = 0; i < 4; ++i)
+      header[KTESTS_MAGIC_SIZE + i] = KTESTS_VERSION >> (24 - 8 * i);
+    if (write(fd, header, KTESTS_HEADER_SIZE) != KTESTS_HEADER_SIZE)
+      goto error_writer;
+  } else {
+    // pick up the names already given and drop what a crash left behind
+    void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    size_t end;
+    if (data == MAP_FAILED)
+      goto error_writer;
+    if (!kTests_checkHeader((unsigned char*) data, st.st_size)) {
+      munmap(data, st.st_size);
+      goto error_writer;
+    }
+    std::map<unsigned, std::string> given;
+    end = kTests_scan((unsigned char*) data, st.st_size,
+                      [&given](unsigned char kind, Cursor payload) {
+                        if (kind == 'N')
+                          kTests_addName(payload, given);
+                      });
+    munmap(data, st.st_size);
+    for (auto &name : given)
+      w->names[name.second] = name.first;
+    if (end != (size_t) st.st_size && ftruncate(fd, end) < 0)
+      goto error_writer;
+  }
+
+  w->f = fdopen(fd, "ab");
+  if (!w->f)
+    goto error_writer;
+  return w;
+
+ error_writer:
+  delete w;
+ error:
+  close(fd);
+  return 0;
+}
+
+int kTestWriter_append(KTestWriter *w, KTest *bo, unsigned id) {
+  std::vector<unsigned char> test;
+  unsigned i;
+
+  put_uint32(test, KTEST_VERSION);
+  put_uint32(test, bo->numArgs);
+  for (i=0; i<bo->numArgs; i++)
+    put_string(test, bo->args[i]);
+  put_uint32(test, bo->symArgvs);
+  put_uint32(test, bo->symArgvLen);
+  put_uint32(test, bo->numObjects);
+  for (i=0; i<bo->numObjects; i++) {
+    KTestObject *o = &bo->objects[i];
+    auto name = w->names.insert(std::make_pair(std::string(o->name),
+                                               (unsigned) w->names.size()));
+    if (name.second) {
+      std::vector<unsigned char> record;
+      put_uint32(record, name.first->second);
+      put_string(record, o->name);
+      if (!kTests_writeRecord(w->f, 'N', record)) {
+        w->names.erase(name.first);
+        return 0;
+      }
+    }
+    put_uint32(test, name.first->second);
+    put_uint32(test, o->numBytes);
+    test.insert(test.end(), o->bytes, o->bytes + o->numBytes);
+  }
+
+  std::vector<unsigned char> record;
+  unsigned char kind = 'T';
+  put_uint32(record, id);
+#ifdef HAVE_ZLIB_H
+  if (w->compress) {
+    uLongf size = compressBound(test.size());
+    kind = 'Z';
+    put_uint32(record, test.size());
+    record.resize(8 + size);
+    if (compress2(&record[8], &size, test.data(), test.size(),
+                  Z_DEFAULT_COMPRESSION) != Z_OK)
+      return 0;
+    record.resize(8 + size);
+  } else
+#endif
+    record.insert(record.end(), test.begin(), test.end());
+
+  // a test is complete on disk once this returns
+  return kTests_writeRecord(w->f, kind, record) && fflush(w->f)==0;
+}
+
+void kTestWriter_close(KTestWriter *w) {
+  fclose(w->f);
+  delete w;
+}
+
+struct KTestReader {
+  unsigned char *data;
+  size_t size;
+  std::map<unsigned, char*> names;
+  /// The 'T' and 'Z' records, by index.
+  std::vector<std::pair<unsigned char, Cursor>> records;
+  /// The tests handed out, built on first use.
+  std::vector<KTest*> tests;
+  /// The decompressed forms of 'Z' records.
+  std::vector<unsigned char*> buffers;
+};
+
+KTestReader *kTestReader_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  void *data;
+  KTestReader *r;
+
+  if (fd < 0)
+    return 0;
+  if (fstat(fd, &st) < 0 || !st.st_size) {
+    close(fd);
+    return 0;
+  }
+  // private, so that the tests handed out may be modified as those read
+  // from a file can be
+  data = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return 0;
+  if (!kTests_checkHeader((unsigned char*) data, st.st_size)) {
+    munmap(data, st.st_size);
+    return 0;
+  }
+
+  r = new KTestReader();
+  r->data = (unsigned char*) data;
+  r->size = st.st_size;
+  // a torn last record is not part of the container
+  kTests_scan(r->data, r->size, [r](unsigned char kind, Cursor payload) {
+    if (kind == 'N')
+      kTests_addName(payload, r->names);
+    else if ((kind == 'T' || kind == 'Z') && payload.end - payload.pos >= 4)
+      r->records.push_back(std::make_pair(kind, payload));
+  });
+  r->tests.resize(r->records.size());
+  return r;
+}
+
+unsigned kTestReader_numTests(KTestReader *r) {
+  return r->records.size();
+}
+
+unsigned kTestReader_getId(KTestReader *r, unsigned index) {
+  return get_uint32(r->records[index].second.pos);
+}
+
+static void kTests_freeView(KTest *res) {
+  free(res->args);
+  free(res->objects);
+  free(res);
+}
+
+KTest *kTestReader_get(KTestReader *r, unsigned index) {
+  KTest *res;
+  unsigned i, id;
+
+  if (index >= r->records.size())
+    return 0;
+  if (r->tests[index])
+    return r->tests[index];
+
+  Cursor c = r->records[index].second;
+  c.uint32(id);
+  if (r->records[index].first == 'Z') {
+#ifdef HAVE_ZLIB_H
+    unsigned rawSize;
+    uLongf size;
+    unsigned char *buffer;
+    if (!c.uint32(rawSize) || !(buffer = (unsigned char*) malloc(rawSize)))
+      return 0;
+    size = rawSize;
+    if (uncompress(buffer, &size, c.pos, c.end - c.pos) != Z_OK ||
+        size != rawSize) {
+      free(buffer);
+      return 0;
+    }
+    r->buffers.push_back(buffer);
+    c.pos = buffer;
+    c.end = buffer + rawSize;
+#else
+    return 0;
+#endif
+  }
+
+  res = (KTest*) calloc(1, sizeof(*res));
+  if (!res)
+    return 0;
+
+  if (!c.uint32(res->version) || res->version > kTest_getCurrentVersion())
+    goto error;
+  if (!c.uint32(res->numArgs) || (size_t) (c.end - c.pos) < res->numArgs)
+    goto error;
+  res->args = (char**) calloc(res->numArgs, sizeof(*res->args));
+  if (!res->args)
+    goto error;
+  for (i=0; i<res->numArgs; i++)
+    if (!c.string(res->args[i]))
+      goto error;
+
+  if (!c.uint32(res->symArgvs) || !c.uint32(res->symArgvLen))
+    goto error;
+
+  if (!c.uint32(res->numObjects) || (size_t) (c.end - c.pos) < res->numObjects)
+    goto error;
+  res->objects = (KTestObject*) calloc(res->numObjects, sizeof(*res->objects));
+  if (!res->objects)
+    goto error;
+  for (i=0; i<res->numObjects; i++) {
+    KTestObject *o = &res->objects[i];
+    unsigned nameId;
+    if (!c.uint32(nameId) || !r->names.count(nameId))
+      goto error;
+    o->name = r->names[nameId];
+    if (!c.uint32(o->numBytes) || !c.bytes(o->numBytes, o->bytes))
+      goto error;
+  }
+
+  r->tests[index] = res;
+  return res;
+ error:
+  kTests_freeView(res);
+  return 0;
+}
+
+void kTestReader_close(KTestReader *r) {
+  for (auto test : r->tests)
+    if (test)
+      kTests_freeView(test);
+  for (auto buffer : r->buffers)
+    free(buffer);
+  munmap(r->data, r->size);
+  delete r;
+}
@@ -9,35 +9,94 @@
 
 #include "klee/Statistics.h"
 
+#include <cstdlib>
+#include <new>
 #include <vector>
 
 using namespace klee;
 
+namespace {
+const size_t CacheLineSize = 64;
+const unsigned ValuesPerLine = CacheLineSize / sizeof(uint64_t);
+}
+
+StatisticShard::StatisticShard(unsigned size)
+    : values(0), storage(0), size(0), next(0) {
+  resize(size);
+}
+
+StatisticShard::~StatisticShard() { free(storage); }
+
+void StatisticShard::resize(unsigned newSize) {
+  unsigned lines = (newSize + ValuesPerLine - 1) / ValuesPerLine;
+  void *newStorage;
+  if (posix_memalign(&newStorage, CacheLineSize,
+                     (lines ? lines : 1) * CacheLineSize))
+    throw std::bad_alloc();
+  std::atomic<uint64_t> *newValues =
+      static_cast<std::atomic<uint64_t> *>(newStorage);
+  for (unsigned i = 0; i != lines * ValuesPerLine; ++i)
+    new (&newValues[i]) std::atomic<uint64_t>(i < size ? get(i) : 0);
+  free(storage);
+  storage = newStorage;
+  values = newValues;
+  size = newSize;
+}
+
+thread_local StatisticShard *StatisticManager::localShard = 0;
+
 StatisticManager::StatisticManager()
   : enabled(true),
-    globalStats(0),
-    indexedStats(0),
+    shards(0),
+    indexedPages(0),
+    numIndexedPages(0),
     contextStats(0),
     index(0) {
 }
 
 StatisticManager::~StatisticManager() {
-  delete[] globalStats;
-  delete[] indexedStats;
+  StatisticShard *shard = shards.load();
+  while (shard) {
+    StatisticShard *next = shard->next;
+    delete shard;
+    shard = next;
+  }
+  useIndexedStats(0);
+}
+
+StatisticShard &StatisticManager::createLocalShard() {
+  // Shards are kept once their thread ends, so that what it counted is not
+  // lost.
+  StatisticShard *shard = new StatisticShard(stats.size());
+  shard->next = shards.load(std::memory_order_relaxed);
+  while (!shards.compare_exchange_weak(shard->next, shard,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed))
+    ;
+  localShard = shard;
+  return *shard;
 }
 
-void StatisticManager::useIndexedStats(unsigned totalIndices) {  
-  delete[] indexedStats;
-  indexedStats = new uint64_t[totalIndices * stats.size()];
-  memset(indexedStats, 0, sizeof(*indexedStats) * totalIndices * stats.size());
+void StatisticManager::useIndexedStats(unsigned totalIndices) {
+  if (indexedPages) {
+    for (unsigned i = 0, e = numIndexedPages * stats.size(); i != e; ++i)
+      delete[] indexedPages[i];
+    delete[] indexedPages;
+    indexedPages = 0;
+  }
+  if (!totalIndices)
+    return;
+  numIndexedPages = (totalIndices + IndexedPageSize - 1) >> IndexedPageShift;
+  indexedPages = new uint64_t *[numIndexedPages * stats.size()]();
 }
 
 void StatisticManager::registerStatistic(Statistic &s) {
-  delete[] globalStats;
+  // Statistics are registered during static initialization, before any
+  // other thread could be counting.
   s.id = stats.size();
   stats.push_back(&s);
-  globalStats = new uint64_t[stats.size()];
-  memset(globalStats, 0, sizeof(*globalStats)*stats.size());
+  for (StatisticShard *shard = shards.load(); shard; shard = shard->next)
+    shard->resize(stats.size());
 }
 
 int StatisticManager::getStatisticID(const std::string &name) const {
@@ -10,13 +10,30 @@
 #include "AddressSpace.h"
 #include "CoreStats.h"
 #include "Memory.h"
+#include "MemoryManager.h"
 #include "TimingSolver.h"
 
 #include "klee/Expr.h"
+#include "klee/OptionCategories.h"
 #include "klee/TimerStatIncrementer.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <unordered_set>
+#include <vector>
+
 using namespace klee;
 
+namespace {
+llvm::cl::opt<bool> BisectPointerResolution(
+    "bisect-pointer-resolution", llvm::cl::init(false),
+    llvm::cl::desc("Resolve symbolic pointers by first bisecting the "
+                   "address-ordered objects for the range the pointer may "
+                   "fall into, and only checking the objects within that "
+                   "range (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+}
+
 ///
 
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
@@ -224,6 +241,11 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
     if (!solver->getValue(state, p, cex))
       return true;
     uint64_t example = cex->getZExtValue();
+
+    if (BisectPointerResolution)
+      return resolveByBisection(state, solver, p, example, rl, maxResolutions,
+                                timeout, timer);
+
     MemoryObject hack(example);
 
     MemoryMap::iterator oi = objects.upper_bound(&hack);
@@ -276,12 +298,116 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
   return false;
 }
 
+bool AddressSpace::resolveByBisection(ExecutionState &state,
+                                      TimingSolver *solver, ref<Expr> p,
+                                      uint64_t example, ResolutionList &rl,
+                                      unsigned maxResolutions,
+                                      time::Span timeout,
+                                      TimerStatIncrementer &timer) const {
+  // Objects do not overlap, so both their start and end addresses are
+  // ordered and the candidates for `p` form a contiguous range.
+  std::vector<const MemoryMap::value_type *> sorted;
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); it != ie;
+       ++it)
+    sorted.push_back(&*it);
+  if (sorted.empty())
+    return false;
+
+  // Index of the last object starting at or below the example value, which
+  // is where `p` most likely points into.
+  unsigned n = sorted.size(), exampleIdx = 0;
+  for (unsigned lo = 0, hi = n; lo < hi;) {
+    unsigned mid = lo + (hi - lo) / 2;
+    if (sorted[mid]->first->address <= example) {
+      exampleIdx = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // Fast path: two queries when `p` can only point into that object.
+  const MemoryObject *exampleMo = sorted[exampleIdx]->first;
+  if (exampleMo->address <= example) {
+    int incomplete = checkPointerInObject(state, solver, p,
+                                          *sorted[exampleIdx], rl,
+                                          maxResolutions);
+    if (incomplete != 2)
+      return incomplete ? true : false;
+  }
+
+  // First object whose end `p` may lie below. The object holding the
+  // example value (or the one after it) satisfies this.
+  unsigned first = exampleIdx;
+  for (unsigned lo = 0, hi = exampleIdx; lo < hi;) {
+    unsigned mid = lo + (hi - lo) / 2;
+    const MemoryObject *mo = sorted[mid]->first;
+    ref<Expr> end = AddExpr::create(
+        mo->getBaseExpr(),
+        ConstantExpr::create(mo->size ? mo->size : 1, p->getWidth()));
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, UltExpr::create(p, end), mayBeTrue))
+      return true;
+    if (mayBeTrue) {
+      first = mid;
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  // Last object whose start `p` may lie at or above.
+  unsigned last = exampleIdx;
+  for (unsigned lo = exampleIdx + 1, hi = n; lo < hi;) {
+    unsigned mid = lo + (hi - lo) / 2;
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(
+            state, UgeExpr::create(p, sorted[mid]->first->getBaseExpr()),
+            mayBeTrue))
+      return true;
+    if (mayBeTrue) {
+      last = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (unsigned i = first; i <= last; ++i) {
+    if (i == exampleIdx && exampleMo->address <= example)
+      continue;
+    if (timeout && timeout < timer.check())
+      return true;
+
+    int incomplete =
+        checkPointerInObject(state, solver, p, *sorted[i], rl, maxResolutions);
+    if (incomplete != 2)
+      return incomplete ? true : false;
+  }
+
+  return false;
+}
+
 // These two are pretty big hack so we can sort of pass memory back
 // and forth to externals. They work by abusing the concrete cache
 // store inside of the object states, which allows them to
 // transparently avoid screwing up symbolics (if the byte is symbolic
 // then its concrete cache byte isn't being used) but is just a hack.
 
+void AddressSpace::copyOutConcrete(const MemoryObject *mo,
+                                   const ObjectState *os) const {
+  auto address = reinterpret_cast<std::uint8_t*>(mo->address);
+  if (mo->parent)
+    mo->parent->commit(mo);
+  if (mo->hostContents) {
+    os->getConcreteStore().copyChangedTo(*mo->hostContents, address);
+    *mo->hostContents = os->getConcreteStore();
+  } else {
+    os->getConcreteStore().copyTo(address);
+    mo->hostContents.reset(new PagedArray<uint8_t>(os->getConcreteStore()));
+  }
+}
+
 void AddressSpace::copyOutConcretes() {
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
        it != ie; ++it) {
@@ -289,14 +415,19 @@ void AddressSpace::copyOutConcretes() {
 
     if (!mo->isUserSpecified) {
       ObjectState *os = it->second;
-      auto address = reinterpret_cast<std::uint8_t*>(mo->address);
 
       if (!os->readOnly)
-        memcpy(address, os->concreteStore, mo->size);
+        copyOutConcrete(mo, os);
     }
   }
 }
 
+void AddressSpace::copyOutConcretes(const ResolutionList &objects) {
+  for (const ObjectPair &op : objects)
+    if (!op.first->isUserSpecified && !op.second->readOnly)
+      copyOutConcrete(op.first, op.second);
+}
+
 bool AddressSpace::copyInConcretes() {
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
        it != ie; ++it) {
@@ -313,20 +444,71 @@ bool AddressSpace::copyInConcretes() {
   return true;
 }
 
+bool AddressSpace::copyInConcretes(const ResolutionList &objects) {
+  for (const ObjectPair &op : objects)
+    if (!op.first->isUserSpecified &&
+        !copyInConcrete(op.first, op.second, op.first->address))
+      return false;
+  return true;
+}
+
 bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   uint64_t src_address) {
   auto address = reinterpret_cast<std::uint8_t*>(src_address);
-  if (memcmp(address, os->concreteStore, mo->size) != 0) {
+  if (!os->getConcreteStore().equals(address)) {
     if (os->readOnly) {
       return false;
     } else {
       ObjectState *wos = getWriteable(mo, os);
-      memcpy(wos->concreteStore, address, mo->size);
+      wos->getConcreteStore().copyFrom(address);
+      wos->invalidateContentSummary();
+      os = wos;
     }
   }
+  // the memory of the object now holds its contents
+  if (mo->hostContents && src_address == mo->address)
+    *mo->hostContents = os->getConcreteStore();
   return true;
 }
 
+void AddressSpace::getReachableObjects(std::vector<uint64_t> addresses,
+                                       ResolutionList &rl) const {
+  if (objects.empty())
+    return;
+  // addresses outside of all objects need no lookup
+  uint64_t low = objects.min().first->address;
+  const MemoryObject *last = objects.max().first;
+  uint64_t high = last->address + last->size;
+  Expr::Width width = Context::get().getPointerWidth();
+  unsigned pointerBytes = width / 8;
+  bool littleEndian = Context::get().isLittleEndian();
+
+  std::unordered_set<const MemoryObject *> visited;
+  while (!addresses.empty()) {
+    uint64_t address = addresses.back();
+    addresses.pop_back();
+    ObjectPair op;
+    if (address < low || address > high ||
+        !resolveOne(ConstantExpr::create(address, width), op) ||
+        !visited.insert(op.first).second)
+      continue;
+    rl.push_back(op);
+
+    const ObjectState *os = op.second;
+    uint8_t bytes[8];
+    for (unsigned offset = 0; offset + pointerBytes <= op.first->size;
+         offset += pointerBytes) {
+      os->getConcreteStore().copyTo(offset, pointerBytes, bytes);
+      uint64_t value = 0;
+      for (unsigned i = 0; i != pointerBytes; ++i)
+        value |= uint64_t(bytes[littleEndian ? i : pointerBytes - 1 - i])
+                 << (8 * i);
+      if (value >= low && value <= high)
+        addresses.push_back(value);
+    }
+  }
+}
+
 /***/
 
 bool MemoryObjectLT::operator()(const MemoryObject *a, const MemoryObject *b) const {
@@ -13,13 +13,14 @@
 #include "ObjectHolder.h"
 
 #include "klee/Expr.h"
-#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableBTreeMap.h"
 #include "klee/Internal/System/Time.h"
 
 namespace klee {
   class ExecutionState;
   class MemoryObject;
   class ObjectState;
+  class TimerStatIncrementer;
   class TimingSolver;
 
   template<class T> class ref;
@@ -32,7 +33,10 @@ namespace klee {
     bool operator()(const MemoryObject *a, const MemoryObject *b) const;
   };
   
-  typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
+  /// Persistent map of the objects in an address space. A B+-tree keeps
+  /// the entries of the typically few hundred objects of a state in a few
+  /// contiguous nodes, while still sharing unmodified nodes across forks.
+  typedef ImmutableBTreeMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
 
   class AddressSpace {
   private:
@@ -53,6 +57,22 @@ namespace klee {
                              ref<Expr> p, const ObjectPair &op,
                              ResolutionList &rl, unsigned maxResolutions) const;
 
+    /// Resolve pointer `p` by first bisecting the address-ordered objects
+    /// for the first and last object `p` may point into, and then checking
+    /// only the objects in between. Needs O(log n + k) queries for n
+    /// objects, k of which lie within the feasible range of `p`.
+    ///
+    /// \param example A feasible value of `p`.
+    /// \return The same as resolve().
+    bool resolveByBisection(ExecutionState &state, TimingSolver *solver,
+                            ref<Expr> p, uint64_t example, ResolutionList &rl,
+                            unsigned maxResolutions, time::Span timeout,
+                            TimerStatIncrementer &timer) const;
+
+    /// Copy the concrete values of the object into the memory at its
+    /// address, skipping the pages which are there already.
+    void copyOutConcrete(const MemoryObject *mo, const ObjectState *os) const;
+
   public:
     /// The MemoryObject -> ObjectState map that constitutes the
     /// address space.
@@ -124,9 +144,15 @@ namespace klee {
     ObjectState *getWriteable(const MemoryObject *mo, const ObjectState *os);
 
     /// Copy the concrete values of all managed ObjectStates into the
-    /// actual system memory location they were allocated at.
+    /// actual system memory location they were allocated at. Only the
+    /// pages changed since the last copy to or from that memory are
+    /// written.
     void copyOutConcretes();
 
+    /// Copy the concrete values of the given objects into the actual system
+    /// memory location they were allocated at, as copyOutConcretes() does.
+    void copyOutConcretes(const ResolutionList &objects);
+
     /// Copy the concrete values of all managed ObjectStates back from
     /// the actual system memory location they were allocated
     /// at. ObjectStates will only be written to (and thus,
@@ -137,6 +163,18 @@ namespace klee {
     /// \retval false The copy failed because a read-only object was modified.
     bool copyInConcretes();
 
+    /// Copy the concrete values of the given objects back from the actual
+    /// system memory location they were allocated at, as copyInConcretes()
+    /// does.
+    bool copyInConcretes(const ResolutionList &objects);
+
+    /// Collects in \a rl the objects which the given addresses point into,
+    /// and those which the pointer-sized words of their concrete contents
+    /// point into, transitively: the memory an external call given these
+    /// addresses can reach.
+    void getReachableObjects(std::vector<uint64_t> addresses,
+                             ResolutionList &rl) const;
+
     /// Updates the memory object with the raw memory from the address
     ///
     /// @param mo The MemoryObject to update
@@ -0,0 +1,149 @@
+//===-- AsyncBranchQueries.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AsyncBranchQueries.h"
+
+#include "TimingSolver.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+// What a child sends back.
+struct Message {
+  bool success;
+  int validity;
+  int64_t solverTimeMicroseconds;
+};
+}
+
+AsyncBranchQueries::~AsyncBranchQueries() {
+  for (Pending &p : pending)
+    kill(p);
+}
+
+void AsyncBranchQueries::kill(Pending &p) {
+  ::kill(p.pid, SIGKILL);
+  close(p.fd);
+  int status;
+  while (waitpid(p.pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+bool AsyncBranchQueries::isPending(const ExecutionState *state) const {
+  for (const Pending &p : pending)
+    if (p.state == state)
+      return true;
+  return false;
+}
+
+bool AsyncBranchQueries::start(ExecutionState &state, ref<Expr> condition,
+                               TimingSolver &solver, time::Span timeout) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    klee_warning_once(0, "pipe failed (for asynchronous query) - %s",
+                      llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning_once(0, "fork failed (for asynchronous query) - %s",
+                      llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    for (const Pending &p : pending)
+      close(p.fd);
+    Message m;
+    Solver::Validity validity = Solver::Unknown;
+    time::Span costBefore = state.queryCost;
+    solver.setTimeout(timeout);
+    m.success = solver.evaluate(state, condition, validity);
+    m.validity = validity;
+    m.solverTimeMicroseconds = (state.queryCost - costBefore).toMicroseconds();
+    // The message is smaller than PIPE_BUF, so it is written at once.
+    ssize_t n = write(fds[1], &m, sizeof(m));
+    _exit(n == sizeof(m) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  Pending p = {&state, condition, pid, fds[0]};
+  pending.push_back(p);
+  return true;
+}
+
+void AsyncBranchQueries::collect(bool block,
+                                 std::vector<Result> &results) {
+  while (!pending.empty()) {
+    std::vector<pollfd> fds;
+    for (const Pending &p : pending) {
+      pollfd pfd = {p.fd, POLLIN, 0};
+      fds.push_back(pfd);
+    }
+    int ready = poll(&fds[0], fds.size(), block ? -1 : 0);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return;
+
+    std::vector<Pending> running;
+    for (unsigned i = 0; i != pending.size(); ++i) {
+      Pending &p = pending[i];
+      if (!fds[i].revents) {
+        running.push_back(p);
+        continue;
+      }
+      results.push_back(finish(p));
+    }
+    pending.swap(running);
+    return;
+  }
+}
+
+void AsyncBranchQueries::collectAll(std::vector<Result> &results) {
+  for (Pending &p : pending)
+    results.push_back(finish(p));
+  pending.clear();
+}
+
+AsyncBranchQueries::Result AsyncBranchQueries::finish(Pending &p) {
+  Message m;
+  ssize_t n;
+  while ((n = read(p.fd, &m, sizeof(m))) < 0 && errno == EINTR)
+    ;
+  close(p.fd);
+  int status;
+  while (waitpid(p.pid, &status, 0) < 0 && errno == EINTR)
+    ;
+
+  Result r;
+  r.state = p.state;
+  r.condition = p.condition;
+  // a child that died without answering counts as a failed query
+  r.success = n == sizeof(m) && m.success;
+  r.validity = r.success ? static_cast<Solver::Validity>(m.validity)
+                         : Solver::Unknown;
+  r.solverTime =
+      r.success ? time::microseconds(m.solverTimeMicroseconds) : time::Span();
+  return r;
+}
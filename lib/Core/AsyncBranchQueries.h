@@ -0,0 +1,83 @@
+//===-- AsyncBranchQueries.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ASYNCBRANCHQUERIES_H
+#define KLEE_ASYNCBRANCHQUERIES_H
+
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+#include "klee/Internal/System/Time.h"
+
+#include <sys/types.h>
+#include <vector>
+
+namespace klee {
+  class ExecutionState;
+  class TimingSolver;
+
+  /// Evaluates branch conditions in forked children, so that the executor
+  /// can keep running other states while a query is in flight. Each child
+  /// works on a copy-on-write snapshot of the executor; only the validity
+  /// of the condition (and the time it took) is sent back.
+  ///
+  /// Processes are used rather than threads because expressions, their
+  /// reference counts and the solver chain's caches are not thread safe.
+  /// As a consequence, what the solver chain learns while answering the
+  /// query is lost with the child.
+  class AsyncBranchQueries {
+  public:
+    struct Result {
+      ExecutionState *state;
+      ref<Expr> condition;
+      bool success;
+      Solver::Validity validity;
+      time::Span solverTime;
+    };
+
+  private:
+    struct Pending {
+      ExecutionState *state;
+      ref<Expr> condition;
+      pid_t pid;
+      int fd;
+    };
+
+    unsigned maxInFlight;
+    std::vector<Pending> pending;
+
+    void kill(Pending &p);
+    /// Reads the answer of \a p, waiting for it, and reaps the child.
+    Result finish(Pending &p);
+
+  public:
+    explicit AsyncBranchQueries(unsigned maxInFlight)
+      : maxInFlight(maxInFlight) {}
+    /// Kills the queries still in flight.
+    ~AsyncBranchQueries();
+
+    bool full() const { return pending.size() >= maxInFlight; }
+    bool empty() const { return pending.empty(); }
+    bool isPending(const ExecutionState *state) const;
+
+    /// Starts evaluating \a condition in \a state. Returns false if no
+    /// child could be created; the caller then has to evaluate it itself.
+    bool start(ExecutionState &state, ref<Expr> condition,
+               TimingSolver &solver, time::Span timeout);
+
+    /// Appends the queries that finished to \a results. If \a block is set,
+    /// waits until at least one did.
+    void collect(bool block, std::vector<Result> &results);
+
+    /// Waits for all queries in flight and appends their results in the
+    /// order the queries were started.
+    void collectAll(std::vector<Result> &results);
+  };
+}
+
+#endif
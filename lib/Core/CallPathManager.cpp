@@ -23,8 +23,10 @@ using namespace klee;
 
 CallPathNode::CallPathNode(CallPathNode *_parent,
                            const llvm::Instruction *_callSite,
-                           const llvm::Function *_function)
-    : parent(_parent), callSite(_callSite), function(_function), count(0) {}
+                           const llvm::Function *_function,
+                           unsigned _index)
+    : parent(_parent), callSite(_callSite), function(_function), count(0),
+      index(_index) {}
 
 void CallPathNode::print() {
   llvm::errs() << "  (Function: " << this->function->getName() << ", "
@@ -39,22 +41,27 @@ void CallPathNode::print() {
 
 ///
 
-CallPathManager::CallPathManager() : root(nullptr, nullptr, nullptr) {}
+CallPathManager::CallPathManager() : root(nullptr, nullptr, nullptr, 0) {}
 
 void CallPathManager::getSummaryStatistics(CallSiteSummaryTable &results) {
   results.clear();
 
-  for (auto &path : paths)
-    path->summaryStatistics = path->statistics;
+  // The summaries are only needed here, so the nodes do not keep them.
+  std::vector<StatisticRecord> summaries;
+  summaries.reserve(paths.size());
+  for (const CallPathNode &path : paths)
+    summaries.push_back(path.statistics);
 
   // compute summary bottom up, while building result table
   for (auto it = paths.rbegin(), ie = paths.rend(); it != ie; ++it) {
-    const auto &cp = (*it);
-    cp->parent->summaryStatistics += cp->summaryStatistics;
-
-    CallSiteInfo &csi = results[cp->callSite][cp->function];
-    csi.count += cp->count;
-    csi.statistics += cp->summaryStatistics;
+    const CallPathNode &cp = *it;
+    const StatisticRecord &summary = summaries[cp.index];
+    if (cp.parent != &root)
+      summaries[cp.parent->index] += summary;
+
+    CallSiteInfo &csi = results[cp.callSite][cp.function];
+    csi.count += cp.count;
+    csi.statistics += summary;
   }
 }
 
@@ -65,10 +72,8 @@ CallPathNode *CallPathManager::computeCallPath(CallPathNode *parent,
     if (cs==p->callSite && f==p->function)
       return p;
 
-  auto cp = std::unique_ptr<CallPathNode>(new CallPathNode(parent, cs, f));
-  auto newCP = cp.get();
-  paths.emplace_back(std::move(cp));
-  return newCP;
+  paths.emplace_back(parent, cs, f, paths.size());
+  return &paths.back();
 }
 
 CallPathNode *CallPathManager::getCallPath(CallPathNode *parent,
@@ -78,13 +83,9 @@ CallPathNode *CallPathManager::getCallPath(CallPathNode *parent,
   if (!parent)
     parent = &root;
 
-  auto it = parent->children.find(key);
-  if (it==parent->children.end()) {
-    auto cp = computeCallPath(parent, cs, f);
-    parent->children.insert(std::make_pair(key, cp));
-    return cp;
-  } else {
-    return it->second;
-  }
+  CallPathNode *&cp = parent->children[key];
+  if (!cp)
+    cp = computeCallPath(parent, cs, f);
+  return cp;
 }
 
@@ -12,9 +12,11 @@
 
 #include "klee/Statistics.h"
 
+#include <deque>
+#include <functional>
 #include <map>
-#include <memory>
-#include <vector>
+#include <unordered_map>
+#include <utility>
 
 namespace llvm {
   class Instruction;
@@ -40,10 +42,17 @@ namespace klee {
     friend class CallPathManager;
 
   public:
-    typedef std::map<
-        std::pair<const llvm::Instruction *, const llvm::Function *>,
-        CallPathNode *>
-        children_ty;
+    typedef std::pair<const llvm::Instruction *, const llvm::Function *>
+        key_ty;
+    struct KeyHash {
+      size_t operator()(const key_ty &key) const {
+        size_t h = std::hash<const void *>()(key.first);
+        return h ^ (std::hash<const void *>()(key.second) + 0x9e3779b9 +
+                    (h << 6) + (h >> 2));
+      }
+    };
+    /// Looked up on every call, hence hashed: a node may have hundreds.
+    typedef std::unordered_map<key_ty, CallPathNode *, KeyHash> children_ty;
 
     // form list of (callSite,function) path
     CallPathNode *parent;
@@ -52,19 +61,21 @@ namespace klee {
     children_ty children;
 
     StatisticRecord statistics;
-    StatisticRecord summaryStatistics;
     unsigned count;
+    /// The position in CallPathManager::getCallPaths().
+    unsigned index;
 
   public:
     CallPathNode(CallPathNode *parent, const llvm::Instruction *callSite,
-                 const llvm::Function *function);
+                 const llvm::Function *function, unsigned index);
 
     void print();
   };
 
   class CallPathManager {
     CallPathNode root;
-    std::vector<std::unique_ptr<CallPathNode>> paths;
+    /// The nodes, allocated a block at a time and never moved.
+    std::deque<CallPathNode> paths;
 
   private:
     CallPathNode *computeCallPath(CallPathNode *parent,
@@ -77,6 +88,11 @@ namespace klee {
 
     void getSummaryStatistics(CallSiteSummaryTable &result);
 
+    /// The call paths, each after its parent.
+    const std::deque<CallPathNode> &getCallPaths() const {
+      return paths;
+    }
+
     CallPathNode *getCallPath(CallPathNode *parent,
                               const llvm::Instruction *callSite,
                               const llvm::Function *f);
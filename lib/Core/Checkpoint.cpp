@@ -0,0 +1,188 @@
+//===-- Checkpoint.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+using namespace klee;
+
+namespace {
+const char Magic[] = "KLEECKPT1";
+
+void writeVarInt(FILE *f, uint64_t v) {
+  do {
+    unsigned char c = v & 0x7f;
+    v >>= 7;
+    fputc(v ? c | 0x80 : c, f);
+  } while (v);
+}
+
+bool readVarInt(FILE *f, uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int c = fgetc(f);
+    if (c == EOF)
+      return false;
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return true;
+  }
+  return false;
+}
+
+typedef DecisionHistory::Node HistoryNode;
+
+struct TrieNode {
+  std::map<unsigned, unsigned> children;
+  bool frontier;
+
+  TrieNode() : frontier(false) {}
+};
+}
+
+bool CheckpointTree::write(const std::string &path,
+                           const std::vector<const DecisionHistory *> &histories,
+                           std::string &error) {
+  // Merge the histories into a trie of decisions. Histories share most of
+  // their nodes, so each node is only walked once.
+  std::vector<TrieNode> trie(1);
+  std::map<const HistoryNode *, unsigned> visited;
+  std::vector<const HistoryNode *> unvisited;
+  for (const DecisionHistory *h : histories) {
+    unsigned node = 0;
+    unvisited.clear();
+    for (const HistoryNode *n = h->getLast(); n; n = n->getParent()) {
+      std::map<const HistoryNode *, unsigned>::iterator it = visited.find(n);
+      if (it != visited.end()) {
+        node = it->second;
+        break;
+      }
+      unvisited.push_back(n);
+    }
+    for (unsigned i = unvisited.size(); i-- > 0;) {
+      std::pair<std::map<unsigned, unsigned>::iterator, bool> child =
+          trie[node].children.insert(
+              std::make_pair(unvisited[i]->getDecision(),
+                         (unsigned)trie.size()));
+      if (child.second)
+        trie.push_back(TrieNode());
+      node = visited[unvisited[i]] = child.first->second;
+    }
+    trie[node].frontier = true;
+  }
+
+  std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f) {
+    error = "unable to open " + tmp + ": " + strerror(errno);
+    return false;
+  }
+  fwrite(Magic, 1, sizeof Magic - 1, f);
+
+  // Preorder, without recursion as paths can be very deep.
+  std::vector<std::pair<unsigned, unsigned> > stack;
+  stack.push_back(std::make_pair(0u, 0u));
+  while (!stack.empty()) {
+    std::pair<unsigned, unsigned> entry = stack.back();
+    stack.pop_back();
+    if (entry.second)
+      writeVarInt(f, entry.first);
+    const TrieNode &node = trie[entry.second];
+    writeVarInt(f, (uint64_t)node.children.size() << 1 | node.frontier);
+    stack.insert(stack.end(), node.children.rbegin(), node.children.rend());
+  }
+
+  bool failed = ferror(f);
+  if (fclose(f) || failed || rename(tmp.c_str(), path.c_str())) {
+    error = "unable to write " + path + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool CheckpointTree::read(const std::string &path, std::string &error) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) {
+    error = "unable to open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  char magic[sizeof Magic - 1];
+  uint64_t header;
+  bool ok = fread(magic, 1, sizeof magic, f) == sizeof magic &&
+            !memcmp(magic, Magic, sizeof magic) && readVarInt(f, header);
+  nodes.clear();
+  // (node index, children left to read)
+  std::vector<std::pair<unsigned, uint64_t> > stack;
+  if (ok) {
+    nodes.push_back(Node());
+    nodes.back().frontier = header & 1;
+    stack.push_back(std::make_pair(0u, header >> 1));
+  }
+  while (ok && !stack.empty()) {
+    if (!stack.back().second) {
+      stack.pop_back();
+      continue;
+    }
+    --stack.back().second;
+    uint64_t decision;
+    if (!(ok = readVarInt(f, decision) && readVarInt(f, header)))
+      break;
+    unsigned index = nodes.size();
+    nodes.push_back(Node());
+    nodes.back().frontier = header & 1;
+    nodes[stack.back().first].children.push_back(
+        std::make_pair((unsigned)decision, &nodes.back()));
+    stack.push_back(std::make_pair(index, header >> 1));
+  }
+  fclose(f);
+
+  if (!ok) {
+    nodes.clear();
+    error = path + " is not a valid checkpoint";
+  }
+  return ok;
+}
+
+const CheckpointTree::Node *
+CheckpointTree::Node::getChild(unsigned decision) const {
+  std::vector<std::pair<unsigned, const Node *> >::const_iterator it =
+      std::lower_bound(children.begin(), children.end(),
+                       std::make_pair(decision, (const Node *)0));
+  if (it == children.end() || it->first != decision)
+    return 0;
+  return it->second;
+}
+
+void CheckpointTree::getPaths(std::vector<DecisionHistory> &paths) const {
+  if (nodes.empty())
+    return;
+
+  // Without recursion, as in write().
+  std::vector<std::pair<const Node *, DecisionHistory> > stack;
+  stack.push_back(std::make_pair(&nodes[0], DecisionHistory()));
+  while (!stack.empty()) {
+    const Node *node = stack.back().first;
+    DecisionHistory history = stack.back().second;
+    stack.pop_back();
+    if (node->frontier)
+      paths.push_back(history);
+    for (const auto &child : node->children) {
+      DecisionHistory h = history;
+      h.append(child.first);
+      stack.push_back(std::make_pair(child.second, h));
+    }
+  }
+}
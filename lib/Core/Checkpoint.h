@@ -0,0 +1,67 @@
+//===-- Checkpoint.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHECKPOINT_H
+#define KLEE_CHECKPOINT_H
+
+#include "klee/Internal/ADT/DecisionHistory.h"
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+  /// CheckpointTree - The branch decisions of all live states of a run,
+  /// merged into a trie. A run resumed from it re-creates the states by
+  /// following the recorded decisions instead of asking the solver, and
+  /// does not revisit the paths which had already been completed.
+  ///
+  /// The file starts with a magic string, followed by the nodes in
+  /// preorder. Each node is a varint holding its number of children
+  /// shifted left by one, with the low bit set if a state stopped at that
+  /// node, followed by the decision varint and the subtree of each child.
+  class CheckpointTree {
+  public:
+    struct Node {
+      /// (decision, node) of each child, by increasing decision.
+      std::vector<std::pair<unsigned, const Node *> > children;
+      /// A state was at this node when the checkpoint was written.
+      bool frontier;
+
+      Node() : frontier(false) {}
+
+      /// getChild - The node reached by taking \a decision, or null if no
+      /// state took it.
+      const Node *getChild(unsigned decision) const;
+    };
+
+  private:
+    // A deque, so that nodes do not move while the tree is read.
+    std::deque<Node> nodes;
+
+  public:
+    /// write - Write the trie of \a histories to \a path, replacing it
+    /// atomically.
+    static bool write(const std::string &path,
+                      const std::vector<const DecisionHistory *> &histories,
+                      std::string &error);
+
+    bool read(const std::string &path, std::string &error);
+
+    /// getPaths - Append to \a paths the decisions leading to each node a
+    /// state was at.
+    void getPaths(std::vector<DecisionHistory> &paths) const;
+
+    const Node *getRoot() const { return nodes.empty() ? 0 : &nodes[0]; }
+  };
+}
+
+#endif
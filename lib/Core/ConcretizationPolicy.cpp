@@ -0,0 +1,192 @@
+//===-- ConcretizationPolicy.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConcretizationPolicy.h"
+
+#include "CoreStats.h"
+#include "klee/Config/Version.h"
+#include "klee/OptionCategories.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+enum class PolicyKind {
+  Fork,
+  Bounded,
+  Merge,
+  Concretize,
+  Symbolic,
+  Adaptive
+};
+
+cl::opt<PolicyKind> SymbolicSizePolicy(
+    "symbolic-size-policy",
+    cl::desc("How symbolic allocation sizes are handled (default=fork)"),
+    cl::values(clEnumValN(PolicyKind::Fork, "fork",
+                          "Fork on the smallest size found and on huge "
+                          "sizes, reporting any other size as an error"),
+               clEnumValN(PolicyKind::Concretize, "concretize",
+                          "Concretize the size to a single value"),
+               clEnumValN(PolicyKind::Symbolic, "symbolic",
+                          "Keep the size symbolic, in bounds checks, and "
+                          "allocate room for the largest size up to "
+                          "--max-symbolic-alloc-size"),
+               clEnumValN(PolicyKind::Adaptive, "adaptive",
+                          "Fork, but concretize at the allocations where "
+                          "forking proves expensive")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::init(PolicyKind::Fork),
+    cl::cat(SolvingCat));
+
+cl::opt<PolicyKind> SymbolicPointerPolicy(
+    "symbolic-pointer-policy",
+    cl::desc("How symbolic pointers which may point to several objects are "
+             "handled (default=fork)"),
+    cl::values(clEnumValN(PolicyKind::Fork, "fork",
+                          "Fork over all the objects"),
+               clEnumValN(PolicyKind::Bounded, "bounded",
+                          "Fork over up to --pointer-fork-bound objects, "
+                          "then concretize"),
+               clEnumValN(PolicyKind::Merge, "merge",
+                          "Read through the pointer as a choice over up to "
+                          "--pointer-merge-bound objects, and write to "
+                          "each of them conditionally, in a single state; "
+                          "fork over more objects"),
+               clEnumValN(PolicyKind::Concretize, "concretize",
+                          "Concretize the pointer to a single value"),
+               clEnumValN(PolicyKind::Adaptive, "adaptive",
+                          "Fork, but bound the forking and then concretize "
+                          "at the accesses where it proves expensive")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::init(PolicyKind::Fork),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> PointerForkBound(
+    "pointer-fork-bound",
+    cl::desc("The number of objects a bounded symbolic pointer is forked "
+             "over (default=4)"),
+    cl::init(4),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> PointerMergeBound(
+    "pointer-merge-bound",
+    cl::desc("The number of objects a merged symbolic pointer is accessed "
+             "through at most (default=8)"),
+    cl::init(8),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> MaxSymbolicAllocSize(
+    "max-symbolic-alloc-size",
+    cl::desc("The largest size an allocation of symbolic size is given room "
+             "for with --symbolic-size-policy=symbolic; larger sizes fail "
+             "to allocate (default=65536)"),
+    cl::init(65536),
+    cl::cat(SolvingCat));
+
+cl::opt<double> ConcretizationCostFactor(
+    "concretization-cost-factor",
+    cl::desc("With an adaptive policy, handle the symbolic sizes or pointers "
+             "of an instruction more cheaply once doing it costs more "
+             "solver time on average than this many queries (default=20)"),
+    cl::init(20),
+    cl::cat(SolvingCat));
+
+/// The times an instruction is seen before deciding it is expensive.
+const unsigned MinSamples = 3;
+
+ConcretizationPolicy::Action getInitialAction(PolicyKind kind) {
+  switch (kind) {
+  case PolicyKind::Bounded:
+    return ConcretizationPolicy::Bounded;
+  case PolicyKind::Merge:
+    return ConcretizationPolicy::Merge;
+  case PolicyKind::Concretize:
+    return ConcretizationPolicy::Concretize;
+  case PolicyKind::Symbolic:
+    return ConcretizationPolicy::Symbolic;
+  default:
+    return ConcretizationPolicy::Fork;
+  }
+}
+}
+
+ConcretizationPolicy::Action
+ConcretizationPolicy::getSizeAction(const KInstruction *ki) {
+  if (SymbolicSizePolicy != PolicyKind::Adaptive)
+    return getInitialAction(SymbolicSizePolicy);
+  return sizeSites.emplace(ki, Site(Fork)).first->second.action;
+}
+
+ConcretizationPolicy::Action
+ConcretizationPolicy::getPointerAction(const KInstruction *ki) {
+  if (SymbolicPointerPolicy != PolicyKind::Adaptive)
+    return getInitialAction(SymbolicPointerPolicy);
+  return pointerSites.emplace(ki, Site(Fork)).first->second.action;
+}
+
+void ConcretizationPolicy::record(const KInstruction *ki, Site &site,
+                                  time::Span cost, Action next,
+                                  const char *what) {
+  site.cost += cost;
+  if (++site.samples < MinSamples || !stats::queries)
+    return;
+
+  double average = site.cost.toMicroseconds() / (double)site.samples;
+  double queryAverage = stats::solverTime / (double)stats::queries;
+  if (average <= ConcretizationCostFactor * queryAverage)
+    return;
+
+  site.action = next;
+  site.samples = 0;
+  site.cost = time::Span();
+  klee_message("NOTE: %s at %s:%u, as handling them took %.1fms on "
+               "average",
+               what, ki->info->file.c_str(), ki->info->line, average / 1e3);
+}
+
+void ConcretizationPolicy::recordSize(const KInstruction *ki,
+                                      time::Span cost) {
+  if (SymbolicSizePolicy != PolicyKind::Adaptive)
+    return;
+  Site &site = sizeSites.emplace(ki, Site(Fork)).first->second;
+  if (site.action == Fork)
+    record(ki, site, cost, Concretize, "concretizing symbolic sizes");
+}
+
+void ConcretizationPolicy::recordPointer(const KInstruction *ki,
+                                         time::Span cost) {
+  if (SymbolicPointerPolicy != PolicyKind::Adaptive)
+    return;
+  Site &site = pointerSites.emplace(ki, Site(Fork)).first->second;
+  if (site.action == Fork)
+    record(ki, site, cost, Bounded, "bounding the forks on symbolic pointers");
+  else if (site.action == Bounded)
+    record(ki, site, cost, Concretize, "concretizing symbolic pointers");
+}
+
+unsigned ConcretizationPolicy::getForkBound() {
+  return std::max(1u, (unsigned)PointerForkBound);
+}
+
+unsigned ConcretizationPolicy::getMergeBound() {
+  return std::max(2u, (unsigned)PointerMergeBound);
+}
+
+unsigned ConcretizationPolicy::getSymbolicSizeBound() {
+  return MaxSymbolicAllocSize;
+}
@@ -0,0 +1,85 @@
+//===-- ConcretizationPolicy.h ----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONCRETIZATIONPOLICY_H
+#define KLEE_CONCRETIZATIONPOLICY_H
+
+#include "klee/Internal/System/Time.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace klee {
+  struct KInstruction;
+
+  /// Decides, per instruction, how symbolic allocation sizes and pointers
+  /// which do not resolve to a single object are handled, as selected with
+  /// --symbolic-size-policy and --symbolic-pointer-policy.
+  ///
+  /// The adaptive policies start with forking and keep track of the solver
+  /// time each instruction spends on it. An instruction whose handling
+  /// costs much more than the average query, as measured so far, moves on
+  /// to a cheaper but less complete handling.
+  class ConcretizationPolicy {
+  public:
+    enum Action {
+      /// Explore the alternatives: the smallest size and the huge sizes,
+      /// or all the objects a pointer may point to.
+      Fork,
+      /// Fork over a few of the objects only, and concretize the pointer
+      /// in the remaining state.
+      Bounded,
+      /// Access all the objects a pointer may point to in the same state,
+      /// as long as they are few.
+      Merge,
+      /// Pick a single value.
+      Concretize,
+      /// Allocate an object of symbolic size, with room for the largest
+      /// size possible.
+      Symbolic
+    };
+
+  private:
+    struct Site {
+      Action action;
+      unsigned samples = 0;
+      time::Span cost;
+
+      explicit Site(Action action) : action(action) {}
+    };
+
+    std::unordered_map<const KInstruction *, Site> sizeSites, pointerSites;
+
+    /// Moves the site on to the next action if it has been too expensive.
+    void record(const KInstruction *ki, Site &site, time::Span cost,
+                Action next, const char *what);
+
+  public:
+    Action getSizeAction(const KInstruction *ki);
+    Action getPointerAction(const KInstruction *ki);
+
+    /// The solver time it took to handle a symbolic size or pointer at the
+    /// instruction, with the action returned for it.
+    void recordSize(const KInstruction *ki, time::Span cost);
+    void recordPointer(const KInstruction *ki, time::Span cost);
+
+    /// The number of objects a pointer is forked over when Bounded.
+    static unsigned getForkBound();
+
+    /// The number of objects a pointer is accessed through at most when
+    /// Merge.
+    static unsigned getMergeBound();
+
+    /// The largest size an object of symbolic size is allocated with when
+    /// Symbolic.
+    static unsigned getSymbolicSizeBound();
+  };
+}
+
+#endif
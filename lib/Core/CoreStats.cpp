@@ -11,19 +11,31 @@
 
 using namespace klee;
 
+Statistic stats::allocatedBytes("AllocatedBytes", "Abytes");
 Statistic stats::allocations("Allocations", "Alloc");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
+Statistic stats::coveredStates("CoveredStates", "CovSt");
+Statistic stats::deadConstraints("DeadConstraints", "DeadC");
+Statistic stats::duplicateStates("DuplicateStates", "DupSt");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
 Statistic stats::forks("Forks", "Forks");
-Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
+Statistic stats::functionSummaryHits("FunctionSummaryHits", "FShits");
+Statistic stats::inBoundsCacheHits("InBoundsCacheHits", "IBhits");
+Statistic stats::inBoundsProofs("InBoundsProofs", "IBproofs");
 Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
+Statistic stats::lazyForksInfeasible("LazyForksInfeasible", "LFinf");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::modelTrieHits("ModelTrieHits", "MThits");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
+Statistic stats::reusedAllocations("ReusedAllocations", "Areused");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::searcherTime("SearcherTime", "SEtime");
 Statistic stats::solverTime("SolverTime", "Stime");
+Statistic stats::stateModelHits("StateModelHits", "SMhits");
 Statistic stats::states("States", "States");
+Statistic stats::subsumedStates("SubsumedStates", "SubSt");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
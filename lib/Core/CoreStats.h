@@ -16,10 +16,14 @@ namespace klee {
 namespace stats {
 
   extern Statistic allocations;
+  /// The bytes of the memory objects allocated.
+  extern Statistic allocatedBytes;
+  /// The allocations which took over the object of a dead stack
+  /// allocation at the same site, see --alloca-pool-size.
+  extern Statistic reusedAllocations;
   extern Statistic resolveTime;
   extern Statistic instructions;
   extern Statistic instructionTime;
-  extern Statistic instructionRealTime;
   extern Statistic coveredInstructions;
   extern Statistic uncoveredInstructions;  
   extern Statistic trueBranches;
@@ -30,6 +34,42 @@ namespace stats {
   /// The number of process forks.
   extern Statistic forks;
 
+  /// The number of queries answered, or branch sides shown feasible, by
+  /// the model of the state.
+  extern Statistic stateModelHits;
+
+  /// The number of bounds checks answered by the accesses a state proved
+  /// in bounds before.
+  extern Statistic inBoundsCacheHits;
+
+  /// The number of bounds checks skipped as the access was proved in
+  /// bounds statically.
+  extern Statistic inBoundsProofs;
+
+  /// The number of constraints dropped as they only read dead arrays.
+  extern Statistic deadConstraints;
+
+  /// The number of states terminated by --prune-covered-states.
+  extern Statistic coveredStates;
+
+  /// The number of states dropped by --drop-duplicate-states.
+  extern Statistic duplicateStates;
+
+  /// The number of states pruned by --prune-subsumed-states.
+  extern Statistic subsumedStates;
+
+  /// The number of states given back a model by the model trie.
+  extern Statistic modelTrieHits;
+
+  /// The number of calls replaced by a function summary.
+  extern Statistic functionSummaryHits;
+
+  /// The number of states of lazy forks found infeasible when selected.
+  extern Statistic lazyForksInfeasible;
+
+  /// The time spent selecting states and keeping the searcher up to date.
+  extern Statistic searcherTime;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "Memory.h"
+#include "Subsumption.h"
 
 #include "klee/ExecutionState.h"
 
@@ -16,12 +17,18 @@
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/OptionCategories.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <map>
@@ -37,6 +44,16 @@ cl::opt<bool> DebugLogStateMerge(
     "debug-log-state-merge", cl::init(false),
     cl::desc("Debug information for underlying state merging (default=false)"),
     cl::cat(MergeCat));
+
+cl::opt<bool> TrimDeadRegisters(
+    "trim-dead-registers", cl::init(true),
+    cl::desc("When a state writes to registers it shares with a forked "
+             "state, copy only the registers which are still live "
+             "(default=true)"),
+    cl::cat(DebugCat));
+
+// The number of emptied register arrays a state keeps for its next frames
+const unsigned LocalsPoolSize = 16;
 }
 
 /***/
@@ -44,23 +61,38 @@ cl::opt<bool> DebugLogStateMerge(
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
 }
 
-StackFrame::StackFrame(const StackFrame &s) 
-  : caller(s.caller),
-    kf(s.kf),
-    callPathNode(s.callPathNode),
-    allocas(s.allocas),
-    minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+std::vector<Cell> &StackFrame::mutateLocals(const KInstruction *current) {
+  if (!TrimDeadRegisters || !locals.isShared() || !current ||
+      current->inst->getParent()->getParent() != kf->function)
+    return locals.mutate();
+
+  llvm::BitVector live;
+  kf->getLiveRegisters(current, live);
+  return locals.mutate([&live](const std::vector<Cell> &shared) {
+    std::vector<Cell> copy(shared.size());
+    for (int i = live.find_first(); i != -1; i = live.find_next(i))
+      copy[i] = shared[i];
+    return copy;
+  });
+}
+
+/***/
+
+SymbolicList::SymbolicList(const SymbolicList &b) : objects(b.objects) {
+  for (const value_type &v : objects)
+    v.first->refCount++;
 }
 
-StackFrame::~StackFrame() { 
-  delete[] locals; 
+SymbolicList::~SymbolicList() {
+  for (const value_type &v : objects)
+    v.first->release();
+}
+
+void SymbolicList::push_back(const MemoryObject *mo, const Array *array) {
+  mo->refCount++;
+  objects.push_back(std::make_pair(mo, array));
 }
 
 /***/
@@ -76,7 +108,8 @@ ExecutionState::ExecutionState(KFunction *kf) :
     coveredNew(false),
     forkDisabled(false),
     ptreeNode(0),
-    steppedInstructions(0){
+    steppedInstructions(0),
+    lastStepped(0){
   pushFrame(0, kf);
 }
 
@@ -84,15 +117,6 @@ ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
     : constraints(assumptions), ptreeNode(0) {}
 
 ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-  {
-    const MemoryObject *mo = symbolics[i].first;
-    assert(mo->refCount > 0);
-    mo->refCount--;
-    if (mo->refCount == 0)
-      delete mo;
-  }
-
   for (auto cur_mergehandler: openMergeStack){
     cur_mergehandler->removeOpenState(this);
   }
@@ -109,6 +133,12 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     addressSpace(state.addressSpace),
     constraints(state.constraints),
+    deadConstraints(state.deadConstraints),
+    collectedConstraints(state.collectedConstraints),
+    subsumptionEntries(state.subsumptionEntries),
+    inBoundsAccesses(state.inBoundsAccesses),
+    model(state.model),
+    lazyCondition(state.lazyCondition),
 
     queryCost(state.queryCost),
     weight(state.weight),
@@ -116,39 +146,86 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
+    decisions(state.decisions),
 
     instsSinceCovNew(state.instsSinceCovNew),
     coveredNew(state.coveredNew),
     forkDisabled(state.forkDisabled),
-    coveredLines(state.coveredLines),
+    reachedTarget(state.reachedTarget),
+    subpath(state.subpath),
+    subpathNext(state.subpathNext),
+    subpathHash(state.subpathHash),
+    branchDecisions(state.branchDecisions),
+    coveredInstructions(state.coveredInstructions),
+    coveredEdges(state.coveredEdges),
     ptreeNode(state.ptreeNode),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames),
+    lazyObjects(state.lazyObjects),
+    lazyPointers(state.lazyPointers),
     openMergeStack(state.openMergeStack),
-    steppedInstructions(state.steppedInstructions)
+    steppedInstructions(state.steppedInstructions),
+    lastStepped(state.lastStepped)
 {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
-
   for (auto cur_mergehandler: openMergeStack)
     cur_mergehandler->addOpenState(this);
 }
 
 ExecutionState *ExecutionState::branch() {
+  KLEE_TRACE_SCOPE("ExecutionState::branch");
   depth++;
+  // what a recorded call does now depends on the path
+  summaryRecording.reset();
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredInstructions.reset();
 
   weight *= .5;
   falseState->weight -= weight;
 
+  for (const std::shared_ptr<SubsumptionEntry> &entry : subsumptionEntries)
+    ++entry->pending;
+
   return falseState;
 }
 
+namespace {
+std::uint64_t mixEdge(std::uint64_t edge) {
+  edge ^= edge >> 33;
+  edge *= 0xff51afd7ed558ccdull;
+  edge ^= edge >> 33;
+  return edge;
+}
+
+std::uint64_t rotateLeft(std::uint64_t value, unsigned bits) {
+  bits %= 64;
+  return bits ? (value << bits) | (value >> (64 - bits)) : value;
+}
+}
+
+void ExecutionState::addBranchDecision(std::uint64_t edge, unsigned length) {
+  ++branchDecisions;
+  // a cyclic polynomial hash: the entry leaving the window is rotated as
+  // often as the ones after it were
+  subpathHash = rotateLeft(subpathHash, 1) ^ mixEdge(edge);
+  if (subpath.size() < length) {
+    subpath.push_back(edge);
+    return;
+  }
+  subpathHash ^= rotateLeft(mixEdge(subpath[subpathNext]), length);
+  subpath[subpathNext] = edge;
+  subpathNext = (subpathNext + 1) % length;
+}
+
 void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
   stack.push_back(StackFrame(caller,kf));
+  StackFrame &sf = stack.back();
+  if (!localsPool.empty()) {
+    sf.locals = std::move(localsPool.back());
+    localsPool.pop_back();
+  }
+  sf.locals.mutate().resize(kf->numRegisters);
 }
 
 void ExecutionState::popFrame() {
@@ -156,12 +233,185 @@ void ExecutionState::popFrame() {
   for (std::vector<const MemoryObject*>::iterator it = sf.allocas.begin(), 
          ie = sf.allocas.end(); it != ie; ++it)
     addressSpace.unbindObject(*it);
+  // keep the registers for the next frame unless a forked state reads them
+  if (sf.locals.getIdentity() && !sf.locals.isShared() &&
+      localsPool.size() < LocalsPoolSize) {
+    sf.locals.mutate().clear();
+    localsPool.push_back(std::move(sf.locals));
+  }
   stack.pop_back();
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
-  mo->refCount++;
-  symbolics.push_back(std::make_pair(mo, array));
+  symbolics.mutate().push_back(mo, array);
+}
+
+/// Sets \a live to the registers of the frame which may still be read: those
+/// live at the instruction it executes next, but the one it writes to.
+static void getLiveRegisters(const ExecutionState &state, size_t frame,
+                             llvm::BitVector &live) {
+  const StackFrame &sf = state.stack[frame];
+  const KInstruction *next = frame + 1 == state.stack.size()
+                                 ? static_cast<KInstruction *>(state.pc)
+                                 : static_cast<KInstruction *>(
+                                       state.stack[frame + 1].caller);
+  if (!next || next->inst->getParent()->getParent() != sf.kf->function) {
+    live.clear();
+    live.resize(sf.locals->size(), true);
+    return;
+  }
+  sf.kf->getLiveRegisters(next, live);
+  live.reset(next->dest);
+}
+
+void ExecutionState::findLiveArrays(std::vector<const Array *> &arrays) const {
+  std::vector<ref<Expr> > live;
+  for (MemoryMap::iterator it = addressSpace.objects.begin(),
+                           ie = addressSpace.objects.end();
+       it != ie; ++it) {
+    const ObjectState *os = it->second;
+    const std::vector<const Array *> &contents = os->getSymbolicArrays();
+    arrays.insert(arrays.end(), contents.begin(), contents.end());
+  }
+  llvm::BitVector registers;
+  for (size_t i = 0; i != stack.size(); ++i) {
+    getLiveRegisters(*this, i, registers);
+    const std::vector<Cell> &locals = *stack[i].locals;
+    for (int r = registers.find_first(); r != -1;
+         r = registers.find_next(r))
+      if (!locals[r].value.isNull())
+        live.push_back(locals[r].value);
+  }
+  if (!lazyCondition.isNull())
+    live.push_back(lazyCondition);
+  live.insert(live.end(), lazyPointers->begin(), lazyPointers->end());
+  findSymbolicObjects(live.begin(), live.end(), arrays);
+  for (const auto &lazy : *lazyObjects)
+    arrays.push_back(lazy.first);
+}
+
+size_t ExecutionState::collectDeadConstraints() {
+  collectedConstraints = constraints.size();
+  // the values held by an open merge or a recorded call are not tracked
+  if (summaryRecording || !openMergeStack.empty())
+    return 0;
+
+  std::set<const Array *> dead;
+  for (size_t i = 0, e = symbolics->size(); i != e; ++i)
+    if (!addressSpace.findObject((*symbolics)[i].first))
+      dead.insert((*symbolics)[i].second);
+  if (dead.empty())
+    return 0;
+
+  std::vector<const Array *> liveArrays;
+  findLiveArrays(liveArrays);
+  for (const Array *array : liveArrays)
+    dead.erase(array);
+  if (dead.empty())
+    return 0;
+
+  std::vector<ConstraintManager::constraints_ty> factors;
+  constraints.getIndependentFactors(ConstantExpr::alloc(1, Expr::Bool),
+                                    factors);
+  ConstraintManager::constraints_ty dropped;
+  for (const ConstraintManager::constraints_ty &factor : factors) {
+    std::vector<const Array *> arrays;
+    findSymbolicObjects(factor.begin(), factor.end(), arrays);
+    if (!arrays.empty() &&
+        std::all_of(arrays.begin(), arrays.end(),
+                    [&](const Array *a) { return dead.count(a) != 0; }))
+      dropped.insert(dropped.end(), factor.begin(), factor.end());
+  }
+  if (dropped.empty())
+    return 0;
+
+  constraints.removeConstraints(dropped);
+  std::vector<ref<Expr> > &log = deadConstraints.mutate();
+  log.insert(log.end(), dropped.begin(), dropped.end());
+  collectedConstraints = constraints.size();
+  return dropped.size();
+}
+
+ConstraintManager ExecutionState::getPathConstraints() const {
+  if (deadConstraints->empty())
+    return constraints;
+  std::vector<ref<Expr> > all(constraints.begin(), constraints.end());
+  all.insert(all.end(), deadConstraints->begin(), deadConstraints->end());
+  return ConstraintManager(all);
+}
+
+void ExecutionState::addConstraint(ref<Expr> e) {
+  // The model may still be extended to satisfy the constraints if it
+  // satisfies the new one whatever the values of the arrays it leaves
+  // symbolic.
+  if (model) {
+    ref<Expr> value = model->evaluate(e);
+    if (!isa<ConstantExpr>(value) || !cast<ConstantExpr>(value)->isTrue())
+      model.reset();
+  }
+  constraints.addConstraint(e);
+}
+
+void ExecutionState::addFootprint(StateFootprint &footprint,
+                                  std::unordered_set<const void *> &seen) const {
+  // Rough sizes of the nodes of the standard containers.
+  const std::uint64_t treeNode = 4 * sizeof(void *);
+  auto add = [&](std::uint64_t &part, std::uint64_t bytes, bool exclusive) {
+    part += bytes;
+    if (exclusive)
+      footprint.exclusive += bytes;
+  };
+
+  add(footprint.stack, stack.capacity() * sizeof(StackFrame), true);
+  for (const StackFrame &sf : stack) {
+    add(footprint.stack, sf.allocas.capacity() * sizeof(const MemoryObject *),
+        true);
+    if (seen.insert(sf.locals.getIdentity()).second)
+      add(footprint.stack, sf.locals->capacity() * sizeof(Cell),
+          !sf.locals.isShared());
+  }
+  for (const auto &locals : localsPool)
+    add(footprint.stack, locals->capacity() * sizeof(Cell), true);
+
+  if (seen.insert(coveredInstructions.getIdentity()).second) {
+    // a list node for each run of the bits in use
+    std::uint64_t bytes = 0;
+    unsigned last = ~0u;
+    for (unsigned id : *coveredInstructions) {
+      unsigned element = id / llvm::SparseBitVectorElement<>::BITS_PER_ELEMENT;
+      if (element != last)
+        bytes += 2 * sizeof(void *) + sizeof(llvm::SparseBitVectorElement<>);
+      last = element;
+    }
+    add(footprint.coveredLines, bytes, !coveredInstructions.isShared());
+  }
+
+  if (seen.insert(arrayNames.getIdentity()).second) {
+    // the names themselves are interned, and shared by all the states
+    add(footprint.arrayNames,
+        arrayNames->size() * (treeNode + 2 * sizeof(unsigned)),
+        !arrayNames.isShared());
+  }
+
+  if (seen.insert(symbolics.getIdentity()).second)
+    add(footprint.symbolics,
+        symbolics->size() * sizeof(SymbolicList::value_type),
+        !symbolics.isShared());
+
+  add(footprint.constraints, constraints.size() * sizeof(ref<Expr>), true);
+
+  addressSpace.objects.forEachNode(
+      [&](const void *node, size_t bytes, bool exclusive,
+          const MemoryMap::value_type *values, unsigned count) {
+        if (!seen.insert(node).second)
+          return false;
+        add(footprint.addressSpace, bytes, exclusive);
+        for (unsigned i = 0; i < count; ++i) {
+          const ObjectState *os = values[i].second;
+          os->addFootprint(footprint, seen, exclusive);
+        }
+        return true;
+      });
 }
 
 /**/
@@ -179,6 +429,120 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
+uint64_t ExecutionState::getMergeFingerprint() const {
+  llvm::hash_code h = llvm::hash_value(static_cast<KInstruction *>(pc));
+  for (const StackFrame &sf : stack)
+    h = llvm::hash_combine(h, static_cast<KInstruction *>(sf.caller), sf.kf);
+  for (size_t i = 0, e = symbolics->size(); i != e; ++i)
+    h = llvm::hash_combine(h, (*symbolics)[i].first, (*symbolics)[i].second);
+  for (MemoryMap::iterator it = addressSpace.objects.begin(),
+                           ie = addressSpace.objects.end();
+       it != ie; ++it)
+    h = llvm::hash_combine(h, it->first);
+  return h;
+}
+
+std::uint64_t ExecutionState::getContentFingerprint() const {
+  llvm::hash_code h = llvm::hash_combine(static_cast<KInstruction *>(pc),
+                                         incomingBBIndex, forkDisabled);
+  llvm::BitVector registers;
+  for (size_t i = 0; i != stack.size(); ++i) {
+    const StackFrame &sf = stack[i];
+    h = llvm::hash_combine(h, static_cast<KInstruction *>(sf.caller), sf.kf);
+    getLiveRegisters(*this, i, registers);
+    const std::vector<Cell> &locals = *sf.locals;
+    for (int r = registers.find_first(); r != -1;
+         r = registers.find_next(r))
+      h = llvm::hash_combine(
+          h, r, locals[r].value.isNull() ? 0 : locals[r].value->hash());
+  }
+  // the objects allocated on different paths differ but may be alike
+  for (MemoryMap::iterator it = addressSpace.objects.begin(),
+                           ie = addressSpace.objects.end();
+       it != ie; ++it) {
+    const ObjectState *os = it->second;
+    h = llvm::hash_combine(h, it->first->address, os->readOnly,
+                           os->getContentHash());
+  }
+  return h;
+}
+
+void ExecutionState::getContents(StateContents &contents) const {
+  contents.pc = pc;
+  contents.incomingBBIndex = incomingBBIndex;
+  contents.forkDisabled = forkDisabled;
+  contents.frames.clear();
+  llvm::BitVector registers;
+  for (size_t i = 0; i != stack.size(); ++i) {
+    const StackFrame &sf = stack[i];
+    contents.frames.push_back(StateContents::Frame{sf.caller, sf.kf, {}});
+    getLiveRegisters(*this, i, registers);
+    const std::vector<Cell> &locals = *sf.locals;
+    for (int r = registers.find_first(); r != -1;
+         r = registers.find_next(r))
+      contents.frames.back().registers.emplace_back(r, locals[r].value);
+  }
+  contents.objects = addressSpace.objects;
+}
+
+bool ExecutionState::hasContents(const StateContents &contents) const {
+  if (pc != contents.pc || incomingBBIndex != contents.incomingBBIndex ||
+      forkDisabled != contents.forkDisabled ||
+      stack.size() != contents.frames.size())
+    return false;
+
+  llvm::BitVector registers;
+  for (size_t i = 0; i != stack.size(); ++i) {
+    const StackFrame &sf = stack[i];
+    const StateContents::Frame &frame = contents.frames[i];
+    if (static_cast<KInstruction *>(sf.caller) != frame.caller ||
+        sf.kf != frame.kf)
+      return false;
+    getLiveRegisters(*this, i, registers);
+    const std::vector<Cell> &locals = *sf.locals;
+    auto other = frame.registers.begin();
+    for (int r = registers.find_first(); r != -1;
+         r = registers.find_next(r), ++other) {
+      if (other == frame.registers.end() || other->first != (unsigned)r)
+        return false;
+      const ref<Expr> &value = locals[r].value;
+      if (value.isNull() != other->second.isNull() ||
+          (!value.isNull() && value != other->second))
+        return false;
+    }
+    if (other != frame.registers.end())
+      return false;
+  }
+
+  return addressSpace.objects.forEachUnshared(
+      contents.objects,
+      [](const MemoryMap::value_type &a, const MemoryMap::value_type &b) {
+        const ObjectState *os = a.second, *other = b.second;
+        if (a.first->address != b.first->address ||
+            a.first->size != b.first->size || os->readOnly != other->readOnly)
+          return false;
+        if (os == other)
+          return true;
+        for (unsigned i = 0; i != a.first->size; ++i)
+          if (os->read8(i) != other->read8(i))
+            return false;
+        return true;
+      });
+}
+
+/// Conjoins the constraints as a balanced tree, so that the expression
+/// only gets logarithmically deep in their number.
+static ref<Expr> createConjunction(const std::vector<ref<Expr> > &constraints,
+                                   size_t begin, size_t end) {
+  if (begin == end)
+    return ConstantExpr::alloc(1, Expr::Bool);
+  if (end - begin == 1)
+    return constraints[begin];
+  size_t mid = begin + (end - begin) / 2;
+  return AndExpr::create(createConjunction(constraints, begin, mid),
+                         createConjunction(constraints, mid, end));
+}
+
 bool ExecutionState::merge(const ExecutionState &b) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
@@ -188,7 +552,10 @@ bool ExecutionState::merge(const ExecutionState &b) {
 
   // XXX is it even possible for these to differ? does it matter? probably
   // implies difference in object states?
-  if (symbolics!=b.symbolics)
+  if (*symbolics != *b.symbolics)
+    return false;
+
+  if (*deadConstraints != *b.deadConstraints)
     return false;
 
   {
@@ -254,29 +621,32 @@ bool ExecutionState::merge(const ExecutionState &b) {
     llvm::errs() << "B: " << b.addressSpace.objects << "\n";
   }
     
+  // The parts of the maps the states still share since they forked hold
+  // the same bindings, so only the others are compared.
   std::set<const MemoryObject*> mutated;
-  MemoryMap::iterator ai = addressSpace.objects.begin();
-  MemoryMap::iterator bi = b.addressSpace.objects.begin();
-  MemoryMap::iterator ae = addressSpace.objects.end();
-  MemoryMap::iterator be = b.addressSpace.objects.end();
-  for (; ai!=ae && bi!=be; ++ai, ++bi) {
-    if (ai->first != bi->first) {
-      if (DebugLogStateMerge) {
-        if (ai->first < bi->first) {
-          llvm::errs() << "\t\tB misses binding for: " << ai->first->id << "\n";
-        } else {
-          llvm::errs() << "\t\tA misses binding for: " << bi->first->id << "\n";
+  bool sameBindings = addressSpace.objects.forEachUnshared(
+      b.addressSpace.objects,
+      [&](const MemoryMap::value_type &ea, const MemoryMap::value_type &eb) {
+        if (ea.first != eb.first) {
+          if (DebugLogStateMerge) {
+            if (ea.first < eb.first) {
+              llvm::errs() << "\t\tB misses binding for: " << ea.first->id
+                           << "\n";
+            } else {
+              llvm::errs() << "\t\tA misses binding for: " << eb.first->id
+                           << "\n";
+            }
+          }
+          return false;
         }
-      }
-      return false;
-    }
-    if (ai->second != bi->second) {
-      if (DebugLogStateMerge)
-        llvm::errs() << "\t\tmutated: " << ai->first->id << "\n";
-      mutated.insert(ai->first);
-    }
-  }
-  if (ai!=ae || bi!=be) {
+        if (ea.second != eb.second) {
+          if (DebugLogStateMerge)
+            llvm::errs() << "\t\tmutated: " << ea.first->id << "\n";
+          mutated.insert(ea.first);
+        }
+        return true;
+      });
+  if (!sameBindings) {
     if (DebugLogStateMerge)
       llvm::errs() << "\t\tmappings differ\n";
     return false;
@@ -284,14 +654,10 @@ bool ExecutionState::merge(const ExecutionState &b) {
   
   // merge stack
 
-  ref<Expr> inA = ConstantExpr::alloc(1, Expr::Bool);
-  ref<Expr> inB = ConstantExpr::alloc(1, Expr::Bool);
-  for (std::set< ref<Expr> >::iterator it = aSuffix.begin(), 
-         ie = aSuffix.end(); it != ie; ++it)
-    inA = AndExpr::create(inA, *it);
-  for (std::set< ref<Expr> >::iterator it = bSuffix.begin(), 
-         ie = bSuffix.end(); it != ie; ++it)
-    inB = AndExpr::create(inB, *it);
+  std::vector<ref<Expr> > aSuffixList(aSuffix.begin(), aSuffix.end());
+  std::vector<ref<Expr> > bSuffixList(bSuffix.begin(), bSuffix.end());
+  ref<Expr> inA = createConjunction(aSuffixList, 0, aSuffixList.size());
+  ref<Expr> inB = createConjunction(bSuffixList, 0, bSuffixList.size());
 
   // XXX should we have a preference as to which predicate to use?
   // it seems like it can make a difference, even though logically
@@ -302,9 +668,10 @@ bool ExecutionState::merge(const ExecutionState &b) {
   for (; itA!=stack.end(); ++itA, ++itB) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
+    std::vector<Cell> &locals = af.locals.mutate();
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> &av = locals[i].value;
+      const ref<Expr> &bv = (*bf.locals)[i].value;
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
@@ -323,19 +690,26 @@ bool ExecutionState::merge(const ExecutionState &b) {
            "objects mutated but not writable in merging state");
     assert(otherOS);
 
+    // the bytes which are the same in both need no select
     ObjectState *wos = addressSpace.getWriteable(mo, os);
     for (unsigned i=0; i<mo->size; i++) {
       ref<Expr> av = wos->read8(i);
       ref<Expr> bv = otherOS->read8(i);
-      wos->write(i, SelectExpr::create(inA, av, bv));
+      if (av != bv)
+        wos->write(i, SelectExpr::create(inA, av, bv));
     }
   }
 
   constraints = ConstraintManager();
+  model.reset();
   for (std::set< ref<Expr> >::iterator it = commonConstraints.begin(), 
          ie = commonConstraints.end(); it != ie; ++it)
     constraints.addConstraint(*it);
   constraints.addConstraint(OrExpr::create(inA, inB));
+  summaryRecording.reset();
+  // the constraints are weaker now
+  inBoundsAccesses = ImmutableSet<std::tuple<unsigned, ref<Expr>, unsigned> >();
+  reachedTarget |= b.reachedTarget;
 
   return true;
 }
@@ -362,7 +736,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = (*sf.locals)[sf.kf->getArgRegister(index++)].value;
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
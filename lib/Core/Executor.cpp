@@ -10,18 +10,24 @@
 #include "Executor.h"
 
 #include "../Expr/ArrayExprOptimizer.h"
+#include "AsyncBranchQueries.h"
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExecutorTimerInfo.h"
 #include "ExternalDispatcher.h"
+#include "FuzzerBridge.h"
+#include "GenerationalSearch.h"
+#include "FunctionSummaries.h"
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
 #include "PTree.h"
 #include "Searcher.h"
+#include "SearcherModel.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
 #include "StatsTracker.h"
+#include "Subsumption.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
 
@@ -39,7 +45,10 @@
 #include "klee/Internal/Support/FileHandling.h"
 #include "klee/Internal/Support/FloatEvaluation.h"
 #include "klee/Internal/Support/ModuleUtil.h"
+#include "klee/Internal/Support/PTreeLog.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/NUMA.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Interpreter.h"
 #include "klee/OptionCategories.h"
@@ -47,11 +56,13 @@
 #include "klee/SolverStats.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprAllocator.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprSMTLIBPrinter.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/GetElementPtrTypeIterator.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/Attributes.h"
@@ -65,6 +76,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
@@ -78,9 +90,13 @@
 #include <fstream>
 #include <iomanip>
 #include <iosfwd>
+#include <signal.h>
 #include <sstream>
 #include <string>
 #include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_set>
 #include <vector>
 
 using namespace llvm;
@@ -122,6 +138,20 @@ cl::opt<bool> OnlyOutputStatesCoveringNew(
     cl::desc("Only output test cases covering new code (default=false)"),
     cl::cat(TestGenCat));
 
+cl::opt<bool> DedupTestCases(
+    "dedup-test-cases",
+    cl::init(false),
+    cl::desc("Do not output test cases for paths which took the same control "
+             "flow edges as one already output, except errors (default=false)"),
+    cl::cat(TestGenCat));
+
+cl::opt<bool> MinimizeTestCases(
+    "minimize-test-cases",
+    cl::init(false),
+    cl::desc("Make the bytes of test cases zero wherever their paths allow it, "
+             "at the cost of extra queries (default=false)"),
+    cl::cat(TestGenCat));
+
 cl::opt<bool> EmitAllErrors(
     "emit-all-errors", cl::init(false),
     cl::desc("Generate tests cases for all errors "
@@ -146,12 +176,88 @@ cl::opt<bool>
                                 "from other constraints (default=false)"),
                        cl::cat(SolvingCat));
 
+cl::opt<bool> ImpliedValueConcretization(
+    "implied-value-concretization",
+    cl::init(true),
+    cl::desc("Write the values constraints imply for bytes of symbolic "
+             "objects to the objects, so that later reads of them are "
+             "concrete (default=true)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     EqualitySubstitution("equality-substitution", cl::init(true),
                          cl::desc("Simplify equality expressions before "
                                   "querying the solver (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool> UseStateModels(
+    "use-state-models", cl::init(true),
+    cl::desc("Keep an assignment satisfying the constraints of each state, "
+             "found while deciding its branches, and check queries against "
+             "it before the solver (default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> ModelTrieSize(
+    "model-trie-size", cl::init(100000),
+    cl::desc("Keep the models found with --use-state-models in a trie of "
+             "up to this many constraint nodes, and give a state which "
+             "loses its model the one of the nearest ancestor still "
+             "satisfying its constraints; 0 disables it (default=100000)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> CollectDeadConstraints(
+    "collect-dead-constraints", cl::init(false),
+    cl::desc("Drop from the queries the constraints over the symbolic "
+             "objects which were freed, or popped with their frame, once "
+             "no value refers to them any more. They are kept for "
+             "generating test cases (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> AsyncBranchQueryLimit(
+    "async-branch-queries", cl::init(0),
+    cl::desc("Maximum number of symbolic branch conditions evaluated at once "
+             "in forked processes while other states keep running. States "
+             "waiting for an answer are not scheduled. Set to 0 to evaluate "
+             "them synchronously (default=0)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> DeterministicAsyncQueries(
+    "deterministic-async-queries", cl::init(false),
+    cl::desc("With --async-branch-queries, resume the waiting states in "
+             "epochs of 256 steps, in the order their queries were started, "
+             "waiting for the queries still running at the end of an epoch. "
+             "The exploration then does not depend on how fast the queries "
+             "are answered (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> LazyFork(
+    "lazy-fork", cl::init(false),
+    cl::desc("Fork on symbolic branches without asking the solver which "
+             "sides are feasible. Each side is checked only when its state "
+             "is next selected, and dropped if infeasible (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> LazyInit(
+    "lazy-init", cl::init(false),
+    cl::desc("Bind the symbolic pointers read from symbolic memory on their "
+             "first dereference: a path for null, one for each object made "
+             "this way before of the same size, and one for a new symbolic "
+             "object (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> LazyInitSize(
+    "lazy-init-size", cl::init(256),
+    cl::desc("Size in bytes of the objects made by --lazy-init "
+             "(default=256)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> LazyInitDepth(
+    "lazy-init-depth", cl::init(3),
+    cl::desc("Largest number of objects made by --lazy-init on the way to "
+             "an object. Deeper pointers may only be null or alias "
+             "(default=3)"),
+    cl::cat(SolvingCat));
+
 
 /*** External call policy options ***/
 
@@ -180,6 +286,33 @@ cl::opt<ExternalCallPolicy> ExternalCalls(
     cl::init(ExternalCallPolicy::Concrete),
     cl::cat(ExtCallsCat));
 
+cl::opt<bool> ExternalCallsCopyReachable(
+    "external-calls-copy-reachable",
+    cl::init(false),
+    cl::desc("Only copy the objects reachable from the pointers passed to an "
+             "external call to and from native memory, instead of all "
+             "objects of the state. Faster, but misses changes the call "
+             "makes through other pointers, such as to globals "
+             "(default=false)"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<bool> ExternalCallsProcess(
+    "external-calls-process",
+    cl::init(false),
+    cl::desc("Run external calls in a separate process, which shares the "
+             "memory of the objects with KLEE and is started anew when a "
+             "call crashes it. Requires --allocate-determ or "
+             "--allocate-virtual. Memory outside of the objects, such as the "
+             "globals of the C library, is not shared (default=false)"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<std::string> ExternalCallTimeout(
+    "external-call-timeout",
+    cl::desc("Kill the process of --external-calls-process when a call takes "
+             "longer than this, failing the call.  Set to 0s to disable "
+             "(default=0s)"),
+    cl::cat(ExtCallsCat));
+
 cl::opt<bool> SuppressExternalWarnings(
     "suppress-external-warnings",
     cl::init(false),
@@ -193,6 +326,81 @@ cl::opt<bool> AllExternalWarnings(
              "as opposed to once per function (default=false)"),
     cl::cat(ExtCallsCat));
 
+cl::opt<bool> FastMemFunctions(
+    "fast-mem-functions",
+    cl::init(false),
+    cl::desc("Carry out calls to memcpy, memmove and memset with concrete "
+             "pointers and sizes within bounds directly on the objects, "
+             "instead of interpreting the byte loops of their bodies. "
+             "Symbolic sizes are handled without forking if they cannot "
+             "exceed the objects (default=false)"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<bool> LazyGlobals(
+    "lazy-globals",
+    cl::init(true),
+    cl::desc("Write the initializer of a global to its memory only once the "
+             "global is first accessed, computing it once for all states "
+             "(default=true)"),
+    cl::cat(ModuleCat));
+
+cl::opt<bool> FastStringFunctions(
+    "fast-string-functions",
+    cl::init(false),
+    cl::desc("Carry out calls to strlen, strcmp, strncmp, memcmp, memchr, "
+             "strchr and strrchr natively when the bytes they read are "
+             "concrete, and interpret their bodies otherwise "
+             "(default=false)"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<bool> PruneSubsumedStates(
+    "prune-subsumed-states",
+    cl::init(false),
+    cl::desc("Terminate the states which reach a join block with the stack "
+             "and memory contents of a state whose paths from there were "
+             "all explored, when their constraints imply those of that "
+             "state over these contents. Hashes the contents at each join "
+             "block (default=false)"),
+    cl::cat(TerminationCat));
+
+enum class PruneCovered {
+  Off,    // Keep the states
+  Silent, // Terminate them without a test case
+  Test,   // Terminate them early, with a test case
+};
+
+cl::opt<PruneCovered> PruneCoveredStates(
+    "prune-covered-states",
+    cl::desc("What to do with the states from which no uncovered instruction "
+             "is reachable any more, through the callers they return to "
+             "(default=off)"),
+    cl::values(clEnumValN(PruneCovered::Off, "off",
+                          "Keep running them, as they may still find errors "
+                          "in covered code"),
+               clEnumValN(PruneCovered::Silent, "silent",
+                          "Terminate them without a test case"),
+               clEnumValN(PruneCovered::Test, "test",
+                          "Terminate them early, with a test case of the "
+                          "path so far") KLEE_LLVM_CL_VAL_END),
+    cl::init(PruneCovered::Off), cl::cat(TerminationCat));
+
+cl::opt<bool> DropDuplicateStates(
+    "drop-duplicate-states",
+    cl::init(false),
+    cl::desc("Terminate the states which reach a join block with the stack, "
+             "memory contents and constraints over these contents of a "
+             "state seen there before (default=false)"),
+    cl::cat(TerminationCat));
+
+cl::opt<bool> SummarizeFunctions(
+    "summarize-functions",
+    cl::init(false),
+    cl::desc("Record the effects of calls with concrete arguments which only "
+             "compute on concrete data, and replay them for later calls "
+             "with the same arguments on the same memory contents instead "
+             "of interpreting the body again (default=false)"),
+    cl::cat(ExtCallsCat));
+
 
 /*** Seeding options ***/
 
@@ -247,6 +455,23 @@ cl::opt<std::string>
                       "search (default=0s (off))"),
              cl::cat(SeedingCat));
 
+cl::opt<bool> Concolic(
+    "concolic", cl::init(false),
+    cl::desc("Search generationally from the seeds, executing a single path "
+             "at a time: each input is followed to the end of its path, and "
+             "each branch taken is negated in turn to get new inputs, those "
+             "of the inputs covering the most new instructions first "
+             "(default=false)"),
+    cl::cat(SeedingCat));
+
+cl::opt<unsigned> SeedWorkers(
+    "seed-workers", cl::init(1),
+    cl::desc("Replay the seeds in this many forked processes, each with its "
+             "share of the seeds. The main process then re-creates their "
+             "states by following their branch decisions, without querying "
+             "the solver (default=1)"),
+    cl::cat(SeedingCat));
+
 
 /*** Termination criteria options ***/
 
@@ -300,6 +525,21 @@ cl::opt<unsigned> MaxMemory("max-memory",
                             cl::init(2000),
                             cl::cat(TerminationCat));
 
+enum class MemoryKillPolicy { Random, Exclusive };
+
+cl::opt<MemoryKillPolicy> MaxMemoryKill(
+    "max-memory-kill",
+    cl::desc("Which states to terminate when well above the memory cap"),
+    cl::values(clEnumValN(MemoryKillPolicy::Random, "random",
+                          "Random states, preferably not those which covered "
+                          "new code (default)"),
+               clEnumValN(MemoryKillPolicy::Exclusive, "exclusive",
+                          "The states holding the most memory which no other "
+                          "state shares, until about enough is freed, after "
+                          "dropping the function summaries")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::init(MemoryKillPolicy::Random), cl::cat(TerminationCat));
+
 cl::opt<bool> MaxMemoryInhibit(
     "max-memory-inhibit",
     cl::desc(
@@ -307,6 +547,15 @@ cl::opt<bool> MaxMemoryInhibit(
     cl::init(true),
     cl::cat(TerminationCat));
 
+cl::opt<bool> SwapStates(
+    "swap-states",
+    cl::desc("Instead of terminating states when far above the memory cap, "
+             "write the branch decisions of the least recently scheduled ones "
+             "to the output directory, and re-create them by re-executing "
+             "those decisions once memory is available (default=false)"),
+    cl::init(false),
+    cl::cat(TerminationCat));
+
 cl::opt<unsigned> RuntimeMaxStackFrames(
     "max-stack-frames",
     cl::desc("Terminate a state after this many stack frames.  Set to 0 to "
@@ -347,6 +596,20 @@ cl::opt<double> MaxStaticCPSolvePct(
              "instructions (default=1.0 (always))"),
     cl::cat(TerminationCat));
 
+cl::opt<bool> Checkpoint(
+    "checkpoint", cl::init(false),
+    cl::desc("Write the branch decisions of all live states to "
+             "checkpoint.ktree in the output directory when execution halts, "
+             "to continue with --resume-from later (default=false)"),
+    cl::cat(TerminationCat));
+
+cl::opt<std::string> ResumeFrom(
+    "resume-from",
+    cl::desc("Re-create the states of a checkpoint written by --checkpoint "
+             "by following their decisions without querying the solver, and "
+             "skip the paths which were already completed (default=off)"),
+    cl::cat(TerminationCat));
+
 
 /*** Debugging options ***/
 
@@ -394,6 +657,12 @@ cl::opt<bool> DebugCompressInstructions(
     cl::cat(DebugCat));
 #endif
 
+cl::opt<bool> WritePTreeLog(
+    "write-ptree-log", cl::init(false),
+    cl::desc("Stream the splits and removals of the process tree to "
+             "ptree.bin as they happen, for klee-ptree (default=false)"),
+    cl::cat(DebugCat));
+
 cl::opt<bool> DebugCheckForImpliedValues(
     "debug-check-for-implied-values", cl::init(false),
     cl::desc("Debug the implied value optimization"),
@@ -424,11 +693,19 @@ const char *Executor::TerminateReasonNames[] = {
 Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
                    InterpreterHandler *ih)
     : Interpreter(opts), interpreterHandler(ih), searcher(0),
-      externalDispatcher(new ExternalDispatcher(ctx)), statsTracker(0),
+      externalDispatcher(new ExternalDispatcher(
+          ctx, ExternalCallsProcess, time::Span(ExternalCallTimeout))),
+      statsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
-      processTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
+      processTree(0), asyncQueries(0), speculative(false), lastSelected(0),
+      functionSummaries(0), fuzzerBridge(0), subsumption(0),
+      subpathLength(0), concolic(0), concolicCoverage(0), swapRoot(0),
+      swapFileCount(0), seedWorker(0),
+      replayKTest(0), replayPath(0),
+      replayPathIsPrefix(false), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
-      ivcEnabled(false), debugLogBuffer(debugBufferString) {
+      constantsBound(false),
+      ivcEnabled(ImpliedValueConcretization), debugLogBuffer(debugBufferString) {
 
 
   const time::Span maxCoreSolverTime(MaxCoreSolverTime);
@@ -448,12 +725,53 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      interpreterHandler->getOutputFilename(ALL_QUERIES_BINARY_FILE_NAME),
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_BINARY_FILE_NAME));
+
+  this->solver = new TimingSolver(solver, EqualitySubstitution, UseStateModels,
+                                  ModelTrieSize);
+  memory = new MemoryManager(&arrayCache, ExternalCallsProcess);
+
+  if (AsyncBranchQueryLimit)
+    asyncQueries = new AsyncBranchQueries(AsyncBranchQueryLimit);
+
+  if (SpeculativeQueries) {
+    // only the solver workers answer speculative queries in the background
+    speculative = CoreSolverToUse == STP_SOLVER && UseForkedCoreSolver &&
+                  SolverWorkers > 1;
+    if (!speculative)
+      klee_warning("--speculative-queries needs at least two solver workers "
+                   "of the STP core solver, ignoring it");
+  }
+
+  if (SummarizeFunctions)
+    functionSummaries = new FunctionSummaries();
 
-  this->solver = new TimingSolver(solver, EqualitySubstitution);
-  memory = new MemoryManager(&arrayCache);
+  if (PruneSubsumedStates || DropDuplicateStates)
+    subsumption = new SubsumptionTable();
+
+  fuzzerBridge = FuzzerBridge::create();
 
   initializeSearchOptions();
+  subpathLength = userSearcherSubpathLength();
+  if (userSearcherWritesFeatures()) {
+    std::string error;
+    searcherFeaturesFile = klee_open_output_file(
+        interpreterHandler->getOutputFilename("searcher-features.csv"), error);
+    if (!searcherFeaturesFile)
+      klee_error("unable to open searcher-features.csv: %s", error.c_str());
+    SearcherModel::writeHeader(*searcherFeaturesFile);
+  }
+
+  if (WritePTreeLog) {
+    std::string error;
+    auto os = klee_open_output_file(
+        interpreterHandler->getOutputFilename("ptree.bin"), error);
+    if (!os)
+      klee_error("unable to open ptree.bin: %s", error.c_str());
+    ptreeLog.reset(new ptreelog::Writer(std::move(os)));
+  }
 
   if (OnlyOutputStatesCoveringNew && !StatsTracker::useIStats())
     klee_error("To use --only-output-states-covering-new, you need to enable --output-istats.");
@@ -500,40 +818,71 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
     klee_error("Could not load KLEE intrinsic file %s", LibPath.c_str());
   }
 
-  // 1.) Link the modules together
-  while (kmodule->link(modules, opts.EntryPoint)) {
-    // 2.) Apply different instrumentation
-    kmodule->instrument(opts);
-  }
+  // A module prepared by an earlier run from the same modules and options
+  // replaces steps 1.) to 3.)
+  std::string preparedPath;
+  if (!opts.CacheDir.empty())
+    preparedPath = KModule::getPreparedPath(modules, opts);
+  bool loadedPrepared =
+      !preparedPath.empty() &&
+      kmodule->loadPrepared(preparedPath, modules[0]->getContext(), opts);
+  specialFunctionHandler = new SpecialFunctionHandler(*this);
+  if (loadedPrepared) {
+    klee_message("Using prepared module %s", preparedPath.c_str());
+  } else {
+    // 1.) Link the modules together
+    while (kmodule->link(modules, opts.EntryPoint)) {
+      // 2.) Apply different instrumentation
+      kmodule->instrument(opts);
+    }
 
-  // 3.) Optimise and prepare for KLEE
+    // 3.) Optimise and prepare for KLEE
 
-  // Create a list of functions that should be preserved if used
-  std::vector<const char *> preservedFunctions;
-  specialFunctionHandler = new SpecialFunctionHandler(*this);
-  specialFunctionHandler->prepare(preservedFunctions);
+    // Create a list of functions that should be preserved if used
+    std::vector<const char *> preservedFunctions;
+    specialFunctionHandler->prepare(preservedFunctions);
 
-  preservedFunctions.push_back(opts.EntryPoint.c_str());
+    preservedFunctions.push_back(opts.EntryPoint.c_str());
+    for (const std::string &name : opts.ExtraEntryPoints)
+      preservedFunctions.push_back(name.c_str());
 
-  // Preserve the free-standing library calls
-  preservedFunctions.push_back("memset");
-  preservedFunctions.push_back("memcpy");
-  preservedFunctions.push_back("memcmp");
-  preservedFunctions.push_back("memmove");
+    // Preserve the free-standing library calls
+    preservedFunctions.push_back("memset");
+    preservedFunctions.push_back("memcpy");
+    preservedFunctions.push_back("memcmp");
+    preservedFunctions.push_back("memmove");
 
-  kmodule->optimiseAndPrepare(opts, preservedFunctions);
+    kmodule->optimiseAndPrepare(opts, preservedFunctions);
+  }
   kmodule->checkModule();
+  if (!preparedPath.empty() && !loadedPrepared)
+    kmodule->storePrepared(preparedPath);
 
   // 4.) Manifest the module
-  kmodule->manifest(interpreterHandler, StatsTracker::useStatistics());
+  // Without statistics nothing needs the functions never called, so they
+  // are only manifested once they are.
+  bool needMD2U =
+      userSearcherRequiresMD2U() || PruneCoveredStates != PruneCovered::Off;
+  bool needAllFunctions = StatsTracker::useStatistics() || needMD2U;
+  kmodule->manifest(interpreterHandler, StatsTracker::useStatistics(),
+                    /*lazyFunctions=*/!needAllFunctions);
+  for (auto &kf : kmodule->functions)
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      bindInstructionConstants(kf->instructions[i]);
 
   specialFunctionHandler->bind();
 
-  if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
+  if (!getUserTargets().empty()) {
+    std::string error;
+    if (!kmodule->setTargets(getUserTargets(), error))
+      klee_error("%s", error.c_str());
+  }
+
+  if (needAllFunctions) {
     statsTracker = 
       new StatsTracker(*this,
                        interpreterHandler->getOutputFilename("assembly.ll"),
-                       userSearcherRequiresMD2U());
+                       needMD2U);
   }
 
   // Initialize the context.
@@ -550,6 +899,10 @@ Executor::~Executor() {
   delete processTree;
   delete specialFunctionHandler;
   delete statsTracker;
+  delete asyncQueries;
+  delete functionSummaries;
+  delete fuzzerBridge;
+  delete subsumption;
   delete solver;
   while(!timers.empty()) {
     delete timers.back();
@@ -559,15 +912,14 @@ Executor::~Executor() {
 
 /***/
 
-void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
-                                      const Constant *c, 
+void Executor::initializeGlobalObject(ObjectState *os, const Constant *c,
                                       unsigned offset) {
   const auto targetData = kmodule->targetData.get();
   if (const ConstantVector *cp = dyn_cast<ConstantVector>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(cp->getType()->getElementType());
     for (unsigned i=0, e=cp->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, cp->getOperand(i), 
+      initializeGlobalObject(os, cp->getOperand(i), 
 			     offset + i*elementSize);
   } else if (isa<ConstantAggregateZero>(c)) {
     unsigned i, size = targetData->getTypeStoreSize(c->getType());
@@ -577,20 +929,20 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
     unsigned elementSize =
       targetData->getTypeStoreSize(ca->getType()->getElementType());
     for (unsigned i=0, e=ca->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, ca->getOperand(i), 
+      initializeGlobalObject(os, ca->getOperand(i), 
 			     offset + i*elementSize);
   } else if (const ConstantStruct *cs = dyn_cast<ConstantStruct>(c)) {
     const StructLayout *sl =
       targetData->getStructLayout(cast<StructType>(cs->getType()));
     for (unsigned i=0, e=cs->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, cs->getOperand(i), 
+      initializeGlobalObject(os, cs->getOperand(i), 
 			     offset + sl->getElementOffset(i));
   } else if (const ConstantDataSequential *cds =
                dyn_cast<ConstantDataSequential>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(cds->getElementType());
     for (unsigned i=0, e=cds->getNumElements(); i != e; ++i)
-      initializeGlobalObject(state, os, cds->getElementAsConstant(i),
+      initializeGlobalObject(os, cds->getElementAsConstant(i),
                              offset + i*elementSize);
   } else if (!isa<UndefValue>(c) && !isa<MetadataAsValue>(c)) {
     unsigned StoreBits = targetData->getTypeStoreSizeInBits(c->getType());
@@ -788,8 +1140,16 @@ void Executor::initializeGlobals(ExecutionState &state) {
       const ObjectState *os = state.addressSpace.findObject(mo);
       assert(os);
       ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-      
-      initializeGlobalObject(state, wos, i->getInitializer(), 0);
+
+      if (LazyGlobals) {
+        const Constant *init = i->getInitializer();
+        wos->initializeLazily(std::make_shared<LazyContents>(
+            [this, init](ObjectState &os) {
+              initializeGlobalObject(&os, init, 0);
+            }));
+        continue;
+      }
+      initializeGlobalObject(wos, i->getInitializer(), 0);
       // if(i->isConstant()) os->setReadOnly(true);
     }
   }
@@ -799,10 +1159,37 @@ void Executor::branch(ExecutionState &state,
                       const std::vector< ref<Expr> > &conditions,
                       std::vector<ExecutionState*> &result) {
   TimerStatIncrementer timer(stats::forkTime);
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginFork);
   unsigned N = conditions.size();
   assert(N);
 
-  if (MaxForks!=~0u && stats::forks >= MaxForks) {
+  // Stop following the checkpoint if it took none of these branches.
+  const CheckpointTree::Node *resumed = getResumeNode(state);
+  if (resumed && (resumed->children.empty() ||
+                  resumed->children.front().first >= N))
+    resumed = 0;
+
+  if (resumed) {
+    // Only re-create the states which were alive or still had live
+    // descendants when the checkpoint was written.
+    for (unsigned i=0; i<N; ++i) {
+      if (!resumed->getChild(i)) {
+        result.push_back(NULL);
+      } else if (std::find(result.begin(), result.end(), &state) ==
+                 result.end()) {
+        result.push_back(&state);
+      } else {
+        ++stats::forks;
+        ExecutionState *ns = state.branch();
+        addedStates.push_back(ns);
+        result.push_back(ns);
+        std::pair<PTree::Node*,PTree::Node*> res =
+          processTree->split(state.ptreeNode, ns, &state);
+        ns->ptreeNode = res.first;
+        state.ptreeNode = res.second;
+      }
+    }
+  } else if (MaxForks!=~0u && stats::forks >= MaxForks) {
     unsigned next = theRNG.getInt32() % N;
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
@@ -821,7 +1208,6 @@ void Executor::branch(ExecutionState &state,
       ExecutionState *ns = es->branch();
       addedStates.push_back(ns);
       result.push_back(ns);
-      es->ptreeNode->data = 0;
       std::pair<PTree::Node*,PTree::Node*> res = 
         processTree->split(es->ptreeNode, ns, es);
       ns->ptreeNode = res.first;
@@ -829,6 +1215,11 @@ void Executor::branch(ExecutionState &state,
     }
   }
 
+  for (unsigned i=0; i<N; ++i)
+    if (result[i])
+      recordDecision(*result[i], i,
+                     resumed ? resumed->getChild(i) : 0);
+
   // If necessary redistribute seeds to match conditions, killing
   // states if necessary due to OnlyReplaySeeds (inefficient but
   // simple).
@@ -839,17 +1230,18 @@ void Executor::branch(ExecutionState &state,
     std::vector<SeedInfo> seeds = it->second;
     seedMap.erase(it);
 
+    std::vector<std::vector<ref<Expr> > > seedValues(N);
+    for (unsigned i=0; i<N; ++i)
+      evaluateSeeds(seeds, conditions[i], seedPrograms, seedValues[i]);
+
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
     // a tautology).
-    for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-           siie = seeds.end(); siit != siie; ++siit) {
+    for (unsigned k=0; k<seeds.size(); ++k) {
       unsigned i;
       for (i=0; i<N; ++i) {
         ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(state, siit->assignment.evaluate(conditions[i]), 
-                           res);
+        bool success = solver->getValue(state, seedValues[i][k], res);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
         if (res->isTrue())
@@ -863,10 +1255,10 @@ void Executor::branch(ExecutionState &state,
 
       // Extra check in case we're replaying seeds with a max-fork
       if (result[i])
-        seedMap[result[i]].push_back(*siit);
+        seedMap[result[i]].push_back(seeds[k]);
     }
 
-    if (OnlyReplaySeeds) {
+    if (OnlyReplaySeeds || concolic) {
       for (unsigned i=0; i<N; ++i) {
         if (result[i] && !seedMap.count(result[i])) {
           terminateState(*result[i]);
@@ -883,6 +1275,10 @@ void Executor::branch(ExecutionState &state,
 
 Executor::StatePair 
 Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
+  KLEE_TRACE_SCOPE("Executor::fork");
+  // internal forks are attributed to the operation forking
+  TimingSolver::OriginScope origin(
+      solver, isInternal ? solver->getOrigin() : TimingSolver::OriginFork);
   Solver::Validity res;
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&current);
@@ -915,23 +1311,71 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     }
   }
 
-  time::Span timeout = coreSolverTimeout;
-  if (isSeeding)
-    timeout *= static_cast<unsigned>(it->second.size());
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current, condition, res);
-  solver->setTimeout(time::Span());
+  // A state resumed from a checkpoint follows the recorded decisions.
+  bool symbolic = !isa<ConstantExpr>(condition);
+  // The condition under each seed, evaluated once for all of them.
+  std::vector<ref<Expr> > seedValues;
+  const CheckpointTree::Node *resumed = 0, *resumedTrue = 0, *resumedFalse = 0;
+  if (symbolic && !isSeeding && (resumed = getResumeNode(current))) {
+    resumedTrue = resumed->getChild(1);
+    resumedFalse = resumed->getChild(0);
+    if (!resumedTrue && !resumedFalse)
+      resumed = 0;
+  }
+
+  bool success;
+  TimingSolver::BranchModels models;
+  auto async = asyncBranchResults.find(&current);
+  // the states of a seed worker are re-created without checks
+  bool lazy = LazyFork && symbolic && !isInternal && !isSeeding &&
+              !seedWorker && !resumed && !isReplaying() &&
+              async == asyncBranchResults.end() &&
+              !(MaxMemoryInhibit && atMemoryLimit) && !current.forkDisabled &&
+              !inhibitForking && (MaxForks == ~0u || stats::forks < MaxForks);
+  if (lazy) {
+    // Both sides are checked by checkLazyFork() once selected.
+    success = true;
+    res = Solver::Unknown;
+  } else if (resumed) {
+    success = true;
+    if (resumedTrue && resumedFalse) {
+      res = Solver::Unknown;
+    } else {
+      // The decision may have been forced, so the constraint is needed.
+      res = resumedTrue ? Solver::True : Solver::False;
+      addConstraint(current, resumedTrue ? condition
+                                         : Expr::createIsZero(condition));
+    }
+  } else if (concolic && isSeeding && symbolic) {
+    // The input decides, the other side is checked once the path ends.
+    success = true;
+    res = Solver::Unknown;
+  } else if (async != asyncBranchResults.end() &&
+      async->second.condition == condition) {
+    success = async->second.success;
+    res = async->second.validity;
+  } else {
+    time::Span timeout = coreSolverTimeout;
+    if (isSeeding)
+      timeout *= static_cast<unsigned>(it->second.size());
+    solver->setTimeout(timeout);
+    success = solver->evaluate(current, condition, res, &models);
+    solver->setTimeout(time::Span());
+  }
+  // the answer is only for the first execution of the deferred branch
+  if (async != asyncBranchResults.end())
+    asyncBranchResults.erase(async);
   if (!success) {
     current.pc = current.prevPC;
     terminateStateEarly(current, "Query timed out (fork).");
     return StatePair(0, 0);
   }
 
-  if (!isSeeding) {
-    if (replayPath && !isInternal) {
-      assert(replayPosition<replayPath->size() &&
+  if (!isSeeding && !resumed) {
+    if (isReplaying() && !isInternal) {
+      assert(!replayCursor.atEnd() &&
              "ran out of branches in replay path mode");
-      bool branch = (*replayPath)[replayPosition++];
+      bool branch = replayCursor.next();
       
       if (res==Solver::True) {
         assert(branch && "hit invalid branch in replay path mode");
@@ -979,15 +1423,14 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   // Fix branch in only-replay-seed mode, if we don't have both true
   // and false seeds.
   if (isSeeding && 
-      (current.forkDisabled || OnlyReplaySeeds) && 
+      (current.forkDisabled || OnlyReplaySeeds || concolic) &&
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
+    evaluateSeeds(it->second, condition, seedPrograms, seedValues);
     // Is seed extension still ok here?
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    for (const ref<Expr> &value : seedValues) {
       ref<ConstantExpr> res;
-      bool success = 
-        solver->getValue(current, siit->assignment.evaluate(condition), res);
+      bool success = solver->getValue(current, value, res);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
       if (res->isTrue()) {
@@ -1002,6 +1445,8 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       assert(trueSeed || falseSeed);
       
       res = trueSeed ? Solver::True : Solver::False;
+      if (concolic)
+        concolic->recordBranch();
       addConstraint(current, trueSeed ? condition : Expr::createIsZero(condition));
     }
   }
@@ -1020,6 +1465,10 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         current.pathOS << "1";
       }
     }
+    if (symbolic)
+      recordDecision(current, 1, resumed ? resumedTrue : 0);
+    if (models.trueModel)
+      current.model = models.trueModel;
 
     return StatePair(&current, 0);
   } else if (res==Solver::False) {
@@ -1028,6 +1477,10 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         current.pathOS << "0";
       }
     }
+    if (symbolic)
+      recordDecision(current, 0, resumed ? resumedFalse : 0);
+    if (models.falseModel)
+      current.model = models.falseModel;
 
     return StatePair(0, &current);
   } else {
@@ -1042,19 +1495,19 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     if (it != seedMap.end()) {
       std::vector<SeedInfo> seeds = it->second;
       it->second.clear();
+      if (seedValues.empty())
+        evaluateSeeds(seeds, condition, seedPrograms, seedValues);
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
-      for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-             siie = seeds.end(); siit != siie; ++siit) {
+      for (unsigned k = 0; k < seeds.size(); ++k) {
         ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
+        bool success = solver->getValue(current, seedValues[k], res);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
         if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
+          trueSeeds.push_back(seeds[k]);
         } else {
-          falseSeeds.push_back(*siit);
+          falseSeeds.push_back(seeds[k]);
         }
       }
       
@@ -1069,11 +1522,11 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
-        std::swap(trueState->coveredLines, falseState->coveredLines);
+        std::swap(trueState->coveredInstructions,
+                  falseState->coveredInstructions);
       }
     }
 
-    current.ptreeNode->data = 0;
     std::pair<PTree::Node*, PTree::Node*> res =
       processTree->split(current.ptreeNode, falseState, trueState);
     falseState->ptreeNode = res.first;
@@ -1096,8 +1549,20 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
     }
 
-    addConstraint(*trueState, condition);
-    addConstraint(*falseState, Expr::createIsZero(condition));
+    recordDecision(*trueState, 1, resumedTrue);
+    recordDecision(*falseState, 0, resumedFalse);
+
+    if (models.trueModel)
+      trueState->model = models.trueModel;
+    if (models.falseModel)
+      falseState->model = models.falseModel;
+    if (lazy) {
+      trueState->lazyCondition = condition;
+      falseState->lazyCondition = Expr::createIsZero(condition);
+    } else {
+      addConstraint(*trueState, condition);
+      addConstraint(*falseState, Expr::createIsZero(condition));
+    }
 
     // Kinda gross, do we even really still want this option?
     if (MaxDepth && MaxDepth<=trueState->depth) {
@@ -1122,15 +1587,15 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
     seedMap.find(&state);
   if (it != seedMap.end()) {
     bool warn = false;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    std::vector<ref<Expr> > seedValues;
+    evaluateSeeds(it->second, condition, seedPrograms, seedValues);
+    for (unsigned k = 0; k < seedValues.size(); ++k) {
       bool res;
-      bool success = 
-        solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
+      bool success = solver->mustBeFalse(state, seedValues[k], res);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
       if (res) {
-        siit->patchSeed(state, condition, solver);
+        it->second[k].patchSeed(state, condition, solver);
         warn = true;
       }
     }
@@ -1139,6 +1604,10 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   }
 
   state.addConstraint(condition);
+  if (concolic && it != seedMap.end())
+    concolic->recordConstraint(condition);
+  if (!state.model)
+    state.model = solver->findModel(state);
   if (ivcEnabled)
     doImpliedValueConcretization(state, condition, 
                                  ConstantExpr::alloc(1, Expr::Bool));
@@ -1159,7 +1628,7 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return (*sf.locals)[index];
   }
 }
 
@@ -1173,21 +1642,62 @@ void Executor::bindArgument(KFunction *kf, unsigned index,
   getArgumentCell(state, kf, index).value = value;
 }
 
+bool Executor::bindConstantBinary(KInstruction *target, ExecutionState &state,
+                                  const ref<Expr> &left,
+                                  const ref<Expr> &right) {
+  const ConstantExpr *l = dyn_cast<ConstantExpr>(left);
+  const ConstantExpr *r = dyn_cast<ConstantExpr>(right);
+  if (!l || !r)
+    return false;
+
+  const APInt &a = l->getAPValue(), &b = r->getAPValue();
+  APInt result;
+  switch (target->opcode) {
+  case Instruction::Add: result = a + b; break;
+  case Instruction::Sub: result = a - b; break;
+  case Instruction::Mul: result = a * b; break;
+  case Instruction::And: result = a & b; break;
+  case Instruction::Or:  result = a | b; break;
+  case Instruction::Xor: result = a ^ b; break;
+  default:
+    return false;
+  }
+  getDestCell(state, target).setConstant(result);
+  return true;
+}
+
+bool Executor::bindConstantGEP(KGEPInstruction *kgepi, ExecutionState &state,
+                               const ref<Expr> &base) {
+  Expr::Width width = Context::get().getPointerWidth();
+  const ConstantExpr *cbase = dyn_cast<ConstantExpr>(base);
+  if (!cbase || cbase->getWidth() != width)
+    return false;
+
+  APInt address = cbase->getAPValue();
+  for (const std::pair<unsigned, uint64_t> &index : kgepi->indices) {
+    const ConstantExpr *ci =
+        dyn_cast<ConstantExpr>(eval(kgepi, index.first, state).value);
+    if (!ci)
+      return false;
+    address += ci->getAPValue().sextOrTrunc(width) * APInt(width, index.second);
+  }
+  address += APInt(width, kgepi->offset);
+  getDestCell(state, kgepi).setConstant(address);
+  return true;
+}
+
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
                              ref<Expr> &e) {
   ref<Expr> result = e;
 
   if (!isa<ConstantExpr>(e)) {
+    TimingSolver::OriginScope origin(solver, TimingSolver::OriginToUnique);
     ref<ConstantExpr> value;
-    bool isTrue = false;
+    bool isUnique = false;
     e = optimizer.optimizeExpr(e, true);
     solver->setTimeout(coreSolverTimeout);
-    if (solver->getValue(state, e, value)) {
-      ref<Expr> cond = EqExpr::create(e, value);
-      cond = optimizer.optimizeExpr(cond, false);
-      if (solver->mustBeTrue(state, cond, isTrue) && isTrue)
-        result = value;
-    }
+    if (solver->getUniqueValue(state, e, value, isUnique) && isUnique)
+      result = value;
     solver->setTimeout(time::Span());
   }
   
@@ -1195,6 +1705,20 @@ ref<Expr> Executor::toUnique(const ExecutionState &state,
 }
 
 
+bool Executor::getModel(const ExecutionState &state,
+                        const std::vector<ref<Expr> > &exprs,
+                        Assignment &model) {
+  std::vector<const Array *> objects;
+  findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+  std::vector<std::vector<unsigned char> > values;
+  solver->setTimeout(coreSolverTimeout);
+  bool success = solver->getInitialValues(state, objects, values);
+  solver->setTimeout(time::Span());
+  if (success)
+    model = Assignment(objects, values);
+  return success;
+}
+
 /* Concretize the given expression, and return a possible constant value. 
    'reason' is just a documentation string stating the reason for concretization. */
 ref<klee::ConstantExpr> 
@@ -1205,6 +1729,7 @@ Executor::toConstant(ExecutionState &state,
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
     return CE;
 
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginGetValue);
   ref<ConstantExpr> value;
   bool success = solver->getValue(state, e, value);
   assert(success && "FIXME: Unhandled solver failure");
@@ -1229,6 +1754,7 @@ Executor::toConstant(ExecutionState &state,
 void Executor::executeGetValue(ExecutionState &state,
                                ref<Expr> e,
                                KInstruction *target) {
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginGetValue);
   e = state.constraints.simplifyExpr(e);
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
@@ -1241,9 +1767,9 @@ void Executor::executeGetValue(ExecutionState &state,
     bindLocal(target, state, value);
   } else {
     std::set< ref<Expr> > values;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
-      ref<Expr> cond = siit->assignment.evaluate(e);
+    std::vector<ref<Expr> > seedValues;
+    evaluateSeeds(it->second, e, seedPrograms, seedValues);
+    for (ref<Expr> cond : seedValues) {
       cond = optimizer.optimizeExpr(cond, true);
       ref<ConstantExpr> value;
       bool success = solver->getValue(state, cond, value);
@@ -1306,12 +1832,29 @@ void Executor::printDebugInstructions(ExecutionState &state) {
 }
 
 void Executor::stepInstruction(ExecutionState &state) {
+  // A branch deferred by deferBranch() was counted when it first ran.
+  if (asyncBranchResults.count(&state)) {
+    if (statsTracker)
+      statsTracker->resumeInstruction(state);
+    state.prevPC = state.pc;
+    ++state.pc;
+    return;
+  }
+
   printDebugInstructions(state);
   if (statsTracker)
     statsTracker->stepInstruction(state);
 
   ++stats::instructions;
   ++state.steppedInstructions;
+  state.lastStepped = stats::instructions;
+  // before an instruction every value is in memory or in a register; the
+  // collection is repeated as the constraints double
+  if (CollectDeadConstraints &&
+      state.constraints.size() >=
+          std::max<size_t>(64, 2 * state.collectedConstraints))
+    stats::deadConstraints += state.collectDeadConstraints();
+
   state.prevPC = state.pc;
   ++state.pc;
 
@@ -1341,6 +1884,102 @@ static inline const llvm::fltSemantics *fpWidthToSemantics(unsigned width) {
   }
 }
 
+bool Executor::executeMemFunction(ExecutionState &state, KInstruction *ki,
+                                  Function *f,
+                                  std::vector<ref<Expr> > &arguments) {
+  StringRef name = f->getName();
+  bool isSet = name == "memset";
+  if ((!isSet && name != "memcpy" && name != "memmove") ||
+      arguments.size() != 3 || !f->getReturnType()->isPointerTy())
+    return false;
+
+  if (!copyMemory(state, isSet, arguments[0], arguments[1], arguments[2]))
+    return false;
+
+  bindLocal(ki, state, arguments[0]);
+  if (InvokeInst *ii = dyn_cast<InvokeInst>(ki->inst))
+    transferToBasicBlock(ii->getNormalDest(), ki->inst->getParent(), state);
+  return true;
+}
+
+bool Executor::copyMemory(ExecutionState &state, bool isSet,
+                          ref<Expr> dstAddress, ref<Expr> srcAddress,
+                          ref<Expr> count) {
+  // Symbolic pointers, objects of symbolic size, and sizes which may be out
+  // of bounds, are left to the body, which forks or reports the error at the
+  // offending byte.
+  ConstantExpr *dst = dyn_cast<ConstantExpr>(dstAddress);
+  ConstantExpr *src = dyn_cast<ConstantExpr>(srcAddress);
+  if (!dst || (!isSet && !src) || count->getWidth() > Expr::Int64)
+    return false;
+
+  // n is first the number of bytes which can be accessed
+  ObjectPair dstOp, srcOp;
+  if (!state.addressSpace.resolveOne(dst, dstOp) || dstOp.second->readOnly ||
+      !dstOp.first->symbolicSize.isNull())
+    return false;
+  uint64_t dstOffset = dst->getZExtValue() - dstOp.first->address;
+  uint64_t srcOffset = 0;
+  uint64_t n = dstOp.first->size - dstOffset;
+  if (!isSet) {
+    if (!state.addressSpace.resolveOne(src, srcOp) ||
+        !srcOp.first->symbolicSize.isNull())
+      return false;
+    srcOffset = src->getZExtValue() - srcOp.first->address;
+    n = std::min(n, srcOp.first->size - srcOffset);
+  }
+
+  // A symbolic size within bounds turns the loop of the body, which would
+  // fork on each byte, into a select on each byte which may be written.
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(count);
+  if (ce) {
+    if (ce->getZExtValue() > n)
+      return false;
+    n = ce->getZExtValue();
+  } else {
+    ref<Expr> check =
+        UleExpr::create(count, ConstantExpr::create(n, count->getWidth()));
+    bool inBounds;
+    solver->setTimeout(coreSolverTimeout);
+    bool success = solver->mustBeTrue(state, check, inBounds);
+    solver->setTimeout(time::Span());
+    if (!success || !inBounds)
+      return false;
+  }
+
+  // A copy of a whole object into another of the same size shares its
+  // contents, which takes time in the number of pages, not of bytes.
+  if (!isSet && ce && !dstOffset && !srcOffset &&
+      n == dstOp.first->size && n == srcOp.first->size) {
+    ObjectState *wos = state.addressSpace.getWriteable(dstOp.first,
+                                                       dstOp.second);
+    wos->copyFrom(*srcOp.second);
+    return true;
+  }
+
+  // Read everything before writing, which gives memmove semantics.
+  std::vector<ref<Expr> > bytes;
+  if (isSet) {
+    bytes.assign(n, ExtractExpr::create(srcAddress, 0, Expr::Int8));
+  } else {
+    bytes.reserve(n);
+    for (uint64_t i = 0; i != n; ++i)
+      bytes.push_back(srcOp.second->read8(srcOffset + i));
+  }
+
+  ObjectState *wos = state.addressSpace.getWriteable(dstOp.first,
+                                                     dstOp.second);
+  for (uint64_t i = 0; i != n; ++i) {
+    ref<Expr> value = bytes[i];
+    if (!ce)
+      value = SelectExpr::create(
+          UltExpr::create(ConstantExpr::create(i, count->getWidth()), count),
+          value, wos->read8(dstOffset + i));
+    wos->write(dstOffset + i, value);
+  }
+  return true;
+}
+
 void Executor::executeCall(ExecutionState &state, 
                            KInstruction *ki,
                            Function *f,
@@ -1425,6 +2064,28 @@ void Executor::executeCall(ExecutionState &state,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
   } else {
+    // A recorded call has to see the accesses of the body.
+    if (FastMemFunctions && !state.summaryRecording &&
+        executeMemFunction(state, ki, f, arguments))
+      return;
+
+    if (FastStringFunctions && !state.summaryRecording &&
+        specialFunctionHandler->handleFast(state, f, ki, arguments)) {
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+        transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+      return;
+    }
+
+    ref<Expr> result;
+    if (functionSummaries &&
+        functionSummaries->apply(state, f, arguments, ki->width, result)) {
+      if (!result.isNull())
+        bindLocal(ki, state, result);
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+        transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+      return;
+    }
+
     // Check if maximum stack size was reached.
     // We currently only count the number of stack frames
     if (RuntimeMaxStackFrames && state.stack.size() > RuntimeMaxStackFrames) {
@@ -1437,7 +2098,7 @@ void Executor::executeCall(ExecutionState &state,
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
     // from just an instruction (unlike LLVM).
-    KFunction *kf = kmodule->functionMap[f];
+    KFunction *kf = getKFunction(f);
 
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
@@ -1548,6 +2209,9 @@ void Executor::executeCall(ExecutionState &state,
     unsigned numFormals = f->arg_size();
     for (unsigned i=0; i<numFormals; ++i) 
       bindArgument(kf, i, state, arguments[i]);
+
+    if (functionSummaries)
+      functionSummaries->start(state, f, arguments);
   }
 }
 
@@ -1569,7 +2233,17 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   KFunction *kf = state.stack.back().kf;
   unsigned entry = kf->basicBlockEntry[dst];
   state.pc = &kf->instructions[entry];
-  if (state.pc->inst->getOpcode() == Instruction::PHI) {
+  if (DedupTestCases || fuzzerBridge) {
+    std::uint64_t edge =
+        ((std::uint64_t)state.prevPC->info->id << 32) | state.pc->info->id;
+    if (!state.coveredEdges.count(edge))
+      state.coveredEdges = state.coveredEdges.insert(edge);
+  }
+  if (subpathLength && src->getTerminator()->getNumSuccessors() > 1)
+    state.addBranchDecision(
+        ((std::uint64_t)state.prevPC->info->id << 32) | state.pc->info->id,
+        subpathLength);
+  if (state.pc->opcode == Instruction::PHI) {
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
   }
@@ -1607,7 +2281,7 @@ Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
 
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -1624,6 +2298,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       assert(!caller && "caller set on initial stack frame");
       terminateStateOnExit(state);
     } else {
+      if (state.summaryRecording &&
+          state.summaryRecording->depth == state.stack.size())
+        functionSummaries->finish(state,
+                                  isVoidReturn ? ref<Expr>() : result);
       state.popFrame();
 
       if (statsTracker)
@@ -1684,6 +2362,18 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       ref<Expr> cond = eval(ki, 0, state).value;
 
       cond = optimizer.optimizeExpr(cond, false);
+      if (deferBranch(state, cond))
+        break;
+      if (UseMerge && !isa<ConstantExpr>(cond)) {
+        KFunction *kf = state.stack.back().kf;
+        auto region = kf->mergeRegions.find(bi->getParent());
+        if (region != kf->mergeRegions.end()) {
+          state.openMergeStack.push_back(ref<MergeHandler>(
+              new MergeHandler(this, &state, region->second)));
+          if (DebugLogMerge)
+            llvm::errs() << "open merge region: " << &state << "\n";
+        }
+      }
       Executor::StatePair branches = fork(state, cond, false);
 
       // NOTE: There is a hidden dependency here, markBranchVisited
@@ -1722,7 +2412,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> errorCase = ConstantExpr::alloc(1, Expr::Bool);
     SmallPtrSet<BasicBlock *, 5> destinations;
-    // collect and check destinations from label list
+    std::vector<BasicBlock *> candidates;
+    std::vector<ref<Expr>> candidateExpressions;
+    // collect destinations from label list
     for (unsigned k = 0; k < numDestinations; ++k) {
       // filter duplicates
       const auto d = bi->getDestination(k);
@@ -1736,19 +2428,23 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // exclude address from errorCase
       errorCase = AndExpr::create(errorCase, Expr::createIsZero(e));
 
-      // check feasibility
-      bool result;
-      bool success __attribute__ ((unused)) = solver->mayBeTrue(state, e, result);
-      assert(success && "FIXME: Unhandled solver failure");
-      if (result) {
-        targets.push_back(d);
-        expressions.push_back(e);
-      }
+      candidates.push_back(d);
+      candidateExpressions.push_back(e);
     }
-    // check errorCase feasibility
-    bool result;
-    bool success __attribute__ ((unused)) = solver->mayBeTrue(state, errorCase, result);
+    candidateExpressions.push_back(errorCase);
+
+    // check feasibility of all destinations and the errorCase at once
+    std::vector<bool> feasible;
+    bool success __attribute__ ((unused)) =
+        solver->mayBeTrue(state, candidateExpressions, feasible);
     assert(success && "FIXME: Unhandled solver failure");
+    for (unsigned k = 0; k < candidates.size(); ++k) {
+      if (feasible[k]) {
+        targets.push_back(candidates[k]);
+        expressions.push_back(candidateExpressions[k]);
+      }
+    }
+    bool result = feasible.back();
     if (result) {
       expressions.push_back(errorCase);
     }
@@ -1774,119 +2470,61 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   }
   case Instruction::Switch: {
-    SwitchInst *si = cast<SwitchInst>(i);
+    KSwitchInstruction *ksi = static_cast<KSwitchInstruction *>(ki);
     ref<Expr> cond = eval(ki, 0, state).value;
-    BasicBlock *bb = si->getParent();
+    BasicBlock *bb = i->getParent();
 
     cond = toUnique(state, cond);
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
-      // Somewhat gross to create these all the time, but fine till we
-      // switch to an internal rep.
-      llvm::IntegerType *Ty = cast<IntegerType>(si->getCondition()->getType());
-      ConstantInt *ci = ConstantInt::get(Ty, CE->getZExtValue());
-#if LLVM_VERSION_CODE >= LLVM_VERSION(5, 0)
-      unsigned index = si->findCaseValue(ci)->getSuccessorIndex();
-#else
-      unsigned index = si->findCaseValue(ci).getSuccessorIndex();
-#endif
-      transferToBasicBlock(si->getSuccessor(index), si->getParent(), state);
+      unsigned target = ksi->getTarget(CE->getAPValue());
+      transferToBasicBlock(ksi->targets[target], bb, state);
     } else {
-      // Handle possible different branch targets
-
-      // We have the following assumptions:
-      // - each case value is mutual exclusive to all other values including the
-      //   default value
-      // - order of case branches is based on the order of the expressions of
-      //   the scase values, still default is handled last
-      std::vector<BasicBlock *> bbOrder;
-      std::map<BasicBlock *, ref<Expr> > branchTargets;
-
-      std::map<ref<Expr>, BasicBlock *> expressionOrder;
-
-      // Iterate through all non-default cases and order them by expressions
-      for (auto i : si->cases()) {
-        ref<Expr> value = evalConstant(i.getCaseValue());
-
-        BasicBlock *caseSuccessor = i.getCaseSuccessor();
-        expressionOrder.insert(std::make_pair(value, caseSuccessor));
-      }
-
-      // Track default branch values
-      ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
-
-      // iterate through all non-default cases but in order of the expressions
-      for (std::map<ref<Expr>, BasicBlock *>::iterator
-               it = expressionOrder.begin(),
-               itE = expressionOrder.end();
-           it != itE; ++it) {
-        ref<Expr> match = EqExpr::create(cond, it->first);
-
-        // Make sure that the default value does not contain this target's value
-        defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
-
-        // Check if control flow could take this case
-        bool result;
-        match = optimizer.optimizeExpr(match, false);
-        bool success = solver->mayBeTrue(state, match, result);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
-
-          // Handle the case that a basic block might be the target of multiple
-          // switch cases.
-          // Currently we generate an expression containing all switch-case
-          // values for the same target basic block. We spare us forking too
-          // many times but we generate more complex condition expressions
-          // TODO Add option to allow to choose between those behaviors
-          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
-              branchTargets.insert(std::make_pair(
-                  caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
-
-          res.first->second = OrExpr::create(match, res.first->second);
-
-          // Only add basic blocks which have not been target of a branch yet
-          if (res.second) {
-            bbOrder.push_back(caseSuccessor);
-          }
+      // One condition per distinct successor: the ranges of case values
+      // leading to it. The default destination takes the values outside of
+      // every range, including those of the cases leading to it.
+      std::vector<ref<Expr> > conditions(ksi->targets.size(),
+                                         ConstantExpr::alloc(0, Expr::Bool));
+      ref<Expr> defaultCondition = ConstantExpr::alloc(1, Expr::Bool);
+      for (const KSwitchInstruction::CaseRange &r : ksi->ranges) {
+        ref<Expr> match;
+        if (r.low == r.high) {
+          match = EqExpr::create(cond, ConstantExpr::alloc(r.low));
+        } else {
+          // cond - low <= high - low, a single comparison
+          match = UleExpr::create(
+              SubExpr::create(cond, ConstantExpr::alloc(r.low)),
+              ConstantExpr::alloc(r.high - r.low));
         }
+        conditions[r.target] = OrExpr::create(match, conditions[r.target]);
+        defaultCondition =
+            AndExpr::create(defaultCondition, Expr::createIsZero(match));
       }
+      conditions.back() = defaultCondition;
+      for (ref<Expr> &c : conditions)
+        c = optimizer.optimizeExpr(c, false);
 
-      // Check if control could take the default case
-      defaultValue = optimizer.optimizeExpr(defaultValue, false);
-      bool res;
-      bool success = solver->mayBeTrue(state, defaultValue, res);
+      // Check which successors control flow could take, in a single query
+      std::vector<bool> feasible;
+      bool success = solver->mayBeTrue(state, conditions, feasible);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
-      if (res) {
-        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
-            branchTargets.insert(
-                std::make_pair(si->getDefaultDest(), defaultValue));
-        if (ret.second) {
-          bbOrder.push_back(si->getDefaultDest());
-        }
-      }
 
       // Fork the current state with each state having one of the possible
       // successors of this switch
-      std::vector< ref<Expr> > conditions;
-      for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
-                                               ie = bbOrder.end();
-           it != ie; ++it) {
-        conditions.push_back(branchTargets[*it]);
+      std::vector<BasicBlock *> targets;
+      std::vector<ref<Expr> > feasibleConditions;
+      for (unsigned k = 0; k != conditions.size(); ++k) {
+        if (feasible[k]) {
+          targets.push_back(ksi->targets[k]);
+          feasibleConditions.push_back(conditions[k]);
+        }
       }
       std::vector<ExecutionState*> branches;
-      branch(state, conditions, branches);
-
-      std::vector<ExecutionState*>::iterator bit = branches.begin();
-      for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
-                                               ie = bbOrder.end();
-           it != ie; ++it) {
-        ExecutionState *es = *bit;
-        if (es)
-          transferToBasicBlock(*it, bb, *es);
-        ++bit;
-      }
+      branch(state, feasibleConditions, branches);
+
+      for (unsigned k = 0; k != branches.size(); ++k)
+        if (branches[k])
+          transferToBasicBlock(targets[k], bb, *branches[k]);
     }
     break;
   }
@@ -2034,59 +2672,76 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Add: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, AddExpr::create(left, right));
+    if (!bindConstantBinary(ki, state, left, right))
+      bindLocal(ki, state, AddExpr::create(left, right));
     break;
   }
 
   case Instruction::Sub: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, SubExpr::create(left, right));
+    if (!bindConstantBinary(ki, state, left, right))
+      bindLocal(ki, state, SubExpr::create(left, right));
     break;
   }
  
   case Instruction::Mul: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, MulExpr::create(left, right));
+    if (!bindConstantBinary(ki, state, left, right))
+      bindLocal(ki, state, MulExpr::create(left, right));
     break;
   }
 
   case Instruction::UDiv: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s = ki->checkDivZero ? checkDivisor(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = UDivExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
   case Instruction::SDiv: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s = ki->checkDivZero ? checkDivisor(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = SDivExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
   case Instruction::URem: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s = ki->checkDivZero ? checkDivisor(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = URemExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
   case Instruction::SRem: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s = ki->checkDivZero ? checkDivisor(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = SRemExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
   case Instruction::And: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (bindConstantBinary(ki, state, left, right))
+      break;
     ref<Expr> result = AndExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2095,6 +2750,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Or: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (bindConstantBinary(ki, state, left, right))
+      break;
     ref<Expr> result = OrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2103,6 +2760,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Xor: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (bindConstantBinary(ki, state, left, right))
+      break;
     ref<Expr> result = XorExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2111,24 +2770,36 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Shl: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s =
+        ki->checkOvershift ? checkShiftAmount(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = ShlExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
   case Instruction::LShr: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s =
+        ki->checkOvershift ? checkShiftAmount(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = LShrExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
   case Instruction::AShr: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    ExecutionState *s =
+        ki->checkOvershift ? checkShiftAmount(state, right) : &state;
+    if (!s)
+      break;
     ref<Expr> result = AShrExpr::create(left, right);
-    bindLocal(ki, state, result);
+    bindLocal(ki, *s, result);
     break;
   }
 
@@ -2255,6 +2926,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::GetElementPtr: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
     ref<Expr> base = eval(ki, 0, state).value;
+    if (bindConstantGEP(kgepi, state, base))
+      break;
 
     for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
            it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
@@ -2274,38 +2947,30 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
-                                           0,
-                                           getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value, 0,
+                                           ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value, ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value, ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
+    Expr::Width pType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     bindLocal(ki, state, ZExtExpr::create(arg, pType));
     break;
   }
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
+    Expr::Width iType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     bindLocal(ki, state, ZExtExpr::create(arg, iType));
     break;
@@ -2394,8 +3059,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
@@ -2411,8 +3075,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
@@ -2427,8 +3090,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2449,8 +3111,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2471,8 +3132,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2487,8 +3147,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2617,7 +3276,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> agg = eval(ki, 0, state).value;
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
 
     bindLocal(ki, state, result);
     break;
@@ -2650,18 +3309,19 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       return;
     }
 
-    const unsigned elementCount = vt->getNumElements();
-    llvm::SmallVector<ref<Expr>, 8> elems;
-    elems.reserve(elementCount);
-    for (unsigned i = elementCount; i != 0; --i) {
-      auto of = i - 1;
-      unsigned bitOffset = EltBits * of;
-      elems.push_back(
-          of == iIdx ? newElt : ExtractExpr::create(vec, bitOffset, EltBits));
-    }
-
+    // the lanes above and below the one written are kept as one extract
+    // each, which folds when the vector is concrete
     assert(Context::get().isLittleEndian() && "FIXME:Broken for big endian");
-    ref<Expr> Result = ConcatExpr::createN(elementCount, elems.data());
+    unsigned bitOffset = EltBits * iIdx, vecBits = vec->getWidth();
+    ref<Expr> Result = newElt;
+    if (bitOffset)
+      Result =
+          ConcatExpr::create(Result, ExtractExpr::create(vec, 0, bitOffset));
+    if (bitOffset + EltBits < vecBits)
+      Result = ConcatExpr::create(
+          ExtractExpr::create(vec, bitOffset + EltBits,
+                              vecBits - bitOffset - EltBits),
+          Result);
     bindLocal(ki, state, Result);
     break;
   }
@@ -2693,11 +3353,37 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, Result);
     break;
   }
-  case Instruction::ShuffleVector:
-    // Should never happen due to Scalarizer pass removing ShuffleVector
-    // instructions.
-    terminateStateOnExecError(state, "Unexpected ShuffleVector instruction");
+  case Instruction::ShuffleVector: {
+    // The Scalarizer pass removes most of them, but not those of the
+    // passes run after it.
+    ShuffleVectorInst *svi = cast<ShuffleVectorInst>(i);
+    ref<Expr> vec1 = eval(ki, 0, state).value;
+    ref<Expr> vec2 = eval(ki, 1, state).value;
+    const llvm::VectorType *vt =
+        cast<llvm::VectorType>(svi->getOperand(0)->getType());
+    unsigned EltBits = getWidthForLLVMType(vt->getElementType());
+    unsigned inCount = vt->getNumElements();
+    SmallVector<int, 16> mask;
+    svi->getShuffleMask(mask);
+
+    // from the most significant lane, as ConcatExpr::createN() expects.
+    // Runs of consecutive lanes merge back into single extracts.
+    assert(Context::get().isLittleEndian() && "FIXME:Broken for big endian");
+    llvm::SmallVector<ref<Expr>, 16> elems;
+    elems.reserve(mask.size());
+    for (unsigned i = mask.size(); i != 0; --i) {
+      int lane = mask[i - 1];
+      if (lane < 0)
+        elems.push_back(ConstantExpr::create(0, EltBits));
+      else if ((unsigned)lane < inCount)
+        elems.push_back(ExtractExpr::create(vec1, lane * EltBits, EltBits));
+      else
+        elems.push_back(
+            ExtractExpr::create(vec2, (lane - inCount) * EltBits, EltBits));
+    }
+    bindLocal(ki, state, ConcatExpr::createN(elems.size(), elems.data()));
     break;
+  }
   case Instruction::AtomicRMW:
     terminateStateOnExecError(state, "Unexpected Atomic instruction, should be "
                                      "lowered by LowerAtomicInstructionPass");
@@ -2716,7 +3402,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 }
 
 void Executor::updateStates(ExecutionState *current) {
-  if (searcher) {
+  // Most steps neither add nor remove states, which only some searchers
+  // need to hear about.
+  if (searcher && (!addedStates.empty() || !removedStates.empty() ||
+                   (current && searcher->updatesCurrent()))) {
+    TimerStatIncrementer timer(stats::searcherTime);
+    KLEE_TRACE_SCOPE("Searcher::update");
     searcher->update(current, addedStates, removedStates);
   }
   
@@ -2727,9 +3418,7 @@ void Executor::updateStates(ExecutionState *current) {
                                                ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
-    std::set<ExecutionState*>::iterator it2 = states.find(es);
-    assert(it2!=states.end());
-    states.erase(it2);
+    states.erase(es);
     std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
       seedMap.find(es);
     if (it3 != seedMap.end())
@@ -2739,7 +3428,8 @@ void Executor::updateStates(ExecutionState *current) {
   }
   removedStates.clear();
 
-  if (searcher) {
+  if (searcher && (!continuedStates.empty() || !pausedStates.empty())) {
+    TimerStatIncrementer timer(stats::searcherTime);
     searcher->update(nullptr, continuedStates, pausedStates);
     pausedStates.clear();
     continuedStates.clear();
@@ -2808,18 +3498,26 @@ void Executor::bindInstructionConstants(KInstruction *KI) {
 }
 
 void Executor::bindModuleConstants() {
-  for (auto &kfp : kmodule->functions) {
-    KFunction *kf = kfp.get();
-    for (unsigned i=0; i<kf->numInstructions; ++i)
-      bindInstructionConstants(kf->instructions[i]);
+  // Cells are appended, so the ones of earlier constants stay in place.
+  for (unsigned i = kmodule->constantTable.size();
+       i < kmodule->constants.size(); ++i) {
+    kmodule->constantTable.emplace_back();
+    kmodule->constantTable.back().value = evalConstant(kmodule->constants[i]);
   }
+  constantsBound = true;
+}
 
-  kmodule->constantTable =
-      std::unique_ptr<Cell[]>(new Cell[kmodule->constants.size()]);
-  for (unsigned i=0; i<kmodule->constants.size(); ++i) {
-    Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
-  }
+KFunction *Executor::getKFunction(Function *f) {
+  auto it = kmodule->functionMap.find(f);
+  if (it != kmodule->functionMap.end())
+    return it->second;
+
+  KFunction *kf = kmodule->manifestFunction(f);
+  for (unsigned i = 0; i < kf->numInstructions; ++i)
+    bindInstructionConstants(kf->instructions[i]);
+  if (constantsBound)
+    bindModuleConstants();
+  return kf;
 }
 
 void Executor::checkMemoryUsage() {
@@ -2832,13 +3530,39 @@ void Executor::checkMemoryUsage() {
     unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
                    (memory->getUsedDeterministicSize() >> 20);
 
+    // The solver caches go before any state, as they refill with the
+    // queries which still matter.
+    if (mbs > MaxMemory) {
+      uint64_t freed = shrinkSolverCaches(uint64_t(mbs - MaxMemory) << 20);
+      if (freed >> 20) {
+        klee_message("dropped %llu MB of solver caches (over memory cap)",
+                     (unsigned long long)(freed >> 20));
+        mbs -= std::min<uint64_t>(mbs, freed >> 20);
+      }
+    }
+
     if (mbs > MaxMemory) {
       if (mbs > MaxMemory + 100) {
         // just guess at how many to kill
         unsigned numStates = states.size();
         unsigned toKill = std::max(1U, numStates - numStates * MaxMemory / mbs);
+        // a seed worker would not swap its states back in
+        if (SwapStates && !seedWorker && swapOutStates(toKill)) {
+          atMemoryLimit = true;
+          return;
+        }
+        std::vector<ExecutionState *> arr;
+        for (ExecutionState *es : states) {
+          // states waiting for a query are not known to the searcher
+          if (!asyncQueries || !asyncQueries->isPending(es))
+            arr.push_back(es);
+        }
+        if (MaxMemoryKill == MemoryKillPolicy::Exclusive) {
+          killExclusiveStates(arr, toKill, uint64_t(mbs - MaxMemory) << 20);
+          atMemoryLimit = true;
+          return;
+        }
         klee_warning("killing %d states (over memory cap)", toKill);
-        std::vector<ExecutionState *> arr(states.begin(), states.end());
         for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
           unsigned idx = rand() % N;
           // Make two pulls to try and not hit a state that
@@ -2853,22 +3577,442 @@ void Executor::checkMemoryUsage() {
       atMemoryLimit = true;
     } else {
       atMemoryLimit = false;
+      // Leave room for the swapped in states to grow again.
+      if (!swapFiles.empty() && mbs < MaxMemory / 2)
+        swapInStates();
     }
   }
 }
 
-void Executor::doDumpStates() {
-  if (!DumpStatesOnHalt || states.empty())
-    return;
+void Executor::killExclusiveStates(std::vector<ExecutionState *> &candidates,
+                                   unsigned maxKill, uint64_t excess) {
+  if (functionSummaries && !functionSummaries->empty()) {
+    klee_message("dropping the function summaries (over memory cap)");
+    functionSummaries->clear();
+  }
 
-  klee_message("halting execution, dumping remaining states");
-  for (const auto &state : states)
-    terminateStateEarly(*state, "Execution halting.");
-  updateStates(nullptr);
+  // The memory no other state shares is counted while walking all states
+  // together, as it is never reached from another state.
+  StateFootprint all;
+  std::unordered_set<const void *> seen;
+  std::vector<std::pair<uint64_t, ExecutionState *> > held;
+  for (ExecutionState *es : candidates) {
+    uint64_t before = all.exclusive;
+    es->addFootprint(all, seen);
+    held.emplace_back(all.exclusive - before, es);
+  }
+
+  const uint64_t MB = 1 << 20;
+  klee_message("memory of the states: %llu MB address spaces, %llu MB "
+               "object states, %llu MB updates, %llu MB stacks, %llu MB "
+               "constraints, %llu MB other, of which %llu MB held by single "
+               "states; %llu MB expressions",
+               (unsigned long long)(all.addressSpace / MB),
+               (unsigned long long)(all.objectStates / MB),
+               (unsigned long long)(all.updates / MB),
+               (unsigned long long)(all.stack / MB),
+               (unsigned long long)(all.constraints / MB),
+               (unsigned long long)((all.coveredLines + all.arrayNames +
+                                     all.symbolics) / MB),
+               (unsigned long long)(all.exclusive / MB),
+               (unsigned long long)(ExprAllocator::getLiveBytes() / MB));
+
+  // The states which covered new code go last.
+  std::sort(held.begin(), held.end(),
+            [](const std::pair<uint64_t, ExecutionState *> &a,
+               const std::pair<uint64_t, ExecutionState *> &b) {
+              if (a.second->coveredNew != b.second->coveredNew)
+                return b.second->coveredNew;
+              return a.first > b.first;
+            });
+  unsigned killed = 0;
+  uint64_t freed = 0;
+  for (; killed < held.size() && killed < maxKill &&
+         (!killed || freed < excess);
+       ++killed) {
+    freed += held[killed].first;
+    terminateStateEarly(*held[killed].second, "Memory limit exceeded.");
+  }
+  klee_warning("killing %u states (over memory cap), freeing about %llu MB",
+               killed, (unsigned long long)(freed / MB));
 }
 
-void Executor::run(ExecutionState &initialState) {
-  bindModuleConstants();
+bool Executor::swapOutStates(unsigned count) {
+  std::vector<ExecutionState *> arr;
+  for (ExecutionState *es : states) {
+    // states waiting for a query are not known to the searcher, and
+    // seeded states cannot be re-created with their seeds
+    if ((!asyncQueries || !asyncQueries->isPending(es)) &&
+        !seedMap.count(es) && es->lazyCondition.isNull() &&
+        std::find(removedStates.begin(), removedStates.end(), es) ==
+            removedStates.end())
+      arr.push_back(es);
+  }
+  count = std::min<unsigned>(count, arr.size());
+  if (!count)
+    return false;
+
+  std::partial_sort(arr.begin(), arr.begin() + count, arr.end(),
+                    [](const ExecutionState *a, const ExecutionState *b) {
+                      return a->lastStepped < b->lastStepped;
+                    });
+  std::vector<const DecisionHistory *> histories;
+  for (unsigned i = 0; i < count; ++i)
+    histories.push_back(&arr[i]->decisions);
+
+  std::string error;
+  std::string path = interpreterHandler->getOutputFilename(
+      "swap" + llvm::utostr(swapFileCount++) + ".ktree");
+  if (!CheckpointTree::write(path, histories, error)) {
+    klee_warning("unable to swap out states: %s", error.c_str());
+    return false;
+  }
+  klee_warning("swapping out %u states (over memory cap)", count);
+  swapFiles.push_back(path);
+  for (unsigned i = 0; i < count; ++i)
+    removeState(*arr[i]);
+  return true;
+}
+
+bool Executor::swapInStates() {
+  if (swapFiles.empty())
+    return false;
+  std::string path = swapFiles.front();
+  swapFiles.pop_front();
+
+  std::unique_ptr<CheckpointTree> tree(new CheckpointTree());
+  std::string error;
+  if (!tree->read(path, error)) {
+    klee_warning("unable to swap in states: %s", error.c_str());
+    return false;
+  }
+  llvm::sys::fs::remove(path);
+  if (tree->getRoot()->children.empty())
+    return false;
+
+  klee_message("swapping in states from %s", path.c_str());
+  ExecutionState *es = copyInitialState();
+  resumeNodes[es] = tree->getRoot();
+  resumeTrees.push_back(std::move(tree));
+  return true;
+}
+
+ExecutionState *Executor::copyInitialState() {
+  ExecutionState *es = new ExecutionState(*swapRoot);
+  if (states.empty() && addedStates.empty()) {
+    // The process tree was removed together with its last state.
+    delete processTree;
+    processTree = new PTree(es, ptreeLog.get());
+    es->ptreeNode = processTree->root;
+  } else {
+    ExecutionState *sibling =
+        addedStates.empty() ? *states.begin() : addedStates.back();
+    std::pair<PTree::Node*, PTree::Node*> res =
+      processTree->split(sibling->ptreeNode, es, sibling);
+    es->ptreeNode = res.first;
+    sibling->ptreeNode = res.second;
+  }
+  if (pathWriter)
+    es->pathOS = pathWriter->open();
+  if (symPathWriter)
+    es->symPathOS = symPathWriter->open();
+
+  addedStates.push_back(es);
+  return es;
+}
+
+void Executor::syncFuzzer(ExecutionState *initialState) {
+  std::vector<KTest *> inputs;
+  fuzzerBridge->importInputs(inputs);
+  if (inputs.empty())
+    return;
+
+  klee_message("importing %u inputs from the fuzzer",
+               (unsigned)inputs.size());
+  for (KTest *input : inputs) {
+    if (concolic) {
+      concolic->addSeed(input);
+    } else {
+      ExecutionState *es = initialState ? initialState : copyInitialState();
+      seedMap[es].push_back(SeedInfo(input));
+    }
+  }
+}
+
+void Executor::exportTestCase(const ExecutionState &state) {
+  if (!fuzzerBridge || !fuzzerBridge->addCoverage(state.coveredEdges) ||
+      !fuzzerBridge->isExporting())
+    return;
+
+  std::vector<std::pair<std::string, std::vector<unsigned char> > > solution;
+  if (getSymbolicSolution(state, solution))
+    fuzzerBridge->exportInput(solution);
+}
+
+std::vector<pid_t> Executor::forkSeedWorkers(std::vector<SeedInfo> &seeds) {
+  // The workers cannot share these with the main process.
+  if (OnlySeed || !ResumeFrom.empty() || ExternalCallsProcess || pathWriter ||
+      symPathWriter) {
+    klee_warning("--seed-workers is not supported with --only-seed, "
+                 "--resume-from, --external-calls-process or --write-paths, "
+                 "seeding in this process");
+    return std::vector<pid_t>();
+  }
+
+  unsigned n = std::min<unsigned>(SeedWorkers, seeds.size());
+  std::vector<pid_t> workers;
+  fflush(stdout);
+  fflush(stderr);
+  for (unsigned i = 0; i < n; ++i) {
+    pid_t pid = ::fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for a seed worker) - %s, seeding in this "
+                   "process", llvm::sys::StrError(errno).c_str());
+      for (pid_t worker : workers) {
+        int status;
+        kill(worker, SIGKILL);
+        while (waitpid(worker, &status, 0) < 0 && errno == EINTR)
+          ;
+      }
+      return std::vector<pid_t>();
+    }
+
+    if (pid == 0) {
+      seedWorker = i + 1;
+      numa::placeWorker(i);
+      std::vector<SeedInfo> share;
+      for (unsigned j = i; j < seeds.size(); j += n)
+        share.push_back(seeds[j]);
+      seeds.swap(share);
+      // The main process writes the statistics and runs the timers.
+      while (!timers.empty()) {
+        delete timers.back();
+        timers.pop_back();
+      }
+      return std::vector<pid_t>();
+    }
+    workers.push_back(pid);
+  }
+
+  klee_message("replaying %u seeds in %u seed workers", (unsigned)seeds.size(),
+               n);
+  seedMap.clear();
+  return workers;
+}
+
+void Executor::finishSeedWorker() {
+  std::vector<const DecisionHistory *> histories;
+  for (ExecutionState *es : states)
+    histories.push_back(&es->decisions);
+  for (const DecisionHistory &path : seedWorkerPaths)
+    histories.push_back(&path);
+
+  std::string error;
+  std::string path = interpreterHandler->getOutputFilename(
+      "seed-worker" + llvm::utostr(seedWorker) + ".ktree");
+  if (!CheckpointTree::write(path, histories, error)) {
+    klee_warning("unable to write the states of seed worker %u: %s",
+                 seedWorker, error.c_str());
+    _exit(1);
+  }
+  _exit(0);
+}
+
+void Executor::joinSeedWorkers(const std::vector<pid_t> &workers,
+                               ExecutionState &initialState) {
+  std::vector<bool> exited(workers.size());
+  unsigned running = workers.size();
+  while (running && !haltExecution) {
+    for (unsigned i = 0; i < workers.size(); ++i) {
+      int status;
+      if (exited[i] || waitpid(workers[i], &status, WNOHANG) == 0)
+        continue;
+      exited[i] = true;
+      --running;
+      if (!WIFEXITED(status) || WEXITSTATUS(status))
+        klee_warning("seed worker %u failed, its states are lost", i + 1);
+    }
+    if (running) {
+      processTimers(nullptr, time::Span());
+      usleep(10000);
+    }
+  }
+
+  std::vector<DecisionHistory> paths;
+  for (unsigned i = 0; i < workers.size(); ++i) {
+    if (!exited[i]) {
+      // halting, the states of the workers are dropped
+      int status;
+      kill(workers[i], SIGKILL);
+      while (waitpid(workers[i], &status, 0) < 0 && errno == EINTR)
+        ;
+    }
+    std::string path = interpreterHandler->getOutputFilename(
+        "seed-worker" + llvm::utostr(i + 1) + ".ktree");
+    CheckpointTree tree;
+    std::string error;
+    if (exited[i] && tree.read(path, error))
+      tree.getPaths(paths);
+    llvm::sys::fs::remove(path);
+  }
+  if (haltExecution || paths.empty())
+    return;
+
+  // Merge the paths of all workers, so that those which several of them
+  // took are only re-created once.
+  std::vector<const DecisionHistory *> histories;
+  for (const DecisionHistory &path : paths)
+    histories.push_back(&path);
+  std::string error;
+  std::string path = interpreterHandler->getOutputFilename("seed-workers.ktree");
+  std::unique_ptr<CheckpointTree> tree(new CheckpointTree());
+  if (!CheckpointTree::write(path, histories, error) ||
+      !tree->read(path, error)) {
+    klee_warning("unable to merge the states of the seed workers: %s",
+                 error.c_str());
+    return;
+  }
+  llvm::sys::fs::remove(path);
+
+  klee_message("re-creating the states of the seed workers from %u paths",
+               (unsigned)paths.size());
+  if (!tree->getRoot()->children.empty())
+    resumeNodes[&initialState] = tree->getRoot();
+  resumeTrees.push_back(std::move(tree));
+}
+
+void Executor::runConcolic(ExecutionState &initialState) {
+  GenerationalSearch search;
+  if (usingSeeds)
+    for (KTest *seed : *usingSeeds)
+      search.addSeed(seed);
+  concolic = &search;
+  if (fuzzerBridge)
+    syncFuzzer();
+
+  ExecutionState *root = new ExecutionState(initialState);
+  ExecutionState *next = &initialState;
+  unsigned runs = 0;
+  while (!haltExecution && search.next()) {
+    if (!next) {
+      next = new ExecutionState(*root);
+      // The process tree was removed together with the last state.
+      delete processTree;
+      processTree = new PTree(next, ptreeLog.get());
+      next->ptreeNode = processTree->root;
+      if (pathWriter)
+        next->pathOS = pathWriter->open();
+      if (symPathWriter)
+        next->symPathOS = symPathWriter->open();
+      states.insert(next);
+    }
+    seedMap[next].push_back(SeedInfo(search.getInput()));
+    concolicCoverage = stats::coveredInstructions;
+    next = 0;
+    ++runs;
+
+    while (!states.empty() && !haltExecution) {
+      ExecutionState &state = **states.begin();
+      if (!seedMap.count(&state)) {
+        // it lost its input, as when running out of input bytes
+        terminateState(state);
+        updateStates(nullptr);
+        continue;
+      }
+      KInstruction *ki = state.pc;
+      stepInstruction(state);
+
+      executeInstruction(state, ki);
+      processTimers(&state, maxInstructionTime);
+
+      checkMemoryUsage();
+
+      updateStates(&state);
+    }
+  }
+
+  klee_message("concolic search done after %u inputs (%u left)", runs,
+               (unsigned)search.getNumPending());
+  concolic = 0;
+  delete root;
+}
+
+void Executor::expandConcolicPath(const ExecutionState &state) {
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginSolution);
+  std::uint64_t score = stats::coveredInstructions - concolicCoverage;
+
+  std::vector<const Array *> objects;
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
+
+  for (unsigned i = concolic->getBound(), e = concolic->getNumBranches();
+       i < e; ++i) {
+    std::vector<ref<Expr> > constraints;
+    concolic->getNegation(i, constraints);
+    ExecutionState tmp(constraints);
+    std::vector<std::vector<unsigned char> > values;
+    solver->setTimeout(coreSolverTimeout);
+    bool success = solver->getInitialValues(tmp, objects, values);
+    solver->setTimeout(time::Span());
+    // the other side is infeasible, or the query timed out
+    if (!success)
+      continue;
+
+    std::vector<std::pair<std::string, std::vector<unsigned char> > > input;
+    for (unsigned j = 0; j != state.symbolics->size(); ++j)
+      input.push_back(
+          std::make_pair((*state.symbolics)[j].first->name, values[j]));
+    concolic->addInput(input, i, score);
+  }
+}
+
+void Executor::recordDecision(ExecutionState &state, unsigned decision,
+                              const CheckpointTree::Node *node) {
+  if (Checkpoint || SwapStates || seedWorker)
+    state.decisions.append(decision);
+  if (node && !node->children.empty())
+    resumeNodes[&state] = node;
+  else
+    resumeNodes.erase(&state);
+}
+
+void Executor::writeCheckpoint() {
+  if (!Checkpoint)
+    return;
+
+  // Timers fire before the states of the current step are committed.
+  std::vector<const DecisionHistory *> histories;
+  for (ExecutionState *es : states)
+    if (std::find(removedStates.begin(), removedStates.end(), es) ==
+        removedStates.end())
+      histories.push_back(&es->decisions);
+  for (ExecutionState *es : addedStates)
+    histories.push_back(&es->decisions);
+  if (histories.empty())
+    return;
+
+  std::string error;
+  if (!CheckpointTree::write(
+          interpreterHandler->getOutputFilename("checkpoint.ktree"),
+          histories, error))
+    klee_warning("unable to write checkpoint: %s", error.c_str());
+  else
+    klee_message("checkpointed %u states", (unsigned)histories.size());
+}
+
+void Executor::doDumpStates() {
+  writeCheckpoint();
+  if (!DumpStatesOnHalt || states.empty())
+    return;
+
+  klee_message("halting execution, dumping remaining states");
+  for (const auto &state : states)
+    terminateStateEarly(*state, "Execution halting.");
+  updateStates(nullptr);
+}
+
+void Executor::run(ExecutionState &initialState) {
+  bindModuleConstants();
 
   // Delay init till now so that ticks don't accrue during
   // optimization and such.
@@ -2876,6 +4020,31 @@ void Executor::run(ExecutionState &initialState) {
 
   states.insert(&initialState);
 
+  if (!ResumeFrom.empty()) {
+    std::unique_ptr<CheckpointTree> tree(new CheckpointTree());
+    std::string error;
+    if (!tree->read(ResumeFrom, error))
+      klee_error("unable to resume: %s", error.c_str());
+    if (!tree->getRoot()->children.empty())
+      resumeNodes[&initialState] = tree->getRoot();
+    resumeTrees.push_back(std::move(tree));
+  }
+
+  if (SwapStates || fuzzerBridge)
+    swapRoot = new ExecutionState(initialState);
+
+  if (Concolic) {
+    if (!usingSeeds && !fuzzerBridge)
+      klee_error("--concolic needs seeds (--seed-file or --seed-dir)");
+    runConcolic(initialState);
+    doDumpStates();
+    return;
+  }
+
+  // the inputs queued already are seeds from the start
+  if (fuzzerBridge)
+    syncFuzzer(&initialState);
+
   if (usingSeeds) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
     
@@ -2883,11 +4052,17 @@ void Executor::run(ExecutionState &initialState) {
            ie = usingSeeds->end(); it != ie; ++it)
       v.push_back(SeedInfo(*it));
 
+    std::vector<pid_t> workers;
+    if (SeedWorkers > 1 && v.size() > 1)
+      workers = forkSeedWorkers(v);
+
     int lastNumSeeds = usingSeeds->size()+10;
     time::Point lastTime, startTime = lastTime = time::getWallTime();
     ExecutionState *lastState = 0;
     while (!seedMap.empty()) {
       if (haltExecution) {
+        if (seedWorker)
+          finishSeedWorker();
         doDumpStates();
         return;
       }
@@ -2930,11 +4105,17 @@ void Executor::run(ExecutionState &initialState) {
       }
     }
 
+    if (seedWorker)
+      finishSeedWorker();
+    if (!workers.empty())
+      joinSeedWorkers(workers, initialState);
+
     klee_message("seeding done (%d states remain)", (int) states.size());
+    seedPrograms.clear();
 
     // XXX total hack, just because I like non uniform better but want
     // seed results to be equally weighted.
-    for (std::set<ExecutionState*>::iterator
+    for (StateSet::iterator
            it = states.begin(), ie = states.end();
          it != ie; ++it) {
       (*it)->weight = 1.;
@@ -2949,11 +4130,71 @@ void Executor::run(ExecutionState &initialState) {
   searcher = constructUserSearcher(*this);
 
   std::vector<ExecutionState *> newStates(states.begin(), states.end());
-  searcher->update(0, newStates, std::vector<ExecutionState *>());
+  searcher->update(0, newStates, llvm::None);
 
-  while (!states.empty() && !haltExecution) {
-    ExecutionState &state = searcher->selectState();
+  unsigned stepsSincePoll = 0;
+  while (!haltExecution) {
+    if (states.empty()) {
+      // Bring back swapped out states before finishing.
+      if (!swapInStates())
+        break;
+      updateStates(nullptr);
+    }
+    if (asyncQueries && !asyncQueries->empty() &&
+        (searcher->empty() || ++stepsSincePoll == 256)) {
+      stepsSincePoll = 0;
+      // wait for an answer if every state is waiting for one
+      resumeAsyncStates(/*block=*/searcher->empty());
+      updateStates(nullptr);
+    }
+    ExecutionState *selected;
+    {
+      TimerStatIncrementer timer(stats::searcherTime);
+      KLEE_TRACE_SCOPE("Searcher::selectState");
+      selected = &searcher->selectState();
+    }
+    ExecutionState &state = *selected;
+    if (speculative) {
+      // the state left waits, its next query can be solved meanwhile
+      if (lastSelected && lastSelected != &state)
+        speculateQueries(*lastSelected);
+      lastSelected = &state;
+    }
+    if (!state.lazyCondition.isNull() && !checkLazyFork(state)) {
+      updateStates(nullptr);
+      continue;
+    }
     KInstruction *ki = state.pc;
+    if (!state.openMergeStack.empty() &&
+        ki == state.openMergeStack.back()->getAutoClose()) {
+      // the end of a merge region, as if klee_close_merge() was called
+      if (DebugLogMerge)
+        llvm::errs() << "close merge region: " << &state << "\n";
+      inCloseMerge.insert(&state);
+      state.openMergeStack.back()->addClosedState(&state, ki->inst);
+      state.openMergeStack.pop_back();
+      updateStates(nullptr);
+      continue;
+    }
+    if (subsumption && isSubsumed(state)) {
+      updateStates(nullptr);
+      continue;
+    }
+    if (!kmodule->targetDistances.empty() && cannotReachTarget(state, ki)) {
+      terminateState(state);
+      updateStates(nullptr);
+      continue;
+    }
+    if (PruneCoveredStates != PruneCovered::Off &&
+        cannotReachUncovered(state, ki)) {
+      ++stats::coveredStates;
+      if (PruneCoveredStates == PruneCovered::Test)
+        terminateStateEarly(state, "no uncovered instruction reachable");
+      else
+        terminateState(state);
+      updateStates(nullptr);
+      continue;
+    }
     stepInstruction(state);
 
     executeInstruction(state, ki);
@@ -2968,6 +4209,9 @@ void Executor::run(ExecutionState &initialState) {
   searcher = 0;
 
   doDumpStates();
+
+  delete swapRoot;
+  swapRoot = 0;
 }
 
 std::string Executor::getAddressInfo(ExecutionState &state, 
@@ -3020,6 +4264,97 @@ std::string Executor::getAddressInfo(ExecutionState &state,
   return info.str();
 }
 
+bool Executor::deferBranch(ExecutionState &state, ref<Expr> condition) {
+  if (!asyncQueries || isa<ConstantExpr>(condition) || asyncQueries->full() ||
+      seedMap.count(&state) || isReplaying() ||
+      asyncBranchResults.count(&state) ||
+      // these make fork() concretize the condition before evaluating it
+      MaxStaticForkPct != 1. || MaxStaticSolvePct != 1. ||
+      MaxStaticCPForkPct != 1. || MaxStaticCPSolvePct != 1.)
+    return false;
+
+  if (!asyncQueries->start(state, condition, *solver, coreSolverTimeout))
+    return false;
+  // The branch is executed again once the answer is there; fork() then
+  // picks it up from asyncBranchResults.
+  state.pc = state.prevPC;
+  pauseState(state);
+  return true;
+}
+
+bool Executor::checkLazyFork(ExecutionState &state) {
+  ref<Expr> condition = state.lazyCondition;
+  state.lazyCondition = ref<Expr>();
+
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginFork);
+  bool feasible;
+  solver->setTimeout(coreSolverTimeout);
+  bool success = solver->mayBeTrue(state, condition, feasible);
+  solver->setTimeout(time::Span());
+  if (!success) {
+    terminateStateEarly(state, "Query timed out (lazy fork).");
+    return false;
+  }
+  if (!feasible) {
+    // not a path of the program, so neither explored nor worth a test
+    ++stats::lazyForksInfeasible;
+    removeState(state);
+    return false;
+  }
+  addConstraint(state, condition);
+  return true;
+}
+
+void Executor::resumeAsyncStates(bool block) {
+  std::vector<AsyncBranchQueries::Result> results;
+  if (DeterministicAsyncQueries)
+    asyncQueries->collectAll(results);
+  else
+    asyncQueries->collect(block, results);
+  for (const AsyncBranchQueries::Result &r : results) {
+    AsyncBranchResult &result = asyncBranchResults[r.state];
+    result.condition = r.condition;
+    result.success = r.success;
+    result.validity = r.validity;
+    stats::solverTime += r.solverTime.toMicroseconds();
+    r.state->queryCost += r.solverTime;
+    continueState(*r.state);
+  }
+}
+
+void Executor::speculateQueries(ExecutionState &state) {
+  // the queries would not be the ones issued when the state runs
+  if (!seedMap.empty() || isReplaying() || LazyFork ||
+      !state.lazyCondition.isNull() ||
+      (asyncQueries && asyncQueries->isPending(&state)))
+    return;
+
+  KInstruction *ki = state.pc;
+  solver->setTimeout(coreSolverTimeout);
+  if (BranchInst *bi = dyn_cast<BranchInst>(ki->inst)) {
+    if (bi->isConditional() && MaxStaticForkPct == 1. &&
+        MaxStaticSolvePct == 1. && MaxStaticCPForkPct == 1. &&
+        MaxStaticCPSolvePct == 1.) {
+      ref<Expr> cond = optimizer.optimizeExpr(eval(ki, 0, state).value, false);
+      if (!isa<ConstantExpr>(cond))
+        solver->speculateEvaluate(state, cond);
+    }
+  } else if (isa<ReturnInst>(ki->inst) && state.stack.size() == 1 &&
+             !MinimizeTestCases) {
+    // getSymbolicSolution() asks for more with preferred values
+    std::vector<const Array *> objects;
+    for (unsigned i = 0; i != state.symbolics->size(); ++i) {
+      if (!(*state.symbolics)[i].first->cexPreferences.empty()) {
+        objects.clear();
+        break;
+      }
+      objects.push_back((*state.symbolics)[i].second);
+    }
+    solver->speculateInitialValues(state.getPathConstraints(), objects);
+  }
+  solver->setTimeout(time::Span());
+}
+
 void Executor::pauseState(ExecutionState &state){
   auto it = std::find(continuedStates.begin(), continuedStates.end(), &state);
   // If the state was to be continued, but now gets paused again
@@ -3050,7 +4385,46 @@ void Executor::terminateState(ExecutionState &state) {
                       "replay did not consume all objects in test input.");
   }
 
+  if (seedWorker)
+    seedWorkerPaths.push_back(state.decisions);
+  if (concolic && !haltExecution && seedMap.count(&state))
+    expandConcolicPath(state);
+  if (searcherFeaturesFile)
+    SearcherModel::writeFeatures(*searcherFeaturesFile, state);
   interpreterHandler->incPathsExplored();
+  removeState(state);
+}
+
+bool Executor::cannotReachTarget(ExecutionState &state, KInstruction *ki) {
+  if (state.reachedTarget)
+    return false;
+  if (kmodule->targetDistances[ki->info->id] == 1) {
+    state.reachedTarget = true;
+    return false;
+  }
+  // the distance is checked on entering blocks, as the branches change it
+  if (ki->inst != &ki->inst->getParent()->front())
+    return false;
+  return !DirectedSearcher::getDistance(*kmodule, state);
+}
+
+bool Executor::cannotReachUncovered(ExecutionState &state, KInstruction *ki) {
+  // the distance is checked on entering blocks, as the branches change it.
+  // An unreachable return stays unreachable, so the distances kept in the
+  // frames are never wrongly 0.
+  if (ki->inst != &ki->inst->getParent()->front())
+    return false;
+  return !computeMinDistToUncovered(
+      ki, state.stack.back().minDistToUncoveredOnReturn);
+}
+
+void Executor::removeState(ExecutionState &state) {
+  if (subsumption)
+    SubsumptionTable::release(state);
+  if (&state == lastSelected)
+    lastSelected = 0;
+  asyncBranchResults.erase(&state);
+  resumeNodes.erase(&state);
 
   std::vector<ExecutionState *>::iterator it =
       std::find(addedStates.begin(), addedStates.end(), &state);
@@ -3072,20 +4446,65 @@ void Executor::terminateState(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, 
                                    const Twine &message) {
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
-      (AlwaysOutputSeeds && seedMap.count(&state)))
+  // the test case would not follow the path if it is not feasible
+  if (!state.lazyCondition.isNull() && !checkLazyFork(state))
+    return;
+  // a seed worker leaves the tests to the main process
+  if (!seedWorker && (!OnlyOutputStatesCoveringNew || state.coveredNew ||
+                      (AlwaysOutputSeeds && seedMap.count(&state))) &&
+      !isDuplicateTestCase(state)) {
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
                                         "early");
+    exportTestCase(state);
+  }
   terminateState(state);
 }
 
+bool Executor::isSubsumed(ExecutionState &state) {
+  if (DropDuplicateStates && subsumption->isDuplicate(state)) {
+    ++stats::duplicateStates;
+    // its paths are those of the state seen before
+    SubsumptionTable::complete(state);
+    terminateState(state);
+    return true;
+  }
+  if (!PruneSubsumedStates)
+    return false;
+
+  solver->setTimeout(coreSolverTimeout);
+  bool subsumed = subsumption->visit(state, solver);
+  solver->setTimeout(time::Span());
+  if (!subsumed)
+    return false;
+  ++stats::subsumedStates;
+  // its paths from here are those of the explored state
+  SubsumptionTable::complete(state);
+  terminateStateEarly(state, "subsumed by an explored state");
+  return true;
+}
+
 void Executor::terminateStateOnExit(ExecutionState &state) {
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew || 
-      (AlwaysOutputSeeds && seedMap.count(&state)))
+  if (subsumption)
+    SubsumptionTable::complete(state);
+  if (!seedWorker && (!OnlyOutputStatesCoveringNew || state.coveredNew ||
+                      (AlwaysOutputSeeds && seedMap.count(&state))) &&
+      !isDuplicateTestCase(state)) {
     interpreterHandler->processTestCase(state, 0, 0);
+    exportTestCase(state);
+  }
   terminateState(state);
 }
 
+bool Executor::isDuplicateTestCase(const ExecutionState &state) {
+  if (!DedupTestCases)
+    return false;
+
+  std::uint64_t fingerprint = 0;
+  for (std::uint64_t edge : state.coveredEdges)
+    fingerprint = llvm::hash_combine(fingerprint, edge);
+  return !emittedCoverage.insert(fingerprint).second;
+}
+
 const InstructionInfo & Executor::getLastNonKleeInternalInstruction(const ExecutionState &state,
     Instruction ** lastInstruction) {
   // unroll the stack of the applications state and find
@@ -3150,8 +4569,9 @@ void Executor::terminateStateOnError(ExecutionState &state,
   Instruction * lastInst;
   const InstructionInfo &ii = getLastNonKleeInternalInstruction(state, &lastInst);
   
-  if (EmitAllErrors ||
-      emittedErrors.insert(std::make_pair(lastInst, message)).second) {
+  if (!seedWorker &&
+      (EmitAllErrors ||
+       emittedErrors.insert(std::make_pair(lastInst, message)).second)) {
     if (ii.file != "") {
       klee_message("ERROR: %s:%d: %s", ii.file.c_str(), ii.line, message.c_str());
     } else {
@@ -3183,8 +4603,13 @@ void Executor::terminateStateOnError(ExecutionState &state,
     }
 
     interpreterHandler->processTestCase(state, msg.str().c_str(), suffix);
+    exportTestCase(state);
   }
-    
+
+  // the paths end with errors of the program, but not with those of KLEE
+  if (subsumption && termReason != Exec && termReason != External &&
+      termReason != Model && termReason != Unhandled)
+    SubsumptionTable::complete(state);
   terminateState(state);
 
   if (shouldExitOn(termReason))
@@ -3204,6 +4629,11 @@ void Executor::callExternalFunction(ExecutionState &state,
                                     KInstruction *target,
                                     Function *function,
                                     std::vector< ref<Expr> > &arguments) {
+  KLEE_TRACE_SCOPE("Executor::callExternalFunction");
+  // what it does is not recorded
+  if (state.summaryRecording)
+    functionSummaries->abandon(state);
+
   // check if specialFunctionHandler wants it
   if (specialFunctionHandler->handle(state, function, target, arguments))
     return;
@@ -3223,39 +4653,109 @@ void Executor::callExternalFunction(ExecutionState &state,
   uint64_t *args = (uint64_t*) alloca(2*sizeof(*args) * (arguments.size() + 1));
   memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
   unsigned wordIndex = 2;
-  for (std::vector<ref<Expr> >::iterator ai = arguments.begin(), 
-       ae = arguments.end(); ai!=ae; ++ai) {
-    if (ExternalCalls == ExternalCallPolicy::All) { // don't bother checking uniqueness
-      *ai = optimizer.optimizeExpr(*ai, true);
-      ref<ConstantExpr> ce;
-      bool success = solver->getValue(state, *ai, ce);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      ce->toMemory(&args[wordIndex]);
-      ObjectPair op;
-      // Checking to see if the argument is a pointer to something
-      if (ce->getWidth() == Context::get().getPointerWidth() &&
-          state.addressSpace.resolveOne(ce, op)) {
-        op.second->flushToConcreteStore(solver, state);
-      }
-      wordIndex += (ce->getWidth()+63)/64;
-    } else {
-      ref<Expr> arg = toUnique(state, *ai);
-      if (ConstantExpr *ce = dyn_cast<ConstantExpr>(arg)) {
-        // XXX kick toMemory functions from here
-        ce->toMemory(&args[wordIndex]);
-        wordIndex += (ce->getWidth()+63)/64;
-      } else {
-        terminateStateOnExecError(state, 
-                                  "external call with symbolic argument: " + 
-                                  function->getName());
-        return;
-      }
+  // the argument values which may be pointers, for copying the reachable
+  // objects only
+  std::vector<uint64_t> pointers;
+
+  // The symbolic arguments, and with --external-calls=all the symbolic bytes
+  // of the objects they point to, are concretized together from one model
+  // instead of a query or two each.
+  std::vector<ref<Expr> > values(arguments.size());
+  std::vector<ref<Expr> > symbolic;
+  for (unsigned i = 0; i != arguments.size(); ++i) {
+    if (!isa<ConstantExpr>(arguments[i]))
+      arguments[i] = optimizer.optimizeExpr(arguments[i], true);
+    if (isa<ConstantExpr>(arguments[i]))
+      values[i] = arguments[i];
+    else
+      symbolic.push_back(arguments[i]);
+  }
+
+  bool all = ExternalCalls == ExternalCallPolicy::All;
+  std::set<const ObjectState *> flushed;
+  auto addPointee = [&](ref<Expr> value, std::vector<ref<Expr> > &bytes,
+                        std::vector<const ObjectState *> &objects) {
+    ObjectPair op;
+    if (value->getWidth() == Context::get().getPointerWidth() &&
+        state.addressSpace.resolveOne(cast<ConstantExpr>(value), op) &&
+        flushed.insert(op.second).second) {
+      op.second->getKnownSymbolicBytes(bytes);
+      objects.push_back(op.second);
+    }
+  };
+
+  // The pointees of the symbolic pointers are only known from the model,
+  // so their bytes take a second one.
+  for (unsigned round = 0; round != 2; ++round) {
+    std::vector<ref<Expr> > exprs, bytes;
+    std::vector<const ObjectState *> objects;
+    if (round == 0) {
+      exprs = symbolic;
+      if (all)
+        for (const ref<Expr> &value : values)
+          if (!value.isNull())
+            addPointee(value, bytes, objects);
+    } else if (all) {
+      for (unsigned i = 0; i != arguments.size(); ++i)
+        if (!isa<ConstantExpr>(arguments[i]))
+          addPointee(values[i], bytes, objects);
+    }
+    exprs.insert(exprs.end(), bytes.begin(), bytes.end());
+    if (exprs.empty())
+      continue;
+
+    TimingSolver::OriginScope origin(solver, all ? TimingSolver::OriginGetValue
+                                                 : TimingSolver::OriginToUnique);
+    Assignment model;
+    if (!getModel(state, exprs, model)) {
+      terminateStateEarly(state, "Query timed out (external call).");
+      return;
+    }
+    ref<Expr> fixed = ConstantExpr::alloc(1, Expr::Bool);
+    for (const ref<Expr> &e : exprs)
+      fixed = AndExpr::create(fixed, EqExpr::create(e, model.evaluate(e)));
+    if (round == 0)
+      for (unsigned i = 0; i != arguments.size(); ++i)
+        if (values[i].isNull())
+          values[i] = model.evaluate(arguments[i]);
+
+    if (all) {
+      for (const ObjectState *os : objects)
+        os->flushToConcreteStore(model);
+      addConstraint(state, fixed);
+      continue;
     }
+
+    // The arguments are unique if the model's values are the only ones.
+    bool unique;
+    solver->setTimeout(coreSolverTimeout);
+    bool success = solver->mustBeTrue(state, fixed, unique);
+    solver->setTimeout(time::Span());
+    if (!success || !unique) {
+      terminateStateOnExecError(state,
+                                "external call with symbolic argument: " +
+                                    function->getName());
+      return;
+    }
+  }
+
+  for (const ref<Expr> &value : values) {
+    ConstantExpr *ce = cast<ConstantExpr>(value);
+    // XXX kick toMemory functions from here
+    ce->toMemory(&args[wordIndex]);
+    if (ce->getWidth() == Context::get().getPointerWidth())
+      pointers.push_back(ce->getZExtValue());
+    wordIndex += (ce->getWidth()+63)/64;
   }
 
   // Prepare external memory for invoking the function
-  state.addressSpace.copyOutConcretes();
+  ResolutionList reachable;
+  if (ExternalCallsCopyReachable) {
+    state.addressSpace.getReachableObjects(pointers, reachable);
+    state.addressSpace.copyOutConcretes(reachable);
+  } else {
+    state.addressSpace.copyOutConcretes();
+  }
 #ifndef WINDOWS
   // Update external errno state with local state value
   int *errno_addr = getErrnoLocation(state);
@@ -3302,7 +4802,9 @@ void Executor::callExternalFunction(ExecutionState &state,
     return;
   }
 
-  if (!state.addressSpace.copyInConcretes()) {
+  if (!(ExternalCallsCopyReachable
+            ? state.addressSpace.copyInConcretes(reachable)
+            : state.addressSpace.copyInConcretes())) {
     terminateStateOnError(state, "external modified read-only object",
                           External);
     return;
@@ -3328,7 +4830,7 @@ void Executor::callExternalFunction(ExecutionState &state,
 ref<Expr> Executor::replaceReadWithSymbolic(ExecutionState &state, 
                                             ref<Expr> e) {
   unsigned n = interpreterOpts.MakeConcreteSymbolic;
-  if (!n || replayKTest || replayPath)
+  if (!n || replayKTest || isReplaying())
     return e;
 
   // right now, we don't replace symbolics (is there any reason to?)
@@ -3366,9 +4868,38 @@ ObjectState *Executor::bindObjectInState(ExecutionState &state,
   if (isLocal)
     state.stack.back().allocas.push_back(mo);
 
+  if (state.summaryRecording)
+    functionSummaries->recordAllocation(state, mo);
+
   return os;
 }
 
+void Executor::bindAllocation(ExecutionState &state, MemoryObject *mo,
+                              bool isLocal, KInstruction *target,
+                              bool zeroMemory,
+                              const ObjectState *reallocFrom) {
+  if (!mo) {
+    bindLocal(target, state, 
+              ConstantExpr::alloc(0, Context::get().getPointerWidth()));
+    return;
+  }
+
+  ObjectState *os = bindObjectInState(state, mo, isLocal);
+  if (zeroMemory) {
+    os->initializeToZero();
+  } else {
+    os->initializeToRandom();
+  }
+  bindLocal(target, state, mo->getBaseExpr());
+
+  if (reallocFrom) {
+    unsigned count = std::min(reallocFrom->size, os->size);
+    for (unsigned i=0; i<count; i++)
+      os->write(i, reallocFrom->read8(i));
+    state.addressSpace.unbindObject(reallocFrom->getObject());
+  }
+}
+
 void Executor::executeAlloc(ExecutionState &state,
                             ref<Expr> size,
                             bool isLocal,
@@ -3385,25 +4916,7 @@ void Executor::executeAlloc(ExecutionState &state,
     MemoryObject *mo =
         memory->allocate(CE->getZExtValue(), isLocal, /*isGlobal=*/false,
                          allocSite, allocationAlignment);
-    if (!mo) {
-      bindLocal(target, state, 
-                ConstantExpr::alloc(0, Context::get().getPointerWidth()));
-    } else {
-      ObjectState *os = bindObjectInState(state, mo, isLocal);
-      if (zeroMemory) {
-        os->initializeToZero();
-      } else {
-        os->initializeToRandom();
-      }
-      bindLocal(target, state, mo->getBaseExpr());
-      
-      if (reallocFrom) {
-        unsigned count = std::min(reallocFrom->size, os->size);
-        for (unsigned i=0; i<count; i++)
-          os->write(i, reallocFrom->read8(i));
-        state.addressSpace.unbindObject(reallocFrom->getObject());
-      }
-    }
+    bindAllocation(state, mo, isLocal, target, zeroMemory, reallocFrom);
   } else {
     // XXX For now we just pick a size. Ideally we would support
     // symbolic sizes fully but even if we don't it would be better to
@@ -3418,6 +4931,21 @@ void Executor::executeAlloc(ExecutionState &state,
 
     size = optimizer.optimizeExpr(size, true);
 
+    const KInstruction *site = state.prevPC;
+    ConcretizationPolicy::Action action =
+        concretizationPolicy.getSizeAction(site);
+    if (action == ConcretizationPolicy::Concretize) {
+      ref<ConstantExpr> value = toConstant(state, size, "symbolic size");
+      executeAlloc(state, value, isLocal, target, zeroMemory, reallocFrom);
+      return;
+    }
+    if (action == ConcretizationPolicy::Symbolic) {
+      executeSymbolicAlloc(state, size, isLocal, target, zeroMemory,
+                           reallocFrom, allocationAlignment);
+      return;
+    }
+    uint64_t solverTimeBefore = stats::solverTime;
+
     ref<ConstantExpr> example;
     bool success = solver->getValue(state, size, example);
     assert(success && "FIXME: Unhandled solver failure");
@@ -3482,9 +5010,85 @@ void Executor::executeAlloc(ExecutionState &state,
     if (fixedSize.first) // can be zero when fork fails
       executeAlloc(*fixedSize.first, example, isLocal, 
                    target, zeroMemory, reallocFrom);
+
+    concretizationPolicy.recordSize(
+        site, time::microseconds(stats::solverTime - solverTimeBefore));
   }
 }
 
+void Executor::executeSymbolicAlloc(ExecutionState &state, ref<Expr> size,
+                                    bool isLocal, KInstruction *target,
+                                    bool zeroMemory,
+                                    const ObjectState *reallocFrom,
+                                    size_t allocationAlignment) {
+  Expr::Width W = Context::get().getPointerWidth();
+  size = ZExtExpr::create(size, W);
+
+  // As when forking, a size above the bound makes the allocation fail.
+  uint64_t bound = ConcretizationPolicy::getSymbolicSizeBound();
+  StatePair bounded =
+      fork(state, UleExpr::create(size, ConstantExpr::alloc(bound, W)), true);
+  if (bounded.second) {
+    klee_message("NOTE: found huge malloc, returning 0");
+    bindLocal(target, *bounded.second, ConstantExpr::alloc(0, W));
+  }
+  if (!bounded.first)
+    return;
+
+  ExecutionState &s = *bounded.first;
+  solver->setTimeout(coreSolverTimeout);
+  std::pair<ref<Expr>, ref<Expr> > range = solver->getRange(s, size);
+  solver->setTimeout(time::Span());
+  uint64_t min = cast<ConstantExpr>(range.first)->getZExtValue();
+  uint64_t max = cast<ConstantExpr>(range.second)->getZExtValue();
+  if (min == max) {
+    executeAlloc(s, range.second, isLocal, target, zeroMemory, reallocFrom,
+                 allocationAlignment);
+    return;
+  }
+
+  // The object has room for the largest size, and the bounds checks keep
+  // the accesses below the actual one.
+  const llvm::Value *allocSite = s.prevPC->inst;
+  if (allocationAlignment == 0)
+    allocationAlignment = getAllocationAlignment(allocSite);
+  MemoryObject *mo = memory->allocate(max, isLocal, /*isGlobal=*/false,
+                                      allocSite, allocationAlignment);
+  if (mo)
+    mo->symbolicSize = size;
+  bindAllocation(s, mo, isLocal, target, zeroMemory, reallocFrom);
+}
+
+ExecutionState *Executor::checkOperand(ExecutionState &state,
+                                       ref<Expr> error, const char *message,
+                                       const char *suffix) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(error)) {
+    if (CE->isFalse())
+      return &state;
+    terminateStateOnError(state, message, ReportError, suffix);
+    return nullptr;
+  }
+
+  StatePair branches = fork(state, error, true);
+  if (branches.first)
+    terminateStateOnError(*branches.first, message, ReportError, suffix);
+  return branches.second;
+}
+
+ExecutionState *Executor::checkDivisor(ExecutionState &state,
+                                       ref<Expr> divisor) {
+  return checkOperand(state, Expr::createIsZero(divisor), "divide by zero",
+                      "div.err");
+}
+
+ExecutionState *Executor::checkShiftAmount(ExecutionState &state,
+                                           ref<Expr> shift) {
+  Expr::Width width = shift->getWidth();
+  return checkOperand(state,
+                      UgeExpr::create(shift, ConstantExpr::alloc(width, width)),
+                      "overshift error", "overshift.err");
+}
+
 void Executor::executeFree(ExecutionState &state,
                            ref<Expr> address,
                            KInstruction *target) {
@@ -3520,6 +5124,7 @@ void Executor::resolveExact(ExecutionState &state,
                             ref<Expr> p,
                             ExactResolutionList &results, 
                             const std::string &name) {
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginResolve);
   p = optimizer.optimizeExpr(p, true);
   // XXX we may want to be capping this?
   ResolutionList rl;
@@ -3551,8 +5156,8 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
-  Expr::Width type = (isWrite ? value->getWidth() : 
-                     getWidthForLLVMType(target->inst->getType()));
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginResolve);
+  Expr::Width type = (isWrite ? value->getWidth() : target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (SimplifySymIndices) {
@@ -3564,6 +5169,13 @@ void Executor::executeMemoryOperation(ExecutionState &state,
 
   address = optimizer.optimizeExpr(address, true);
 
+  if (LazyInit && !isa<ConstantExpr>(address) &&
+      lazyInitialize(state, isWrite, address, value, target))
+    return;
+
+  if (state.summaryRecording && !isa<ConstantExpr>(address))
+    functionSummaries->abandon(state);
+
   // fast path: single in-bounds resolution
   ObjectPair op;
   bool success;
@@ -3585,14 +5197,29 @@ void Executor::executeMemoryOperation(ExecutionState &state,
     ref<Expr> check = mo->getBoundsCheckOffset(offset, bytes);
     check = optimizer.optimizeExpr(check, true);
 
-    bool inBounds;
-    solver->setTimeout(coreSolverTimeout);
-    bool success = solver->mustBeTrue(state, check, inBounds);
-    solver->setTimeout(time::Span());
-    if (!success) {
-      state.pc = state.prevPC;
-      terminateStateEarly(state, "Query timed out (bounds check).");
-      return;
+    // an access proved in bounds stays so as constraints are added, and
+    // one proved in bounds statically is in bounds of the object it resolved
+    // to, as it is of every object it may point to
+    auto access = std::make_tuple(mo->id, offset, bytes);
+    bool inBounds = false;
+    if (!isa<ConstantExpr>(check) && state.prevPC->provedInBounds) {
+      inBounds = true;
+      ++stats::inBoundsProofs;
+    } else if (!isa<ConstantExpr>(check) &&
+               state.inBoundsAccesses.count(access)) {
+      inBounds = true;
+      ++stats::inBoundsCacheHits;
+    } else {
+      solver->setTimeout(coreSolverTimeout);
+      bool success = solver->mustBeTrue(state, check, inBounds);
+      solver->setTimeout(time::Span());
+      if (!success) {
+        state.pc = state.prevPC;
+        terminateStateEarly(state, "Query timed out (bounds check).");
+        return;
+      }
+      if (inBounds && !isa<ConstantExpr>(check))
+        state.inBoundsAccesses = state.inBoundsAccesses.insert(access);
     }
 
     if (inBounds) {
@@ -3604,12 +5231,25 @@ void Executor::executeMemoryOperation(ExecutionState &state,
         } else {
           ObjectState *wos = state.addressSpace.getWriteable(mo, os);
           wos->write(offset, value);
+          if (state.summaryRecording)
+            functionSummaries->recordAccess(
+                state, mo, wos, cast<ConstantExpr>(offset)->getZExtValue(),
+                bytes, true);
         }          
       } else {
         ref<Expr> result = os->read(offset, type);
         
         if (interpreterOpts.MakeConcreteSymbolic)
           result = replaceReadWithSymbolic(state, result);
+
+        if (state.summaryRecording) {
+          if (isa<ConstantExpr>(result))
+            functionSummaries->recordAccess(
+                state, mo, os, cast<ConstantExpr>(offset)->getZExtValue(),
+                bytes, false);
+          else
+            functionSummaries->abandon(state);
+        }
         
         bindLocal(target, state, result);
       }
@@ -3621,11 +5261,29 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   // we are on an error path (no resolution, multiple resolution, one
   // resolution with out of bounds)
 
+  if (state.summaryRecording)
+    functionSummaries->abandon(state);
+
   address = optimizer.optimizeExpr(address, true);
+
+  const KInstruction *site = state.prevPC;
+  ConcretizationPolicy::Action action =
+      concretizationPolicy.getPointerAction(site);
+  if (action == ConcretizationPolicy::Concretize && !isa<ConstantExpr>(address))
+    address = toConstant(state, address, "symbolic pointer");
+  if (action == ConcretizationPolicy::Merge && !isa<ConstantExpr>(address) &&
+      executeMergedMemoryOperation(state, isWrite, address, value, target))
+    return;
+  unsigned maxResolutions = action == ConcretizationPolicy::Bounded
+                                ? ConcretizationPolicy::getForkBound()
+                                : 0;
+  uint64_t solverTimeBefore = stats::solverTime;
+
   ResolutionList rl;  
   solver->setTimeout(coreSolverTimeout);
   bool incomplete = state.addressSpace.resolve(state, solver, address, rl,
-                                               0, coreSolverTimeout);
+                                               maxResolutions,
+                                               coreSolverTimeout);
   solver->setTimeout(time::Span());
   
   // XXX there is some query wasteage here. who cares?
@@ -3659,6 +5317,18 @@ void Executor::executeMemoryOperation(ExecutionState &state,
     if (!unbound)
       break;
   }
+
+  if (!isa<ConstantExpr>(address))
+    concretizationPolicy.recordPointer(
+        site, time::microseconds(stats::solverTime - solverTimeBefore));
+
+  // the objects left out of a bounded resolution are not explored
+  if (unbound && incomplete && maxResolutions &&
+      rl.size() == maxResolutions) {
+    ref<Expr> concrete = toConstant(*unbound, address, "symbolic pointer");
+    executeMemoryOperation(*unbound, isWrite, concrete, value, target);
+    return;
+  }
   
   // XXX should we distinguish out of bounds and overlapped cases?
   if (unbound) {
@@ -3671,17 +5341,192 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   }
 }
 
+bool Executor::executeMergedMemoryOperation(ExecutionState &state,
+                                            bool isWrite, ref<Expr> address,
+                                            ref<Expr> value,
+                                            KInstruction *target) {
+  Expr::Width type = (isWrite ? value->getWidth() : target->width);
+  unsigned bytes = Expr::getMinBytesForWidth(type);
+  unsigned bound = ConcretizationPolicy::getMergeBound();
+
+  ResolutionList rl;
+  solver->setTimeout(coreSolverTimeout);
+  bool incomplete = state.addressSpace.resolve(state, solver, address, rl,
+                                               bound + 1, coreSolverTimeout);
+  solver->setTimeout(time::Span());
+  if (incomplete || rl.size() < 2)
+    return false;
+  if (isWrite)
+    for (const ObjectPair &op : rl)
+      if (op.second->readOnly)
+        return false;
+
+  std::vector<ref<Expr> > inBounds;
+  ref<Expr> anyInBounds = ConstantExpr::alloc(0, Expr::Bool);
+  for (const ObjectPair &op : rl) {
+    inBounds.push_back(op.first->getBoundsCheckPointer(address, bytes));
+    anyInBounds = OrExpr::create(anyInBounds, inBounds.back());
+  }
+
+  StatePair branches = fork(state, anyInBounds, true);
+  if (ExecutionState *bound = branches.first) {
+    if (isWrite) {
+      // where the pointer points elsewhere the write puts back what is there
+      for (unsigned i = 0; i != rl.size(); ++i) {
+        const MemoryObject *mo = rl[i].first;
+        ObjectState *wos =
+            bound->addressSpace.getWriteable(mo, rl[i].second);
+        ref<Expr> offset = mo->getOffsetExpr(address);
+        wos->write(offset, SelectExpr::create(inBounds[i], value,
+                                              wos->read(offset, type)));
+      }
+    } else {
+      ref<Expr> result;
+      for (unsigned i = rl.size(); i-- != 0;) {
+        const MemoryObject *mo = rl[i].first;
+        ref<Expr> read = rl[i].second->read(mo->getOffsetExpr(address), type);
+        result = result.isNull() ? read
+                                 : SelectExpr::create(inBounds[i], read, result);
+      }
+      bindLocal(target, *bound, result);
+    }
+  }
+
+  if (ExecutionState *unbound = branches.second)
+    terminateStateOnError(*unbound, "memory error: out of bound pointer", Ptr,
+                          NULL, getAddressInfo(*unbound, address));
+  return true;
+}
+
+/// Returns the array whose bytes make up \a e alone, as when \a e was read
+/// whole from a symbolic object which was never written, or null.
+static const Array *getPointerSource(ref<Expr> e) {
+  if (WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+    if (wre->updates.head || !isa<klee::ConstantExpr>(wre->index))
+      return 0;
+    return wre->updates.root;
+  }
+
+  const Array *array = 0;
+  for (;;) {
+    ref<Expr> byte = e;
+    ConcatExpr *ce = dyn_cast<ConcatExpr>(e);
+    if (ce)
+      byte = ce->getLeft();
+    ReadExpr *re = dyn_cast<ReadExpr>(byte);
+    if (!re || re->updates.head || !isa<klee::ConstantExpr>(re->index) ||
+        (array && re->updates.root != array))
+      return 0;
+    array = re->updates.root;
+    if (!ce)
+      return array;
+    e = ce->getRight();
+  }
+}
+
+bool Executor::lazyInitialize(ExecutionState &state, bool isWrite,
+                              ref<Expr> address, ref<Expr> value,
+                              KInstruction *target) {
+  // the pointer may have an offset added, of a field or an element
+  ref<Expr> base = address;
+  const Array *source = getPointerSource(base);
+  if (AddExpr *ae = dyn_cast<AddExpr>(address)) {
+    if (!source && (source = getPointerSource(ae->right)))
+      base = ae->right;
+    if (!source && (source = getPointerSource(ae->left)))
+      base = ae->left;
+  }
+  if (!source || base->getWidth() != Context::get().getPointerWidth() ||
+      state.lazyPointers->count(base))
+    return false;
+
+  // only pointers in the symbolic inputs are free to point anywhere
+  bool isInput = false;
+  for (size_t i = 0, e = state.symbolics->size(); i != e && !isInput; ++i)
+    isInput = (*state.symbolics)[i].second == source;
+  if (!isInput)
+    return false;
+
+  unsigned depth = 1;
+  auto it = state.lazyObjects->find(source);
+  if (it != state.lazyObjects->end())
+    depth = it->second.second + 1;
+
+  // null, then each object this pointer may alias
+  std::vector<ref<Expr> > choices;
+  choices.push_back(ConstantExpr::create(0, base->getWidth()));
+  for (const auto &lazy : *state.lazyObjects)
+    if (lazy.second.first->size == LazyInitSize)
+      choices.push_back(lazy.second.first->getBaseExpr());
+
+  std::vector<ExecutionState *> bound;
+  ExecutionState *unbound = &state;
+  for (const ref<Expr> &choice : choices) {
+    StatePair branches = fork(*unbound, EqExpr::create(base, choice), true);
+    if (branches.first)
+      bound.push_back(branches.first);
+    unbound = branches.second;
+    if (!unbound)
+      break;
+  }
+
+  // or a new object, while not too deep
+  if (unbound && depth <= LazyInitDepth) {
+    MemoryObject *mo =
+        memory->allocate(LazyInitSize, /*isLocal=*/false, /*isGlobal=*/false,
+                         unbound->prevPC->inst, /*alignment=*/8);
+    if (mo) {
+      // the constraints may keep the pointer from the new address
+      ref<Expr> isNew = EqExpr::create(base, mo->getBaseExpr());
+      bool mayBeNew = false;
+      solver->setTimeout(coreSolverTimeout);
+      bool success = solver->mayBeTrue(*unbound, isNew, mayBeNew);
+      solver->setTimeout(time::Span());
+      if (success && mayBeNew) {
+        std::string name = "lazy" + llvm::utostr(depth);
+        mo->setName(name);
+        executeMakeSymbolic(*unbound, mo, name);
+        const SymbolicList &symbolics = *unbound->symbolics;
+        size_t n = symbolics.size();
+        // not when replaying a test, which makes the contents concrete
+        if (n && symbolics[n - 1].first == mo)
+          unbound->lazyObjects.mutate()[symbolics[n - 1].second] =
+              std::make_pair(mo, depth);
+        addConstraint(*unbound, isNew);
+      } else {
+        delete mo;
+      }
+    }
+  }
+  if (unbound)
+    bound.push_back(unbound);
+
+  for (ExecutionState *es : bound) {
+    es->lazyPointers.mutate().insert(base);
+    executeMemoryOperation(*es, isWrite, address, value, target);
+  }
+  return true;
+}
+
 void Executor::executeMakeSymbolic(ExecutionState &state, 
                                    const MemoryObject *mo,
                                    const std::string &name) {
   // Create a new object state for the memory object (instead of a copy).
   if (!replayKTest) {
     // Find a unique name for this array.  First try the original name,
-    // or if that fails try adding a unique identifier.
-    unsigned id = 0;
+    // or if that fails try adding a unique identifier, starting after the
+    // last one tried for this name.
+    std::map<unsigned, unsigned> &names = state.arrayNames.mutate();
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
-      uniqueName = name + "_" + llvm::utostr(++id);
+    auto used = names.find(Array::internName(name).second);
+    if (used == names.end()) {
+      names.insert(std::make_pair(Array::internName(name).second, 0u));
+    } else {
+      unsigned &id = used->second;
+      do {
+        uniqueName = name + "_" + llvm::utostr(++id);
+      } while (names.count(Array::internName(uniqueName).second));
+      names.insert(std::make_pair(Array::internName(uniqueName).second, 0u));
     }
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
     bindObjectInState(state, mo, false, array);
@@ -3748,12 +5593,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
 
 /***/
 
-void Executor::runFunctionAsMain(Function *f,
-				 int argc,
-				 char **argv,
-				 char **envp) {
-  std::vector<ref<Expr> > arguments;
-
+ExecutionState *
+Executor::createInitialState(const std::vector<Function *> &fs, int argc,
+                             char **argv, char **envp,
+                             std::vector<ref<Expr> > &arguments) {
   // force deterministic initialization of memory objects
   srand(1);
   srandom(1);
@@ -3769,12 +5612,13 @@ void Executor::runFunctionAsMain(Function *f,
   for (envc=0; envp[envc]; ++envc) ;
 
   unsigned NumPtrBytes = Context::get().getPointerWidth() / 8;
-  KFunction *kf = kmodule->functionMap[f];
-  assert(kf);
-  Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
-  if (ai!=ae) {
+  Function *f = fs.front();
+  unsigned numArgs = 0;
+  for (Function *entry : fs)
+    numArgs = std::max<unsigned>(numArgs, entry->arg_size());
+  if (numArgs > 0) {
     arguments.push_back(ConstantExpr::alloc(argc, Expr::Int32));
-    if (++ai!=ae) {
+    if (numArgs > 1) {
       Instruction *first = &*(f->begin()->begin());
       argvMO =
           memory->allocate((argc + 1 + envc + 1 + 1) * NumPtrBytes,
@@ -3786,30 +5630,17 @@ void Executor::runFunctionAsMain(Function *f,
 
       arguments.push_back(argvMO->getBaseExpr());
 
-      if (++ai!=ae) {
+      if (numArgs > 2) {
         uint64_t envp_start = argvMO->address + (argc+1)*NumPtrBytes;
         arguments.push_back(Expr::createPointer(envp_start));
 
-        if (++ai!=ae)
+        if (numArgs > 3)
           klee_error("invalid main function (expect 0-3 arguments)");
       }
     }
   }
 
-  ExecutionState *state = new ExecutionState(kmodule->functionMap[f]);
-  
-  if (pathWriter) 
-    state->pathOS = pathWriter->open();
-  if (symPathWriter) 
-    state->symPathOS = symPathWriter->open();
-
-
-  if (statsTracker)
-    statsTracker->framePushed(*state, 0);
-
-  assert(arguments.size() == f->arg_size() && "wrong number of arguments");
-  for (unsigned i = 0, e = f->arg_size(); i != e; ++i)
-    bindArgument(kf, i, *state, arguments[i]);
+  ExecutionState *state = new ExecutionState(getKFunction(f));
 
   if (argvMO) {
     ObjectState *argvOS = bindObjectInState(*state, argvMO, false);
@@ -3838,12 +5669,62 @@ void Executor::runFunctionAsMain(Function *f,
   }
   
   initializeGlobals(*state);
+  return state;
+}
 
-  processTree = new PTree(state);
-  state->ptreeNode = processTree->root;
-  run(*state);
-  delete processTree;
-  processTree = 0;
+void Executor::runFunctionAsMain(Function *f,
+				 int argc,
+				 char **argv,
+				 char **envp) {
+  runFunctionsAsMain(std::vector<Function *>(1, f), argc, argv, envp);
+}
+
+void Executor::runFunctionsAsMain(const std::vector<Function *> &fs, int argc,
+                                  char **argv, char **envp) {
+  assert(!fs.empty() && "no entry point");
+  std::vector<ref<Expr> > arguments;
+  std::unique_ptr<ExecutionState> initialState(
+      createInitialState(fs, argc, argv, envp, arguments));
+
+  for (Function *f : fs) {
+    if (haltExecution)
+      break;
+
+    // the last entry point takes over the initial state instead of a copy
+    KFunction *kf = getKFunction(f);
+    ExecutionState *state = f == fs.back() ? initialState.release()
+                                           : new ExecutionState(*initialState);
+    if (state->stack.back().kf != kf) {
+      while (!state->stack.empty())
+        state->popFrame();
+      state->pc = state->prevPC = kf->instructions;
+      state->pushFrame(0, kf);
+    }
+    if (fs.size() > 1) {
+      klee_message("running entry point %s", f->getName().str().c_str());
+      srand(1);
+      srandom(1);
+    }
+
+    if (pathWriter) 
+      state->pathOS = pathWriter->open();
+    if (symPathWriter) 
+      state->symPathOS = symPathWriter->open();
+
+    if (statsTracker)
+      statsTracker->framePushed(*state, 0);
+
+    for (unsigned i = 0, e = f->arg_size(); i != e; ++i)
+      bindArgument(kf, i, *state, arguments[i]);
+
+    processTree = new PTree(state, ptreeLog.get());
+    state->ptreeNode = processTree->root;
+    run(*state);
+    delete processTree;
+    processTree = 0;
+  }
+  // the entry points run after a halt do not take over the initial state
+  initialState.reset();
 
   // hack to clear memory objects
   delete memory;
@@ -3869,9 +5750,10 @@ unsigned Executor::getSymbolicPathStreamID(const ExecutionState &state) {
 void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
                                 Interpreter::LogType logFormat) {
 
+  ConstraintManager constraints = state.getPathConstraints();
   switch (logFormat) {
   case STP: {
-    Query query(state.constraints, ConstantExpr::alloc(0, Expr::Bool));
+    Query query(constraints, ConstantExpr::alloc(0, Expr::Bool));
     char *log = solver->getConstraintLog(query);
     res = std::string(log);
     free(log);
@@ -3880,7 +5762,7 @@ void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
   case KQUERY: {
     std::string Str;
     llvm::raw_string_ostream info(Str);
-    ExprPPrinter::printConstraints(info, state.constraints);
+    ExprPPrinter::printConstraints(info, constraints);
     res = info.str();
   } break;
 
@@ -3889,7 +5771,7 @@ void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
     llvm::raw_string_ostream info(Str);
     ExprSMTLIBPrinter printer;
     printer.setOutput(info);
-    Query query(state.constraints, ConstantExpr::alloc(0, Expr::Bool));
+    Query query(constraints, ConstantExpr::alloc(0, Expr::Bool));
     printer.setQuery(query);
     printer.generateOutput();
     res = info.str();
@@ -3905,9 +5787,11 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
                                    std::pair<std::string,
                                    std::vector<unsigned char> > >
                                    &res) {
+  TimingSolver::OriginScope origin(solver, TimingSolver::OriginSolution);
   solver->setTimeout(coreSolverTimeout);
 
   ExecutionState tmp(state);
+  tmp.constraints = state.getPathConstraints();
 
   // Go through each byte in every test case and attempt to restrict
   // it to the constraints contained in cexPreferences.  (Note:
@@ -3916,8 +5800,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // the preferred constraints.  See test/Features/PreferCex.c for
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
-  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
+  for (unsigned i = 0; i != state.symbolics->size(); ++i) {
+    const MemoryObject *mo = (*state.symbolics)[i].first;
     std::vector< ref<Expr> >::const_iterator pi = 
       mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
     for (; pi != pie; ++pi) {
@@ -3937,10 +5821,18 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     if (pi!=pie) break;
   }
 
+  // Smaller values make test cases easier to read, and to reduce.
+  if (MinimizeTestCases)
+    for (unsigned i = 0; i != state.symbolics->size(); ++i) {
+      const Array *array = (*state.symbolics)[i].second;
+      if (!preferZeros(tmp, array, 0, array->size))
+        break;
+    }
+
   std::vector< std::vector<unsigned char> > values;
   std::vector<const Array*> objects;
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    objects.push_back(state.symbolics[i].second);
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
   bool success = solver->getInitialValues(tmp, objects, values);
   solver->setTimeout(time::Span());
   if (!success) {
@@ -3950,47 +5842,101 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     return false;
   }
   
-  for (unsigned i = 0; i != state.symbolics.size(); ++i)
-    res.push_back(std::make_pair(state.symbolics[i].first->name, values[i]));
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    res.push_back(
+        std::make_pair((*state.symbolics)[i].first->name, values[i]));
   return true;
 }
 
+bool Executor::preferZeros(ExecutionState &state, const Array *array,
+                           unsigned begin, unsigned end) {
+  if (begin == end)
+    return true;
+
+  // zero the whole range if possible, else try either half
+  ref<Expr> zero = ConstantExpr::alloc(1, Expr::Bool);
+  for (unsigned i = begin; i != end; ++i) {
+    ref<Expr> byte = ReadExpr::create(UpdateList(array, 0),
+                                      ConstantExpr::alloc(i, Expr::Int32));
+    zero = AndExpr::create(
+        zero, EqExpr::create(byte, ConstantExpr::alloc(0, Expr::Int8)));
+  }
+
+  bool mayBeZero;
+  if (!solver->mayBeTrue(state, zero, mayBeZero))
+    return false;
+  if (mayBeZero) {
+    state.addConstraint(zero);
+    return true;
+  }
+  if (end - begin == 1)
+    return true;
+
+  unsigned mid = begin + (end - begin) / 2;
+  return preferZeros(state, array, begin, mid) &&
+         preferZeros(state, array, mid, end);
+}
+
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  if (infosById.empty()) {
+    infosById.resize(kmodule->infos->getMaxID());
+    for (auto &kf : kmodule->functions)
+      for (unsigned i = 0; i < kf->numInstructions; ++i)
+        infosById[kf->instructions[i]->info->id] = kf->instructions[i]->info;
+  }
+  for (unsigned id : *state.coveredInstructions) {
+    const InstructionInfo &ii = *infosById[id];
+    res[&ii.file].insert(ii.line);
+  }
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
                                             ref<Expr> e,
                                             ref<ConstantExpr> value) {
-  abort(); // FIXME: Broken until we sort out how to do the write back.
-
   if (DebugCheckForImpliedValues)
     ImpliedValue::checkForImpliedValues(solver->solver, e, value);
 
   ImpliedValueList results;
   ImpliedValue::getImpliedValues(e, value, results);
+  if (results.empty())
+    return;
+
+  // The bytes implied, by array, so that each object is written once.
+  std::map<const Array *, std::vector<const ImpliedValueList::value_type *> >
+      bytes;
   for (ImpliedValueList::iterator it = results.begin(), ie = results.end();
        it != ie; ++it) {
     ReadExpr *re = it->first.get();
-    
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-      // FIXME: This is the sole remaining usage of the Array object
-      // variable. Kill me.
-      const MemoryObject *mo = 0; //re->updates.root->object;
-      const ObjectState *os = state.addressSpace.findObject(mo);
+    if (isa<ConstantExpr>(re->index))
+      bytes[re->updates.root].push_back(&*it);
+  }
 
-      if (!os) {
-        // object has been free'd, no need to concretize (although as
-        // in other cases we would like to concretize the outstanding
-        // reads, but we have no facility for that yet)
-      } else {
-        assert(!os->readOnly && 
-               "not possible? read only object with static read?");
-        ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-        wos->write(CE, it->second);
+  for (unsigned i = 0, ie = state.symbolics->size();
+       i != ie && !bytes.empty(); ++i) {
+    auto found = bytes.find((*state.symbolics)[i].second);
+    if (found == bytes.end())
+      continue;
+    const MemoryObject *mo = (*state.symbolics)[i].first;
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    // Objects which have been freed, and the read only ones, are left
+    // alone.
+    if (os && !os->readOnly) {
+      ObjectState *wos = 0;
+      for (const ImpliedValueList::value_type *implied : found->second) {
+        // Only the bytes which still read as the expression the constraint
+        // is about are known to hold the value.
+        uint64_t offset =
+            cast<ConstantExpr>(implied->first->index)->getZExtValue();
+        if (offset >= os->size ||
+            *(wos ? wos : os)->read8(offset) != *implied->first)
+          continue;
+        if (!wos)
+          wos = state.addressSpace.getWriteable(mo, os);
+        wos->write8(offset, implied->second->getZExtValue(8));
       }
     }
+    bytes.erase(found);
   }
 }
 
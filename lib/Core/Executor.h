@@ -17,20 +17,29 @@
 
 #include "klee/ExecutionState.h"
 #include "klee/Interpreter.h"
+#include "klee/Solver.h"
+#include "klee/Internal/ADT/BranchPath.h"
 #include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/CompiledExpr.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "llvm/ADT/Twine.h"
 
 #include "../Expr/ArrayExprOptimizer.h"
+#include "Checkpoint.h"
+#include "ConcretizationPolicy.h"
+#include "StateSet.h"
+#include <deque>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <sys/types.h>
+#include <unordered_set>
 #include <vector>
 
 struct KTest;
@@ -52,11 +61,13 @@ namespace llvm {
 
 namespace klee {  
   class Array;
+  class Assignment;
   struct Cell;
   class ExecutionState;
   class ExternalDispatcher;
   class Expr;
   class InstructionInfoTable;
+  struct InstructionInfo;
   struct KFunction;
   struct KInstruction;
   class KInstIterator;
@@ -65,11 +76,19 @@ namespace klee {
   class MemoryObject;
   class ObjectState;
   class PTree;
+  namespace ptreelog {
+  class Writer;
+  }
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
   struct StackFrame;
   class StatsTracker;
+  class AsyncBranchQueries;
+  class FunctionSummaries;
+  class FuzzerBridge;
+  class GenerationalSearch;
+  class SubsumptionTable;
   class TimingSolver;
   class TreeStreamWriter;
   class MergeHandler;
@@ -82,6 +101,9 @@ namespace klee {
   /// removedStates, and haltExecution, among others.
 
 class Executor : public Interpreter {
+  friend class CheckpointTimer;
+  friend class FuzzerSyncTimer;
+  friend class DirectedSearcher;
   friend class RandomPathSearcher;
   friend class OwningSearcher;
   friend class WeightedRandomSearcher;
@@ -130,7 +152,7 @@ private:
   ExternalDispatcher *externalDispatcher;
   TimingSolver *solver;
   MemoryManager *memory;
-  std::set<ExecutionState*> states;
+  StateSet states;
   StatsTracker *statsTracker;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
@@ -165,6 +187,43 @@ private:
   /// scheduled again
   std::vector<ExecutionState *> continuedStates;
 
+  /// Branch conditions being evaluated in the background, or null if
+  /// branches are evaluated synchronously.
+  AsyncBranchQueries *asyncQueries;
+
+  /// Whether the solver workers solve the queries a state is likely to
+  /// issue next when another state is selected (--speculative-queries).
+  bool speculative;
+  /// The state last selected, null once it is removed.
+  ExecutionState *lastSelected;
+
+  /// Summaries of calls shared by all states, or null if calls are always
+  /// interpreted.
+  FunctionSummaries *functionSummaries;
+
+  /// The fuzzer inputs are exchanged with, or null.
+  FuzzerBridge *fuzzerBridge;
+
+  /// The join blocks the states went through, to prune the states whose
+  /// paths were explored already, or null.
+  SubsumptionTable *subsumption;
+
+  /// How the symbolic sizes and pointers of each instruction are handled.
+  ConcretizationPolicy concretizationPolicy;
+
+  /// How many of their last branch decisions the states keep, for
+  /// --search=subpath, or 0.
+  unsigned subpathLength;
+
+  struct AsyncBranchResult {
+    ref<Expr> condition;
+    bool success;
+    Solver::Validity validity;
+  };
+  /// Answers for states whose branch condition was evaluated in the
+  /// background, consumed by fork() when the branch is executed again.
+  std::map<ExecutionState *, AsyncBranchResult> asyncBranchResults;
+
   /// When non-empty the Executor is running in "seed" mode. The
   /// states in this map will be executed in an arbitrary order
   /// (outside the normal search interface) until they terminate. When
@@ -173,6 +232,46 @@ private:
   /// happens with other states (that don't satisfy the seeds) depends
   /// on as-yet-to-be-determined flags.
   std::map<ExecutionState*, std::vector<SeedInfo> > seedMap;
+
+  /// The compiled programs of the branch conditions evaluated under the
+  /// seeds, dropped once seeding is done.
+  CompiledExprCache seedPrograms;
+
+  /// The inputs of --concolic, while it runs, or null. The state following
+  /// the current input is the only one in seedMap.
+  GenerationalSearch *concolic;
+
+  /// The instructions covered before the current --concolic input.
+  std::uint64_t concolicCoverage;
+
+  /// The checkpoints states are re-created from: the one this run resumes
+  /// from, and those of swapped out states which were swapped back in.
+  std::vector<std::unique_ptr<CheckpointTree> > resumeTrees;
+
+  /// A copy of the initial state, from which swapped out states and the
+  /// seeds of the fuzzer are started. \see swapOutStates()
+  ExecutionState *swapRoot;
+
+  /// Files holding the decisions of swapped out states, oldest first.
+  std::deque<std::string> swapFiles;
+  unsigned swapFileCount;
+
+  /// The checkpoint node reached by each state which still follows the
+  /// recorded decisions. States leave the map once they pass the point
+  /// where they were checkpointed, and run normally from then on.
+  std::map<ExecutionState*, const CheckpointTree::Node*> resumeNodes;
+
+  /// The number of this process among the --seed-workers, or 0 in the main
+  /// process.
+  unsigned seedWorker;
+
+  /// In a seed worker, the decisions of the states which terminated. The
+  /// main process re-creates them too, so that it outputs their tests.
+  std::vector<DecisionHistory> seedWorkerPaths;
+
+  /// The fingerprints of the edges covered by the paths whose test cases
+  /// were output, for --dedup-test-cases.
+  std::unordered_set<std::uint64_t> emittedCoverage;
   
   /// Map of globals to their representative memory object.
   std::map<const llvm::GlobalValue*, MemoryObject*> globalObjects;
@@ -190,12 +289,24 @@ private:
   const struct KTest *replayKTest;
 
   /// When non-null a list of branch decisions to be used for replay.
-  const std::vector<bool> *replayPath;
+  const BranchPath *replayPath;
 
-  /// The index into the current \ref replayKTest or \ref replayPath
-  /// object.
+  /// When set, \ref replayPath only fixes a prefix of the branch
+  /// decisions; forks after it has been consumed proceed normally.
+  bool replayPathIsPrefix;
+
+  /// The index into the current \ref replayKTest object.
   unsigned replayPosition;
 
+  /// The next decision of \ref replayPath.
+  BranchPath::Cursor replayCursor;
+
+  /// Whether the branch decisions still come from \ref replayPath, which
+  /// stops once a prefix is used up.
+  bool isReplaying() const {
+    return replayPath && (!replayPathIsPrefix || !replayCursor.atEnd());
+  }
+
   /// When non-null a list of "seed" inputs which will be used to
   /// drive execution.
   const std::vector<struct KTest *> *usingSeeds;  
@@ -211,8 +322,13 @@ private:
   /// step.
   bool haltExecution;  
 
-  /// Whether implied-value concretization is enabled. Currently
-  /// false, it is buggy (it needs to validate its writes).
+  /// Whether the constant table has been initialized, after which the
+  /// constants of functions manifested later are evaluated right away.
+  bool constantsBound;
+
+  /// Whether implied-value concretization is enabled: the bytes of the
+  /// symbolic objects which a constraint fixes to a value are written with
+  /// it, so that later reads of them are concrete.
   bool ivcEnabled;
 
   /// The maximum time to allow for a single core solver query.
@@ -228,6 +344,15 @@ private:
   /// File to print executed instructions to
   std::unique_ptr<llvm::raw_ostream> debugInstFile;
 
+  /// The features of the terminated states, for --write-searcher-features.
+  std::unique_ptr<llvm::raw_ostream> searcherFeaturesFile;
+
+  /// Where the process trees are streamed to, for --write-ptree-log.
+  std::unique_ptr<ptreelog::Writer> ptreeLog;
+
+  /// The instructions by id, for getCoveredLines(), once it was called.
+  std::vector<const InstructionInfo *> infosById;
+
   // @brief Buffer used by logBuffer
   std::string debugBufferString;
 
@@ -252,17 +377,39 @@ private:
   MemoryObject *addExternalObject(ExecutionState &state, void *addr, 
                                   unsigned size, bool isReadOnly);
 
-  void initializeGlobalObject(ExecutionState &state, ObjectState *os, 
-			      const llvm::Constant *c,
-			      unsigned offset);
+  void initializeGlobalObject(ObjectState *os, const llvm::Constant *c,
+                              unsigned offset);
   void initializeGlobals(ExecutionState &state);
 
+  /// Returns the state the entry points \a fs start from, in the frame of
+  /// the first: argv and envp laid out in memory as far as any of them
+  /// takes them, and the globals initialized.
+  /// \param [out] arguments - The values of argc, argv and envp.
+  ExecutionState *createInitialState(const std::vector<llvm::Function *> &fs,
+                                     int argc, char **argv, char **envp,
+                                     std::vector<ref<Expr> > &arguments);
+
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
 
+  /// Carries out a call to memcpy, memmove or memset directly on the
+  /// objects involved, if its pointers are concrete and its size is in
+  /// bounds. A symbolic size is applied byte by byte with selects.
+  /// \return false if the body has to be interpreted instead.
+  bool executeMemFunction(ExecutionState &state, KInstruction *ki,
+                          llvm::Function *f,
+                          std::vector<ref<Expr> > &arguments);
+
+  /// Copies \a count bytes from \a src to \a dst, like memmove, or with
+  /// \a isSet sets them to the low byte of \a src, like memset, under the
+  /// conditions of executeMemFunction().
+  /// \return false if nothing was done as the conditions do not hold.
+  bool copyMemory(ExecutionState &state, bool isSet, ref<Expr> dst,
+                  ref<Expr> src, ref<Expr> count);
+
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
                             llvm::Function *function,
@@ -313,6 +460,33 @@ private:
                     const ObjectState *reallocFrom=0,
                     size_t allocationAlignment=0);
 
+  /// Allocate an object of symbolic size, with room for the largest value
+  /// of \a size up to --max-symbolic-alloc-size, and fail the allocation
+  /// for the larger values.
+  void executeSymbolicAlloc(ExecutionState &state, ref<Expr> size,
+                            bool isLocal, KInstruction *target,
+                            bool zeroMemory, const ObjectState *reallocFrom,
+                            size_t allocationAlignment);
+
+  /// Bind a newly allocated object, or null if the allocation failed, in
+  /// the state and its address to \a target, as executeAlloc.
+  void bindAllocation(ExecutionState &state, MemoryObject *mo, bool isLocal,
+                      KInstruction *target, bool zeroMemory,
+                      const ObjectState *reallocFrom);
+
+  /// Terminate the paths of \a state on which \a error holds with
+  /// \a message, and return the state following the other paths, or null
+  /// if there are none.
+  ExecutionState *checkOperand(ExecutionState &state, ref<Expr> error,
+                               const char *message, const char *suffix);
+
+  /// Check a divisor for zero, see checkOperand().
+  ExecutionState *checkDivisor(ExecutionState &state, ref<Expr> divisor);
+
+  /// Check a shift amount against the width of the shift, see
+  /// checkOperand().
+  ExecutionState *checkShiftAmount(ExecutionState &state, ref<Expr> shift);
+
   /// Free the given address with checking for errors. If target is
   /// given it will be bound to 0 in the resulting states (this is a
   /// convenience for realloc). Note that this function can cause the
@@ -335,6 +509,23 @@ private:
                               ref<Expr> value /* undef if read */,
                               KInstruction *target /* undef if write */);
 
+  /// Carries out the memory operation through \a address on all the
+  /// objects it may point to at once: a read is a choice over the reads of
+  /// the objects, and a write writes each object where the pointer points
+  /// into it. The state is forked only for an out of bound pointer.
+  /// \return false if \a address may point to one object only, to more
+  /// than ConcretizationPolicy::getMergeBound() or to a read-only object.
+  bool executeMergedMemoryOperation(ExecutionState &state, bool isWrite,
+                                    ref<Expr> address, ref<Expr> value,
+                                    KInstruction *target);
+
+  /// With --lazy-init, forks \a state on what the symbolic pointer in
+  /// \a address, read from the symbolic inputs and not bound yet, points
+  /// to, and carries out the memory operation in each state.
+  /// \return false if \a address is not such a pointer.
+  bool lazyInitialize(ExecutionState &state, bool isWrite, ref<Expr> address,
+                      ref<Expr> value, KInstruction *target);
+
   void executeMakeSymbolic(ExecutionState &state, const MemoryObject *mo,
                            const std::string &name);
 
@@ -367,12 +558,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().locals.mutate()[kf->getArgRegister(index)];
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().mutateLocals(target)[target->dest];
   }
 
   void bindLocal(KInstruction *target, 
@@ -383,6 +574,17 @@ private:
                     ExecutionState &state,
                     ref<Expr> value);
 
+  /// Binds the result of the integer binary operator \a target if both
+  /// operands are constant, without building an expression for it.
+  /// \return false if the result has to be built as an expression.
+  bool bindConstantBinary(KInstruction *target, ExecutionState &state,
+                          const ref<Expr> &left, const ref<Expr> &right);
+
+  /// Binds the address computed by \a kgepi if the base and all indices
+  /// are constant, without intermediate expressions.
+  bool bindConstantGEP(KGEPInstruction *kgepi, ExecutionState &state,
+                       const ref<Expr> &base);
+
   /// Evaluates an LLVM constant expression.  The optional argument ki
   /// is the instruction where this constant was encountered, or NULL
   /// if not applicable/unavailable.
@@ -400,6 +602,12 @@ private:
   /// value). Otherwise return the original expression.
   ref<Expr> toUnique(const ExecutionState &state, ref<Expr> &e);
 
+  /// Finds one model of the constraints of \a state for the arrays \a exprs
+  /// read, to concretize them together rather than one query each.
+  /// Returns false if the query timed out.
+  bool getModel(const ExecutionState &state,
+                const std::vector<ref<Expr> > &exprs, Assignment &model);
+
   /// Return a constant value for the given expression, forcing it to
   /// be constant in the given state by adding a constraint if
   /// necessary. Note that this function breaks completeness and
@@ -423,6 +631,31 @@ private:
 
   bool shouldExitOn(enum TerminateReason termReason);
 
+  /// Starts evaluating the condition of the branch \a state is at in the
+  /// background and pauses the state. Returns false if the branch has to
+  /// be executed right away.
+  bool deferBranch(ExecutionState &state, ref<Expr> condition);
+
+  /// Adds the pending condition of a lazy fork to the constraints of the
+  /// state if it is feasible. Otherwise the state is terminated and false
+  /// is returned.
+  bool checkLazyFork(ExecutionState &state);
+
+  /// Terminates the state if --drop-duplicate-states finds it a duplicate
+  /// or --prune-subsumed-states finds its paths from here explored
+  /// already, and returns whether it did.
+  bool isSubsumed(ExecutionState &state);
+
+  /// Resumes the states whose background query finished, waiting for at
+  /// least one if \a block is set, or for all of them in the order they
+  /// were started with --deterministic-async-queries.
+  void resumeAsyncStates(bool block);
+
+  /// Starts the query \a state will issue at its next instruction as a
+  /// speculative one: the validity of the condition of a symbolic branch,
+  /// or the initial values for the test case of a returning entry point.
+  void speculateQueries(ExecutionState &state);
+
   // remove state from searcher only
   void pauseState(ExecutionState& state);
   // add state to searcher only
@@ -433,6 +666,13 @@ private:
   void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
   // call exit handler and terminate state
   void terminateStateOnExit(ExecutionState &state);
+  // whether --dedup-test-cases drops the test case of a terminating state,
+  // as an earlier one covered the same edges
+  bool isDuplicateTestCase(const ExecutionState &state);
+  // add to the constraints of state that the bytes [begin, end) of array
+  // are zero where they allow it, returning false if the solver failed
+  bool preferZeros(ExecutionState &state, const Array *array, unsigned begin,
+                   unsigned end);
   // call error handler and terminate state
   void terminateStateOnError(ExecutionState &state, const llvm::Twine &message,
                              enum TerminateReason termReason,
@@ -451,6 +691,10 @@ private:
   /// bindModuleConstants - Initialize the module constant table.
   void bindModuleConstants();
 
+  /// Return the KFunction of the defined function \a f, manifesting it
+  /// if only called now.
+  KFunction *getKFunction(llvm::Function *f);
+
   template <typename TypeIt>
   void computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie);
 
@@ -478,6 +722,84 @@ private:
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
+  /// Return the checkpoint node \a state follows, or null.
+  const CheckpointTree::Node *getResumeNode(ExecutionState &state) const {
+    auto it = resumeNodes.find(&state);
+    return it == resumeNodes.end() ? 0 : it->second;
+  }
+
+  /// Record that \a state took \a decision, and continue following the
+  /// checkpoint from \a node if it is non-null and has children.
+  void recordDecision(ExecutionState &state, unsigned decision,
+                      const CheckpointTree::Node *node);
+
+  /// Write the decisions of all live states to the checkpoint file.
+  void writeCheckpoint();
+
+  /// Terminate up to \a maxKill of \a candidates, those holding the most
+  /// memory no other state shares first, until about \a excess bytes are
+  /// freed.
+  void killExclusiveStates(std::vector<ExecutionState *> &candidates,
+                           unsigned maxKill, uint64_t excess);
+
+  /// Move the \a count least recently scheduled states out of memory by
+  /// writing their decisions to a file in the output directory.
+  ///
+  /// \return True if states were swapped out.
+  bool swapOutStates(unsigned count);
+
+  /// Re-create the states of the oldest swap file by following their
+  /// decisions from a copy of the initial state.
+  ///
+  /// \return True if a state was added.
+  bool swapInStates();
+
+  /// A new state at the start of the program, added to the states.
+  ExecutionState *copyInitialState();
+
+  /// Import the new inputs of the fuzzer as seeds of \a initialState, or
+  /// of new states from the start of the program.
+  void syncFuzzer(ExecutionState *initialState = nullptr);
+
+  /// Give the fuzzer the input of a test case output for \a state, if it
+  /// covers new edges.
+  void exportTestCase(const ExecutionState &state);
+
+  /// Fork the --seed-workers, each keeping its share of \a seeds. The main
+  /// process keeps none.
+  ///
+  /// \return The pids of the workers in the main process, and nothing in
+  /// the workers or if seeding stays in this process.
+  std::vector<pid_t> forkSeedWorkers(std::vector<SeedInfo> &seeds);
+
+  /// In a seed worker, write the decisions of its live and terminated
+  /// states for the main process, and exit.
+  void finishSeedWorker();
+
+  /// Wait for \a workers, then make \a initialState re-create their states
+  /// by following their decisions.
+  void joinSeedWorkers(const std::vector<pid_t> &workers,
+                       ExecutionState &initialState);
+
+  /// Execute the seeds and the inputs generated from them one at a time,
+  /// starting each from a copy of \a initialState, for --concolic.
+  void runConcolic(ExecutionState &initialState);
+
+  /// Generate the inputs of the next generation from the path of \a state,
+  /// following the current --concolic input to its end.
+  void expandConcolicPath(const ExecutionState &state);
+
+  /// Whether \a state, about to execute \a ki, can no longer reach a
+  /// --target it did not reach yet.
+  bool cannotReachTarget(ExecutionState &state, KInstruction *ki);
+
+  /// Whether no uncovered instruction is reachable from \a ki, the next
+  /// instruction of \a state, for --prune-covered-states.
+  bool cannotReachUncovered(ExecutionState &state, KInstruction *ki);
+
+  /// Remove \a state from execution without counting it as explored.
+  void removeState(ExecutionState &state);
+
 public:
   Executor(llvm::LLVMContext &ctx, const InterpreterOptions &opts,
       InterpreterHandler *ie);
@@ -499,10 +821,12 @@ public:
     replayPosition = 0;
   }
 
-  void setReplayPath(const std::vector<bool> *path) override {
+  void setReplayPath(const BranchPath *path,
+                     bool asPrefix = false) override {
     assert(!replayKTest && "cannot replay both buffer and path");
     replayPath = path;
-    replayPosition = 0;
+    replayPathIsPrefix = asPrefix;
+    replayCursor = path ? BranchPath::Cursor(*path) : BranchPath::Cursor();
   }
 
   llvm::Module *setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
@@ -515,6 +839,9 @@ public:
   void runFunctionAsMain(llvm::Function *f, int argc, char **argv,
                          char **envp) override;
 
+  void runFunctionsAsMain(const std::vector<llvm::Function *> &fs, int argc,
+                          char **argv, char **envp) override;
+
   /*** Runtime options ***/
 
   void setHaltExecution(bool value) override { haltExecution = value; }
@@ -24,14 +24,14 @@ public:
 
   /// Approximate delay per timer firing.
   time::Span rate;
-  /// Wall time for next firing.
+  /// Coarse wall time for next firing.
   time::Point nextFireTime;
 
 public:
   TimerInfo(Timer *_timer, time::Span _rate)
     : timer(_timer),
       rate(_rate),
-      nextFireTime(time::getWallTime() + rate) {}
+      nextFireTime(time::getCoarseTime() + rate) {}
   ~TimerInfo() { delete timer; }
 };
 
@@ -10,6 +10,7 @@
 #include "CoreStats.h"
 #include "Executor.h"
 #include "ExecutorTimerInfo.h"
+#include "FuzzerBridge.h"
 #include "PTree.h"
 #include "StatsTracker.h"
 
@@ -18,17 +19,19 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/OptionCategories.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <atomic>
+#include <chrono>
 #include <math.h>
-#include <signal.h>
+#include <pthread.h>
 #include <string>
-#include <sys/time.h>
-#include <unistd.h>
+#include <thread>
 
 using namespace llvm;
 using namespace klee;
@@ -40,6 +43,12 @@ cl::opt<std::string>
                      "Set to 0s to disable (default=0s)"),
             cl::init("0s"),
             cl::cat(TerminationCat));
+
+cl::opt<std::string> CheckpointInterval(
+    "checkpoint-interval",
+    cl::desc("With --checkpoint, also write the checkpoint periodically at "
+             "this interval.  Set to 0s to disable (default=0s)"),
+    cl::init("0s"), cl::cat(TerminationCat));
 }
 
 ///
@@ -59,25 +68,56 @@ public:
 
 ///
 
+namespace klee {
+class CheckpointTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  CheckpointTimer(Executor *_executor) : executor(_executor) {}
+  ~CheckpointTimer() {}
+
+  void run() { executor->writeCheckpoint(); }
+};
+
+class FuzzerSyncTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  FuzzerSyncTimer(Executor *_executor) : executor(_executor) {}
+  ~FuzzerSyncTimer() {}
+
+  void run() { executor->syncFuzzer(); }
+};
+}
+
+///
+
 static const time::Span kMilliSecondsPerTick(time::milliseconds(100));
-static volatile unsigned timerTicks = 0;
+/// Counts the ticks since the timers were last processed, which is all the
+/// interpreter loop reads between them.
+static std::atomic<unsigned> timerTicks(0);
 
 // XXX hack
 extern "C" unsigned dumpStates, dumpPTree;
 unsigned dumpStates = 0, dumpPTree = 0;
 
-static void onAlarm(int) {
-  ++timerTicks;
+// A thread takes the ticks rather than SIGALRM, which the external calls
+// and the solvers may reset or be interrupted by. It is restarted in the
+// processes forked off, which inherit no threads.
+static void startTicker() {
+  std::thread([] {
+    const auto tick =
+        std::chrono::microseconds(kMilliSecondsPerTick.toMicroseconds());
+    while (true) {
+      std::this_thread::sleep_for(tick);
+      timerTicks.fetch_add(1, std::memory_order_relaxed);
+    }
+  }).detach();
 }
 
-// oooogalay
-static void setupHandler() {
-  itimerval t{};
-  timeval tv = static_cast<timeval>(kMilliSecondsPerTick);
-  t.it_interval = t.it_value = tv;
-
-  ::setitimer(ITIMER_REAL, &t, nullptr);
-  ::signal(SIGALRM, onAlarm);
+static void setupTicker() {
+  startTicker();
+  ::pthread_atfork(nullptr, nullptr, startTicker);
 }
 
 void Executor::initTimers() {
@@ -85,13 +125,25 @@ void Executor::initTimers() {
 
   if (first) {
     first = false;
-    setupHandler();
+    setupTicker();
   }
 
+  // the timers of an earlier run keep running across entry points
+  if (!timers.empty())
+    return;
+
   const time::Span maxTime(MaxTime);
   if (maxTime) {
     addTimer(new HaltTimer(this), maxTime);
   }
+
+  const time::Span checkpointInterval(CheckpointInterval);
+  if (checkpointInterval) {
+    addTimer(new CheckpointTimer(this), checkpointInterval);
+  }
+
+  if (fuzzerBridge)
+    addTimer(new FuzzerSyncTimer(this), FuzzerBridge::getSyncInterval());
 }
 
 ///
@@ -106,96 +158,97 @@ void Executor::addTimer(Timer *timer, time::Span rate) {
 
 void Executor::processTimers(ExecutionState *current,
                              time::Span maxInstTime) {
-  static unsigned callsWithoutCheck = 0;
-  unsigned ticks = timerTicks;
+  if (!timerTicks.load(std::memory_order_relaxed))
+    return;
+  unsigned ticks = timerTicks.exchange(0, std::memory_order_relaxed);
+
+  if (dumpPTree) {
+    char name[32];
+    sprintf(name, "ptree%08d.dot", (int) stats::instructions);
+    auto os = interpreterHandler->openOutputFile(name);
+    if (os) {
+      processTree->dump(*os);
+    }
 
-  if (!ticks && ++callsWithoutCheck > 1000) {
-    setupHandler();
-    ticks = 1;
+    dumpPTree = 0;
   }
 
-  if (ticks || dumpPTree || dumpStates) {
-    if (dumpPTree) {
-      char name[32];
-      sprintf(name, "ptree%08d.dot", (int) stats::instructions);
-      auto os = interpreterHandler->openOutputFile(name);
-      if (os) {
-        processTree->dump(*os);
-      }
-
-      dumpPTree = 0;
-    }
-
-    if (dumpStates) {
-      auto os = interpreterHandler->openOutputFile("states.txt");
-
-      if (os) {
-        for (ExecutionState *es : states) {
-          *os << "(" << es << ",";
-          *os << "[";
-          auto next = es->stack.begin();
-          ++next;
-          for (auto sfIt = es->stack.begin(), sf_ie = es->stack.end();
-               sfIt != sf_ie; ++sfIt) {
-            *os << "('" << sfIt->kf->function->getName().str() << "',";
-            if (next == es->stack.end()) {
-              *os << es->prevPC->info->line << "), ";
-            } else {
-              *os << next->caller->info->line << "), ";
-              ++next;
-            }
+  if (dumpStates) {
+    auto os = interpreterHandler->openOutputFile("states.txt");
+
+    if (os) {
+      for (ExecutionState *es : states) {
+        *os << "(" << es << ",";
+        *os << "[";
+        auto next = es->stack.begin();
+        ++next;
+        for (auto sfIt = es->stack.begin(), sf_ie = es->stack.end();
+             sfIt != sf_ie; ++sfIt) {
+          *os << "('" << sfIt->kf->function->getName().str() << "',";
+          if (next == es->stack.end()) {
+            *os << es->prevPC->info->line << "), ";
+          } else {
+            *os << next->caller->info->line << "), ";
+            ++next;
           }
-          *os << "], ";
-
-          StackFrame &sf = es->stack.back();
-          uint64_t md2u = computeMinDistToUncovered(es->pc,
-                                                    sf.minDistToUncoveredOnReturn);
-          uint64_t icnt = theStatisticManager->getIndexedValue(stats::instructions,
-                                                               es->pc->info->id);
-          uint64_t cpicnt = sf.callPathNode->statistics.getValue(stats::instructions);
-
-          *os << "{";
-          *os << "'depth' : " << es->depth << ", ";
-          *os << "'weight' : " << es->weight << ", ";
-          *os << "'queryCost' : " << es->queryCost << ", ";
-          *os << "'coveredNew' : " << es->coveredNew << ", ";
-          *os << "'instsSinceCovNew' : " << es->instsSinceCovNew << ", ";
-          *os << "'md2u' : " << md2u << ", ";
-          *os << "'icnt' : " << icnt << ", ";
-          *os << "'CPicnt' : " << cpicnt << ", ";
-          *os << "}";
-          *os << ")\n";
         }
+        *os << "], ";
+
+        StackFrame &sf = es->stack.back();
+        uint64_t md2u = computeMinDistToUncovered(es->pc,
+                                                  sf.minDistToUncoveredOnReturn);
+        uint64_t icnt = theStatisticManager->getIndexedValue(stats::instructions,
+                                                             es->pc->info->id);
+        uint64_t cpicnt = sf.callPathNode->statistics.getValue(stats::instructions);
+
+        *os << "{";
+        *os << "'depth' : " << es->depth << ", ";
+        *os << "'weight' : " << es->weight << ", ";
+        *os << "'queryCost' : " << es->queryCost << ", ";
+        *os << "'coveredNew' : " << es->coveredNew << ", ";
+        *os << "'instsSinceCovNew' : " << es->instsSinceCovNew << ", ";
+        *os << "'md2u' : " << md2u << ", ";
+        *os << "'icnt' : " << icnt << ", ";
+        *os << "'CPicnt' : " << cpicnt << ", ";
+        *os << "}";
+        *os << ")\n";
       }
-
-      dumpStates = 0;
     }
 
-    if (maxInstTime && current &&
-        std::find(removedStates.begin(), removedStates.end(), current) ==
-            removedStates.end()) {
-      if (timerTicks * kMilliSecondsPerTick > maxInstTime) {
-        klee_warning("max-instruction-time exceeded: %.2fs", (timerTicks * kMilliSecondsPerTick).toSeconds());
-        terminateStateEarly(*current, "max-instruction-time exceeded");
-      }
-    }
+    dumpStates = 0;
+  }
 
-    if (!timers.empty()) {
-      auto time = time::getWallTime();
+#ifdef ENABLE_KLEE_TRACING
+  if (trace::takeWriteRequest()) {
+    std::string error;
+    if (!trace::write(interpreterHandler->getOutputFilename("trace.json"),
+                      error))
+      klee_warning("unable to write the trace: %s", error.c_str());
+  }
+#endif
+
+  if (maxInstTime && current &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+          removedStates.end()) {
+    if (ticks * kMilliSecondsPerTick > maxInstTime) {
+      klee_warning("max-instruction-time exceeded: %.2fs", (ticks * kMilliSecondsPerTick).toSeconds());
+      terminateStateEarly(*current, "max-instruction-time exceeded");
+    }
+  }
 
-      for (std::vector<TimerInfo*>::iterator it = timers.begin(), 
-             ie = timers.end(); it != ie; ++it) {
-        TimerInfo *ti = *it;
-        
-        if (time >= ti->nextFireTime) {
-          ti->timer->run();
-          ti->nextFireTime = time + ti->rate;
-        }
+  if (!timers.empty()) {
+    // read after every instruction, the timers only need milliseconds
+    auto time = time::getCoarseTime();
+
+    for (std::vector<TimerInfo*>::iterator it = timers.begin(), 
+           ie = timers.end(); it != ie; ++it) {
+      TimerInfo *ti = *it;
+      
+      if (time >= ti->nextFireTime) {
+        ti->timer->run();
+        ti->nextFireTime = time + ti->rate;
       }
     }
-
-    timerTicks = 0;
-    callsWithoutCheck = 0;
   }
 }
 
@@ -9,6 +9,7 @@
 
 #include "ExternalDispatcher.h"
 #include "klee/Config/Version.h"
+#include "klee/Internal/Support/ErrorHandling.h"
 
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
@@ -20,11 +21,26 @@
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Errno.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
 
+#include <cerrno>
 #include <csetjmp>
 #include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 
 using namespace llvm;
 using namespace klee;
@@ -40,25 +56,92 @@ static void sigsegv_handler(int signal, siginfo_t *info, void *context) {
 }
 }
 
+namespace {
+/// Where KLEE hands an external call over to the process running it, and
+/// gets its result back. The arguments are the words the dispatcher stubs
+/// read, with the return value in the first two.
+struct CallMailbox {
+  sem_t request, response;
+  llvm::Function *function;
+  llvm::Instruction *inst;
+  int lastErrno;
+  bool success;
+  unsigned numWords;
+  uint64_t args[1];
+};
+
+const size_t MailboxSize = 64 * 1024;
+const unsigned MaxCallWords =
+    (MailboxSize - offsetof(CallMailbox, args)) / sizeof(uint64_t);
+
+void waitFor(sem_t *s) {
+  while (sem_wait(s) && errno == EINTR)
+    ;
+}
+}
+
 namespace klee {
 
 class ExternalDispatcherImpl {
 private:
-  typedef std::map<const llvm::Instruction *, llvm::Function *> dispatchers_ty;
+  /// The stub to call a function with, and the address of the function.
+  struct Dispatcher {
+    llvm::Function *stub;
+    void *target;
+  };
+  typedef std::map<std::pair<const llvm::Instruction *, const llvm::Function *>,
+                   Dispatcher>
+      dispatchers_ty;
   dispatchers_ty dispatchers;
-  llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i,
+
+  /// The stubs by the declared type of the callee and the type of the
+  /// arguments of the call, with the function each was created for. Stubs
+  /// call the function stored in gTheTarget, so one serves every function of
+  /// the same signature and attributes.
+  typedef std::pair<llvm::FunctionType *, llvm::FunctionType *> signature_ty;
+  std::map<signature_ty,
+           std::vector<std::pair<llvm::Function *, llvm::Function *> > >
+      stubs;
+
+  Dispatcher getDispatcher(llvm::Function *f, llvm::Instruction *i);
+  llvm::Function *createDispatcher(llvm::Function *target,
+                                   const std::vector<llvm::Type *> &argTypes,
                                    llvm::Module *module);
+  void *resolveTarget(llvm::Function *f);
   llvm::ExecutionEngine *executionEngine;
   LLVMContext &ctx;
   std::map<std::string, void *> preboundFunctions;
-  bool runProtectedCall(llvm::Function *f, uint64_t *args);
+  bool runProtectedCall(const Dispatcher &d, uint64_t *args);
   llvm::Module *singleDispatchModule;
   std::vector<std::string> moduleIDs;
   std::string &getFreshModuleID();
   int lastErrno;
 
+  /// Runs the calls in a process forked at the first call, which thus knows
+  /// the module, and shares the memory of the objects with KLEE through the
+  /// mapping of the MemoryManager.
+  bool separateProcess;
+  time::Span timeout;
+  CallMailbox *mailbox;
+  /// The process running the calls, or 0 if it is not started.
+  pid_t helper;
+  /// The number of argument words of a call, or 0 if the callee is unknown.
+  std::map<std::pair<const llvm::Instruction *, const llvm::Function *>,
+           unsigned>
+      callWords;
+
+  bool executeCallHere(llvm::Function *f, llvm::Instruction *i,
+                       uint64_t *args);
+  bool executeCallInHelper(llvm::Function *f, llvm::Instruction *i,
+                           uint64_t *args);
+  bool startHelper();
+  /// Kills the helper unless it is already reaped, ready for a new one.
+  void stopHelper(bool reaped);
+  [[noreturn]] void runHelper();
+
 public:
-  ExternalDispatcherImpl(llvm::LLVMContext &ctx);
+  ExternalDispatcherImpl(llvm::LLVMContext &ctx, bool separateProcess,
+                         time::Span timeout);
   ~ExternalDispatcherImpl();
   bool executeCall(llvm::Function *function, llvm::Instruction *i,
                    uint64_t *args);
@@ -107,8 +190,11 @@ void *ExternalDispatcherImpl::resolveSymbol(const std::string &name) {
   return addr;
 }
 
-ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
-    : ctx(ctx), lastErrno(0) {
+ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx,
+                                               bool separateProcess,
+                                               time::Span timeout)
+    : ctx(ctx), lastErrno(0), separateProcess(separateProcess),
+      timeout(timeout), mailbox(nullptr), helper(0) {
   std::string error;
   singleDispatchModule = new Module(getFreshModuleID(), ctx);
   // The MCJIT JITs whole modules at a time rather than individual functions
@@ -139,6 +225,16 @@ ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
     sys::DynamicLibrary::LoadLibraryPermanently(0);
   }
 
+  if (separateProcess) {
+    void *m = mmap(nullptr, MailboxSize, PROT_READ | PROT_WRITE,
+                   MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+    if (m == MAP_FAILED)
+      klee_error("Couldn't mmap() memory for the external call process");
+    mailbox = static_cast<CallMailbox *>(m);
+    sem_init(&mailbox->request, 1, 0);
+    sem_init(&mailbox->response, 1, 0);
+  }
+
 #ifdef WINDOWS
   preboundFunctions["getpid"] = (void *)(long)getpid;
   preboundFunctions["putchar"] = (void *)(long)putchar;
@@ -149,6 +245,12 @@ ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
 }
 
 ExternalDispatcherImpl::~ExternalDispatcherImpl() {
+  if (mailbox) {
+    stopHelper(false);
+    sem_destroy(&mailbox->request);
+    sem_destroy(&mailbox->response);
+    munmap(mailbox, MailboxSize);
+  }
   delete executionEngine;
   // NOTE: the `executionEngine` owns all modules so
   // we don't need to delete any of them.
@@ -156,68 +258,247 @@ ExternalDispatcherImpl::~ExternalDispatcherImpl() {
 
 bool ExternalDispatcherImpl::executeCall(Function *f, Instruction *i,
                                          uint64_t *args) {
-  dispatchers_ty::iterator it = dispatchers.find(i);
-  if (it != dispatchers.end()) {
-    // Code already JIT'ed for this
-    return runProtectedCall(it->second, args);
+  if (separateProcess)
+    return executeCallInHelper(f, i, args);
+  return executeCallHere(f, i, args);
+}
+
+bool ExternalDispatcherImpl::executeCallHere(Function *f, Instruction *i,
+                                             uint64_t *args) {
+  dispatchers_ty::iterator it = dispatchers.find(std::make_pair(i, f));
+  if (it == dispatchers.end()) {
+    // Code for this not JIT'ed, or not looked up for this call site yet.
+    it = dispatchers
+             .insert(std::make_pair(std::make_pair(i, f), getDispatcher(f, i)))
+             .first;
   }
+  return runProtectedCall(it->second, args);
+}
 
-  // Code for this not JIT'ed. Do this now.
-  Function *dispatcher;
+void *ExternalDispatcherImpl::resolveTarget(Function *f) {
 #ifdef WINDOWS
-  std::map<std::string, void *>::iterator it2 =
+  std::map<std::string, void *>::iterator it =
       preboundFunctions.find(f->getName());
+  if (it != preboundFunctions.end())
+    return it->second;
+#endif
+  return resolveSymbol(f->getName());
+}
+
+/// Returns the types the arguments of the call \a i to \a f are passed as.
+/// This accommodates for the corresponding code in Executor.cpp for handling
+/// calls to bitcasted functions.
+static std::vector<Type *> getArgumentTypes(Function *f, Instruction *i) {
+  CallSite cs;
+  if (i->getOpcode() == Instruction::Call) {
+    cs = CallSite(cast<CallInst>(i));
+  } else {
+    cs = CallSite(cast<InvokeInst>(i));
+  }
+
+  FunctionType *FTy =
+      cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
+  std::vector<Type *> argTypes;
+  unsigned n = 0;
+  for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end(); ai != ae;
+       ++ai, ++n)
+    argTypes.push_back(n < FTy->getNumParams() ? FTy->getParamType(n)
+                                               : (*ai)->getType());
+  return argTypes;
+}
 
-  if (it2 != preboundFunctions.end()) {
-    // only bind once
-    if (it2->second) {
-      executionEngine->addGlobalMapping(f, it2->second);
-      it2->second = 0;
+/// Returns the index of the argument words after the arguments of the given
+/// types, which follow the two words of the return value.
+static unsigned countArgumentWords(const std::vector<Type *> &argTypes) {
+  unsigned idx = 2;
+  for (Type *argTy : argTypes) {
+    unsigned argSize = argTy->getPrimitiveSizeInBits();
+    idx += ((!!argSize ? argSize : 64) + 63) / 64;
+  }
+  return idx;
+}
+
+ExternalDispatcherImpl::Dispatcher
+ExternalDispatcherImpl::getDispatcher(Function *f, Instruction *i) {
+  Dispatcher d = {nullptr, resolveTarget(f)};
+  if (!d.target)
+    return d;
+
+  // Get the target function type.
+  FunctionType *FTy =
+      cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
+  std::vector<Type *> argTypes = getArgumentTypes(f, i);
+
+  // Reuse the stub of a function with the same signature and attributes,
+  // as calls to printf from different places, with the same arguments, are.
+  signature_ty signature(
+      FTy, FunctionType::get(FTy->getReturnType(), argTypes, false));
+  auto &candidates = stubs[signature];
+  for (auto &c : candidates) {
+    if (c.first->getAttributes() == f->getAttributes()) {
+      d.stub = c.second;
+      return d;
     }
   }
-#endif
 
-  Module *dispatchModule = NULL;
-  // The MCJIT generates whole modules at a time so for every call that we
-  // haven't made before we need to create a new Module.
-  dispatchModule = new Module(getFreshModuleID(), ctx);
-  dispatcher = createDispatcher(f, i, dispatchModule);
-  dispatchers.insert(std::make_pair(i, dispatcher));
+  // The MCJIT generates whole modules at a time so for every signature that
+  // we haven't called before we need to create a new Module.
+  Module *dispatchModule = new Module(getFreshModuleID(), ctx);
+  d.stub = createDispatcher(f, argTypes, dispatchModule);
+  candidates.push_back(std::make_pair(f, d.stub));
 
   // Force the JIT execution engine to go ahead and build the function. This
   // ensures that any errors or assertions in the compilation process will
   // trigger crashes instead of being caught as aborts in the external
   // function.
-  if (dispatcher) {
-    // The dispatchModule is now ready so tell MCJIT to generate the code for
-    // it.
-    auto dispatchModuleUniq = std::unique_ptr<Module>(dispatchModule);
-    executionEngine->addModule(
-        std::move(dispatchModuleUniq)); // MCJIT takes ownership
-    // Force code generation
-    uint64_t fnAddr =
-        executionEngine->getFunctionAddress(dispatcher->getName());
-    executionEngine->finalizeObject();
-    assert(fnAddr && "failed to get function address");
-    (void)fnAddr;
-  } else {
-    // MCJIT didn't take ownership of the module so delete it.
-    delete dispatchModule;
+  auto dispatchModuleUniq = std::unique_ptr<Module>(dispatchModule);
+  executionEngine->addModule(
+      std::move(dispatchModuleUniq)); // MCJIT takes ownership
+  // Force code generation
+  uint64_t fnAddr = executionEngine->getFunctionAddress(d.stub->getName());
+  executionEngine->finalizeObject();
+  assert(fnAddr && "failed to get function address");
+  (void)fnAddr;
+  return d;
+}
+
+bool ExternalDispatcherImpl::executeCallInHelper(Function *f, Instruction *i,
+                                                 uint64_t *args) {
+  auto key = std::make_pair(i, f);
+  auto it = callWords.find(key);
+  if (it == callWords.end()) {
+    // Unknown functions fail here, as they would in the helper.
+    unsigned words =
+        resolveTarget(f) ? countArgumentWords(getArgumentTypes(f, i)) : 0;
+    if (words > MaxCallWords) {
+      klee_warning("too many arguments for the external call process: %s",
+                   f->getName().str().c_str());
+      words = 0;
+    }
+    it = callWords.insert(std::make_pair(key, words)).first;
+  }
+  unsigned words = it->second;
+  if (!words || (!helper && !startHelper()))
+    return false;
+
+  CallMailbox &m = *mailbox;
+  m.function = f;
+  m.inst = i;
+  m.lastErrno = lastErrno;
+  m.numWords = words;
+  memcpy(m.args, args, words * sizeof(uint64_t));
+  sem_post(&m.request);
+
+  // Poll for the answer, so that a crashed or stuck helper is noticed.
+  time::Point deadline = time::getWallTime() + timeout;
+  for (;;) {
+    struct timespec slice;
+    clock_gettime(CLOCK_REALTIME, &slice);
+    slice.tv_nsec += 100 * 1000 * 1000;
+    if (slice.tv_nsec >= 1000 * 1000 * 1000) {
+      slice.tv_nsec -= 1000 * 1000 * 1000;
+      ++slice.tv_sec;
+    }
+    if (!sem_timedwait(&m.response, &slice))
+      break;
+    if (errno == EINTR)
+      continue;
+    if (timeout && time::getWallTime() >= deadline) {
+      klee_warning("external call to %s timed out",
+                   f->getName().str().c_str());
+      stopHelper(false);
+      return false;
+    }
+    int status;
+    if (waitpid(helper, &status, WNOHANG) == helper) {
+      klee_warning("external call process died in a call to %s",
+                   f->getName().str().c_str());
+      stopHelper(true);
+      return false;
+    }
+  }
+
+  if (!m.success) {
+    // The call crashed, the helper exits rather than carry on damaged.
+    stopHelper(false);
+    return false;
+  }
+  lastErrno = m.lastErrno;
+  memcpy(args, m.args, 2 * sizeof(uint64_t));
+  return true;
+}
+
+bool ExternalDispatcherImpl::startHelper() {
+  fflush(stdout);
+  fflush(stderr);
+  pid_t parent = getpid();
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for the external call process) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  if (pid == 0) {
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    if (getppid() != parent)
+      _exit(1);
+    runHelper();
+  }
+  helper = pid;
+  return true;
+}
+
+void ExternalDispatcherImpl::stopHelper(bool reaped) {
+  if (!helper)
+    return;
+  if (!reaped) {
+    int status;
+    kill(helper, SIGKILL);
+    while (waitpid(helper, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+  helper = 0;
+  // a dead helper may have left either semaphore posted
+  sem_destroy(&mailbox->request);
+  sem_destroy(&mailbox->response);
+  sem_init(&mailbox->request, 1, 0);
+  sem_init(&mailbox->response, 1, 0);
+}
+
+void ExternalDispatcherImpl::runHelper() {
+  // KLEE decides when to stop
+  signal(SIGINT, SIG_IGN);
+  separateProcess = false;
+  CallMailbox &m = *mailbox;
+  for (;;) {
+    waitFor(&m.request);
+    lastErrno = m.lastErrno;
+    m.success = executeCallHere(m.function, m.inst, m.args);
+    m.lastErrno = lastErrno;
+    // keep the output of the calls in order with that of KLEE
+    fflush(stdout);
+    sem_post(&m.response);
+    if (!m.success)
+      _exit(1);
   }
-  return runProtectedCall(dispatcher, args);
 }
 
 // FIXME: This is not reentrant.
 static uint64_t *gTheArgsP;
-bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
+static void *gTheTarget;
+bool ExternalDispatcherImpl::runProtectedCall(const Dispatcher &d,
+                                              uint64_t *args) {
   struct sigaction segvAction, segvActionOld;
   bool res;
 
-  if (!f)
+  if (!d.stub)
     return false;
 
   std::vector<GenericValue> gvArgs;
   gTheArgsP = args;
+  gTheTarget = d.target;
 
   segvAction.sa_handler = nullptr;
   sigemptyset(&(segvAction.sa_mask));
@@ -230,7 +511,7 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
     res = false;
   } else {
     errno = lastErrno;
-    executionEngine->runFunction(f, gvArgs);
+    executionEngine->runFunction(d.stub, gvArgs);
     // Explicitly acquire errno information
     lastErrno = errno;
     res = true;
@@ -250,28 +531,22 @@ bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
 // the special cases that the JIT knows how to directly call. If this is not
 // done, then the jit will end up generating a nullary stub just to call our
 // stub, for every single function call.
-Function *ExternalDispatcherImpl::createDispatcher(Function *target,
-                                                   Instruction *inst,
-                                                   Module *module) {
-  if (!resolveSymbol(target->getName()))
-    return 0;
-
-  CallSite cs;
-  if (inst->getOpcode() == Instruction::Call) {
-    cs = CallSite(cast<CallInst>(inst));
-  } else {
-    cs = CallSite(cast<InvokeInst>(inst));
-  }
-
-  Value **args = new Value *[cs.arg_size()];
+//
+// The function to call is passed the same way, through gTheTarget, so that
+// the stub only depends on the signature of the call and can be shared by all
+// functions with it.
+Function *
+ExternalDispatcherImpl::createDispatcher(Function *target,
+                                         const std::vector<Type *> &argTypes,
+                                         Module *module) {
+  Value **args = new Value *[argTypes.size()];
 
   std::vector<Type *> nullary;
 
   // MCJIT functions need unique names, or wrong function can be called.
   // The module identifier is included because for the MCJIT we need
   // unique function names across all `llvm::Modules`s.
-  std::string fnName =
-      "dispatcher_" + target->getName().str() + module->getModuleIdentifier();
+  std::string fnName = "dispatcher_" + module->getModuleIdentifier();
   Function *dispatcher =
       Function::Create(FunctionType::get(Type::getVoidTy(ctx), nullary, false),
                        GlobalVariable::ExternalLinkage, fnName, module);
@@ -290,30 +565,31 @@ Function *ExternalDispatcherImpl::createDispatcher(Function *target,
   FunctionType *FTy = cast<FunctionType>(
       cast<PointerType>(target->getType())->getElementType());
 
+  // Get the function to call from gTheTarget.
+  auto targetp = Builder.CreateIntToPtr(
+      ConstantInt::get(Type::getInt64Ty(ctx), (uintptr_t)(void *)&gTheTarget),
+      PointerType::getUnqual(PointerType::getUnqual(FTy)), "targetp");
+  auto dispatchTarget = Builder.CreateLoad(targetp, "target");
+
   // Each argument will be passed by writing it into gTheArgsP[i].
   unsigned i = 0, idx = 2;
-  for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end(); ai != ae;
-       ++ai, ++i) {
-    // Determine the type the argument will be passed as. This accommodates for
-    // the corresponding code in Executor.cpp for handling calls to bitcasted
-    // functions.
-    auto argTy =
-        (i < FTy->getNumParams() ? FTy->getParamType(i) : (*ai)->getType());
+  for (Type *argTy : argTypes) {
     auto argI64p =
         Builder.CreateGEP(nullptr, argI64s,
                           ConstantInt::get(Type::getInt32Ty(ctx), idx));
 
     auto argp = Builder.CreateBitCast(argI64p, PointerType::getUnqual(argTy));
-    args[i] = Builder.CreateLoad(argp);
+    args[i++] = Builder.CreateLoad(argp);
 
     unsigned argSize = argTy->getPrimitiveSizeInBits();
     idx += ((!!argSize ? argSize : 64) + 63) / 64;
   }
 
-  auto dispatchTarget = module->getOrInsertFunction(target->getName(), FTy,
-                                                    target->getAttributes());
   auto result = Builder.CreateCall(dispatchTarget,
                                    llvm::ArrayRef<Value *>(args, args + i));
+  // The call is indirect, so the attributes of the callee, which select how
+  // its arguments are passed, go on the call.
+  result->setAttributes(target->getAttributes());
   if (result->getType() != Type::getVoidTy(ctx)) {
     auto resp = Builder.CreateBitCast(
         argI64s, PointerType::getUnqual(result->getType()));
@@ -332,8 +608,10 @@ void ExternalDispatcherImpl::setLastErrno(int newErrno) {
   lastErrno = newErrno;
 }
 
-ExternalDispatcher::ExternalDispatcher(llvm::LLVMContext &ctx)
-    : impl(new ExternalDispatcherImpl(ctx)) {}
+ExternalDispatcher::ExternalDispatcher(llvm::LLVMContext &ctx,
+                                       bool separateProcess,
+                                       time::Span timeout)
+    : impl(new ExternalDispatcherImpl(ctx, separateProcess, timeout)) {}
 
 ExternalDispatcher::~ExternalDispatcher() { delete impl; }
 
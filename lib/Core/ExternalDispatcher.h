@@ -11,6 +11,7 @@
 #define KLEE_EXTERNALDISPATCHER_H
 
 #include "klee/Config/Version.h"
+#include "klee/Internal/System/Time.h"
 
 #include <map>
 #include <memory>
@@ -30,7 +31,11 @@ private:
   ExternalDispatcherImpl *impl;
 
 public:
-  ExternalDispatcher(llvm::LLVMContext &ctx);
+  /// With \a separateProcess, the calls run in a process of their own,
+  /// which is killed when a call takes longer than a non-zero \a timeout.
+  /// The memory the calls access must then be shared with that process.
+  ExternalDispatcher(llvm::LLVMContext &ctx, bool separateProcess = false,
+                     time::Span timeout = time::Span());
   ~ExternalDispatcher();
 
   /* Call the given function using the parameter passing convention of
@@ -0,0 +1,206 @@
+//===-- FunctionSummaries.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionSummaries.h"
+
+#include "AddressSpace.h"
+#include "Context.h"
+#include "CoreStats.h"
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+
+#include "llvm/IR/Function.h"
+
+using namespace klee;
+
+namespace {
+/// The number of bytes a recording may read and write before it is
+/// abandoned, which bounds the cost of checking and applying a summary.
+const size_t MaxRecordedBytes = 4096;
+
+/// The number of abandoned recordings of a function after which no more
+/// are started.
+const unsigned MaxFailures = 8;
+
+/// The number of summaries kept for the same arguments, the oldest being
+/// dropped first.
+const size_t MaxSummariesPerKey = 4;
+
+/// The number of different calls summarized before forgetting them all.
+const size_t MaxKeys = 1 << 14;
+
+ref<ConstantExpr> getAddress(uint64_t address) {
+  return ConstantExpr::create(address, Context::get().getPointerWidth());
+}
+}
+
+bool FunctionSummaries::Key::operator==(const Key &b) const {
+  if (function != b.function || arguments.size() != b.arguments.size())
+    return false;
+  for (unsigned i = 0; i != arguments.size(); ++i)
+    if (arguments[i]->compare(*b.arguments[i]))
+      return false;
+  return true;
+}
+
+size_t FunctionSummaries::KeyHash::operator()(const Key &key) const {
+  size_t h = std::hash<llvm::Function *>()(key.function);
+  for (const ref<Expr> &arg : key.arguments)
+    h = h * Expr::MAGIC_HASH_CONSTANT + arg->hash();
+  return h;
+}
+
+bool FunctionSummaries::matches(const ExecutionState &state,
+                                const Summary &summary) const {
+  for (const Summary::Object &o : summary.objects) {
+    ObjectPair op;
+    if (!state.addressSpace.resolveOne(getAddress(o.address), op) ||
+        op.first->address != o.address || op.first->size != o.size ||
+        (o.written && op.second->readOnly))
+      return false;
+  }
+  for (const std::pair<uint64_t, uint8_t> &r : summary.reads) {
+    ObjectPair op;
+    bool success = state.addressSpace.resolveOne(getAddress(r.first), op);
+    assert(success && "read outside the objects of the summary");
+    (void) success;
+    ConstantExpr *ce =
+        dyn_cast<ConstantExpr>(op.second->read8(r.first - op.first->address));
+    if (!ce || ce->getZExtValue() != r.second)
+      return false;
+  }
+  return true;
+}
+
+bool FunctionSummaries::recordByte(SummaryRecording &recording,
+                                   const MemoryObject *mo, uint64_t address,
+                                   uint8_t value, bool isWrite) {
+  recording.objects[mo] |= isWrite;
+  if (isWrite)
+    recording.writes[address] = value;
+  else if (!recording.writes.count(address))
+    recording.reads.insert(std::make_pair(address, value));
+  return recording.reads.size() + recording.writes.size() <= MaxRecordedBytes;
+}
+
+bool FunctionSummaries::apply(ExecutionState &state, llvm::Function *f,
+                              const std::vector<ref<Expr> > &arguments,
+                              Expr::Width width, ref<Expr> &result) {
+  auto it = summaries.find(Key{f, arguments});
+  if (it == summaries.end())
+    return false;
+
+  for (const Summary &summary : it->second) {
+    if ((summary.result.isNull() ? 0 : summary.result->getWidth()) != width ||
+        !matches(state, summary))
+      continue;
+
+    // Replaying inside a recorded call is part of what that call does.
+    SummaryRecording *recording = state.summaryRecording.get();
+    if (recording) {
+      for (const std::pair<uint64_t, uint8_t> &r : summary.reads) {
+        ObjectPair op;
+        state.addressSpace.resolveOne(getAddress(r.first), op);
+        if (!recording->fresh.count(op.first) &&
+            !recordByte(*recording, op.first, r.first, r.second, false)) {
+          abandon(state);
+          recording = nullptr;
+          break;
+        }
+      }
+    }
+    for (const std::pair<uint64_t, uint8_t> &w : summary.writes) {
+      ObjectPair op;
+      state.addressSpace.resolveOne(getAddress(w.first), op);
+      ObjectState *wos = state.addressSpace.getWriteable(op.first, op.second);
+      wos->write8(w.first - op.first->address, w.second);
+      if (recording && !recording->fresh.count(op.first) &&
+          !recordByte(*recording, op.first, w.first, w.second, true)) {
+        abandon(state);
+        recording = nullptr;
+      }
+    }
+
+    ++stats::functionSummaryHits;
+    result = summary.result;
+    return true;
+  }
+  return false;
+}
+
+void FunctionSummaries::start(ExecutionState &state, llvm::Function *f,
+                              const std::vector<ref<Expr> > &arguments) {
+  if (state.summaryRecording || f->isVarArg())
+    return;
+  for (const ref<Expr> &arg : arguments)
+    if (!isa<ConstantExpr>(arg))
+      return;
+  auto failed = failures.find(f);
+  if (failed != failures.end() && failed->second >= MaxFailures)
+    return;
+
+  state.summaryRecording = std::make_shared<SummaryRecording>();
+  state.summaryRecording->function = f;
+  state.summaryRecording->arguments = arguments;
+  state.summaryRecording->depth = state.stack.size();
+}
+
+void FunctionSummaries::recordAccess(ExecutionState &state,
+                                     const MemoryObject *mo,
+                                     const ObjectState *os, uint64_t offset,
+                                     unsigned bytes, bool isWrite) {
+  SummaryRecording *recording = state.summaryRecording.get();
+  if (!recording || recording->fresh.count(mo))
+    return;
+  for (unsigned i = 0; i != bytes; ++i) {
+    ConstantExpr *ce = dyn_cast<ConstantExpr>(os->read8(offset + i));
+    if (!ce || !recordByte(*recording, mo, mo->address + offset + i,
+                           ce->getZExtValue(), isWrite)) {
+      abandon(state);
+      return;
+    }
+  }
+}
+
+void FunctionSummaries::recordAllocation(ExecutionState &state,
+                                         const MemoryObject *mo) {
+  if (state.summaryRecording)
+    state.summaryRecording->fresh.insert(mo);
+}
+
+void FunctionSummaries::abandon(ExecutionState &state) {
+  if (!state.summaryRecording)
+    return;
+  ++failures[state.summaryRecording->function];
+  state.summaryRecording.reset();
+}
+
+void FunctionSummaries::finish(ExecutionState &state, ref<Expr> result) {
+  SummaryRecording &recording = *state.summaryRecording;
+  assert(recording.depth == state.stack.size() && "not the recorded call");
+  if (!result.isNull() && !isa<ConstantExpr>(result))
+    return abandon(state);
+
+  Summary summary;
+  for (const auto &o : recording.objects)
+    summary.objects.push_back({o.first->address, o.first->size, o.second});
+  summary.reads.assign(recording.reads.begin(), recording.reads.end());
+  summary.writes.assign(recording.writes.begin(), recording.writes.end());
+  summary.result = result;
+
+  if (summaries.size() >= MaxKeys)
+    summaries.clear();
+  std::vector<Summary> &known =
+      summaries[Key{recording.function, recording.arguments}];
+  if (known.size() >= MaxSummariesPerKey)
+    known.erase(known.begin());
+  known.push_back(std::move(summary));
+  state.summaryRecording.reset();
+}
@@ -0,0 +1,119 @@
+//===-- FunctionSummaries.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FUNCTIONSUMMARIES_H
+#define KLEE_FUNCTIONSUMMARIES_H
+
+#include "klee/Expr.h"
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace llvm {
+  class Function;
+}
+
+namespace klee {
+  class ExecutionState;
+  class MemoryObject;
+  class ObjectState;
+
+  /// A call whose effects are being recorded: the bytes it read from and
+  /// wrote to the objects which existed before it. It is abandoned as soon
+  /// as anything symbolic is involved, so that what is recorded does not
+  /// depend on the path constraints.
+  struct SummaryRecording {
+    llvm::Function *function;
+    std::vector<ref<Expr> > arguments;
+    /// The size of the stack while the call runs.
+    size_t depth;
+    /// The objects allocated during the call, whose accesses do not matter.
+    std::unordered_set<const MemoryObject *> fresh;
+    /// The other objects accessed, and whether they were written.
+    std::map<const MemoryObject *, bool> objects;
+    std::map<uint64_t, uint8_t> reads;
+    std::map<uint64_t, uint8_t> writes;
+  };
+
+  /// Summaries of calls with concrete arguments which only computed on
+  /// concrete data, shared by all states. A summary applies to a call with
+  /// the same arguments in a state whose memory holds the same values at
+  /// the addresses the recorded call read, and replaces interpreting the
+  /// body by its writes and its return value.
+  class FunctionSummaries {
+    struct Summary {
+      struct Object {
+        uint64_t address;
+        unsigned size;
+        bool written;
+      };
+      std::vector<Object> objects;
+      std::vector<std::pair<uint64_t, uint8_t> > reads;
+      std::vector<std::pair<uint64_t, uint8_t> > writes;
+      /// Null if the function returns nothing.
+      ref<Expr> result;
+    };
+
+    struct Key {
+      llvm::Function *function;
+      std::vector<ref<Expr> > arguments;
+
+      bool operator==(const Key &b) const;
+    };
+
+    struct KeyHash {
+      size_t operator()(const Key &key) const;
+    };
+
+    std::unordered_map<Key, std::vector<Summary>, KeyHash> summaries;
+    /// The number of abandoned recordings of each function.
+    std::unordered_map<llvm::Function *, unsigned> failures;
+
+    bool matches(const ExecutionState &state, const Summary &summary) const;
+    bool recordByte(SummaryRecording &recording, const MemoryObject *mo,
+                    uint64_t address, uint8_t value, bool isWrite);
+
+  public:
+    /// Drops the summaries recorded so far, to free their memory.
+    void clear() { summaries.clear(); }
+    bool empty() const { return summaries.empty(); }
+
+    /// Applies a summary of calling \a f with \a arguments to the memory of
+    /// \a state, if one matches it and returns a value of \a width bits (0
+    /// for none), and sets \a result to its return value.
+    bool apply(ExecutionState &state, llvm::Function *f,
+               const std::vector<ref<Expr> > &arguments, Expr::Width width,
+               ref<Expr> &result);
+
+    /// Starts recording the call of \a f just entered by \a state, unless
+    /// it is recording one already or \a f is not worth summarizing.
+    void start(ExecutionState &state, llvm::Function *f,
+               const std::vector<ref<Expr> > &arguments);
+
+    /// Records an in bounds access to \a bytes bytes of \a os just made by
+    /// \a state, which is abandoned if any of them is symbolic.
+    void recordAccess(ExecutionState &state, const MemoryObject *mo,
+                      const ObjectState *os, uint64_t offset, unsigned bytes,
+                      bool isWrite);
+
+    void recordAllocation(ExecutionState &state, const MemoryObject *mo);
+
+    /// Abandons the recording of \a state, if any.
+    void abandon(ExecutionState &state);
+
+    /// Ends the recording of the call \a state returns from, with \a result
+    /// as the return value (null if none), if it is still valid.
+    void finish(ExecutionState &state, ref<Expr> result);
+  };
+}
+
+#endif
@@ -0,0 +1,234 @@
+//===-- FuzzerBridge.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FuzzerBridge.h"
+
+#include "klee/Internal/ADT/KTest.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/OptionCategories.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+cl::opt<std::string> FuzzerQueue(
+    "fuzzer-queue",
+    cl::desc("Import the inputs a fuzzer adds to this queue directory as "
+             "seeds while running (default=none)"),
+    cl::cat(SeedingCat));
+
+cl::opt<std::string> FuzzerExportDir(
+    "fuzzer-export-dir",
+    cl::desc("Also write the inputs of the tests covering new edges to this "
+             "directory, for a fuzzer to sync from (default=none)"),
+    cl::cat(SeedingCat));
+
+cl::opt<std::string> FuzzerBitmap(
+    "fuzzer-bitmap",
+    cl::desc("Keep the edges covered by the tests in this file, an AFL "
+             "coverage bitmap shared with the processes mapping it, which "
+             "is created if missing (default=none)"),
+    cl::cat(SeedingCat));
+
+cl::opt<std::string> FuzzerObject(
+    "fuzzer-object",
+    cl::desc("The symbolic object the raw inputs of the fuzzer are the "
+             "contents of (default=the first one)"),
+    cl::cat(SeedingCat));
+
+cl::opt<std::string> FuzzerSyncInterval(
+    "fuzzer-sync-interval",
+    cl::desc("How often the queue of --fuzzer-queue is read (default=10s)"),
+    cl::init("10s"), cl::cat(SeedingCat));
+
+/// The index of a block in the bitmap.
+std::uint32_t hashBlock(std::uint32_t id) {
+  return (id * 0x9E3779B1u) >> 16;
+}
+
+/// A test with a single object of \a size bytes, named \a name.
+KTest *createRawTest(const std::string &name, const char *data,
+                     size_t size) {
+  KTest *test = (KTest *)calloc(1, sizeof(*test));
+  test->version = kTest_getCurrentVersion();
+  test->numObjects = 1;
+  test->objects = (KTestObject *)calloc(1, sizeof(*test->objects));
+  test->objects[0].name = strdup(name.c_str());
+  test->objects[0].numBytes = size;
+  test->objects[0].bytes = (unsigned char *)malloc(size ? size : 1);
+  memcpy(test->objects[0].bytes, data, size);
+  return test;
+}
+}
+
+FuzzerBridge::~FuzzerBridge() {
+  for (KTest *input : inputs)
+    kTest_free(input);
+  if (mapped)
+    munmap(bitmap, MapSize);
+  else
+    delete[] bitmap;
+}
+
+FuzzerBridge *FuzzerBridge::create() {
+  if (FuzzerQueue.empty() && FuzzerExportDir.empty() && FuzzerBitmap.empty())
+    return nullptr;
+
+  FuzzerBridge *bridge = new FuzzerBridge();
+  bridge->queueDir = FuzzerQueue;
+  bridge->exportDir = FuzzerExportDir;
+
+  if (!FuzzerBitmap.empty()) {
+    int fd = open(FuzzerBitmap.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 ||
+        (st.st_size < MapSize && ftruncate(fd, MapSize) < 0))
+      klee_error("unable to open the fuzzer bitmap %s: %s",
+                 FuzzerBitmap.c_str(), sys::StrError(errno).c_str());
+    void *map = mmap(nullptr, MapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                     0);
+    close(fd);
+    if (map == MAP_FAILED)
+      klee_error("unable to map the fuzzer bitmap %s: %s",
+                 FuzzerBitmap.c_str(), sys::StrError(errno).c_str());
+    bridge->bitmap = (unsigned char *)map;
+    bridge->mapped = true;
+  } else if (!bridge->exportDir.empty()) {
+    bridge->bitmap = new unsigned char[MapSize]();
+  }
+
+  if (!bridge->exportDir.empty()) {
+    if (std::error_code ec = sys::fs::create_directories(bridge->exportDir))
+      klee_error("unable to create the fuzzer export directory %s: %s",
+                 bridge->exportDir.c_str(), ec.message().c_str());
+  }
+  return bridge;
+}
+
+time::Span FuzzerBridge::getSyncInterval() {
+  return time::Span(FuzzerSyncInterval);
+}
+
+void FuzzerBridge::importInputs(std::vector<KTest *> &result) {
+  if (queueDir.empty())
+    return;
+
+  std::vector<std::string> names;
+  std::error_code ec;
+  sys::fs::directory_iterator i(queueDir, ec), e;
+  for (; i != e && !ec; i.increment(ec)) {
+    std::string name = sys::path::filename(i->path()).str();
+    // the fuzzer keeps its own state in hidden entries
+    if (name.empty() || name[0] == '.' || imported.count(name) ||
+        sys::fs::is_directory(i->path()))
+      continue;
+    names.push_back(name);
+  }
+  if (ec) {
+    klee_warning_once(0, "unable to read the fuzzer queue %s: %s",
+                      queueDir.c_str(), ec.message().c_str());
+    return;
+  }
+
+  // the fuzzer numbers its entries in the order they were added
+  std::sort(names.begin(), names.end());
+  for (const std::string &name : names) {
+    imported.insert(name);
+    SmallString<128> path(queueDir);
+    sys::path::append(path, name);
+
+    KTest *input;
+    if (kTest_isKTestFile(path.c_str())) {
+      input = kTest_fromFile(path.c_str());
+    } else {
+      auto file = MemoryBuffer::getFile(path);
+      std::string object =
+          FuzzerObject.empty() ? "input" : FuzzerObject.getValue();
+      input = file ? createRawTest(object, (*file)->getBufferStart(),
+                                   (*file)->getBufferSize())
+                   : nullptr;
+    }
+    if (!input) {
+      klee_warning("unable to read the fuzzer input %s", path.c_str());
+      continue;
+    }
+    inputs.push_back(input);
+    result.push_back(input);
+  }
+}
+
+bool FuzzerBridge::addCoverage(const ImmutableSet<std::uint64_t> &edges) {
+  if (!bitmap)
+    return false;
+
+  bool covered = false;
+  for (std::uint64_t edge : edges) {
+    std::uint32_t from = hashBlock(edge >> 32), to = hashBlock(edge);
+    unsigned char &entry = bitmap[((from >> 1) ^ to) & (MapSize - 1)];
+    if (!entry) {
+      entry = 1;
+      covered = true;
+    }
+  }
+  return covered;
+}
+
+void FuzzerBridge::exportInput(
+    const std::vector<std::pair<std::string, std::vector<unsigned char> > >
+        &solution) {
+  if (exportDir.empty())
+    return;
+
+  auto object = solution.begin();
+  if (!FuzzerObject.empty())
+    object = std::find_if(solution.begin(), solution.end(),
+                          [](const std::pair<std::string,
+                                             std::vector<unsigned char> > &o) {
+                            return o.first == FuzzerObject;
+                          });
+  if (object == solution.end())
+    return;
+
+  char name[32];
+  snprintf(name, sizeof(name), "id:%06u,src:klee", exported++);
+  SmallString<128> path(exportDir), temporary(exportDir);
+  sys::path::append(path, name);
+  // the fuzzer only sees complete inputs
+  sys::path::append(temporary, std::string(".") + name);
+
+  std::string error;
+  auto os = klee_open_output_file(temporary.str().str(), error);
+  if (!os) {
+    klee_warning("unable to export a test to the fuzzer: %s", error.c_str());
+    return;
+  }
+  os->write((const char *)object->second.data(), object->second.size());
+  os->close();
+  if (std::error_code ec = sys::fs::rename(temporary, path))
+    klee_warning("unable to export a test to the fuzzer: %s",
+                 ec.message().c_str());
+}
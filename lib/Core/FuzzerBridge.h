@@ -0,0 +1,85 @@
+//===-- FuzzerBridge.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FUZZERBRIDGE_H
+#define KLEE_FUZZERBRIDGE_H
+
+#include "klee/Internal/ADT/ImmutableSet.h"
+#include "klee/Internal/System/Time.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  struct KTest;
+}
+
+namespace klee {
+  /// Exchanges inputs with a fuzzer running next to KLEE, as selected with
+  /// --fuzzer-queue, --fuzzer-export-dir and --fuzzer-bitmap.
+  ///
+  /// The new files of the fuzzer's queue directory become seeds. They are
+  /// .ktest files, or raw inputs which give the contents of the first
+  /// symbolic object (or of the one named by --fuzzer-object). In the other
+  /// direction, the tests which cover edges not in the coverage bitmap are
+  /// written as raw inputs, named as in an AFL queue so that the fuzzer
+  /// can sync from the directory.
+  ///
+  /// The bitmap has the layout of AFL's: a byte per edge, indexed by the
+  /// hashes of the blocks. Kept in a file, it is shared with the processes
+  /// mapping it as well, so that a tool feeding the fuzzer can skip the
+  /// inputs covering nothing new to KLEE.
+  class FuzzerBridge {
+    static const unsigned MapSize = 1 << 16;
+
+    std::string queueDir, exportDir;
+    /// The queue entries imported already.
+    std::set<std::string> imported;
+    std::vector<KTest *> inputs;
+    unsigned exported = 0;
+
+    unsigned char *bitmap = nullptr;
+    /// Whether the bitmap is mapped from its file, or allocated.
+    bool mapped = false;
+
+    FuzzerBridge() = default;
+
+  public:
+    FuzzerBridge(const FuzzerBridge &) = delete;
+    FuzzerBridge &operator=(const FuzzerBridge &) = delete;
+    ~FuzzerBridge();
+
+    /// Returns a bridge configured by the options, or null if there is no
+    /// fuzzer to exchange inputs with.
+    static FuzzerBridge *create();
+
+    /// How often the queue is read.
+    static time::Span getSyncInterval();
+
+    /// Adds the inputs which entered the queue since the last call to
+    /// \a result. They stay owned by the bridge.
+    void importInputs(std::vector<KTest *> &result);
+
+    /// Marks the \a edges a test covered in the bitmap, returning whether
+    /// any of them was not covered before.
+    bool addCoverage(const ImmutableSet<std::uint64_t> &edges);
+
+    bool isExporting() const { return !exportDir.empty(); }
+
+    /// Writes the input of a test to the export directory.
+    void exportInput(
+        const std::vector<std::pair<std::string, std::vector<unsigned char> > >
+            &solution);
+  };
+}
+
+#endif
@@ -0,0 +1,80 @@
+//===-- GenerationalSearch.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GenerationalSearch.h"
+
+#include "klee/Internal/ADT/KTest.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace klee;
+
+void GenerationalSearch::addSeed(KTest *seed) {
+  Input input;
+  input.test = std::shared_ptr<KTest>(seed, [](KTest *) {});
+  input.order = added++;
+  worklist.push(input);
+}
+
+void GenerationalSearch::addInput(
+    const std::vector<std::pair<std::string, std::vector<unsigned char> > >
+        &values,
+    unsigned index, std::uint64_t score) {
+  const KTest *parent = current.test.get();
+  assert(parent && "no current input");
+
+  KTest *test = (KTest *)calloc(1, sizeof(*test));
+  test->version = kTest_getCurrentVersion();
+  // the arguments stay those of the seed
+  test->numArgs = parent->numArgs;
+  test->args = (char **)calloc(parent->numArgs, sizeof(*test->args));
+  for (unsigned i = 0; i < parent->numArgs; i++)
+    test->args[i] = strdup(parent->args[i]);
+  test->symArgvs = parent->symArgvs;
+  test->symArgvLen = parent->symArgvLen;
+
+  test->numObjects = values.size();
+  test->objects = (KTestObject *)calloc(values.size(), sizeof(*test->objects));
+  for (unsigned i = 0; i < values.size(); i++) {
+    KTestObject &o = test->objects[i];
+    o.name = strdup(values[i].first.c_str());
+    o.numBytes = values[i].second.size();
+    o.bytes = (unsigned char *)malloc(o.numBytes ? o.numBytes : 1);
+    std::copy(values[i].second.begin(), values[i].second.end(), o.bytes);
+  }
+
+  Input input;
+  input.test = std::shared_ptr<KTest>(test, kTest_free);
+  input.bound = index + 1;
+  input.score = score;
+  input.order = added++;
+  worklist.push(input);
+}
+
+bool GenerationalSearch::next() {
+  path.clear();
+  branches.clear();
+  if (worklist.empty()) {
+    current = Input();
+    return false;
+  }
+  current = worklist.top();
+  worklist.pop();
+  return true;
+}
+
+void GenerationalSearch::getNegation(
+    unsigned index, std::vector<ref<Expr> > &constraints) const {
+  assert(index < branches.size() && "invalid branch");
+  unsigned taken = branches[index];
+  constraints.assign(path.begin(), path.begin() + taken);
+  constraints.push_back(Expr::createIsZero(path[taken]));
+}
@@ -0,0 +1,92 @@
+//===-- GenerationalSearch.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_GENERATIONALSEARCH_H
+#define KLEE_GENERATIONALSEARCH_H
+
+#include "klee/Expr.h"
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  struct KTest;
+}
+
+namespace klee {
+  /// The inputs of a generational search, as done by --concolic: each
+  /// input is executed on a single path, following its values, and the
+  /// branches taken on that path are negated one at a time to get the
+  /// inputs of the next generation.
+  ///
+  /// An input only negates the branches after the one it was generated
+  /// from, the others were negated by its ancestors already. The inputs
+  /// whose parent covered the most new instructions are executed first.
+  class GenerationalSearch {
+    struct Input {
+      std::shared_ptr<KTest> test;
+      /// The branches below this are not negated.
+      unsigned bound = 0;
+      std::uint64_t score = 0;
+      std::uint64_t order = 0;
+
+      bool operator<(const Input &other) const {
+        // the highest score first, then in the order they were added
+        if (score != other.score)
+          return score < other.score;
+        return order > other.order;
+      }
+    };
+
+    std::priority_queue<Input> worklist;
+    std::uint64_t added = 0;
+    Input current;
+
+    /// The constraints added on the path of the current input, in order,
+    /// and the indices of those which took a branch.
+    std::vector<ref<Expr> > path;
+    std::vector<unsigned> branches;
+
+  public:
+    /// Adds an input given by the user, which stays owned by the caller.
+    void addSeed(KTest *seed);
+
+    /// Adds an input generated from the current one for branch \a index.
+    void addInput(const std::vector<std::pair<std::string,
+                                              std::vector<unsigned char> > >
+                      &values,
+                  unsigned index, std::uint64_t score);
+
+    /// Moves on to the next input, if there is one left.
+    bool next();
+
+    KTest *getInput() const { return current.test.get(); }
+    unsigned getBound() const { return current.bound; }
+    unsigned getNumBranches() const { return branches.size(); }
+    std::size_t getNumPending() const { return worklist.size(); }
+
+    void recordConstraint(const ref<Expr> &constraint) {
+      path.push_back(constraint);
+    }
+
+    /// The next constraint recorded is the branch taken.
+    void recordBranch() { branches.push_back(path.size()); }
+
+    /// The constraints under which the current path goes the other way at
+    /// branch \a index.
+    void getNegation(unsigned index,
+                     std::vector<ref<Expr> > &constraints) const;
+  };
+}
+
+#endif
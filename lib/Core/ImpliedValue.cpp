@@ -48,6 +48,10 @@ void ImpliedValue::getImpliedValues(ref<Expr> e,
     results.push_back(std::make_pair(re, value));
     break;
   }
+
+  case Expr::WideRead:
+    getImpliedValues(cast<WideReadExpr>(e)->lower(), value, results);
+    break;
     
   case Expr::Select: {
     // not much to do, could improve with range analysis
@@ -143,8 +147,8 @@ void ImpliedValue::getImpliedValues(ref<Expr> e,
   case Expr::Or: {
     BinaryExpr *be = cast<BinaryExpr>(e);
     if (value->isZero()) {
-      getImpliedValues(be->left, 0, results);
-      getImpliedValues(be->right, 0, results);
+      getImpliedValues(be->left, value, results);
+      getImpliedValues(be->right, value, results);
     } else {
       // FIXME: Can do more?
     }
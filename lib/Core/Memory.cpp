@@ -12,13 +12,16 @@
 #include "Context.h"
 #include "MemoryManager.h"
 #include "ObjectHolder.h"
+#include "klee/ExecutionState.h"
 #include "klee/Expr.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/OptionCategories.h"
 #include "klee/Solver.h"
 #include "klee/util/ArrayCache.h"
-#include "klee/util/BitArray.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Value.h"
@@ -26,6 +29,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 using namespace llvm;
@@ -37,6 +41,14 @@ namespace {
                     cl::desc("Use constant arrays instead of updates when possible (default=true)\n"),
                     cl::init(true),
                     cl::cat(SolvingCat));
+
+  cl::opt<unsigned> CompactUpdates(
+      "compact-updates",
+      cl::desc("Drop the overwritten concrete writes from the update list of "
+               "an object once it holds this many updates, and again each "
+               "time it doubled since (0=off) (default=0)"),
+      cl::init(0),
+      cl::cat(SolvingCat));
 }
 
 /***/
@@ -69,6 +81,25 @@ MemoryObject::~MemoryObject() {
     parent->markFreed(this);
 }
 
+void MemoryObject::release() const {
+  assert(refCount > 0);
+  if (--refCount)
+    return;
+  MemoryObject *mo = const_cast<MemoryObject *>(this);
+  if (!parent || !parent->recycle(mo))
+    delete mo;
+}
+
+void MemoryObject::reset() {
+  assert(!refCount && "reusing an object still referred to");
+  id = counter++;
+  symbolicSize = nullptr;
+  name = "unnamed";
+  isUserSpecified = false;
+  cexPreferences.clear();
+  hostContents.reset();
+}
+
 void MemoryObject::getAllocInfo(std::string &result) const {
   llvm::raw_string_ostream info(result);
 
@@ -97,11 +128,14 @@ ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(mo->size),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    compactedUpdates(0),
+    contentHash(0),
+    contentSummaryValid(false),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
@@ -111,7 +145,6 @@ ObjectState::ObjectState(const MemoryObject *mo)
         getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), size);
     updates = UpdateList(array, 0);
   }
-  memset(concreteStore, 0, size);
 }
 
 
@@ -119,57 +152,143 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(mo->size),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    compactedUpdates(0),
+    contentHash(0),
+    contentSummaryValid(false),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
   makeSymbolic();
-  memset(concreteStore, 0, size);
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
-    concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
-    flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
-    knownSymbolics(0),
+    concreteStore(os.concreteStore),
+    lazyContents(os.lazyContents),
+    concreteMask(os.concreteMask ? new PagedBitArray(*os.concreteMask) : 0),
+    flushMask(os.flushMask ? new PagedBitArray(*os.flushMask) : 0),
+    knownSymbolics(os.knownSymbolics
+                       ? new PagedArray<ref<Expr> >(*os.knownSymbolics)
+                       : 0),
     updates(os.updates),
+    compactedUpdates(os.compactedUpdates),
+    contentHash(os.contentHash),
+    contentArrays(os.contentArrays),
+    contentSummaryValid(os.contentSummaryValid),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
   if (object)
     object->refCount++;
+}
+
+void ObjectState::copyFrom(const ObjectState &src) {
+  assert(src.size == size && "copying from an object of another size");
+  if (&src == this)
+    return;
+  concreteStore = src.concreteStore;
+  lazyContents = src.lazyContents;
+  delete concreteMask;
+  concreteMask = src.concreteMask ? new PagedBitArray(*src.concreteMask) : 0;
+  delete flushMask;
+  flushMask = src.flushMask ? new PagedBitArray(*src.flushMask) : 0;
+  delete knownSymbolics;
+  knownSymbolics = src.knownSymbolics
+                       ? new PagedArray<ref<Expr> >(*src.knownSymbolics)
+                       : 0;
+  updates = src.updates;
+  compactedUpdates = src.compactedUpdates;
+  invalidateContentSummary();
+}
+
+void ObjectState::addFootprint(StateFootprint &footprint,
+                               std::unordered_set<const void *> &seen,
+                               bool exclusive) const {
+  if (!seen.insert(this).second)
+    return;
+  exclusive = exclusive && refCount == 1;
+  auto add = [&](std::uint64_t &part, std::uint64_t bytes, bool excl) {
+    part += bytes;
+    if (excl)
+      footprint.exclusive += bytes;
+  };
+  add(footprint.objectStates, sizeof(*this), exclusive);
+
+  auto page = [&](const void *p, size_t bytes, bool excl) {
+    if (seen.insert(p).second)
+      add(footprint.objectStates, bytes, exclusive && excl);
+  };
+  // lazy contents are not held yet
+  concreteStore.forEachPage(page);
+  if (concreteMask) {
+    add(footprint.objectStates, sizeof(*concreteMask), exclusive);
+    concreteMask->forEachPage(page);
+  }
+  if (flushMask) {
+    add(footprint.objectStates, sizeof(*flushMask), exclusive);
+    flushMask->forEachPage(page);
+  }
+  if (knownSymbolics) {
+    add(footprint.objectStates, sizeof(*knownSymbolics), exclusive);
+    knownSymbolics->forEachPage(page);
+  }
+
+  // The updates are shared from the first one another list refers to.
+  for (const UpdateNode *un = updates.head; un && seen.insert(un).second;
+       un = un->next) {
+    exclusive = exclusive && !un->isShared();
+    add(footprint.updates, sizeof(*un), exclusive);
+  }
+}
 
-  if (os.knownSymbolics) {
-    knownSymbolics = new ref<Expr>[size];
-    for (unsigned i=0; i<size; i++)
-      knownSymbolics[i] = os.knownSymbolics[i];
+void ObjectState::computeContentSummary() const {
+  llvm::hash_code h = llvm::hash_value(size);
+  for (unsigned i = 0; i != size; ++i)
+    h = llvm::hash_combine(h, read8(i)->hash());
+  contentHash = h;
+
+  std::vector<ref<Expr> > exprs;
+  if (knownSymbolics)
+    for (unsigned i = 0; i != size; ++i)
+      if (!knownSymbolics->get(i).isNull())
+        exprs.push_back(knownSymbolics->get(i));
+  for (const UpdateNode *un = updates.head; un; un = un->next) {
+    exprs.push_back(un->index);
+    exprs.push_back(un->value);
   }
+  contentArrays.clear();
+  findSymbolicObjects(exprs.begin(), exprs.end(), contentArrays);
+  if (updates.root && updates.root->isSymbolicArray())
+    contentArrays.push_back(updates.root);
+  contentSummaryValid = true;
+}
+
+std::uint64_t ObjectState::getContentHash() const {
+  if (!contentSummaryValid)
+    computeContentSummary();
+  return contentHash;
+}
 
-  memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
+const std::vector<const Array *> &ObjectState::getSymbolicArrays() const {
+  if (!contentSummaryValid)
+    computeContentSummary();
+  return contentArrays;
 }
 
 ObjectState::~ObjectState() {
   delete concreteMask;
   delete flushMask;
-  delete[] knownSymbolics;
-  delete[] concreteStore;
+  delete knownSymbolics;
 
   if (object)
-  {
-    assert(object->refCount > 0);
-    object->refCount--;
-    if (object->refCount == 0)
-    {
-      delete object;
-    }
-  }
+    object->release();
 }
 
 ArrayCache *ObjectState::getArrayCache() const {
@@ -217,7 +336,7 @@ const UpdateList &ObjectState::getUpdates() const {
     }
 
     static unsigned id = 0;
-    const Array *array = getArrayCache()->CreateArray(
+    const Array *array = getArrayCache()->CreateSharedConstantArray(
         "const_arr" + llvm::utostr(++id), size, &Contents[0],
         &Contents[0] + Contents.size());
     updates = UpdateList(array, 0);
@@ -241,15 +360,33 @@ void ObjectState::flushToConcreteStore(TimingSolver *solver,
                      "byte %p+%u will have random value",
                      (void *)object->address, i);
       else
-        ce->toMemory(concreteStore + i);
+        getConcreteStore().set(i, ce->getZExtValue(8));
+    }
+  }
+}
+
+void ObjectState::flushToConcreteStore(Assignment &model) const {
+  for (unsigned i = 0; i < size; i++) {
+    if (isByteKnownSymbolic(i)) {
+      ref<Expr> value = model.evaluate(read8(i));
+      if (ConstantExpr *ce = dyn_cast<ConstantExpr>(value))
+        getConcreteStore().set(i, ce->getZExtValue(8));
     }
   }
 }
 
+void ObjectState::getKnownSymbolicBytes(
+    std::vector<ref<Expr> > &bytes) const {
+  for (unsigned i = 0; i < size; i++)
+    if (isByteKnownSymbolic(i))
+      bytes.push_back(read8(i));
+}
+
 void ObjectState::makeConcrete() {
+  invalidateContentSummary();
   delete concreteMask;
   delete flushMask;
-  delete[] knownSymbolics;
+  delete knownSymbolics;
   concreteMask = 0;
   flushMask = 0;
   knownSymbolics = 0;
@@ -258,6 +395,7 @@ void ObjectState::makeConcrete() {
 void ObjectState::makeSymbolic() {
   assert(!updates.head &&
          "XXX makeSymbolic of objects with symbolic values is unsupported");
+  invalidateContentSummary();
 
   // XXX simplify this, can just delete various arrays I guess
   for (unsigned i=0; i<size; i++) {
@@ -269,15 +407,39 @@ void ObjectState::makeSymbolic() {
 
 void ObjectState::initializeToZero() {
   makeConcrete();
-  memset(concreteStore, 0, size);
+  lazyContents.reset();
+  concreteStore.reset(0);
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
-  for (unsigned i=0; i<size; i++) {
-    // randomly selected by 256 sided die
-    concreteStore[i] = 0xAB;
+  lazyContents.reset();
+  // randomly selected by 256 sided die
+  concreteStore.reset(0xAB);
+}
+
+void ObjectState::initializeLazily(std::shared_ptr<LazyContents> contents) {
+  makeConcrete();
+  concreteStore.reset(0);
+  lazyContents = std::move(contents);
+  invalidateContentSummary();
+}
+
+void ObjectState::materialize() const {
+  // the concrete store only ever held the fill value so far
+  concreteStore = lazyContents->get(object);
+  lazyContents.reset();
+}
+
+const PagedArray<uint8_t> &LazyContents::get(const MemoryObject *mo) {
+  if (!contents) {
+    ObjectState os(mo);
+    os.initializeToZero();
+    initialize(os);
+    contents.reset(new PagedArray<uint8_t>(os.concreteStore));
+    initialize = nullptr;
   }
+  return *contents;
 }
 
 /*
@@ -297,52 +459,49 @@ void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
 
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
                                     unsigned rangeSize) const {
-  if (!flushMask) flushMask = new BitArray(size, true);
- 
-  for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-      }
-
-      flushMask->unset(offset);
+  if (!flushMask) flushMask = new PagedBitArray(size, true);
+  invalidateContentSummary();
+
+  // Only visit the unflushed bytes, skipping flushed ones a word at a time.
+  unsigned rangeEnd = rangeBase + rangeSize;
+  for (unsigned offset = flushMask->findNext(rangeBase, rangeEnd, true);
+       offset != rangeEnd;
+       offset = flushMask->findNext(offset + 1, rangeEnd, true)) {
+    if (isByteConcrete(offset)) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(getConcreteStore().get(offset), Expr::Int8));
+    } else {
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics->get(offset));
     }
-  } 
+  }
+  flushMask->set(rangeBase, rangeEnd, false);
+
+  // Flushing again after concrete writes appends the same indices again.
+  unsigned numUpdates = updates.getSize();
+  if (CompactUpdates && numUpdates >= CompactUpdates &&
+      numUpdates >= 2 * compactedUpdates) {
+    updates.compact();
+    compactedUpdates = updates.getSize();
+  }
 }
 
 void ObjectState::flushRangeForWrite(unsigned rangeBase, 
                                      unsigned rangeSize) {
-  if (!flushMask) flushMask = new BitArray(size, true);
-
-  for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
-        markByteSymbolic(offset);
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-        setKnownSymbolic(offset, 0);
-      }
+  if (!flushMask) flushMask = new PagedBitArray(size, true);
+  if (!rangeSize)
+    return;
 
-      flushMask->unset(offset);
-    } else {
-      // flushed bytes that are written over still need
-      // to be marked out
-      if (isByteConcrete(offset)) {
-        markByteSymbolic(offset);
-      } else if (isByteKnownSymbolic(offset)) {
-        setKnownSymbolic(offset, 0);
-      }
-    }
-  } 
+  unsigned rangeEnd = rangeBase + rangeSize;
+  flushRangeForRead(rangeBase, rangeSize);
+
+  // All bytes in the range are flushed now; the ones written over still need
+  // to be marked out.
+  if (!concreteMask)
+    concreteMask = new PagedBitArray(size, true);
+  concreteMask->set(rangeBase, rangeEnd, false);
+  clearKnownSymbolics(rangeBase, rangeSize);
 }
 
 bool ObjectState::isByteConcrete(unsigned offset) const {
@@ -354,7 +513,7 @@ bool ObjectState::isByteFlushed(unsigned offset) const {
 }
 
 bool ObjectState::isByteKnownSymbolic(unsigned offset) const {
-  return knownSymbolics && knownSymbolics[offset].get();
+  return knownSymbolics && knownSymbolics->get(offset).get();
 }
 
 void ObjectState::markByteConcrete(unsigned offset) {
@@ -364,7 +523,7 @@ void ObjectState::markByteConcrete(unsigned offset) {
 
 void ObjectState::markByteSymbolic(unsigned offset) {
   if (!concreteMask)
-    concreteMask = new BitArray(size, true);
+    concreteMask = new PagedBitArray(size, true);
   concreteMask->unset(offset);
 }
 
@@ -375,20 +534,42 @@ void ObjectState::markByteUnflushed(unsigned offset) {
 
 void ObjectState::markByteFlushed(unsigned offset) {
   if (!flushMask) {
-    flushMask = new BitArray(size, false);
+    flushMask = new PagedBitArray(size, false);
   } else {
     flushMask->unset(offset);
   }
 }
 
+bool ObjectState::isRangeConcrete(unsigned offset, unsigned count) const {
+  return !concreteMask || concreteMask->all(offset, offset + count, true);
+}
+
+unsigned ObjectState::readConcretePrefix(unsigned offset, unsigned count,
+                                         uint8_t *dst) const {
+  unsigned end = offset + count;
+  if (concreteMask)
+    end = concreteMask->findNext(offset, end, false);
+  getConcreteStore().copyTo(offset, end - offset, dst);
+  return end - offset;
+}
+
+void ObjectState::clearKnownSymbolics(unsigned offset, unsigned count) {
+  if (!knownSymbolics)
+    return;
+  for (unsigned i = offset, e = offset + count; i != e; ++i)
+    setKnownSymbolic(i, 0);
+}
+
 void ObjectState::setKnownSymbolic(unsigned offset, 
                                    Expr *value /* can be null */) {
   if (knownSymbolics) {
-    knownSymbolics[offset] = value;
+    // Avoid unsharing the page when clearing an already empty entry.
+    if (value || knownSymbolics->get(offset).get())
+      knownSymbolics->set(offset, value);
   } else {
     if (value) {
-      knownSymbolics = new ref<Expr>[size];
-      knownSymbolics[offset] = value;
+      knownSymbolics = new PagedArray<ref<Expr> >(size);
+      knownSymbolics->set(offset, value);
     }
   }
 }
@@ -397,9 +578,9 @@ void ObjectState::setKnownSymbolic(unsigned offset,
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
   if (isByteConcrete(offset)) {
-    return ConstantExpr::create(concreteStore[offset], Expr::Int8);
+    return ConstantExpr::create(getConcreteStore().get(offset), Expr::Int8);
   } else if (isByteKnownSymbolic(offset)) {
-    return knownSymbolics[offset];
+    return knownSymbolics->get(offset);
   } else {
     assert(isByteFlushed(offset) && "unflushed byte without cache value");
     
@@ -427,7 +608,9 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
-  concreteStore[offset] = value;
+  invalidateContentSummary();
+  if (getConcreteStore().get(offset) != value)
+    getConcreteStore().set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -439,6 +622,7 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
   } else {
+    invalidateContentSummary();
     setKnownSymbolic(offset, value.get());
       
     markByteSymbolic(offset);
@@ -461,6 +645,7 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
   }
   
   updates.extend(ZExtExpr::create(offset, Expr::Int32), value);
+  invalidateContentSummary();
 }
 
 /***/
@@ -497,9 +682,22 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Fully concrete reads of up to 64 bits become a single constant.
+  if (width <= Expr::Int64 && isRangeConcrete(offset, NumBytes)) {
+    uint8_t bytes[8];
+    getConcreteStore().copyTo(offset, NumBytes, bytes);
+    uint64_t value = 0;
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      value |= (uint64_t) bytes[idx] << (8 * i);
+    }
+    return ConstantExpr::create(value, width);
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -571,27 +769,37 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
 } 
 
 void ObjectState::write16(unsigned offset, uint16_t value) {
-  unsigned NumBytes = 2;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
-  }
+  writeConcrete(offset, value, 2);
 }
 
 void ObjectState::write32(unsigned offset, uint32_t value) {
-  unsigned NumBytes = 4;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
-  }
+  writeConcrete(offset, value, 4);
 }
 
 void ObjectState::write64(unsigned offset, uint64_t value) {
-  unsigned NumBytes = 8;
+  writeConcrete(offset, value, 8);
+}
+
+void ObjectState::writeConcrete(unsigned offset, uint64_t value,
+                                unsigned NumBytes) {
+  uint8_t bytes[8];
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    bytes[idx] = (uint8_t) (value >> (8 * i));
   }
+
+  // Same as write8() for each byte, but updating the store and the masks
+  // for the whole range at once.
+  invalidateContentSummary();
+  uint8_t current[8];
+  getConcreteStore().copyTo(offset, NumBytes, current);
+  if (memcmp(current, bytes, NumBytes))
+    getConcreteStore().copyFrom(offset, NumBytes, bytes);
+  clearKnownSymbolics(offset, NumBytes);
+  if (concreteMask)
+    concreteMask->set(offset, offset + NumBytes, true);
+  if (flushMask)
+    flushMask->set(offset, offset + NumBytes, true);
 }
 
 void ObjectState::print() const {
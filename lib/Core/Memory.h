@@ -13,11 +13,15 @@
 #include "Context.h"
 #include "TimingSolver.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/PagedArray.h"
 
 #include "llvm/ADT/StringExtras.h"
 
-#include <vector>
+#include <functional>
+#include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace llvm {
   class Value;
@@ -25,15 +29,17 @@ namespace llvm {
 
 namespace klee {
 
-class BitArray;
 class MemoryManager;
+class ObjectState;
 class Solver;
 class ArrayCache;
+class Assignment;
 
 class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class SymbolicList;
 
 private:
   static int counter;
@@ -45,6 +51,11 @@ public:
 
   /// size in bytes
   unsigned size;
+  /// The size of an object allocated with a symbolic size, of pointer
+  /// width, or null. The object then has room for \a size bytes, an upper
+  /// bound of this size, but only its first symbolicSize bytes are in
+  /// bounds.
+  ref<Expr> symbolicSize;
   mutable std::string name;
 
   bool isLocal;
@@ -66,6 +77,12 @@ public:
   /// should sensibly be only at creation time).
   mutable std::vector< ref<Expr> > cexPreferences;
 
+  /// The concrete contents last copied to or from the memory at \a address
+  /// for an external call, sharing the pages of the ObjectState they were
+  /// copied from, or null if unknown. Copying the object out again only
+  /// writes the pages that changed since.
+  mutable std::unique_ptr<PagedArray<uint8_t> > hostContents;
+
   // DO NOT IMPLEMENT
   MemoryObject(const MemoryObject &b);
   MemoryObject &operator=(const MemoryObject &b);
@@ -102,6 +119,14 @@ public:
 
   ~MemoryObject();
 
+  /// Drop a reference, and hand the object back to its memory manager or
+  /// delete it once it was the last.
+  void release() const;
+
+  /// Make the object a new one of the same size at the same address, for
+  /// the memory manager to reuse it.
+  void reset();
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -112,7 +137,9 @@ public:
   ref<ConstantExpr> getBaseExpr() const { 
     return ConstantExpr::create(address, Context::get().getPointerWidth());
   }
-  ref<ConstantExpr> getSizeExpr() const { 
+  ref<Expr> getSizeExpr() const {
+    if (!symbolicSize.isNull())
+      return symbolicSize;
     return ConstantExpr::create(size, Context::get().getPointerWidth());
   }
   ref<Expr> getOffsetExpr(ref<Expr> pointer) const {
@@ -126,6 +153,12 @@ public:
   }
 
   ref<Expr> getBoundsCheckOffset(ref<Expr> offset) const {
+    if (!symbolicSize.isNull()) {
+      // a pointer to a zero-sized object points to its base
+      return OrExpr::create(
+          EqExpr::create(offset, ConstantExpr::alloc(0, offset->getWidth())),
+          UltExpr::create(offset, symbolicSize));
+    }
     if (size==0) {
       return EqExpr::create(offset, 
                             ConstantExpr::alloc(0, Context::get().getPointerWidth()));
@@ -134,6 +167,12 @@ public:
     }
   }
   ref<Expr> getBoundsCheckOffset(ref<Expr> offset, unsigned bytes) const {
+    if (!symbolicSize.isNull() && bytes<=size) {
+      ref<Expr> n = ConstantExpr::alloc(bytes, symbolicSize->getWidth());
+      return AndExpr::create(
+          UleExpr::create(n, symbolicSize),
+          UleExpr::create(offset, SubExpr::create(symbolicSize, n)));
+    }
     if (bytes<=size) {
       return UltExpr::create(offset, 
                              ConstantExpr::alloc(size - bytes + 1, 
@@ -144,6 +183,24 @@ public:
   }
 };
 
+struct StateFootprint;
+
+/// The initial contents of an object, such as those of a global from its
+/// initializer, computed on first use. They are computed once and then
+/// shared, page by page, by every object state materialized from them.
+class LazyContents {
+  std::function<void(ObjectState &)> initialize;
+  std::unique_ptr<PagedArray<uint8_t> > contents;
+
+public:
+  /// \a initialize writes the contents to a concrete object state.
+  explicit LazyContents(std::function<void(ObjectState &)> initialize)
+      : initialize(std::move(initialize)) {}
+
+  /// Returns the contents of \a mo, computing them on the first call.
+  const PagedArray<uint8_t> &get(const MemoryObject *mo);
+};
+
 class ObjectState {
 private:
   friend class AddressSpace;
@@ -152,21 +209,39 @@ private:
   friend class ObjectHolder;
   unsigned refCount;
 
+  friend class LazyContents;
+
   const MemoryObject *object;
 
-  uint8_t *concreteStore;
+  // Contents are shared between copies of this object state at page
+  // granularity and only copied on the first write to a page. Mutable as
+  // flushToConcreteStore() may update the cached concrete values.
+  mutable PagedArray<uint8_t> concreteStore;
+
+  /// The contents the concrete store is to take on first access, or null
+  /// once it holds them. Mutable as any access may materialize them.
+  mutable std::shared_ptr<LazyContents> lazyContents;
 
   // XXX cleanup name of flushMask (its backwards or something)
-  BitArray *concreteMask;
+  PagedBitArray *concreteMask;
 
   // mutable because may need flushed during read of const
-  mutable BitArray *flushMask;
+  mutable PagedBitArray *flushMask;
 
-  ref<Expr> *knownSymbolics;
+  PagedArray<ref<Expr> > *knownSymbolics;
 
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// The size of the updates when they were last compacted.
+  mutable unsigned compactedUpdates;
+
+  /// A hash of the contents and the symbolic arrays they refer to,
+  /// computed on first use after the contents change.
+  mutable std::uint64_t contentHash;
+  mutable std::vector<const Array *> contentArrays;
+  mutable bool contentSummaryValid;
+
 public:
   unsigned size;
 
@@ -193,6 +268,11 @@ public:
   void initializeToZero();
   // make contents all concrete and random
   void initializeToRandom();
+  /// Make contents all concrete and those of \a contents, computed only
+  /// once the contents are first accessed.
+  void initializeLazily(std::shared_ptr<LazyContents> contents);
+  /// Whether the contents are still to be materialized.
+  bool isLazy() const { return lazyContents != nullptr; }
 
   ref<Expr> read(ref<Expr> offset, Expr::Width width) const;
   ref<Expr> read(unsigned offset, Expr::Width width) const;
@@ -202,22 +282,62 @@ public:
   void write(unsigned offset, ref<Expr> value);
   void write(ref<Expr> offset, ref<Expr> value);
 
+  /// Makes the contents those of `src`, an object state of the same size,
+  /// sharing its pages and update list instead of copying byte by byte.
+  void copyFrom(const ObjectState &src);
+
+  /// Copies the leading concrete bytes of [offset, offset + count) to
+  /// \a dst, checking the concrete mask a word at a time.
+  /// \return the number of bytes copied.
+  unsigned readConcretePrefix(unsigned offset, unsigned count,
+                              uint8_t *dst) const;
+
   void write8(unsigned offset, uint8_t value);
   void write16(unsigned offset, uint16_t value);
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
   void print() const;
 
+  /// Adds the memory held by this object state to \a footprint, skipping
+  /// the parts recorded in \a seen and recording the others. \a exclusive
+  /// tells whether the address space holding it is not shared.
+  void addFootprint(StateFootprint &footprint,
+                    std::unordered_set<const void *> &seen,
+                    bool exclusive) const;
+
+  /// Returns a hash of the contents. Different representations of the
+  /// same contents, as left by flushes, may hash differently.
+  std::uint64_t getContentHash() const;
+
+  /// Returns the symbolic arrays the contents refer to.
+  const std::vector<const Array *> &getSymbolicArrays() const;
+
   /*
     Looks at all the symbolic bytes of this object, gets a value for them
     from the solver and puts them in the concreteStore.
   */
   void flushToConcreteStore(TimingSolver *solver,
                             const ExecutionState &state) const;
+  /// Likewise, with the values of the bytes in \a model, which binds the
+  /// arrays they read.
+  void flushToConcreteStore(Assignment &model) const;
+  /// Appends the symbolic bytes flushToConcreteStore() concretizes.
+  void getKnownSymbolicBytes(std::vector<ref<Expr> > &bytes) const;
 
 private:
+  /// Returns the concrete store, materializing the lazy contents first.
+  PagedArray<uint8_t> &getConcreteStore() const {
+    if (lazyContents)
+      materialize();
+    return concreteStore;
+  }
+  void materialize() const;
+
   const UpdateList &getUpdates() const;
 
+  void computeContentSummary() const;
+  void invalidateContentSummary() const { contentSummaryValid = false; }
+
   void makeConcrete();
 
   void makeSymbolic();
@@ -231,6 +351,12 @@ private:
   void flushRangeForRead(unsigned rangeBase, unsigned rangeSize) const;
   void flushRangeForWrite(unsigned rangeBase, unsigned rangeSize);
 
+  /// Writes the lowest `NumBytes` bytes of the concrete `value`.
+  void writeConcrete(unsigned offset, uint64_t value, unsigned NumBytes);
+
+  bool isRangeConcrete(unsigned offset, unsigned count) const;
+  void clearKnownSymbolics(unsigned offset, unsigned count);
+
   bool isByteConcrete(unsigned offset) const;
   bool isByteFlushed(unsigned offset) const;
   bool isByteKnownSymbolic(unsigned offset) const;
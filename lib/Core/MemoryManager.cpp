@@ -19,6 +19,7 @@
 
 #include <inttypes.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 using namespace klee;
 
@@ -55,19 +56,62 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
     llvm::cl::desc("Start address for deterministic allocation. Has to be page "
                    "aligned (default=0x7ff30000000)"),
     llvm::cl::init(0x7ff30000000), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<bool> VirtualAllocation(
+    "allocate-virtual",
+    llvm::cl::desc("Take the addresses of objects from a reserved range which "
+                   "is only backed by memory once an object is passed to an "
+                   "external call, instead of from malloc. The range is that "
+                   "of --allocate-determ if enabled (default=false)"),
+    llvm::cl::init(false), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<unsigned> VirtualAllocationSize(
+    "allocate-virtual-size",
+    llvm::cl::desc("Size of the range reserved for --allocate-virtual in GB, "
+                   "without --allocate-determ (default=64)"),
+    llvm::cl::init(64), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<unsigned> AllocaPoolSize(
+    "alloca-pool-size",
+    llvm::cl::desc("Number of objects of dead stack allocations kept per "
+                   "allocation site, with their addresses, for the next "
+                   "allocations at the site to reuse. 0 disables it "
+                   "(default=4)"),
+    llvm::cl::init(4), llvm::cl::cat(MemoryCat));
+
+/// Rounds \a value up to a multiple of \a alignment, a power of two.
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
 } // namespace
 
 /***/
-MemoryManager::MemoryManager(ArrayCache *_arrayCache)
+MemoryManager::MemoryManager(ArrayCache *_arrayCache, bool _sharedSpace)
     : arrayCache(_arrayCache), deterministicSpace(0), nextFreeSlot(0),
-      spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024) {
-  if (DeterministicAllocation) {
+      spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024),
+      usedDeterministicSize(0), numCommittedPages(0),
+      pageSize(sysconf(_SC_PAGESIZE)), sharedSpace(_sharedSpace) {
+  if (sharedSpace && !DeterministicAllocation && !VirtualAllocation)
+    klee_error("Sharing the memory of the objects requires --allocate-determ "
+               "or --allocate-virtual");
+  if (DeterministicAllocation || VirtualAllocation) {
     // Page boundary
-    void *expectedAddress = (void *)DeterministicStartAddress.getValue();
+    void *expectedAddress = nullptr;
+    if (DeterministicAllocation)
+      expectedAddress = (void *)DeterministicStartAddress.getValue();
+    else
+      spaceSize = (size_t)VirtualAllocationSize.getValue() << 30;
 
-    char *newSpace =
-        (char *)mmap(expectedAddress, spaceSize, PROT_READ | PROT_WRITE,
-                     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    // The virtual space is only reserved, pages are made accessible when
+    // an external call needs them. A shared space is accessible from the
+    // start, as protecting its pages later would not reach the processes
+    // which share it.
+    char *newSpace = (char *)mmap(
+        expectedAddress, spaceSize,
+        VirtualAllocation && !sharedSpace ? PROT_NONE : PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | (sharedSpace ? MAP_SHARED : MAP_PRIVATE) |
+            (VirtualAllocation ? MAP_NORESERVE : 0),
+        -1, 0);
 
     if (newSpace == MAP_FAILED) {
       klee_error("Couldn't mmap() memory for deterministic allocations");
@@ -76,22 +120,26 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
       klee_error("Could not allocate memory deterministically");
     }
 
-    klee_message("Deterministic memory allocation starting from %p", newSpace);
+    if (DeterministicAllocation)
+      klee_message("Deterministic memory allocation starting from %p",
+                   newSpace);
     deterministicSpace = newSpace;
     nextFreeSlot = newSpace;
+    if (VirtualAllocation)
+      committedPages.resize(spaceSize / pageSize);
   }
 }
 
 MemoryManager::~MemoryManager() {
   while (!objects.empty()) {
     MemoryObject *mo = *objects.begin();
-    if (!mo->isFixed && !DeterministicAllocation)
+    if (!mo->isFixed && !deterministicSpace)
       free((void *)mo->address);
     objects.erase(mo);
     delete mo;
   }
 
-  if (DeterministicAllocation)
+  if (deterministicSpace)
     munmap(deterministicSpace, spaceSize);
 }
 
@@ -113,26 +161,28 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
     return 0;
   }
 
-  uint64_t address = 0;
-  if (DeterministicAllocation) {
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
-    address = llvm::alignTo((uint64_t)nextFreeSlot + alignment - 1, alignment);
-#else
-    address = llvm::RoundUpToAlignment((uint64_t)nextFreeSlot + alignment - 1,
-                                       alignment);
-#endif
-
-    // Handle the case of 0-sized allocations as 1-byte allocations.
-    // This way, we make sure we have this allocation between its own red zones
-    size_t alloc_size = std::max(size, (uint64_t)1);
-    if ((char *)address + alloc_size < deterministicSpace + spaceSize) {
-      nextFreeSlot = (char *)address + alloc_size + RedzoneSize;
-    } else {
-      klee_warning_once(0, "Couldn't allocate %" PRIu64
-                           " bytes. Not enough deterministic space left.",
-                        size);
-      address = 0;
+  // take over a dead object of the site which fits
+  if (isLocal && allocSite) {
+    auto pool = localPools.find(allocSite);
+    if (pool != localPools.end()) {
+      std::vector<MemoryObject *> &free = pool->second;
+      for (auto it = free.begin(), ie = free.end(); it != ie; ++it) {
+        MemoryObject *mo = *it;
+        if (mo->size != size || mo->address % alignment)
+          continue;
+        free.erase(it);
+        mo->reset();
+        ++stats::allocations;
+        ++stats::reusedAllocations;
+        stats::allocatedBytes += size;
+        return mo;
+      }
     }
+  }
+
+  uint64_t address = 0;
+  if (deterministicSpace) {
+    address = allocateInSpace(size, alignment);
   } else {
     // Use malloc for the standard case
     if (alignment <= 8)
@@ -150,12 +200,63 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
     return 0;
 
   ++stats::allocations;
+  stats::allocatedBytes += size;
   MemoryObject *res = new MemoryObject(address, size, isLocal, isGlobal, false,
                                        allocSite, this);
   objects.insert(res);
   return res;
 }
 
+size_t MemoryManager::getSlotSize(uint64_t size) {
+  // Handle the case of 0-sized allocations as 1-byte allocations.
+  // This way, we make sure we have this allocation between its own red zones
+  uint64_t needed = std::max(size, (uint64_t)1) + RedzoneSize;
+  if (needed <= 128)
+    return alignUp(needed, 16);
+  // four classes per power of two, wasting at most a fifth of a slot
+  uint64_t step = uint64_t(1) << (llvm::Log2_64(needed - 1) - 2);
+  return alignUp(needed, step);
+}
+
+uint64_t MemoryManager::allocateInSpace(uint64_t size, size_t alignment) {
+  if (size >= spaceSize) {
+    klee_warning_once(0, "Couldn't allocate %" PRIu64
+                         " bytes. Not enough deterministic space left.",
+                      size);
+    return 0;
+  }
+  size_t slotSize = getSlotSize(size);
+
+  // Reuse the lowest free slot of the size which is aligned enough, slots
+  // being aligned to at least 16 bytes.
+  auto slots = freeSlots.find(slotSize);
+  if (slots != freeSlots.end()) {
+    for (auto it = slots->second.begin(), ie = slots->second.end(); it != ie;
+         ++it) {
+      if (*it % alignment)
+        continue;
+      uint64_t address = *it;
+      slots->second.erase(it);
+      if (slots->second.empty())
+        freeSlots.erase(slots);
+      usedDeterministicSize += slotSize;
+      return address;
+    }
+  }
+
+  uint64_t address = alignUp((uint64_t)nextFreeSlot + alignment - 1,
+                             std::max(alignment, (size_t)16));
+  if ((char *)address + slotSize > deterministicSpace + spaceSize) {
+    klee_warning_once(0, "Couldn't allocate %" PRIu64
+                         " bytes. Not enough deterministic space left.",
+                      size);
+    return 0;
+  }
+  nextFreeSlot = (char *)address + slotSize;
+  usedDeterministicSize += slotSize;
+  return address;
+}
+
 MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
                                            const llvm::Value *allocSite) {
 #ifndef NDEBUG
@@ -168,6 +269,7 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
 #endif
 
   ++stats::allocations;
+  stats::allocatedBytes += size;
   MemoryObject *res =
       new MemoryObject(address, size, false, true, true, allocSite, this);
   objects.insert(res);
@@ -178,12 +280,57 @@ void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end()) {
-    if (!mo->isFixed && !DeterministicAllocation)
+    if (!mo->isFixed && !deterministicSpace)
       free((void *)mo->address);
+    if (!mo->isFixed && deterministicSpace) {
+      size_t slotSize = getSlotSize(mo->size);
+      freeSlots[slotSize].insert(mo->address);
+      usedDeterministicSize -= slotSize;
+    }
     objects.erase(mo);
   }
 }
 
+bool MemoryManager::recycle(MemoryObject *mo) {
+  if (!mo->isLocal || mo->isFixed || !mo->allocSite ||
+      objects.find(mo) == objects.end())
+    return false;
+  std::vector<MemoryObject *> &free = localPools[mo->allocSite];
+  if (free.size() >= AllocaPoolSize)
+    return false;
+  free.push_back(mo);
+  return true;
+}
+
+void MemoryManager::commit(const MemoryObject *mo) {
+  if (!VirtualAllocation || mo->isFixed || !mo->size)
+    return;
+  assert((char *)mo->address >= deterministicSpace &&
+         (char *)mo->address + mo->size <= deterministicSpace + spaceSize &&
+         "object outside of the virtual space");
+  size_t first = ((char *)mo->address - deterministicSpace) / pageSize;
+  size_t last = ((char *)mo->address + mo->size - 1 - deterministicSpace) /
+                pageSize;
+  // one call for each run of pages not yet accessible
+  for (size_t page = first; page <= last;) {
+    if (committedPages[page]) {
+      ++page;
+      continue;
+    }
+    size_t end = page;
+    while (end <= last && !committedPages[end])
+      committedPages[end++] = true;
+    if (!sharedSpace && mprotect(deterministicSpace + page * pageSize,
+                                 (end - page) * pageSize,
+                                 PROT_READ | PROT_WRITE))
+      klee_error("Couldn't back memory for an external call");
+    numCommittedPages += end - page;
+    page = end;
+  }
+}
+
 size_t MemoryManager::getUsedDeterministicSize() {
-  return nextFreeSlot - deterministicSpace;
+  if (VirtualAllocation)
+    return numCommittedPages * pageSize;
+  return usedDeterministicSize;
 }
@@ -11,8 +11,11 @@
 #define KLEE_MEMORYMANAGER_H
 
 #include <cstddef>
+#include <map>
 #include <set>
 #include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 namespace llvm {
 class Value;
@@ -28,12 +31,44 @@ private:
   objects_ty objects;
   ArrayCache *const arrayCache;
 
+  /// The space the objects are allocated in with --allocate-determ or
+  /// --allocate-virtual, null when they are allocated with malloc.
   char *deterministicSpace;
   char *nextFreeSlot;
   size_t spaceSize;
 
+  /// The free slots of the space by slot size, each ordered by address so
+  /// that the lowest one is reused first. This keeps the addresses a
+  /// function of the allocations and frees only.
+  std::map<size_t, std::set<uint64_t> > freeSlots;
+  /// The bytes of the slots of live objects.
+  size_t usedDeterministicSize;
+
+  /// With --allocate-virtual, the pages of the space which were made
+  /// accessible, and their number.
+  std::vector<bool> committedPages;
+  size_t numCommittedPages;
+  size_t pageSize;
+
+  /// Whether the space is shared with the processes forked from this one,
+  /// which then see the memory of the objects.
+  bool sharedSpace;
+
+  /// The objects of stack allocations which nothing refers to any more,
+  /// by allocation site. They keep their addresses, for the next
+  /// allocation of the same size at the site to take over.
+  std::unordered_map<const llvm::Value *, std::vector<MemoryObject *> >
+      localPools;
+
+  /// The size class of the slot holding an object of \a size bytes and
+  /// the red zone after it.
+  static size_t getSlotSize(uint64_t size);
+  uint64_t allocateInSpace(uint64_t size, size_t alignment);
+
 public:
-  MemoryManager(ArrayCache *arrayCache);
+  /// With \a sharedSpace, the objects are allocated in memory which
+  /// processes forked later share, as the process of external calls needs.
+  MemoryManager(ArrayCache *arrayCache, bool sharedSpace = false);
   ~MemoryManager();
 
   /**
@@ -46,10 +81,19 @@ public:
                               const llvm::Value *allocSite);
   void deallocate(const MemoryObject *mo);
   void markFreed(MemoryObject *mo);
+  /// Takes back \a mo, which nothing refers to any more, to reuse it for
+  /// a later allocation. Returns false if it is to be deleted instead.
+  bool recycle(MemoryObject *mo);
   ArrayCache *getArrayCache() const { return arrayCache; }
 
+  /// Backs the host memory at the address of \a mo, which is about to be
+  /// handed to an external call. Only needed with --allocate-virtual.
+  void commit(const MemoryObject *mo);
+
   /*
-   * Returns the size used by deterministic allocation in bytes
+   * Returns the size used by deterministic allocation in bytes: that of the
+   * slots of the live objects, or with --allocate-virtual that of the
+   * pages backed for external calls
    */
   size_t getUsedDeterministicSize();
 };
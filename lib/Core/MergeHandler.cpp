@@ -89,32 +89,21 @@ void MergeHandler::addClosedState(ExecutionState *es,
   // Remove from openStates
   removeOpenState(es);
 
-  auto closePoint = reachedCloseMerge.find(mp);
-
-  // If no other state has yet encountered this klee_close_merge instruction,
-  // add a new element to the map
-  if (closePoint == reachedCloseMerge.end()) {
-    reachedCloseMerge[mp].push_back(es);
-    executor->pauseState(*es);
-  } else {
-    // Otherwise try to merge with any state in the map element for this
-    // instruction
-    auto &cpv = closePoint->second;
-    bool mergedSuccessful = false;
-
-    for (auto& mState: cpv) {
-      if (mState->merge(*es)) {
-        executor->terminateState(*es);
-        executor->inCloseMerge.erase(es);
-        mergedSuccessful = true;
-        break;
-      }
-    }
-    if (!mergedSuccessful) {
-      cpv.push_back(es);
-      executor->pauseState(*es);
+  // Only states with the same fingerprint can be merged, and apart from
+  // hash collisions the first of them will do.
+  auto &candidates = closedByFingerprint[mp];
+  uint64_t fingerprint = es->getMergeFingerprint();
+  auto range = candidates.equal_range(fingerprint);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->merge(*es)) {
+      executor->terminateState(*es);
+      executor->inCloseMerge.erase(es);
+      return;
     }
   }
+  candidates.emplace(fingerprint, es);
+  reachedCloseMerge[mp].push_back(es);
+  executor->pauseState(*es);
 }
 
 void MergeHandler::releaseStates() {
@@ -125,15 +114,17 @@ void MergeHandler::releaseStates() {
     }
   }
   reachedCloseMerge.clear();
+  closedByFingerprint.clear();
 }
 
 bool MergeHandler::hasMergedStates() {
   return (!reachedCloseMerge.empty());
 }
 
-MergeHandler::MergeHandler(Executor *_executor, ExecutionState *es)
+MergeHandler::MergeHandler(Executor *_executor, ExecutionState *es,
+                           KInstruction *autoClose)
     : executor(_executor), openInstruction(es->steppedInstructions),
-      closedMean(0), closedStateCount(0), refCount(0) {
+      closedMean(0), closedStateCount(0), autoClose(autoClose), refCount(0) {
   executor->mergeGroups.push_back(this);
   addOpenState(es);
 }
@@ -0,0 +1,210 @@
+//===-- MetricsServer.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MetricsServer.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Statistics.h"
+
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// QueryTime becomes query_time.
+std::string metricName(const std::string &name) {
+  std::string result = "klee_";
+  for (size_t i = 0; i != name.size(); ++i) {
+    if (i && isupper(name[i]) && islower(name[i - 1]))
+      result += '_';
+    result += tolower(name[i]);
+  }
+  return result;
+}
+
+void writeAll(int fd, const std::string &s) {
+  for (size_t done = 0; done != s.size();) {
+    ssize_t n = ::send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return; // the client went away
+    done += n;
+  }
+}
+} // namespace
+
+MetricsServer::Gauges::Gauges() {
+  for (auto &counts : latencyCounts)
+    for (auto &count : counts)
+      count = 0;
+  for (auto &time : latencyTime)
+    time = 0;
+}
+
+MetricsServer::MetricsServer(const std::string &socketPath, unsigned port)
+    : socketPath(socketPath) {
+  if (!socketPath.empty()) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+      klee_error("Metrics socket path is too long: %s", socketPath.c_str());
+    strcpy(addr.sun_path, socketPath.c_str());
+    ::unlink(socketPath.c_str());
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 ||
+        ::bind(listener, (sockaddr *)&addr, sizeof(addr)) < 0)
+      klee_error("Unable to bind metrics socket %s: %s", socketPath.c_str(),
+                 strerror(errno));
+  } else {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (listener >= 0)
+      ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (listener < 0 ||
+        ::bind(listener, (sockaddr *)&addr, sizeof(addr)) < 0)
+      klee_error("Unable to bind metrics port %u: %s", port, strerror(errno));
+  }
+  if (::listen(listener, 16) < 0 || ::pipe2(wakeup, O_CLOEXEC) < 0)
+    klee_error("Unable to listen for metrics requests: %s", strerror(errno));
+  thread = std::thread(&MetricsServer::run, this);
+}
+
+MetricsServer::~MetricsServer() {
+  char c = 0;
+  while (::write(wakeup[1], &c, 1) < 0 && errno == EINTR)
+    ;
+  thread.join();
+  ::close(listener);
+  ::close(wakeup[0]);
+  ::close(wakeup[1]);
+  if (!socketPath.empty())
+    ::unlink(socketPath.c_str());
+}
+
+void MetricsServer::run() {
+  for (;;) {
+    pollfd fds[2] = {{listener, POLLIN, 0}, {wakeup[0], POLLIN, 0}};
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (fds[0].revents & POLLIN) {
+      int connection = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (connection >= 0) {
+        serve(connection);
+        ::close(connection);
+      }
+    }
+  }
+}
+
+void MetricsServer::serve(int connection) {
+  // Reads the request up to the end of its headers, giving up on a client
+  // which does not send it promptly. Every path gets the metrics.
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.find("\n\n") == std::string::npos && request.size() < 8192) {
+    pollfd fd = {connection, POLLIN, 0};
+    if (::poll(&fd, 1, 1000) <= 0)
+      return;
+    ssize_t n = ::recv(connection, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    request.append(buffer, n);
+  }
+
+  std::string body = render();
+  std::ostringstream response;
+  response << "HTTP/1.0 200 OK\r\n"
+           << "Content-Type: text/plain; version=0.0.4\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: close\r\n\r\n"
+           << body;
+  writeAll(connection, response.str());
+}
+
+std::string MetricsServer::render() {
+  std::ostringstream os;
+  StatisticManager &sm = *theStatisticManager;
+  for (unsigned i = 0; i < sm.getNumStatistics(); i++) {
+    Statistic &s = sm.getStatistic(i);
+    std::string name = metricName(s.getName());
+    os << "# HELP " << name << " The " << s.getName() << " statistic.\n"
+       << "# TYPE " << name << " counter\n"
+       << name << " " << sm.getValue(s) << "\n";
+  }
+
+  os << "# HELP klee_states The number of states.\n"
+     << "# TYPE klee_states gauge\n"
+     << "klee_states " << gauges.states.load(std::memory_order_relaxed)
+     << "\n";
+  os << "# HELP klee_malloc_usage_bytes The memory allocated by malloc.\n"
+     << "# TYPE klee_malloc_usage_bytes gauge\n"
+     << "klee_malloc_usage_bytes "
+     << gauges.mallocUsage.load(std::memory_order_relaxed) << "\n";
+  os << "# HELP klee_deterministic_usage_bytes The memory used in the "
+        "deterministic allocator.\n"
+     << "# TYPE klee_deterministic_usage_bytes gauge\n"
+     << "klee_deterministic_usage_bytes "
+     << gauges.deterministicUsage.load(std::memory_order_relaxed) << "\n";
+
+  // Bucket i holds the queries taking less than 10^(i+1)us.
+  os << "# HELP klee_query_latency_seconds The time taken by solver queries, "
+        "by the operation issuing them.\n"
+     << "# TYPE klee_query_latency_seconds histogram\n";
+  for (unsigned o = 0; o != TimingSolver::NumQueryOrigins; ++o) {
+    const char *origin =
+        TimingSolver::getOriginName((TimingSolver::QueryOrigin)o);
+    uint64_t count = 0;
+    for (unsigned b = 0; b != TimingSolver::NumLatencyBuckets; ++b) {
+      count += gauges.latencyCounts[o][b].load(std::memory_order_relaxed);
+      os << "klee_query_latency_seconds_bucket{origin=\"" << origin
+         << "\",le=\"";
+      if (b + 1 == TimingSolver::NumLatencyBuckets)
+        os << "+Inf";
+      else
+        os << "1e" << (int)b - 5;
+      os << "\"} " << count << "\n";
+    }
+    uint64_t time = gauges.latencyTime[o].load(std::memory_order_relaxed);
+    char sum[32];
+    snprintf(sum, sizeof(sum), "%llu.%06llu",
+             (unsigned long long)(time / 1000000),
+             (unsigned long long)(time % 1000000));
+    os << "klee_query_latency_seconds_sum{origin=\"" << origin << "\"} "
+       << sum << "\n"
+       << "klee_query_latency_seconds_count{origin=\"" << origin << "\"} "
+       << count << "\n";
+  }
+  return os.str();
+}
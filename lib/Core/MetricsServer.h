@@ -0,0 +1,70 @@
+//===-- MetricsServer.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_METRICSSERVER_H
+#define KLEE_METRICSSERVER_H
+
+#include "TimingSolver.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace klee {
+  /// Serves the global statistics and a few gauges over HTTP, in the
+  /// Prometheus text format, on a thread of its own.
+  ///
+  /// The statistics are read directly, as their global values may be read
+  /// from any thread. The gauges are only updated by the interpreter, with
+  /// publish(), so that serving a scrape never waits for nor interrupts it.
+  class MetricsServer {
+  public:
+    struct Gauges {
+      /// The states the searcher selects from.
+      std::atomic<uint64_t> states{0};
+      std::atomic<uint64_t> mallocUsage{0};
+      std::atomic<uint64_t> deterministicUsage{0};
+      /// The query latency histograms, summed over instructions, in the
+      /// buckets of TimingSolver::LatencyHistogram.
+      std::atomic<uint64_t>
+          latencyCounts[TimingSolver::NumQueryOrigins]
+                       [TimingSolver::NumLatencyBuckets];
+      std::atomic<uint64_t> latencyTime[TimingSolver::NumQueryOrigins];
+
+      Gauges();
+    };
+
+  private:
+    int listener;
+    /// Written to by the destructor to stop the thread.
+    int wakeup[2];
+    std::string socketPath;
+    Gauges gauges;
+    std::thread thread;
+
+    void run();
+    void serve(int connection);
+    std::string render();
+
+  public:
+    /// Listens on the Unix socket \a socketPath if it is not empty, else
+    /// on \a port of the loopback interface. Exits with an error if it
+    /// cannot.
+    MetricsServer(const std::string &socketPath, unsigned port);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    Gauges &getGauges() { return gauges; }
+  };
+}
+
+#endif
@@ -0,0 +1,132 @@
+//===-- ModelTrie.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ModelTrie.h"
+
+#include "klee/util/Assignment.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace klee;
+
+// The paths are as long as the constraint lists, so the trie is walked
+// without recursion.
+
+ModelTrie::~ModelTrie() {
+  for (auto &child : root.children)
+    destroy(child.second);
+}
+
+void ModelTrie::destroy(Node *n) {
+  std::vector<Node *> pending(1, n);
+  while (!pending.empty()) {
+    Node *p = pending.back();
+    pending.pop_back();
+    for (auto &child : p->children)
+      pending.push_back(child.second);
+    --numNodes;
+    delete p;
+  }
+}
+
+void ModelTrie::record(const ConstraintManager &constraints,
+                       const std::shared_ptr<Assignment> &model) {
+  ++clock;
+  Node *n = &root;
+  n->model = model;
+  n->stamp = clock;
+  for (const ref<Expr> &constraint : constraints) {
+    Node *&child = n->children[constraint];
+    if (!child) {
+      child = new Node();
+      ++numNodes;
+    }
+    n = child;
+    n->model = model;
+    n->stamp = clock;
+  }
+
+  if (numNodes > maxNodes) {
+    // drop about the older half of the nodes
+    std::vector<uint64_t> stamps;
+    stamps.reserve(numNodes);
+    collectStamps(root, stamps);
+    std::nth_element(stamps.begin(), stamps.begin() + stamps.size() / 2,
+                     stamps.end());
+    prune(root, stamps[stamps.size() / 2]);
+    // a single path may be longer than the trie allows
+    if (numNodes > maxNodes) {
+      for (auto &child : root.children)
+        destroy(child.second);
+      root.children.clear();
+    }
+  }
+}
+
+std::shared_ptr<Assignment>
+ModelTrie::lookup(const ConstraintManager &constraints) {
+  std::vector<Node *> path(1, &root);
+  auto it = constraints.begin(), ie = constraints.end();
+  for (; it != ie; ++it) {
+    auto child = path.back()->children.find(*it);
+    if (child == path.back()->children.end())
+      break;
+    path.push_back(child->second);
+  }
+  const std::shared_ptr<Assignment> &model = path.back()->model;
+  if (!model)
+    return nullptr;
+
+  // The model satisfies the constraints up to the node, and must be
+  // checked against the others.
+  for (; it != ie; ++it) {
+    ref<Expr> value = model->evaluate(*it);
+    if (!isa<ConstantExpr>(value) || !cast<ConstantExpr>(value)->isTrue())
+      return nullptr;
+  }
+
+  ++clock;
+  for (Node *n : path)
+    n->stamp = clock;
+  return model;
+}
+
+void ModelTrie::collectStamps(const Node &n,
+                              std::vector<uint64_t> &stamps) const {
+  std::vector<const Node *> pending(1, &n);
+  while (!pending.empty()) {
+    const Node *p = pending.back();
+    pending.pop_back();
+    for (const auto &child : p->children) {
+      stamps.push_back(child.second->stamp);
+      pending.push_back(child.second);
+    }
+  }
+}
+
+void ModelTrie::prune(Node &n, uint64_t cutoff) {
+  std::vector<Node *> pending(1, &n);
+  std::vector<ref<Expr> > cold;
+  while (!pending.empty()) {
+    Node *p = pending.back();
+    pending.pop_back();
+    cold.clear();
+    for (auto &child : p->children) {
+      if (child.second->stamp < cutoff)
+        cold.push_back(child.first);
+      else
+        pending.push_back(child.second);
+    }
+    for (const ref<Expr> &constraint : cold) {
+      destroy(p->children.find(constraint)->second);
+      p->children.erase(constraint);
+    }
+  }
+}
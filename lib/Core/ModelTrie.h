@@ -0,0 +1,70 @@
+//===-- ModelTrie.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_MODELTRIE_H
+#define KLEE_MODELTRIE_H
+
+#include "klee/Constraints.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace klee {
+  class Assignment;
+
+  /// A trie of constraint sequences. The constraints of a state extend
+  /// those of its parent, so the paths of the trie follow the process tree,
+  /// and each node keeps the last model found for a state whose constraints
+  /// start with the node's.
+  ///
+  /// A state which lost its model gets the one at the deepest node its
+  /// constraints reach, if that model satisfies the constraints past it.
+  ///
+  /// The trie is kept to a number of nodes by dropping the subtrees which
+  /// were used the longest ago.
+  class ModelTrie {
+    struct Node {
+      ExprHashMap<Node *> children;
+      std::shared_ptr<Assignment> model;
+      /// When a model was last recorded or found through the node; never
+      /// older than those of its children.
+      uint64_t stamp = 0;
+    };
+
+    Node root;
+    size_t numNodes = 0;
+    size_t maxNodes;
+    uint64_t clock = 0;
+
+    void destroy(Node *n);
+    /// Drops the subtrees below \a n last used before \a cutoff.
+    void prune(Node &n, uint64_t cutoff);
+    void collectStamps(const Node &n, std::vector<uint64_t> &stamps) const;
+
+  public:
+    explicit ModelTrie(size_t maxNodes) : maxNodes(maxNodes) {}
+    ~ModelTrie();
+
+    ModelTrie(const ModelTrie &) = delete;
+    ModelTrie &operator=(const ModelTrie &) = delete;
+
+    /// Records a model satisfying the constraints.
+    void record(const ConstraintManager &constraints,
+                const std::shared_ptr<Assignment> &model);
+
+    /// Returns a recorded model satisfying the constraints, or null.
+    std::shared_ptr<Assignment> lookup(const ConstraintManager &constraints);
+
+    size_t size() const { return numNodes; }
+  };
+}
+
+#endif
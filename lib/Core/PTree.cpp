@@ -9,42 +9,110 @@
 
 #include "PTree.h"
 
+#include "CoreStats.h"
+
+#include <klee/ExecutionState.h>
 #include <klee/Expr.h>
+#include <klee/Internal/Module/InstructionInfoTable.h>
+#include <klee/Internal/Module/KInstruction.h>
+#include <klee/Internal/Support/PTreeLog.h>
 #include <klee/util/ExprPPrinter.h>
 
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+
 #include <vector>
 
 using namespace klee;
 
   /* *** */
 
-PTree::PTree(const data_type &root) : root(new Node(nullptr, root)) {}
+namespace {
+/// The number of nodes in a chunk of the node pool.
+const size_t ChunkSize = 4096;
+}
+
+PTree::PTree(const data_type &root, ptreelog::Writer *log)
+    : root(allocate(nullptr, root)), log(log) {
+  if (log)
+    log->tree(this->root, stats::instructions);
+}
+
+PTreeNode *PTree::allocate(Node *parent, data_type data) {
+  Node *n;
+  if (freeNodes) {
+    n = freeNodes;
+    freeNodes = n->parent;
+  } else {
+    if (chunks.empty() || chunkUsed == ChunkSize) {
+      chunks.emplace_back(new Node[ChunkSize]);
+      chunkUsed = 0;
+    }
+    n = &chunks.back()[chunkUsed++];
+  }
+  n->parent = parent;
+  n->setData(data);
+  return n;
+}
+
+void PTree::release(Node *n) {
+  n->left = nullptr;
+  n->rightOrData = 0;
+  n->parent = freeNodes;
+  freeNodes = n;
+}
 
 std::pair<PTreeNode*, PTreeNode*>
 PTree::split(Node *n, 
              const data_type &leftData, 
              const data_type &rightData) {
-  assert(n && !n->left && !n->right);
-  n->left = new Node(n, leftData);
-  n->right = new Node(n, rightData);
-  return std::make_pair(n->left, n->right);
+  assert(n && n->isLeaf());
+  n->left = allocate(n, leftData);
+  n->setRight(allocate(n, rightData));
+  if (log)
+    logSplit(n, leftData);
+  return std::make_pair(n->left, n->getRight());
+}
+
+void PTree::logSplit(Node *n, const data_type &data) {
+  // the instruction forking, which both states have just executed
+  unsigned site = 0;
+  if (const KInstruction *ki = data->prevPC) {
+    site = ki->info->id + 1;
+    if (!log->isDescribed(site))
+      log->describe(site, ki->inst->getParent()->getParent()->getName().str(),
+                    ki->info->file, ki->info->line);
+  }
+  log->split(n, n->left, n->getRight(), site, stats::instructions);
 }
 
 void PTree::remove(Node *n) {
-  assert(!n->left && !n->right);
-  do {
-    Node *p = n->parent;
-    if (p) {
-      if (n == p->left) {
-        p->left = nullptr;
-      } else {
-        assert(n == p->right);
-        p->right = nullptr;
-      }
-    }
-    delete n;
-    n = p;
-  } while (n && !n->left && !n->right);
+  assert(n->isLeaf());
+  if (log)
+    log->remove(n, stats::instructions);
+  Node *p = n->parent;
+  release(n);
+  if (!p) {
+    root = nullptr;
+    return;
+  }
+
+  // Inner nodes always have two children, so the sibling takes the place
+  // of the parent. Random path selection then only walks branch points,
+  // and the expected length of its walk is at most log2 of the number of
+  // states (the entropy of the distribution it samples).
+  Node *sibling = n == p->left ? p->getRight() : p->left;
+  assert(sibling && (n == p->left || n == p->getRight()));
+  Node *g = p->parent;
+  sibling->parent = g;
+  if (!g) {
+    root = sibling;
+  } else if (p == g->left) {
+    g->left = sibling;
+  } else {
+    g->setRight(sibling);
+  }
+  release(p);
 }
 
 void PTree::dump(llvm::raw_ostream &os) {
@@ -58,27 +126,25 @@ void PTree::dump(llvm::raw_ostream &os) {
   os << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n";
   os << "\tedge [arrowsize=.3]\n";
   std::vector<PTree::Node*> stack;
-  stack.push_back(root);
+  if (root)
+    stack.push_back(root);
   while (!stack.empty()) {
     PTree::Node *n = stack.back();
     stack.pop_back();
     os << "\tn" << n << " [shape=diamond";
-    if (n->data)
+    if (n->getData())
       os << ",fillcolor=green";
     os << "];\n";
-    if (n->left) {
-      os << "\tn" << n << " -> n" << n->left << ";\n";
-      stack.push_back(n->left);
+    if (PTree::Node *left = n->getLeft()) {
+      os << "\tn" << n << " -> n" << left << ";\n";
+      stack.push_back(left);
     }
-    if (n->right) {
-      os << "\tn" << n << " -> n" << n->right << ";\n";
-      stack.push_back(n->right);
+    if (PTree::Node *right = n->getRight()) {
+      os << "\tn" << n << " -> n" << right << ";\n";
+      stack.push_back(right);
     }
   }
   os << "}\n";
   delete pp;
 }
 
-PTreeNode::PTreeNode(PTreeNode * parent, ExecutionState * data)
-  : parent{parent}, data{data} {}
-
@@ -12,8 +12,15 @@
 
 #include <klee/Expr.h>
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace klee {
   class ExecutionState;
+  namespace ptreelog {
+  class Writer;
+  }
 
   class PTree { 
     typedef ExecutionState* data_type;
@@ -22,28 +29,69 @@ namespace klee {
     typedef class PTreeNode Node;
     Node *root;
 
-    explicit PTree(const data_type &_root);
+    /// \param log - Where the splits and removals are streamed to, if
+    /// not null.
+    explicit PTree(const data_type &_root, ptreelog::Writer *log = nullptr);
     ~PTree() = default;
     
+    /// Turns the leaf \a n into an inner node with two leaves holding the
+    /// given states.
     std::pair<Node*,Node*> split(Node *n,
                                  const data_type &leftData,
                                  const data_type &rightData);
     void remove(Node *n);
 
     void dump(llvm::raw_ostream &os);
+
+  private:
+    /// Nodes are allocated in chunks, so that the nodes of a path are
+    /// mostly close in memory and freeing them is cheap. Freed nodes are
+    /// linked through their parent.
+    std::vector<std::unique_ptr<Node[]> > chunks;
+    size_t chunkUsed = 0;
+    Node *freeNodes = nullptr;
+    ptreelog::Writer *log;
+
+    Node *allocate(Node *parent, data_type data);
+    void release(Node *n);
+    void logSplit(Node *n, const data_type &data);
   };
 
+  /// A node in the process tree. Leaves hold the state they stand for,
+  /// tagged in the low bit of the word inner nodes hold their right child
+  /// in, and have no left child.
   class PTreeNode {
     friend class PTree;
-  public:
+
     PTreeNode *parent = nullptr;
     PTreeNode *left = nullptr;
-    PTreeNode *right = nullptr;
-    ExecutionState *data = nullptr;
+    uintptr_t rightOrData = 0;
+
+    static const uintptr_t LeafTag = 1;
+
+  public:
+    PTreeNode() = default;
+
+    PTreeNode *getParent() const { return parent; }
+    bool isLeaf() const { return rightOrData & LeafTag; }
+    PTreeNode *getLeft() const { return left; }
+    PTreeNode *getRight() const {
+      return isLeaf() ? nullptr : reinterpret_cast<PTreeNode *>(rightOrData);
+    }
+    ExecutionState *getData() const {
+      return isLeaf()
+                 ? reinterpret_cast<ExecutionState *>(rightOrData & ~LeafTag)
+                 : nullptr;
+    }
 
   private:
-    PTreeNode(PTreeNode * parent, ExecutionState * data);
-    ~PTreeNode() = default;
+    void setRight(PTreeNode *n) {
+      rightOrData = reinterpret_cast<uintptr_t>(n);
+    }
+    void setData(ExecutionState *data) {
+      left = nullptr;
+      rightOrData = reinterpret_cast<uintptr_t>(data) | LeafTag;
+    }
   };
 }
 
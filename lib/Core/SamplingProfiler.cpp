@@ -0,0 +1,57 @@
+//===-- SamplingProfiler.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SamplingProfiler.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/time.h>
+
+using namespace klee;
+
+std::atomic<unsigned> SamplingProfiler::executingTicks(0);
+std::atomic<unsigned> SamplingProfiler::solvingTicks(0);
+std::atomic<bool> SamplingProfiler::solving(false);
+
+void SamplingProfiler::handleTick(int) {
+  // Lock-free atomics are safe to use from a signal handler.
+  (solving.load(std::memory_order_relaxed) ? solvingTicks : executingTicks)
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+SamplingProfiler::SamplingProfiler(time::Span interval) : interval(interval) {
+  executingTicks = 0;
+  solvingTicks = 0;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handleTick;
+  // Interrupted system calls are restarted, so that sampling does not make
+  // them fail with EINTR.
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr))
+    klee_error("Cannot install the SIGPROF handler: %s", strerror(errno));
+
+  struct itimerval timer;
+  timer.it_interval = static_cast<timeval>(interval);
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr))
+    klee_error("Cannot start the profiling timer: %s", strerror(errno));
+}
+
+SamplingProfiler::~SamplingProfiler() {
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  signal(SIGPROF, SIG_DFL);
+}
@@ -0,0 +1,70 @@
+//===-- SamplingProfiler.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SAMPLINGPROFILER_H
+#define KLEE_SAMPLINGPROFILER_H
+
+#include "klee/Internal/System/Time.h"
+
+#include <atomic>
+
+namespace klee {
+  /// Samples the CPU time of the process with a SIGPROF interval timer. The
+  /// signal handler only counts ticks, telling apart those taken while the
+  /// solver was running; the executor takes them between instructions and
+  /// charges them to the instruction it just executed.
+  ///
+  /// At most one profiler exists at a time.
+  class SamplingProfiler {
+    static std::atomic<unsigned> executingTicks, solvingTicks;
+    static std::atomic<bool> solving;
+
+    static void handleTick(int);
+
+    time::Span interval;
+
+  public:
+    /// Marks the solver as running while it exists.
+    class SolverScope {
+      bool outer;
+
+    public:
+      SolverScope() : outer(!solving.exchange(true)) {}
+      ~SolverScope() {
+        if (outer)
+          solving = false;
+      }
+    };
+
+    /// Starts sampling every \a interval of CPU time.
+    explicit SamplingProfiler(time::Span interval);
+    /// Stops the timer and restores the default SIGPROF handler.
+    ~SamplingProfiler();
+
+    SamplingProfiler(const SamplingProfiler &) = delete;
+    SamplingProfiler &operator=(const SamplingProfiler &) = delete;
+
+    time::Span getInterval() const { return interval; }
+
+    /// Returns true if ticks were counted since they were last taken.
+    static bool pending() {
+      return executingTicks.load(std::memory_order_relaxed) ||
+             solvingTicks.load(std::memory_order_relaxed);
+    }
+
+    /// Takes the ticks counted since the last call, outside and inside the
+    /// solver.
+    static void take(unsigned &executing, unsigned &solver) {
+      executing = executingTicks.exchange(0, std::memory_order_relaxed);
+      solver = solvingTicks.exchange(0, std::memory_order_relaxed);
+    }
+  };
+}
+
+#endif
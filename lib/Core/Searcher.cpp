@@ -12,15 +12,17 @@
 #include "CoreStats.h"
 #include "Executor.h"
 #include "PTree.h"
+#include "SearcherModel.h"
 #include "StatsTracker.h"
 
 #include "klee/ExecutionState.h"
 #include "klee/MergeHandler.h"
+#include "klee/SolverStats.h"
 #include "klee/Statistics.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
-#include "klee/Internal/ADT/DiscretePDF.h"
+#include "klee/Internal/ADT/FenwickPDF.h"
 #include "klee/Internal/ADT/RNG.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/Time.h"
@@ -53,12 +55,12 @@ ExecutionState &DFSSearcher::selectState() {
 }
 
 void DFSSearcher::update(ExecutionState *current,
-                         const std::vector<ExecutionState *> &addedStates,
-                         const std::vector<ExecutionState *> &removedStates) {
+                         llvm::ArrayRef<ExecutionState *> addedStates,
+                         llvm::ArrayRef<ExecutionState *> removedStates) {
   states.insert(states.end(),
                 addedStates.begin(),
                 addedStates.end());
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+  for (llvm::ArrayRef<ExecutionState *>::iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
@@ -89,8 +91,8 @@ ExecutionState &BFSSearcher::selectState() {
 }
 
 void BFSSearcher::update(ExecutionState *current,
-                         const std::vector<ExecutionState *> &addedStates,
-                         const std::vector<ExecutionState *> &removedStates) {
+                         llvm::ArrayRef<ExecutionState *> addedStates,
+                         llvm::ArrayRef<ExecutionState *> removedStates) {
   // Assumption: If new states were added KLEE forked, therefore states evolved.
   // constraints were added to the current state, it evolved.
   if (!addedStates.empty() && current &&
@@ -105,7 +107,7 @@ void BFSSearcher::update(ExecutionState *current,
   states.insert(states.end(),
                 addedStates.begin(),
                 addedStates.end());
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+  for (llvm::ArrayRef<ExecutionState *>::iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
@@ -137,12 +139,12 @@ ExecutionState &RandomSearcher::selectState() {
 
 void
 RandomSearcher::update(ExecutionState *current,
-                       const std::vector<ExecutionState *> &addedStates,
-                       const std::vector<ExecutionState *> &removedStates) {
+                       llvm::ArrayRef<ExecutionState *> addedStates,
+                       llvm::ArrayRef<ExecutionState *> removedStates) {
   states.insert(states.end(),
                 addedStates.begin(),
                 addedStates.end());
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+  for (llvm::ArrayRef<ExecutionState *>::iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
@@ -164,9 +166,12 @@ RandomSearcher::update(ExecutionState *current,
 
 ///
 
-WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
-  : states(new DiscretePDF<ExecutionState*>()),
-    type(_type) {
+WeightedRandomSearcher::WeightedRandomSearcher(
+    WeightType _type, Executor &_executor,
+    std::unique_ptr<SearcherModel> _model)
+  : executor(_executor), states(new FenwickPDF<ExecutionState*>()),
+    type(_type), reachableUpdates(0), model(std::move(_model)),
+    queryLatency(0.), lastSolverTime(0), lastQueries(0) {
   switch(type) {
   case Depth: 
     updateWeights = false;
@@ -176,6 +181,8 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   case QueryCost:
   case MinDistToUncovered:
   case CoveringNew:
+  case CoveragePerCost:
+  case Model:
     updateWeights = true;
     break;
   default:
@@ -210,8 +217,11 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   }
   case QueryCost:
     return (es->queryCost.toSeconds() < .1) ? 1. : 1./ es->queryCost.toSeconds();
+  case Model:
+    return model->getWeight(*es);
   case CoveringNew:
-  case MinDistToUncovered: {
+  case MinDistToUncovered:
+  case CoveragePerCost: {
     uint64_t md2u = computeMinDistToUncovered(es->pc,
                                               es->stack.back().minDistToUncoveredOnReturn);
 
@@ -221,6 +231,12 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
       if (es->instsSinceCovNew)
         invCovNew = 1. / std::max(1, (int) es->instsSinceCovNew - 1000);
       return (invCovNew * invCovNew + invMD2U * invMD2U);
+    } else if (type==CoveragePerCost) {
+      // The queries a state issued so far predict those still to come,
+      // and each of them costs at least the recent average. The floor
+      // keeps cheap states from drowning out the coverage signal.
+      double cost = es->queryCost.toSeconds() + queryLatency;
+      return invMD2U * invMD2U / std::max(cost, .001);
     } else {
       return invMD2U * invMD2U;
     }
@@ -228,26 +244,52 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   }
 }
 
+void WeightedRandomSearcher::updateQueryLatency() {
+  uint64_t solverTime = stats::solverTime, queries = stats::queries;
+  if (queries == lastQueries)
+    return;
+  double latency = (solverTime - lastSolverTime) / 1e6 /
+                   (queries - lastQueries);
+  queryLatency = lastQueries ? .9 * queryLatency + .1 * latency : latency;
+  lastSolverTime = solverTime;
+  lastQueries = queries;
+}
+
 void WeightedRandomSearcher::update(
-    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
-    const std::vector<ExecutionState *> &removedStates) {
+    ExecutionState *current, llvm::ArrayRef<ExecutionState *> addedStates,
+    llvm::ArrayRef<ExecutionState *> removedStates) {
+  // Only the weights recomputed below see the new average, the others are
+  // refreshed as their states get selected.
+  if (type == CoveragePerCost)
+    updateQueryLatency();
+
   if (current && updateWeights &&
       std::find(removedStates.begin(), removedStates.end(), current) ==
           removedStates.end())
     states->update(current, getWeight(current));
 
-  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+  for (llvm::ArrayRef<ExecutionState *>::iterator it = addedStates.begin(),
                                                      ie = addedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
     states->insert(es, getWeight(es));
   }
 
-  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+  for (llvm::ArrayRef<ExecutionState *>::iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     states->remove(*it);
   }
+
+  // The distances changed for all states, which are reweighted at once.
+  if ((type == MinDistToUncovered || type == CoveringNew ||
+       type == CoveragePerCost || type == Model) &&
+      executor.statsTracker &&
+      executor.statsTracker->getReachableUpdates() != reachableUpdates) {
+    reachableUpdates = executor.statsTracker->getReachableUpdates();
+    states->updateAll(
+        [this](ExecutionState *es) { return getWeight(es); });
+  }
 }
 
 bool WeightedRandomSearcher::empty() { 
@@ -255,6 +297,126 @@ bool WeightedRandomSearcher::empty() {
 }
 
 ///
+
+DirectedSearcher::DirectedSearcher(Executor &executor)
+    : kmodule(*executor.kmodule) {}
+
+uint64_t DirectedSearcher::getDistance(const KModule &kmodule,
+                                       const ExecutionState &es) {
+  // returning from the frames above first, the callers continue after
+  // their call
+  uint64_t best = 0, returned = 0;
+  for (unsigned i = es.stack.size(); i-- != 0;) {
+    KInstIterator ki = es.pc;
+    if (i + 1 != es.stack.size()) {
+      ki = es.stack[i + 1].caller;
+      ++ki;
+    }
+    unsigned id = ki->info->id;
+    uint64_t dist = kmodule.targetDistances[id];
+    if (dist && (!best || returned + dist < best))
+      best = returned + dist;
+    if (!kmodule.returnDistances[id])
+      break;
+    returned += kmodule.returnDistances[id];
+  }
+  return best;
+}
+
+void DirectedSearcher::insert(ExecutionState *es, uint64_t order) {
+  uint64_t dist = getDistance(kmodule, *es);
+  auto key = std::make_pair(dist ? dist : UINT64_MAX, order);
+  keys[es] = key;
+  queue.insert(std::make_tuple(key.first, key.second, es));
+}
+
+ExecutionState &DirectedSearcher::selectState() {
+  return *std::get<2>(*queue.begin());
+}
+
+void DirectedSearcher::update(ExecutionState *current,
+                              llvm::ArrayRef<ExecutionState *> addedStates,
+                              llvm::ArrayRef<ExecutionState *> removedStates) {
+  for (ExecutionState *es : removedStates) {
+    auto it = keys.find(es);
+    assert(it != keys.end() && "invalid state removed");
+    queue.erase(std::make_tuple(it->second.first, it->second.second, es));
+    keys.erase(it);
+  }
+
+  auto it = current ? keys.find(current) : keys.end();
+  if (it != keys.end()) {
+    queue.erase(std::make_tuple(it->second.first, it->second.second, current));
+    insert(current, it->second.second);
+  }
+
+  // the order is reversed, so that the latest come first
+  for (ExecutionState *es : addedStates)
+    insert(es, UINT64_MAX - added++);
+}
+
+///
+
+void SubpathSearcher::insert(ExecutionState *es) {
+  Group &group = groups[es->subpathHash];
+  if (!group.states.empty()) {
+    auto bucket = buckets.find(group.frequency);
+    bucket->second.erase(es->subpathHash);
+    if (bucket->second.empty())
+      buckets.erase(bucket);
+  }
+  ++group.frequency;
+  buckets[group.frequency].insert(es->subpathHash);
+
+  Entry &entry = entries[es];
+  entry.hash = es->subpathHash;
+  entry.decisions = es->branchDecisions;
+  entry.index = group.states.size();
+  group.states.push_back(es);
+}
+
+void SubpathSearcher::remove(ExecutionState *es) {
+  auto it = entries.find(es);
+  assert(it != entries.end() && "invalid state removed");
+  Group &group = groups[it->second.hash];
+  ExecutionState *last = group.states.back();
+  group.states[it->second.index] = last;
+  entries[last].index = it->second.index;
+  group.states.pop_back();
+  if (group.states.empty()) {
+    auto bucket = buckets.find(group.frequency);
+    bucket->second.erase(it->second.hash);
+    if (bucket->second.empty())
+      buckets.erase(bucket);
+  }
+  entries.erase(it);
+}
+
+ExecutionState &SubpathSearcher::selectState() {
+  const std::unordered_set<uint64_t> &rarest = buckets.begin()->second;
+  return *groups[*rarest.begin()].states.back();
+}
+
+void SubpathSearcher::update(ExecutionState *current,
+                             llvm::ArrayRef<ExecutionState *> addedStates,
+                             llvm::ArrayRef<ExecutionState *> removedStates) {
+  for (ExecutionState *es : removedStates)
+    remove(es);
+
+  // the current state only moves when it took a branch
+  auto it = current ? entries.find(current) : entries.end();
+  if (it != entries.end() &&
+      it->second.decisions != current->branchDecisions) {
+    remove(current);
+    insert(current);
+  }
+
+  for (ExecutionState *es : addedStates)
+    insert(es);
+}
+
+///
+
 RandomPathSearcher::RandomPathSearcher(Executor &_executor)
   : executor(_executor) {
 }
@@ -265,28 +427,23 @@ RandomPathSearcher::~RandomPathSearcher() {
 ExecutionState &RandomPathSearcher::selectState() {
   unsigned flips=0, bits=0;
   PTree::Node *n = executor.processTree->root;
-  while (!n->data) {
-    if (!n->left) {
-      n = n->right;
-    } else if (!n->right) {
-      n = n->left;
-    } else {
-      if (bits==0) {
-        flips = theRNG.getInt32();
-        bits = 32;
-      }
-      --bits;
-      n = (flips&(1<<bits)) ? n->left : n->right;
+  // inner nodes of the process tree always have two children
+  while (!n->isLeaf()) {
+    if (bits==0) {
+      flips = theRNG.getInt32();
+      bits = 32;
     }
+    --bits;
+    n = (flips&(1<<bits)) ? n->getLeft() : n->getRight();
   }
 
-  return *n->data;
+  return *n->getData();
 }
 
 void
 RandomPathSearcher::update(ExecutionState *current,
-                           const std::vector<ExecutionState *> &addedStates,
-                           const std::vector<ExecutionState *> &removedStates) {
+                           llvm::ArrayRef<ExecutionState *> addedStates,
+                           llvm::ArrayRef<ExecutionState *> removedStates) {
 }
 
 bool RandomPathSearcher::empty() { 
@@ -333,10 +490,12 @@ ExecutionState& MergingSearcher::selectState() {
 
 BatchingSearcher::BatchingSearcher(Searcher *_baseSearcher,
                                    time::Span _timeBudget,
-                                   unsigned _instructionBudget) 
+                                   unsigned _instructionBudget,
+                                   unsigned _targetOverhead)
   : baseSearcher(_baseSearcher),
     timeBudget(_timeBudget),
     instructionBudget(_instructionBudget),
+    targetOverhead(_targetOverhead),
     lastState(0) {
   
 }
@@ -345,6 +504,20 @@ BatchingSearcher::~BatchingSearcher() {
   delete baseSearcher;
 }
 
+void BatchingSearcher::adaptInstructionBudget(time::Span batchTime) {
+  uint64_t batch = batchTime.toMicroseconds();
+  if (!batch)
+    return;
+  double overhead =
+      100. * (stats::searcherTime - lastStartSearcherTime) / batch;
+  // Searcher costs per batch are mostly fixed, so the overhead shrinks
+  // about inversely with the batch length; don't jump more than a factor
+  // of two at once, as single batches are noisy.
+  double scale = std::min(2., std::max(.5, overhead / targetOverhead));
+  instructionBudget = static_cast<unsigned>(std::min(
+      double(1u << 24), std::max(1., instructionBudget * scale)));
+}
+
 ExecutionState &BatchingSearcher::selectState() {
   if (!lastState ||
       (((timeBudget.toSeconds() > 0) &&
@@ -359,10 +532,13 @@ ExecutionState &BatchingSearcher::selectState() {
         klee_message("increased time budget from %f to %f\n", timeBudget.toSeconds(), delta.toSeconds());
         timeBudget = delta;
       }
+      if (targetOverhead && instructionBudget)
+        adaptInstructionBudget(delta);
     }
     lastState = &baseSearcher->selectState();
     lastStartTime = time::getWallTime();
     lastStartInstructions = stats::instructions;
+    lastStartSearcherTime = stats::searcherTime;
     return *lastState;
   } else {
     return *lastState;
@@ -371,8 +547,8 @@ ExecutionState &BatchingSearcher::selectState() {
 
 void
 BatchingSearcher::update(ExecutionState *current,
-                         const std::vector<ExecutionState *> &addedStates,
-                         const std::vector<ExecutionState *> &removedStates) {
+                         llvm::ArrayRef<ExecutionState *> addedStates,
+                         llvm::ArrayRef<ExecutionState *> removedStates) {
   if (std::find(removedStates.begin(), removedStates.end(), lastState) !=
       removedStates.end())
     lastState = 0;
@@ -397,14 +573,14 @@ ExecutionState &IterativeDeepeningTimeSearcher::selectState() {
 }
 
 void IterativeDeepeningTimeSearcher::update(
-    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
-    const std::vector<ExecutionState *> &removedStates) {
+    ExecutionState *current, llvm::ArrayRef<ExecutionState *> addedStates,
+    llvm::ArrayRef<ExecutionState *> removedStates) {
 
   const auto elapsed = time::getWallTime() - startTime;
 
   if (!removedStates.empty()) {
-    std::vector<ExecutionState *> alt = removedStates;
-    for (std::vector<ExecutionState *>::const_iterator
+    std::vector<ExecutionState *> alt = removedStates.vec();
+    for (llvm::ArrayRef<ExecutionState *>::iterator
              it = removedStates.begin(),
              ie = removedStates.end();
          it != ie; ++it) {
@@ -432,7 +608,7 @@ void IterativeDeepeningTimeSearcher::update(
     time *= 2U;
     klee_message("increased time budget to %f\n", time.toSeconds());
     std::vector<ExecutionState *> ps(pausedStates.begin(), pausedStates.end());
-    baseSearcher->update(0, ps, std::vector<ExecutionState *>());
+    baseSearcher->update(0, ps, llvm::None);
     pausedStates.clear();
   }
 }
@@ -457,8 +633,8 @@ ExecutionState &InterleavedSearcher::selectState() {
 }
 
 void InterleavedSearcher::update(
-    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
-    const std::vector<ExecutionState *> &removedStates) {
+    ExecutionState *current, llvm::ArrayRef<ExecutionState *> addedStates,
+    llvm::ArrayRef<ExecutionState *> removedStates) {
   for (std::vector<Searcher*>::const_iterator it = searchers.begin(),
          ie = searchers.end(); it != ie; ++it)
     (*it)->update(current, addedStates, removedStates);
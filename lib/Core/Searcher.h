@@ -12,11 +12,16 @@
 
 #include "klee/Internal/System/Time.h"
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace llvm {
@@ -27,9 +32,11 @@ namespace llvm {
 }
 
 namespace klee {
-  template<class T> class DiscretePDF;
+  template<class T> class FenwickPDF;
   class ExecutionState;
   class Executor;
+  class KModule;
+  class SearcherModel;
 
   class Searcher {
   public:
@@ -38,11 +45,16 @@ namespace klee {
     virtual ExecutionState &selectState() = 0;
 
     virtual void update(ExecutionState *current,
-                        const std::vector<ExecutionState *> &addedStates,
-                        const std::vector<ExecutionState *> &removedStates) = 0;
+                        llvm::ArrayRef<ExecutionState *> addedStates,
+                        llvm::ArrayRef<ExecutionState *> removedStates) = 0;
 
     virtual bool empty() = 0;
 
+    /// Whether update() needs to be called for the current state after
+    /// every instruction, e.g. as its weight changes while it runs. If not,
+    /// update() is only called when states are added or removed.
+    virtual bool updatesCurrent() { return true; }
+
     // prints name of searcher as a klee_message()
     // TODO: could probably make prettier or more flexible
     virtual void printName(llvm::raw_ostream &os) {
@@ -58,15 +70,11 @@ namespace klee {
     // utility functions
 
     void addState(ExecutionState *es, ExecutionState *current = 0) {
-      std::vector<ExecutionState *> tmp;
-      tmp.push_back(es);
-      update(current, tmp, std::vector<ExecutionState *>());
+      update(current, es, llvm::None);
     }
 
     void removeState(ExecutionState *es, ExecutionState *current = 0) {
-      std::vector<ExecutionState *> tmp;
-      tmp.push_back(es);
-      update(current, std::vector<ExecutionState *>(), tmp);
+      update(current, llvm::None, es);
     }
 
     enum CoreSearchType {
@@ -79,7 +87,11 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      NURS_CovPerCost,
+      NURS_Model,
+      Directed,
+      Subpath
     };
   };
 
@@ -89,9 +101,10 @@ namespace klee {
   public:
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty() { return states.empty(); }
+    bool updatesCurrent() { return false; }
     void printName(llvm::raw_ostream &os) {
       os << "DFSSearcher\n";
     }
@@ -103,9 +116,10 @@ namespace klee {
   public:
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty() { return states.empty(); }
+    bool updatesCurrent() { return false; }
     void printName(llvm::raw_ostream &os) {
       os << "BFSSearcher\n";
     }
@@ -117,9 +131,10 @@ namespace klee {
   public:
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty() { return states.empty(); }
+    bool updatesCurrent() { return false; }
     void printName(llvm::raw_ostream &os) {
       os << "RandomSearcher\n";
     }
@@ -133,25 +148,42 @@ namespace klee {
       InstCount,
       CPInstCount,
       MinDistToUncovered,
-      CoveringNew
+      CoveringNew,
+      CoveragePerCost,
+      Model
     };
 
   private:
-    DiscretePDF<ExecutionState*> *states;
+    Executor &executor;
+    FenwickPDF<ExecutionState*> *states;
     WeightType type;
     bool updateWeights;
+    /// The distances to uncovered instructions the weights were computed
+    /// with, as StatsTracker::getReachableUpdates().
+    unsigned reachableUpdates;
+    /// The model of Model.
+    std::unique_ptr<SearcherModel> model;
+
+    /// Moving average of the time, in seconds, spent per query reaching
+    /// the core solver, and the totals it was last updated from.
+    double queryLatency;
+    uint64_t lastSolverTime, lastQueries;
+
+    void updateQueryLatency();
     
     double getWeight(ExecutionState*);
 
   public:
-    WeightedRandomSearcher(WeightType type);
+    WeightedRandomSearcher(WeightType type, Executor &executor,
+                           std::unique_ptr<SearcherModel> model = nullptr);
     ~WeightedRandomSearcher();
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty();
+    bool updatesCurrent() { return updateWeights; }
     void printName(llvm::raw_ostream &os) {
       os << "WeightedRandomSearcher::";
       switch(type) {
@@ -161,11 +193,86 @@ namespace klee {
       case CPInstCount        : os << "CPInstCount\n"; return;
       case MinDistToUncovered : os << "MinDistToUncovered\n"; return;
       case CoveringNew        : os << "CoveringNew\n"; return;
+      case CoveragePerCost    : os << "CoveragePerCost\n"; return;
+      case Model              : os << "Model\n"; return;
       default                 : os << "<unknown type>\n"; return;
       }
     }
   };
 
+  /// Selects the states closest to a --target, by the distances computed
+  /// by KModule::setTargets(), the most recently added first among those
+  /// as close. The states which cannot reach one come last.
+  class DirectedSearcher : public Searcher {
+    const KModule &kmodule;
+    /// The states by distance, and then by the reverse of the order they
+    /// were added in.
+    std::set<std::tuple<uint64_t, uint64_t, ExecutionState *> > queue;
+    std::map<ExecutionState *, std::pair<uint64_t, uint64_t> > keys;
+    uint64_t added = 0;
+
+    void insert(ExecutionState *es, uint64_t order);
+
+  public:
+    explicit DirectedSearcher(Executor &executor);
+
+    /// The shortest path from the state to a target, through the callers
+    /// it may return to, or 0 if it cannot reach one.
+    static uint64_t getDistance(const KModule &kmodule,
+                                const ExecutionState &es);
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
+    bool empty() { return queue.empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "DirectedSearcher\n";
+    }
+  };
+
+  /// Selects the states whose recent subpath, the last --subpath-length
+  /// branch decisions they took, was taken the least often by any state
+  /// (see "Steering Symbolic Execution to Less Traveled Paths",
+  /// OOPSLA'13). The most recent one among those is selected.
+  ///
+  /// The states are grouped by the hash of their subpath, and the groups
+  /// by frequency, so that a decision only moves the group of the state
+  /// taking it.
+  class SubpathSearcher : public Searcher {
+    struct Group {
+      /// How often a state took the subpath.
+      uint64_t frequency = 0;
+      /// The states whose subpath it is now.
+      std::vector<ExecutionState *> states;
+    };
+    std::unordered_map<uint64_t, Group> groups;
+    /// The hashes of the groups with states, by frequency.
+    std::map<uint64_t, std::unordered_set<uint64_t> > buckets;
+
+    struct Entry {
+      uint64_t hash;
+      /// The decisions of the state when it entered its group.
+      uint64_t decisions;
+      /// Its index in the states of the group.
+      unsigned index;
+    };
+    std::unordered_map<ExecutionState *, Entry> entries;
+
+    void insert(ExecutionState *es);
+    void remove(ExecutionState *es);
+
+  public:
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
+    bool empty() { return entries.empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "SubpathSearcher\n";
+    }
+  };
+
   class RandomPathSearcher : public Searcher {
     Executor &executor;
 
@@ -175,9 +282,10 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty();
+    bool updatesCurrent() { return false; }
     void printName(llvm::raw_ostream &os) {
       os << "RandomPathSearcher\n";
     }
@@ -199,11 +307,12 @@ namespace klee {
     ExecutionState &selectState();
 
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates) {
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates) {
       baseSearcher->update(current, addedStates, removedStates);
     }
     bool empty() { return baseSearcher->empty(); }
+    bool updatesCurrent() { return baseSearcher->updatesCurrent(); }
     void printName(llvm::raw_ostream &os) {
       os << "MergingSearcher\n";
     }
@@ -213,26 +322,38 @@ namespace klee {
     Searcher *baseSearcher;
     time::Span timeBudget;
     unsigned instructionBudget;
+    /// The share of the time the searcher should take, in percent, which
+    /// instructionBudget is adapted to. 0 keeps the budget fixed.
+    unsigned targetOverhead;
 
     ExecutionState *lastState;
     time::Point lastStartTime;
     unsigned lastStartInstructions;
+    uint64_t lastStartSearcherTime;
+
+    /// Scales the instruction budget by how far the share of the time the
+    /// searcher took during the last batch was off the target.
+    void adaptInstructionBudget(time::Span batchTime);
 
   public:
     BatchingSearcher(Searcher *baseSearcher, 
                      time::Span _timeBudget,
-                     unsigned _instructionBudget);
+                     unsigned _instructionBudget,
+                     unsigned _targetOverhead = 0);
     ~BatchingSearcher();
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty() { return baseSearcher->empty(); }
+    bool updatesCurrent() { return baseSearcher->updatesCurrent(); }
     void printName(llvm::raw_ostream &os) {
       os << "<BatchingSearcher> timeBudget: " << timeBudget
-         << ", instructionBudget: " << instructionBudget
-         << ", baseSearcher:\n";
+         << ", instructionBudget: " << instructionBudget;
+      if (targetOverhead)
+        os << ", targetOverhead: " << targetOverhead << "%";
+      os << ", baseSearcher:\n";
       baseSearcher->printName(os);
       os << "</BatchingSearcher>\n";
     }
@@ -250,8 +371,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty() { return baseSearcher->empty() && pausedStates.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "IterativeDeepeningTimeSearcher\n";
@@ -270,9 +391,15 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::vector<ExecutionState *> &addedStates,
-                const std::vector<ExecutionState *> &removedStates);
+                llvm::ArrayRef<ExecutionState *> addedStates,
+                llvm::ArrayRef<ExecutionState *> removedStates);
     bool empty() { return searchers[0]->empty(); }
+    bool updatesCurrent() {
+      for (Searcher *s : searchers)
+        if (s->updatesCurrent())
+          return true;
+      return false;
+    }
     void printName(llvm::raw_ostream &os) {
       os << "<InterleavedSearcher> containing "
          << searchers.size() << " searchers:\n";
@@ -0,0 +1,120 @@
+//===-- SearcherModel.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SearcherModel.h"
+
+#include "StatsTracker.h"
+
+#include "klee/ExecutionState.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace llvm;
+using namespace klee;
+
+const char *SearcherModel::getFeatureName(Feature feature) {
+  switch (feature) {
+  case Depth: return "depth";
+  case QueryCost: return "query_cost";
+  case InstsSinceCovNew: return "insts_since_cov_new";
+  case StackDepth: return "stack_depth";
+  case Constraints: return "constraints";
+  case MinDistToUncovered: return "md2u";
+  case ForkRate: return "fork_rate";
+  case NumFeatures: break;
+  }
+  return "<unknown feature>";
+}
+
+void SearcherModel::getFeatures(const ExecutionState &es,
+                                double (&features)[NumFeatures]) {
+  features[Depth] = es.depth;
+  features[QueryCost] = es.queryCost.toSeconds();
+  features[InstsSinceCovNew] = es.instsSinceCovNew;
+  features[StackDepth] = es.stack.size();
+  features[Constraints] = es.constraints.size();
+  features[MinDistToUncovered] = computeMinDistToUncovered(
+      es.pc, es.stack.back().minDistToUncoveredOnReturn);
+  // forks per thousand instructions on the path of the state
+  features[ForkRate] =
+      es.depth * 1000. / std::max<std::uint64_t>(es.steppedInstructions, 1);
+}
+
+std::unique_ptr<SearcherModel> SearcherModel::load(const std::string &path,
+                                                   std::string &error) {
+  auto file = MemoryBuffer::getFile(path);
+  if (!file) {
+    error = "unable to read " + path + ": " + file.getError().message();
+    return nullptr;
+  }
+
+  std::unique_ptr<SearcherModel> model(new SearcherModel());
+  SmallVector<StringRef, 16> lines;
+  (*file)->getBuffer().split(lines, '\n');
+  for (unsigned i = 0; i < lines.size(); ++i) {
+    StringRef line = lines[i].split('#').first.trim();
+    if (line.empty())
+      continue;
+
+    std::pair<StringRef, StringRef> fields = getToken(line);
+    StringRef name = fields.first, value = fields.second.trim();
+    double weight;
+    if (value.empty() || value.getAsDouble(weight)) {
+      error = path + ":" + llvm::utostr(i + 1) + ": expected a feature and " +
+              "its weight";
+      return nullptr;
+    }
+
+    if (name == "bias") {
+      model->bias = weight;
+      continue;
+    }
+    unsigned feature = 0;
+    while (feature < NumFeatures &&
+           name != getFeatureName((Feature)feature))
+      ++feature;
+    if (feature == NumFeatures) {
+      error = path + ":" + llvm::utostr(i + 1) + ": unknown feature " +
+              name.str();
+      return nullptr;
+    }
+    model->weights[feature] = weight;
+  }
+  return model;
+}
+
+double SearcherModel::getWeight(const ExecutionState &es) const {
+  double features[NumFeatures];
+  getFeatures(es, features);
+  double score = bias;
+  for (unsigned i = 0; i < NumFeatures; ++i)
+    score += weights[i] * features[i];
+  return 1 / (1 + std::exp(-score));
+}
+
+void SearcherModel::writeHeader(llvm::raw_ostream &os) {
+  for (unsigned i = 0; i < NumFeatures; ++i)
+    os << getFeatureName((Feature)i) << ",";
+  os << "covered_new\n";
+}
+
+void SearcherModel::writeFeatures(llvm::raw_ostream &os,
+                                  const ExecutionState &es) {
+  double features[NumFeatures];
+  getFeatures(es, features);
+  for (unsigned i = 0; i < NumFeatures; ++i)
+    os << features[i] << ",";
+  os << (es.coveredNew ? 1 : 0) << "\n";
+}
@@ -0,0 +1,69 @@
+//===-- SearcherModel.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SEARCHERMODEL_H
+#define KLEE_SEARCHERMODEL_H
+
+#include <memory>
+#include <string>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace klee {
+  class ExecutionState;
+
+  /// A linear model scoring states from cheap features, for
+  /// --search=nurs:model.
+  ///
+  /// The model is read from a file with a "feature weight" pair per line,
+  /// the features named as in the header of searcher-features.csv, plus an
+  /// optional "bias". A state is weighted by the logistic function of its
+  /// score, so that a logistic regression trained on the features written
+  /// by --write-searcher-features, with covered_new as label, predicts how
+  /// likely a state is to cover new code.
+  class SearcherModel {
+  public:
+    enum Feature {
+      Depth,
+      QueryCost,
+      InstsSinceCovNew,
+      StackDepth,
+      Constraints,
+      MinDistToUncovered,
+      ForkRate,
+      NumFeatures
+    };
+
+  private:
+    double bias = 0;
+    double weights[NumFeatures] = {};
+
+  public:
+    static const char *getFeatureName(Feature feature);
+    static void getFeatures(const ExecutionState &es,
+                            double (&features)[NumFeatures]);
+
+    /// Reads a model, returning null and setting \a error on failure.
+    static std::unique_ptr<SearcherModel> load(const std::string &path,
+                                               std::string &error);
+
+    /// The weight of a state, in (0,1).
+    double getWeight(const ExecutionState &es) const;
+
+    /// Writes the names of the columns of writeFeatures().
+    static void writeHeader(llvm::raw_ostream &os);
+    /// Writes the features of a terminated state and whether it covered
+    /// new instructions, as a line of CSV.
+    static void writeFeatures(llvm::raw_ostream &os, const ExecutionState &es);
+  };
+}
+
+#endif
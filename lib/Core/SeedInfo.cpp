@@ -13,6 +13,7 @@
 
 #include "klee/ExecutionState.h"
 #include "klee/Expr.h"
+#include "klee/util/CompiledExpr.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/Support/ErrorHandling.h"
@@ -162,3 +163,21 @@ void SeedInfo::patchSeed(const ExecutionState &state,
   }
 #endif
 }
+
+void klee::evaluateSeeds(std::vector<SeedInfo> &seeds, const ref<Expr> &e,
+                         CompiledExprCache &compiled,
+                         std::vector<ref<Expr> > &values) {
+  std::vector<const Assignment *> assignments;
+  for (const SeedInfo &si : seeds)
+    assignments.push_back(&si.assignment);
+  std::vector<uint64_t> results;
+  std::vector<char> evaluated;
+  compiled.evaluateAll(e, assignments, results, evaluated);
+
+  values.clear();
+  for (unsigned k = 0, n = seeds.size(); k != n; ++k)
+    values.push_back(evaluated[k]
+                         ? ref<Expr>(ConstantExpr::create(results[k],
+                                                          e->getWidth()))
+                         : seeds[k].assignment.evaluate(e));
+}
@@ -12,6 +12,8 @@
 
 #include "klee/util/Assignment.h"
 
+#include <vector>
+
 extern "C" {
   struct KTest;
   struct KTestObject;
@@ -44,6 +46,14 @@ namespace klee {
                    ref<Expr> condition,
                    TimingSolver *solver);
   };
+
+  /// Evaluate \a e under the assignments of all \a seeds, in one pass of
+  /// its program from \a compiled where possible. values[k] is the value
+  /// under seeds[k], which is only non-constant where that assignment leaves
+  /// part of \a e free.
+  void evaluateSeeds(std::vector<SeedInfo> &seeds, const ref<Expr> &e,
+                     CompiledExprCache &compiled,
+                     std::vector<ref<Expr> > &values);
 }
 
 #endif
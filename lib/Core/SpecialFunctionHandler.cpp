@@ -27,6 +27,7 @@
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Module.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <sstream>
 
@@ -81,6 +82,7 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
   add("free", handleFree, false),
   add("klee_assume", handleAssume, false),
   add("klee_check_memory_access", handleCheckMemoryAccess, false),
+  add("klee_copy_memory", handleCopyMemory, true),
   add("klee_get_valuef", handleGetValue, true),
   add("klee_get_valued", handleGetValue, true),
   add("klee_get_valuel", handleGetValue, true),
@@ -140,6 +142,22 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
 #undef add
 };
 
+// String functions which are carried out natively when the bytes they read
+// are concrete. Their bodies are kept for the other calls.
+static const struct {
+  const char *name;
+  SpecialFunctionHandler::FastHandler handler;
+  unsigned numArgs;
+} fastHandlerInfo[] = {
+  { "memchr", &SpecialFunctionHandler::handleFastMemchr, 3 },
+  { "memcmp", &SpecialFunctionHandler::handleFastMemcmp, 3 },
+  { "strchr", &SpecialFunctionHandler::handleFastStrchr, 2 },
+  { "strcmp", &SpecialFunctionHandler::handleFastStrcmp, 2 },
+  { "strlen", &SpecialFunctionHandler::handleFastStrlen, 1 },
+  { "strncmp", &SpecialFunctionHandler::handleFastStrncmp, 3 },
+  { "strrchr", &SpecialFunctionHandler::handleFastStrrchr, 2 },
+};
+
 SpecialFunctionHandler::const_iterator SpecialFunctionHandler::begin() {
   return SpecialFunctionHandler::const_iterator(handlerInfo);
 }
@@ -202,7 +220,23 @@ void SpecialFunctionHandler::bind() {
     
     if (f && (!hi.doNotOverride || f->isDeclaration()))
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
+
   }
+  for (const auto &fi : fastHandlerInfo) {
+    Function *f = executor.kmodule->module->getFunction(fi.name);
+    // declarations are called natively anyway
+    if (f && !f->isDeclaration() && f->arg_size() == fi.numArgs &&
+        !handlers.count(f))
+      fastHandlers[f] = fi.handler;
+  }
+}
+
+bool SpecialFunctionHandler::handleFast(ExecutionState &state, Function *f,
+                                        KInstruction *target,
+                                        std::vector<ref<Expr> > &arguments) {
+  fast_handlers_ty::iterator it = fastHandlers.find(f);
+  return it != fastHandlers.end() &&
+         (this->*(it->second))(state, target, arguments);
 }
 
 
@@ -275,6 +309,54 @@ SpecialFunctionHandler::readStringAtAddress(ExecutionState &state,
   return result;
 }
 
+bool SpecialFunctionHandler::readConcreteBytes(ExecutionState &state,
+                                               ref<Expr> address,
+                                               uint64_t max, int stop,
+                                               bool stopAtNul,
+                                               std::vector<uint8_t> &bytes) {
+  bytes.clear();
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(address);
+  ObjectPair op;
+  if (!ce || !state.addressSpace.resolveOne(ce, op))
+    return false;
+  uint64_t offset = ce->getZExtValue() - op.first->address;
+  uint64_t available = op.first->size - offset;
+
+  // read in chunks, as the strings are often much shorter than the objects
+  uint8_t chunk[4096];
+  while (bytes.size() < max) {
+    uint64_t want = std::min<uint64_t>(
+        sizeof(chunk), std::min(max, available) - bytes.size());
+    if (!want)
+      return false;
+    unsigned got = op.second->readConcretePrefix(offset + bytes.size(),
+                                                 want, chunk);
+    for (unsigned i = 0; i != got; ++i) {
+      bytes.push_back(chunk[i]);
+      if ((stopAtNul && !chunk[i]) || chunk[i] == stop)
+        return true;
+    }
+    if (got != want)
+      return false;
+  }
+  return true;
+}
+
+/// Returns the difference of the first bytes which differ, as unsigned
+/// chars, among the first \a n, or 0. With \a stopAtNul the comparison ends
+/// after a 0 in both. \a b may only be shorter than \a a if it ends with a
+/// difference or, with \a stopAtNul, a 0.
+static int compareBytes(const std::vector<uint8_t> &a,
+                        const std::vector<uint8_t> &b, bool stopAtNul) {
+  for (size_t i = 0, e = b.size(); i != e; ++i) {
+    if (a[i] != b[i])
+      return (int)a[i] - (int)b[i];
+    if (stopAtNul && !a[i])
+      break;
+  }
+  return 0;
+}
+
 /****/
 
 void SpecialFunctionHandler::handleAbort(ExecutionState &state,
@@ -446,19 +528,57 @@ void SpecialFunctionHandler::handleMemalign(ExecutionState &state,
                         alignment);
 }
 
+/// Whether \a e is 0 or 1, as the C truth values are.
+static bool isTruthValue(const ref<Expr> &e) {
+  if (const klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(e))
+    return ce->getZExtValue(64) <= 1;
+  if (const ZExtExpr *ze = dyn_cast<ZExtExpr>(e))
+    return ze->src->getWidth() == Expr::Bool;
+  if (const AndExpr *ae = dyn_cast<AndExpr>(e))
+    return isTruthValue(ae->left) && isTruthValue(ae->right);
+  return false;
+}
+
 void SpecialFunctionHandler::handleAssume(ExecutionState &state,
                             KInstruction *target,
                             std::vector<ref<Expr> > &arguments) {
   assert(arguments.size()==1 && "invalid number of arguments to klee_assume");
   
-  ref<Expr> e = arguments[0];
-  
-  if (e->getWidth() != Expr::Bool)
-    e = NeExpr::create(e, ConstantExpr::create(0, e->getWidth()));
-  
-  bool res;
-  bool success __attribute__ ((unused)) = executor.solver->mustBeFalse(state, e, res);
-  assert(success && "FIXME: Unhandled solver failure");
+  // Assumptions are often large conjunctions, of which the constraints may
+  // already imply some conjuncts. These are dropped, and the others checked
+  // at once, which the model of the state answers without a query when it
+  // satisfies them.
+  std::vector<ref<Expr> > conjuncts(1, arguments[0]);
+  ref<Expr> remaining = ConstantExpr::alloc(1, Expr::Bool);
+  bool res = false;
+  while (!conjuncts.empty() && !res) {
+    ref<Expr> c = conjuncts.back();
+    conjuncts.pop_back();
+    // Unoptimized code conjoins C truth values, as in (a > 0) & (b > 0),
+    // which is true when both of them are.
+    AndExpr *ae = dyn_cast<AndExpr>(c);
+    if (ae && (c->getWidth() == Expr::Bool ||
+               (isTruthValue(ae->left) && isTruthValue(ae->right)))) {
+      conjuncts.push_back(ae->right);
+      conjuncts.push_back(ae->left);
+      continue;
+    }
+    if (c->getWidth() != Expr::Bool)
+      c = NeExpr::create(c, ConstantExpr::create(0, c->getWidth()));
+    c = state.constraints.simplifyExpr(c);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(c))
+      res = CE->isFalse();
+    else
+      remaining = AndExpr::create(remaining, c);
+  }
+  if (!res && isa<ConstantExpr>(remaining))
+    return;
+
+  if (!res) {
+    bool success __attribute__ ((unused)) =
+        executor.solver->mustBeFalse(state, remaining, res);
+    assert(success && "FIXME: Unhandled solver failure");
+  }
   if (res) {
     if (SilentKleeAssume) {
       executor.terminateState(state);
@@ -468,7 +588,7 @@ void SpecialFunctionHandler::handleAssume(ExecutionState &state,
                                      Executor::User);
     }
   } else {
-    executor.addConstraint(state, e);
+    executor.addConstraint(state, remaining);
   }
 }
 
@@ -591,6 +711,16 @@ void SpecialFunctionHandler::handlePrintRange(ExecutionState &state,
   llvm::errs() << "\n";
 }
 
+void SpecialFunctionHandler::handleCopyMemory(ExecutionState &state,
+                                              KInstruction *target,
+                                              std::vector<ref<Expr> > &arguments) {
+  assert(arguments.size()==3 &&
+         "invalid number of arguments to klee_copy_memory");
+  bool copied = executor.copyMemory(state, false, arguments[0], arguments[1],
+                                    arguments[2]);
+  executor.bindLocal(target, state, ConstantExpr::create(copied, Expr::Int32));
+}
+
 void SpecialFunctionHandler::handleGetObjSize(ExecutionState &state,
                                   KInstruction *target,
                                   std::vector<ref<Expr> > &arguments) {
@@ -603,9 +733,9 @@ void SpecialFunctionHandler::handleGetObjSize(ExecutionState &state,
          ie = rl.end(); it != ie; ++it) {
     executor.bindLocal(
         target, *it->second,
-        ConstantExpr::create(it->first.first->size,
-                             executor.kmodule->targetData->getTypeSizeInBits(
-                                 target->inst->getType())));
+        ZExtExpr::create(it->first.first->getSizeExpr(),
+                         executor.kmodule->targetData->getTypeSizeInBits(
+                             target->inst->getType())));
   }
 }
 
@@ -867,3 +997,127 @@ void SpecialFunctionHandler::handleDivRemOverflow(ExecutionState &state,
   executor.terminateStateOnError(state, "overflow on division or remainder",
                                  Executor::Overflow);
 }
+
+/* Fast handlers */
+
+bool SpecialFunctionHandler::handleFastStrlen(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  std::vector<uint8_t> s;
+  if (!readConcreteBytes(state, arguments[0], UINT64_MAX, -1, true, s))
+    return false;
+  executor.bindLocal(
+      target, state,
+      ConstantExpr::create(s.size() - 1, executor.getWidthForLLVMType(
+                                             target->inst->getType())));
+  return true;
+}
+
+bool SpecialFunctionHandler::handleFastStrcmp(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  std::vector<uint8_t> a, b;
+  if (!readConcreteBytes(state, arguments[0], UINT64_MAX, -1, true, a) ||
+      !readConcreteBytes(state, arguments[1], a.size(), -1, true, b))
+    return false;
+  executor.bindLocal(
+      target, state,
+      ConstantExpr::create(
+          compareBytes(a, b, true),
+          executor.getWidthForLLVMType(target->inst->getType())));
+  return true;
+}
+
+bool SpecialFunctionHandler::handleFastStrncmp(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  ConstantExpr *n = dyn_cast<ConstantExpr>(arguments[2]);
+  std::vector<uint8_t> a, b;
+  if (!n || n->getWidth() > Expr::Int64 ||
+      !readConcreteBytes(state, arguments[0], n->getZExtValue(), -1, true,
+                         a) ||
+      !readConcreteBytes(state, arguments[1], a.size(), -1, true, b))
+    return false;
+  executor.bindLocal(
+      target, state,
+      ConstantExpr::create(
+          compareBytes(a, b, true),
+          executor.getWidthForLLVMType(target->inst->getType())));
+  return true;
+}
+
+bool SpecialFunctionHandler::handleFastMemcmp(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  ConstantExpr *n = dyn_cast<ConstantExpr>(arguments[2]);
+  std::vector<uint8_t> a, b;
+  if (!n || n->getWidth() > Expr::Int64 ||
+      !readConcreteBytes(state, arguments[0], n->getZExtValue(), -1, false,
+                         a) ||
+      !readConcreteBytes(state, arguments[1], n->getZExtValue(), -1, false,
+                         b))
+    return false;
+  executor.bindLocal(
+      target, state,
+      ConstantExpr::create(
+          compareBytes(a, b, false),
+          executor.getWidthForLLVMType(target->inst->getType())));
+  return true;
+}
+
+void SpecialFunctionHandler::bindFoundPointer(ExecutionState &state,
+                                              KInstruction *target,
+                                              ref<Expr> base, bool found,
+                                              uint64_t offset) {
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  ref<Expr> result = ConstantExpr::create(0, width);
+  if (found)
+    result = AddExpr::create(base, ConstantExpr::create(offset, width));
+  executor.bindLocal(target, state, result);
+}
+
+bool SpecialFunctionHandler::handleFastMemchr(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  ConstantExpr *c = dyn_cast<ConstantExpr>(arguments[1]);
+  ConstantExpr *n = dyn_cast<ConstantExpr>(arguments[2]);
+  std::vector<uint8_t> s;
+  if (!c || !n || n->getWidth() > Expr::Int64)
+    return false;
+  uint8_t ch = c->getZExtValue();
+  if (!readConcreteBytes(state, arguments[0], n->getZExtValue(), ch, false,
+                         s))
+    return false;
+  bindFoundPointer(state, target, arguments[0],
+                   !s.empty() && s.back() == ch, s.size() - 1);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleFastStrchr(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  ConstantExpr *c = dyn_cast<ConstantExpr>(arguments[1]);
+  std::vector<uint8_t> s;
+  if (!c)
+    return false;
+  uint8_t ch = c->getZExtValue();
+  if (!readConcreteBytes(state, arguments[0], UINT64_MAX, ch, true, s))
+    return false;
+  bindFoundPointer(state, target, arguments[0], s.back() == ch,
+                   s.size() - 1);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleFastStrrchr(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  ConstantExpr *c = dyn_cast<ConstantExpr>(arguments[1]);
+  std::vector<uint8_t> s;
+  if (!c || !readConcreteBytes(state, arguments[0], UINT64_MAX, -1, true, s))
+    return false;
+  std::vector<uint8_t>::reverse_iterator it =
+      std::find(s.rbegin(), s.rend(), (uint8_t)c->getZExtValue());
+  bindFoundPointer(state, target, arguments[0], it != s.rend(),
+                   s.rend() - it - 1);
+  return true;
+}
@@ -10,6 +10,7 @@
 #ifndef KLEE_SPECIALFUNCTIONHANDLER_H
 #define KLEE_SPECIALFUNCTIONHANDLER_H
 
+#include <cstdint>
 #include <iterator>
 #include <map>
 #include <vector>
@@ -36,6 +37,15 @@ namespace klee {
                      std::pair<Handler,bool> > handlers_ty;
 
     handlers_ty handlers;
+
+    /// A handler which may decline a call, then carried out by the body of
+    /// the function.
+    typedef bool (SpecialFunctionHandler::*FastHandler)(
+        ExecutionState &state, KInstruction *target,
+        std::vector<ref<Expr> > &arguments);
+    typedef std::map<const llvm::Function *, FastHandler> fast_handlers_ty;
+
+    fast_handlers_ty fastHandlers;
     class Executor &executor;
 
     struct HandlerInfo {
@@ -91,9 +101,29 @@ namespace klee {
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
+    /// Carries out a call to one of the string functions natively, if the
+    /// bytes it reads and its other arguments are concrete.
+    /// \return false if the body has to be interpreted instead.
+    bool handleFast(ExecutionState &state,
+                    llvm::Function *f,
+                    KInstruction *target,
+                    std::vector< ref<Expr> > &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
+
+    /// Reads the bytes from the concrete \a address on, up to \a max of them
+    /// or through the first one equal to \a stop or, with \a stopAtNul, to 0.
+    /// \return false if a symbolic byte or the end of the object comes first.
+    bool readConcreteBytes(ExecutionState &state, ref<Expr> address,
+                           uint64_t max, int stop, bool stopAtNul,
+                           std::vector<uint8_t> &bytes);
+
+    /// Binds \a base plus \a offset as the result, or a null pointer
+    /// without \a found.
+    void bindFoundPointer(ExecutionState &state, KInstruction *target,
+                          ref<Expr> base, bool found, uint64_t offset);
     
     /* Handlers */
 
@@ -106,6 +136,7 @@ namespace klee {
     HANDLER(handleAssume);
     HANDLER(handleCalloc);
     HANDLER(handleCheckMemoryAccess);
+    HANDLER(handleCopyMemory);
     HANDLER(handleDefineFixedObject);
     HANDLER(handleDelete);    
     HANDLER(handleDeleteArray);
@@ -143,6 +174,18 @@ namespace klee {
     HANDLER(handleSubOverflow);
     HANDLER(handleDivRemOverflow);
 #undef HANDLER
+
+#define FAST_HANDLER(name) bool name(ExecutionState &state, \
+                                     KInstruction *target, \
+                                     std::vector< ref<Expr> > &arguments)
+    FAST_HANDLER(handleFastMemchr);
+    FAST_HANDLER(handleFastMemcmp);
+    FAST_HANDLER(handleFastStrchr);
+    FAST_HANDLER(handleFastStrcmp);
+    FAST_HANDLER(handleFastStrlen);
+    FAST_HANDLER(handleFastStrncmp);
+    FAST_HANDLER(handleFastStrrchr);
+#undef FAST_HANDLER
   };
 } // End klee namespace
 
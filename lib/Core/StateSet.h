@@ -0,0 +1,67 @@
+//===-- StateSet.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESET_H
+#define KLEE_STATESET_H
+
+#include "klee/ExecutionState.h"
+
+#include <cassert>
+#include <vector>
+
+namespace klee {
+
+/// A set of states kept densely in a vector, with each state knowing its
+/// position, so that inserting, erasing and looking up a state take
+/// constant time without allocating on every change. Erasing moves the
+/// last state into the gap, so the order of the states is arbitrary (as it
+/// was in the std::set ordered by address this replaces).
+///
+/// A state can be in only one StateSet at a time.
+class StateSet {
+  std::vector<ExecutionState *> states;
+
+public:
+  typedef std::vector<ExecutionState *>::const_iterator iterator;
+  typedef iterator const_iterator;
+
+  iterator begin() const { return states.begin(); }
+  iterator end() const { return states.end(); }
+  size_t size() const { return states.size(); }
+  bool empty() const { return states.empty(); }
+  ExecutionState *operator[](size_t i) const { return states[i]; }
+
+  bool count(const ExecutionState *es) const {
+    return es->stateSetIndex < states.size() &&
+           states[es->stateSetIndex] == es;
+  }
+
+  void insert(ExecutionState *es) {
+    assert(!count(es) && "state inserted twice");
+    es->stateSetIndex = states.size();
+    states.push_back(es);
+  }
+
+  template <class It> void insert(It begin, It end) {
+    for (; begin != end; ++begin)
+      insert(*begin);
+  }
+
+  void erase(ExecutionState *es) {
+    assert(count(es) && "erasing a state not in the set");
+    ExecutionState *last = states.back();
+    states[es->stateSetIndex] = last;
+    last->stateSetIndex = es->stateSetIndex;
+    states.pop_back();
+    es->stateSetIndex = ~size_t(0);
+  }
+};
+}
+
+#endif
@@ -15,21 +15,29 @@
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Support/BinaryIStats.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/SolverStats.h"
+#include "klee/util/ExprAllocator.h"
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
 #include "MemoryManager.h"
+#include "MetricsServer.h"
+#include "SamplingProfiler.h"
+#include "StatsWriter.h"
+#include "TimingSolver.h"
 #include "UserSearcher.h"
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/InlineAsm.h"
@@ -40,7 +48,9 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/FileSystem.h"
 
+#include <algorithm>
 #include <fstream>
+#include <queue>
 #include <unistd.h>
 
 using namespace klee;
@@ -55,8 +65,16 @@ cl::OptionCategory
 
 cl::opt<bool> TrackInstructionTime(
     "track-instruction-time", cl::init(false),
-    cl::desc(
-        "Enable tracking of time for individual instructions (default=false)"),
+    cl::desc("Sample the CPU time spent on individual instructions into the "
+             "instruction level statistics, and write the samples of each "
+             "call path to run.folded, one line per stack as taken by "
+             "flamegraph.pl (default=false)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> InstructionTimeSampleInterval(
+    "instruction-time-sample-interval", cl::init("1ms"),
+    cl::desc("CPU time between two samples of --track-instruction-time "
+             "(default=1ms)"),
     cl::cat(StatsCat));
 
 cl::opt<bool>
@@ -69,6 +87,24 @@ cl::opt<bool> OutputIStats("output-istats", cl::init(true),
                                     "callgrind format (default=true)"),
                            cl::cat(StatsCat));
 
+cl::opt<bool> OutputStateFootprint(
+    "output-state-footprint", cl::init(false),
+    cl::desc("Write the approximate memory held by the stacks, covered lines, "
+             "array names, symbolics, constraints and memory of all states to "
+             "the stats trace file. Costs a walk over all states per write "
+             "(default=false)"),
+    cl::cat(StatsCat));
+
+cl::opt<bool> OutputQueryComplexity(
+    "output-query-complexity", cl::init(false),
+    cl::desc("Measure the expression nodes, depth, arrays, updates and "
+             "constraints of each query. Their 50th and 99th percentiles and "
+             "maximum go to the stats trace file, their totals and the "
+             "deepest query of each instruction to the instruction level "
+             "statistics. Costs a walk over the constraints per query "
+             "(default=false)"),
+    cl::cat(StatsCat));
+
 cl::opt<std::string> StatsWriteInterval(
     "stats-write-interval", cl::init("1s"),
     cl::desc("Approximate time between stats writes (default=1s)"),
@@ -87,6 +123,19 @@ cl::opt<unsigned> StatsWriteAfterInstructions(
                "-stats-write-after-instructions. (default=0)"),
       cl::cat(StatsCat));
 
+enum class IStatsFormat { Callgrind, Binary };
+
+cl::opt<IStatsFormat> OutputIStatsFormat(
+    "istats-format",
+    cl::desc("Format of the instruction level statistics (default=callgrind)"),
+    cl::values(clEnumValN(IStatsFormat::Callgrind, "callgrind",
+                          "run.istats, rewritten on each write"),
+               clEnumValN(IStatsFormat::Binary, "binary",
+                          "run.istats.bin, which each write appends the "
+                          "changes to. klee-istats converts it to callgrind")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::init(IStatsFormat::Callgrind), cl::cat(StatsCat));
+
 cl::opt<std::string> IStatsWriteInterval(
     "istats-write-interval", cl::init("10s"),
     cl::desc(
@@ -110,12 +159,30 @@ cl::opt<bool> UseCallPaths("use-call-paths", cl::init(true),
                                     "level statistics (default=true)"),
                            cl::cat(StatsCat));
 
+cl::opt<std::string> MetricsSocket(
+    "metrics-socket",
+    cl::desc("Serve the statistics over HTTP on this Unix socket, in the "
+             "Prometheus text format (default=off)"),
+    cl::value_desc("path"), cl::cat(StatsCat));
+
+cl::opt<unsigned> MetricsPort(
+    "metrics-port", cl::init(0),
+    cl::desc("Serve the statistics over HTTP on this port of the loopback "
+             "interface, in the Prometheus text format, 0 to disable "
+             "(default=0)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsUpdateInterval(
+    "metrics-update-interval", cl::init("1s"),
+    cl::desc("Approximate time between updates of the served state counts, "
+             "memory usage and query latencies (default=1s)"),
+    cl::cat(StatsCat));
 } // namespace
 
 ///
 
 bool StatsTracker::useStatistics() {
-  return OutputStats || OutputIStats;
+  return OutputStats || OutputIStats || !MetricsSocket.empty() || MetricsPort;
 }
 
 bool StatsTracker::useIStats() {
@@ -133,6 +200,16 @@ namespace klee {
     void run() { statsTracker->writeIStats(); }
   };
   
+  class PublishMetricsTimer : public Executor::Timer {
+    StatsTracker *statsTracker;
+
+  public:
+    PublishMetricsTimer(StatsTracker *_statsTracker)
+        : statsTracker(_statsTracker) {}
+
+    void run() { statsTracker->publishMetrics(); }
+  };
+
   class WriteStatsTimer : public Executor::Timer {
     StatsTracker *statsTracker;
     
@@ -154,6 +231,47 @@ namespace klee {
  
 }
 
+namespace klee {
+/// Maintains the minimum distance from each instruction to an uncovered
+/// one, 0 if none is reachable, in stats::minDistToUncovered. Through a
+/// call, the distance counts the shortest path through the callees to
+/// their return. Since instructions only ever get covered, the distances
+/// only grow: an update only recomputes those of the instructions whose
+/// shortest path went through a newly covered one [Ramalingam and Reps,
+/// "On the computational complexity of dynamic graph problems"].
+class UncoveredDistances {
+  struct Edge {
+    /// The other end of the edge, and its length.
+    unsigned id, weight;
+  };
+
+  /// The edges from and to each instruction id, in compressed rows.
+  std::vector<unsigned> succBegin, predBegin;
+  std::vector<Edge> succs, preds;
+  std::vector<uint64_t> distance;
+  /// The ids of the instructions uncovered after the last update.
+  std::vector<unsigned> uncovered;
+  std::vector<bool> affected;
+
+  typedef std::pair<uint64_t, unsigned> QueueEntry;
+  typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                              std::greater<QueueEntry> >
+      Queue;
+
+  bool isUncovered(unsigned id) const {
+    return theStatisticManager->getIndexedValue(stats::uncoveredInstructions,
+                                                id);
+  }
+  /// Lowers the distances of the predecessors of the instructions in
+  /// \a queue, among the affected ones if \a onlyAffected is set.
+  void propagate(Queue &queue, bool onlyAffected);
+
+public:
+  explicit UncoveredDistances(KModule &km);
+  void update();
+};
+}
+
 //
 
 /// Check for special cases where we statically know an instruction is
@@ -227,8 +345,12 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
-  if (OutputIStats)
+  executor.solver->measureComplexity = OutputQueryComplexity;
+
+  if (OutputIStats) {
     theStatisticManager->useIndexedStats(km->infos->getMaxID());
+    uncovered.resize(km->infos->getMaxID());
+  }
 
   for (auto &kfp : km->functions) {
     KFunction *kf = kfp.get();
@@ -240,8 +362,10 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
       if (OutputIStats) {
         unsigned id = ki->info->id;
         theStatisticManager->setIndex(id);
-        if (kf->trackCoverage && instructionIsCoverable(ki->inst))
+        if (kf->trackCoverage && instructionIsCoverable(ki->inst)) {
           ++stats::uncoveredInstructions;
+          uncovered.set(id);
+        }
       }
       
       if (kf->trackCoverage) {
@@ -284,6 +408,8 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
 
       // create table
       writeStatsHeader();
+      statsWriter.reset(new StatsWriter(statsFile, transactionBeginStmt,
+                                        transactionEndStmt, statsCommitEvery));
       writeStatsLine();
 
       if (statsWriteInterval)
@@ -302,19 +428,42 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     executor.addTimer(new UpdateReachableTimer(this), time::Span(UncoveredUpdateInterval));
   }
 
+  if (!MetricsSocket.empty() || MetricsPort) {
+    const time::Span interval(MetricsUpdateInterval);
+    if (!interval)
+      klee_error("--metrics-update-interval cannot be 0.");
+    metricsServer.reset(new MetricsServer(MetricsSocket, MetricsPort));
+    publishMetrics();
+    executor.addTimer(new PublishMetricsTimer(this), interval);
+  }
+
   if (OutputIStats) {
-    istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
-    if (istatsFile) {
-      if (iStatsWriteInterval)
-        executor.addTimer(new WriteIStatsTimer(this), iStatsWriteInterval);
+    if (OutputIStatsFormat == IStatsFormat::Binary) {
+      if (auto f = executor.interpreterHandler->openOutputFile("run.istats.bin"))
+        istatsWriter.reset(new istats::BinaryWriter(std::move(f)));
+      else
+        klee_error("Unable to open instruction level stats file "
+                   "(run.istats.bin).");
     } else {
-      klee_error("Unable to open instruction level stats file (run.istats).");
+      istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
+      if (!istatsFile)
+        klee_error("Unable to open instruction level stats file (run.istats).");
+    }
+    if (iStatsWriteInterval)
+      executor.addTimer(new WriteIStatsTimer(this), iStatsWriteInterval);
+
+    if (TrackInstructionTime) {
+      const time::Span interval(InstructionTimeSampleInterval);
+      if (!interval)
+        klee_error("--instruction-time-sample-interval cannot be 0.");
+      profiler.reset(new SamplingProfiler(interval));
     }
   }
 }
 
 StatsTracker::~StatsTracker() {  
   if (statsFile) {
+    statsWriter.reset();
     auto rc = sqlite3_step(transactionEndStmt);
     if (rc != SQLITE_DONE) {
       klee_warning("Can't commit transaction: %s", sqlite3_errmsg(statsFile));
@@ -323,60 +472,60 @@ StatsTracker::~StatsTracker() {
     sqlite3_finalize(transactionBeginStmt);
     sqlite3_finalize(transactionEndStmt);
     sqlite3_finalize(insertStmt);
+    sqlite3_finalize(latencyStmt);
+    sqlite3_finalize(callPathStmt);
     sqlite3_close(statsFile);
   }
 }
 
 void StatsTracker::done() {
-  if (statsFile)
+  if (statsFile) {
     writeStatsLine();
+    if (UseCallPaths)
+      writeCallPaths();
+  }
 
   if (OutputIStats) {
     if (updateMinDistToUncovered)
       computeReachableUncovered();
-    if (istatsFile)
+    if (istatsFile || istatsWriter)
       writeIStats();
   }
+  profiler.reset();
 }
 
-void StatsTracker::stepInstruction(ExecutionState &es) {
-  if (OutputIStats) {
-    if (TrackInstructionTime) {
-      static time::Point lastNowTime(time::getWallTime());
-      static time::Span lastUserTime;
+void StatsTracker::resumeInstruction(ExecutionState &es) {
+  if (!OutputIStats)
+    return;
+  if (profiler && SamplingProfiler::pending())
+    chargeSamples();
 
-      if (!lastUserTime) {
-        lastUserTime = time::getUserTime();
-      } else {
-        const auto now = time::getWallTime();
-        const auto user = time::getUserTime();
-        const auto delta = user - lastUserTime;
-        const auto deltaNow = now - lastNowTime;
-        stats::instructionTime += delta.toMicroseconds();
-        stats::instructionRealTime += deltaNow.toMicroseconds();
-        lastUserTime = user;
-        lastNowTime = now;
-      }
-    }
+  StackFrame &sf = es.stack.back();
+  theStatisticManager->setIndex(es.pc->info->id);
+  if (UseCallPaths)
+    theStatisticManager->setContext(&sf.callPathNode->statistics);
+  if (profiler) {
+    sampledCallPath = sf.callPathNode;
+    sampledFunction = sf.kf->function;
+  }
+}
 
-    Instruction *inst = es.pc->inst;
+void StatsTracker::stepInstruction(ExecutionState &es) {
+  resumeInstruction(es);
+  if (OutputIStats) {
     const InstructionInfo &ii = *es.pc->info;
-    StackFrame &sf = es.stack.back();
-    theStatisticManager->setIndex(ii.id);
-    if (UseCallPaths)
-      theStatisticManager->setContext(&sf.callPathNode->statistics);
-
     if (es.instsSinceCovNew)
       ++es.instsSinceCovNew;
 
-    if (sf.kf->trackCoverage && instructionIsCoverable(inst)) {
+    if (uncovered.test(ii.id)) {
+      uncovered.reset(ii.id);
       if (!theStatisticManager->getIndexedValue(stats::coveredInstructions, ii.id)) {
         // Checking for actual stoppoints avoids inconsistencies due
         // to line number propogation.
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+        es.coveredInstructions.mutate().set(ii.id);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -385,17 +534,65 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     }
   }
 
+  // at the multiples of the intervals, without dividing every step
   if (statsFile && StatsWriteAfterInstructions &&
-      stats::instructions % StatsWriteAfterInstructions.getValue() == 0)
-    writeStatsLine();
+      stats::instructions >= nextStatsWrite) {
+    uint64_t interval = StatsWriteAfterInstructions;
+    if (stats::instructions % interval == 0)
+      writeStatsLine();
+    nextStatsWrite = (stats::instructions / interval + 1) * interval;
+  }
 
-  if (istatsFile && IStatsWriteAfterInstructions &&
-      stats::instructions % IStatsWriteAfterInstructions.getValue() == 0)
-    writeIStats();
+  if ((istatsFile || istatsWriter) && IStatsWriteAfterInstructions &&
+      stats::instructions >= nextIStatsWrite) {
+    uint64_t interval = IStatsWriteAfterInstructions;
+    if (stats::instructions % interval == 0)
+      writeIStats();
+    nextIStatsWrite = (stats::instructions / interval + 1) * interval;
+  }
 }
 
 ///
 
+void StatsTracker::chargeSamples() {
+  unsigned executing, solving;
+  SamplingProfiler::take(executing, solving);
+  if (!sampledFunction)
+    return;
+
+  // The statistics index and context are still those of the instruction
+  // last stepped, which the samples were taken while executing.
+  stats::instructionTime +=
+      (profiler->getInterval() * (executing + solving)).toMicroseconds();
+  const CallPathNode *cp = UseCallPaths ? sampledCallPath : nullptr;
+  if (executing)
+    foldedSamples[std::make_tuple(cp, sampledFunction, false)] += executing;
+  if (solving)
+    foldedSamples[std::make_tuple(cp, sampledFunction, true)] += solving;
+}
+
+void StatsTracker::writeFoldedStacks() {
+  auto of = executor.interpreterHandler->openOutputFile("run.folded");
+  if (!of)
+    return;
+
+  std::vector<const llvm::Function *> frames;
+  for (const auto &entry : foldedSamples) {
+    frames.clear();
+    for (const CallPathNode *cp = std::get<0>(entry.first);
+         cp && cp->function; cp = cp->parent)
+      frames.push_back(cp->function);
+    if (frames.empty())
+      frames.push_back(std::get<1>(entry.first));
+
+    for (auto it = frames.rbegin(), ie = frames.rend(); it != ie; ++it)
+      *of << (it == frames.rbegin() ? "" : ";") << (*it)->getName();
+    if (std::get<2>(entry.first))
+      *of << ";[solver]";
+    *of << " " << entry.second << "\n";
+  }
+}
+
 /* Should be called _after_ the es->pushFrame() */
 void StatsTracker::framePushed(ExecutionState &es, StackFrame *parentFrame) {
   if (OutputIStats) {
@@ -477,8 +674,28 @@ void StatsTracker::writeStatsHeader() {
 #ifdef KLEE_ARRAY_DEBUG
 	           << "ArrayHashTime INTEGER,"
 #endif
-             << "QueryCexCacheHits INTEGER"
-             << ")";
+             << "QueryCexCacheHits INTEGER,"
+             << "SearcherTime INTEGER,"
+             << "StateStackBytes INTEGER,"
+             << "StateCoveredLinesBytes INTEGER,"
+             << "StateArrayNamesBytes INTEGER,"
+             << "StateSymbolicsBytes INTEGER,"
+             << "StateConstraintsBytes INTEGER,"
+             << "StateAddressSpaceBytes INTEGER,"
+             << "StateObjectStatesBytes INTEGER,"
+             << "StateUpdatesBytes INTEGER,"
+             << "ExprArenaReserved INTEGER,"
+             << "ExprArenaLive INTEGER";
+  // The distribution of the measures of the queries, by name, as in
+  // QueryNodesP50, QueryNodesP99 and QueryNodesMax.
+  for (unsigned m = 0; m != TimingSolver::NumComplexityMetrics; ++m) {
+    const char *name =
+        TimingSolver::getMetricName((TimingSolver::ComplexityMetric)m);
+    create << ",Query" << name << "P50 INTEGER"
+           << ",Query" << name << "P99 INTEGER"
+           << ",Query" << name << "Max INTEGER";
+  }
+  create << ")";
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
     klee_error("%s", sqlite3ErrToStringAndFree("ERROR creating table: ", zErrMsg).c_str());
@@ -513,8 +730,26 @@ void StatsTracker::writeStatsHeader() {
 #ifdef KLEE_ARRAY_DEBUG
              << "ArrayHashTime,"
 #endif
-             << "QueryCexCacheHits "
-             << ") VALUES ( "
+             << "QueryCexCacheHits ,"
+             << "SearcherTime ,"
+             << "StateStackBytes ,"
+             << "StateCoveredLinesBytes ,"
+             << "StateArrayNamesBytes ,"
+             << "StateSymbolicsBytes ,"
+             << "StateConstraintsBytes ,"
+             << "StateAddressSpaceBytes ,"
+             << "StateObjectStatesBytes ,"
+             << "StateUpdatesBytes ,"
+             << "ExprArenaReserved ,"
+             << "ExprArenaLive ";
+  for (unsigned m = 0; m != TimingSolver::NumComplexityMetrics; ++m) {
+    const char *name =
+        TimingSolver::getMetricName((TimingSolver::ComplexityMetric)m);
+    insert << ", Query" << name << "P50"
+           << ", Query" << name << "P99"
+           << ", Query" << name << "Max";
+  }
+  insert     << ") VALUES ( "
              << "?, "
              << "?, "
              << "?, "
@@ -537,12 +772,153 @@ void StatsTracker::writeStatsHeader() {
 #ifdef KLEE_ARRAY_DEBUG
              << "?, "
 #endif
-             << "? "
-             << ")";
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "? ";
+  for (unsigned m = 0; m != TimingSolver::NumComplexityMetrics; ++m)
+    insert << ", ?, ?, ?";
+  insert << ")";
 
   if(sqlite3_prepare_v2(statsFile, insert.str().c_str(), -1, &insertStmt, nullptr) != SQLITE_OK) {
     klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(statsFile));
   }
+
+  // Query latency histograms by origin and instruction, where Count<i>
+  // counts the queries taking less than 10^(i+1)us (the last one all
+  // longer ones) and Time is their total in microseconds. Instruction is
+  // the id used in run.istats, or -1 outside of instructions.
+  std::ostringstream latencyCreate, latencyInsert;
+  latencyCreate << "CREATE TABLE query_latency "
+                << "(Origin TEXT,"
+                << "Instruction INTEGER,"
+                << "Function TEXT,"
+                << "File TEXT,"
+                << "Line INTEGER,";
+  latencyInsert << "INSERT OR REPLACE INTO query_latency VALUES (?, ?, ?, ?, ?, ";
+  for (unsigned i = 0; i != TimingSolver::NumLatencyBuckets; ++i) {
+    latencyCreate << "Count" << i << " INTEGER,";
+    latencyInsert << "?, ";
+  }
+  latencyCreate << "Time INTEGER,"
+                << "PRIMARY KEY (Origin, Instruction))";
+  latencyInsert << "?)";
+  if (sqlite3_exec(statsFile, latencyCreate.str().c_str(), nullptr, nullptr, &zErrMsg)) {
+    klee_error("%s", sqlite3ErrToStringAndFree("ERROR creating table: ", zErrMsg).c_str());
+  }
+  if (sqlite3_prepare_v2(statsFile, latencyInsert.str().c_str(), -1, &latencyStmt, nullptr) != SQLITE_OK) {
+    klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(statsFile));
+  }
+
+  // What is attributed to each call path, written at the end of the run.
+  // Path is the functions from main, separated by semicolons; the values
+  // exclude those of the paths it calls. SolverTime is in microseconds.
+  if (UseCallPaths) {
+    if (sqlite3_exec(statsFile,
+                     "CREATE TABLE call_paths "
+                     "(Path TEXT PRIMARY KEY,"
+                     "Calls INTEGER,"
+                     "Instructions INTEGER,"
+                     "Forks INTEGER,"
+                     "SolverTime INTEGER,"
+                     "AllocatedBytes INTEGER)",
+                     nullptr, nullptr, &zErrMsg)) {
+      klee_error("%s", sqlite3ErrToStringAndFree("ERROR creating table: ", zErrMsg).c_str());
+    }
+    if (sqlite3_prepare_v2(statsFile,
+                           "INSERT INTO call_paths VALUES (?, ?, ?, ?, ?, ?)",
+                           -1, &callPathStmt, nullptr) != SQLITE_OK) {
+      klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(statsFile));
+    }
+  }
+}
+
+void StatsTracker::writeQueryLatency() {
+  for (auto &entry : executor.solver->getLatency()) {
+    TimingSolver::LatencyHistogram &histogram = entry.second;
+    if (!histogram.dirty)
+      continue;
+    histogram.dirty = false;
+
+    const KInstruction *ki = entry.first.second;
+    std::unique_ptr<StatsRow> row(new StatsRow(latencyStmt, false));
+    row->add(TimingSolver::getOriginName(entry.first.first));
+    row->add(ki ? (int64_t)ki->info->id : -1);
+    row->add(ki ? ki->inst->getParent()->getParent()->getName().str()
+                : std::string());
+    row->add(ki ? ki->info->file : std::string());
+    row->add(ki ? (int64_t)ki->info->line : 0);
+    for (uint64_t count : histogram.counts)
+      row->add(count);
+    row->add(histogram.time);
+    // A histogram which could not be queued is written the next time.
+    if (!statsWriter->push(std::move(row)))
+      histogram.dirty = true;
+  }
+}
+
+void StatsTracker::publishMetrics() {
+  MetricsServer::Gauges &gauges = metricsServer->getGauges();
+  gauges.states.store(executor.states.size(), std::memory_order_relaxed);
+  gauges.mallocUsage.store(util::GetTotalMallocUsage(),
+                           std::memory_order_relaxed);
+  gauges.deterministicUsage.store(executor.memory->getUsedDeterministicSize(),
+                                  std::memory_order_relaxed);
+
+  uint64_t counts[TimingSolver::NumQueryOrigins]
+                 [TimingSolver::NumLatencyBuckets] = {};
+  uint64_t times[TimingSolver::NumQueryOrigins] = {};
+  for (auto &entry : executor.solver->getLatency()) {
+    const TimingSolver::LatencyHistogram &histogram = entry.second;
+    unsigned origin = entry.first.first;
+    for (unsigned i = 0; i != TimingSolver::NumLatencyBuckets; ++i)
+      counts[origin][i] += histogram.counts[i];
+    times[origin] += histogram.time;
+  }
+  for (unsigned o = 0; o != TimingSolver::NumQueryOrigins; ++o) {
+    for (unsigned i = 0; i != TimingSolver::NumLatencyBuckets; ++i)
+      gauges.latencyCounts[o][i].store(counts[o][i],
+                                       std::memory_order_relaxed);
+    gauges.latencyTime[o].store(times[o], std::memory_order_relaxed);
+  }
+}
+
+void StatsTracker::writeCallPaths() {
+  // Paths differing only in their call sites are merged.
+  struct Totals {
+    uint64_t calls = 0;
+    StatisticRecord statistics;
+  };
+  std::map<std::string, Totals> totals;
+  std::string path;
+  for (const auto &cp : callPathManager.getCallPaths()) {
+    path.clear();
+    for (const CallPathNode *p = &cp; p && p->function; p = p->parent)
+      path.insert(0, (p == &cp ? "" : ";") + p->function->getName().str());
+    Totals &t = totals[path];
+    t.calls += cp.count;
+    t.statistics += cp.statistics;
+  }
+
+  for (const auto &entry : totals) {
+    const StatisticRecord &sr = entry.second.statistics;
+    std::unique_ptr<StatsRow> row(new StatsRow(callPathStmt, false));
+    row->add(entry.first);
+    row->add(entry.second.calls);
+    row->add(sr.getValue(stats::instructions));
+    row->add(sr.getValue(stats::forks));
+    row->add(sr.getValue(stats::solverTime));
+    row->add(sr.getValue(stats::allocatedBytes));
+    statsWriter->pushWaiting(std::move(row));
+  }
 }
 
 time::Span StatsTracker::elapsed() {
@@ -550,48 +926,62 @@ time::Span StatsTracker::elapsed() {
 }
 
 void StatsTracker::writeStatsLine() {
-  sqlite3_bind_int64(insertStmt, 1, stats::instructions);
-  sqlite3_bind_int64(insertStmt, 2, fullBranches);
-  sqlite3_bind_int64(insertStmt, 3, partialBranches);
-  sqlite3_bind_int64(insertStmt, 4, numBranches);
-  sqlite3_bind_int64(insertStmt, 5, time::getUserTime().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, 6, executor.states.size());
-  sqlite3_bind_int64(insertStmt, 7, util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
-  sqlite3_bind_int64(insertStmt, 8, stats::queries);
-  sqlite3_bind_int64(insertStmt, 9, stats::queryConstructs);
-  sqlite3_bind_int64(insertStmt, 10, 0);  // was numObjects
-  sqlite3_bind_int64(insertStmt, 11, elapsed().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, 12, stats::coveredInstructions);
-  sqlite3_bind_int64(insertStmt, 13, stats::uncoveredInstructions);
-  sqlite3_bind_int64(insertStmt, 14, stats::queryTime);
-  sqlite3_bind_int64(insertStmt, 15, stats::solverTime);
-  sqlite3_bind_int64(insertStmt, 16, stats::cexCacheTime);
-  sqlite3_bind_int64(insertStmt, 17, stats::forkTime);
-  sqlite3_bind_int64(insertStmt, 18, stats::resolveTime);
-  sqlite3_bind_int64(insertStmt, 19, stats::queryCexCacheMisses);
-  sqlite3_bind_int64(insertStmt, 20, stats::queryCexCacheHits);
+  KLEE_TRACE_SCOPE("StatsTracker::writeStatsLine");
+  std::unique_ptr<StatsRow> row(new StatsRow(insertStmt, true));
+  row->add(stats::instructions);
+  row->add(fullBranches);
+  row->add(partialBranches);
+  row->add(numBranches);
+  row->add(time::getUserTime().toMicroseconds());
+  row->add(executor.states.size());
+  row->add(util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
+  row->add(stats::queries);
+  row->add(stats::queryConstructs);
+  row->add(0);  // was numObjects
+  row->add(elapsed().toMicroseconds());
+  row->add(stats::coveredInstructions);
+  row->add(stats::uncoveredInstructions);
+  row->add(stats::queryTime);
+  row->add(stats::solverTime);
+  row->add(stats::cexCacheTime);
+  row->add(stats::forkTime);
+  row->add(stats::resolveTime);
+  row->add(stats::queryCexCacheMisses);
 #ifdef KLEE_ARRAY_DEBUG
-  sqlite3_bind_int64(insertStmt, 21, stats::arrayHashTime);
+  row->add(stats::arrayHashTime);
 #endif
-  int errCode = sqlite3_step(insertStmt);
-  if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
-  sqlite3_reset(insertStmt);
-
-  statsWriteCount++;
-  if(statsWriteCount == statsCommitEvery) {
-    errCode = sqlite3_step(transactionEndStmt);
-    if (errCode != SQLITE_DONE) klee_warning("Transaction commit error: %s", sqlite3_errmsg(statsFile));
-    sqlite3_reset(transactionEndStmt);
-    errCode = sqlite3_step(transactionBeginStmt);
-    if (errCode != SQLITE_DONE) klee_warning("Transaction begin error: %s", sqlite3_errmsg(statsFile));
-    sqlite3_reset(transactionBeginStmt);
-
-    statsWriteCount = 0;
+  row->add(stats::queryCexCacheHits);
+  row->add(stats::searcherTime);
+  StateFootprint footprint;
+  if (OutputStateFootprint) {
+    std::unordered_set<const void *> seen;
+    for (const ExecutionState *es : executor.states)
+      es->addFootprint(footprint, seen);
   }
+  row->add(footprint.stack);
+  row->add(footprint.coveredLines);
+  row->add(footprint.arrayNames);
+  row->add(footprint.symbolics);
+  row->add(footprint.constraints);
+  row->add(footprint.addressSpace);
+  row->add(footprint.objectStates);
+  row->add(footprint.updates);
+  row->add(ExprAllocator::getReservedBytes());
+  row->add(ExprAllocator::getLiveBytes());
+  for (unsigned m = 0; m != TimingSolver::NumComplexityMetrics; ++m) {
+    const TimingSolver::ComplexityHistogram &histogram =
+        executor.solver->getComplexity((TimingSolver::ComplexityMetric)m);
+    row->add(histogram.getPercentile(50));
+    row->add(histogram.getPercentile(99));
+    row->add(histogram.max);
+  }
+  statsWriter->push(std::move(row));
+
+  writeQueryLatency();
 }
 
 void StatsTracker::updateStateStatistics(uint64_t addend) {
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+  for (StateSet::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState &state = **it;
     const InstructionInfo &ii = *state.pc->info;
@@ -601,9 +991,39 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
+/// The statistics written to run.istats, by id.
+static std::vector<bool> getIStatsMask(StatisticManager &sm) {
+  std::vector<bool> istatsMask(sm.getNumStatistics());
+  istatsMask[sm.getStatisticID("Queries")] = true;
+  istatsMask[sm.getStatisticID("QueriesValid")] = true;
+  istatsMask[sm.getStatisticID("QueriesInvalid")] = true;
+  istatsMask[sm.getStatisticID("QueryTime")] = true;
+  istatsMask[sm.getStatisticID("ResolveTime")] = true;
+  istatsMask[sm.getStatisticID("Instructions")] = true;
+  istatsMask[sm.getStatisticID("InstructionTimes")] = true;
+  istatsMask[sm.getStatisticID("Forks")] = true;
+  istatsMask[sm.getStatisticID("CoveredInstructions")] = true;
+  istatsMask[sm.getStatisticID("UncoveredInstructions")] = true;
+  istatsMask[sm.getStatisticID("States")] = true;
+  istatsMask[sm.getStatisticID("MinDistToUncovered")] = true;
+  if (OutputQueryComplexity) {
+    istatsMask[stats::queryNodes.getID()] = true;
+    istatsMask[stats::queryMaxDepth.getID()] = true;
+    istatsMask[stats::queryArrays.getID()] = true;
+    istatsMask[stats::queryUpdates.getID()] = true;
+    istatsMask[stats::queryConstraints.getID()] = true;
+  }
+  return istatsMask;
+}
+
 void StatsTracker::writeIStats() {
+  KLEE_TRACE_SCOPE("StatsTracker::writeIStats");
+  if (istatsWriter) {
+    writeBinaryIStats();
+    return;
+  }
+
   const auto m = executor.kmodule->module.get();
-  uint64_t istatsMask = 0;
   llvm::raw_fd_ostream &of = *istatsFile;
   
   // We assume that we didn't move the file pointer
@@ -619,26 +1039,12 @@ void StatsTracker::writeIStats() {
 
   StatisticManager &sm = *theStatisticManager;
   unsigned nStats = sm.getNumStatistics();
-
-  // Max is 13, sadly
-  istatsMask |= 1<<sm.getStatisticID("Queries");
-  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
-  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
-  istatsMask |= 1<<sm.getStatisticID("QueryTime");
-  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
-  istatsMask |= 1<<sm.getStatisticID("Instructions");
-  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
-  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
-  istatsMask |= 1<<sm.getStatisticID("Forks");
-  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("States");
-  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  std::vector<bool> istatsMask = getIStatsMask(sm);
 
   of << "positions: instr line\n";
 
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i)) {
+    if (istatsMask[i]) {
       Statistic &s = sm.getStatistic(i);
       of << "event: " << s.getShortName() << " : " 
          << s.getName() << "\n";
@@ -647,14 +1053,14 @@ void StatsTracker::writeIStats() {
 
   of << "events: ";
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i))
+    if (istatsMask[i])
       of << sm.getStatistic(i).getShortName() << " ";
   }
   of << "\n";
   
   // set state counts, decremented after we process so that we don't
   // have to zero all records each time.
-  if (istatsMask & (1<<stats::states.getID()))
+  if (istatsMask[stats::states.getID()])
     updateStateStatistics(1);
 
   std::string sourceFile = "";
@@ -693,7 +1099,7 @@ void StatsTracker::writeIStats() {
           of << ii.assemblyLine << " ";
           of << ii.line << " ";
           for (unsigned i=0; i<nStats; i++)
-            if (istatsMask&(1<<i))
+            if (istatsMask[i])
               of << sm.getIndexedValue(sm.getStatistic(i), index) << " ";
           of << "\n";
 
@@ -718,7 +1124,7 @@ void StatsTracker::writeIStats() {
                 of << ii.assemblyLine << " ";
                 of << ii.line << " ";
                 for (unsigned i=0; i<nStats; i++) {
-                  if (istatsMask&(1<<i)) {
+                  if (istatsMask[i]) {
                     Statistic &s = sm.getStatistic(i);
                     uint64_t value;
 
@@ -742,7 +1148,7 @@ void StatsTracker::writeIStats() {
     }
   }
 
-  if (istatsMask & (1<<stats::states.getID()))
+  if (istatsMask[stats::states.getID()])
     updateStateStatistics((uint64_t)-1);
   
   // Clear then end of the file if necessary (no truncate op?).
@@ -751,6 +1157,96 @@ void StatsTracker::writeIStats() {
     of << '\n';
   
   of.flush();
+
+  if (profiler)
+    writeFoldedStacks();
+}
+
+void StatsTracker::writeBinaryIStats() {
+  const auto m = executor.kmodule->module.get();
+  StatisticManager &sm = *theStatisticManager;
+  const InstructionInfoTable &infos = *executor.kmodule->infos;
+
+  std::vector<Statistic *> events;
+  std::vector<bool> istatsMask = getIStatsMask(sm);
+  for (unsigned i = 0; i < sm.getNumStatistics(); i++)
+    if (istatsMask[i])
+      events.push_back(&sm.getStatistic(i));
+  const unsigned n = events.size();
+
+  // The functions and instructions are described once, by the first dump.
+  if (istatsInstructions.empty()) {
+    std::vector<std::pair<std::string, std::string> > names;
+    for (Statistic *s : events)
+      names.emplace_back(s->getShortName(), s->getName());
+    istatsWriter->writeHeader(getpid(), m->getModuleIdentifier(),
+                              objectFilename, names);
+
+    unsigned maxID = 0;
+    for (Function &fn : *m) {
+      if (fn.isDeclaration())
+        continue;
+      const FunctionInfo &fi = infos.getFunctionInfo(fn);
+      istatsWriter->writeFunction(fi.id, fn.getName().str(), fi.file, fi.line,
+                                  fi.assemblyLine);
+      for (Instruction &instr : instructions(fn)) {
+        const InstructionInfo &ii = infos.getInfo(instr);
+        istatsWriter->writeInstruction(ii.id, fi.id, ii.file, ii.line,
+                                       ii.assemblyLine);
+        istatsInstructions.push_back(ii.id);
+        maxID = std::max(maxID, ii.id);
+      }
+    }
+    // ids are given out as functions are first looked up, so not in the
+    // order of the module
+    std::sort(istatsInstructions.begin(), istatsInstructions.end());
+    istatsLast.assign((maxID + 1) * n, 0);
+  }
+
+  if (istatsMask[stats::states.getID()])
+    updateStateStatistics(1);
+
+  std::vector<uint64_t> values(n);
+  for (unsigned id : istatsInstructions) {
+    for (unsigned i = 0; i < n; i++)
+      values[i] = sm.getIndexedValue(*events[i], id);
+    istatsWriter->addValues(id, values.data(), &istatsLast[id * n]);
+  }
+  istatsWriter->endValues();
+
+  if (UseCallPaths) {
+    CallSiteSummaryTable callSiteStats;
+    callPathManager.getSummaryStatistics(callSiteStats);
+    std::map<std::pair<unsigned, unsigned>, const CallSiteInfo *> sites;
+    for (auto &site : callSiteStats) {
+      unsigned caller = infos.getInfo(*site.first).id;
+      for (auto &callee : site.second)
+        sites[std::make_pair(caller,
+                             infos.getFunctionInfo(*callee.first).id)] =
+            &callee.second;
+    }
+    for (auto &site : sites) {
+      const CallSiteInfo &csi = *site.second;
+      for (unsigned i = 0; i < n; i++)
+        // Hack, ignore things that don't make sense on call paths.
+        values[i] = events[i] == &stats::uncoveredInstructions
+                        ? 0
+                        : csi.statistics.getValue(*events[i]);
+      std::vector<uint64_t> &last = istatsCallsLast[site.first];
+      last.resize(n + 1);
+      istatsWriter->addCall(site.first.first, site.first.second, csi.count,
+                            values.data(), last.data());
+    }
+    istatsWriter->endCalls();
+  }
+
+  if (istatsMask[stats::states.getID()])
+    updateStateStatistics((uint64_t)-1);
+
+  istatsWriter->flush();
+
+  if (profiler)
+    writeFoldedStacks();
 }
 
 ///
@@ -797,7 +1293,149 @@ uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
   }
 }
 
+UncoveredDistances::UncoveredDistances(KModule &km) {
+  const InstructionInfoTable &infos = *km.infos;
+  unsigned numIds = infos.getMaxID();
+  std::vector<std::vector<Edge> > edges(numIds);
+  for (Function &f : *km.module) {
+    for (BasicBlock &bb : f) {
+      for (Instruction &i : bb) {
+        unsigned id = infos.getInfo(i).id;
+        if (isUncovered(id))
+          uncovered.push_back(id);
+
+        // Through a call, the shortest path through its callees, if any
+        // returns. The distances of the callees are not followed, being
+        // kept at their function's id, which is never set.
+        uint64_t through = 1;
+        if (isa<CallInst>(i) || isa<InvokeInst>(i)) {
+          through = 0;
+          for (Function *target : callTargets[&i]) {
+            uint64_t dist = functionShortestPath[target];
+            if (dist && (!through || 1 + dist < through))
+              through = 1 + dist;
+          }
+        }
+        if (through)
+          for (Instruction *succ : getSuccs(&i))
+            edges[id].push_back({infos.getInfo(*succ).id, (unsigned)through});
+      }
+    }
+  }
+
+  succBegin.assign(numIds + 1, 0);
+  predBegin.assign(numIds + 1, 0);
+  for (unsigned id = 0; id != numIds; ++id) {
+    succBegin[id + 1] = succBegin[id] + edges[id].size();
+    for (const Edge &e : edges[id])
+      ++predBegin[e.id + 1];
+  }
+  for (unsigned id = 0; id != numIds; ++id)
+    predBegin[id + 1] += predBegin[id];
+  succs.reserve(succBegin[numIds]);
+  preds.resize(predBegin[numIds]);
+  std::vector<unsigned> nextPred(predBegin.begin(), predBegin.end() - 1);
+  for (unsigned id = 0; id != numIds; ++id) {
+    for (const Edge &e : edges[id]) {
+      succs.push_back(e);
+      preds[nextPred[e.id]++] = {id, e.weight};
+    }
+  }
+
+  distance.assign(numIds, 0);
+  affected.assign(numIds, false);
+  Queue queue;
+  for (unsigned id : uncovered) {
+    distance[id] = 1;
+    queue.push(std::make_pair(1, id));
+  }
+  propagate(queue, false);
+  for (unsigned id = 0; id != numIds; ++id)
+    theStatisticManager->setIndexedValue(stats::minDistToUncovered, id,
+                                         distance[id]);
+}
+
+void UncoveredDistances::propagate(Queue &queue, bool onlyAffected) {
+  while (!queue.empty()) {
+    QueueEntry top = queue.top();
+    queue.pop();
+    if (top.first != distance[top.second])
+      continue;
+    for (unsigned i = predBegin[top.second]; i != predBegin[top.second + 1];
+         ++i) {
+      const Edge &e = preds[i];
+      uint64_t dist = top.first + e.weight;
+      if ((!onlyAffected || affected[e.id]) &&
+          (!distance[e.id] || dist < distance[e.id])) {
+        distance[e.id] = dist;
+        queue.push(std::make_pair(dist, e.id));
+      }
+    }
+  }
+}
+
+void UncoveredDistances::update() {
+  // The instructions covered since the last update lose their distance.
+  Queue candidates;
+  auto covered = std::partition(uncovered.begin(), uncovered.end(),
+                                [this](unsigned id) { return isUncovered(id); });
+  for (auto it = covered, ie = uncovered.end(); it != ie; ++it)
+    candidates.push(std::make_pair(1, *it));
+  uncovered.erase(covered, uncovered.end());
+  if (candidates.empty())
+    return;
+
+  // Find the instructions whose distance is no longer that of a successor
+  // which keeps its own, in order of distance so that the successors of an
+  // instruction are settled before it. Those of uncovered ones are 1.
+  std::vector<unsigned> changed;
+  while (!candidates.empty()) {
+    unsigned id = candidates.top().second;
+    candidates.pop();
+    if (affected[id] || (distance[id] == 1 && isUncovered(id)))
+      continue;
+    bool kept = false;
+    for (unsigned i = succBegin[id]; !kept && i != succBegin[id + 1]; ++i) {
+      const Edge &e = succs[i];
+      kept = !affected[e.id] && distance[e.id] &&
+             distance[e.id] + e.weight == distance[id];
+    }
+    if (kept)
+      continue;
+    affected[id] = true;
+    changed.push_back(id);
+    for (unsigned i = predBegin[id]; i != predBegin[id + 1]; ++i) {
+      const Edge &e = preds[i];
+      if (!affected[e.id] && distance[e.id] == distance[id] + e.weight)
+        candidates.push(std::make_pair(distance[e.id], e.id));
+    }
+  }
+
+  // Recompute their distances from those of the other successors.
+  Queue queue;
+  for (unsigned id : changed) {
+    uint64_t best = 0;
+    for (unsigned i = succBegin[id]; i != succBegin[id + 1]; ++i) {
+      const Edge &e = succs[i];
+      if (!affected[e.id] && distance[e.id] &&
+          (!best || distance[e.id] + e.weight < best))
+        best = distance[e.id] + e.weight;
+    }
+    distance[id] = best;
+    if (best)
+      queue.push(std::make_pair(best, id));
+  }
+  propagate(queue, true);
+
+  for (unsigned id : changed) {
+    affected[id] = false;
+    theStatisticManager->setIndexedValue(stats::minDistToUncovered, id,
+                                         distance[id]);
+  }
+}
+
 void StatsTracker::computeReachableUncovered() {
+  ++reachableUpdates;
   KModule *km = executor.kmodule.get();
   const auto m = km->module.get();
   static bool init = true;
@@ -935,86 +1573,11 @@ void StatsTracker::computeReachableUncovered() {
     } while (changed);
   }
 
-  // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        Instruction *inst = &*it;
-        unsigned id = infos.getInfo(*inst).id;
-        instructions.push_back(inst);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
-  }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getInfo(*inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(
-                stats::minDistToUncovered, infos.getFunctionInfo(*(*fnIt)).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
-      
-      if (bestThrough) {
-        std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*(*it2)).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
-        }
-      }
-
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, infos.getInfo(*inst).id,
-                           best);
-        changed = true;
-      }
-    }
-  } while (changed);
+  if (!uncoveredDistances)
+    uncoveredDistances.reset(new UncoveredDistances(*km));
+  uncoveredDistances->update();
 
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+  for (StateSet::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState *es = *it;
     uint64_t currentFrameMinDist = 0;
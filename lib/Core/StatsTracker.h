@@ -13,8 +13,13 @@
 #include "CallPathManager.h"
 #include "klee/Internal/System/Time.h"
 
+#include "llvm/ADT/BitVector.h"
+
+#include <map>
 #include <memory>
 #include <set>
+#include <tuple>
+#include <vector>
 #include <sqlite3.h>
 
 namespace llvm {
@@ -30,22 +35,43 @@ namespace klee {
   class InstructionInfoTable;
   class InterpreterHandler;
   struct KInstruction;
+  class MetricsServer;
+  class SamplingProfiler;
+  class StatsWriter;
+  class UncoveredDistances;
   struct StackFrame;
 
+  namespace istats {
+  class BinaryWriter;
+  }
+
   class StatsTracker {
     friend class WriteStatsTimer;
     friend class WriteIStatsTimer;
+    friend class PublishMetricsTimer;
 
     Executor &executor;
     std::string objectFilename;
 
     std::unique_ptr<llvm::raw_fd_ostream> istatsFile;
+    /// With --istats-format=binary, instead of istatsFile.
+    std::unique_ptr<istats::BinaryWriter> istatsWriter;
+    /// The ids of the instructions in increasing order, and the values of
+    /// each and of each call site (with the number of calls first) as of
+    /// the previous binary dump.
+    std::vector<unsigned> istatsInstructions;
+    std::vector<uint64_t> istatsLast;
+    std::map<std::pair<unsigned, unsigned>, std::vector<uint64_t> >
+        istatsCallsLast;
     ::sqlite3 *statsFile = nullptr;
     ::sqlite3_stmt *transactionBeginStmt = nullptr;
     ::sqlite3_stmt *transactionEndStmt = nullptr;
     ::sqlite3_stmt *insertStmt = nullptr;
+    ::sqlite3_stmt *latencyStmt = nullptr;
+    ::sqlite3_stmt *callPathStmt = nullptr;
     std::uint32_t statsCommitEvery;
-    std::uint32_t statsWriteCount = 0;
+    std::unique_ptr<StatsWriter> statsWriter;
+    std::unique_ptr<MetricsServer> metricsServer;
     time::Point startWallTime;
 
     unsigned numBranches;
@@ -54,6 +80,26 @@ namespace klee {
     CallPathManager callPathManager;
 
     bool updateMinDistToUncovered;
+    /// The coverable instructions not covered yet, by id, so that stepping
+    /// the others is a single test.
+    llvm::BitVector uncovered;
+    /// The values of stats::instructions at which the statistics are
+    /// written next, for --stats-write-after-instructions and
+    /// --istats-write-after-instructions.
+    uint64_t nextStatsWrite = 0, nextIStatsWrite = 0;
+    unsigned reachableUpdates = 0;
+    std::unique_ptr<UncoveredDistances> uncoveredDistances;
+
+    std::unique_ptr<SamplingProfiler> profiler;
+    /// The call path and function of the instruction last stepped, which
+    /// the samples taken since are charged to.
+    const CallPathNode *sampledCallPath = nullptr;
+    const llvm::Function *sampledFunction = nullptr;
+    /// The number of samples of each call path (or function, without call
+    /// paths), inside and outside the solver.
+    std::map<std::tuple<const CallPathNode *, const llvm::Function *, bool>,
+             uint64_t>
+        foldedSamples;
 
   public:
     static bool useStatistics();
@@ -63,7 +109,13 @@ namespace klee {
     void updateStateStatistics(uint64_t addend);
     void writeStatsHeader();
     void writeStatsLine();
+    void writeQueryLatency();
+    void publishMetrics();
+    void writeCallPaths();
     void writeIStats();
+    void writeBinaryIStats();
+    void chargeSamples();
+    void writeFoldedStacks();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -94,10 +146,18 @@ namespace klee {
     // about to be stepped
     void stepInstruction(ExecutionState &es);
 
+    // attribute the statistics to the instruction es executes again, as a
+    // branch deferred until its condition is evaluated, without counting it
+    void resumeInstruction(ExecutionState &es);
+
     /// Return duration since execution start.
     time::Span elapsed();
 
     void computeReachableUncovered();
+
+    /// How often computeReachableUncovered() ran, so that the weights
+    /// derived from the distances can be refreshed when they change.
+    unsigned getReachableUpdates() const { return reachableUpdates; }
   };
 
   uint64_t computeMinDistToUncovered(const KInstruction *ki,
@@ -0,0 +1,96 @@
+//===-- StatsWriter.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StatsWriter.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <chrono>
+
+using namespace klee;
+
+StatsWriter::StatsWriter(::sqlite3 *db, ::sqlite3_stmt *transactionBeginStmt,
+                         ::sqlite3_stmt *transactionEndStmt,
+                         unsigned commitEvery)
+    : db(db), transactionBeginStmt(transactionBeginStmt),
+      transactionEndStmt(transactionEndStmt), commitEvery(commitEvery),
+      head(0), tail(0), stopping(false), thread(&StatsWriter::run, this) {}
+
+StatsWriter::~StatsWriter() {
+  stopping = true;
+  ready.notify_one();
+  thread.join();
+  if (dropped)
+    klee_warning("%llu statistics rows were dropped as the disk could not "
+                 "keep up",
+                 (unsigned long long)dropped);
+}
+
+bool StatsWriter::push(std::unique_ptr<StatsRow> row) {
+  size_t t = tail.load(std::memory_order_relaxed);
+  if (t - head.load(std::memory_order_acquire) == Capacity) {
+    ++dropped;
+    return false;
+  }
+  queue[t % Capacity] = std::move(row);
+  tail.store(t + 1, std::memory_order_release);
+  ready.notify_one();
+  return true;
+}
+
+void StatsWriter::pushWaiting(std::unique_ptr<StatsRow> row) {
+  size_t t = tail.load(std::memory_order_relaxed);
+  while (t - head.load(std::memory_order_acquire) == Capacity) {
+    ready.notify_one();
+    std::this_thread::yield();
+  }
+  queue[t % Capacity] = std::move(row);
+  tail.store(t + 1, std::memory_order_release);
+  ready.notify_one();
+}
+
+void StatsWriter::run() {
+  for (;;) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      if (stopping)
+        return;
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait_for(lock, std::chrono::milliseconds(100));
+      continue;
+    }
+    std::unique_ptr<StatsRow> row = std::move(queue[h % Capacity]);
+    head.store(h + 1, std::memory_order_release);
+    write(*row);
+  }
+}
+
+void StatsWriter::write(StatsRow &row) {
+  int column = 1;
+  for (const StatsRow::Value &v : row.values) {
+    if (v.isText)
+      sqlite3_bind_text(row.stmt, column++, v.text.c_str(), -1,
+                        SQLITE_TRANSIENT);
+    else
+      sqlite3_bind_int64(row.stmt, column++, v.integer);
+  }
+  if (sqlite3_step(row.stmt) != SQLITE_DONE)
+    klee_warning("Error writing stats data: %s", sqlite3_errmsg(db));
+  sqlite3_reset(row.stmt);
+
+  if (!row.commits || ++uncommitted != commitEvery)
+    return;
+  uncommitted = 0;
+  if (sqlite3_step(transactionEndStmt) != SQLITE_DONE)
+    klee_warning("Transaction commit error: %s", sqlite3_errmsg(db));
+  sqlite3_reset(transactionEndStmt);
+  if (sqlite3_step(transactionBeginStmt) != SQLITE_DONE)
+    klee_warning("Transaction begin error: %s", sqlite3_errmsg(db));
+  sqlite3_reset(transactionBeginStmt);
+}
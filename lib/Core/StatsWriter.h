@@ -0,0 +1,100 @@
+//===-- StatsWriter.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATSWRITER_H
+#define KLEE_STATSWRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace klee {
+  /// The values of one row to insert with a prepared statement, bound to
+  /// its parameters in order.
+  class StatsRow {
+    friend class StatsWriter;
+
+    struct Value {
+      int64_t integer;
+      std::string text;
+      bool isText;
+    };
+
+    ::sqlite3_stmt *stmt;
+    std::vector<Value> values;
+    /// Whether it counts towards committing the transaction.
+    bool commits;
+
+  public:
+    StatsRow(::sqlite3_stmt *stmt, bool commits)
+      : stmt(stmt), commits(commits) {}
+
+    void add(int64_t integer) { values.push_back({integer, "", false}); }
+    void add(const std::string &text) { values.push_back({0, text, true}); }
+  };
+
+  /// Inserts rows into the statistics database on a thread of its own, so
+  /// that a slow disk never stalls the execution. Rows are handed over
+  /// through a bounded single producer, single consumer queue which does
+  /// not take locks; when it is full, rows are dropped rather than waited
+  /// for.
+  ///
+  /// The database and its statements belong to the writer from its
+  /// construction until its destruction, which waits for the queued rows
+  /// to be written.
+  class StatsWriter {
+    static const size_t Capacity = 1024;
+
+    ::sqlite3 *db;
+    ::sqlite3_stmt *transactionBeginStmt, *transactionEndStmt;
+    /// The number of rows after which the transaction is committed.
+    unsigned commitEvery;
+    unsigned uncommitted = 0;
+
+    std::unique_ptr<StatsRow> queue[Capacity];
+    /// The next row to write, and the next free slot.
+    std::atomic<size_t> head, tail;
+    std::atomic<bool> stopping;
+    uint64_t dropped = 0;
+
+    /// Wakes up the thread, which also polls in case a notification is
+    /// missed, as the producer notifies without holding the mutex.
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::thread thread;
+
+    void run();
+    void write(StatsRow &row);
+
+  public:
+    StatsWriter(::sqlite3 *db, ::sqlite3_stmt *transactionBeginStmt,
+                ::sqlite3_stmt *transactionEndStmt, unsigned commitEvery);
+    ~StatsWriter();
+
+    StatsWriter(const StatsWriter &) = delete;
+    StatsWriter &operator=(const StatsWriter &) = delete;
+
+    /// Queues \a row for writing, returning false if it was dropped.
+    bool push(std::unique_ptr<StatsRow> row);
+    /// Queues \a row for writing, waiting for room if the queue is full.
+    /// For the end of the run, when the rows must not be lost.
+    void pushWaiting(std::unique_ptr<StatsRow> row);
+
+    /// The number of rows dropped because the queue was full.
+    uint64_t getDropped() const { return dropped; }
+  };
+}
+
+#endif
@@ -0,0 +1,158 @@
+//===-- Subsumption.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Subsumption.h"
+
+#include "TimingSolver.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace klee;
+
+namespace {
+/// The entries or hashes recorded at most, after which states are only
+/// checked.
+const size_t MaxEntries = 100000;
+
+/// The entries a state keeps track of at most. Older ones are given up,
+/// as their paths would not all be explored for a long time.
+const size_t MaxOpenEntries = 64;
+}
+
+/// Whether the state is about to execute the first instruction of a join
+/// block, with all the values the paths from there depend on hashed.
+static bool isAtJoinBlock(const ExecutionState &state) {
+  const llvm::Instruction *inst = state.pc->inst;
+  const llvm::BasicBlock *bb = inst->getParent();
+  if (inst != &bb->front() || bb == &bb->getParent()->getEntryBlock() ||
+      bb->getSinglePredecessor())
+    return false;
+  // the values held by an open merge or a recorded call are not hashed
+  return !state.summaryRecording && state.openMergeStack.empty() &&
+         state.lazyCondition.isNull();
+}
+
+/// Appends the constraints of the state which read the arrays its values
+/// refer to.
+static void getRelevantConstraints(const ExecutionState &state,
+                                   std::vector<ref<Expr> > &result) {
+  std::vector<const Array *> live;
+  state.findLiveArrays(live);
+  std::set<const Array *> liveSet(live.begin(), live.end());
+  std::vector<ConstraintManager::constraints_ty> factors;
+  state.constraints.getIndependentFactors(ConstantExpr::alloc(1, Expr::Bool),
+                                          factors);
+  for (const ConstraintManager::constraints_ty &factor : factors) {
+    std::vector<const Array *> arrays;
+    findSymbolicObjects(factor.begin(), factor.end(), arrays);
+    if (std::any_of(arrays.begin(), arrays.end(),
+                    [&](const Array *a) { return liveSet.count(a) != 0; }))
+      result.insert(result.end(), factor.begin(), factor.end());
+  }
+}
+
+bool SubsumptionTable::isDuplicate(const ExecutionState &state) {
+  if (!isAtJoinBlock(state))
+    return false;
+
+  std::vector<ref<Expr> > relevant;
+  getRelevantConstraints(state, relevant);
+  // the order the constraints were added in does not matter
+  std::sort(relevant.begin(), relevant.end());
+  llvm::hash_code h = llvm::hash_value(state.getContentFingerprint());
+  for (const ref<Expr> &e : relevant)
+    h = llvm::hash_combine(h, e->hash());
+  std::uint64_t fingerprint = h;
+
+  auto range = seen.equal_range(fingerprint);
+  for (auto it = range.first; it != range.second; ++it) {
+    const SeenState &other = *it->second;
+    if (other.constraints.size() == relevant.size() &&
+        std::equal(relevant.begin(), relevant.end(),
+                   other.constraints.begin()) &&
+        state.hasContents(other.contents))
+      return true;
+  }
+
+  if (seen.size() < MaxEntries) {
+    std::unique_ptr<SeenState> entry(new SeenState());
+    state.getContents(entry->contents);
+    entry->constraints = std::move(relevant);
+    seen.emplace(fingerprint, std::move(entry));
+  }
+  return false;
+}
+
+bool SubsumptionTable::visit(ExecutionState &state, TimingSolver *solver) {
+  if (!isAtJoinBlock(state))
+    return false;
+
+  std::uint64_t fingerprint = state.getContentFingerprint();
+  auto range = entries.equal_range(fingerprint);
+  for (auto it = range.first; it != range.second;) {
+    const SubsumptionEntry &entry = *it->second;
+    if (entry.incomplete) {
+      it = entries.erase(it);
+      continue;
+    }
+    ++it;
+    if (entry.pending || !state.hasContents(entry.contents))
+      continue;
+    ref<Expr> condition = ConstantExpr::alloc(1, Expr::Bool);
+    for (const ref<Expr> &e : entry.interpolant)
+      condition = AndExpr::create(condition, e);
+    bool implied;
+    if (solver->mustBeTrue(state, condition, implied) && implied)
+      return true;
+  }
+
+  if (entries.size() >= MaxEntries)
+    return false;
+
+  auto entry = std::make_shared<SubsumptionEntry>();
+  entry->fingerprint = fingerprint;
+  state.getContents(entry->contents);
+  getRelevantConstraints(state, entry->interpolant);
+  entries.emplace(fingerprint, entry);
+
+  if (state.subsumptionEntries.size() == MaxOpenEntries) {
+    SubsumptionEntry &oldest = *state.subsumptionEntries.front();
+    --oldest.pending;
+    oldest.incomplete = true;
+    state.subsumptionEntries.erase(state.subsumptionEntries.begin());
+  }
+  state.subsumptionEntries.push_back(entry);
+  return false;
+}
+
+void SubsumptionTable::complete(ExecutionState &state) {
+  for (const std::shared_ptr<SubsumptionEntry> &entry :
+       state.subsumptionEntries)
+    --entry->pending;
+  state.subsumptionEntries.clear();
+}
+
+void SubsumptionTable::release(ExecutionState &state) {
+  for (const std::shared_ptr<SubsumptionEntry> &entry :
+       state.subsumptionEntries) {
+    --entry->pending;
+    entry->incomplete = true;
+  }
+  state.subsumptionEntries.clear();
+}
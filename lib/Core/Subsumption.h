@@ -0,0 +1,91 @@
+//===-- Subsumption.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SUBSUMPTION_H
+#define KLEE_SUBSUMPTION_H
+
+#include "klee/ExecutionState.h"
+#include "klee/Expr.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  class TimingSolver;
+
+  /// A state at the start of a join block, with the condition which the
+  /// states reaching it later with the same contents must imply to be
+  /// pruned.
+  struct SubsumptionEntry {
+    std::uint64_t fingerprint;
+    /// What the fingerprint hashes, compared on a match of the fingerprints
+    /// so that a collision prunes no state.
+    StateContents contents;
+    /// The constraints of the state which read the arrays its values
+    /// refer to. The others make no difference to the paths from here.
+    std::vector<ref<Expr> > interpolant;
+    /// The descendants of the state not terminated yet.
+    unsigned pending = 1;
+    /// Whether a descendant was terminated before the end of its path.
+    bool incomplete = false;
+
+    bool isComplete() const { return !pending && !incomplete; }
+  };
+
+  /// Prunes the states which reach a join block with the same stack and
+  /// memory contents as a state whose paths from there were all explored,
+  /// when their constraints imply the part of that state's constraints
+  /// over these contents: the paths of the new states are paths explored
+  /// already.
+  ///
+  /// The same table finds the states which reach a join block exactly as
+  /// a state before them, with the same constraints over their contents.
+  ///
+  /// The contents are looked up by a hash of the stack, the live registers
+  /// and the memory objects, and compared on a match. The hashes of the
+  /// objects are kept between the writes to them, so only the objects
+  /// written since are hashed again on each visit of a join block, and
+  /// only the objects not shared with the recorded state are compared.
+  class SubsumptionTable {
+    std::unordered_multimap<std::uint64_t, std::shared_ptr<SubsumptionEntry> >
+        entries;
+
+    /// A state seen at a join block, with its constraints over its
+    /// contents in the order of ref<Expr>.
+    struct SeenState {
+      StateContents contents;
+      std::vector<ref<Expr> > constraints;
+    };
+    /// The states seen at join blocks, by the hash of their contents and
+    /// constraints.
+    std::unordered_multimap<std::uint64_t, std::unique_ptr<SeenState> > seen;
+
+  public:
+    /// Returns whether \a state, about to execute the first instruction of
+    /// a join block, does so as a state seen before, which is recorded
+    /// otherwise.
+    bool isDuplicate(const ExecutionState &state);
+
+    /// Returns whether \a state, about to execute the first instruction of
+    /// a block, is subsumed by an explored state. Otherwise the block is
+    /// recorded for the state if it is a join block.
+    bool visit(ExecutionState &state, TimingSolver *solver);
+
+    /// The state reached the end of its path, or was subsumed.
+    static void complete(ExecutionState &state);
+
+    /// The state is removed. Unless completed, the paths of the states
+    /// it descends from are not all explored.
+    static void release(ExecutionState &state);
+  };
+}
+
+#endif
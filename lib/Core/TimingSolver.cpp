@@ -12,18 +12,199 @@
 #include "klee/Config/Version.h"
 #include "klee/ExecutionState.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/Statistics.h"
 #include "klee/TimerStatIncrementer.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
 
 #include "CoreStats.h"
+#include "ModelTrie.h"
+#include "SamplingProfiler.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <cassert>
 
 using namespace klee;
 using namespace llvm;
 
 /***/
 
+TimingSolver::TimingSolver(Solver *_solver, bool _simplifyExprs,
+                           bool _useStateModels, size_t modelTrieSize)
+    : solver(_solver), simplifyExprs(_simplifyExprs),
+      useStateModels(_useStateModels), measureComplexity(false),
+      origin(OriginOther) {
+  if (useStateModels && modelTrieSize)
+    models.reset(new ModelTrie(modelTrieSize));
+}
+
+TimingSolver::~TimingSolver() {
+  delete solver;
+}
+
+std::shared_ptr<Assignment>
+TimingSolver::findModel(const ExecutionState &state) {
+  if (!models)
+    return nullptr;
+  std::shared_ptr<Assignment> model = models->lookup(state.constraints);
+  if (model)
+    ++stats::modelTrieHits;
+  return model;
+}
+
+const char *TimingSolver::getOriginName(QueryOrigin origin) {
+  switch (origin) {
+  case OriginOther: return "Other";
+  case OriginFork: return "Fork";
+  case OriginResolve: return "Resolve";
+  case OriginGetValue: return "GetValue";
+  case OriginToUnique: return "ToUnique";
+  case OriginSolution: return "Solution";
+  default: break;
+  }
+  assert(0 && "invalid query origin");
+  return "";
+}
+
+void TimingSolver::recordLatency(const ExecutionState &state,
+                                 time::Span elapsed) {
+  LatencyHistogram &histogram =
+      latency[std::make_pair(origin, (const KInstruction *)state.prevPC)];
+  uint64_t us = elapsed.toMicroseconds();
+  unsigned bucket = 0;
+  for (uint64_t limit = 10; us >= limit && bucket + 1 != NumLatencyBuckets;
+       limit *= 10)
+    ++bucket;
+  ++histogram.counts[bucket];
+  histogram.time += us;
+  histogram.dirty = true;
+}
+
+const char *TimingSolver::getMetricName(ComplexityMetric metric) {
+  switch (metric) {
+  case MetricNodes: return "Nodes";
+  case MetricDepth: return "Depth";
+  case MetricArrays: return "Arrays";
+  case MetricUpdates: return "Updates";
+  case MetricConstraints: return "Constraints";
+  default: break;
+  }
+  assert(0 && "invalid complexity metric");
+  return "";
+}
+
+void TimingSolver::ComplexityHistogram::add(uint64_t value) {
+  ++counts[64 - countLeadingZeros(value)];
+  max = std::max(max, value);
+}
+
+uint64_t
+TimingSolver::ComplexityHistogram::getPercentile(unsigned percent) const {
+  uint64_t total = 0;
+  for (uint64_t count : counts)
+    total += count;
+  uint64_t rank = (total * percent + 99) / 100, seen = 0;
+  for (unsigned b = 0; b != 65; ++b) {
+    seen += counts[b];
+    if (seen && seen >= rank)
+      return std::min(max, b == 64 ? max : (UINT64_C(1) << b) - 1);
+  }
+  return 0;
+}
+
+void TimingSolver::recordComplexity(const ExecutionState &state,
+                                    const ref<Expr> *exprs, unsigned n) {
+  if (!measureComplexity)
+    return;
+  ExprShapeMeasurer measurer;
+  for (const ref<Expr> &constraint : state.constraints)
+    measurer.add(constraint);
+  for (unsigned i = 0; i != n; ++i)
+    measurer.add(exprs[i]);
+
+  const uint64_t values[NumComplexityMetrics] = {
+      measurer.getNodes(), measurer.getDepth(), measurer.getArrays(),
+      measurer.getUpdates(), state.constraints.size()};
+  for (unsigned m = 0; m != NumComplexityMetrics; ++m)
+    complexity[m].add(values[m]);
+
+  stats::queryNodes += values[MetricNodes];
+  stats::queryArrays += values[MetricArrays];
+  stats::queryUpdates += values[MetricUpdates];
+  stats::queryConstraints += values[MetricConstraints];
+  // a sum of depths says little: each instruction keeps its deepest query
+  StatisticManager &sm = *theStatisticManager;
+  if (sm.hasIndexedStats() &&
+      values[MetricDepth] >
+          sm.getIndexedValue(stats::queryMaxDepth, sm.getIndex()))
+    sm.setIndexedValue(stats::queryMaxDepth, sm.getIndex(),
+                       values[MetricDepth]);
+}
+
+ref<ConstantExpr> TimingSolver::getModelValue(const ExecutionState &state,
+                                              ref<Expr> expr) {
+  if (!useStateModels || !state.model)
+    return 0;
+  ref<Expr> value = state.model->evaluate(expr);
+  return dyn_cast<ConstantExpr>(value);
+}
+
+bool TimingSolver::evaluateWithModels(const ExecutionState &state,
+                                      ref<Expr> expr, Solver::Validity &result,
+                                      BranchModels &models) {
+  std::vector<const Array *> objects;
+  findSymbolicObjects(expr, objects);
+  for (unsigned i = 0; i != state.symbolics->size(); ++i)
+    objects.push_back((*state.symbolics)[i].second);
+  std::sort(objects.begin(), objects.end());
+  objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+
+  // The side the model of the state takes is feasible, so only the other
+  // side needs a query.
+  ref<ConstantExpr> value = getModelValue(state, expr);
+  if (!value.isNull()) {
+    ++stats::stateModelHits;
+    if (value->isTrue())
+      models.trueModel = state.model;
+    else
+      models.falseModel = state.model;
+  }
+
+  for (bool side : {true, false}) {
+    std::shared_ptr<Assignment> &model =
+        side ? models.trueModel : models.falseModel;
+    if (model)
+      continue;
+    // a counterexample to the negated side is a witness of this side
+    std::vector<std::vector<unsigned char> > values;
+    bool hasSolution;
+    Query query(state.constraints, side ? Expr::createIsZero(expr) : expr);
+    if (!solver->impl->computeInitialValues(query, objects, values,
+                                            hasSolution))
+      return false;
+    if (hasSolution) {
+      model = std::make_shared<Assignment>(objects, values,
+                                           /*_allowFreeValues=*/true);
+      if (this->models)
+        this->models->record(state.constraints, model);
+    }
+  }
+
+  if (!models.falseModel)
+    result = Solver::True;
+  else if (!models.trueModel)
+    result = Solver::False;
+  else
+    result = Solver::Unknown;
+  return true;
+}
+
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
-                            Solver::Validity &result) {
+                            Solver::Validity &result, BranchModels *models) {
   // Fast path, to avoid timer and OS overhead.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
     result = CE->isTrue() ? Solver::True : Solver::False;
@@ -31,13 +212,20 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
   }
 
   TimerStatIncrementer timer(stats::solverTime);
+  SamplingProfiler::SolverScope profilerScope;
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->evaluate(Query(state.constraints, expr), result);
+  bool success =
+      useStateModels && models
+          ? evaluateWithModels(state, expr, result, *models)
+          : solver->evaluate(Query(state.constraints, expr), result);
 
-  state.queryCost += timer.check();
+  time::Span elapsed = timer.check();
+  state.queryCost += elapsed;
+  recordLatency(state, elapsed);
+  recordComplexity(state, &expr, 1);
 
   return success;
 }
@@ -50,14 +238,26 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
     return true;
   }
 
+  // A model falsifying the expression is a counterexample.
+  ref<ConstantExpr> value = getModelValue(state, expr);
+  if (!value.isNull() && !value->isTrue()) {
+    ++stats::stateModelHits;
+    result = false;
+    return true;
+  }
+
   TimerStatIncrementer timer(stats::solverTime);
+  SamplingProfiler::SolverScope profilerScope;
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
   bool success = solver->mustBeTrue(Query(state.constraints, expr), result);
 
-  state.queryCost += timer.check();
+  time::Span elapsed = timer.check();
+  state.queryCost += elapsed;
+  recordLatency(state, elapsed);
+  recordComplexity(state, &expr, 1);
 
   return success;
 }
@@ -85,6 +285,63 @@ bool TimingSolver::mayBeFalse(const ExecutionState& state, ref<Expr> expr,
   return true;
 }
 
+bool TimingSolver::mayBeTrue(const ExecutionState& state,
+                             const std::vector< ref<Expr> > &conditions,
+                             std::vector<bool> &result) {
+  std::vector< ref<Expr> > simplified;
+  simplified.reserve(conditions.size());
+  bool allConstant = true;
+  for (ref<Expr> e : conditions) {
+    if (simplifyExprs && !isa<ConstantExpr>(e))
+      e = state.constraints.simplifyExpr(e);
+    allConstant &= isa<ConstantExpr>(e);
+    simplified.push_back(e);
+  }
+
+  // Fast path, to avoid timer and OS overhead.
+  if (allConstant)
+    return solver->mayBeTrue(state.constraints, simplified, result);
+
+  // The conditions the model of the state satisfies are feasible, the
+  // others are left to the solver.
+  std::vector<unsigned> queried;
+  if (useStateModels && state.model) {
+    std::vector<ref<Expr> > remaining;
+    result.assign(simplified.size(), false);
+    for (unsigned i = 0; i != simplified.size(); ++i) {
+      ref<ConstantExpr> value = getModelValue(state, simplified[i]);
+      if (!value.isNull() && value->isTrue()) {
+        ++stats::stateModelHits;
+        result[i] = true;
+      } else {
+        queried.push_back(i);
+        remaining.push_back(simplified[i]);
+      }
+    }
+    if (remaining.empty())
+      return true;
+    simplified.swap(remaining);
+  }
+
+  TimerStatIncrementer timer(stats::solverTime);
+  SamplingProfiler::SolverScope profilerScope;
+
+  std::vector<bool> queriedResult;
+  bool success = solver->mayBeTrue(state.constraints, simplified,
+                                   queried.empty() ? result : queriedResult);
+  if (success) {
+    for (unsigned i = 0; i != queried.size(); ++i)
+      result[queried[i]] = queriedResult[i];
+  }
+
+  time::Span elapsed = timer.check();
+  state.queryCost += elapsed;
+  recordLatency(state, elapsed);
+  recordComplexity(state, simplified.data(), simplified.size());
+
+  return success;
+}
+
 bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr, 
                             ref<ConstantExpr> &result) {
   // Fast path, to avoid timer and OS overhead.
@@ -92,15 +349,53 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
     result = CE;
     return true;
   }
+
+  // Any value the expression may take will do.
+  ref<ConstantExpr> value = getModelValue(state, expr);
+  if (!value.isNull()) {
+    ++stats::stateModelHits;
+    result = value;
+    return true;
+  }
   
   TimerStatIncrementer timer(stats::solverTime);
+  SamplingProfiler::SolverScope profilerScope;
 
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
   bool success = solver->getValue(Query(state.constraints, expr), result);
 
-  state.queryCost += timer.check();
+  time::Span elapsed = timer.check();
+  state.queryCost += elapsed;
+  recordLatency(state, elapsed);
+  recordComplexity(state, &expr, 1);
+
+  return success;
+}
+
+bool TimingSolver::getUniqueValue(const ExecutionState &state, ref<Expr> expr,
+                                  ref<ConstantExpr> &result, bool &isUnique) {
+  // Fast path, to avoid timer and OS overhead.
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    result = CE;
+    isUnique = true;
+    return true;
+  }
+
+  TimerStatIncrementer timer(stats::solverTime);
+  SamplingProfiler::SolverScope profilerScope;
+
+  if (simplifyExprs)
+    expr = state.constraints.simplifyExpr(expr);
+
+  bool success = solver->getUniqueValue(Query(state.constraints, expr), result,
+                                        isUnique);
+
+  time::Span elapsed = timer.check();
+  state.queryCost += elapsed;
+  recordLatency(state, elapsed);
+  recordComplexity(state, &expr, 1);
 
   return success;
 }
@@ -115,16 +410,45 @@ TimingSolver::getInitialValues(const ExecutionState& state,
     return true;
 
   TimerStatIncrementer timer(stats::solverTime);
+  SamplingProfiler::SolverScope profilerScope;
 
   bool success = solver->getInitialValues(Query(state.constraints,
                                                 ConstantExpr::alloc(0, Expr::Bool)), 
                                           objects, result);
   
-  state.queryCost += timer.check();
+  time::Span elapsed = timer.check();
+  state.queryCost += elapsed;
+  recordLatency(state, elapsed);
+  recordComplexity(state, nullptr, 0);
   
   return success;
 }
 
+void TimingSolver::speculateEvaluate(const ExecutionState &state,
+                                     ref<Expr> expr) {
+  SpeculationScope speculation;
+  if (simplifyExprs)
+    expr = state.constraints.simplifyExpr(expr);
+  Solver::Validity result;
+  if (useStateModels) {
+    BranchModels models;
+    evaluateWithModels(state, expr, result, models);
+  } else {
+    solver->evaluate(Query(state.constraints, expr), result);
+  }
+}
+
+void TimingSolver::speculateInitialValues(
+    const ConstraintManager &constraints,
+    const std::vector<const Array *> &objects) {
+  if (objects.empty())
+    return;
+  SpeculationScope speculation;
+  std::vector<std::vector<unsigned char> > result;
+  solver->getInitialValues(
+      Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), objects, result);
+}
+
 std::pair< ref<Expr>, ref<Expr> >
 TimingSolver::getRange(const ExecutionState& state, ref<Expr> expr) {
   return solver->getRange(Query(state.constraints, expr));
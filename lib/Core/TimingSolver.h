@@ -14,18 +14,128 @@
 #include "klee/Solver.h"
 #include "klee/Internal/System/Time.h"
 
+#include <map>
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace klee {
+  class Assignment;
   class ExecutionState;
+  class ModelTrie;
+  struct KInstruction;
   class Solver;  
 
   /// TimingSolver - A simple class which wraps a solver and handles
   /// tracking the statistics that we care about.
   class TimingSolver {
   public:
+    /// The Executor operations which queries are attributed to.
+    enum QueryOrigin {
+      OriginOther,
+      OriginFork,
+      OriginResolve,
+      OriginGetValue,
+      OriginToUnique,
+      OriginSolution,
+      NumQueryOrigins
+    };
+
+    static const char *getOriginName(QueryOrigin origin);
+
+    /// Bucket 0 counts the queries which took less than 10us, each further
+    /// bucket those taking up to ten times longer, and the last one all
+    /// longer ones.
+    enum { NumLatencyBuckets = 8 };
+
+    struct LatencyHistogram {
+      uint64_t counts[NumLatencyBuckets] = {};
+      /// in microseconds
+      uint64_t time = 0;
+      /// whether it changed since it was last written out
+      bool dirty = false;
+    };
+
+    /// The measures of the queries reaching the solver chain, recorded
+    /// when measureComplexity is set.
+    enum ComplexityMetric {
+      MetricNodes,
+      MetricDepth,
+      MetricArrays,
+      MetricUpdates,
+      MetricConstraints,
+      NumComplexityMetrics
+    };
+
+    static const char *getMetricName(ComplexityMetric metric);
+
+    /// The distribution of a measure: bucket b counts the values of b
+    /// significant bits.
+    struct ComplexityHistogram {
+      uint64_t counts[65] = {};
+      uint64_t max = 0;
+
+      void add(uint64_t value);
+      /// An upper bound of the given percentile of the values, which is at
+      /// most twice it.
+      uint64_t getPercentile(unsigned percent) const;
+    };
+
+    /// Histograms by origin and by the instruction being executed (null
+    /// outside of instructions).
+    typedef std::map<std::pair<QueryOrigin, const KInstruction *>,
+                     LatencyHistogram> latency_map;
+
+    /// OriginScope - Attributes the queries issued during its lifetime to
+    /// \a origin.
+    class OriginScope {
+      TimingSolver &solver;
+      QueryOrigin saved;
+
+    public:
+      OriginScope(TimingSolver *solver, QueryOrigin origin)
+          : solver(*solver), saved(solver->origin) {
+        solver->origin = origin;
+      }
+      ~OriginScope() { solver.origin = saved; }
+    };
+
+    /// Assignments satisfying the constraints of a state together with a
+    /// branch condition (trueModel) or its negation (falseModel), as found
+    /// by evaluate.
+    struct BranchModels {
+      std::shared_ptr<Assignment> trueModel, falseModel;
+    };
+
     Solver *solver;
     bool simplifyExprs;
+    /// Whether queries are first checked against the model of the state.
+    bool useStateModels;
+    /// Whether the size and shape of the queries are measured, into the
+    /// complexity histograms and the query statistics of the instruction.
+    /// This walks the constraints of each query.
+    bool measureComplexity;
+
+  private:
+    QueryOrigin origin;
+    latency_map latency;
+    ComplexityHistogram complexity[NumComplexityMetrics];
+    /// The models found by evaluate, by the constraints they satisfy.
+    std::unique_ptr<ModelTrie> models;
+
+    void recordLatency(const ExecutionState &state, time::Span elapsed);
+    /// Measures the query of the constraints of \a state and the \a n
+    /// expressions \a exprs, if measureComplexity is set.
+    void recordComplexity(const ExecutionState &state, const ref<Expr> *exprs,
+                          unsigned n);
+
+    /// Returns the value of \a expr in the model of \a state, or null if
+    /// there is no model or the value depends on arrays it leaves symbolic.
+    ref<ConstantExpr> getModelValue(const ExecutionState &state,
+                                    ref<Expr> expr);
+
+    bool evaluateWithModels(const ExecutionState &state, ref<Expr> expr,
+                            Solver::Validity &result, BranchModels &models);
 
   public:
     /// TimingSolver - Construct a new timing solver.
@@ -33,10 +143,28 @@ namespace klee {
     /// \param _simplifyExprs - Whether expressions should be
     /// simplified (via the constraint manager interface) prior to
     /// querying.
-    TimingSolver(Solver *_solver, bool _simplifyExprs = true) 
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
-    ~TimingSolver() {
-      delete solver;
+    ///
+    /// \param _useStateModels - Whether queries should first be checked
+    /// against the model of the state.
+    ///
+    /// \param modelTrieSize - The number of nodes of the trie keeping the
+    /// models found, for the states which lose theirs; 0 disables it.
+    TimingSolver(Solver *_solver, bool _simplifyExprs = true,
+                 bool _useStateModels = false, size_t modelTrieSize = 0);
+    ~TimingSolver();
+
+    QueryOrigin getOrigin() const { return origin; }
+
+    /// findModel - Returns a model found for an ancestor of the state which
+    /// satisfies its constraints, or null.
+    std::shared_ptr<Assignment> findModel(const ExecutionState &state);
+
+    /// getLatency - The query latency histograms, which the caller may mark
+    /// as written out.
+    latency_map &getLatency() { return latency; }
+
+    const ComplexityHistogram &getComplexity(ComplexityMetric metric) const {
+      return complexity[metric];
     }
 
     void setTimeout(time::Span t) {
@@ -47,7 +175,11 @@ namespace klee {
       return solver->getConstraintLog(query);
     }
 
-    bool evaluate(const ExecutionState&, ref<Expr>, Solver::Validity &result);
+    /// evaluate - Determine the validity of an expression in the state.
+    /// With state models, the witnesses of the feasible sides are returned
+    /// in \a models, if given.
+    bool evaluate(const ExecutionState&, ref<Expr>, Solver::Validity &result,
+                  BranchModels *models = 0);
 
     bool mustBeTrue(const ExecutionState&, ref<Expr>, bool &result);
 
@@ -57,15 +189,33 @@ namespace klee {
 
     bool mayBeFalse(const ExecutionState&, ref<Expr>, bool &result);
 
+    bool mayBeTrue(const ExecutionState&, const std::vector< ref<Expr> > &,
+                   std::vector<bool> &result);
+
     bool getValue(const ExecutionState &, ref<Expr> expr, 
                   ref<ConstantExpr> &result);
 
+    /// getUniqueValue - Compute a value of the expression in the state, and
+    /// whether it is the only one.
+    bool getUniqueValue(const ExecutionState &, ref<Expr> expr,
+                        ref<ConstantExpr> &result, bool &isUnique);
+
     bool getInitialValues(const ExecutionState&, 
                           const std::vector<const Array*> &objects,
                           std::vector< std::vector<unsigned char> > &result);
 
     std::pair< ref<Expr>, ref<Expr> >
     getRange(const ExecutionState&, ref<Expr> query);
+
+    /// speculateEvaluate - Issues the queries evaluate() with models would
+    /// for the expression in the state as speculative ones (see
+    /// SpeculationScope), without accounting for them.
+    void speculateEvaluate(const ExecutionState &, ref<Expr>);
+
+    /// speculateInitialValues - Likewise for getInitialValues() under the
+    /// given constraints.
+    void speculateInitialValues(const ConstraintManager &constraints,
+                                const std::vector<const Array *> &objects);
   };
 
 }
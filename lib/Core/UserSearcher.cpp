@@ -10,8 +10,10 @@
 #include "UserSearcher.h"
 
 #include "Searcher.h"
+#include "SearcherModel.h"
 #include "Executor.h"
 
+#include "klee/Internal/ADT/RNG.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/SolverCmdLine.h"
 #include "klee/MergeHandler.h"
@@ -22,6 +24,10 @@
 using namespace llvm;
 using namespace klee;
 
+namespace klee {
+  extern RNG theRNG;
+}
+
 namespace {
 llvm::cl::OptionCategory
     SearchCat("Search options", "These options control the search heuristic.");
@@ -48,10 +54,53 @@ cl::list<Searcher::CoreSearchType> CoreSearch(
                    "use NURS with Instr-Count"),
         clEnumValN(Searcher::NURS_CPICnt, "nurs:cpicnt",
                    "use NURS with CallPath-Instr-Count"),
-        clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost")
+        clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost"),
+        clEnumValN(Searcher::NURS_CovPerCost, "nurs:cpc",
+                   "use NURS with Min-Dist-to-Uncovered per predicted "
+                   "Query-Cost"),
+        clEnumValN(Searcher::NURS_Model, "nurs:model",
+                   "use NURS with the weights of the --searcher-model"),
+        clEnumValN(Searcher::Directed, "directed",
+                   "select the states closest to a --target"),
+        clEnumValN(Searcher::Subpath, "subpath",
+                   "select the states whose last --subpath-length branch "
+                   "decisions were taken the least often")
             KLEE_LLVM_CL_VAL_END),
     cl::cat(SearchCat));
 
+cl::list<std::string> Targets(
+    "target",
+    cl::desc("A source location, as file:line, to direct the search to. The "
+             "states which cannot reach one any more are dropped, unless "
+             "they reached one. Can be given several times, and selects "
+             "--search=directed by default"),
+    cl::value_desc("file:line"),
+    cl::cat(SearchCat));
+
+cl::opt<std::string> SearcherModelFile(
+    "searcher-model",
+    cl::desc("The linear model of --search=nurs:model, a \"feature weight\" "
+             "pair per line, for the features written by "
+             "--write-searcher-features and a bias"),
+    cl::value_desc("file"),
+    cl::cat(SearchCat));
+
+cl::opt<bool> WriteSearcherFeatures(
+    "write-searcher-features",
+    cl::desc("Write the features --search=nurs:model weighs of every "
+             "terminated state, and whether it covered new instructions, to "
+             "searcher-features.csv, to train a --searcher-model from "
+             "(default=false)"),
+    cl::init(false),
+    cl::cat(SearchCat));
+
+cl::opt<unsigned> SubpathLength(
+    "subpath-length",
+    cl::desc("Number of the last branch decisions of a state which "
+             "--search=subpath compares (default=4)"),
+    cl::init(4),
+    cl::cat(SearchCat));
+
 cl::opt<bool> UseIterativeDeepeningTimeSearch(
     "use-iterative-deepening-time-search",
     cl::desc(
@@ -74,6 +123,16 @@ cl::opt<unsigned> BatchInstructions(
     cl::init(10000),
     cl::cat(SearchCat));
 
+cl::opt<unsigned> BatchSearcherOverhead(
+    "batch-searcher-overhead",
+    cl::desc("Adapt the number of instructions to batch when using "
+             "--use-batching-search so that selecting states and keeping "
+             "the searcher up to date takes about this percentage of the "
+             "time, starting from --batch-instructions. Set to 0 to keep "
+             "it fixed (default=0)"),
+    cl::init(0),
+    cl::cat(SearchCat));
+
 cl::opt<std::string> BatchTime(
     "batch-time",
     cl::desc("Amount of time to batch when using "
@@ -81,12 +140,21 @@ cl::opt<std::string> BatchTime(
     cl::init("5s"),
     cl::cat(SearchCat));
 
+cl::opt<unsigned> RNGSeed(
+    "rng-seed",
+    cl::desc("Seed of the random numbers the searchers and the executor "
+             "draw, for reproducible runs (default=5489)"),
+    cl::init(5489),
+    cl::cat(SearchCat));
+
 } // namespace
 
 void klee::initializeSearchOptions() {
   // default values
   if (CoreSearch.empty()) {
-    if (UseMerge){
+    if (!Targets.empty()) {
+      CoreSearch.push_back(Searcher::Directed);
+    } else if (UseMerge){
       CoreSearch.push_back(Searcher::NURS_CovNew);
       klee_warning("--use-merge enabled. Using NURS_CovNew as default searcher.");
     } else {
@@ -94,14 +162,38 @@ void klee::initializeSearchOptions() {
       CoreSearch.push_back(Searcher::NURS_CovNew);
     }
   }
+
+  if (Targets.empty() && std::find(CoreSearch.begin(), CoreSearch.end(),
+                                   Searcher::Directed) != CoreSearch.end())
+    klee_error("--search=directed needs a --target");
+  if (SubpathLength == 0)
+    klee_error("--subpath-length must be positive");
+  if (SearcherModelFile.empty() &&
+      std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_Model) !=
+          CoreSearch.end())
+    klee_error("--search=nurs:model needs a --searcher-model");
 }
 
+const std::vector<std::string> &klee::getUserTargets() { return Targets; }
+
+unsigned klee::userSearcherSubpathLength() {
+  return std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::Subpath) !=
+                 CoreSearch.end()
+             ? SubpathLength
+             : 0;
+}
+
+bool klee::userSearcherWritesFeatures() { return WriteSearcherFeatures; }
+
 bool klee::userSearcherRequiresMD2U() {
-  return (std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_MD2U) != CoreSearch.end() ||
+  return (WriteSearcherFeatures ||
+          std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_Model) != CoreSearch.end() ||
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_MD2U) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CovNew) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_ICnt) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CPICnt) != CoreSearch.end() ||
-	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end());
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end() ||
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CovPerCost) != CoreSearch.end());
 }
 
 
@@ -112,18 +204,32 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   case Searcher::BFS: searcher = new BFSSearcher(); break;
   case Searcher::RandomState: searcher = new RandomSearcher(); break;
   case Searcher::RandomPath: searcher = new RandomPathSearcher(executor); break;
-  case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew); break;
-  case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered); break;
-  case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth); break;
-  case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount); break;
-  case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount); break;
-  case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost); break;
+  case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew, executor); break;
+  case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered, executor); break;
+  case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth, executor); break;
+  case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount, executor); break;
+  case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount, executor); break;
+  case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost, executor); break;
+  case Searcher::NURS_CovPerCost: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveragePerCost, executor); break;
+  case Searcher::NURS_Model: {
+    std::string error;
+    std::unique_ptr<SearcherModel> model =
+        SearcherModel::load(SearcherModelFile, error);
+    if (!model)
+      klee_error("%s", error.c_str());
+    searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Model,
+                                          executor, std::move(model));
+    break;
+  }
+  case Searcher::Directed: searcher = new DirectedSearcher(executor); break;
+  case Searcher::Subpath: searcher = new SubpathSearcher(); break;
   }
 
   return searcher;
 }
 
 Searcher *klee::constructUserSearcher(Executor &executor) {
+  theRNG.seed(RNGSeed);
 
   Searcher *searcher = getNewSearcher(CoreSearch[0], executor);
   
@@ -144,7 +250,8 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
   }
 
   if (UseBatchingSearch) {
-    searcher = new BatchingSearcher(searcher, time::Span(BatchTime), BatchInstructions);
+    searcher = new BatchingSearcher(searcher, time::Span(BatchTime),
+                                    BatchInstructions, BatchSearcherOverhead);
   }
 
   if (UseMerge && UseIncompleteMerge) {
@@ -10,6 +10,9 @@
 #ifndef KLEE_USERSEARCHER_H
 #define KLEE_USERSEARCHER_H
 
+#include <string>
+#include <vector>
+
 namespace klee {
   class Executor;
   class Searcher;
@@ -17,8 +20,19 @@ namespace klee {
   // XXX gross, should be on demand?
   bool userSearcherRequiresMD2U();
 
+  /// Whether the features of the terminated states are written, see
+  /// SearcherModel::writeFeatures().
+  bool userSearcherWritesFeatures();
+
   void initializeSearchOptions();
 
+  /// The number of branch decisions the states keep for --search=subpath,
+  /// or 0 if it is not used.
+  unsigned userSearcherSubpathLength();
+
+  /// The source locations given with --target, as file:line.
+  const std::vector<std::string> &getUserTargets();
+
   Searcher *constructUserSearcher(Executor &executor);
 }
 
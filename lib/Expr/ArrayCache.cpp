@@ -14,6 +14,11 @@ ArrayCache::~ArrayCache() {
        ai != e; ++ai) {
     delete *ai;
   }
+  for (ConstantArrayHashMap::iterator ai = cachedConstantArrays.begin(),
+                                      e = cachedConstantArrays.end();
+       ai != e; ++ai) {
+    delete *ai;
+  }
 }
 
 const Array *
@@ -44,4 +49,23 @@ ArrayCache::CreateArray(const std::string &_name, uint64_t _size,
     return array;
   }
 }
+
+const Array *ArrayCache::CreateSharedConstantArray(
+    const std::string &_name, uint64_t _size,
+    const ref<ConstantExpr> *constantValuesBegin,
+    const ref<ConstantExpr> *constantValuesEnd, Expr::Width _domain,
+    Expr::Width _range) {
+  const Array *array = new Array(_name, _size, constantValuesBegin,
+                                 constantValuesEnd, _domain, _range);
+  assert(array->isConstantArray());
+  std::pair<ConstantArrayHashMap::const_iterator, bool> success =
+      cachedConstantArrays.insert(array);
+  if (success.second) {
+    // Cache miss
+    return array;
+  }
+  // Cache hit: an array with the same contents, possibly named otherwise
+  delete array;
+  return *(success.first);
+}
 }
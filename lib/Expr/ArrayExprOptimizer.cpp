@@ -119,12 +119,16 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
   if (cached != cacheExprOptimized.end())
     return cached->second;
 
+  // The visitors look for the reads of single bytes, and keep pointers to
+  // them while the lowered expression is alive.
+  ref<Expr> lowered = WideReadLoweringVisitor().visit(e);
+
   ref<Expr> result;
   // ----------------------- INDEX-BASED OPTIMIZATION -------------------------
   if (!valueOnly && (OptimizeArray == ALL || OptimizeArray == INDEX)) {
     array2idx_ty arrays;
     ConstantArrayExprVisitor aev(arrays);
-    aev.visit(e);
+    aev.visit(lowered);
 
     if (arrays.empty() || aev.isIncompatible()) {
       // We do not optimize expressions other than those with concrete
@@ -139,10 +143,10 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
       mapIndexOptimizedExpr_ty idx_valIdx;
 
       // Compute those indexes s.t. orig_expr =equisat= (k==i|k==j|..)
-      if (computeIndexes(arrays, e, idx_valIdx)) {
+      if (computeIndexes(arrays, lowered, idx_valIdx)) {
         if (!idx_valIdx.empty()) {
           // Create new expression on indexes
-          result = ExprRewriter::createOptExpr(e, arrays, idx_valIdx);
+          result = ExprRewriter::createOptExpr(lowered, arrays, idx_valIdx);
         } else {
           klee_warning("OPT_I: infeasible branch!");
           result = ConstantExpr::create(0, Expr::Bool);
@@ -166,7 +170,7 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
     std::vector<const ReadExpr *> reads;
     std::map<const ReadExpr *, std::pair<unsigned, Expr::Width>> readInfo;
     ArrayReadExprVisitor are(reads, readInfo);
-    are.visit(e);
+    are.visit(lowered);
     std::reverse(reads.begin(), reads.end());
 
     if (reads.empty() || are.isIncompatible()) {
@@ -175,7 +179,7 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
     }
 
     ref<Expr> selectOpt =
-        getSelectOptExpr(e, reads, readInfo, are.containsSymbolic());
+        getSelectOptExpr(lowered, reads, readInfo, are.containsSymbolic());
     if (selectOpt.get()) {
       klee_warning("OPT_V: successful");
       result = selectOpt;
@@ -220,23 +224,22 @@ bool ExprOptimizer::computeIndexes(array2idx_ty &arrays, const ref<Expr> &e,
         width = mulVal;
     }
 
+    // The bindings are overwritten in place for each value
+    Assignment a;
+
     // For each concrete value 'i' stored in the array
     for (size_t aIdx = 0; aIdx < arr->constantValues.size(); aIdx += width) {
-      auto *a = new Assignment();
-      std::vector<const Array *> objects;
-      std::vector<std::vector<unsigned char>> values;
-
       // For each symbolic index Expr(k) found
       for (auto &index_it : element.second) {
         ref<Expr> idx = index_it;
         ref<Expr> val = ConstantExpr::alloc(aIdx, arr->getDomain());
         // We create a partial assignment on 'k' s.t. Expr(k)==i
-        bool assignmentSuccess =
-            AssignmentGenerator::generatePartialAssignment(idx, val, a);
+        bool assignmentSuccess = AssignmentGenerator::generateAssignment(
+            AssignmentGenerator::Target(idx, val), a);
         success |= assignmentSuccess;
 
         // If the assignment satisfies both the expression 'e' and the PC
-        ref<Expr> evaluation = a->evaluate(e);
+        ref<Expr> evaluation = a.evaluate(e);
         if (assignmentSuccess && evaluation->isTrue()) {
           if (idx_valIdx.find(idx) == idx_valIdx.end()) {
             idx_valIdx.insert(std::make_pair(idx, std::vector<ref<Expr>>()));
@@ -245,7 +248,6 @@ bool ExprOptimizer::computeIndexes(array2idx_ty &arrays, const ref<Expr> &e,
               ConstantExpr::alloc(aIdx, arr->getDomain()));
         }
       }
-      delete a;
     }
   }
   return success;
@@ -272,38 +274,9 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
       if (info.second > width) {
         width = info.second;
       }
-      unsigned size = read->updates.root->getSize();
-      unsigned bytesPerElement = width / 8;
-      unsigned elementsInArray = size / bytesPerElement;
-
-      // Note: we already filtered the ReadExpr, so here we can safely
-      // assume that the UpdateNodes contain ConstantExpr indexes and values
-      assert(read->updates.root->isConstantArray() &&
-             "Expected concrete array, found symbolic array");
-      auto arrayConstValues = read->updates.root->constantValues;
-      for (const UpdateNode *un = read->updates.head; un; un = un->next) {
-        auto ce = dyn_cast<ConstantExpr>(un->index);
-        assert(ce && "Not a constant expression");
-        uint64_t index = ce->getAPValue().getZExtValue();
-        assert(index < arrayConstValues.size());
-        auto arrayValue = dyn_cast<ConstantExpr>(un->value);
-        assert(arrayValue && "Not a constant expression");
-        arrayConstValues[index] = arrayValue;
-      }
-      std::vector<uint64_t> arrayValues;
-      // Get the concrete values from the array
-      for (unsigned i = 0; i < elementsInArray; i++) {
-        uint64_t val = 0;
-        for (unsigned j = 0; j < bytesPerElement; j++) {
-          val |= (*(
-                       arrayConstValues[(i * bytesPerElement) + j]
-                           .get()
-                           ->getAPValue()
-                           .getRawData())
-                  << (j * 8));
-        }
-        arrayValues.push_back(val);
-      }
+      const ValueIndex &values = getValueIndex(read->updates, width);
+      if (!values.applicable && !values.useSegments)
+        continue;
 
       ref<Expr> index = read->index;
       IndexCleanerVisitor ice;
@@ -312,8 +285,9 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
         index = ice.getIndex();
       }
 
-      ref<Expr> opt =
-          buildConstantSelectExpr(index, arrayValues, width, elementsInArray);
+      ref<Expr> opt = values.useSegments
+                          ? buildSegmentSelectExpr(index, values, width)
+                          : buildConstantSelectExpr(index, values, width);
       if (opt.get()) {
         cacheReadExprOptimized[read->hash()] = opt;
         optimized.insert(std::make_pair(info.first, opt));
@@ -416,23 +390,60 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
   return toReturn.get() ? toReturn : notFound;
 }
 
-ref<Expr> ExprOptimizer::buildConstantSelectExpr(
-    const ref<Expr> &index, std::vector<uint64_t> &arrayValues,
-    Expr::Width width, unsigned arraySize) const {
+const ExprOptimizer::ValueIndex &
+ExprOptimizer::getValueIndex(const UpdateList &updates, Expr::Width width) {
+  ValueIndexKey key(updates.root, updates.head, width);
+  auto cached = valueIndexes.find(key);
+  if (cached != valueIndexes.end())
+    return cached->second;
+
+  ValueIndex &result =
+      valueIndexes.insert(std::make_pair(key, ValueIndex(updates)))
+          .first->second;
+
+  const Array *root = updates.root;
+  unsigned size = root->getSize();
+  unsigned bytesPerElement = width / 8;
+  unsigned arraySize = size / bytesPerElement;
+  if (arraySize == 0)
+    return result;
+
+  // Note: we already filtered the ReadExpr, so here we can safely
+  // assume that the UpdateNodes contain ConstantExpr indexes and values
+  assert(root->isConstantArray() &&
+         "Expected concrete array, found symbolic array");
+  std::vector<uint8_t> bytes(size);
+  for (unsigned i = 0; i < size; i++)
+    bytes[i] = root->constantValues[i]->getZExtValue(8);
+
+  // Apply the updates oldest first, so the most recent write of an index
+  // is the one which remains
+  std::vector<const UpdateNode *> writes;
+  for (const UpdateNode *un = updates.head; un; un = un->next)
+    writes.push_back(un);
+  for (auto it = writes.rbegin(), ie = writes.rend(); it != ie; ++it) {
+    auto ce = dyn_cast<ConstantExpr>((*it)->index);
+    assert(ce && "Not a constant expression");
+    uint64_t index = ce->getZExtValue();
+    assert(index < size);
+    auto arrayValue = dyn_cast<ConstantExpr>((*it)->value);
+    assert(arrayValue && "Not a constant expression");
+    bytes[index] = arrayValue->getZExtValue(8);
+  }
+
+  // Get the concrete values from the array
+  std::vector<uint64_t> arrayValues;
+  arrayValues.reserve(arraySize);
+  for (unsigned i = 0; i < arraySize; i++) {
+    uint64_t val = 0;
+    for (unsigned j = 0; j < bytesPerElement; j++)
+      val |= uint64_t(bytes[(i * bytesPerElement) + j]) << (j * 8);
+    arrayValues.push_back(val);
+  }
+
   std::vector<std::pair<uint64_t, uint64_t>> ranges;
   std::vector<uint64_t> values;
   std::set<uint64_t> unique_array_values;
-  ExprBuilder *builder = createDefaultExprBuilder();
-  Expr::Width valWidth = width;
-  ref<Expr> result;
-
-  ref<Expr> actualIndex;
-  if (index->getWidth() > Expr::Int32) {
-    actualIndex = ExtractExpr::alloc(index, 0, Expr::Int32);
-  } else {
-    actualIndex = index;
-  }
-  Expr::Width idxWidth = actualIndex->getWidth();
 
   // Calculate the repeating values ranges in the constant array
   unsigned curr_idx = 0;
@@ -455,28 +466,87 @@ ref<Expr> ExprOptimizer::buildConstantSelectExpr(
     }
   }
 
-  if (((double)unique_array_values.size() / (double)(arraySize)) >=
+  if (((double)unique_array_values.size() / (double)(arraySize)) <
       ArrayValueRatio) {
-    return result;
+    result.applicable = true;
+    for (size_t i = 0; i < ranges.size(); i++)
+      result.ranges[values[i]].emplace_back(ranges[i].first,
+                                            ranges[i].second);
   }
 
-  std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>> exprMap;
-  for (size_t i = 0; i < ranges.size(); i++) {
-    if (exprMap.find(values[i]) != exprMap.end()) {
-      exprMap[values[i]].emplace_back(ranges[i].first, ranges[i].second);
-    } else {
-      if (exprMap.find(values[i]) == exprMap.end()) {
-        exprMap.insert(std::make_pair(
-            values[i], std::vector<std::pair<uint64_t, uint64_t>>()));
+  findSegments(arrayValues, arraySize, width, result.segments);
+
+  // A table repeating with a power of two period, such as one indexed by a
+  // few low bits, is read through a mask with the segments of one period
+  for (uint64_t period = 2; period < arraySize; period *= 2) {
+    if (arraySize % period)
+      break;
+    bool periodic = true;
+    for (unsigned i = period; periodic && i < arraySize; i++)
+      periodic = arrayValues[i] == arrayValues[i & (period - 1)];
+    if (!periodic)
+      continue;
+    std::vector<Segment> segments;
+    findSegments(arrayValues, period, width, segments);
+    if (segments.size() < result.segments.size()) {
+      result.segments.swap(segments);
+      result.periodMask = period - 1;
+    }
+    break;
+  }
+
+  size_t rangeCount = 0;
+  for (auto &range : result.ranges)
+    rangeCount += range.second.size();
+  result.useSegments =
+      ((double)result.segments.size() / (double)(arraySize)) <
+          ArrayValueRatio &&
+      (!result.applicable || result.segments.size() < rangeCount);
+  return result;
+}
+
+void ExprOptimizer::findSegments(const std::vector<uint64_t> &arrayValues,
+                                 size_t count, Expr::Width width,
+                                 std::vector<Segment> &segments) {
+  uint64_t mask = width >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << width) - 1;
+  size_t i = 0;
+  while (i < count) {
+    uint64_t stride = 0;
+    size_t end = i + 1;
+    if (end < count) {
+      stride = (arrayValues[end] - arrayValues[i]) & mask;
+      for (++end; end < count; ++end)
+        if (arrayValues[end] != ((arrayValues[end - 1] + stride) & mask))
+          break;
+      // Two different values are cheaper to compare as two constants
+      if (end - i == 2 && stride != 0) {
+        stride = 0;
+        end = i + 1;
       }
-      exprMap.find(values[i])->second.emplace_back(ranges[i].first,
-                                                   ranges[i].second);
     }
+    segments.push_back({end, (arrayValues[i] - stride * i) & mask, stride});
+    i = end;
   }
+}
+
+ref<Expr> ExprOptimizer::buildConstantSelectExpr(const ref<Expr> &index,
+                                                 const ValueIndex &values,
+                                                 Expr::Width width) const {
+  ExprBuilder *builder = createDefaultExprBuilder();
+  Expr::Width valWidth = width;
+  ref<Expr> result;
+
+  ref<Expr> actualIndex;
+  if (index->getWidth() > Expr::Int32) {
+    actualIndex = ExtractExpr::alloc(index, 0, Expr::Int32);
+  } else {
+    actualIndex = index;
+  }
+  Expr::Width idxWidth = actualIndex->getWidth();
 
   int ct = 0;
   // For each range appropriately build the Select expression.
-  for (auto range : exprMap) {
+  for (auto &range : values.ranges) {
     ref<Expr> temp;
     if (ct == 0) {
       temp = builder->Constant(llvm::APInt(valWidth, range.first, false));
@@ -557,6 +627,44 @@ ref<Expr> ExprOptimizer::buildConstantSelectExpr(
   return result;
 }
 
+ref<Expr> ExprOptimizer::buildSegmentSelectExpr(const ref<Expr> &index,
+                                                const ValueIndex &values,
+                                                Expr::Width width) const {
+  ref<Expr> actualIndex;
+  if (index->getWidth() > Expr::Int32) {
+    actualIndex = ExtractExpr::alloc(index, 0, Expr::Int32);
+  } else {
+    actualIndex = index;
+  }
+  Expr::Width idxWidth = actualIndex->getWidth();
+  if (values.periodMask)
+    actualIndex = AndExpr::create(
+        actualIndex, ConstantExpr::create(values.periodMask, idxWidth));
+  ref<Expr> valueIndex = ZExtExpr::create(actualIndex, width);
+
+  // The segments are tested in index order, so each only needs to compare
+  // the index with its end; the last one is the fallback.
+  ref<Expr> result;
+  for (auto it = values.segments.rbegin(), ie = values.segments.rend();
+       it != ie; ++it) {
+    ref<Expr> value = ConstantExpr::create(it->offset, width);
+    if (it->stride == 1)
+      value = AddExpr::create(value, valueIndex);
+    else if (it->stride != 0)
+      value = AddExpr::create(
+          value,
+          MulExpr::create(ConstantExpr::create(it->stride, width), valueIndex));
+
+    if (result.isNull())
+      result = value;
+    else
+      result = SelectExpr::create(
+          UltExpr::create(actualIndex, ConstantExpr::create(it->end, idxWidth)),
+          value, result);
+  }
+  return result;
+}
+
 ref<Expr> ExprOptimizer::buildMixedSelectExpr(
     const ReadExpr *re, std::vector<std::pair<uint64_t, bool>> &arrayValues,
     Expr::Width width, unsigned elementsInArray) const {
@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include <map>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -33,6 +34,44 @@ private:
   std::unordered_set<unsigned> cacheExprUnapplicable;
   std::unordered_map<unsigned, ref<Expr>> cacheReadExprOptimized;
 
+  /// A run of elements whose values are offset + stride * index, for the
+  /// indexes from where the previous segment ends up to end.
+  struct Segment {
+    uint64_t end;
+    uint64_t offset;
+    uint64_t stride;
+  };
+
+  /// The elements of a concrete array after its concrete updates, read at
+  /// one width, grouped by value: each value maps to the index ranges
+  /// holding it. They are also split into affine segments, for lookup
+  /// tables with few runs but many values.
+  struct ValueIndex {
+    /// Keeps the update nodes of the key alive.
+    UpdateList updates;
+    /// Whether the values are few enough for the value-based
+    /// transformation, as set by ArrayValueRatio.
+    bool applicable;
+    std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>> ranges;
+
+    /// Whether reads are lowered through the segments rather than the
+    /// ranges, which is when they need fewer comparisons.
+    bool useSegments;
+    std::vector<Segment> segments;
+    /// If not zero, the elements repeat every periodMask + 1 of them and
+    /// the segments describe the first period, read at index & periodMask.
+    uint64_t periodMask;
+
+    explicit ValueIndex(const UpdateList &updates)
+        : updates(updates), applicable(false), useSegments(false),
+          periodMask(0) {}
+  };
+  using ValueIndexKey =
+      std::tuple<const Array *, const UpdateNode *, Expr::Width>;
+  /// Value indexes by root array, most recent update and width, so the
+  /// reads of a table are not analysed again for every new index.
+  std::map<ValueIndexKey, ValueIndex> valueIndexes;
+
 public:
   /// Returns the optimised version of e.
   /// @param e expression to optimise
@@ -49,10 +88,20 @@ private:
       std::map<const ReadExpr *, std::pair<unsigned, Expr::Width>> &readInfo,
       bool isSymbolic);
 
+  const ValueIndex &getValueIndex(const UpdateList &updates,
+                                  Expr::Width width);
+
+  static void findSegments(const std::vector<uint64_t> &arrayValues,
+                           size_t count, Expr::Width width,
+                           std::vector<Segment> &segments);
+
   ref<Expr> buildConstantSelectExpr(const ref<Expr> &index,
-                                    std::vector<uint64_t> &arrayValues,
-                                    Expr::Width width,
-                                    unsigned elementsInArray) const;
+                                    const ValueIndex &values,
+                                    Expr::Width width) const;
+
+  ref<Expr> buildSegmentSelectExpr(const ref<Expr> &index,
+                                   const ValueIndex &values,
+                                   Expr::Width width) const;
 
   ref<Expr>
   buildMixedSelectExpr(const ReadExpr *re,
@@ -272,3 +272,8 @@ ExprVisitor::Action IndexCleanerVisitor::visitRead(const ReadExpr &) {
   mul = false;
   return Action::doChildren();
 }
+
+ExprVisitor::Action
+WideReadLoweringVisitor::visitWideRead(const WideReadExpr &wre) {
+  return Action::changeTo(visit(wre.lower()));
+}
@@ -138,6 +138,13 @@ public:
   IndexCleanerVisitor() : ExprVisitor(true) {}
   inline ref<Expr> getIndex() { return index; }
 };
+
+/// Replaces the wide reads by the concatenations of the reads of their
+/// bytes, which the visitors above match.
+class WideReadLoweringVisitor : public ExprVisitor {
+protected:
+  Action visitWideRead(const WideReadExpr &) override;
+};
 } // namespace klee
 
 #endif
@@ -9,6 +9,7 @@
 
 #include "AssignmentGenerator.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <llvm/ADT/APInt.h>
@@ -18,6 +19,7 @@
 #include <set>
 #include <stddef.h>
 #include <string>
+#include <tuple>
 #include <utility>
 
 #include "klee/Internal/Support/ErrorHandling.h"
@@ -29,14 +31,83 @@ using namespace klee;
 bool AssignmentGenerator::generatePartialAssignment(const ref<Expr> &e,
                                                     ref<Expr> &val,
                                                     Assignment *&a) {
-  return helperGenerateAssignment(e, val, a, e->getWidth(), false);
+  ref<ReadExpr> re;
+  if (!findRead(e, val, re, false))
+    return false;
+  if (re.isNull())
+    return true;
+  if (!isa<ConstantExpr>(val))
+    return false;
+
+  ConstantExpr &index = static_cast<ConstantExpr &>(*re->index.get());
+  std::vector<unsigned char> c_value =
+      getIndexedValue(getByteValue(val), index, re->updates.root->size);
+  if (c_value.size() == 0) {
+    return false;
+  }
+  if (a->bindings.find(re->updates.root) == a->bindings.end()) {
+    a->bindings.insert(std::make_pair(re->updates.root, c_value));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool AssignmentGenerator::generateAssignment(llvm::ArrayRef<Target> targets,
+                                             Assignment &a) {
+  // The bytes written, to find those two targets need different values in.
+  struct Byte {
+    const Array *array;
+    uint64_t offset;
+    unsigned char value;
+  };
+  std::vector<Byte> written;
+  written.reserve(targets.size() * 8);
+
+  for (const Target &target : targets) {
+    ref<Expr> val = target.second;
+    ref<ReadExpr> re;
+    if (!findRead(target.first, val, re, false))
+      return false;
+    if (re.isNull())
+      continue;
+
+    const ConstantExpr *value = dyn_cast<ConstantExpr>(val);
+    if (!value || value->getWidth() % 8)
+      return false;
+    const Array *array = re->updates.root;
+    uint64_t offset = cast<ConstantExpr>(re->index)->getZExtValue();
+    unsigned bytes = value->getWidth() / 8;
+    if (offset + bytes > array->size)
+      return false;
+
+    std::vector<unsigned char> &binding = a.bindings[array];
+    if (binding.size() != array->size)
+      binding.resize(array->size);
+    const llvm::APInt &bits = value->getAPValue();
+    for (unsigned i = 0; i != bytes; ++i) {
+      unsigned char byte =
+          bits.getBitWidth() <= 64
+              ? (unsigned char)(bits.getZExtValue() >> (8 * i))
+              : (unsigned char)bits.lshr(8 * i).getLoBits(8).getZExtValue();
+      binding[offset + i] = byte;
+      written.push_back(Byte{array, offset + i, byte});
+    }
+  }
+
+  std::sort(written.begin(), written.end(), [](const Byte &l, const Byte &r) {
+    return std::tie(l.array, l.offset) < std::tie(r.array, r.offset);
+  });
+  for (size_t i = 1; i < written.size(); ++i)
+    if (written[i].array == written[i - 1].array &&
+        written[i].offset == written[i - 1].offset &&
+        written[i].value != written[i - 1].value)
+      return false;
+  return true;
 }
 
-bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
-                                                   ref<Expr> &val,
-                                                   Assignment *&a,
-                                                   Expr::Width width,
-                                                   bool sign) {
+bool AssignmentGenerator::findRead(const ref<Expr> &e, ref<Expr> &val,
+                                   ref<ReadExpr> &read, bool sign) {
   Expr &ep = *e.get();
   switch (ep.getKind()) {
 
@@ -62,7 +133,7 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
     } else {
       val = createSubExpr(kid_val, val);
     }
-    return helperGenerateAssignment(kid_expr, val, a, width, sign);
+    return findRead(kid_expr, val, read, sign);
   }
   case Expr::Sub: {
     // val = val + kid
@@ -78,7 +149,7 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
       return false;
     }
     val = createAddExpr(kid_val, val);
-    return helperGenerateAssignment(kid_expr, val, a, width, sign);
+    return findRead(kid_expr, val, read, sign);
   }
   case Expr::Mul: {
     // val = val / kid (check for sign)
@@ -100,7 +171,7 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
       return false;
     }
     val = createDivExpr(kid_val, val, sign);
-    return helperGenerateAssignment(kid_expr, val, a, width, sign);
+    return findRead(kid_expr, val, read, sign);
   }
   case Expr::UDiv:
   // val = val * kid
@@ -119,7 +190,7 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
       return false;
     }
     val = createMulExpr(kid_val, val);
-    return helperGenerateAssignment(kid_expr, val, a, width, sign);
+    return findRead(kid_expr, val, read, sign);
   }
 
   // LOGICAL
@@ -129,7 +200,7 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
     }
     ref<Expr> kid_val = ep.getKid(1);
     val = createShlExpr(val, kid_val);
-    return helperGenerateAssignment(ep.getKid(0), val, a, width, sign);
+    return findRead(ep.getKid(0), val, read, sign);
   }
   case Expr::Shl: {
     if (!isa<ConstantExpr>(ep.getKid(1))) {
@@ -137,10 +208,10 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
     }
     ref<Expr> kid_val = ep.getKid(1);
     val = createLShrExpr(val, kid_val);
-    return helperGenerateAssignment(ep.getKid(0), val, a, width, sign);
+    return findRead(ep.getKid(0), val, read, sign);
   }
   case Expr::Not: {
-    return helperGenerateAssignment(ep.getKid(0), val, a, width, sign);
+    return findRead(ep.getKid(0), val, read, sign);
   }
   case Expr::And: {
     // val = val & kid
@@ -156,25 +227,24 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
       return false;
     }
     val = createAndExpr(kid_val, val);
-    return helperGenerateAssignment(kid_expr, val, a, width, sign);
+    return findRead(kid_expr, val, read, sign);
   }
 
   // CASTING
   case Expr::ZExt: {
     val = createExtractExpr(ep.getKid(0), val);
-    return helperGenerateAssignment(ep.getKid(0), val, a, width, false);
+    return findRead(ep.getKid(0), val, read, false);
   }
   case Expr::SExt: {
     val = createExtractExpr(ep.getKid(0), val);
-    return helperGenerateAssignment(ep.getKid(0), val, a, width, true);
+    return findRead(ep.getKid(0), val, read, true);
   }
 
   // SPECIAL
   case Expr::Concat: {
     ReadExpr *base = hasOrderedReads(&ep);
     if (base) {
-      return helperGenerateAssignment(ref<Expr>(base), val, a, ep.getWidth(),
-                                      sign);
+      return findRead(ref<Expr>(base), val, read, sign);
     } else {
       klee_warning("Not supported");
       ep.printKind(llvm::errs(), ep.getKind());
@@ -183,31 +253,27 @@ bool AssignmentGenerator::helperGenerateAssignment(const ref<Expr> &e,
   }
   case Expr::Extract: {
     val = createExtendExpr(ep.getKid(0), val);
-    return helperGenerateAssignment(ep.getKid(0), val, a, width, sign);
+    return findRead(ep.getKid(0), val, read, sign);
   }
 
   // READ
   case Expr::Read: {
     ReadExpr &re = static_cast<ReadExpr &>(ep);
-    if (isa<ConstantExpr>(re.index)) {
-      if (re.updates.root->isSymbolicArray()) {
-        ConstantExpr &index = static_cast<ConstantExpr &>(*re.index.get());
-        std::vector<unsigned char> c_value =
-            getIndexedValue(getByteValue(val), index, re.updates.root->size);
-        if (c_value.size() == 0) {
-          return false;
-        }
-        if (a->bindings.find(re.updates.root) == a->bindings.end()) {
-          a->bindings.insert(std::make_pair(re.updates.root, c_value));
-        } else {
-          return false;
-        }
-      }
-    } else {
-      return helperGenerateAssignment(re.index, val, a, width, sign);
-    }
+    if (!isa<ConstantExpr>(re.index))
+      return findRead(re.index, val, read, sign);
+    read = re.updates.root->isSymbolicArray() ? &re : nullptr;
     return true;
   }
+  case Expr::WideRead: {
+    // like the ordered reads of a concatenation, from the lowest index
+    WideReadExpr &wre = static_cast<WideReadExpr &>(ep);
+    if (!wre.isLittleEndian || wre.updates.root->getRange() != Expr::Int8) {
+      klee_warning("Not supported");
+      ep.printKind(llvm::errs(), ep.getKind());
+      return false;
+    }
+    return findRead(wre.getByte(0), val, read, sign);
+  }
   default:
     std::string type_str;
     llvm::raw_string_ostream rso(type_str);
@@ -10,11 +10,14 @@
 #ifndef KLEE_ASSIGNMENTGENERATOR_H
 #define KLEE_ASSIGNMENTGENERATOR_H
 
+#include <utility>
 #include <vector>
 
 #include "klee/Expr.h"
 #include "klee/util/Ref.h"
 
+#include "llvm/ADT/ArrayRef.h"
+
 namespace klee {
 class Assignment;
 } /* namespace klee */
@@ -26,13 +29,29 @@ template <class T> class ref;
 
 class AssignmentGenerator {
 public:
+  /// An expression, and the value it should take.
+  typedef std::pair<ref<Expr>, ref<Expr> > Target;
+
   static bool generatePartialAssignment(const ref<Expr> &e, ref<Expr> &val,
                                         Assignment *&a);
 
+  /// Writes the bytes of the arrays which make each of the expressions take
+  /// its value, at its offset in the binding of the array in \a a. Missing
+  /// bindings are added, filled with zeros, whereas the others are written
+  /// in place, so that an assignment can be reused without allocating.
+  /// Several of the expressions may read the same array.
+  ///
+  /// Returns false if an expression is not supported, or if two of them
+  /// need different values in the same byte, leaving \a a partly written.
+  static bool generateAssignment(llvm::ArrayRef<Target> targets,
+                                 Assignment &a);
+
 private:
-  static bool helperGenerateAssignment(const ref<Expr> &e, ref<Expr> &val,
-                                       Assignment *&a, Expr::Width width,
-                                       bool sign);
+  /// Walks down \a e to the read of a constant index it is made of,
+  /// updating \a val to the value the read should take. \a read is null
+  /// if it is not of a symbolic array, and has no byte to bind.
+  static bool findRead(const ref<Expr> &e, ref<Expr> &val,
+                       ref<ReadExpr> &read, bool sign);
 
   static bool isReadExprAtOffset(ref<Expr> e, const ReadExpr *base,
                                  ref<Expr> offset);
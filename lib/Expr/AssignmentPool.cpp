@@ -0,0 +1,328 @@
+//===-- AssignmentPool.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/AssignmentPool.h"
+
+#include "klee/util/Assignment.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+namespace {
+inline uint64_t widthMask(Expr::Width w) {
+  return w >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+}
+
+inline int64_t signExtend(uint64_t v, Expr::Width w) {
+  return w >= 64 ? (int64_t)v : (int64_t)(v << (64 - w)) >> (64 - w);
+}
+}
+
+AssignmentPool::AssignmentPool(unsigned _capacity)
+    : capacity(std::min(_capacity, (unsigned)MaxCapacity)), dirty(false),
+      undefined(0) {}
+
+void AssignmentPool::add(Assignment *a) {
+  assert(!a->allowFreeValues && "pooled assignments must be complete");
+  if (!capacity)
+    return;
+
+  std::vector<Assignment *>::iterator it =
+      std::find(assignments.begin(), assignments.end(), a);
+  if (it == assignments.begin() && it != assignments.end())
+    return;
+  if (it != assignments.end())
+    assignments.erase(it);
+  else if (assignments.size() == capacity)
+    assignments.pop_back();
+  assignments.insert(assignments.begin(), a);
+  dirty = true;
+}
+
+void AssignmentPool::remove(Assignment *a) {
+  std::vector<Assignment *>::iterator it =
+      std::find(assignments.begin(), assignments.end(), a);
+  if (it == assignments.end())
+    return;
+  assignments.erase(it);
+  dirty = true;
+}
+
+void AssignmentPool::rebuildTable() {
+  table.clear();
+  unsigned lanes = assignments.size();
+  for (unsigned lane = 0; lane != lanes; ++lane) {
+    const Assignment::bindings_ty &bindings = assignments[lane]->bindings;
+    for (Assignment::bindings_ty::const_iterator it = bindings.begin(),
+                                                 ie = bindings.end();
+         it != ie; ++it) {
+      std::vector<uint8_t> &values = table[it->first];
+      if (values.size() < it->second.size() * lanes)
+        values.resize(it->second.size() * lanes, 0);
+      for (unsigned i = 0, e = it->second.size(); i != e; ++i)
+        values[i * lanes + lane] = it->second[i];
+    }
+  }
+  dirty = false;
+}
+
+bool AssignmentPool::evaluateRead(const ReadExpr &re, lanes_ty &result) {
+  const lanes_ty *index = evaluate(re.index);
+  if (!index)
+    return false;
+  unsigned lanes = assignments.size();
+  uint64_t all = widthMask(lanes), resolved = 0;
+
+  // Walk the update list once for all lanes until every lane found its
+  // write.
+  for (const UpdateNode *un = re.updates.head; un && resolved != all;
+       un = un->next) {
+    const lanes_ty *ui = evaluate(un->index);
+    if (!ui)
+      return false;
+    const lanes_ty *uv = 0;
+    for (unsigned lane = 0; lane != lanes; ++lane) {
+      if ((resolved >> lane) & 1 || (*ui)[lane] != (*index)[lane])
+        continue;
+      if (!uv && !(uv = evaluate(un->value)))
+        return false;
+      result[lane] = (*uv)[lane];
+      resolved |= UINT64_C(1) << lane;
+    }
+  }
+  if (resolved == all)
+    return true;
+
+  // Values outside the array or unbound by an assignment read as zero, like
+  // in Assignment::evaluate().
+  const Array *root = re.updates.root;
+  if (root->isConstantArray()) {
+    for (unsigned lane = 0; lane != lanes; ++lane) {
+      if ((resolved >> lane) & 1)
+        continue;
+      uint64_t i = (*index)[lane];
+      result[lane] =
+          i < root->size ? root->constantValues[i]->getZExtValue() : 0;
+    }
+    return true;
+  }
+
+  std::map<const Array *, std::vector<uint8_t> >::const_iterator values =
+      table.find(root);
+  uint64_t size = values == table.end() ? 0 : values->second.size() / lanes;
+  for (unsigned lane = 0; lane != lanes; ++lane) {
+    if ((resolved >> lane) & 1)
+      continue;
+    uint64_t i = (*index)[lane];
+    result[lane] = i < size ? values->second[i * lanes + lane] : 0;
+  }
+  return true;
+}
+
+bool AssignmentPool::evaluateOperation(const Expr &e, lanes_ty &result) {
+  unsigned lanes = assignments.size();
+  const lanes_ty *kids[3];
+  for (unsigned i = 0, n = e.getNumKids(); i != n; ++i)
+    if (!(kids[i] = evaluate(e.getKid(i))))
+      return false;
+  Expr::Width width = e.getWidth();
+  uint64_t mask = widthMask(width);
+
+  switch (e.getKind()) {
+  case Expr::Select:
+    for (unsigned l = 0; l != lanes; ++l)
+      result[l] = (*kids[0])[l] ? (*kids[1])[l] : (*kids[2])[l];
+    return true;
+
+  case Expr::Concat: {
+    Expr::Width shift = e.getKid(1)->getWidth();
+    for (unsigned l = 0; l != lanes; ++l)
+      result[l] = ((*kids[0])[l] << shift) | (*kids[1])[l];
+    return true;
+  }
+
+  case Expr::Extract: {
+    unsigned offset = static_cast<const ExtractExpr &>(e).offset;
+    for (unsigned l = 0; l != lanes; ++l)
+      result[l] = ((*kids[0])[l] >> offset) & mask;
+    return true;
+  }
+
+  case Expr::ZExt:
+    result = *kids[0];
+    return true;
+
+  case Expr::SExt: {
+    Expr::Width from = e.getKid(0)->getWidth();
+    for (unsigned l = 0; l != lanes; ++l)
+      result[l] = (uint64_t)signExtend((*kids[0])[l], from) & mask;
+    return true;
+  }
+
+  case Expr::Not:
+    for (unsigned l = 0; l != lanes; ++l)
+      result[l] = ~(*kids[0])[l] & mask;
+    return true;
+
+  default:
+    break;
+  }
+
+  assert(e.getNumKids() == 2 && "unexpected expression kind");
+  const lanes_ty &a = *kids[0], &b = *kids[1];
+  Expr::Width opWidth = e.getKid(0)->getWidth();
+
+  for (unsigned l = 0; l != lanes; ++l) {
+    uint64_t x = a[l], y = b[l], r;
+    switch (e.getKind()) {
+    case Expr::Add: r = x + y; break;
+    case Expr::Sub: r = x - y; break;
+    case Expr::Mul: r = x * y; break;
+    case Expr::And: r = x & y; break;
+    case Expr::Or:  r = x | y; break;
+    case Expr::Xor: r = x ^ y; break;
+
+    // A zero divisor leaves the expression unevaluated (see
+    // ExprEvaluator::protectedDivOperation()), so the lane cannot satisfy it.
+    case Expr::UDiv:
+    case Expr::URem:
+      if (!y) {
+        undefined |= UINT64_C(1) << l;
+        r = 0;
+      } else {
+        r = e.getKind() == Expr::UDiv ? x / y : x % y;
+      }
+      break;
+    case Expr::SDiv:
+    case Expr::SRem: {
+      if (!y) {
+        undefined |= UINT64_C(1) << l;
+        r = 0;
+        break;
+      }
+      int64_t sx = signExtend(x, width), sy = signExtend(y, width);
+      // Avoid the overflowing INT64_MIN / -1, which wraps in APInt.
+      if (sy == -1)
+        r = e.getKind() == Expr::SDiv ? 0 - x : 0;
+      else
+        r = e.getKind() == Expr::SDiv ? (uint64_t)(sx / sy)
+                                      : (uint64_t)(sx % sy);
+      break;
+    }
+
+    // Shifting by the width or more yields zero, or the sign for AShr, as in
+    // APInt.
+    case Expr::Shl: r = y >= width ? 0 : x << y; break;
+    case Expr::LShr: r = y >= width ? 0 : x >> y; break;
+    case Expr::AShr:
+      r = (uint64_t)(signExtend(x, width) >> (y >= width ? width - 1 : y));
+      break;
+
+    case Expr::Eq:  r = x == y; break;
+    case Expr::Ne:  r = x != y; break;
+    case Expr::Ult: r = x < y; break;
+    case Expr::Ule: r = x <= y; break;
+    case Expr::Ugt: r = x > y; break;
+    case Expr::Uge: r = x >= y; break;
+    case Expr::Slt: r = signExtend(x, opWidth) < signExtend(y, opWidth); break;
+    case Expr::Sle: r = signExtend(x, opWidth) <= signExtend(y, opWidth); break;
+    case Expr::Sgt: r = signExtend(x, opWidth) > signExtend(y, opWidth); break;
+    case Expr::Sge: r = signExtend(x, opWidth) >= signExtend(y, opWidth); break;
+
+    default:
+      return false;
+    }
+    result[l] = r & mask;
+  }
+  return true;
+}
+
+/// evaluate - Compute the value of \a e for every lane, or return null if it
+/// cannot be evaluated this way (e.g. because it is wider than 64 bits).
+const AssignmentPool::lanes_ty *AssignmentPool::evaluate(const ref<Expr> &e) {
+  std::unordered_map<const Expr *, lanes_ty>::iterator it =
+      values.find(e.get());
+  if (it != values.end())
+    return &it->second;
+  if (e->getWidth() > 64)
+    return 0;
+
+  unsigned lanes = assignments.size();
+  lanes_ty result(lanes);
+  switch (e->getKind()) {
+  case Expr::Constant:
+    std::fill(result.begin(), result.end(),
+              cast<ConstantExpr>(e)->getZExtValue());
+    break;
+  case Expr::NotOptimized:
+    if (const lanes_ty *src = evaluate(cast<NotOptimizedExpr>(e)->src))
+      result = *src;
+    else
+      return 0;
+    break;
+  case Expr::Read:
+    if (!evaluateRead(*cast<ReadExpr>(e), result))
+      return 0;
+    break;
+  case Expr::WideRead: {
+    ref<Expr> bytes = cast<WideReadExpr>(e)->lower();
+    lowered.push_back(bytes);
+    if (const lanes_ty *src = evaluate(bytes))
+      result = *src;
+    else
+      return 0;
+    break;
+  }
+  default:
+    if (!evaluateOperation(*e, result))
+      return 0;
+    break;
+  }
+
+  return &(values[e.get()] = std::move(result));
+}
+
+uint64_t AssignmentPool::beginSearch() {
+  if (dirty)
+    rebuildTable();
+  // Undefined lanes accumulate over the whole search, as their expressions
+  // stay memoized for later constraints.
+  undefined = 0;
+  return widthMask(assignments.size());
+}
+
+void AssignmentPool::narrow(const ref<Expr> &c, uint64_t &alive) {
+  unsigned lanes = assignments.size();
+  if (const lanes_ty *result = evaluate(c)) {
+    for (unsigned l = 0; l != lanes; ++l)
+      if (!((*result)[l] & 1))
+        alive &= ~(UINT64_C(1) << l);
+    alive &= ~undefined;
+  } else {
+    // Fall back to evaluating the constraint per assignment.
+    for (unsigned l = 0; l != lanes; ++l)
+      if ((alive >> l) & 1 && !assignments[l]->satisfies(&c, &c + 1))
+        alive &= ~(UINT64_C(1) << l);
+  }
+}
+
+Assignment *AssignmentPool::endSearch(uint64_t alive) {
+  values.clear();
+  lowered.clear();
+  if (!alive)
+    return 0;
+
+  unsigned lane = 0;
+  while (!((alive >> lane) & 1))
+    ++lane;
+  Assignment *a = assignments[lane];
+  add(a);
+  return a;
+}
@@ -0,0 +1,342 @@
+//===-- CompiledExpr.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/CompiledExpr.h"
+
+#include "klee/util/Assignment.h"
+
+#include <memory>
+#include <unordered_map>
+
+using namespace klee;
+
+namespace {
+inline uint64_t widthMask(Expr::Width w) {
+  return w >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+}
+
+inline int64_t signExtend(uint64_t v, Expr::Width w) {
+  return w >= 64 ? (int64_t)v : (int64_t)(v << (64 - w)) >> (64 - w);
+}
+
+class Compiler {
+  std::vector<CompiledExpr::Instruction> &instructions;
+  std::vector<CompiledExpr::Read> &reads;
+  std::vector<const Array *> &arrays;
+  std::unordered_map<const Expr *, unsigned> registers;
+  std::unordered_map<const Array *, unsigned> arrayIndex;
+  /// The expressions compiled in place of wide reads, kept alive while
+  /// their addresses are in registers.
+  std::vector<ref<Expr> > lowered;
+
+  unsigned emit(const CompiledExpr::Instruction &i) {
+    instructions.push_back(i);
+    return instructions.size() - 1;
+  }
+
+public:
+  Compiler(std::vector<CompiledExpr::Instruction> &instructions,
+           std::vector<CompiledExpr::Read> &reads,
+           std::vector<const Array *> &arrays)
+      : instructions(instructions), reads(reads), arrays(arrays) {}
+
+  /// compile - Emit the instructions computing \a e and return its register,
+  /// or ~0u if it cannot be compiled.
+  unsigned compile(const ref<Expr> &e) {
+    std::unordered_map<const Expr *, unsigned>::iterator it =
+        registers.find(e.get());
+    if (it != registers.end())
+      return it->second;
+    if (e->getWidth() > 64)
+      return ~0u;
+
+    CompiledExpr::Instruction i = {e->getKind(), e->getWidth(), 0, 0, 0, 0, 0};
+    switch (e->getKind()) {
+    case Expr::Constant:
+      i.imm = cast<ConstantExpr>(e)->getZExtValue();
+      break;
+
+    case Expr::NotOptimized: {
+      unsigned src = compile(cast<NotOptimizedExpr>(e)->src);
+      registers[e.get()] = src;
+      return src;
+    }
+
+    case Expr::WideRead: {
+      ref<Expr> bytes = cast<WideReadExpr>(e)->lower();
+      lowered.push_back(bytes);
+      unsigned r = compile(bytes);
+      registers[e.get()] = r;
+      return r;
+    }
+
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      CompiledExpr::Read read;
+      read.root = re->updates.root;
+      std::pair<std::unordered_map<const Array *, unsigned>::iterator, bool>
+          slot = arrayIndex.insert(std::make_pair(read.root, arrays.size()));
+      if (slot.second)
+        arrays.push_back(read.root);
+      read.array = slot.first->second;
+      for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+        unsigned index = compile(un->index), value = compile(un->value);
+        if (index == ~0u || value == ~0u)
+          return ~0u;
+        read.updates.push_back(std::make_pair(index, value));
+      }
+      if ((i.a = compile(re->index)) == ~0u)
+        return ~0u;
+      i.imm = reads.size();
+      reads.push_back(read);
+      break;
+    }
+
+    default: {
+      unsigned *operands[3] = {&i.a, &i.b, &i.c};
+      for (unsigned k = 0, n = e->getNumKids(); k != n; ++k)
+        if ((*operands[k] = compile(e->getKid(k))) == ~0u)
+          return ~0u;
+      if (e->getNumKids())
+        i.operandWidth = e->getKid(e->getNumKids() - 1)->getWidth();
+      if (e->getKind() == Expr::Concat)
+        i.imm = e->getKid(1)->getWidth();
+      else if (e->getKind() == Expr::Extract)
+        i.imm = cast<ExtractExpr>(e)->offset;
+      break;
+    }
+    }
+
+    unsigned r = emit(i);
+    registers[e.get()] = r;
+    return r;
+  }
+};
+}
+
+CompiledExpr::~CompiledExpr() {}
+
+CompiledExpr *CompiledExpr::compile(const ref<Expr> &e) {
+  std::unique_ptr<CompiledExpr> program(new CompiledExpr());
+  Compiler compiler(program->instructions, program->reads, program->arrays);
+  program->resultRegister = compiler.compile(e);
+  if (program->resultRegister == ~0u)
+    return 0;
+  program->registers.resize(program->instructions.size());
+  program->bindings.resize(program->arrays.size());
+  return program.release();
+}
+
+uint64_t CompiledExpr::getMemoryUsage() const {
+  uint64_t bytes = sizeof(*this) +
+                   instructions.capacity() * sizeof(Instruction) +
+                   reads.capacity() * sizeof(Read) +
+                   arrays.capacity() * sizeof(const Array *) +
+                   registers.capacity() * sizeof(uint64_t) +
+                   bindings.capacity() * sizeof(bindings[0]);
+  for (const Read &r : reads)
+    bytes += r.updates.capacity() * sizeof(r.updates[0]);
+  return bytes;
+}
+
+const CompiledExpr *CompiledExprCache::get(const ref<Expr> &e) {
+  std::unordered_map<const Expr *, Entry>::iterator it = cache.find(e.get());
+  if (it != cache.end())
+    return it->second.program.get();
+
+  if (cache.size() >= MaxSize)
+    clear();
+  Entry &entry = cache[e.get()];
+  entry.expr = e;
+  entry.program.reset(CompiledExpr::compile(e));
+  bytes += sizeof(Entry) + 4 * sizeof(void *);
+  if (entry.program)
+    bytes += entry.program->getMemoryUsage();
+  return entry.program.get();
+}
+
+bool CompiledExprCache::evaluate(const ref<Expr> &e, const Assignment &a,
+                                 uint64_t &result) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    if (CE->getWidth() > 64)
+      return false;
+    result = CE->getZExtValue();
+    return true;
+  }
+  const CompiledExpr *program = get(e);
+  return program && program->run(a, result);
+}
+
+void CompiledExprCache::evaluateAll(const ref<Expr> &e,
+                                    const std::vector<const Assignment *> &as,
+                                    std::vector<uint64_t> &results,
+                                    std::vector<char> &evaluated) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    bool fits = CE->getWidth() <= 64;
+    results.assign(as.size(), fits ? CE->getZExtValue() : 0);
+    evaluated.assign(as.size(), fits);
+    return;
+  }
+  if (const CompiledExpr *program = get(e)) {
+    program->runAll(as, results, evaluated);
+  } else {
+    results.assign(as.size(), 0);
+    evaluated.assign(as.size(), false);
+  }
+}
+
+void CompiledExpr::bind(const Assignment &a,
+                        const std::vector<unsigned char> **bindings) const {
+  for (unsigned k = 0, n = arrays.size(); k != n; ++k) {
+    Assignment::bindings_ty::const_iterator it = a.bindings.find(arrays[k]);
+    bindings[k] = it == a.bindings.end() ? 0 : &it->second;
+  }
+}
+
+inline bool
+CompiledExpr::execute(unsigned pc, uint64_t *r,
+                      const std::vector<unsigned char> *const *bindings,
+                      bool allowFreeValues) const {
+  const Instruction &i = instructions[pc];
+  uint64_t x = r[i.a], y = r[i.b], v;
+  switch (i.kind) {
+  case Expr::Constant: v = i.imm; break;
+
+  case Expr::Read: {
+    const Read &read = reads[i.imm];
+    bool found = false;
+    for (const std::pair<unsigned, unsigned> &u : read.updates) {
+      if (r[u.first] == x) {
+        v = r[u.second];
+        found = true;
+        break;
+      }
+    }
+    if (found)
+      break;
+    if (read.root->isConstantArray() && x < read.root->size) {
+      v = read.root->constantValues[x]->getZExtValue();
+      break;
+    }
+    // Like Assignment::evaluate(const Array *, unsigned).
+    const std::vector<unsigned char> *values = bindings[read.array];
+    if (values && x < values->size())
+      v = (*values)[x];
+    else if (allowFreeValues)
+      return false;
+    else
+      v = 0;
+    break;
+  }
+
+  case Expr::Select: v = x ? y : r[i.c]; break;
+  case Expr::Concat: v = (x << i.imm) | y; break;
+  case Expr::Extract: v = x >> i.imm; break;
+  case Expr::ZExt: v = x; break;
+  case Expr::SExt: v = (uint64_t)signExtend(x, i.operandWidth); break;
+  case Expr::Not: v = ~x; break;
+
+  case Expr::Add: v = x + y; break;
+  case Expr::Sub: v = x - y; break;
+  case Expr::Mul: v = x * y; break;
+  // ExprEvaluator leaves a division by zero unevaluated.
+  case Expr::UDiv:
+    if (!y)
+      return false;
+    v = x / y;
+    break;
+  case Expr::URem:
+    if (!y)
+      return false;
+    v = x % y;
+    break;
+  case Expr::SDiv:
+  case Expr::SRem: {
+    if (!y)
+      return false;
+    int64_t sx = signExtend(x, i.width), sy = signExtend(y, i.width);
+    // INT64_MIN / -1 overflows, but wraps in APInt.
+    if (sy == -1)
+      v = i.kind == Expr::SDiv ? 0 - x : 0;
+    else
+      v = i.kind == Expr::SDiv ? (uint64_t)(sx / sy) : (uint64_t)(sx % sy);
+    break;
+  }
+
+  case Expr::And: v = x & y; break;
+  case Expr::Or: v = x | y; break;
+  case Expr::Xor: v = x ^ y; break;
+  // Shifting by the width or more yields zero, or the sign for AShr, as in
+  // APInt.
+  case Expr::Shl: v = y >= i.width ? 0 : x << y; break;
+  case Expr::LShr: v = y >= i.width ? 0 : x >> y; break;
+  case Expr::AShr:
+    v = (uint64_t)(signExtend(x, i.width) >> (y >= i.width ? i.width - 1 : y));
+    break;
+
+  case Expr::Eq: v = x == y; break;
+  case Expr::Ne: v = x != y; break;
+  case Expr::Ult: v = x < y; break;
+  case Expr::Ule: v = x <= y; break;
+  case Expr::Ugt: v = x > y; break;
+  case Expr::Uge: v = x >= y; break;
+  case Expr::Slt:
+    v = signExtend(x, i.operandWidth) < signExtend(y, i.operandWidth);
+    break;
+  case Expr::Sle:
+    v = signExtend(x, i.operandWidth) <= signExtend(y, i.operandWidth);
+    break;
+  case Expr::Sgt:
+    v = signExtend(x, i.operandWidth) > signExtend(y, i.operandWidth);
+    break;
+  case Expr::Sge:
+    v = signExtend(x, i.operandWidth) >= signExtend(y, i.operandWidth);
+    break;
+
+  default:
+    return false;
+  }
+  r[pc] = v & widthMask(i.width);
+  return true;
+}
+
+bool CompiledExpr::run(const Assignment &a, uint64_t &result) const {
+  bind(a, bindings.data());
+  uint64_t *r = registers.data();
+  for (unsigned pc = 0, n = instructions.size(); pc != n; ++pc)
+    if (!execute(pc, r, bindings.data(), a.allowFreeValues))
+      return false;
+
+  result = r[resultRegister];
+  return true;
+}
+
+void CompiledExpr::runAll(const std::vector<const Assignment *> &as,
+                          std::vector<uint64_t> &results,
+                          std::vector<char> &evaluated) const {
+  // One register file and set of bindings per assignment, each
+  // instruction runs for all of them before the next.
+  unsigned lanes = as.size(), n = instructions.size(), m = arrays.size();
+  std::vector<uint64_t> r((size_t)lanes * n);
+  std::vector<const std::vector<unsigned char> *> b((size_t)lanes * m);
+  for (unsigned k = 0; k != lanes; ++k)
+    bind(*as[k], &b[(size_t)k * m]);
+
+  evaluated.assign(lanes, true);
+  for (unsigned pc = 0; pc != n; ++pc)
+    for (unsigned k = 0; k != lanes; ++k)
+      if (evaluated[k] && !execute(pc, &r[(size_t)k * n], &b[(size_t)k * m],
+                                   as[k]->allowFreeValues))
+        evaluated[k] = false;
+
+  results.assign(lanes, 0);
+  for (unsigned k = 0; k != lanes; ++k)
+    if (evaluated[k])
+      results[k] = r[(size_t)k * n + resultRegister];
+}
@@ -11,13 +11,18 @@
 
 #include "klee/Internal/Module/KModule.h"
 #include "klee/OptionCategories.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/ExprPPrinter.h"
+#include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+#include <cstring>
 #include <map>
+#include <unordered_map>
 
 using namespace klee;
 
@@ -28,8 +33,405 @@ llvm::cl::opt<bool> RewriteEqualities(
                    "constant is added (default=true)"),
     llvm::cl::init(true),
     llvm::cl::cat(SolvingCat));
+
+llvm::cl::opt<bool> FoldRangeConstraints(
+    "fold-range-constraints",
+    llvm::cl::desc("Track the bounds that constraints place on expressions "
+                   "compared with constants: drop implied bounds, keep only "
+                   "the tightest bound of each kind, turn bounds pinning an "
+                   "expression into equalities, and fold comparisons "
+                   "decided by the bounds (default=true)"),
+    llvm::cl::init(true),
+    llvm::cl::cat(SolvingCat));
+}
+
+namespace klee {
+/// Partition of the constraints of a ConstraintManager into independent
+/// classes: two constraints are in the same class iff they are connected by
+/// a chain of constraints reading a common array byte, where a read at a
+/// symbolic index counts as reading every byte of the array. Constraints are
+/// identified by their position in the manager.
+class ConstraintIndependence {
+  enum : unsigned { None = ~0u };
+
+  struct ArrayReaders {
+    // some constraint reading the array at a symbolic index; all
+    // constraints reading the array are in its class
+    unsigned whole = None;
+    // for each byte read at a constant index, some constraint reading it
+    std::unordered_map<unsigned, unsigned> bytes;
+  };
+
+  // parent links, class sizes, and for each class a linked list of its
+  // members (threaded through next, ending at last)
+  std::vector<unsigned> parent, classSize, next, last;
+  std::unordered_map<const Array *, ArrayReaders> arrays;
+
+  unsigned find(unsigned i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  void unite(unsigned a, unsigned b) {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+      return;
+    if (classSize[a] < classSize[b])
+      std::swap(a, b);
+    parent[b] = a;
+    classSize[a] += classSize[b];
+    next[last[a]] = b;
+    last[a] = last[b];
+  }
+
+  template <class F> static void forEachRead(const ref<Expr> &e, F f) {
+    std::vector<ref<ReadExpr> > reads;
+    findReads(e, /* visitUpdates= */ true, reads);
+    for (const ref<ReadExpr> &re : reads) {
+      // Reads of a constant array don't alias.
+      if (re->updates.root->isConstantArray() && !re->updates.head)
+        continue;
+      f(re->updates.root, dyn_cast<ConstantExpr>(re->index));
+    }
+  }
+
+public:
+  /// Adds the next constraint.
+  void add(const ref<Expr> &e) {
+    unsigned id = parent.size();
+    parent.push_back(id);
+    classSize.push_back(1);
+    next.push_back(None);
+    last.push_back(id);
+
+    forEachRead(e, [&](const Array *array, ConstantExpr *index) {
+      ArrayReaders &readers = arrays[array];
+      if (readers.whole != None) {
+        unite(id, readers.whole);
+      } else if (index) {
+        auto res = readers.bytes.insert(
+            std::make_pair((unsigned)index->getZExtValue(32), id));
+        if (!res.second)
+          unite(id, res.first->second);
+      } else {
+        readers.whole = id;
+        for (const auto &byte : readers.bytes)
+          unite(id, byte.second);
+        readers.bytes.clear();
+      }
+    });
+  }
+
+  /// Returns the classes \a e depends on, without duplicates.
+  std::vector<unsigned> getClasses(const ref<Expr> &e) {
+    std::vector<unsigned> classes;
+    forEachRead(e, [&](const Array *array, ConstantExpr *index) {
+      auto it = arrays.find(array);
+      if (it == arrays.end())
+        return;
+      const ArrayReaders &readers = it->second;
+      if (readers.whole != None) {
+        classes.push_back(find(readers.whole));
+      } else if (index) {
+        auto byte = readers.bytes.find((unsigned)index->getZExtValue(32));
+        if (byte != readers.bytes.end())
+          classes.push_back(find(byte->second));
+      } else {
+        for (const auto &byte : readers.bytes)
+          classes.push_back(find(byte.second));
+      }
+    });
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+    return classes;
+  }
+
+  /// Returns the class of the constraint \a i.
+  unsigned getClass(unsigned i) { return find(i); }
+
+  /// Appends the members of class \a c to \a result, in no particular order.
+  void getMembers(unsigned c, std::vector<unsigned> &result) const {
+    for (unsigned i = c; i != None; i = next[i])
+      result.push_back(i);
+  }
+};
+}
+
+namespace klee {
+/// The unsigned and signed intervals the constraints of a ConstraintManager
+/// confine terms to, where a term is any expression of at most 64 bits
+/// compared with a constant. For each kind of bound, the position of the
+/// constraint which sets it is kept, so that a tighter bound can replace it.
+class ConstraintRanges {
+public:
+  enum Kind { UnsignedMin, UnsignedMax, SignedMin, SignedMax, Equal };
+  enum : unsigned { None = ~0u };
+
+  struct Bound {
+    ref<Expr> term;
+    Kind kind;
+    uint64_t value;
+  };
+
+private:
+  struct Range {
+    Expr::Width width;
+    // indexed by Kind; the signed bounds are sign extended
+    uint64_t bounds[4];
+    unsigned sources[4];
+  };
+
+  ExprHashMap<Range> terms;
+
+  static uint64_t mask(Expr::Width w) {
+    return w == 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+  }
+
+  static int64_t signExtend(uint64_t v, Expr::Width w) {
+    return w == 64 ? (int64_t)v : (int64_t)(v << (64 - w)) >> (64 - w);
+  }
+
+  static int64_t signedMin(Expr::Width w) {
+    return w == 64 ? INT64_MIN : -(INT64_C(1) << (w - 1));
+  }
+
+  static int64_t signedMax(Expr::Width w) {
+    return (int64_t)((UINT64_C(1) << (w - 1)) - 1);
+  }
+
+  static bool getConstant(const ref<Expr> &e, const ref<Expr> &other,
+                          uint64_t &value) {
+    const ConstantExpr *ce = dyn_cast<ConstantExpr>(e);
+    if (!ce || isa<ConstantExpr>(other) || other->getWidth() > 64 ||
+        other->getWidth() == Expr::Bool)
+      return false;
+    value = ce->getZExtValue();
+    return true;
+  }
+
+  // Sets b to the bound "term < c" (or "c < term" if swapped), where strict
+  // excludes c, negated turns the comparison around, and isSigned selects
+  // the signed order. Returns false if the bound cannot hold or always
+  // holds.
+  static bool makeBound(const ref<Expr> &term, uint64_t c, bool isSigned,
+                        bool strict, bool swapped, bool negated, Bound &b) {
+    // not (term < c) is (c <= term)
+    if (negated) {
+      swapped = !swapped;
+      strict = !strict;
+    }
+    Expr::Width w = term->getWidth();
+    b.term = term;
+    if (!isSigned) {
+      if (!swapped) {
+        if (strict && c == 0)
+          return false;
+        b.kind = UnsignedMax;
+        b.value = strict ? c - 1 : c;
+      } else {
+        if (strict && c == mask(w))
+          return false;
+        b.kind = UnsignedMin;
+        b.value = strict ? c + 1 : c;
+      }
+      return true;
+    }
+    int64_t sc = signExtend(c, w);
+    if (!swapped) {
+      if (strict && sc == signedMin(w))
+        return false;
+      b.kind = SignedMax;
+      b.value = strict ? sc - 1 : sc;
+    } else {
+      if (strict && sc == signedMax(w))
+        return false;
+      b.kind = SignedMin;
+      b.value = strict ? sc + 1 : sc;
+    }
+    return true;
+  }
+
+  Range makeRange(Expr::Width w) const {
+    Range r;
+    r.width = w;
+    r.bounds[UnsignedMin] = 0;
+    r.bounds[UnsignedMax] = mask(w);
+    r.bounds[SignedMin] = signedMin(w);
+    r.bounds[SignedMax] = signedMax(w);
+    for (unsigned &source : r.sources)
+      source = None;
+    return r;
+  }
+
+  // Narrows \a r by \a b, and each order by the other one where every value
+  // has the same sign. Returns the kinds of bound which were tightened.
+  static unsigned narrow(Range &r, const Bound &b) {
+    unsigned tightened = 0;
+    uint64_t *bounds = r.bounds;
+    auto raise = [&](Kind k, uint64_t v, bool isSigned) {
+      if (isSigned ? (int64_t)v > (int64_t)bounds[k] : v > bounds[k]) {
+        bounds[k] = v;
+        tightened |= 1 << k;
+      }
+    };
+    auto lower = [&](Kind k, uint64_t v, bool isSigned) {
+      if (isSigned ? (int64_t)v < (int64_t)bounds[k] : v < bounds[k]) {
+        bounds[k] = v;
+        tightened |= 1 << k;
+      }
+    };
+
+    switch (b.kind) {
+    case UnsignedMin: raise(UnsignedMin, b.value, false); break;
+    case UnsignedMax: lower(UnsignedMax, b.value, false); break;
+    case SignedMin: raise(SignedMin, b.value, true); break;
+    case SignedMax: lower(SignedMax, b.value, true); break;
+    case Equal:
+      raise(UnsignedMin, b.value, false);
+      lower(UnsignedMax, b.value, false);
+      raise(SignedMin, signExtend(b.value, r.width), true);
+      lower(SignedMax, signExtend(b.value, r.width), true);
+      break;
+    }
+
+    unsigned direct = tightened;
+    uint64_t signBit = UINT64_C(1) << (r.width - 1);
+    if ((bounds[UnsignedMin] & signBit) == (bounds[UnsignedMax] & signBit)) {
+      raise(SignedMin, signExtend(bounds[UnsignedMin], r.width), true);
+      lower(SignedMax, signExtend(bounds[UnsignedMax], r.width), true);
+    }
+    if (((int64_t)bounds[SignedMin] < 0) == ((int64_t)bounds[SignedMax] < 0)) {
+      raise(UnsignedMin, bounds[SignedMin] & mask(r.width), false);
+      lower(UnsignedMax, bounds[SignedMax] & mask(r.width), false);
+    }
+    return direct;
+  }
+
+  static bool isEmpty(const Range &r) {
+    return r.bounds[UnsignedMin] > r.bounds[UnsignedMax] ||
+           (int64_t)r.bounds[SignedMin] > (int64_t)r.bounds[SignedMax];
+  }
+
+public:
+  /// Returns false if \a e is not a comparison of a term with a constant.
+  static bool getBound(const ref<Expr> &e, Bound &b) {
+    bool negated = false;
+    ref<Expr> cmp = e;
+    if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+      uint64_t c;
+      if (getConstant(ee->left, ee->right, c)) {
+        b.term = ee->right;
+        b.kind = Equal;
+        b.value = c;
+        return true;
+      }
+      const ConstantExpr *ce = dyn_cast<ConstantExpr>(ee->left);
+      if (!ce || ce->getWidth() != Expr::Bool || !ce->isFalse())
+        return false;
+      negated = true;
+      cmp = ee->right;
+    }
+
+    Expr::Kind k = cmp->getKind();
+    if (k != Expr::Ult && k != Expr::Ule && k != Expr::Slt && k != Expr::Sle)
+      return false;
+    const BinaryExpr *be = cast<BinaryExpr>(cmp);
+    bool isSigned = k == Expr::Slt || k == Expr::Sle;
+    bool strict = k == Expr::Ult || k == Expr::Slt;
+    uint64_t c;
+    if (getConstant(be->right, be->left, c))
+      return makeBound(be->left, c, isSigned, strict, false, negated, b);
+    if (getConstant(be->left, be->right, c))
+      return makeBound(be->right, c, isSigned, strict, true, negated, b);
+    return false;
+  }
+
+  /// Returns 1 if the bound is implied, 0 if it cannot hold, and -1 if
+  /// neither is known.
+  int decide(const Bound &b) const {
+    auto it = terms.find(b.term);
+    if (it == terms.end())
+      return -1;
+    Range r = it->second;
+    narrow(r, b);
+    if (isEmpty(r))
+      return 0;
+    return memcmp(r.bounds, it->second.bounds, sizeof r.bounds) ? -1 : 1;
+  }
+
+  /// Returns true and sets \a value if adding \a b pins its term to a
+  /// single value.
+  bool getImpliedConstant(const Bound &b, uint64_t &value) const {
+    auto it = terms.find(b.term);
+    Range r = it == terms.end() ? makeRange(b.term->getWidth()) : it->second;
+    narrow(r, b);
+    if (isEmpty(r))
+      return false;
+    if (r.bounds[UnsignedMin] == r.bounds[UnsignedMax]) {
+      value = r.bounds[UnsignedMin];
+      return true;
+    }
+    if (r.bounds[SignedMin] == r.bounds[SignedMax]) {
+      value = r.bounds[SignedMin] & mask(r.width);
+      return true;
+    }
+    return false;
+  }
+
+  /// Returns the position of the constraint setting the bound of the kind of
+  /// \a b, if \a b is tighter, and None otherwise.
+  unsigned getLooserSource(const Bound &b) const {
+    if (b.kind == Equal)
+      return None;
+    auto it = terms.find(b.term);
+    if (it == terms.end())
+      return None;
+    Range r = it->second;
+    if (!(narrow(r, b) & (1 << b.kind)))
+      return None;
+    return it->second.sources[b.kind];
+  }
+
+  /// Records the bound \a b set by the constraint at \a position.
+  void add(const Bound &b, unsigned position) {
+    auto it = terms.find(b.term);
+    if (it == terms.end())
+      it = terms.insert(std::make_pair(b.term,
+                                       makeRange(b.term->getWidth()))).first;
+    unsigned tightened = narrow(it->second, b);
+    if (b.kind != Equal && (tightened & (1 << b.kind)))
+      it->second.sources[b.kind] = position;
+  }
+
+  bool empty() const { return terms.empty(); }
+};
 }
 
+/// Replaces the comparisons decided by the bounds of the constraints.
+class RangeFoldVisitor : public ExprVisitor {
+  const ConstraintRanges &ranges;
+
+public:
+  RangeFoldVisitor(const ConstraintRanges &ranges)
+      : ExprVisitor(true), ranges(ranges) {}
+
+  Action visitExprPost(const Expr &e) {
+    if (e.getWidth() != Expr::Bool)
+      return Action::doChildren();
+    ConstraintRanges::Bound b;
+    if (!ConstraintRanges::getBound(ref<Expr>(const_cast<Expr *>(&e)), b))
+      return Action::doChildren();
+    int decided = ranges.decide(b);
+    if (decided < 0)
+      return Action::doChildren();
+    return Action::changeTo(ConstantExpr::alloc(decided, Expr::Bool));
+  }
+};
+
 class ExprReplaceVisitor : public ExprVisitor {
 private:
   ref<Expr> src, dst;
@@ -75,10 +477,18 @@ public:
 };
 
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintManager::constraints_ty old;
   bool changed = false;
 
-  constraints.swap(old);
+  // positions change if any constraint is rewritten; the indices are
+  // rebuilt on demand in that case
+  std::shared_ptr<ConstraintIndependence> oldIndependence;
+  independence.swap(oldIndependence);
+  std::shared_ptr<ConstraintRanges> oldRanges;
+  ranges.swap(oldRanges);
+
+  ConstraintManager::constraints_ty old(constraints.begin(),
+                                        constraints.end());
+  constraints.clear();
   for (ConstraintManager::constraints_ty::iterator 
          it = old.begin(), ie = old.end(); it != ie; ++it) {
     ref<Expr> &ce = *it;
@@ -92,6 +502,10 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  if (!changed) {
+    independence.swap(oldIndependence);
+    ranges.swap(oldRanges);
+  }
   return changed;
 }
 
@@ -105,7 +519,7 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
 
   std::map< ref<Expr>, ref<Expr> > equalities;
   
-  for (ConstraintManager::constraints_ty::const_iterator 
+  for (ConstraintManager::const_iterator
          it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
     if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
       if (isa<ConstantExpr>(ee->left)) {
@@ -121,7 +535,13 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
     }
   }
 
-  return ExprReplaceVisitor2(equalities).visit(e);
+  e = ExprReplaceVisitor2(equalities).visit(e);
+  if (FoldRangeConstraints && !isa<ConstantExpr>(e)) {
+    const ConstraintRanges &r = getRanges();
+    if (!r.empty())
+      e = RangeFoldVisitor(r).visit(e);
+  }
+  return e;
 }
 
 void ConstraintManager::addConstraintInternal(ref<Expr> e) {
@@ -154,16 +574,159 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 	rewriteConstraints(visitor);
       }
     }
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    if (FoldRangeConstraints && foldBound(e))
+      break;
+    pushConstraint(e);
     break;
   }
 }
 
+bool ConstraintManager::foldBound(ref<Expr> e) {
+  ConstraintRanges::Bound b;
+  if (!ConstraintRanges::getBound(e, b))
+    return false;
+  ConstraintRanges &r = getRanges();
+  if (r.decide(b) == 1)
+    return true;
+
+  uint64_t value;
+  if (r.getImpliedConstant(b, value)) {
+    addConstraintInternal(
+        EqExpr::create(ConstantExpr::create(value, b.term->getWidth()),
+                       b.term));
+    return true;
+  }
+
+  // The tighter bound reads the same bytes as the looser one, so it can
+  // take its place without changing the independence index.
+  unsigned looser = r.getLooserSource(b);
+  if (looser == ConstraintRanges::None)
+    return false;
+  constraints.set(looser, e);
+  if (ranges.use_count() > 1)
+    ranges = std::make_shared<ConstraintRanges>(*ranges);
+  ranges->add(b, looser);
+  return true;
+}
+
+void ConstraintManager::pushConstraint(ref<Expr> e) {
+  constraints.push_back(e);
+  ConstraintRanges::Bound b;
+  if (ranges && ConstraintRanges::getBound(e, b)) {
+    if (ranges.use_count() > 1)
+      ranges = std::make_shared<ConstraintRanges>(*ranges);
+    ranges->add(b, constraints.size() - 1);
+  }
+  if (!independence)
+    return;
+  if (independence.use_count() > 1)
+    independence = std::make_shared<ConstraintIndependence>(*independence);
+  independence->add(e);
+}
+
+ConstraintIndependence &ConstraintManager::getIndependence() const {
+  if (!independence) {
+    independence = std::make_shared<ConstraintIndependence>();
+    for (const ref<Expr> &c : constraints)
+      independence->add(c);
+  }
+  return *independence;
+}
+
+ConstraintRanges &ConstraintManager::getRanges() const {
+  if (!ranges) {
+    ranges = std::make_shared<ConstraintRanges>();
+    ConstraintRanges::Bound b;
+    unsigned i = 0;
+    for (const ref<Expr> &c : constraints) {
+      if (ConstraintRanges::getBound(c, b))
+        ranges->add(b, i);
+      ++i;
+    }
+  }
+  return *ranges;
+}
+
+void ConstraintManager::getIndependentConstraints(ref<Expr> e,
+                                                  constraints_ty &result) const {
+  ConstraintIndependence &ci = getIndependence();
+  std::vector<unsigned> members;
+  for (unsigned c : ci.getClasses(e))
+    ci.getMembers(c, members);
+  std::sort(members.begin(), members.end());
+  ConstraintManager::const_iterator it = constraints.begin();
+  unsigned last = 0;
+  for (unsigned i : members) {
+    it += i - last;
+    last = i;
+    result.push_back(*it);
+  }
+}
+
+void ConstraintManager::getIndependentConstraints(
+    ref<Expr> e, ConstraintManager &result) const {
+  ConstraintIndependence &ci = getIndependence();
+  std::vector<unsigned> members;
+  for (unsigned c : ci.getClasses(e))
+    ci.getMembers(c, members);
+  if (members.size() == constraints.size()) {
+    result = *this;
+    return;
+  }
+
+  std::sort(members.begin(), members.end());
+  constraints_ty required;
+  required.reserve(members.size());
+  ConstraintManager::const_iterator it = constraints.begin();
+  unsigned last = 0;
+  for (unsigned i : members) {
+    it += i - last;
+    last = i;
+    required.push_back(*it);
+  }
+  result = ConstraintManager(std::move(required));
+}
+
+void ConstraintManager::getIndependentFactors(
+    ref<Expr> e, std::vector<constraints_ty> &factors) const {
+  ConstraintIndependence &ci = getIndependence();
+  // maps each class to its factor, with the classes of e mapping to the
+  // first one
+  std::unordered_map<unsigned, unsigned> factorOf;
+  for (unsigned c : ci.getClasses(e))
+    factorOf[c] = 0;
+  factors.clear();
+  factors.resize(1);
+  unsigned i = 0;
+  for (const ref<Expr> &c : constraints) {
+    auto res =
+        factorOf.insert(std::make_pair(ci.getClass(i++), factors.size()));
+    if (res.second)
+      factors.emplace_back();
+    factors[res.first->second].push_back(c);
+  }
+}
+
+void ConstraintManager::removeConstraints(const constraints_ty &dropped) {
+  ExprHashSet set;
+  for (const ref<Expr> &c : dropped)
+    set.insert(c);
+  constraints_ty kept;
+  kept.reserve(constraints.size());
+  for (const ref<Expr> &c : constraints)
+    if (!set.count(c))
+      kept.push_back(c);
+  constraints.assign(kept.begin(), kept.end());
+  // the indices refer to the positions of the constraints
+  independence.reset();
+  ranges.reset();
+}
+
 void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
   addConstraintInternal(e);
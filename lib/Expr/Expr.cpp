@@ -20,7 +20,10 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 using namespace klee;
 using namespace llvm;
@@ -37,12 +40,67 @@ cl::opt<bool> ConstArrayOpt(
     cl::desc(
         "Enable an optimization involving all-constant arrays (default=false)"),
     cl::cat(klee::ExprCat));
+
+cl::opt<bool> InternExprs(
+    "intern-exprs", cl::init(false),
+    cl::desc("Share a single node between structurally equal expressions, "
+             "so that equal expressions can be compared by address "
+             "(default=false)"),
+    cl::cat(klee::ExprCat));
+
+/// Non-owning table of interned expressions, bucketed by hash value. Nodes
+/// remove themselves from it on destruction.
+typedef std::unordered_multimap<unsigned, Expr *> ExprInternTable;
+
+// Intentionally leaked so that expressions destroyed during static
+// destruction can still unregister themselves.
+ExprInternTable *internTable = nullptr;
 }
 
 /***/
 
 unsigned Expr::count = 0;
 
+Expr::~Expr() {
+  Expr::count--;
+  // Only the base part of the object is left at this point, so lookup is by
+  // address within the bucket of the (still valid) hash value.
+  if (internTable && !internTable->empty()) {
+    auto range = internTable->equal_range(hashValue);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == this) {
+        internTable->erase(it);
+        break;
+      }
+    }
+  }
+}
+
+ref<Expr> Expr::intern(const ref<Expr> &e) {
+  if (!InternExprs)
+    return e;
+  if (!internTable)
+    internTable = new ExprInternTable();
+
+  Kind k = e->getKind();
+  unsigned numKids = e->getNumKids();
+  auto range = internTable->equal_range(e->hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    Expr *candidate = it->second;
+    if (candidate->getKind() != k || candidate->compareContents(*e))
+      continue;
+    unsigned i = 0;
+    for (; i < numKids; ++i)
+      if (candidate->getKid(i).get() != e->getKid(i).get())
+        break;
+    if (i == numKids)
+      return candidate;
+  }
+
+  internTable->insert(std::make_pair(e->hashValue, e.get()));
+  return e;
+}
+
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
 
@@ -120,7 +178,11 @@ int Expr::compare(const Expr &b, ExprEquivSet &equivs) const {
   if (int res = compareContents(b)) 
     return res;
 
+  // Leaves are fully compared by their contents, only shared subtrees are
+  // worth remembering.
   unsigned aN = getNumKids();
+  if (!aN)
+    return 0;
   for (unsigned i=0; i<aN; i++)
     if (int res = getKid(i)->compare(*b.getKid(i), equivs))
       return res;
@@ -164,6 +226,7 @@ void Expr::printKind(llvm::raw_ostream &os, Kind k) {
     X(Sle);
     X(Sgt);
     X(Sge);
+    X(WideRead);
 #undef X
   default:
     assert(0 && "invalid kind");
@@ -180,10 +243,8 @@ unsigned Expr::computeHash() {
   unsigned res = getKind() * Expr::MAGIC_HASH_CONSTANT;
 
   int n = getNumKids();
-  for (int i = 0; i < n; i++) {
-    res <<= 1;
-    res ^= getKid(i)->hash() * Expr::MAGIC_HASH_CONSTANT;
-  }
+  for (int i = 0; i < n; i++)
+    res = combineHash(res, getKid(i)->hash());
   
   hashValue = res;
   return hashValue;
@@ -199,28 +260,86 @@ unsigned ConstantExpr::computeHash() {
   return hashValue;
 }
 
+namespace {
+/// The number of values shared per width.
+const unsigned NumSmallConstants = 256;
+const Expr::Width SmallConstantWidths[] = {Expr::Bool, Expr::Int8, Expr::Int16,
+                                           Expr::Int32, Expr::Int64};
+const unsigned NumSmallConstantWidths =
+    sizeof(SmallConstantWidths) / sizeof(SmallConstantWidths[0]);
+}
+
+ConstantExpr *ConstantExpr::getSmall(const llvm::APInt &v) {
+  unsigned widthIndex;
+  switch (v.getBitWidth()) {
+  case Expr::Bool:  widthIndex = 0; break;
+  case Expr::Int8:  widthIndex = 1; break;
+  case Expr::Int16: widthIndex = 2; break;
+  case Expr::Int32: widthIndex = 3; break;
+  case Expr::Int64: widthIndex = 4; break;
+  default:
+    return nullptr;
+  }
+  if (v.getActiveBits() > 8)
+    return nullptr;
+
+  // Created all at once on first use, so that the number of live expressions
+  // does not creep up as constants are first seen, and never freed.
+  static ref<ConstantExpr> *table = [] {
+    ref<ConstantExpr> *t =
+        new ref<ConstantExpr>[NumSmallConstantWidths * NumSmallConstants];
+    for (unsigned i = 0; i != NumSmallConstantWidths; ++i) {
+      Expr::Width w = SmallConstantWidths[i];
+      unsigned n = w == Expr::Bool ? 2 : NumSmallConstants;
+      for (unsigned j = 0; j != n; ++j)
+        t[i * NumSmallConstants + j] = allocUncached(llvm::APInt(w, j));
+    }
+    return t;
+  }();
+  return table[widthIndex * NumSmallConstants + v.getZExtValue()].get();
+}
+
+void ConstantExpr::assign(ref<Expr> &dst, const llvm::APInt &v) {
+  if (ConstantExpr *small = getSmall(v)) {
+    dst = small;
+    return;
+  }
+  // Interned nodes are found by their contents, so they must not change.
+  ConstantExpr *ce = dyn_cast_or_null<ConstantExpr>(dst.get());
+  if (!ce || ce->refCount != 1 || InternExprs ||
+      ce->getWidth() != v.getBitWidth()) {
+    dst = alloc(v);
+    return;
+  }
+  ce->value = v;
+  ce->computeHash();
+}
+
 unsigned CastExpr::computeHash() {
-  unsigned res = getWidth() * Expr::MAGIC_HASH_CONSTANT;
-  hashValue = res ^ src->hash() * Expr::MAGIC_HASH_CONSTANT;
+  unsigned res = combineHash(getKind(), getWidth());
+  hashValue = combineHash(res, src->hash());
   return hashValue;
 }
 
 unsigned ExtractExpr::computeHash() {
-  unsigned res = offset * Expr::MAGIC_HASH_CONSTANT;
-  res ^= getWidth() * Expr::MAGIC_HASH_CONSTANT;
-  hashValue = res ^ expr->hash() * Expr::MAGIC_HASH_CONSTANT;
+  unsigned res = combineHash(offset, getWidth());
+  hashValue = combineHash(res, expr->hash());
   return hashValue;
 }
 
 unsigned ReadExpr::computeHash() {
-  unsigned res = index->hash() * Expr::MAGIC_HASH_CONSTANT;
-  res ^= updates.hash();
-  hashValue = res;
+  hashValue = combineHash(updates.hash(), index->hash());
+  return hashValue;
+}
+
+unsigned WideReadExpr::computeHash() {
+  unsigned res = combineHash(updates.hash(), index->hash());
+  hashValue = combineHash(res, width * 2 + isLittleEndian);
   return hashValue;
 }
 
 unsigned NotExpr::computeHash() {
-  hashValue = expr->hash() * Expr::MAGIC_HASH_CONSTANT * Expr::Not;
+  hashValue = combineHash(Expr::Not, expr->hash());
   return hashValue;
 }
 
@@ -499,11 +618,20 @@ ref<Expr>  NotOptimizedExpr::create(ref<Expr> src) {
 
 /***/
 
+const Array::InternedName &Array::internName(const std::string &name) {
+  static std::mutex lock;
+  static std::unordered_map<std::string, unsigned> names;
+  std::lock_guard<std::mutex> guard(lock);
+  // the elements of an unordered map stay in place as it grows
+  return *names.insert(std::make_pair(name, names.size())).first;
+}
+
 Array::Array(const std::string &_name, uint64_t _size,
              const ref<ConstantExpr> *constantValuesBegin,
              const ref<ConstantExpr> *constantValuesEnd, Expr::Width _domain,
              Expr::Width _range)
-    : name(_name), size(_size), domain(_domain), range(_range),
+    : interned(internName(_name)), id(nextId()), nameId(interned.second),
+      name(interned.first), size(_size), domain(_domain), range(_range),
       constantValues(constantValuesBegin, constantValuesEnd) {
 
   assert((isSymbolicArray() || constantValues.size() == size) &&
@@ -520,11 +648,13 @@ Array::Array(const std::string &_name, uint64_t _size,
 Array::~Array() {
 }
 
+unsigned Array::nextId() {
+  static std::atomic<unsigned> counter(0);
+  return counter++;
+}
+
 unsigned Array::computeHash() {
-  unsigned res = 0;
-  for (unsigned i = 0, e = name.size(); i != e; ++i)
-    res = (res * Expr::MAGIC_HASH_CONSTANT) + name[i];
-  res = (res * Expr::MAGIC_HASH_CONSTANT) + size;
+  unsigned res = Expr::combineHash(nameId, size);
   hashValue = res;
   return hashValue; 
 }
@@ -539,17 +669,27 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
   // array element has been updated
   const UpdateNode *un = ul.head;
   bool updateListHasSymbolicWrites = false;
-  for (; un; un=un->next) {
-    // Check if we have an equivalent concrete index
-    ref<Expr> cond = EqExpr::create(index, un->index);
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
-      if (CE->isTrue())
-        // Return the found value
-        return un->value;
-    } else {
-      // Found write with symbolic index
-      updateListHasSymbolicWrites = true;
-      break;
+  const UpdateNode *found;
+  ConstantExpr *CI = dyn_cast<ConstantExpr>(index);
+  if (CI && CI->getWidth() <= Expr::Int64 &&
+      ul.findConcrete(CI->getZExtValue(), found, un)) {
+    // The concrete writes are indexed, no need to go through them
+    if (found)
+      return found->value;
+    updateListHasSymbolicWrites = un != nullptr;
+  } else {
+    for (; un; un=un->next) {
+      // Check if we have an equivalent concrete index
+      ref<Expr> cond = EqExpr::create(index, un->index);
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
+        if (CE->isTrue())
+          // Return the found value
+          return un->value;
+      } else {
+        // Found write with symbolic index
+        updateListHasSymbolicWrites = true;
+        break;
+      }
     }
   }
 
@@ -585,6 +725,58 @@ int ReadExpr::compareContents(const Expr &b) const {
   return updates.compare(static_cast<const ReadExpr&>(b).updates);
 }
 
+ref<Expr> WideReadExpr::create(const UpdateList &ul, ref<Expr> index, Width w,
+                               bool isLittleEndian) {
+  Width range = ul.root->getRange();
+  unsigned n = w / range;
+  assert(n && n * range == w && "wide read of a partial byte");
+
+  // The concatenation of the reads of the bytes, most significant first,
+  // folds what it can and is a wide read again otherwise.
+  ref<Expr> result;
+  for (unsigned byte = 0; byte != n; ++byte) {
+    unsigned offset = isLittleEndian ? byte : n - 1 - byte;
+    ref<Expr> byteIndex =
+        offset ? AddExpr::create(index, ConstantExpr::create(
+                                            offset, index->getWidth()))
+               : index;
+    ref<Expr> read = ReadExpr::create(ul, byteIndex);
+    result = byte ? ConcatExpr::create(read, result) : read;
+  }
+  return result;
+}
+
+ref<Expr> WideReadExpr::getByteIndex(unsigned byte) const {
+  unsigned offset = isLittleEndian ? byte : getNumBytes() - 1 - byte;
+  if (!offset)
+    return index;
+  return AddExpr::create(index,
+                         ConstantExpr::create(offset, index->getWidth()));
+}
+
+ref<Expr> WideReadExpr::getByte(unsigned byte) const {
+  return ReadExpr::create(updates, getByteIndex(byte));
+}
+
+ref<Expr> WideReadExpr::lower() const {
+  // allocated as is, so that the concatenations do not merge again
+  ref<Expr> result = getByte(0);
+  for (unsigned byte = 1, n = getNumBytes(); byte != n; ++byte)
+    result = ConcatExpr::alloc(getByte(byte), result);
+  return result;
+}
+
+int WideReadExpr::compareContents(const Expr &b) const {
+  const WideReadExpr &wb = static_cast<const WideReadExpr &>(b);
+  if (int res = updates.compare(wb.updates))
+    return res;
+  if (width != wb.width)
+    return width < wb.width ? -1 : 1;
+  if (isLittleEndian != wb.isLittleEndian)
+    return isLittleEndian < wb.isLittleEndian ? -1 : 1;
+  return 0;
+}
+
 ref<Expr> SelectExpr::create(ref<Expr> c, ref<Expr> t, ref<Expr> f) {
   Expr::Width kt = t->getWidth();
 
@@ -616,15 +808,47 @@ ref<Expr> SelectExpr::create(ref<Expr> c, ref<Expr> t, ref<Expr> f) {
 
 /***/
 
+namespace {
+/// The bytes a read or a wide read reads.
+struct ByteRun {
+  const UpdateList *updates;
+  ref<Expr> index;
+  unsigned bytes;
+  /// 1 if little-endian, -1 if big-endian, 0 for a single byte.
+  int order;
+};
+
+bool getByteRun(const ref<Expr> &e, ByteRun &run) {
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    run = ByteRun{&re->updates, re->index, 1, 0};
+    return true;
+  }
+  if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+    run = ByteRun{&wre->updates, wre->index, wre->getNumBytes(),
+                  wre->isLittleEndian ? 1 : -1};
+    return true;
+  }
+  return false;
+}
+
+ref<Expr> offsetIndex(const ref<Expr> &index, unsigned offset) {
+  return AddExpr::create(index,
+                         ConstantExpr::create(offset, index->getWidth()));
+}
+}
+
 ref<Expr> ConcatExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
   Expr::Width w = l->getWidth() + r->getWidth();
   
   // Fold concatenation of constants.
-  //
-  // FIXME: concat 0 x -> zext x ?
-  if (ConstantExpr *lCE = dyn_cast<ConstantExpr>(l))
+  if (ConstantExpr *lCE = dyn_cast<ConstantExpr>(l)) {
     if (ConstantExpr *rCE = dyn_cast<ConstantExpr>(r))
       return lCE->Concat(rCE);
+    // Concat(0, x) = ZExt(x), as produced by reading an integer whose most
+    // significant bytes are concrete zeros
+    if (lCE->isZero())
+      return ZExtExpr::create(r, w);
+  }
 
   // Merge contiguous Extracts
   if (ExtractExpr *ee_left = dyn_cast<ExtractExpr>(l)) {
@@ -634,6 +858,34 @@ ref<Expr> ConcatExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
         return ExtractExpr::create(ee_left->expr, ee_right->offset, w);
       }
     }
+    // and those at the top of a chain of Concats, as for the consecutive
+    // lanes of a vector, which are concatenated from the right
+    if (ConcatExpr *ce = dyn_cast<ConcatExpr>(r)) {
+      if (ExtractExpr *ee_right = dyn_cast<ExtractExpr>(ce->getLeft())) {
+        if (ee_left->expr == ee_right->expr &&
+            ee_right->offset + ee_right->width == ee_left->offset)
+          return ConcatExpr::create(
+              ExtractExpr::create(ee_left->expr, ee_right->offset,
+                                  ee_left->width + ee_right->width),
+              ce->getRight());
+      }
+    }
+  }
+
+  // Merge reads of consecutive bytes into a wide read
+  ByteRun left, right;
+  if (getByteRun(l, left) && getByteRun(r, right) &&
+      left.updates->root == right.updates->root &&
+      left.updates->head == right.updates->head &&
+      left.index->getWidth() == right.index->getWidth()) {
+    // the more significant bytes follow the others in little-endian order,
+    // and precede them in big-endian order
+    if (left.order >= 0 && right.order >= 0 &&
+        left.index == offsetIndex(right.index, right.bytes))
+      return WideReadExpr::alloc(*right.updates, right.index, w, true);
+    if (left.order <= 0 && right.order <= 0 &&
+        right.index == offsetIndex(left.index, left.bytes))
+      return WideReadExpr::alloc(*left.updates, left.index, w, false);
   }
 
   return ConcatExpr::alloc(l, r);
@@ -691,6 +943,36 @@ ref<Expr> ExtractExpr::create(ref<Expr> expr, unsigned off, Width w) {
       return ConcatExpr::create(ExtractExpr::create(ce->getKid(0), 0, w - ce->getKid(1)->getWidth() + off),
 				ExtractExpr::create(ce->getKid(1), off, ce->getKid(1)->getWidth() - off));
     }
+
+    // Extract(WideRead): the bytes covered
+    if (WideReadExpr *wre = dyn_cast<WideReadExpr>(expr)) {
+      Width range = wre->updates.root->getRange();
+      unsigned first = off / range, last = (off + w - 1) / range;
+      if (first == last)
+        return ExtractExpr::create(wre->getByte(first), off % range, w);
+      if (off % range || w % range)
+        return ExtractExpr::create(wre->lower(), off, w);
+      return WideReadExpr::alloc(
+          wre->updates,
+          wre->getByteIndex(wre->isLittleEndian ? first : last), w,
+          wre->isLittleEndian);
+    }
+
+    // Extract(ZExt) and Extract(SExt)
+    if (CastExpr *ce = dyn_cast<CastExpr>(expr)) {
+      unsigned sw = ce->src->getWidth();
+      bool isZExt = isa<ZExtExpr>(ce);
+      // if the extract is within the source
+      if (off + w <= sw)
+        return ExtractExpr::create(ce->src, off, w);
+      // if the extract is within the zeros
+      if (isZExt && off >= sw)
+        return ConstantExpr::create(0, w);
+      // if the extract is a narrower extension
+      if (!off)
+        return isZExt ? ZExtExpr::create(ce->src, w)
+                      : SExtExpr::create(ce->src, w);
+    }
   }
   
   return ExtractExpr::alloc(expr, off, w);
@@ -716,6 +998,9 @@ ref<Expr> ZExtExpr::create(const ref<Expr> &e, Width w) {
     return ExtractExpr::create(e, 0, w);
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
     return CE->ZExt(w);
+  } else if (ZExtExpr *ZE = dyn_cast<ZExtExpr>(e)) {
+    // ZExt(ZExt(x)) = ZExt(x)
+    return ZExtExpr::alloc(ZE->src, w);
   } else {
     return ZExtExpr::alloc(e, w);
   }
@@ -729,6 +1014,12 @@ ref<Expr> SExtExpr::create(const ref<Expr> &e, Width w) {
     return ExtractExpr::create(e, 0, w);
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
     return CE->SExt(w);
+  } else if (SExtExpr *SE = dyn_cast<SExtExpr>(e)) {
+    // SExt(SExt(x)) = SExt(x)
+    return SExtExpr::alloc(SE->src, w);
+  } else if (ZExtExpr *ZE = dyn_cast<ZExtExpr>(e)) {
+    // the sign of a zero extension is 0
+    return ZExtExpr::alloc(ZE->src, w);
   } else {    
     return SExtExpr::alloc(e, w);
   }
@@ -1127,6 +1418,19 @@ static ref<Expr> EqExpr_createPartialR(const ref<ConstantExpr> &cl, Expr *r) {
     } else {
       return ConstantExpr::create(0, Expr::Bool);
     }
+  } else if (rk == Expr::Concat) {
+    // (concat(a,b)==c) == (a==extract(c) && b==extract(c)), comparing a
+    // value assembled from bytes byte by byte
+    const ConcatExpr *ce = cast<ConcatExpr>(r);
+    Expr::Width rightBits = ce->getRight()->getWidth();
+    return AndExpr::create(
+        EqExpr::create(cl->Extract(rightBits, width - rightBits),
+                       ce->getLeft()),
+        EqExpr::create(cl->Extract(0, rightBits), ce->getRight()));
+  } else if (rk == Expr::WideRead) {
+    // likewise, over the bytes it stands for
+    ref<Expr> lowered = cast<WideReadExpr>(r)->lower();
+    return EqExpr_createPartialR(cl, lowered.get());
   } else if (rk==Expr::Add) {
     const AddExpr *ae = cast<AddExpr>(r);
     if (isa<ConstantExpr>(ae->left)) {
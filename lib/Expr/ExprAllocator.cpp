@@ -0,0 +1,148 @@
+//===-- ExprAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprAllocator.h"
+
+#include "klee/Expr.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<bool> UseExprArena(
+    "expr-arena", cl::init(false),
+    cl::desc("Allocate expression and update nodes from per-thread slabs "
+             "instead of the global heap (default=false)"),
+    cl::cat(klee::ExprCat));
+
+// Nodes are pointer aligned, so their sizes are multiples of the pointer
+// size. Larger requests always go to the global heap.
+const std::size_t Granularity = sizeof(void *);
+const std::size_t MaxSlabObjectSize = 256;
+const std::size_t NumSizeClasses = MaxSlabObjectSize / Granularity;
+const std::size_t SlabSize = 64 * 1024;
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+/// Per-thread slab state. Caches are intentionally leaked on thread exit:
+/// nodes allocated by a thread may outlive it and be freed by another one.
+struct ThreadCache {
+  FreeBlock *freeLists[NumSizeClasses] = {};
+  char *current = nullptr;
+  char *end = nullptr;
+  uint64_t reservedBytes = 0;
+  // May become negative when nodes are freed by another thread than the one
+  // that allocated them; only the sum over all caches is meaningful.
+  int64_t liveBytes = 0;
+};
+
+std::mutex cachesLock;
+std::vector<ThreadCache *> &getAllCaches() {
+  static std::vector<ThreadCache *> *caches = new std::vector<ThreadCache *>();
+  return *caches;
+}
+
+thread_local ThreadCache *threadCache = nullptr;
+
+ThreadCache &getThreadCache() {
+  if (!threadCache) {
+    threadCache = new ThreadCache();
+    std::lock_guard<std::mutex> guard(cachesLock);
+    getAllCaches().push_back(threadCache);
+  }
+  return *threadCache;
+}
+
+// Set on the first allocation made while -expr-arena is in effect. From then
+// on freed nodes are recycled through the free lists, including those that
+// were allocated from the heap before the command line was parsed (which is
+// sound as heap allocations use the same rounded-up sizes).
+bool arenaEnabled = false;
+
+inline std::size_t roundUp(std::size_t size) {
+  return (size + Granularity - 1) & ~(Granularity - 1);
+}
+}
+
+bool ExprAllocator::isArenaEnabled() { return arenaEnabled; }
+
+void *ExprAllocator::allocate(std::size_t size) {
+  size = roundUp(size);
+  if (size > MaxSlabObjectSize)
+    return ::operator new(size);
+  if (!arenaEnabled) {
+    if (!UseExprArena)
+      return ::operator new(size);
+    arenaEnabled = true;
+  }
+
+  ThreadCache &cache = getThreadCache();
+  cache.liveBytes += size;
+  FreeBlock *&freeList = cache.freeLists[size / Granularity - 1];
+  if (freeList) {
+    FreeBlock *block = freeList;
+    freeList = block->next;
+    return block;
+  }
+
+  if (static_cast<std::size_t>(cache.end - cache.current) < size) {
+    // The remainder of the previous slab is leaked; it is smaller than the
+    // largest object size and thus negligible.
+    cache.current = static_cast<char *>(std::malloc(SlabSize));
+    if (!cache.current)
+      throw std::bad_alloc();
+    cache.end = cache.current + SlabSize;
+    cache.reservedBytes += SlabSize;
+  }
+  void *p = cache.current;
+  cache.current += size;
+  return p;
+}
+
+void ExprAllocator::deallocate(void *p, std::size_t size) {
+  size = roundUp(size);
+  if (!arenaEnabled || size > MaxSlabObjectSize) {
+    ::operator delete(p);
+    return;
+  }
+
+  ThreadCache &cache = getThreadCache();
+  cache.liveBytes -= size;
+  FreeBlock *block = static_cast<FreeBlock *>(p);
+  FreeBlock *&freeList = cache.freeLists[size / Granularity - 1];
+  block->next = freeList;
+  freeList = block;
+}
+
+uint64_t ExprAllocator::getReservedBytes() {
+  std::lock_guard<std::mutex> guard(cachesLock);
+  uint64_t total = 0;
+  for (ThreadCache *cache : getAllCaches())
+    total += cache->reservedBytes;
+  return total;
+}
+
+uint64_t ExprAllocator::getLiveBytes() {
+  std::lock_guard<std::mutex> guard(cachesLock);
+  int64_t total = 0;
+  for (ThreadCache *cache : getAllCaches())
+    total += cache->liveBytes;
+  // Heap allocated nodes recycled after enabling the arena make the sum
+  // slightly pessimistic.
+  return total < 0 ? 0 : total;
+}
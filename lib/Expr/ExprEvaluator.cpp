@@ -13,7 +13,12 @@ using namespace klee;
 
 ExprVisitor::Action ExprEvaluator::evalRead(const UpdateList &ul,
                                             unsigned index) {
-  for (const UpdateNode *un=ul.head; un; un=un->next) {
+  // The updates with concrete indices may be indexed.
+  const UpdateNode *un = ul.head, *found;
+  if (ul.findConcrete(index, found, un) && found)
+    return Action::changeTo(visit(found->value));
+
+  for (; un; un=un->next) {
     ref<Expr> ui = visit(un->index);
     
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(ui)) {
@@ -41,7 +46,7 @@ ExprVisitor::Action ExprEvaluator::visitExpr(const Expr &e) {
   // construction. Don't do this for reads though, because we want them to go to
   // the normal rewrite path.
   unsigned N = e.getNumKids();
-  if (!N || isa<ReadExpr>(e))
+  if (!N || isa<ReadExpr>(e) || isa<WideReadExpr>(e))
     return Action::doChildren();
 
   for (unsigned i = 0; i != N; ++i)
@@ -67,6 +72,25 @@ ExprVisitor::Action ExprEvaluator::visitRead(const ReadExpr &re) {
   }
 }
 
+ExprVisitor::Action ExprEvaluator::visitWideRead(const WideReadExpr &wre) {
+  ref<Expr> v = visit(wre.index);
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(v);
+  if (!CE)
+    return ExprVisitor::visitWideRead(wre);
+
+  // The concatenation of the bytes, most significant first.
+  unsigned n = wre.getNumBytes();
+  ref<Expr> result;
+  for (unsigned byte = 0; byte != n; ++byte) {
+    unsigned offset = wre.isLittleEndian ? byte : n - 1 - byte;
+    ref<ConstantExpr> index =
+        CE->Add(ConstantExpr::create(offset, CE->getWidth()));
+    ref<Expr> value = evalRead(wre.updates, index->getZExtValue()).argument;
+    result = byte ? ConcatExpr::create(value, result) : value;
+  }
+  return Action::changeTo(result);
+}
+
 // we need to check for div by zero during partial evaluation,
 // if this occurs then simply ignore the 0 divisor and use the
 // original expression.
@@ -93,6 +93,9 @@ private:
       return true;
     } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
       return isVerySimple(re->index) && isVerySimpleUpdate(re->updates.head);
+    } else if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+      return isVerySimple(wre->index) &&
+             isVerySimpleUpdate(wre->updates.head);
     } else {
       Expr *ep = e.get();
       for (unsigned i=0; i<ep->getNumKids(); i++)
@@ -131,6 +134,9 @@ private:
         if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
           usedArrays.insert(re->updates.root);
           scanUpdate(re->updates.head);
+        } else if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+          usedArrays.insert(wre->updates.root);
+          scanUpdate(wre->updates.head);
         }
       } else {
         shouldPrint.insert(e);
@@ -300,6 +306,13 @@ private:
     printUpdateList(re->updates, PC);
   }
 
+  void printWideRead(const WideReadExpr *wre, PrintContext &PC,
+                     unsigned indent) {
+    print(wre->index, PC);
+    printSeparator(PC, isVerySimple(wre->index), indent);
+    printUpdateList(wre->updates, PC);
+  }
+
   void printExtract(const ExtractExpr *ee, PrintContext &PC, unsigned indent) {
     PC << ee->offset << ' ';
     print(ee->expr, PC);
@@ -411,6 +424,20 @@ public:
 	  }
         }
 
+        if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+          if (!PCMultibyteReads) {
+            print(wre->lower(), PC);
+            return;
+          }
+          // the index of both is the lowest one
+          PC << "(Read" << (wre->isLittleEndian ? "LSB" : "MSB");
+          printWidth(PC, e);
+          PC << ' ';
+          printWideRead(wre, PC, PC.pos);
+          PC << ')';
+          return;
+        }
+
 	PC << '(' << e->getKind();
         printWidth(PC, e);
         PC << ' ';
@@ -9,6 +9,7 @@
 
 #include "klee/util/ExprSMTLIBPrinter.h"
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -47,7 +48,11 @@ llvm::cl::opt<klee::ExprSMTLIBPrinter::AbbreviationMode> abbreviationMode(
                      clEnumValN(klee::ExprSMTLIBPrinter::ABBR_LET, "let",
                                 "Abbreviate with let"),
                      clEnumValN(klee::ExprSMTLIBPrinter::ABBR_NAMED, "named",
-                                "Abbreviate with :named annotations")
+                                "Abbreviate with :named annotations"),
+                     clEnumValN(klee::ExprSMTLIBPrinter::ABBR_DEFINE, "define",
+                                "Abbreviate with define-fun commands, each "
+                                "shared expression and array update "
+                                "printed once")
                          KLEE_LLVM_CL_VAL_END),
     llvm::cl::init(klee::ExprSMTLIBPrinter::ABBR_LET),
     llvm::cl::cat(klee::ExprCat));
@@ -84,8 +89,11 @@ void ExprSMTLIBPrinter::setQuery(const Query &q) {
 void ExprSMTLIBPrinter::reset() {
   bindings.clear();
   orderedBindings.clear();
+  scannedUpdates.clear();
+  updateBindings.clear();
   seenExprs.clear();
   usedArrays.clear();
+  loweredWideReads.clear();
   haveConstantArray = false;
 
   /* Clear the PRODUCE_MODELS option if it was automatically set.
@@ -123,7 +131,7 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
 
   /* Handle bitvector constants */
 
-  std::string value;
+  llvm::SmallString<32> value;
 
   /* SMTLIBv2 deduces the bit-width (should be 8-bits in our case)
    * from the length of the string (e.g. zero is #b00000000). LLVM
@@ -134,10 +142,10 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
 
   switch (cdm) {
   case BINARY:
-    e->toString(value, 2);
+    e->getAPValue().toString(value, 2, false);
     *p << "#b";
 
-    zeroPad = e->getWidth() - value.length();
+    zeroPad = e->getWidth() - value.size();
 
     for (unsigned int count = 0; count < zeroPad; count++)
       *p << "0";
@@ -146,10 +154,10 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
     break;
 
   case HEX:
-    e->toString(value, 16);
+    e->getAPValue().toString(value, 16, false);
     *p << "#x";
 
-    zeroPad = (e->getWidth() / 4) - value.length();
+    zeroPad = (e->getWidth() / 4) - value.size();
     for (unsigned int count = 0; count < zeroPad; count++)
       *p << "0";
 
@@ -157,7 +165,7 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
     break;
 
   case DECIMAL:
-    e->toString(value, 10);
+    e->getAPValue().toString(value, 10, false);
     *p << "(_ bv" << value << " " << e->getWidth() << ")";
     break;
 
@@ -168,6 +176,12 @@ void ExprSMTLIBPrinter::printConstant(const ref<ConstantExpr> &e) {
 
 void ExprSMTLIBPrinter::printExpression(
     const ref<Expr> &e, ExprSMTLIBPrinter::SMTLIB_SORT expectedSort) {
+  // wide reads are printed, and scanned, as the selects of their bytes
+  if (isa<WideReadExpr>(e)) {
+    printExpression(lower(e), expectedSort);
+    return;
+  }
+
   // check if casting might be necessary
   if (getSort(e) != expectedSort) {
     printCastToSort(e, expectedSort);
@@ -202,6 +216,15 @@ void ExprSMTLIBPrinter::printExpression(
     }
     break;
   }
+
+  case ABBR_DEFINE: {
+    BindingMap::iterator i = bindings.find(e);
+    if (i != bindings.end() && i->second < 0) {
+      *p << "?B" << -i->second;
+      return;
+    }
+    break;
+  }
   }
 
   printFullExpression(e, expectedSort);
@@ -477,6 +500,15 @@ const char *ExprSMTLIBPrinter::getSMTLIBKeyword(const ref<Expr> &e) {
 
 void ExprSMTLIBPrinter::printUpdatesAndArray(const UpdateNode *un,
                                              const Array *root) {
+  if (abbrMode == ABBR_DEFINE && un != NULL) {
+    // printUpdateDefinitions() has already defined the whole list
+    std::map<const UpdateNode *, int>::const_iterator i =
+        updateBindings.find(un);
+    assert(i != updateBindings.end() && "update node was not defined");
+    *p << "?U" << i->second;
+    return;
+  }
+
   if (un != NULL) {
     *p << "(store ";
     p->pushIndent();
@@ -649,7 +681,17 @@ void ExprSMTLIBPrinter::printHumanReadableQuery() {
 }
 void ExprSMTLIBPrinter::printMachineReadableQuery() {
   assert(!humanReadable && "method should not be called in humanReadable mode");
-  printQueryInSingleAssert();
+  if (abbrMode != ABBR_DEFINE) {
+    printQueryInSingleAssert();
+    return;
+  }
+
+  // define-fun abbreviations are global, so each constraint can be
+  // asserted on its own as soon as its definitions are printed
+  for (ConstraintManager::const_iterator i = query->constraints.begin();
+       i != query->constraints.end(); i++)
+    printAssert(*i);
+  printAssert(Expr::createIsZero(query->expr));
 }
 
 
@@ -659,8 +701,8 @@ void ExprSMTLIBPrinter::printQueryInSingleAssert() {
   ref<Expr> queryAssert = Expr::createIsZero(query->expr);
 
   // Print constraints inside the main query to reuse the Expr bindings
-  for (std::vector<ref<Expr> >::const_iterator i = query->constraints.begin(),
-                                               e = query->constraints.end();
+  for (ConstraintManager::const_iterator i = query->constraints.begin(),
+                                         e = query->constraints.end();
        i != e; ++i) {
     queryAssert = AndExpr::create(queryAssert, *i);
   }
@@ -694,12 +736,24 @@ void ExprSMTLIBPrinter::printAction() {
   }
 }
 
+const ref<Expr> &ExprSMTLIBPrinter::lower(const ref<Expr> &e) {
+  ref<Expr> &lowered = loweredWideReads[e];
+  if (lowered.isNull())
+    lowered = cast<WideReadExpr>(e)->lower();
+  return lowered;
+}
+
 void ExprSMTLIBPrinter::scan(const ref<Expr> &e) {
   assert(!(e.isNull()) && "found NULL expression");
 
   if (isa<ConstantExpr>(e))
     return; // we don't need to scan simple constants
 
+  if (isa<WideReadExpr>(e)) {
+    scan(lower(e));
+    return;
+  }
+
   if (seenExprs.insert(e).second) {
     // We've not seen this expression before
 
@@ -714,6 +768,11 @@ void ExprSMTLIBPrinter::scan(const ref<Expr> &e) {
 
         // scan the update list
         scanUpdates(re->updates.head);
+      } else if (abbrMode == ABBR_DEFINE) {
+        // Every version of the array gets defined, so the updates of each
+        // must be scanned for shared expressions. scanUpdates() stops at
+        // the tail already scanned with an earlier version.
+        scanUpdates(re->updates.head);
       }
     }
 
@@ -761,12 +820,14 @@ void ExprSMTLIBPrinter::scanBindingExprDeps() {
     childQueue.push(it->first);
     // Non-recursive expression parsing
     while (childQueue.size()) {
-      Expr *ep = childQueue.top().get();
+      ref<Expr> cur = childQueue.top();
       childQueue.pop();
-      for (unsigned i = 0; i < ep->getNumKids(); ++i) {
-        ref<Expr> e = ep->getKid(i);
+      for (unsigned i = 0; i < cur->getNumKids(); ++i) {
+        ref<Expr> e = cur->getKid(i);
         if (isa<ConstantExpr>(e))
           continue;
+        if (isa<WideReadExpr>(e))
+          e = lower(e);
         // Are there any dependencies in the bindings?
         if (bindings.count(e)) {
           usesSubExprMap[it->first].insert(e);
@@ -822,6 +883,8 @@ void ExprSMTLIBPrinter::scanBindingExprDeps() {
 
 void ExprSMTLIBPrinter::scanUpdates(const UpdateNode *un) {
   while (un != NULL) {
+    if (abbrMode == ABBR_DEFINE && !scannedUpdates.insert(un).second)
+      break;
     scan(un->index);
     scan(un->value);
     un = un->next;
@@ -861,7 +924,93 @@ void ExprSMTLIBPrinter::printOptions() {
   }
 }
 
+void ExprSMTLIBPrinter::printDefinitions(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return;
+  if (isa<WideReadExpr>(e)) {
+    printDefinitions(lower(e));
+    return;
+  }
+
+  // Expressions used only once are not bindings and so are visited once,
+  // which keeps this walk linear in the size of the query.
+  BindingMap::iterator i = bindings.find(e);
+  if (i != bindings.end() && i->second < 0)
+    return; // already defined
+
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+    printUpdateDefinitions(re->updates.head, re->updates.root);
+  for (unsigned k = 0; k < e->getNumKids(); ++k)
+    printDefinitions(e->getKid(k));
+
+  if (i == bindings.end())
+    return;
+
+  SMTLIB_SORT sort = getSort(e);
+  p->pushIndent();
+  *p << "(define-fun";
+  p->pushIndent();
+  *p << " ?B" << i->second << " () ";
+  if (sort == SORT_BOOL)
+    *p << "Bool";
+  else
+    *p << "(_ BitVec " << e->getWidth() << ")";
+  printSeperator();
+  printFullExpression(e, sort);
+  p->popIndent();
+  printSeperator();
+  *p << ")";
+  p->popIndent();
+  p->breakLineI();
+
+  i->second = -i->second;
+}
+
+void ExprSMTLIBPrinter::printUpdateDefinitions(const UpdateNode *un,
+                                               const Array *root) {
+  // Define the updates not defined yet, oldest first, each on top of the
+  // version of the array before it.
+  std::vector<const UpdateNode *> pending;
+  for (; un != NULL && !updateBindings.count(un); un = un->next)
+    pending.push_back(un);
+
+  for (std::vector<const UpdateNode *>::reverse_iterator it = pending.rbegin(),
+                                                        ie = pending.rend();
+       it != ie; ++it) {
+    const UpdateNode *u = *it;
+    printDefinitions(u->index);
+    printDefinitions(u->value);
+
+    int id = updateBindings.size() + 1;
+    p->pushIndent();
+    *p << "(define-fun";
+    p->pushIndent();
+    *p << " ?U" << id << " () (Array (_ BitVec " << root->getDomain()
+       << ") (_ BitVec " << root->getRange() << "))";
+    printSeperator();
+    *p << "(store ";
+    p->pushIndent();
+    printUpdatesAndArray(u->next, root);
+    printSeperator();
+    printExpression(u->index, SORT_BITVECTOR);
+    printSeperator();
+    printExpression(u->value, SORT_BITVECTOR);
+    p->popIndent();
+    *p << ")";
+    p->popIndent();
+    printSeperator();
+    *p << ")";
+    p->popIndent();
+    p->breakLineI();
+
+    updateBindings.insert(std::make_pair(u, id));
+  }
+}
+
 void ExprSMTLIBPrinter::printAssert(const ref<Expr> &e) {
+  if (abbrMode == ABBR_DEFINE)
+    printDefinitions(e);
+
   p->pushIndent();
   *p << "(assert";
   p->pushIndent();
@@ -14,6 +14,7 @@
 
 #include "klee/util/ExprVisitor.h"
 
+#include <algorithm>
 #include <set>
 
 using namespace klee;
@@ -62,6 +63,13 @@ void klee::findReads(ref<Expr> e,
           }
         }
       }
+    } else if (WideReadExpr *wre = dyn_cast<WideReadExpr>(top)) {
+      // the reads of the bytes, which make up the results
+      for (unsigned byte = 0, n = wre->getNumBytes(); byte != n; ++byte) {
+        ref<Expr> k = wre->getByte(byte);
+        if (!isa<ConstantExpr>(k) && visited.insert(k).second)
+          stack.push_back(k);
+      }
     } else if (!isa<ConstantExpr>(top)) {
       Expr *e = top.get();
       for (unsigned i=0; i<e->getNumKids(); i++) {
@@ -96,6 +104,21 @@ protected:
     return Action::doChildren();
   }
 
+  Action visitWideRead(const WideReadExpr &wre) {
+    const UpdateList &ul = wre.updates;
+
+    for (const UpdateNode *un=ul.head; un; un=un->next) {
+      visit(un->index);
+      visit(un->value);
+    }
+
+    if (ul.root->isSymbolicArray())
+      if (results.insert(ul.root).second)
+        objects.push_back(ul.root);
+
+    return Action::doChildren();
+  }
+
 public:
   std::set<const Array*> results;
   std::vector<const Array*> &objects;
@@ -119,6 +142,43 @@ ExprVisitor::Action ConstantArrayFinder::visitRead(const ReadExpr &re) {
 
   return Action::doChildren();
 }
+
+ExprVisitor::Action
+ConstantArrayFinder::visitWideRead(const WideReadExpr &wre) {
+  const UpdateList &ul = wre.updates;
+
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    visit(un->index);
+    visit(un->value);
+  }
+
+  if (ul.root->isConstantArray()) {
+    results.insert(ul.root);
+  }
+
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ScalarArrayFinder::visitRead(const ReadExpr &re) {
+  const UpdateList &ul = re.updates;
+
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    visit(un->index);
+    visit(un->value);
+  }
+
+  // Constant arrays are handled by their own assertions.
+  if (!ul.root->isConstantArray() && !excluded.count(ul.root)) {
+    if (isa<ConstantExpr>(re.index) && ul.getSize() <= maxUpdates) {
+      results.insert(ul.root);
+    } else {
+      excluded.insert(ul.root);
+      results.erase(ul.root);
+    }
+  }
+
+  return Action::doChildren();
+}
 }
 
 template<typename InputIterator>
@@ -135,8 +195,49 @@ void klee::findSymbolicObjects(ref<Expr> e,
   findSymbolicObjects(&e, &e+1, results);
 }
 
+uint64_t ExprShapeMeasurer::measure(const UpdateList &ul) {
+  arrays.insert(ul.root);
+  // The lists are walked without recursion, as they can be long: the
+  // updates up to the first one measured before, then back.
+  std::vector<const UpdateNode *> pending;
+  const UpdateNode *un = ul.head;
+  for (; un && !updateDepths.count(un); un = un->next)
+    pending.push_back(un);
+  uint64_t d = un ? updateDepths[un] : 0;
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    d = std::max(d, std::max(measure((*it)->index), measure((*it)->value)));
+    updateDepths[*it] = d;
+  }
+  return d;
+}
+
+uint64_t ExprShapeMeasurer::measure(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return 0;
+  auto it = depths.find(e.get());
+  if (it != depths.end())
+    return it->second;
+
+  uint64_t d = 0;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+    d = measure(re->updates);
+  else if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e))
+    d = measure(wre->updates);
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    d = std::max(d, measure(e->getKid(i)));
+  depths[e.get()] = ++d;
+  return d;
+}
+
+void ExprShapeMeasurer::add(const ref<Expr> &e) {
+  depth = std::max(depth, measure(e));
+}
+
 typedef std::vector< ref<Expr> >::iterator A;
 template void klee::findSymbolicObjects<A>(A, A, std::vector<const Array*> &);
 
 typedef std::set< ref<Expr> >::iterator B;
 template void klee::findSymbolicObjects<B>(B, B, std::vector<const Array*> &);
+
+typedef std::vector< ref<Expr> >::const_iterator C;
+template void klee::findSymbolicObjects<C>(C, C, std::vector<const Array*> &);
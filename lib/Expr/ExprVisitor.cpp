@@ -22,42 +22,74 @@ llvm::cl::opt<bool> UseVisitorHash(
 
 using namespace klee;
 
+// The visit is a post-order traversal driven by an explicit stack rather
+// than by recursion, so that deep expressions do not overflow the native
+// stack. Hooks are called in the same order as a recursive traversal
+// would, and may themselves visit other expressions.
 ref<Expr> ExprVisitor::visit(const ref<Expr> &e) {
-  if (!UseVisitorHash || isa<ConstantExpr>(e)) {
-    return visitActual(e);
-  } else {
-    visited_ty::iterator it = visited.find(e);
-
-    if (it!=visited.end()) {
-      return it->second;
+  ref<Expr> result;
+  size_t base = stack.size();
+  if (enter(e, result))
+    return result;
+
+  while (stack.size() > base) {
+    Frame &f = stack.back();
+    if (f.next != f.e->getNumKids()) {
+      if (!enter(f.e->getKid(f.next), result))
+        continue;
+    } else if (f.rebuild && !f.revisiting) {
+      ref<Expr> rebuilt = f.e->rebuild(f.kids);
+      if (!recursive) {
+        result = leave(rebuilt);
+      } else {
+        f.revisiting = true;
+        if (!enter(rebuilt, result))
+          continue;
+        result = leave(result);
+      }
     } else {
-      ref<Expr> res = visitActual(e);
-      visited.insert(std::make_pair(e, res));
-      return res;
+      result = leave(f.e);
+    }
+
+    // Hand the result on to the expression it is part of, finishing those
+    // which are complete.
+    while (stack.size() > base) {
+      Frame &parent = stack.back();
+      if (parent.revisiting) {
+        result = leave(result);
+        continue;
+      }
+      ref<Expr> kid = parent.e->getKid(parent.next);
+      parent.kids[parent.next++] = result;
+      if (result != kid)
+        parent.rebuild = true;
+      break;
     }
   }
+  return result;
 }
 
-ref<Expr> ExprVisitor::visitActual(const ref<Expr> &e) {
-  if (isa<ConstantExpr>(e)) {    
-    return e;
-  } else {
-    Expr &ep = *e.get();
+bool ExprVisitor::enter(const ref<Expr> &e, ref<Expr> &result) {
+  if (isa<ConstantExpr>(e)) {
+    result = e;
+    return true;
+  }
 
-    Action res = visitExpr(ep);
-    switch(res.kind) {
-    case Action::DoChildren:
-      // continue with normal action
-      break;
-    case Action::SkipChildren:
-      return e;
-    case Action::ChangeTo:
-      return res.argument;
+  if (UseVisitorHash) {
+    visited_ty::iterator it = visited.find(e.get());
+    if (it != visited.end()) {
+      result = it->second.second;
+      return true;
     }
+  }
 
+  Expr &ep = *e.get();
+  Action res = visitExpr(ep);
+  if (res.kind == Action::DoChildren) {
     switch(ep.getKind()) {
     case Expr::NotOptimized: res = visitNotOptimized(static_cast<NotOptimizedExpr&>(ep)); break;
     case Expr::Read: res = visitRead(static_cast<ReadExpr&>(ep)); break;
+    case Expr::WideRead: res = visitWideRead(static_cast<WideReadExpr&>(ep)); break;
     case Expr::Select: res = visitSelect(static_cast<SelectExpr&>(ep)); break;
     case Expr::Concat: res = visitConcat(static_cast<ConcatExpr&>(ep)); break;
     case Expr::Extract: res = visitExtract(static_cast<ExtractExpr&>(ep)); break;
@@ -91,38 +123,39 @@ ref<Expr> ExprVisitor::visitActual(const ref<Expr> &e) {
     default:
       assert(0 && "invalid expression kind");
     }
+  }
 
-    switch(res.kind) {
-    default:
-      assert(0 && "invalid kind");
-    case Action::DoChildren: {  
-      bool rebuild = false;
-      ref<Expr> e(&ep), kids[8];
-      unsigned count = ep.getNumKids();
-      for (unsigned i=0; i<count; i++) {
-        ref<Expr> kid = ep.getKid(i);
-        kids[i] = visit(kid);
-        if (kids[i] != kid)
-          rebuild = true;
-      }
-      if (rebuild) {
-        e = ep.rebuild(kids);
-        if (recursive)
-          e = visit(e);
-      }
-      if (!isa<ConstantExpr>(e)) {
-        res = visitExprPost(*e.get());
-        if (res.kind==Action::ChangeTo)
-          e = res.argument;
-      }
-      return e;
-    }
-    case Action::SkipChildren:
-      return e;
-    case Action::ChangeTo:
-      return res.argument;
-    }
+  switch (res.kind) {
+  default:
+    assert(0 && "invalid kind");
+  case Action::DoChildren:
+    assert(ep.getNumKids() <= 3 && "too many kids");
+    stack.push_back(Frame(e));
+    return false;
+  case Action::SkipChildren:
+    result = e;
+    break;
+  case Action::ChangeTo:
+    result = res.argument;
+    break;
   }
+  if (UseVisitorHash)
+    visited[e.get()] = std::make_pair(e, result);
+  return true;
+}
+
+ref<Expr> ExprVisitor::leave(ref<Expr> e) {
+  if (!isa<ConstantExpr>(e)) {
+    Action res = visitExprPost(*e.get());
+    if (res.kind == Action::ChangeTo)
+      e = res.argument;
+  }
+  // the hook may have visited other expressions, moving the stack
+  ref<Expr> key = stack.back().e;
+  stack.pop_back();
+  if (UseVisitorHash)
+    visited[key.get()] = std::make_pair(key, e);
+  return e;
 }
 
 ExprVisitor::Action ExprVisitor::visitExpr(const Expr&) {
@@ -141,6 +174,15 @@ ExprVisitor::Action ExprVisitor::visitRead(const ReadExpr&) {
   return Action::doChildren(); 
 }
 
+ExprVisitor::Action ExprVisitor::visitWideRead(const WideReadExpr &wre) {
+  // the visitors overriding visitRead expect to see every byte
+  ref<Expr> lowered = wre.lower();
+  ref<Expr> result = visit(lowered);
+  if (result.get() == lowered.get())
+    return Action::skipChildren();
+  return Action::changeTo(result);
+}
+
 ExprVisitor::Action ExprVisitor::visitSelect(const SelectExpr&) {
   return Action::doChildren(); 
 }
@@ -9,10 +9,27 @@
 
 #include "klee/Expr.h"
 
+#include <algorithm>
 #include <cassert>
+#include <unordered_set>
+#include <vector>
 
 using namespace klee;
 
+namespace {
+/// The number of most recent updates with concrete indices from which on
+/// they are indexed.
+const unsigned MinIndexedUpdates = 16;
+
+bool getConcreteIndex(const ref<Expr> &index, uint64_t &value) {
+  const ConstantExpr *CE = dyn_cast<ConstantExpr>(index);
+  if (!CE || CE->getWidth() > Expr::Int64)
+    return false;
+  value = CE->getZExtValue();
+  return true;
+}
+}
+
 ///
 
 UpdateNode::UpdateNode(const UpdateNode *_next, 
@@ -30,10 +47,32 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
   */
   computeHash();
   if (next) {
-    ++next->refCount;
+    refCountInc(next->refCount);
     size = 1 + next->size;
   }
   else size = 1;
+
+  uint64_t i;
+  if (!getConcreteIndex(index, i))
+    return;
+  if (next && next->concreteIndex) {
+    concreteIndex = std::move(next->concreteIndex);
+  } else {
+    unsigned run = 0;
+    const UpdateNode *un = next;
+    for (; un && run < MinIndexedUpdates && isa<ConstantExpr>(un->index);
+         un = un->next)
+      ++run;
+    if (run < MinIndexedUpdates)
+      return;
+
+    concreteIndex.reset(new ConcreteIndex());
+    uint64_t j;
+    for (un = next; un && getConcreteIndex(un->index, j); un = un->next)
+      concreteIndex->latest.insert(std::make_pair(j, un));
+    concreteIndex->rest = un;
+  }
+  concreteIndex->latest[i] = this;
 }
 
 extern "C" void vc_DeleteExpr(void*);
@@ -53,9 +92,9 @@ int UpdateNode::compare(const UpdateNode &b) const {
 }
 
 unsigned UpdateNode::computeHash() {
-  hashValue = index->hash() ^ value->hash();
+  hashValue = Expr::combineHash(index->hash(), value->hash());
   if (next)
-    hashValue ^= next->hash();
+    hashValue = Expr::combineHash(hashValue, next->hash());
   return hashValue;
 }
 
@@ -64,13 +103,13 @@ unsigned UpdateNode::computeHash() {
 UpdateList::UpdateList(const Array *_root, const UpdateNode *_head)
   : root(_root),
     head(_head) {
-  if (head) ++head->refCount;
+  if (head) refCountInc(head->refCount);
 }
 
 UpdateList::UpdateList(const UpdateList &b)
   : root(b.root),
     head(b.head) {
-  if (head) ++head->refCount;
+  if (head) refCountInc(head->refCount);
 }
 
 UpdateList::~UpdateList() {
@@ -127,7 +166,7 @@ void UpdateList::tryFreeNodes() {
   //  nullptr
   //  ^Head0
   //
-  while (head && --head->refCount==0) {
+  while (head && refCountDec(head->refCount)) {
     const UpdateNode *n = head->next;
     delete head;
     head = n;
@@ -135,7 +174,7 @@ void UpdateList::tryFreeNodes() {
 }
 
 UpdateList &UpdateList::operator=(const UpdateList &b) {
-  if (b.head) ++b.head->refCount;
+  if (b.head) refCountInc(b.head->refCount);
   // Drop reference to the current head and free a chain of nodes
   // if we are the only UpdateList referencing them
   tryFreeNodes();
@@ -151,19 +190,74 @@ void UpdateList::extend(const ref<Expr> &index, const ref<Expr> &value) {
     assert(root->getRange() == value->getWidth());
   }
 
-  if (head) --head->refCount;
+  if (head) refCountDec(head->refCount);
   head = new UpdateNode(head, index, value);
-  ++head->refCount;
+  refCountInc(head->refCount);
 }
 
-int UpdateList::compare(const UpdateList &b) const {
-  if (root->name != b.root->name)
-    return root->name < b.root->name ? -1 : 1;
+bool UpdateList::findConcrete(uint64_t index, const UpdateNode *&found,
+                              const UpdateNode *&rest) const {
+  if (!head || !head->concreteIndex)
+    return false;
+  auto it = head->concreteIndex->latest.find(index);
+  found = it == head->concreteIndex->latest.end() ? nullptr : it->second;
+  rest = head->concreteIndex->rest;
+  return true;
+}
+
+void UpdateList::compact() {
+  std::vector<const UpdateNode *> nodes;
+  for (const UpdateNode *un = head; un; un = un->next)
+    nodes.push_back(un);
 
-  // Check the root itself in case we have separate objects with the
-  // same name.
+  // Only the most recent update of a concrete index can be read.
+  std::unordered_set<uint64_t> written;
+  std::vector<bool> keep(nodes.size());
+  for (unsigned i = 0; i != nodes.size(); ++i) {
+    uint64_t index;
+    keep[i] = !getConcreteIndex(nodes[i]->index, index) ||
+              written.insert(index).second;
+  }
+
+  unsigned shared = nodes.size();
+  while (shared && keep[shared - 1])
+    --shared;
+  if (!shared)
+    return;
+
+  UpdateList result(root, shared == nodes.size() ? nullptr : nodes[shared]);
+  std::vector<std::pair<uint64_t, const UpdateNode *> > run;
+  auto flushRun = [&]() {
+    std::sort(run.begin(), run.end(),
+              [](const std::pair<uint64_t, const UpdateNode *> &a,
+                 const std::pair<uint64_t, const UpdateNode *> &b) {
+                return a.first < b.first;
+              });
+    for (const auto &update : run)
+      result.extend(update.second->index, update.second->value);
+    run.clear();
+  };
+  for (unsigned i = shared - 1; i != 0; --i) {
+    const UpdateNode *un = nodes[i - 1];
+    uint64_t index;
+    if (!keep[i - 1])
+      continue;
+    if (getConcreteIndex(un->index, index)) {
+      run.push_back(std::make_pair(index, un));
+    } else {
+      flushRun();
+      result.extend(un->index, un->value);
+    }
+  }
+  flushRun();
+  *this = result;
+}
+
+int UpdateList::compare(const UpdateList &b) const {
+  // arrays are ordered by creation, which also separates the arrays of the
+  // same name
   if (root != b.root)
-    return root < b.root ? -1 : 1;
+    return root->id < b.root->id ? -1 : 1;
 
   if (getSize() < b.getSize()) return -1;
   else if (getSize() > b.getSize()) return 1;    
@@ -174,6 +268,10 @@ int UpdateList::compare(const UpdateList &b) const {
     if (an==bn) { // exploit shared list structure
       return 0;
     } else {
+      // the hashes cover the rest of the lists, hence usually tell them
+      // apart without comparing them node by node
+      if (an->hash() != bn->hash())
+        return an->hash() < bn->hash() ? -1 : 1;
       if (int res = an->compare(*bn))
         return res;
     }
@@ -183,10 +281,8 @@ int UpdateList::compare(const UpdateList &b) const {
 }
 
 unsigned UpdateList::hash() const {
-  unsigned res = 0;
-  for (unsigned i = 0, e = root->name.size(); i != e; ++i)
-    res = (res * Expr::MAGIC_HASH_CONSTANT) + root->name[i];
+  unsigned res = root->hash();
   if (head)
-    res ^= head->hash();
+    res = Expr::combineHash(res, head->hash());
   return res;
 }
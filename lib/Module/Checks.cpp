@@ -13,6 +13,7 @@
 
 #include "KLEEIRMetaData.h"
 
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -26,6 +27,9 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Pass.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(5, 0)
+#include "llvm/Support/KnownBits.h"
+#endif
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
@@ -35,7 +39,10 @@ using namespace klee;
 char DivCheckPass::ID;
 
 bool DivCheckPass::runOnModule(Module &M) {
-  std::vector<llvm::BinaryOperator *> divInstruction;
+  const DataLayout &DL = M.getDataLayout();
+  KleeIRMetaData md(M.getContext());
+  std::vector<llvm::BinaryOperator *> unusedInstructions;
+  bool changed = false;
 
   for (auto &F : M) {
     for (auto &BB : F) {
@@ -50,48 +57,76 @@ bool DivCheckPass::runOnModule(Module &M) {
             opcode != Instruction::SRem && opcode != Instruction::URem)
           continue;
 
-        // Check if the operand is constant and not zero, skip in that case.
+        // Check if the operand is known not to be zero, skip in that case.
         const auto &operand = binOp->getOperand(1);
         if (const auto &coOp = dyn_cast<llvm::Constant>(operand)) {
           if (!coOp->isZeroValue())
             continue;
+        } else if (isKnownNonZero(operand, DL)) {
+          continue;
         }
 
-        // Check if the operand is already checked by "klee_div_zero_check"
-        if (KleeIRMetaData::hasAnnotation(I, "klee.check.div", "True"))
+        // Check if the operand is already checked
+        if (KleeIRMetaData::hasAnnotation(I, "klee.check.div", "True") ||
+            KleeIRMetaData::hasAnnotation(I, "klee.check.div", "Call"))
+          continue;
+        if (binOp->use_empty()) {
+          unusedInstructions.push_back(binOp);
           continue;
-        divInstruction.push_back(binOp);
+        }
+        md.addAnnotation(I, "klee.check.div", "True");
+        changed = true;
       }
     }
   }
 
-  // If nothing to do, return
-  if (divInstruction.empty())
-    return false;
+  if (unusedInstructions.empty())
+    return changed;
 
+  // The optimiser deletes a division whose result is unused, and its
+  // metadata with it, so those are checked by a call instead.
   LLVMContext &ctx = M.getContext();
-  KleeIRMetaData md(ctx);
   auto divZeroCheckFunction = cast<Function>(
       M.getOrInsertFunction("klee_div_zero_check", Type::getVoidTy(ctx),
                             Type::getInt64Ty(ctx) KLEE_LLVM_GOIF_TERMINATOR));
 
-  for (auto &divInst : divInstruction) {
+  for (auto &divInst : unusedInstructions) {
     llvm::IRBuilder<> Builder(divInst /* Inserts before divInst*/);
     auto denominator =
         Builder.CreateIntCast(divInst->getOperand(1), Type::getInt64Ty(ctx),
                               false, /* sign doesn't matter */
                               "int_cast_to_i64");
     Builder.CreateCall(divZeroCheckFunction, denominator);
-    md.addAnnotation(*divInst, "klee.check.div", "True");
+    md.addAnnotation(*divInst, "klee.check.div", "Call");
   }
 
   return true;
 }
 
+/// Returns whether \a shift is known to be less than \a width.
+static bool isKnownInRange(Value *shift, uint64_t width,
+                           const DataLayout &DL) {
+  unsigned bits = shift->getType()->getScalarSizeInBits();
+#if LLVM_VERSION_CODE >= LLVM_VERSION(5, 0)
+  KnownBits known(bits);
+  computeKnownBits(shift, known, DL);
+  APInt max = ~known.Zero;
+#else
+  APInt zero(bits, 0), one(bits, 0);
+  computeKnownBits(shift, zero, one, DL);
+  APInt max = ~zero;
+#endif
+  return max.ult(width);
+}
+
 char OvershiftCheckPass::ID;
 
 bool OvershiftCheckPass::runOnModule(Module &M) {
-  std::vector<llvm::BinaryOperator *> shiftInstructions;
+  const DataLayout &DL = M.getDataLayout();
+  KleeIRMetaData md(M.getContext());
+  std::vector<llvm::BinaryOperator *> unusedInstructions;
+  bool changed = false;
+
   for (auto &F : M) {
     for (auto &BB : F) {
       for (auto &I : BB) {
@@ -105,36 +140,41 @@ bool OvershiftCheckPass::runOnModule(Module &M) {
             opcode != Instruction::AShr)
           continue;
 
-        // Check if the operand is constant and not zero, skip in that case
+        // Check if the shift amount is known to be smaller than the type
+        // width, skip in that case
         auto operand = binOp->getOperand(1);
+        auto typeWidth = binOp->getOperand(0)->getType()->getScalarSizeInBits();
         if (auto coOp = dyn_cast<llvm::ConstantInt>(operand)) {
-          auto typeWidth =
-              binOp->getOperand(0)->getType()->getScalarSizeInBits();
-          // If the constant shift is positive and smaller,equal the type width,
-          // we can ignore this instruction
           if (!coOp->isNegative() && coOp->getZExtValue() < typeWidth)
             continue;
+        } else if (isKnownInRange(operand, typeWidth, DL)) {
+          continue;
         }
 
-        if (KleeIRMetaData::hasAnnotation(I, "klee.check.shift", "True"))
+        if (KleeIRMetaData::hasAnnotation(I, "klee.check.shift", "True") ||
+            KleeIRMetaData::hasAnnotation(I, "klee.check.shift", "Call"))
           continue;
-
-        shiftInstructions.push_back(binOp);
+        if (binOp->use_empty()) {
+          unusedInstructions.push_back(binOp);
+          continue;
+        }
+        md.addAnnotation(I, "klee.check.shift", "True");
+        changed = true;
       }
     }
   }
 
-  if (shiftInstructions.empty())
-    return false;
+  if (unusedInstructions.empty())
+    return changed;
 
-  // Retrieve the checker function
+  // The optimiser deletes a shift whose result is unused, and its metadata
+  // with it, so those are checked by a call instead.
   auto &ctx = M.getContext();
-  KleeIRMetaData md(ctx);
   auto overshiftCheckFunction = cast<Function>(M.getOrInsertFunction(
       "klee_overshift_check", Type::getVoidTy(ctx), Type::getInt64Ty(ctx),
       Type::getInt64Ty(ctx) KLEE_LLVM_GOIF_TERMINATOR));
 
-  for (auto &shiftInst : shiftInstructions) {
+  for (auto &shiftInst : unusedInstructions) {
     llvm::IRBuilder<> Builder(shiftInst);
 
     std::vector<llvm::Value *> args;
@@ -151,7 +191,7 @@ bool OvershiftCheckPass::runOnModule(Module &M) {
     args.push_back(shiftValue);
 
     Builder.CreateCall(overshiftCheckFunction, args);
-    md.addAnnotation(*shiftInst, "klee.check.shift", "True");
+    md.addAnnotation(*shiftInst, "klee.check.shift", "Call");
   }
 
   return true;
@@ -0,0 +1,142 @@
+//===-- DiamondFolding.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "KLEEIRMetaData.h"
+
+#include "klee/Config/Version.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+
+using namespace llvm;
+
+namespace klee {
+
+char DiamondFoldingPass::ID = 0;
+
+void DiamondFoldingPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<LoopInfoWrapperPass>();
+}
+
+/// Whether \a Side, a successor of \a Head, only computes values and falls
+/// through to another block, returned in \a Tail.
+bool DiamondFoldingPass::isFoldable(BasicBlock *Side, BasicBlock *Head,
+                                    BasicBlock *&Tail) const {
+  if (Side == Head || Side->getSinglePredecessor() != Head ||
+      Side->hasAddressTaken())
+    return false;
+  BranchInst *BI = dyn_cast<BranchInst>(Side->getTerminator());
+  if (!BI || BI->isConditional())
+    return false;
+  Tail = BI->getSuccessor(0);
+  if (Tail == Side || Tail == Head)
+    return false;
+
+  unsigned Count = 0;
+  for (Instruction &I : *Side) {
+    if (&I == BI)
+      break;
+    // the checked divisions and shifts would report errors on the paths
+    // which did not execute them
+    if (isa<PHINode>(I) || !isSafeToSpeculativelyExecute(&I) ||
+        KleeIRMetaData::hasAnnotation(I, "klee.check.div", "True") ||
+        KleeIRMetaData::hasAnnotation(I, "klee.check.shift", "True") ||
+        ++Count > MaxInstructions)
+      return false;
+  }
+  return true;
+}
+
+bool DiamondFoldingPass::fold(BasicBlock *Head, LoopInfo &LI) const {
+  BranchInst *BI = dyn_cast<BranchInst>(Head->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+  BasicBlock *True = BI->getSuccessor(0), *False = BI->getSuccessor(1);
+  if (True == False)
+    return false;
+
+  // A diamond runs one side or the other to the tail, a triangle runs its
+  // side or goes to the tail directly.
+  BasicBlock *TrueTail = nullptr, *FalseTail = nullptr, *Tail;
+  bool TrueSide = isFoldable(True, Head, TrueTail);
+  bool FalseSide = isFoldable(False, Head, FalseTail);
+  if (TrueSide && FalseSide && TrueTail == FalseTail)
+    Tail = TrueTail;
+  else if (TrueSide && TrueTail == False)
+    Tail = False, FalseSide = false;
+  else if (FalseSide && FalseTail == True)
+    Tail = True, TrueSide = false;
+  else
+    return false;
+
+  // keep the shape of the loops: the tail may not start an iteration
+  Loop *L = LI.getLoopFor(Head);
+  if (LI.isLoopHeader(Tail) || LI.getLoopFor(Tail) != L ||
+      (TrueSide && LI.getLoopFor(True) != L) ||
+      (FalseSide && LI.getLoopFor(False) != L))
+    return false;
+
+  for (BasicBlock *Side : {True, False}) {
+    if (Side == Tail)
+      continue;
+    while (&Side->front() != Side->getTerminator())
+      Side->front().moveBefore(BI);
+  }
+
+  // the values flowing in from each side are selected at the head
+  BasicBlock *TrueFrom = TrueSide ? True : Head;
+  BasicBlock *FalseFrom = FalseSide ? False : Head;
+  IRBuilder<> Builder(BI);
+  for (BasicBlock::iterator it = Tail->begin(); isa<PHINode>(*it); ++it) {
+    PHINode *PN = cast<PHINode>(&*it);
+    Value *TrueValue = PN->getIncomingValueForBlock(TrueFrom);
+    Value *FalseValue = PN->getIncomingValueForBlock(FalseFrom);
+    Value *V = TrueValue == FalseValue
+                   ? TrueValue
+                   : Builder.CreateSelect(BI->getCondition(), TrueValue,
+                                          FalseValue, PN->getName() + ".fold");
+    if (TrueSide)
+      PN->removeIncomingValue(True, /*DeletePHIIfEmpty=*/false);
+    if (FalseSide)
+      PN->removeIncomingValue(False, /*DeletePHIIfEmpty=*/false);
+    if (TrueSide && FalseSide)
+      PN->addIncoming(V, Head);
+    else
+      PN->setIncomingValue(PN->getBasicBlockIndex(Head), V);
+  }
+
+  BranchInst::Create(Tail, BI);
+  BI->eraseFromParent();
+  for (BasicBlock *Side : {True, False}) {
+    if (Side == Tail)
+      continue;
+    LI.removeBlock(Side);
+    Side->eraseFromParent();
+  }
+  return true;
+}
+
+bool DiamondFoldingPass::runOnFunction(Function &F) {
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  bool Changed = false;
+  // folding an inner branch may make the branch around it foldable
+  for (bool Folded = true; Folded; Changed |= Folded) {
+    Folded = false;
+    for (BasicBlock &BB : F)
+      Folded |= fold(&BB, LI);
+  }
+  return Changed;
+}
+} // namespace klee
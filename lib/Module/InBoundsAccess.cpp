@@ -0,0 +1,100 @@
+//===-- InBoundsAccess.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "KLEEIRMetaData.h"
+
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+using namespace llvm;
+
+namespace klee {
+
+char InBoundsAccessPass::ID = 0;
+
+void InBoundsAccessPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<ScalarEvolutionWrapperPass>();
+  AU.setPreservesAll();
+}
+
+bool InBoundsAccessPass::isProvedInBounds(const Instruction &I) {
+  return KleeIRMetaData::hasAnnotation(I, "klee.inbounds", "True");
+}
+
+/// Returns the size of the object KLEE allocates for \a base, if it only
+/// allocates one of a fixed size, or 0.
+static uint64_t getObjectSize(const Value *base, const DataLayout &DL) {
+  if (const AllocaInst *ai = dyn_cast<AllocaInst>(base)) {
+    uint64_t size = DL.getTypeStoreSize(ai->getAllocatedType());
+    if (!ai->isArrayAllocation())
+      return size;
+    if (const ConstantInt *count = dyn_cast<ConstantInt>(ai->getArraySize()))
+      return size * count->getZExtValue();
+    return 0;
+  }
+  if (const GlobalVariable *gv = dyn_cast<GlobalVariable>(base)) {
+    // a declaration may be defined with a different size elsewhere
+    if (gv->isDeclaration())
+      return 0;
+    return DL.getTypeStoreSize(gv->getValueType());
+  }
+  return 0;
+}
+
+bool InBoundsAccessPass::runOnFunction(Function &F) {
+  ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+  KleeIRMetaData md(F.getContext());
+  bool changed = false;
+
+  for (inst_iterator it = inst_begin(F), ie = inst_end(F); it != ie; ++it) {
+    Value *pointer;
+    Type *type;
+    if (LoadInst *li = dyn_cast<LoadInst>(&*it)) {
+      pointer = li->getPointerOperand();
+      type = li->getType();
+    } else if (StoreInst *si = dyn_cast<StoreInst>(&*it)) {
+      pointer = si->getPointerOperand();
+      type = si->getValueOperand()->getType();
+    } else {
+      continue;
+    }
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(12, 0)
+    const Value *base = getUnderlyingObject(pointer);
+#else
+    const Value *base = GetUnderlyingObject(pointer, DataLayout);
+#endif
+    uint64_t size = getObjectSize(base, DataLayout);
+    uint64_t bytes = DataLayout.getTypeStoreSize(type);
+    if (!size || bytes > size || !SE.isSCEVable(pointer->getType()))
+      continue;
+
+    // The offset from the base, over all the values the indices take, as
+    // bounded by the loops and the masks and extensions applied to them.
+    const SCEV *offset = SE.getMinusSCEV(SE.getSCEV(pointer),
+                                         SE.getSCEV(const_cast<Value *>(base)));
+    if (isa<SCEVCouldNotCompute>(offset))
+      continue;
+    ConstantRange range = SE.getSignedRange(offset);
+    if (range.isFullSet() || range.getSignedMin().isNegative() ||
+        range.getSignedMax().ugt(size - bytes))
+      continue;
+
+    md.addAnnotation(*it, "klee.inbounds", "True");
+    changed = true;
+  }
+  return changed;
+}
+}
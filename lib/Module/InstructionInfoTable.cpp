@@ -27,60 +27,31 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cstdint>
-#include <map>
 #include <string>
 
 using namespace klee;
 
+/// Records the assembly line of every instruction and function as the
+/// module is printed.
 class InstructionToLineAnnotator : public llvm::AssemblyAnnotationWriter {
+  std::unordered_map<uintptr_t, uint64_t> &lines;
+
 public:
+  explicit InstructionToLineAnnotator(
+      std::unordered_map<uintptr_t, uint64_t> &_lines)
+      : lines(_lines) {}
+
   void emitInstructionAnnot(const llvm::Instruction *i,
                             llvm::formatted_raw_ostream &os) {
-    os << "%%%";
-    os << reinterpret_cast<std::uintptr_t>(i);
+    lines[reinterpret_cast<std::uintptr_t>(i)] = os.getLine() + 1;
   }
 
   void emitFunctionAnnot(const llvm::Function *f,
                          llvm::formatted_raw_ostream &os) {
-    os << "%%%";
-    os << reinterpret_cast<std::uintptr_t>(f);
+    lines[reinterpret_cast<std::uintptr_t>(f)] = os.getLine() + 1;
   }
 };
 
-static std::map<uintptr_t, uint64_t>
-buildInstructionToLineMap(const llvm::Module &m) {
-
-  std::map<uintptr_t, uint64_t> mapping;
-  InstructionToLineAnnotator a;
-  std::string str;
-
-  llvm::raw_string_ostream os(str);
-  m.print(os, &a);
-  os.flush();
-
-  const char *s;
-
-  unsigned line = 1;
-  for (s=str.c_str(); *s; s++) {
-    if (*s != '\n')
-      continue;
-
-    line++;
-    if (s[1] != '%' || s[2] != '%' || s[3] != '%')
-      continue;
-
-    s += 4;
-    char *end;
-    uint64_t value = strtoull(s, &end, 10);
-    if (end != s) {
-      mapping.insert(std::make_pair(value, line));
-    }
-    s = end;
-  }
-
-  return mapping;
-}
-
 static std::string getFullPath(llvm::StringRef Directory,
                                llvm::StringRef FileName) {
   llvm::SmallString<128> file_pathname(Directory);
@@ -90,35 +61,20 @@ static std::string getFullPath(llvm::StringRef Directory,
 }
 
 class DebugInfoExtractor {
-  std::vector<std::unique_ptr<std::string>> &internedStrings;
-  std::map<uintptr_t, uint64_t> lineTable;
-
-  const llvm::Module &module;
+  std::unordered_set<std::string> &internedStrings;
+  const std::unordered_map<uintptr_t, uint64_t> &lineTable;
 
 public:
   DebugInfoExtractor(
-      std::vector<std::unique_ptr<std::string>> &_internedStrings,
-      const llvm::Module &_module)
-      : internedStrings(_internedStrings), module(_module) {
-    lineTable = buildInstructionToLineMap(module);
-  }
-
-  std::string &getInternedString(const std::string &s) {
-    auto found = std::find_if(internedStrings.begin(), internedStrings.end(),
-                              [&s](const std::unique_ptr<std::string> &item) {
-                                return *item.get() == s;
-                              });
-    if (found != internedStrings.end())
-      return *found->get();
+      std::unordered_set<std::string> &_internedStrings,
+      const std::unordered_map<uintptr_t, uint64_t> &_lineTable)
+      : internedStrings(_internedStrings), lineTable(_lineTable) {}
 
-    auto newItem = std::unique_ptr<std::string>(new std::string(s));
-    auto result = newItem.get();
-
-    internedStrings.emplace_back(std::move(newItem));
-    return *result;
+  const std::string &getInternedString(const std::string &s) {
+    return *internedStrings.insert(s).first;
   }
 
-  std::unique_ptr<FunctionInfo> getFunctionInfo(const llvm::Function &Func) {
+  FunctionInfo getFunctionInfo(const llvm::Function &Func) {
     auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Func));
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
     auto dsub = Func.getSubprogram();
@@ -127,17 +83,16 @@ public:
 #endif
     if (dsub != nullptr) {
       auto path = getFullPath(dsub->getDirectory(), dsub->getFilename());
-      return std::unique_ptr<FunctionInfo>(new FunctionInfo(
-          0, getInternedString(path), dsub->getLine(), asmLine));
+      return FunctionInfo(0, getInternedString(path), dsub->getLine(),
+                          asmLine);
     }
 
     // Fallback: Mark as unknown
-    return std::unique_ptr<FunctionInfo>(
-        new FunctionInfo(0, getInternedString(""), 0, asmLine));
+    return FunctionInfo(0, getInternedString(""), 0, asmLine);
   }
 
-  std::unique_ptr<InstructionInfo>
-  getInstructionInfo(const llvm::Instruction &Inst, const FunctionInfo *f) {
+  InstructionInfo getInstructionInfo(const llvm::Instruction &Inst,
+                                     const FunctionInfo *f) {
     auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Inst));
 
     // Retrieve debug information associated with instruction
@@ -158,62 +113,80 @@ public:
           column = LexicalBlock->getColumn();
         }
       }
-      return std::unique_ptr<InstructionInfo>(new InstructionInfo(
-          0, getInternedString(full_path), line, column, asmLine));
+      return InstructionInfo(0, getInternedString(full_path), line, column,
+                             asmLine);
     }
 
     if (f != nullptr)
       // If nothing found, use the surrounding function
-      return std::unique_ptr<InstructionInfo>(
-          new InstructionInfo(0, f->file, f->line, 0, asmLine));
+      return InstructionInfo(0, f->file, f->line, 0, asmLine);
     // If nothing found, use the surrounding function
-    return std::unique_ptr<InstructionInfo>(
-        new InstructionInfo(0, getInternedString(""), 0, 0, asmLine));
+    return InstructionInfo(0, getInternedString(""), 0, 0, asmLine);
   }
 };
 
-InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
-  // Generate all debug instruction information
-  DebugInfoExtractor DI(internedStrings, m);
+InstructionInfoTable::InstructionInfoTable(const llvm::Module &m)
+    : module(m), maxID(0) {
+  // Every item gets a unique ID below maxID, whenever it is extracted
   for (const auto &Func : m) {
-    auto F = DI.getFunctionInfo(Func);
-    auto FR = F.get();
-    functionInfos.insert(std::make_pair(&Func, std::move(F)));
-
-    for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
-         ++it) {
-      auto instr = &*it;
-      infos.insert(std::make_pair(instr, DI.getInstructionInfo(*instr, FR)));
-    }
+    ++maxID;
+    for (const auto &BB : Func)
+      maxID += BB.size();
   }
+}
 
-  // Make sure that every item has a unique ID
-  size_t idCounter = 0;
-  for (auto &item : infos)
-    item.second->id = idCounter++;
-  for (auto &item : functionInfos)
-    item.second->id = idCounter++;
+void InstructionInfoTable::printAssembly(llvm::raw_ostream &os) const {
+  InstructionToLineAnnotator a(lineTable);
+  module.print(os, &a);
 }
 
-unsigned InstructionInfoTable::getMaxID() const {
-  return infos.size() + functionInfos.size();
+void InstructionInfoTable::addFunction(const llvm::Function &Func) const {
+  if (lineTable.empty()) {
+    llvm::raw_null_ostream os;
+    printAssembly(os);
+  }
+
+  DebugInfoExtractor DI(internedStrings, lineTable);
+  auto F = functionInfos.emplace(&Func, DI.getFunctionInfo(Func)).first;
+  FunctionInfo &FR = F->second;
+  FR.id = nextID++;
+
+  for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
+       ++it) {
+    auto instr = &*it;
+    auto I = infos.emplace(instr, DI.getInstructionInfo(*instr, &FR)).first;
+    I->second.id = nextID++;
+  }
 }
 
+unsigned InstructionInfoTable::getMaxID() const { return maxID; }
+
 const InstructionInfo &
 InstructionInfoTable::getInfo(const llvm::Instruction &inst) const {
   auto it = infos.find(&inst);
+  if (it == infos.end()) {
+    const llvm::Function *f = inst.getParent()->getParent();
+    if (f->getParent() == &module && !functionInfos.count(f)) {
+      addFunction(*f);
+      it = infos.find(&inst);
+    }
+  }
   if (it == infos.end())
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
-  return *it->second.get();
+  return it->second;
 }
 
 const FunctionInfo &
 InstructionInfoTable::getFunctionInfo(const llvm::Function &f) const {
   auto found = functionInfos.find(&f);
+  if (found == functionInfos.end() && f.getParent() == &module) {
+    addFunction(f);
+    found = functionInfos.find(&f);
+  }
   if (found == functionInfos.end())
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
 
-  return *found->second.get();
+  return found->second;
 }
@@ -8,6 +8,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Internal/Module/KInstruction.h"
+
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+#include <map>
 #include <string>
 
 using namespace llvm;
@@ -25,3 +30,66 @@ std::string KInstruction::getSourceLocation() const {
            std::to_string(info->column);
   else return "[no debug info]";
 }
+
+/***/
+
+void KSwitchInstruction::initialize(SwitchInst *si) {
+  BasicBlock *defaultDest = si->getDefaultDest();
+  std::map<BasicBlock *, unsigned> targetIndex;
+  std::vector<std::pair<APInt, unsigned> > values;
+  for (auto c : si->cases()) {
+    BasicBlock *successor = c.getCaseSuccessor();
+    // the default condition covers the cases leading to it
+    if (successor == defaultDest)
+      continue;
+    auto it = targetIndex.insert(std::make_pair(successor, targets.size()));
+    if (it.second)
+      targets.push_back(successor);
+    values.push_back(std::make_pair(c.getCaseValue()->getValue(),
+                                    it.first->second));
+  }
+  targets.push_back(defaultDest);
+
+  std::sort(values.begin(), values.end(),
+            [](const std::pair<APInt, unsigned> &a,
+               const std::pair<APInt, unsigned> &b) {
+              return a.first.ult(b.first);
+            });
+  for (auto const &v : values) {
+    if (!ranges.empty() && ranges.back().target == v.second &&
+        !ranges.back().high.isMaxValue() && ranges.back().high + 1 == v.first)
+      ranges.back().high = v.first;
+    else
+      ranges.push_back(CaseRange{v.first, v.first, v.second});
+  }
+
+  // a dense table, for the values no more spread out than a few entries
+  // per case
+  tableBase = 0;
+  if (ranges.empty() || ranges.front().low.getBitWidth() > 64)
+    return;
+  uint64_t low = ranges.front().low.getZExtValue();
+  uint64_t span = ranges.back().high.getZExtValue() - low;
+  if (span >= std::max<uint64_t>(64, 4 * values.size()))
+    return;
+  tableBase = low;
+  table.assign(span + 1, targets.size() - 1);
+  for (const CaseRange &r : ranges)
+    std::fill(table.begin() + (r.low.getZExtValue() - low),
+              table.begin() + (r.high.getZExtValue() - low) + 1, r.target);
+}
+
+unsigned KSwitchInstruction::getTarget(const APInt &value) const {
+  unsigned defaultTarget = targets.size() - 1;
+  if (!table.empty()) {
+    uint64_t index = value.getZExtValue() - tableBase;
+    return index < table.size() ? table[index] : defaultTarget;
+  }
+  // the first range ending at or above the value
+  auto it = std::lower_bound(
+      ranges.begin(), ranges.end(), value,
+      [](const CaseRange &r, const APInt &v) { return r.high.ult(v); });
+  if (it == ranges.end() || value.ult(it->low))
+    return defaultTarget;
+  return it->target;
+}
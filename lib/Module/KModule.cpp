@@ -11,6 +11,8 @@
 
 #include "Passes.h"
 
+#include "KLEEIRMetaData.h"
+
 #include "klee/Config/Version.h"
 #include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
@@ -18,6 +20,7 @@
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Interpreter.h"
 #include "klee/OptionCategories.h"
@@ -27,10 +30,13 @@
 #else
 #include "llvm/Bitcode/ReaderWriter.h"
 #endif
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -38,6 +44,8 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
@@ -50,8 +58,12 @@
 #include "llvm/Transforms/Utils.h"
 #endif
 
+#include <algorithm>
+#include <queue>
 #include <sstream>
 
+#include <unistd.h>
+
 using namespace llvm;
 using namespace klee;
 
@@ -108,6 +120,23 @@ namespace {
                              cl::desc("Allow optimization of functions that "
                                       "contain KLEE calls (default=true)"),
                              cl::init(true), cl::cat(ModuleCat));
+
+  cl::opt<bool> ProveInBounds(
+      "prove-in-bounds", cl::init(false),
+      cl::desc("Skip the bounds checks of the loads and stores which "
+               "ScalarEvolution proves in bounds of a stack or global "
+               "object, assuming that the indices do not overflow where the "
+               "IR says so (default=false)"),
+      cl::cat(ModuleCat));
+
+  cl::opt<unsigned> AutoMergeMaxBlocks(
+      "auto-merge-max-blocks", cl::init(0),
+      cl::desc("Merge the states forked in acyclic single-entry single-exit "
+               "regions of at most this many blocks without calls, as if "
+               "they were enclosed by klee_open_merge() and "
+               "klee_close_merge(). Requires --use-merge. Set to 0 to "
+               "disable (default=0)"),
+      cl::cat(MergeCat));
 }
 
 /***/
@@ -205,6 +234,15 @@ void KModule::addInternalFunction(const char* functionName){
   internalFunctions.insert(internalFunction);
 }
 
+void KModule::addInternalFunctions(const Interpreter::ModuleOptions &opts) {
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
+}
+
 bool KModule::link(std::vector<std::unique_ptr<llvm::Module>> &modules,
                    const std::string &entryPoint) {
   auto numRemainingModules = modules.size();
@@ -247,6 +285,90 @@ void KModule::instrument(const Interpreter::ModuleOptions &opts) {
   pm.run(*module);
 }
 
+std::string KModule::getPreparedPath(
+    const std::vector<std::unique_ptr<llvm::Module>> &modules,
+    const Interpreter::ModuleOptions &opts) {
+  MD5 hash;
+  for (const auto &m : modules) {
+    SmallString<0> bitcode;
+    raw_svector_ostream os(bitcode);
+#if LLVM_VERSION_CODE >= LLVM_VERSION(7, 0)
+    WriteBitcodeToFile(*m, os);
+#else
+    WriteBitcodeToFile(m.get(), os);
+#endif
+    hash.update(StringRef(bitcode.data(), bitcode.size()));
+  }
+  hash.update(opts.EntryPoint);
+  for (const std::string &name : opts.ExtraEntryPoints) {
+    hash.update(StringRef("\0", 1));
+    hash.update(name);
+  }
+  const char flags[] = {opts.Optimize, opts.CheckDivZero, opts.CheckOvershift};
+  hash.update(StringRef(flags, sizeof(flags)));
+  hash.update(opts.CacheSalt);
+
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> name;
+  MD5::stringifyResult(result, name);
+  name += ".bc";
+
+  SmallString<128> path(opts.CacheDir);
+  sys::path::append(path, name);
+  return path.str().str();
+}
+
+bool KModule::loadPrepared(const std::string &path, LLVMContext &ctx,
+                           const Interpreter::ModuleOptions &opts) {
+  if (!sys::fs::exists(path))
+    return false;
+
+  std::vector<std::unique_ptr<llvm::Module>> loaded;
+  std::string error;
+  if (!klee::loadFile(path, ctx, loaded, error) || loaded.size() != 1) {
+    klee_warning("Ignoring prepared module %s: %s", path.c_str(),
+                 error.c_str());
+    return false;
+  }
+  module = std::move(loaded.front());
+  targetData = std::unique_ptr<llvm::DataLayout>(new DataLayout(module.get()));
+  addInternalFunctions(opts);
+  return true;
+}
+
+void KModule::storePrepared(const std::string &path) {
+  SmallString<128> dir(path);
+  sys::path::remove_filename(dir);
+  if (std::error_code ec = sys::fs::create_directories(dir)) {
+    klee_warning("Could not create %s: %s", dir.c_str(),
+                 ec.message().c_str());
+    return;
+  }
+
+  // Written aside and renamed, so that concurrent runs never load a
+  // partially written module.
+  std::string tmp = path + ".tmp" + std::to_string(getpid());
+  std::string error;
+  {
+    std::unique_ptr<llvm::raw_fd_ostream> os =
+        klee_open_output_file(tmp, error);
+    if (!os) {
+      klee_warning("Could not keep prepared module: %s", error.c_str());
+      return;
+    }
+#if LLVM_VERSION_CODE >= LLVM_VERSION(7, 0)
+    WriteBitcodeToFile(*module, *os);
+#else
+    WriteBitcodeToFile(module.get(), *os);
+#endif
+  }
+  if (std::error_code ec = sys::fs::rename(tmp, path)) {
+    klee_warning("Could not keep prepared module: %s", ec.message().c_str());
+    sys::fs::remove(tmp);
+  }
+}
+
 void KModule::optimiseAndPrepare(
     const Interpreter::ModuleOptions &opts,
     llvm::ArrayRef<const char *> preservedFunctions) {
@@ -261,12 +383,7 @@ void KModule::optimiseAndPrepare(
   if (opts.Optimize)
     Optimize(module.get(), preservedFunctions);
 
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
+  addInternalFunctions(opts);
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
@@ -286,16 +403,25 @@ void KModule::optimiseAndPrepare(
   default: klee_error("invalid --switch-type");
   }
   pm3.add(new IntrinsicCleanerPass(*targetData));
+  // mark the divisions and shifts the optimiser rewrote without metadata
+  if (opts.CheckDivZero) pm3.add(new DivCheckPass());
+  if (opts.CheckOvershift) pm3.add(new OvershiftCheckPass());
   pm3.add(new PhiCleanerPass());
   pm3.add(new FunctionAliasPass());
+  if (ProveInBounds)
+    pm3.add(new InBoundsAccessPass(*targetData));
   pm3.run(*module);
 }
 
-void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
+void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput,
+                       bool lazyFunctions) {
+  infos = std::unique_ptr<InstructionInfoTable>(
+      new InstructionInfoTable(*module.get()));
+
   if (OutputSource || forceSourceOutput) {
     std::unique_ptr<llvm::raw_fd_ostream> os(ih->openOutputFile("assembly.ll"));
     assert(os && !os->has_error() && "unable to open source output");
-    *os << *module;
+    infos->printAssembly(*os);
   }
 
   if (OutputModule) {
@@ -309,38 +435,18 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
 
   /* Build shadow structures */
 
-  infos = std::unique_ptr<InstructionInfoTable>(
-      new InstructionInfoTable(*module.get()));
-
-  std::vector<Function *> declarations;
-
-  for (auto &Function : *module) {
-    if (Function.isDeclaration()) {
-      declarations.push_back(&Function);
-      continue;
+  if (!lazyFunctions) {
+    for (auto &Function : *module) {
+      if (!Function.isDeclaration())
+        manifestFunction(&Function);
     }
-
-    auto kf = std::unique_ptr<KFunction>(new KFunction(&Function, this));
-
-    for (unsigned i=0; i<kf->numInstructions; ++i) {
-      KInstruction *ki = kf->instructions[i];
-      ki->info = &infos->getInfo(*ki->inst);
-    }
-
-    functionMap.insert(std::make_pair(&Function, kf.get()));
-    functions.push_back(std::move(kf));
   }
 
   /* Compute various interesting properties */
 
-  for (auto &kf : functions) {
-    if (functionEscapes(kf->function))
-      escapingFunctions.insert(kf->function);
-  }
-
-  for (auto &declaration : declarations) {
-    if (functionEscapes(declaration))
-      escapingFunctions.insert(declaration);
+  for (auto &Function : *module) {
+    if (functionEscapes(&Function))
+      escapingFunctions.insert(&Function);
   }
 
   if (DebugPrintEscapingFunctions && !escapingFunctions.empty()) {
@@ -372,6 +478,176 @@ void KModule::checkModule() {
   }
 }
 
+namespace {
+/// The instructions which may be executed right after \a i.
+void getSuccessors(Instruction &i, std::vector<Instruction *> &succs) {
+  succs.clear();
+  BasicBlock *bb = i.getParent();
+  if (&i != bb->getTerminator()) {
+    succs.push_back(&*(++i.getIterator()));
+    return;
+  }
+  for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it)
+    succs.push_back(&*(it->begin()));
+}
+
+/// The functions \a i may call, all escaping functions if it calls through
+/// a pointer.
+void getCallTargets(Instruction &i, const std::set<Function *> &escaping,
+                    std::vector<Function *> &targets) {
+  targets.clear();
+  CallSite cs(&i);
+  if (isa<InlineAsm>(cs.getCalledValue()))
+    return;
+  if (Function *f = getDirectCallTarget(cs, /*moduleIsFullyLinked=*/true))
+    targets.push_back(f);
+  else
+    targets.assign(escaping.begin(), escaping.end());
+}
+}
+
+bool KModule::setTargets(const std::vector<std::string> &targets,
+                         std::string &error) {
+  std::vector<std::pair<std::string, unsigned> > locations;
+  for (const std::string &target : targets) {
+    auto colon = target.rfind(':');
+    unsigned line;
+    if (colon == std::string::npos ||
+        StringRef(target).substr(colon + 1).getAsInteger(10, line)) {
+      error = "invalid target " + target + ", expected file:line";
+      return false;
+    }
+    locations.push_back(std::make_pair(target.substr(0, colon), line));
+  }
+
+  unsigned numIds = infos->getMaxID();
+  std::vector<bool> found(locations.size());
+  std::vector<unsigned> targetIds;
+  for (Function &f : *module) {
+    for (BasicBlock &bb : f) {
+      for (Instruction &i : bb) {
+        const InstructionInfo &info = infos->getInfo(i);
+        for (unsigned k = 0; k != locations.size(); ++k) {
+          const std::string &file = locations[k].first;
+          if (info.line != locations[k].second ||
+              info.file.size() < file.size() ||
+              info.file.compare(info.file.size() - file.size(), file.size(),
+                                file) ||
+              (info.file.size() > file.size() &&
+               info.file[info.file.size() - file.size() - 1] != '/'))
+            continue;
+          found[k] = true;
+          targetIds.push_back(info.id);
+        }
+      }
+    }
+  }
+  for (unsigned k = 0; k != locations.size(); ++k) {
+    if (!found[k]) {
+      error = "no instructions at target " + targets[k];
+      return false;
+    }
+  }
+
+  // The distances to the returns go through the shortest paths of the
+  // callees to theirs, so they are iterated to a fixed point.
+  std::vector<Instruction *> instructions;
+  for (Function &f : *module)
+    for (BasicBlock &bb : f)
+      for (Instruction &i : bb)
+        instructions.push_back(&i);
+  std::reverse(instructions.begin(), instructions.end());
+
+  auto getEntryId = [this](Function *f) {
+    return infos->getInfo(*f->begin()->begin()).id;
+  };
+  std::vector<Instruction *> succs;
+  std::vector<Function *> callees;
+  // the length of the shortest path through i to its successors
+  auto getThrough = [&](Instruction &i) -> std::uint64_t {
+    if (!isa<CallInst>(i) && !isa<InvokeInst>(i))
+      return 1;
+    std::uint64_t through = 0;
+    getCallTargets(i, escapingFunctions, callees);
+    for (Function *f : callees) {
+      std::uint64_t dist = f->isDeclaration() ? !f->doesNotReturn()
+                                              : returnDistances[getEntryId(f)];
+      if (dist && (!through || 1 + dist < through))
+        through = 1 + dist;
+    }
+    return through;
+  };
+
+  returnDistances.assign(numIds, 0);
+  bool changed;
+  do {
+    changed = false;
+    for (Instruction *i : instructions) {
+      unsigned id = infos->getInfo(*i).id;
+      std::uint64_t best = isa<ReturnInst>(i) ? 1 : returnDistances[id];
+      std::uint64_t through = isa<ReturnInst>(i) ? 0 : getThrough(*i);
+      if (through) {
+        getSuccessors(*i, succs);
+        for (Instruction *succ : succs) {
+          std::uint64_t dist = returnDistances[infos->getInfo(*succ).id];
+          if (dist && (!best || through + dist < best))
+            best = through + dist;
+        }
+      }
+      if (best != returnDistances[id]) {
+        returnDistances[id] = best;
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  // The distances to the targets, found backwards from them over the
+  // edges to the successors and into the callees.
+  struct Edge {
+    unsigned id;
+    std::uint64_t weight;
+  };
+  std::vector<std::vector<Edge> > preds(numIds);
+  for (Instruction *i : instructions) {
+    unsigned id = infos->getInfo(*i).id;
+    if (std::uint64_t through = getThrough(*i)) {
+      getSuccessors(*i, succs);
+      for (Instruction *succ : succs)
+        preds[infos->getInfo(*succ).id].push_back({id, through});
+    }
+    if (isa<CallInst>(i) || isa<InvokeInst>(i)) {
+      getCallTargets(*i, escapingFunctions, callees);
+      for (Function *f : callees)
+        if (!f->isDeclaration())
+          preds[getEntryId(f)].push_back({id, 1});
+    }
+  }
+
+  typedef std::pair<std::uint64_t, unsigned> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry> >
+      queue;
+  targetDistances.assign(numIds, 0);
+  for (unsigned id : targetIds) {
+    targetDistances[id] = 1;
+    queue.push(std::make_pair(1, id));
+  }
+  while (!queue.empty()) {
+    QueueEntry top = queue.top();
+    queue.pop();
+    if (top.first != targetDistances[top.second])
+      continue;
+    for (const Edge &e : preds[top.second]) {
+      std::uint64_t dist = top.first + e.weight;
+      if (!targetDistances[e.id] || dist < targetDistances[e.id]) {
+        targetDistances[e.id] = dist;
+        queue.push(std::make_pair(dist, e.id));
+      }
+    }
+  }
+  return true;
+}
+
 KConstant* KModule::getKConstant(const Constant *c) {
   auto it = constantMap.find(c);
   if (it != constantMap.end())
@@ -379,6 +655,22 @@ KConstant* KModule::getKConstant(const Constant *c) {
   return NULL;
 }
 
+KFunction *KModule::manifestFunction(llvm::Function *f) {
+  assert(!f->isDeclaration() && !functionMap.count(f) &&
+         "function cannot be manifested");
+  auto kf = std::unique_ptr<KFunction>(new KFunction(f, this));
+
+  for (unsigned i=0; i<kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    ki->info = &infos->getInfo(*ki->inst);
+  }
+
+  KFunction *result = kf.get();
+  functionMap.insert(std::make_pair(f, result));
+  functions.push_back(std::move(kf));
+  return result;
+}
+
 unsigned KModule::getConstantID(Constant *c, KInstruction* ki) {
   if (KConstant *kc = getKConstant(c))
     return kc->id;  
@@ -456,6 +748,12 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Switch: {
+        KSwitchInstruction *ksi = new KSwitchInstruction();
+        ksi->initialize(cast<SwitchInst>(&*it));
+        ki = ksi;
+        break;
+      }
       default:
         ki = new KInstruction(); break;
       }
@@ -463,6 +761,15 @@ KFunction::KFunction(llvm::Function *_function,
       Instruction *inst = &*it;
       ki->inst = inst;
       ki->dest = registerMap[inst];
+      ki->opcode = inst->getOpcode();
+      ki->width = inst->getType()->isSized()
+                      ? km->targetData->getTypeSizeInBits(inst->getType())
+                      : 0;
+      ki->provedInBounds = InBoundsAccessPass::isProvedInBounds(*inst);
+      ki->checkDivZero =
+          KleeIRMetaData::hasAnnotation(*inst, "klee.check.div", "True");
+      ki->checkOvershift =
+          KleeIRMetaData::hasAnnotation(*inst, "klee.check.shift", "True");
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(inst);
@@ -486,6 +793,159 @@ KFunction::KFunction(llvm::Function *_function,
       instructions[i++] = ki;
     }
   }
+
+  if (AutoMergeMaxBlocks)
+    findMergeRegions(AutoMergeMaxBlocks);
+}
+
+/// Collects the blocks between the branch ending \a entry and its immediate
+/// post-dominator \a exit into \a region. Returns false unless they form an
+/// acyclic region of at most \a maxBlocks blocks without calls, entered only
+/// through \a entry.
+static bool collectMergeRegion(BasicBlock *entry, BasicBlock *exit,
+                               unsigned maxBlocks,
+                               std::set<BasicBlock *> &region) {
+  std::vector<BasicBlock *> worklist(succ_begin(entry), succ_end(entry));
+  while (!worklist.empty()) {
+    BasicBlock *bb = worklist.back();
+    worklist.pop_back();
+    if (bb == exit || region.count(bb))
+      continue;
+    if (bb == entry || region.size() == maxBlocks)
+      return false;
+    region.insert(bb);
+    for (Instruction &inst : *bb)
+      if ((isa<CallInst>(inst) && !isa<IntrinsicInst>(inst)) ||
+          isa<InvokeInst>(inst))
+        return false;
+    worklist.insert(worklist.end(), succ_begin(bb), succ_end(bb));
+  }
+
+  // Single entry, and acyclic: peel off the blocks whose predecessors are
+  // all peeled off already, starting from the entry.
+  std::map<BasicBlock *, unsigned> pending;
+  for (BasicBlock *bb : region) {
+    for (pred_iterator it = pred_begin(bb), ie = pred_end(bb); it != ie; ++it)
+      if (*it != entry && !region.count(*it))
+        return false;
+    pending[bb] = std::distance(pred_begin(bb), pred_end(bb));
+  }
+  std::vector<BasicBlock *> ready(1, entry);
+  size_t peeled = 0;
+  while (!ready.empty()) {
+    BasicBlock *bb = ready.back();
+    ready.pop_back();
+    for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it) {
+      auto p = pending.find(*it);
+      if (p != pending.end() && --p->second == 0) {
+        ready.push_back(*it);
+        ++peeled;
+      }
+    }
+  }
+  return peeled == region.size();
+}
+
+void KFunction::findMergeRegions(unsigned maxBlocks) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
+  PostDominatorTree pdt;
+#else
+  DominatorTreeBase<BasicBlock> pdt(true);
+#endif
+  pdt.recalculate(*function);
+
+  std::map<BasicBlock *, std::pair<BasicBlock *, std::set<BasicBlock *> > >
+      candidates;
+  for (BasicBlock &bb : *function) {
+    BranchInst *bi = dyn_cast<BranchInst>(bb.getTerminator());
+    if (!bi || bi->isUnconditional())
+      continue;
+    DomTreeNodeBase<BasicBlock> *node = pdt.getNode(&bb);
+    if (!node || !node->getIDom() || !node->getIDom()->getBlock())
+      continue;
+    BasicBlock *exit = node->getIDom()->getBlock();
+    std::set<BasicBlock *> region;
+    if (collectMergeRegion(&bb, exit, maxBlocks, region))
+      candidates[&bb] = std::make_pair(exit, region);
+  }
+
+  // Such regions are either nested or disjoint, keep the outermost.
+  for (auto &c : candidates) {
+    bool nested = false;
+    for (auto &other : candidates)
+      if (other.second.second.count(c.first))
+        nested = true;
+    if (nested)
+      continue;
+    BasicBlock *exit = c.second.first;
+    unsigned close = basicBlockEntry[exit] +
+                     std::distance(exit->begin(),
+                                   BasicBlock::iterator(exit->getFirstNonPHI()));
+    mergeRegions[c.first] = instructions[close];
+  }
+}
+
+/// Returns the number of entries of the operands of \a ki.
+static unsigned getNumOperands(const KInstruction *ki) {
+  if (isa<CallInst>(ki->inst) || isa<InvokeInst>(ki->inst))
+    return CallSite(ki->inst).arg_size() + 1;
+  return ki->inst->getNumOperands();
+}
+
+/// Updates \a live from after \a ki to before it.
+static void stepLiveness(const KInstruction *ki, BitVector &live) {
+  live.reset(ki->dest);
+  for (unsigned j = 0, e = getNumOperands(ki); j != e; ++j)
+    if (ki->operands[j] >= 0)
+      live.set(ki->operands[j]);
+}
+
+void KFunction::computeLiveness() {
+  // the registers read before being written in each block, and written
+  std::map<BasicBlock *, std::pair<BitVector, BitVector> > useDef;
+  for (BasicBlock &bb : *function) {
+    BitVector &use = useDef[&bb].first, &def = useDef[&bb].second;
+    use.resize(numRegisters);
+    def.resize(numRegisters);
+    unsigned end = basicBlockEntry[&bb] + bb.size();
+    for (unsigned i = end; i-- != basicBlockEntry[&bb];) {
+      stepLiveness(instructions[i], use);
+      def.set(instructions[i]->dest);
+    }
+    liveOut[&bb].resize(numRegisters);
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (BasicBlock &block : *function) {
+      BasicBlock *bb = &block;
+      BitVector out(numRegisters);
+      for (BasicBlock *succ : successors(bb)) {
+        BitVector in = liveOut[succ];
+        in.reset(useDef[succ].second);
+        in |= useDef[succ].first;
+        out |= in;
+      }
+      if (out != liveOut[bb]) {
+        liveOut[bb] = out;
+        changed = true;
+      }
+    }
+  }
+}
+
+void KFunction::getLiveRegisters(const KInstruction *ki, BitVector &live) {
+  if (liveOut.empty())
+    computeLiveness();
+
+  BasicBlock *bb = ki->inst->getParent();
+  live = liveOut[bb];
+  unsigned i = basicBlockEntry[bb] + bb->size();
+  do
+    stepLiveness(instructions[--i], live);
+  while (instructions[i] != ki);
+  live.set(ki->dest);
 }
 
 KFunction::~KFunction() {
@@ -18,9 +18,7 @@
 #include "klee/Config/Version.h"
 #include "klee/OptionCategories.h"
 
-#ifdef USE_WORKAROUND_LLVM_PR39177
 #include "Passes.h"
-#endif
 
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/Passes.h"
@@ -53,6 +51,37 @@ static cl::opt<bool>
                   cl::desc("Do not run the inliner pass (default=false)"),
                   cl::init(false), cl::cat(klee::ModuleCat));
 
+namespace {
+enum class OptimizePipeline { Standard, Symbolic };
+}
+
+static cl::opt<OptimizePipeline> Pipeline(
+    "optimize-pipeline",
+    cl::desc("The passes --optimize runs (default=standard)"),
+    cl::values(clEnumValN(OptimizePipeline::Standard, "standard",
+                          "The pipeline of opt -O2, tuned for native code"),
+               clEnumValN(OptimizePipeline::Symbolic, "symbolic",
+                          "Inline small functions and fold small branches "
+                          "into selects, but do not unroll, unswitch or "
+                          "rotate loops, which multiplies the forks")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::init(OptimizePipeline::Standard), cl::cat(klee::ModuleCat));
+
+static cl::opt<unsigned> SymbolicInlineThreshold(
+    "symbolic-inline-threshold",
+    cl::desc("The inlining threshold of --optimize-pipeline=symbolic, "
+             "against the 225 of -O2: inlining saves the cost of a call in "
+             "the executor, but a larger function repeats its forks in every "
+             "caller (default=75)"),
+    cl::init(75), cl::cat(klee::ModuleCat));
+
+static cl::opt<unsigned> FoldBranchSize(
+    "fold-branch-size",
+    cl::desc("The most instructions a side of a branch may have for "
+             "--optimize-pipeline=symbolic to fold the branch into selects "
+             "(default=8)"),
+    cl::init(8), cl::cat(klee::ModuleCat));
+
 static cl::opt<bool> DisableInternalize(
     "disable-internalize",
     cl::desc("Do not mark all symbols as internal (default=false)"),
@@ -144,6 +173,7 @@ static void AddStandardCompilePasses(legacy::PassManager &PM) {
   // FIXME : Removing instcombine causes nestedloop regression.
   addPass(PM, createInstructionCombiningPass());
   addPass(PM, createIndVarSimplifyPass());       // Canonicalize indvars
+  addPass(PM, createLoopIdiomPass());           // Turn loops into memset / memcpy
   addPass(PM, createLoopDeletionPass());         // Delete dead loops
   addPass(PM, createLoopUnrollPass());           // Unroll small loops
   addPass(PM, createInstructionCombiningPass()); // Clean up after the unroller
@@ -162,6 +192,65 @@ static void AddStandardCompilePasses(legacy::PassManager &PM) {
   addPass(PM, createConstantMergePass());        // Merge dup global constants
 }
 
+/// The scalar passes for symbolic execution: the ones of
+/// AddStandardCompilePasses() which simplify the code without duplicating
+/// it, so that each branch left forks as often as in the program, with
+/// small helpers inlined and small branches folded into selects.
+static void AddSymbolicCompilePasses(legacy::PassManager &PM) {
+  PM.add(createVerifierPass());                  // Verify that input is correct
+
+  if (StripDebug)
+    addPass(PM, createStripSymbolsPass(true));
+
+  addPass(PM, createCFGSimplificationPass());    // Clean up disgusting code
+  addPass(PM, createPromoteMemoryToRegisterPass());// Kill useless allocas
+  addPass(PM, createGlobalOptimizerPass());      // Optimize out global vars
+  addPass(PM, createGlobalDCEPass());            // Remove unused fns and globs
+  addPass(PM, createIPConstantPropagationPass());// IP Constant Propagation
+  addPass(PM, createDeadArgEliminationPass());   // Dead argument elimination
+  addPass(PM, createInstructionCombiningPass()); // Clean up after IPCP & DAE
+  addPass(PM, createCFGSimplificationPass());    // Clean up after IPCP & DAE
+
+  addPass(PM, createPruneEHPass());              // Remove dead EH info
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
+  addPass(PM, createPostOrderFunctionAttrsLegacyPass());
+#else
+  addPass(PM, createPostOrderFunctionAttrsPass());
+#endif
+  addPass(PM, createReversePostOrderFunctionAttrsPass()); // Deduce function attrs
+
+  if (!DisableInline)                            // Inline small functions
+    addPass(PM, createFunctionInliningPass(SymbolicInlineThreshold));
+  addPass(PM, createArgumentPromotionPass());    // Scalarize uninlined fn args
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
+  addPass(PM, createSROAPass());                 // Break up aggregate allocas
+#else
+  addPass(PM, createScalarReplAggregatesPass()); // Break up aggregate allocas
+#endif
+  addPass(PM, createInstructionCombiningPass()); // Combine silly seq's
+  addPass(PM, createCFGSimplificationPass());    // Merge & remove BBs
+  addPass(PM, createEarlyCSEPass());             // Reuse loads before folding
+  addPass(PM, new klee::DiamondFoldingPass(FoldBranchSize)); // Avoid forks
+  addPass(PM, createInstructionCombiningPass()); // Clean up the selects
+
+  addPass(PM, createReassociatePass());          // Reassociate expressions
+  addPass(PM, createLICMPass());                 // Hoist loop invariants
+  addPass(PM, createIndVarSimplifyPass());       // Canonicalize indvars
+  addPass(PM, createLoopIdiomPass());           // Turn loops into memset / memcpy
+  addPass(PM, createLoopDeletionPass());         // Delete dead loops
+  addPass(PM, createGVNPass());                  // Remove redundancies
+  addPass(PM, createMemCpyOptPass());            // Remove memcpy / form memset
+  addPass(PM, createSCCPPass());                 // Constant prop with SCCP
+  addPass(PM, createInstructionCombiningPass());
+
+  addPass(PM, createDeadStoreEliminationPass()); // Delete dead stores
+  addPass(PM, createAggressiveDCEPass());        // Delete dead instructions
+  addPass(PM, createCFGSimplificationPass());    // Merge & remove BBs
+  addPass(PM, createStripDeadPrototypesPass());  // Get rid of dead prototypes
+  addPass(PM, createConstantMergePass());        // Merge dup global constants
+}
+
 /// Optimize - Perform link time optimizations. This will run the scalar
 /// optimizations, any loaded plugin-optimization modules, and then the
 /// inter-procedural optimizations if applicable.
@@ -179,7 +268,11 @@ void Optimize(Module *M, llvm::ArrayRef<const char *> preservedFunctions) {
 #endif
 
   // DWD - Run the opt standard pass list as well.
-  AddStandardCompilePasses(Passes);
+  bool Symbolic = Pipeline == OptimizePipeline::Symbolic;
+  if (Symbolic)
+    AddSymbolicCompilePasses(Passes);
+  else
+    AddStandardCompilePasses(Passes);
 
   // Now that composite has been compiled, scan through the module, looking
   // for a main function.  If main is defined, mark all other functions
@@ -223,8 +316,10 @@ void Optimize(Module *M, llvm::ArrayRef<const char *> preservedFunctions) {
   // calls, etc, so let instcombine do this.
   addPass(Passes, createInstructionCombiningPass());
 
-  if (!DisableInline)
-    addPass(Passes, createFunctionInliningPass()); // Inline small functions
+  if (!DisableInline)                            // Inline small functions
+    addPass(Passes, Symbolic
+                        ? createFunctionInliningPass(SymbolicInlineThreshold)
+                        : createFunctionInliningPass());
 
   addPass(Passes, createPruneEHPass());         // Remove dead EH info
   addPass(Passes, createGlobalOptimizerPass()); // Optimize globals again.
@@ -236,7 +331,8 @@ void Optimize(Module *M, llvm::ArrayRef<const char *> preservedFunctions) {
 
   // The IPO passes may leave cruft around.  Clean up after them.
   addPass(Passes, createInstructionCombiningPass());
-  addPass(Passes, createJumpThreadingPass()); // Thread jumps.
+  if (!Symbolic)
+    addPass(Passes, createJumpThreadingPass()); // Thread jumps.
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
   addPass(Passes, createSROAPass()); // Break up allocas
 #else
@@ -260,7 +356,8 @@ void Optimize(Module *M, llvm::ArrayRef<const char *> preservedFunctions) {
   // Cleanup and simplify the code after the scalar optimizations.
   addPass(Passes, createInstructionCombiningPass());
 
-  addPass(Passes, createJumpThreadingPass());           // Thread jumps.
+  if (!Symbolic)
+    addPass(Passes, createJumpThreadingPass());         // Thread jumps.
   addPass(Passes, createPromoteMemoryToRegisterPass()); // Cleanup jumpthread.
 
   // Delete basic blocks, which optimization passes may have killed...
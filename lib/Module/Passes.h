@@ -24,6 +24,7 @@ class Function;
 class Instruction;
 class Module;
 class DataLayout;
+class LoopInfo;
 class TargetLowering;
 class Type;
 } // namespace llvm
@@ -92,6 +93,11 @@ public:
   bool runOnFunction(llvm::Function &f) override;
 };
 
+/// This pass marks the divisions and remainders which may divide by zero
+/// with klee.check.div metadata, for the executor to check them. Those with
+/// a divisor known not to be zero are left unmarked. Those whose result is
+/// unused, which the optimiser would delete along with their metadata, are
+/// preceded by a call to klee_div_zero_check instead.
 class DivCheckPass : public llvm::ModulePass {
   static char ID;
 
@@ -100,7 +106,10 @@ public:
   bool runOnModule(llvm::Module &M) override;
 };
 
-/// This pass injects checks to check for overshifting.
+/// This pass marks the shifts which may overshift with klee.check.shift
+/// metadata, for the executor to check them. Those with a shift amount
+/// known to be in range are left unmarked, and those whose result is unused
+/// are preceded by a call to klee_overshift_check instead.
 ///
 /// Overshifting is where a Shl, LShr or AShr is performed
 /// where the shift amount is greater than width of the bitvector
@@ -197,6 +206,50 @@ public:
 };
 #endif
 
+/// InBoundsAccessPass - Annotates the loads and stores which
+/// ScalarEvolution proves to stay within the stack or global object they
+/// are based on, whatever the values of their indices, so that the executor
+/// skips their bounds checks.
+///
+/// The ranges ScalarEvolution derives assume that the indices do not
+/// overflow where the IR says they do not.
+class InBoundsAccessPass : public llvm::FunctionPass {
+  const llvm::DataLayout &DataLayout;
+
+public:
+  static char ID;
+  InBoundsAccessPass(const llvm::DataLayout &TD)
+      : llvm::FunctionPass(ID), DataLayout(TD) {}
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+  bool runOnFunction(llvm::Function &F) override;
+
+  /// Whether the pass annotated the access as in bounds.
+  static bool isProvedInBounds(const llvm::Instruction &I);
+};
+
+/// DiamondFoldingPass - Replaces the conditional branches around small
+/// blocks which only compute values, the two sides of an if-then-else or
+/// the side of an if-then, by selects of the values, so that the executor
+/// computes both instead of forking on a symbolic condition. Blocks with
+/// more than the given number of instructions, or with instructions that
+/// are not safe to execute speculatively, are left alone, as are loop
+/// headers and latches: only branches within a loop body are folded.
+class DiamondFoldingPass : public llvm::FunctionPass {
+  unsigned MaxInstructions;
+
+  bool isFoldable(llvm::BasicBlock *Side, llvm::BasicBlock *Head,
+                  llvm::BasicBlock *&Tail) const;
+  /// Folds the branch ending \a Head, if it can.
+  bool fold(llvm::BasicBlock *Head, llvm::LoopInfo &LI) const;
+
+public:
+  static char ID;
+  DiamondFoldingPass(unsigned MaxInstructions)
+      : llvm::FunctionPass(ID), MaxInstructions(MaxInstructions) {}
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+  bool runOnFunction(llvm::Function &F) override;
+};
+
 /// Instruments every function that contains a KLEE function call as nonopt
 class OptNonePass : public llvm::ModulePass {
 public:
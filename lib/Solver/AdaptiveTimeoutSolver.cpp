@@ -0,0 +1,194 @@
+//===-- AdaptiveTimeoutSolver.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/OptionCategories.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <unordered_map>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> AdaptiveTimeoutSamples(
+    "adaptive-timeout-samples", cl::init(3),
+    cl::desc("Number of queries of a shape to observe before predicting "
+             "whether queries of that shape time out (default=3)"),
+    cl::cat(SolvingCat));
+
+cl::opt<double> AdaptiveTimeoutFraction(
+    "adaptive-timeout-fraction", cl::init(0.1),
+    cl::desc("Fraction of the core solver timeout given to queries "
+             "predicted to time out (default=0.1)"),
+    cl::cat(SolvingCat));
+
+/// The number of shapes tracked before forgetting them all.
+const size_t MaxShapes = 1 << 16;
+
+/// Hashes the structure of expressions, i.e. their kinds and widths, with
+/// the values of constants and the identity of arrays abstracted away.
+class ShapeHasher {
+  std::unordered_map<const Expr *, uint64_t> hashes;
+
+  static uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+  }
+
+public:
+  uint64_t hash(const ref<Expr> &e) {
+    auto it = hashes.find(e.get());
+    if (it != hashes.end())
+      return it->second;
+
+    uint64_t h = mix(e->getKind(), e->getWidth());
+    for (unsigned i = 0; i != e->getNumKids(); ++i)
+      h = mix(h, hash(e->getKid(i)));
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      h = mix(h, re->updates.root->size);
+      h = mix(h, re->updates.getSize());
+    } else if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+      h = mix(h, wre->updates.root->size);
+      h = mix(h, wre->updates.getSize() * 2 + wre->isLittleEndian);
+    } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      h = mix(h, ee->offset);
+    }
+    hashes[e.get()] = h;
+    return h;
+  }
+
+  /// The shape of a query asking \a kind, independent of the order of the
+  /// constraints.
+  uint64_t hash(const Query &query, unsigned kind) {
+    uint64_t constraints = 0;
+    for (const ref<Expr> &c : query.constraints)
+      constraints += mix(0, hash(c));
+    return mix(mix(kind, constraints), hash(query.expr));
+  }
+};
+
+/// Records how queries of each shape fared, and gives queries of shapes
+/// which almost always time out only a fraction of the core solver timeout,
+/// so that recurring hopeless queries fail early instead of each burning
+/// the full timeout.
+class AdaptiveTimeoutSolver : public SolverImpl {
+  struct ShapeStats {
+    unsigned queries = 0;
+    unsigned timeouts = 0;
+  };
+
+  enum QueryKind { Validity, Truth, Value, InitialValues };
+
+  Solver *solver;
+  time::Span timeout;
+  std::unordered_map<uint64_t, ShapeStats> shapes;
+
+  /// Calls \a run to solve the query, with a shortened timeout if queries
+  /// of its shape are predicted to time out.
+  template <class F> bool solve(const Query &query, QueryKind kind, F run);
+
+public:
+  AdaptiveTimeoutSolver(Solver *solver) : solver(solver) {}
+  ~AdaptiveTimeoutSolver() { delete solver; }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return solve(query, Validity, [&]() {
+      return solver->impl->computeValidity(query, result);
+    });
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    return solve(query, Truth, [&]() {
+      return solver->impl->computeTruth(query, isValid);
+    });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    return solve(query, Value, [&]() {
+      return solver->impl->computeValue(query, result);
+    });
+  }
+  bool computeBound(const Query &query, bool maximize,
+                    ref<ConstantExpr> &result) {
+    return solve(query, Value, [&]() {
+      return solver->impl->computeBound(query, maximize, result);
+    });
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    return solve(query, InitialValues, [&]() {
+      return solver->impl->computeInitialValues(query, objects, values,
+                                                hasSolution);
+    });
+  }
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique) {
+    return solve(query, Value, [&]() {
+      return solver->impl->computeUniqueValue(query, objects, values,
+                                              otherValues, isUnique);
+    });
+  }
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    return solver->impl->getUnsatCore(core);
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span t) {
+    timeout = t;
+    solver->impl->setCoreSolverTimeout(t);
+  }
+};
+}
+
+template <class F>
+bool AdaptiveTimeoutSolver::solve(const Query &query, QueryKind kind,
+                                  F run) {
+  // Without a timeout there is nothing to adapt.
+  if (!timeout)
+    return run();
+
+  if (shapes.size() >= MaxShapes)
+    shapes.clear();
+  ShapeStats &shape = shapes[ShapeHasher().hash(query, kind)];
+
+  // predicted to time out if at least 90% of its queries did
+  bool shorten = shape.queries >= AdaptiveTimeoutSamples &&
+                 shape.timeouts * 10 >= shape.queries * 9;
+  if (shorten) {
+    ++stats::queryTimeoutPredictions;
+    solver->impl->setCoreSolverTimeout(timeout * AdaptiveTimeoutFraction);
+  }
+  bool success = run();
+  if (shorten)
+    solver->impl->setCoreSolverTimeout(timeout);
+
+  ++shape.queries;
+  if (!success &&
+      solver->impl->getOperationStatusCode() == SOLVER_RUN_STATUS_TIMEOUT)
+    ++shape.timeouts;
+  return success;
+}
+
+Solver *klee::createAdaptiveTimeoutSolver(Solver *s) {
+  return new Solver(new AdaptiveTimeoutSolver(s));
+}
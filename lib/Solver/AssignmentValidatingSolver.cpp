@@ -26,6 +26,13 @@ public:
   bool computeValidity(const Query &, Solver::Validity &result);
   bool computeTruth(const Query &, bool &isValid);
   bool computeValue(const Query &, ref<Expr> &result);
+  bool computeBound(const Query &, bool maximize, ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
+  bool getUnsatCore(std::vector<ref<Expr> > &core);
   bool computeInitialValues(const Query &,
                             const std::vector<const Array *> &objects,
                             std::vector<std::vector<unsigned char> > &values,
@@ -48,6 +55,23 @@ bool AssignmentValidatingSolver::computeValue(const Query &query,
                                               ref<Expr> &result) {
   return solver->impl->computeValue(query, result);
 }
+bool AssignmentValidatingSolver::computeBound(const Query &query,
+                                              bool maximize,
+                                              ref<ConstantExpr> &result) {
+  return solver->impl->computeBound(query, maximize, result);
+}
+// the objects need not cover the constraints, so the values are not checked
+bool AssignmentValidatingSolver::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  return solver->impl->computeUniqueValue(query, objects, values, otherValues,
+                                          isUnique);
+}
+
+bool AssignmentValidatingSolver::getUnsatCore(std::vector<ref<Expr> > &core) {
+  return solver->impl->getUnsatCore(core);
+}
 
 bool AssignmentValidatingSolver::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
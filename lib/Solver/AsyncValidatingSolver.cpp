@@ -0,0 +1,514 @@
+//===-- AsyncValidatingSolver.cpp - Cross-checking in another process -----===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerializer.h"
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprPPrinter.h"
+
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+using namespace klee;
+
+namespace {
+
+enum Check : char {
+  Truth = 'T',
+  Validity = 'V',
+  /// A computeValue result, checked as the truth of query.expr != value,
+  /// which must be false.
+  Value = 'X',
+  InitialValues = 'I'
+};
+
+/// What the run and the checker process share.
+struct CheckerCounters {
+  std::atomic<uint64_t> checked;
+  std::atomic<uint64_t> mismatches;
+};
+
+/// Ahead of each serialized query: the primary's answer, the size of the
+/// values of a computeInitialValues result and that of the names of the
+/// arrays, which follow in this order.
+struct CheckHeader {
+  char expected;
+  uint64_t valuesSize;
+  uint64_t namesSize;
+};
+
+bool readFully(int fd, void *data, size_t size) {
+  char *p = static_cast<char *>(data);
+  while (size) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool sendFully(int fd, const char *data, size_t size) {
+  while (size) {
+    // MSG_NOSIGNAL: a dead checker must not take the run down with SIGPIPE
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+/// Checks the results of the primary solver against an oracle in a process
+/// forked when the solver is created, so that the run does not wait for the
+/// oracle. Queries are serialized in the run and handed to a thread which
+/// only writes their bytes to the checker. A sampleRatio fraction of the
+/// queries is checked, and a query is not checked while maxBacklog others
+/// wait for the checker. Mismatches are reported by the checker as it finds
+/// them. Processes forked from the one which created the solver do not
+/// check their queries.
+class AsyncValidatingSolver : public SolverImpl {
+  Solver *solver, *oracle;
+  double sampleRatio;
+  unsigned maxBacklog;
+
+  pid_t owner, checker;
+  int fd;
+  CheckerCounters *counters;
+
+  double credit;
+  uint64_t submitted, skipped;
+
+  std::thread thread;
+  std::mutex lock;
+  std::condition_variable ready;
+  std::deque<std::string> queue;
+  bool done;
+
+  [[noreturn]] void runChecker(int fd, pid_t parent);
+  void runWriter();
+
+  /// Decides whether to check the next query.
+  bool sample();
+  void submit(Check check, char expected, const Query &query,
+              const std::vector<const Array *> *objects = nullptr,
+              const std::string &values = std::string());
+
+public:
+  AsyncValidatingSolver(Solver *solver, Solver *oracle, double sampleRatio,
+                        unsigned maxBacklog);
+  ~AsyncValidatingSolver();
+
+  /// Forks the checker, returns false if that fails.
+  bool start();
+
+  /// Hands the primary solver back, for checking without this solver.
+  Solver *releaseSolver() {
+    Solver *s = solver;
+    solver = nullptr;
+    return s;
+  }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeBound(const Query &, bool maximize, ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+}
+
+AsyncValidatingSolver::AsyncValidatingSolver(Solver *solver, Solver *oracle,
+                                             double sampleRatio,
+                                             unsigned maxBacklog)
+    : solver(solver), oracle(oracle), sampleRatio(sampleRatio),
+      maxBacklog(maxBacklog), owner(getpid()), checker(0), fd(-1),
+      counters(nullptr), credit(0), submitted(0), skipped(0), done(false) {}
+
+AsyncValidatingSolver::~AsyncValidatingSolver() {
+  if (checker > 0 && getpid() == owner) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      done = true;
+    }
+    ready.notify_one();
+    thread.join();
+    // processes forked since may hold the socket too; the checker must see
+    // its end anyway
+    shutdown(fd, SHUT_WR);
+    close(fd);
+    // let the checker report on the queries still waiting
+    int status;
+    while (waitpid(checker, &status, 0) < 0 && errno == EINTR)
+      ;
+    klee_message("cross-checked %llu queries (%llu mismatches, %llu not "
+                 "checked as the checker was busy)",
+                 (unsigned long long)counters->checked,
+                 (unsigned long long)counters->mismatches,
+                 (unsigned long long)skipped);
+  }
+  if (counters)
+    munmap(counters, sizeof(CheckerCounters));
+  delete solver;
+}
+
+bool AsyncValidatingSolver::start() {
+  void *shared = mmap(nullptr, sizeof(CheckerCounters),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    klee_warning("mmap failed (for the cross-check) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  counters = new (shared) CheckerCounters();
+  counters->checked = 0;
+  counters->mismatches = 0;
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+    klee_warning("socketpair failed (for the cross-check) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t parent = getpid();
+  checker = fork();
+  if (checker == -1) {
+    klee_warning("fork failed (for the cross-check) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (checker == 0) {
+    close(fds[0]);
+    runChecker(fds[1], parent);
+  }
+  close(fds[1]);
+  fd = fds[0];
+  thread = std::thread(&AsyncValidatingSolver::runWriter, this);
+  return true;
+}
+
+void AsyncValidatingSolver::runChecker(int fd, pid_t parent) {
+#ifdef __linux__
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+  if (getppid() != parent)
+    _exit(1);
+
+  ArrayCache arrays;
+  uint64_t length;
+  std::string record;
+  while (readFully(fd, &length, sizeof(length))) {
+    record.resize(length);
+    if (!readFully(fd, &record[0], length) || length < sizeof(CheckHeader))
+      break;
+    CheckHeader header;
+    memcpy(&header, record.data(), sizeof(header));
+    if (header.valuesSize > length - sizeof(header) ||
+        header.namesSize > length - sizeof(header) - header.valuesSize)
+      break;
+    const char *values = record.data() + sizeof(header);
+
+    // the names, each preceded by its length
+    std::vector<std::string> names;
+    const char *p = values + header.valuesSize,
+               *namesEnd = p + header.namesSize;
+    while (p + sizeof(uint32_t) <= namesEnd) {
+      uint32_t n;
+      memcpy(&n, p, sizeof(n));
+      p += sizeof(n);
+      if (n > (size_t)(namesEnd - p))
+        break;
+      names.push_back(std::string(p, n));
+      p += n;
+    }
+    std::string serialized = record.substr(
+        sizeof(header) + header.valuesSize + header.namesSize);
+
+    char check;
+    std::vector<ref<Expr> > constraints;
+    ref<Expr> expr;
+    std::vector<const Array *> objects;
+    QueryDeserializer deserializer(serialized, arrays, &names);
+    if (!deserializer.read(check, constraints, expr, objects))
+      break;
+    ConstraintManager cm(constraints);
+    Query query(cm, expr);
+
+    const char *name = "";
+    bool mismatch = false, answer;
+    switch (check) {
+    case Truth:
+      name = "computeTruth";
+      mismatch = oracle->impl->computeTruth(query, answer) &&
+                 answer != (bool)header.expected;
+      break;
+    case Value:
+      name = "computeValue";
+      mismatch = oracle->impl->computeTruth(query, answer) && answer;
+      break;
+    case Validity: {
+      name = "computeValidity";
+      Solver::Validity validity;
+      mismatch = oracle->impl->computeValidity(query, validity) &&
+                 validity + 1 != header.expected;
+      break;
+    }
+    case InitialValues: {
+      name = "computeInitialValues";
+      if (header.expected) {
+        // Assert the bindings as constraints, and verify that the
+        // conjunction of the actual constraints is satisfiable.
+        std::vector<ref<Expr> > bindings;
+        uint64_t offset = 0;
+        for (const Array *array : objects) {
+          for (unsigned j = 0; j < array->size && offset < header.valuesSize;
+               j++, offset++)
+            bindings.push_back(EqExpr::create(
+                ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::alloc(j, array->getDomain())),
+                ConstantExpr::alloc((unsigned char)values[offset],
+                                    array->getRange())));
+        }
+        ConstraintManager tmp(bindings);
+        ref<Expr> conjunction = Expr::createIsZero(expr);
+        for (const ref<Expr> &c : constraints)
+          conjunction = AndExpr::create(conjunction, c);
+        mismatch =
+            oracle->impl->computeTruth(Query(tmp, conjunction), answer) &&
+            !answer;
+      } else {
+        mismatch = oracle->impl->computeTruth(query, answer) && !answer;
+      }
+      break;
+    }
+    }
+
+    if (mismatch) {
+      ++counters->mismatches;
+      klee_warning("cross-check: invalid solver result (%s) for the query",
+                   name);
+      ExprPPrinter::printQuery(llvm::errs(), cm, expr);
+      llvm::errs().flush();
+    }
+    ++counters->checked;
+  }
+  _exit(0);
+}
+
+void AsyncValidatingSolver::runWriter() {
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    ready.wait(guard, [this] { return done || !queue.empty(); });
+    if (queue.empty())
+      return;
+    std::string record = std::move(queue.front());
+    queue.pop_front();
+    guard.unlock();
+    uint64_t length = record.size();
+    bool sent = sendFully(fd, reinterpret_cast<const char *>(&length),
+                          sizeof(length)) &&
+                sendFully(fd, record.data(), record.size());
+    guard.lock();
+    if (!sent) {
+      // the checker is gone, drop what is left
+      queue.clear();
+      if (done)
+        return;
+    }
+  }
+}
+
+bool AsyncValidatingSolver::sample() {
+  if (checker <= 0 || getpid() != owner)
+    return false;
+  credit += sampleRatio;
+  if (credit < 1)
+    return false;
+  credit -= 1;
+  if (submitted - counters->checked >= maxBacklog) {
+    ++skipped;
+    return false;
+  }
+  return true;
+}
+
+void AsyncValidatingSolver::submit(Check check, char expected,
+                                   const Query &query,
+                                   const std::vector<const Array *> *objects,
+                                   const std::string &values) {
+  QuerySerializer serializer;
+  serializer.writeTag(check);
+  serializer.visit(query);
+  if (objects)
+    serializer.visitObjects(*objects);
+
+  // the names make the checker's reports readable
+  std::string names;
+  for (const Array *array : serializer.getArrays()) {
+    uint32_t n = array->name.size();
+    names.append(reinterpret_cast<const char *>(&n), sizeof(n));
+    names += array->name;
+  }
+
+  CheckHeader header;
+  memset(&header, 0, sizeof(header));
+  header.expected = expected;
+  header.valuesSize = values.size();
+  header.namesSize = names.size();
+
+  std::string record(reinterpret_cast<const char *>(&header), sizeof(header));
+  record += values;
+  record += names;
+  record += serializer.getBuffer();
+
+  ++submitted;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queue.push_back(std::move(record));
+  }
+  ready.notify_one();
+}
+
+bool AsyncValidatingSolver::computeTruth(const Query &query, bool &isValid) {
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  if (sample())
+    submit(Truth, isValid, query);
+  return true;
+}
+
+bool AsyncValidatingSolver::computeValidity(const Query &query,
+                                            Solver::Validity &result) {
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  if (sample())
+    submit(Validity, result + 1, query);
+  return true;
+}
+
+bool AsyncValidatingSolver::computeValue(const Query &query,
+                                         ref<Expr> &result) {
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  // We don't want to compare, but just make sure this is a legal
+  // solution.
+  if (sample())
+    submit(Value, 0, query.withExpr(NeExpr::create(query.expr, result)));
+  return true;
+}
+
+bool AsyncValidatingSolver::computeBound(const Query &query, bool maximize,
+                                         ref<ConstantExpr> &result) {
+  if (!solver->impl->computeBound(query, maximize, result))
+    return false;
+  // Only check that the bound is a legal solution: if it is, and not the
+  // bound, the synchronous range search finds a better one.
+  if (sample())
+    submit(Value, 0, query.withExpr(NeExpr::create(query.expr, result)));
+  return true;
+}
+
+bool AsyncValidatingSolver::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  if (!solver->impl->computeUniqueValue(query, objects, values, otherValues,
+                                        isUnique))
+    return false;
+  // the uniqueness is the truth of the expression being equal to the value
+  if (sample()) {
+    ref<Expr> value = Assignment(objects, values).evaluate(query.expr);
+    submit(Truth, isUnique,
+           query.withExpr(EqExpr::create(query.expr, value)));
+  }
+  return true;
+}
+
+bool AsyncValidatingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+    return false;
+  if (sample()) {
+    std::string bytes;
+    if (hasSolution)
+      for (const std::vector<unsigned char> &v : values)
+        bytes.append(v.begin(), v.end());
+    submit(InitialValues, hasSolution, query, &objects, bytes);
+  }
+  return true;
+}
+
+Solver *klee::createAsyncValidatingSolver(Solver *s, Solver *oracle,
+                                          double sampleRatio,
+                                          unsigned maxBacklog) {
+  AsyncValidatingSolver *impl =
+      new AsyncValidatingSolver(s, oracle, sampleRatio, maxBacklog);
+  if (impl->start())
+    return new Solver(impl);
+
+  klee_warning("cross-checking the solver synchronously");
+  s = impl->releaseSolver();
+  delete impl;
+  return createValidatingSolver(s, oracle);
+}
@@ -0,0 +1,595 @@
+//===-- BinaryQueryLoggingSolver.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A query log which costs the solving thread little more than serializing
+// each query with QuerySerializer: compressing and writing the records is
+// left to a thread of its own, and printing them to `kleaver
+// --print-query-log`.
+//
+// The log starts with a magic and holds one record per query: its length,
+// a header of LEB128 numbers (the kind, number, instructions, elapsed
+// microseconds, success, status, the result and the names of the arrays),
+// and the query as QuerySerializer writes it. The whole stream is gzip compressed, if zlib is
+// available, and flushed after every batch of records so that a crash only
+// loses the last batch.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerializer.h"
+
+#include "klee/Config/config.h"
+#include "klee/Constraints.h"
+#include "klee/QueryLog.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/Statistics.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+using namespace klee;
+
+#define QUERYLOG_MAGIC "KQLOG\1"
+#define QUERYLOG_MAGIC_SIZE 6
+
+namespace {
+void write(std::string &buffer, uint64_t v) {
+  // LEB128
+  do {
+    unsigned char byte = v & 0x7f;
+    v >>= 7;
+    if (v)
+      byte |= 0x80;
+    buffer.push_back(byte);
+  } while (v);
+}
+
+bool read(const std::string &buffer, size_t &pos, uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; shift < 64 && pos != buffer.size(); shift += 7) {
+    unsigned char byte = buffer[pos++];
+    v |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/// Compresses and writes batches of records on a thread of its own. The
+/// solving thread only waits for it when it falls behind by MaxPending
+/// batches, as queries are never dropped.
+///
+/// Processes forked from the one which opened the log, which have no
+/// writing thread, do not log.
+class QueryLogWriter {
+  static const size_t BatchSize = 1 << 16;
+  static const size_t MaxPending = 16;
+
+  int fd;
+  pid_t owner;
+  std::string batch;
+
+  std::deque<std::string> pending;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable ready, drained;
+  std::thread thread;
+
+#ifdef HAVE_ZLIB_H
+  z_stream strm;
+#endif
+
+  void submit();
+  void run();
+  void writeFully(const char *data, size_t size);
+
+public:
+  explicit QueryLogWriter(int fd);
+  ~QueryLogWriter();
+
+  QueryLogWriter(const QueryLogWriter &) = delete;
+  QueryLogWriter &operator=(const QueryLogWriter &) = delete;
+
+  void append(const std::string &record);
+};
+
+QueryLogWriter::QueryLogWriter(int fd) : fd(fd), owner(getpid()) {
+#ifdef HAVE_ZLIB_H
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, Z_BEST_SPEED, Z_DEFLATED, 31, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    klee_error("Could not initialize the query log compression");
+#endif
+  batch.append(QUERYLOG_MAGIC, QUERYLOG_MAGIC_SIZE);
+  thread = std::thread(&QueryLogWriter::run, this);
+}
+
+QueryLogWriter::~QueryLogWriter() {
+  if (getpid() != owner)
+    return;
+  submit();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  ready.notify_one();
+  thread.join();
+
+#ifdef HAVE_ZLIB_H
+  std::vector<char> out(BatchSize);
+  int res;
+  do {
+    strm.next_in = nullptr;
+    strm.avail_in = 0;
+    strm.next_out = reinterpret_cast<Bytef *>(out.data());
+    strm.avail_out = out.size();
+    res = deflate(&strm, Z_FINISH);
+    writeFully(out.data(), out.size() - strm.avail_out);
+  } while (res == Z_OK);
+  deflateEnd(&strm);
+#endif
+  close(fd);
+}
+
+void QueryLogWriter::append(const std::string &record) {
+  if (getpid() != owner)
+    return;
+  write(batch, record.size());
+  batch += record;
+  if (batch.size() >= BatchSize)
+    submit();
+}
+
+void QueryLogWriter::submit() {
+  if (batch.empty())
+    return;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this]() { return pending.size() < MaxPending; });
+    pending.push_back(std::move(batch));
+  }
+  batch.clear();
+  ready.notify_one();
+}
+
+void QueryLogWriter::run() {
+#ifdef HAVE_ZLIB_H
+  std::vector<char> out(BatchSize);
+#endif
+  for (;;) {
+    std::string data;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this]() { return stopping || !pending.empty(); });
+      if (pending.empty())
+        return;
+      data = std::move(pending.front());
+      pending.pop_front();
+    }
+    drained.notify_one();
+
+#ifdef HAVE_ZLIB_H
+    strm.next_in = reinterpret_cast<Bytef *>(&data[0]);
+    strm.avail_in = data.size();
+    do {
+      strm.next_out = reinterpret_cast<Bytef *>(out.data());
+      strm.avail_out = out.size();
+      deflate(&strm, Z_SYNC_FLUSH);
+      writeFully(out.data(), out.size() - strm.avail_out);
+    } while (strm.avail_out == 0);
+#else
+    writeFully(data.data(), data.size());
+#endif
+  }
+}
+
+void QueryLogWriter::writeFully(const char *data, size_t size) {
+  while (size) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      klee_warning_once(0, "could not write the query log: %s",
+                        strerror(errno));
+      return;
+    }
+    data += n;
+    size -= n;
+  }
+}
+
+class BinaryQueryLoggingSolver : public SolverImpl {
+  Solver *solver;
+  QueryLogWriter writer;
+  Statistic *instructions;
+  uint64_t queryCount = 0;
+  time::Span minQueryTimeToLog;
+  bool logTimedOutQueries;
+
+  /// The record of the current query.
+  std::string record;
+  char kind;
+  uint64_t startInstructions;
+  time::Point startTime;
+
+  void startQuery(char queryKind);
+  /// Writes the header of the record, if the query is to be logged.
+  bool finishQuery(bool success);
+  void logQuery(const Query &query,
+                const std::vector<const Array *> *objects = nullptr);
+
+public:
+  BinaryQueryLoggingSolver(Solver *solver, int fd, time::Span queryTimeToLog,
+                           bool logTimedOut)
+      : solver(solver), writer(fd),
+        instructions(theStatisticManager->getStatisticByName("Instructions")),
+        minQueryTimeToLog(queryTimeToLog), logTimedOutQueries(logTimedOut) {}
+  ~BinaryQueryLoggingSolver() { delete solver; }
+
+  bool computeTruth(const Query &query, bool &isValid);
+  bool computeValidity(const Query &query, Solver::Validity &result);
+  bool computeValue(const Query &query, ref<Expr> &result);
+  // not logged, as the log format has no record for bounds
+  bool computeBound(const Query &query, bool maximize,
+                    ref<ConstantExpr> &result) {
+    return solver->impl->computeBound(query, maximize, result);
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  // not logged, as the log format has no record for it
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique) {
+    return solver->impl->computeUniqueValue(query, objects, values,
+                                            otherValues, isUnique);
+  }
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    return solver->impl->getUnsatCore(core);
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+void BinaryQueryLoggingSolver::startQuery(char queryKind) {
+  kind = queryKind;
+  startInstructions = instructions ? instructions->getValue() : 0;
+  startTime = time::getWallTime();
+}
+
+bool BinaryQueryLoggingSolver::finishQuery(bool success) {
+  time::Span elapsed = time::getWallTime() - startTime;
+  uint64_t number = queryCount++;
+  SolverRunStatus status = solver->impl->getOperationStatusCode();
+  // as QueryLoggingSolver::flushBuffer()
+  if (minQueryTimeToLog && elapsed <= minQueryTimeToLog &&
+      !(logTimedOutQueries && status == SOLVER_RUN_STATUS_TIMEOUT))
+    return false;
+
+  record.clear();
+  write(record, kind);
+  write(record, number);
+  write(record, startInstructions);
+  write(record, elapsed.toMicroseconds());
+  write(record, success);
+  write(record, status);
+  return true;
+}
+
+void BinaryQueryLoggingSolver::logQuery(
+    const Query &query, const std::vector<const Array *> *objects) {
+  QuerySerializer serializer;
+  serializer.writeTag(kind);
+  serializer.visit(query);
+  if (objects)
+    serializer.visitObjects(*objects);
+
+  std::vector<const Array *> arrays = serializer.getArrays();
+  write(record, arrays.size());
+  for (const Array *array : arrays) {
+    write(record, array->name.size());
+    record += array->name;
+  }
+  record += serializer.getBuffer();
+  writer.append(record);
+}
+
+bool BinaryQueryLoggingSolver::computeTruth(const Query &query,
+                                            bool &isValid) {
+  startQuery(LoggedQuery::Truth);
+  bool success = solver->impl->computeTruth(query, isValid);
+  if (finishQuery(success)) {
+    if (success)
+      write(record, isValid);
+    logQuery(query);
+  }
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeValidity(const Query &query,
+                                               Solver::Validity &result) {
+  startQuery(LoggedQuery::Validity);
+  bool success = solver->impl->computeValidity(query, result);
+  if (finishQuery(success)) {
+    if (success)
+      write(record, result + 1);
+    logQuery(query);
+  }
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeValue(const Query &query,
+                                            ref<Expr> &result) {
+  startQuery(LoggedQuery::Value);
+  bool success = solver->impl->computeValue(query, result);
+  if (finishQuery(success)) {
+    if (success) {
+      // the width, then the words of the value
+      const ConstantExpr *ce = dyn_cast<ConstantExpr>(result);
+      write(record, ce ? ce->getWidth() : 0);
+      if (ce)
+        for (unsigned i = 0; i != ce->getAPValue().getNumWords(); ++i)
+          write(record, ce->getAPValue().getRawData()[i]);
+    }
+    logQuery(query);
+  }
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  startQuery(LoggedQuery::InitialValues);
+  bool success =
+      solver->impl->computeInitialValues(query, objects, values, hasSolution);
+  if (finishQuery(success)) {
+    if (success) {
+      write(record, hasSolution);
+      if (hasSolution) {
+        write(record, values.size());
+        for (const std::vector<unsigned char> &value : values) {
+          write(record, value.size());
+          record.append(value.begin(), value.end());
+        }
+      }
+    }
+    logQuery(query, &objects);
+  }
+  return success;
+}
+} // namespace
+
+Solver *klee::createBinaryQueryLoggingSolver(Solver *s, std::string path,
+                                             time::Span minQueryTimeToLog,
+                                             bool logTimedOut) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    klee_error("Could not open file %s : %s", path.c_str(), strerror(errno));
+  return new Solver(
+      new BinaryQueryLoggingSolver(s, fd, minQueryTimeToLog, logTimedOut));
+}
+
+const char *LoggedQuery::getKindName() const {
+  switch (kind) {
+  case Truth:
+    return "Truth";
+  case Validity:
+    return "Validity";
+  case Value:
+    return "Value";
+  case InitialValues:
+    return "InitialValues";
+  }
+  return "Unknown";
+}
+
+#ifdef HAVE_ZLIB_H
+struct QueryLogReader::Inflater {
+  z_stream strm;
+
+  Inflater(llvm::StringRef input) {
+    memset(&strm, 0, sizeof(strm));
+    inflateInit2(&strm, 15 + 32);
+    strm.next_in = (Bytef *)input.data();
+    strm.avail_in = input.size();
+  }
+  ~Inflater() { inflateEnd(&strm); }
+};
+#else
+struct QueryLogReader::Inflater {};
+#endif
+
+QueryLogReader::QueryLogReader(llvm::StringRef contents,
+                               ArrayCache &arrayCache, ExprBuilder *builder)
+    : input(contents), arrayCache(arrayCache), builder(builder) {
+  if (contents.size() >= 2 && (unsigned char)contents[0] == 0x1f &&
+      (unsigned char)contents[1] == 0x8b) {
+#ifdef HAVE_ZLIB_H
+    inflater.reset(new Inflater(contents));
+#else
+    error = "compressed query logs need zlib";
+    return;
+#endif
+  }
+  if (!fill(QUERYLOG_MAGIC_SIZE) ||
+      data.compare(0, QUERYLOG_MAGIC_SIZE, QUERYLOG_MAGIC,
+                   QUERYLOG_MAGIC_SIZE))
+    error = "not a binary query log";
+  pos = QUERYLOG_MAGIC_SIZE;
+}
+
+QueryLogReader::~QueryLogReader() {}
+
+bool QueryLogReader::isQueryLog(llvm::StringRef contents) {
+  return contents.startswith("\x1f\x8b") ||
+         contents.startswith(llvm::StringRef(QUERYLOG_MAGIC,
+                                             QUERYLOG_MAGIC_SIZE));
+}
+
+bool QueryLogReader::fill(size_t size) {
+  if (data.size() - pos >= size)
+    return true;
+  offset += pos;
+  data.erase(0, pos);
+  pos = 0;
+
+  const size_t chunkSize = 1 << 16;
+  while (data.size() < size && !inputDone) {
+    if (!inflater) {
+      size_t n = std::min(chunkSize, input.size() - inputPos);
+      data.append(input.data() + inputPos, n);
+      inputPos += n;
+      inputDone = inputPos == input.size();
+      continue;
+    }
+#ifdef HAVE_ZLIB_H
+    size_t used = data.size();
+    data.resize(used + chunkSize);
+    z_stream &strm = inflater->strm;
+    strm.next_out = reinterpret_cast<Bytef *>(&data[used]);
+    strm.avail_out = chunkSize;
+    int res = inflate(&strm, Z_NO_FLUSH);
+    data.resize(data.size() - strm.avail_out);
+    // a log whose writer did not finish lacks the end of the stream
+    inputDone = res != Z_OK;
+#endif
+  }
+  return data.size() >= size;
+}
+
+bool QueryLogReader::next(LoggedQuery &query) {
+  if (!error.empty() || !fill(1))
+    return false;
+
+  // a length takes at most 10 bytes
+  fill(10);
+  uint64_t start = offset + pos, size;
+  if (!read(data, pos, size) || !fill(size)) {
+    // the last record was not written completely
+    pos = data.size();
+    return false;
+  }
+  std::string payload = data.substr(pos, size);
+  pos += size;
+
+  if (!readRecord(payload, query)) {
+    error = "malformed record at offset " + llvm::utostr(start);
+    return false;
+  }
+  return true;
+}
+
+bool QueryLogReader::readRecord(const std::string &payload,
+                                LoggedQuery &query) {
+  size_t p = 0;
+  uint64_t kind, elapsed, success, status, v;
+  query = LoggedQuery();
+  if (!read(payload, p, kind) || !read(payload, p, query.number) ||
+      !read(payload, p, query.instructions) || !read(payload, p, elapsed) ||
+      !read(payload, p, success) || !read(payload, p, status))
+    return false;
+  query.kind = static_cast<LoggedQuery::Kind>(kind);
+  query.elapsed = time::microseconds(elapsed);
+  query.success = success;
+  query.status = static_cast<SolverImpl::SolverRunStatus>(status);
+
+  if (query.success) {
+    switch (query.kind) {
+    case LoggedQuery::Truth:
+      if (!read(payload, p, v))
+        return false;
+      query.isValid = v;
+      break;
+    case LoggedQuery::Validity:
+      if (!read(payload, p, v))
+        return false;
+      query.validity = static_cast<Solver::Validity>((int)v - 1);
+      break;
+    case LoggedQuery::Value: {
+      uint64_t width;
+      if (!read(payload, p, width) || width > (1u << 24))
+        return false;
+      if (width) {
+        std::vector<uint64_t> words(llvm::APInt::getNumWords(width));
+        for (uint64_t &word : words)
+          if (!read(payload, p, word))
+            return false;
+        query.value = ConstantExpr::alloc(llvm::APInt(width, words));
+      }
+      break;
+    }
+    case LoggedQuery::InitialValues:
+      if (!read(payload, p, v))
+        return false;
+      query.hasSolution = v;
+      if (query.hasSolution) {
+        uint64_t count, n;
+        if (!read(payload, p, count))
+          return false;
+        for (uint64_t i = 0; i != count; ++i) {
+          if (!read(payload, p, n) || n > payload.size() - p)
+            return false;
+          query.values.push_back(std::vector<unsigned char>(
+              payload.begin() + p, payload.begin() + p + n));
+          p += n;
+        }
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+
+  uint64_t numNames, n;
+  std::vector<std::string> names;
+  if (!read(payload, p, numNames))
+    return false;
+  for (uint64_t i = 0; i != numNames; ++i) {
+    if (!read(payload, p, n) || n > payload.size() - p)
+      return false;
+    names.push_back(payload.substr(p, n));
+    p += n;
+  }
+
+  char tag;
+  std::string serialized = payload.substr(p);
+  QueryDeserializer deserializer(serialized, arrayCache, &names, builder);
+  return deserializer.read(tag, query.constraints, query.expr,
+                           query.objects) &&
+         tag == query.kind;
+}
@@ -0,0 +1,460 @@
+//===-- BitBlaster.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BitBlaster.h"
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <cassert>
+
+using namespace klee;
+
+constexpr BitBlaster::Literal BitBlaster::True;
+constexpr BitBlaster::Literal BitBlaster::False;
+
+BitBlaster::BitBlaster(ClauseSink &sink) : sink(sink), variables(0) {
+  Literal t = newVariable();
+  assert(t == True);
+  addClause({t});
+}
+
+const BitBlaster::Bits *BitBlaster::getArrayBits(const Array *array) const {
+  auto it = arrayBits.find(array);
+  return it == arrayBits.end() ? nullptr : &it->second;
+}
+
+/***/
+
+// The gates fold constant and repeated operands away, and are defined by
+// clauses from which unit propagation derives the output once the inputs
+// are known.
+
+BitBlaster::Literal BitBlaster::mkAnd(Literal a, Literal b) {
+  if (a == False || b == False || a == -b)
+    return False;
+  if (a == True || a == b)
+    return b;
+  if (b == True)
+    return a;
+  Literal g = newVariable();
+  addClause({-g, a});
+  addClause({-g, b});
+  addClause({g, -a, -b});
+  return g;
+}
+
+BitBlaster::Literal BitBlaster::mkXor(Literal a, Literal b) {
+  if (a == False)
+    return b;
+  if (b == False)
+    return a;
+  if (a == True)
+    return -b;
+  if (b == True)
+    return -a;
+  if (a == b)
+    return False;
+  if (a == -b)
+    return True;
+  Literal g = newVariable();
+  addClause({-g, a, b});
+  addClause({-g, -a, -b});
+  addClause({g, -a, b});
+  addClause({g, a, -b});
+  return g;
+}
+
+BitBlaster::Literal BitBlaster::mkIte(Literal c, Literal t, Literal e) {
+  if (c == True || t == e)
+    return t;
+  if (c == False)
+    return e;
+  if (t == True)
+    return mkOr(c, e);
+  if (t == False)
+    return mkAnd(-c, e);
+  if (e == True)
+    return mkOr(-c, t);
+  if (e == False)
+    return mkAnd(c, t);
+  if (t == -e)
+    return -mkXor(c, t);
+  Literal g = newVariable();
+  addClause({-c, -t, g});
+  addClause({-c, t, -g});
+  addClause({c, -e, g});
+  addClause({c, e, -g});
+  // redundant, but they settle the output when both branches agree
+  addClause({-t, -e, g});
+  addClause({t, e, -g});
+  return g;
+}
+
+/***/
+
+BitBlaster::Bits BitBlaster::constant(uint64_t value, unsigned width) {
+  Bits bits(width, False);
+  for (unsigned i = 0; i < width && i < 64; ++i)
+    if ((value >> i) & 1)
+      bits[i] = True;
+  return bits;
+}
+
+BitBlaster::Bits BitBlaster::constant(const ConstantExpr &ce) {
+  const llvm::APInt &value = ce.getAPValue();
+  Bits bits(value.getBitWidth(), False);
+  for (unsigned i = 0, e = bits.size(); i != e; ++i)
+    if (value[i])
+      bits[i] = True;
+  return bits;
+}
+
+BitBlaster::Bits BitBlaster::ite(Literal c, const Bits &t, const Bits &e) {
+  assert(t.size() == e.size() && "ite of different widths");
+  Bits bits(t.size());
+  for (unsigned i = 0, n = t.size(); i != n; ++i)
+    bits[i] = mkIte(c, t[i], e[i]);
+  return bits;
+}
+
+BitBlaster::Bits BitBlaster::add(const Bits &a, const Bits &b, Literal carry,
+                                 Literal *carryOut) {
+  assert(a.size() == b.size() && "add of different widths");
+  Bits sum(a.size());
+  for (unsigned i = 0, n = a.size(); i != n; ++i) {
+    Literal half = mkXor(a[i], b[i]);
+    sum[i] = mkXor(half, carry);
+    carry = mkOr(mkAnd(a[i], b[i]), mkAnd(carry, half));
+  }
+  if (carryOut)
+    *carryOut = carry;
+  return sum;
+}
+
+BitBlaster::Bits BitBlaster::negate(const Bits &a) {
+  Bits inverted(a.size());
+  for (unsigned i = 0, n = a.size(); i != n; ++i)
+    inverted[i] = -a[i];
+  return add(inverted, Bits(a.size(), False), True);
+}
+
+BitBlaster::Bits BitBlaster::mul(const Bits &a, const Bits &b) {
+  unsigned width = a.size();
+  Bits product(width, False);
+  for (unsigned i = 0; i != width; ++i) {
+    if (b[i] == False)
+      continue;
+    Bits partial(width, False);
+    for (unsigned j = i; j != width; ++j)
+      partial[j] = mkAnd(a[j - i], b[i]);
+    product = add(product, partial);
+  }
+  return product;
+}
+
+/// Restoring division, one bit of the quotient per step.
+void BitBlaster::udivrem(const Bits &a, const Bits &b, Bits &quotient,
+                         Bits &remainder) {
+  unsigned width = a.size();
+  // The partial remainder is below the divisor, but takes an extra bit once
+  // shifted.
+  Bits divisor(b);
+  divisor.push_back(False);
+  Bits inverted(width + 1);
+  for (unsigned i = 0; i != width + 1; ++i)
+    inverted[i] = -divisor[i];
+
+  Bits partial(width + 1, False);
+  quotient.assign(width, False);
+  for (unsigned i = width; i--;) {
+    Bits shifted(width + 1);
+    shifted[0] = a[i];
+    for (unsigned j = 1; j != width + 1; ++j)
+      shifted[j] = partial[j - 1];
+    Literal fits;
+    Bits difference = add(shifted, inverted, True, &fits);
+    quotient[i] = fits;
+    partial = ite(fits, difference, shifted);
+  }
+  remainder.assign(partial.begin(), partial.begin() + width);
+}
+
+/// Barrel shifter, shifting in \a fill.
+BitBlaster::Bits BitBlaster::shift(const Bits &a, const Bits &amount,
+                                   bool left, Literal fill) {
+  unsigned width = a.size();
+  Bits current(a);
+  for (unsigned k = 0; k < amount.size() && k < 32 && (1u << k) < width;
+       ++k) {
+    unsigned distance = 1u << k;
+    Bits shifted(width, fill);
+    for (unsigned j = 0; j != width; ++j) {
+      if (left && j >= distance)
+        shifted[j] = current[j - distance];
+      else if (!left && j + distance < width)
+        shifted[j] = current[j + distance];
+    }
+    current = ite(amount[k], shifted, current);
+  }
+
+  // shifting by the width or more leaves the fill only
+  if (amount.size() < 64 && width >= (UINT64_C(1) << amount.size()))
+    return current;
+  Literal over = -ult(amount, constant(width, amount.size()), false);
+  return ite(over, Bits(width, fill), current);
+}
+
+BitBlaster::Literal BitBlaster::eq(const Bits &a, const Bits &b) {
+  Literal result = True;
+  for (unsigned i = 0, n = a.size(); i != n; ++i)
+    result = mkAnd(result, -mkXor(a[i], b[i]));
+  return result;
+}
+
+BitBlaster::Literal BitBlaster::ult(const Bits &a, const Bits &b,
+                                    bool orEqual) {
+  // the most significant bit which differs decides
+  Literal result = orEqual ? True : False;
+  for (unsigned i = 0, n = a.size(); i != n; ++i)
+    result = mkIte(mkXor(a[i], b[i]), b[i], result);
+  return result;
+}
+
+BitBlaster::Literal BitBlaster::slt(const Bits &a, const Bits &b,
+                                    bool orEqual) {
+  // flipping the sign bits maps the signed order onto the unsigned one
+  Bits flippedA(a), flippedB(b);
+  flippedA.back() = -flippedA.back();
+  flippedB.back() = -flippedB.back();
+  return ult(flippedA, flippedB, orEqual);
+}
+
+/***/
+
+/// The initial value of a byte of an array.
+BitBlaster::Bits BitBlaster::rootByte(const Array *array, uint64_t index) {
+  unsigned range = array->getRange();
+  if (index >= array->size)
+    return Bits(range, False);
+  if (array->isConstantArray())
+    return constant(*array->constantValues[index]);
+
+  Bits &bits = arrayBits[array];
+  if (bits.empty())
+    bits.assign(array->size * range, 0);
+  Bits::iterator byte = bits.begin() + index * range;
+  if (!*byte)
+    for (unsigned i = 0; i != range; ++i)
+      byte[i] = newVariable();
+  return Bits(byte, byte + range);
+}
+
+/// The initial value of the byte of an array at a symbolic index, selected
+/// by a multiplexer over all the bytes, one level per bit of the index.
+BitBlaster::Bits BitBlaster::rootRead(const Array *array, const Bits &index) {
+  uint64_t concrete = 0;
+  bool isConcrete = true;
+  for (unsigned i = 0, n = index.size(); i != n && isConcrete; ++i) {
+    if (index[i] == True && i < 64)
+      concrete |= UINT64_C(1) << i;
+    else if (index[i] != False)
+      isConcrete = false;
+  }
+  if (isConcrete)
+    return rootByte(array, concrete);
+
+  std::vector<Bits> level;
+  for (unsigned i = 0; i != array->size; ++i)
+    level.push_back(rootByte(array, i));
+  if (level.empty())
+    return Bits(array->getRange(), False);
+
+  Bits zero(array->getRange(), False);
+  unsigned k = 0;
+  for (; k != index.size() && level.size() > 1; ++k) {
+    std::vector<Bits> next;
+    for (unsigned j = 0; j < level.size(); j += 2)
+      next.push_back(
+          ite(index[k], j + 1 < level.size() ? level[j + 1] : zero, level[j]));
+    level.swap(next);
+  }
+
+  // the remaining bits of the index are set only outside of the array
+  Literal outside = False;
+  for (; k != index.size(); ++k)
+    outside = mkOr(outside, index[k]);
+  return ite(outside, zero, level[0]);
+}
+
+BitBlaster::Bits BitBlaster::read(const ReadExpr &re) {
+  const Bits &index = blast(re.index);
+
+  // The updates more recent than the first one known to match the index.
+  std::vector<std::pair<Literal, const UpdateNode *> > updates;
+  Bits value;
+  const UpdateNode *un = re.updates.head;
+  for (; un; un = un->next) {
+    Literal matches = eq(index, blast(un->index));
+    if (matches == True)
+      break;
+    if (matches != False)
+      updates.push_back(std::make_pair(matches, un));
+  }
+  value = un ? blast(un->value) : rootRead(re.updates.root, index);
+
+  for (auto it = updates.rbegin(), ie = updates.rend(); it != ie; ++it)
+    value = ite(it->first, blast(it->second->value), value);
+  return value;
+}
+
+/***/
+
+const BitBlaster::Bits &BitBlaster::blast(const ref<Expr> &e) {
+  auto it = cache.find(e);
+  if (it != cache.end())
+    return *it->second;
+  Bits bits = construct(e);
+  assert(bits.size() == e->getWidth() && "encoded with the wrong width");
+  encodings.push_back(std::move(bits));
+  cache.insert(std::make_pair(e, &encodings.back()));
+  return encodings.back();
+}
+
+BitBlaster::Bits BitBlaster::construct(const ref<Expr> &e) {
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return constant(*cast<ConstantExpr>(e));
+
+  case Expr::NotOptimized:
+    return blast(cast<NotOptimizedExpr>(e)->src);
+
+  case Expr::Read:
+    return read(*cast<ReadExpr>(e));
+
+  case Expr::WideRead:
+    return blast(cast<WideReadExpr>(e)->lower());
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    Literal c = blast(se->cond)[0];
+    return ite(c, blast(se->trueExpr), blast(se->falseExpr));
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    Bits bits = blast(ce->getRight());
+    const Bits &left = blast(ce->getLeft());
+    bits.insert(bits.end(), left.begin(), left.end());
+    return bits;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    const Bits &src = blast(ee->expr);
+    return Bits(src.begin() + ee->offset,
+                src.begin() + ee->offset + ee->width);
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    Bits bits = blast(ce->src);
+    Literal fill = e->getKind() == Expr::SExt ? bits.back() : False;
+    bits.resize(ce->width, fill);
+    return bits;
+  }
+
+  case Expr::Not: {
+    Bits bits = blast(cast<NotExpr>(e)->expr);
+    for (Literal &bit : bits)
+      bit = -bit;
+    return bits;
+  }
+
+  default:
+    break;
+  }
+
+  const BinaryExpr *be = cast<BinaryExpr>(e);
+  const Bits &left = blast(be->left);
+  const Bits &right = blast(be->right);
+  switch (e->getKind()) {
+  case Expr::Add:
+    return add(left, right);
+  case Expr::Sub: {
+    Bits inverted(right.size());
+    for (unsigned i = 0, n = right.size(); i != n; ++i)
+      inverted[i] = -right[i];
+    return add(left, inverted, True);
+  }
+  case Expr::Mul:
+    return mul(left, right);
+
+  case Expr::UDiv:
+  case Expr::URem: {
+    Bits quotient, remainder;
+    udivrem(left, right, quotient, remainder);
+    return e->getKind() == Expr::UDiv ? quotient : remainder;
+  }
+  case Expr::SDiv:
+  case Expr::SRem: {
+    // divide the magnitudes, then set the signs
+    Literal signLeft = left.back(), signRight = right.back();
+    Bits quotient, remainder;
+    udivrem(ite(signLeft, negate(left), left),
+            ite(signRight, negate(right), right), quotient, remainder);
+    if (e->getKind() == Expr::SDiv)
+      return ite(mkXor(signLeft, signRight), negate(quotient), quotient);
+    return ite(signLeft, negate(remainder), remainder);
+  }
+
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor: {
+    Bits bits(left.size());
+    for (unsigned i = 0, n = left.size(); i != n; ++i)
+      bits[i] = e->getKind() == Expr::And
+                    ? mkAnd(left[i], right[i])
+                    : e->getKind() == Expr::Or ? mkOr(left[i], right[i])
+                                               : mkXor(left[i], right[i]);
+    return bits;
+  }
+
+  case Expr::Shl:
+    return shift(left, right, true, False);
+  case Expr::LShr:
+    return shift(left, right, false, False);
+  case Expr::AShr:
+    return shift(left, right, false, left.back());
+
+  case Expr::Eq:
+    return Bits(1, eq(left, right));
+  case Expr::Ne:
+    return Bits(1, -eq(left, right));
+  case Expr::Ult:
+    return Bits(1, ult(left, right, false));
+  case Expr::Ule:
+    return Bits(1, ult(left, right, true));
+  case Expr::Ugt:
+    return Bits(1, ult(right, left, false));
+  case Expr::Uge:
+    return Bits(1, ult(right, left, true));
+  case Expr::Slt:
+    return Bits(1, slt(left, right, false));
+  case Expr::Sle:
+    return Bits(1, slt(left, right, true));
+  case Expr::Sgt:
+    return Bits(1, slt(right, left, false));
+  case Expr::Sge:
+    return Bits(1, slt(right, left, true));
+
+  default:
+    llvm_unreachable("unhandled expression kind");
+  }
+}
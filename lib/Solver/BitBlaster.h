@@ -0,0 +1,115 @@
+//===-- BitBlaster.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BITBLASTER_H
+#define KLEE_BITBLASTER_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <deque>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+
+/// Translates expressions to propositional clauses, for a SAT solver.
+///
+/// Literals are DIMACS style: variables are numbered from 1 and a negative
+/// literal is the negation of its variable. Variable 1 is true, asserted by
+/// the first clause.
+///
+/// The bits of every expression encoded are kept, so that encoding a query
+/// sharing subexpressions with an earlier one only adds the clauses of the
+/// new subexpressions. The clauses only define the bits in terms of the
+/// bytes of the arrays, and do not constrain the arrays by themselves:
+/// they can all be added to a single solver, and a query asserted by
+/// assuming the literals of its formulas.
+///
+/// Reads outside of an array give zero, as they do under an Assignment.
+/// Division by zero follows SMT-LIB: the quotient is all ones and the
+/// remainder the dividend.
+class BitBlaster {
+public:
+  typedef int Literal;
+  typedef std::vector<Literal> Bits;
+
+  /// Receives the clauses as they are generated.
+  class ClauseSink {
+  public:
+    virtual ~ClauseSink() {}
+    virtual void addClause(const Literal *literals, unsigned count) = 0;
+  };
+
+  static constexpr Literal True = 1;
+  static constexpr Literal False = -1;
+
+private:
+  ClauseSink &sink;
+  int variables;
+
+  /// The bits of the expressions encoded, least significant first, kept
+  /// apart from the table so that they do not move as it grows.
+  std::deque<Bits> encodings;
+  ExprHashMap<const Bits *> cache;
+  /// The bits of the bytes of each symbolic array, zero for the bytes no
+  /// expression read so far.
+  std::unordered_map<const Array *, Bits> arrayBits;
+
+  Literal newVariable() { return ++variables; }
+  void addClause(std::initializer_list<Literal> literals) {
+    sink.addClause(literals.begin(), literals.size());
+  }
+
+  Literal mkAnd(Literal a, Literal b);
+  Literal mkOr(Literal a, Literal b) { return -mkAnd(-a, -b); }
+  Literal mkXor(Literal a, Literal b);
+  Literal mkIte(Literal c, Literal t, Literal e);
+
+  Bits constant(uint64_t value, unsigned width);
+  Bits constant(const ConstantExpr &ce);
+  Bits ite(Literal c, const Bits &t, const Bits &e);
+  Bits add(const Bits &a, const Bits &b, Literal carry = False,
+           Literal *carryOut = nullptr);
+  Bits negate(const Bits &a);
+  Bits mul(const Bits &a, const Bits &b);
+  void udivrem(const Bits &a, const Bits &b, Bits &quotient, Bits &remainder);
+  Bits shift(const Bits &a, const Bits &amount, bool left, Literal fill);
+  Literal eq(const Bits &a, const Bits &b);
+  Literal ult(const Bits &a, const Bits &b, bool orEqual);
+  Literal slt(const Bits &a, const Bits &b, bool orEqual);
+
+  Bits rootByte(const Array *array, uint64_t index);
+  Bits rootRead(const Array *array, const Bits &index);
+  Bits read(const ReadExpr &re);
+
+  Bits construct(const ref<Expr> &e);
+
+public:
+  explicit BitBlaster(ClauseSink &sink);
+  BitBlaster(const BitBlaster &) = delete;
+  BitBlaster &operator=(const BitBlaster &) = delete;
+
+  /// Returns the bits of \a e, least significant first, adding the clauses
+  /// defining them unless \a e was encoded before.
+  const Bits &blast(const ref<Expr> &e);
+
+  /// The number of variables the clauses use.
+  unsigned getNumVariables() const { return variables; }
+
+  /// Returns the bits of the bytes of a symbolic array, the range width of
+  /// the array per byte, or null if no expression read the array. The bits
+  /// of the bytes never read are zero: such bytes are unconstrained.
+  const Bits *getArrayBits(const Array *array) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_BITBLASTER_H */
@@ -0,0 +1,232 @@
+//===-- CaDiCaLSolver.cpp ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#include "klee/Config/config.h"
+
+#ifdef ENABLE_CADICAL
+#include "BitBlaster.h"
+#include "CaDiCaLSolver.h"
+#include "klee/Constraints.h"
+#include "klee/OptionCategories.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/Trace.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include "cadical.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace {
+llvm::cl::opt<unsigned> CaDiCaLMaxVariables(
+    "cadical-max-variables", llvm::cl::init(10000000),
+    llvm::cl::desc("Start over with an empty SAT solver, dropping the "
+                   "encoding of the earlier queries, once it uses this many "
+                   "variables (default=10000000)"),
+    llvm::cl::cat(klee::SolvingCat));
+}
+
+namespace klee {
+
+class CaDiCaLSolverImpl : public SolverImpl, public BitBlaster::ClauseSink {
+  /// Interrupts the search at a deadline.
+  class Deadline : public CaDiCaL::Terminator {
+  public:
+    time::Point point;
+    bool expired = false;
+
+    bool terminate() override {
+      expired = expired || time::getWallTime() > point;
+      return expired;
+    }
+  };
+
+  std::unique_ptr<CaDiCaL::Solver> sat;
+  std::unique_ptr<BitBlaster> blaster;
+  /// The greatest variable the clauses mention, which every variable the
+  /// SAT solver knows of is below.
+  int maxVariable;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+  std::vector<ref<Expr> > unsatCore;
+  bool hasUnsatCore;
+
+  void reset();
+  bool internalRunSolver(const Query &query,
+                         const std::vector<const Array *> *objects,
+                         std::vector<std::vector<unsigned char> > *values,
+                         bool &hasSolution);
+  bool isTrue(BitBlaster::Literal literal) {
+    return std::abs(literal) <= maxVariable && sat->val(literal) > 0;
+  }
+
+public:
+  CaDiCaLSolverImpl();
+
+  void addClause(const BitBlaster::Literal *literals,
+                 unsigned count) override {
+    for (unsigned i = 0; i != count; ++i) {
+      maxVariable = std::max(maxVariable, std::abs(literals[i]));
+      sat->add(literals[i]);
+    }
+    sat->add(0);
+  }
+
+  void setCoreSolverTimeout(time::Span timeout) override {
+    this->timeout = timeout;
+  }
+  bool computeTruth(const Query &, bool &isValid) override;
+  bool computeValue(const Query &, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) override {
+    return internalRunSolver(query, &objects, &values, hasSolution);
+  }
+  bool getUnsatCore(std::vector<ref<Expr> > &core) override {
+    if (!hasUnsatCore)
+      return false;
+    core = unsatCore;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() override { return runStatusCode; }
+};
+
+CaDiCaLSolverImpl::CaDiCaLSolverImpl()
+    : runStatusCode(SOLVER_RUN_STATUS_FAILURE), hasUnsatCore(false) {
+  reset();
+}
+
+void CaDiCaLSolverImpl::reset() {
+  // the blaster asserts its true literal into the new solver
+  blaster.reset();
+  maxVariable = 0;
+  sat.reset(new CaDiCaL::Solver());
+  blaster.reset(new BitBlaster(*this));
+}
+
+bool CaDiCaLSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  bool hasSolution = false;
+  bool status =
+      internalRunSolver(query, /*objects=*/NULL, /*values=*/NULL, hasSolution);
+  isValid = !hasSolution;
+  return status;
+}
+
+bool CaDiCaLSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  // Find the object used in the expression, and compute an assignment
+  // for them.
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+
+  return true;
+}
+
+bool CaDiCaLSolverImpl::internalRunSolver(
+    const Query &query, const std::vector<const Array *> *objects,
+    std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
+  KLEE_TRACE_SCOPE("CaDiCaLSolver");
+  TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  hasUnsatCore = false;
+  ++stats::queries;
+  if (objects)
+    ++stats::queryCounterexamples;
+
+  if (blaster->getNumVariables() > CaDiCaLMaxVariables)
+    reset();
+
+  // The clauses only define the literals of the formulas, which the query
+  // asserts as assumptions: the constraints and the negated query
+  // expression, in this order.
+  std::vector<BitBlaster::Literal> assumptions;
+  for (auto const &constraint : query.constraints)
+    assumptions.push_back(blaster->blast(constraint)[0]);
+  assumptions.push_back(-blaster->blast(query.expr)[0]);
+  for (BitBlaster::Literal literal : assumptions)
+    sat->assume(literal);
+
+  Deadline deadline;
+  if (timeout) {
+    deadline.point = time::getWallTime() + timeout;
+    sat->connect_terminator(&deadline);
+  }
+  int result = sat->solve();
+  if (timeout)
+    sat->disconnect_terminator();
+
+  if (result == 10) {
+    hasSolution = true;
+    if (objects) {
+      values->clear();
+      values->reserve(objects->size());
+      for (const Array *array : *objects) {
+        std::vector<unsigned char> data(array->size, 0);
+        if (array->isConstantArray()) {
+          for (unsigned i = 0; i != array->size; ++i)
+            data[i] = array->constantValues[i]->getZExtValue(8);
+        } else if (const BitBlaster::Bits *bits =
+                       blaster->getArrayBits(array)) {
+          // the bytes no expression reads are free, and left zero
+          unsigned range = array->getRange();
+          for (unsigned i = 0; i != array->size; ++i)
+            for (unsigned j = 0; j != range && j != 8; ++j)
+              if ((*bits)[i * range + j] && isTrue((*bits)[i * range + j]))
+                data[i] |= 1 << j;
+        }
+        values->push_back(std::move(data));
+      }
+    }
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+    ++stats::queriesInvalid;
+    return true;
+  }
+
+  if (result == 20) {
+    hasSolution = false;
+    unsatCore.clear();
+    unsigned i = 0;
+    for (auto const &constraint : query.constraints)
+      if (sat->failed(assumptions[i++]))
+        unsatCore.push_back(constraint);
+    if (sat->failed(assumptions[i]))
+      unsatCore.push_back(Expr::createIsZero(query.expr));
+    hasUnsatCore = true;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+    ++stats::queriesValid;
+    return true;
+  }
+
+  runStatusCode =
+      deadline.expired ? SOLVER_RUN_STATUS_TIMEOUT : SOLVER_RUN_STATUS_FAILURE;
+  return false;
+}
+
+CaDiCaLSolver::CaDiCaLSolver() : Solver(new CaDiCaLSolverImpl()) {}
+
+void CaDiCaLSolver::setCoreSolverTimeout(time::Span timeout) {
+  impl->setCoreSolverTimeout(timeout);
+}
+}
+#endif // ENABLE_CADICAL
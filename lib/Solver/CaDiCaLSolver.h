@@ -0,0 +1,34 @@
+//===-- CaDiCaLSolver.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CADICALSOLVER_H
+#define KLEE_CADICALSOLVER_H
+
+#include "klee/Solver.h"
+
+namespace klee {
+/// CaDiCaLSolver - A complete solver bit-blasting the queries to the
+/// CaDiCaL SAT solver.
+///
+/// A single SAT solver is kept across queries, holding the clauses of every
+/// expression encoded so far, and each query is solved by assuming the
+/// literals of its formulas. The expressions a query shares with earlier
+/// ones, such as the constraints of sibling states, are thus encoded once.
+class CaDiCaLSolver : public Solver {
+public:
+  CaDiCaLSolver();
+
+  /// setCoreSolverTimeout - Set constraint solver timeout delay to the given
+  /// value; 0
+  /// is off.
+  virtual void setCoreSolverTimeout(time::Span timeout);
+};
+}
+
+#endif /* KLEE_CADICALSOLVER_H */
@@ -0,0 +1,74 @@
+//===-- CacheGenerations.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CacheGenerations.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+std::vector<CacheGenerations *> &getCaches() {
+  static std::vector<CacheGenerations *> caches;
+  return caches;
+}
+} // namespace
+
+CacheGenerations::CacheGenerations(const char *name, uint64_t budget)
+    : name(name), budget(budget), generation(0), youngBytes(0), oldBytes(0),
+      lookups(0), youngHits(0), oldHits(0) {
+  getCaches().push_back(this);
+}
+
+CacheGenerations::~CacheGenerations() {
+  std::vector<CacheGenerations *> &caches = getCaches();
+  caches.erase(std::find(caches.begin(), caches.end(), this));
+}
+
+void CacheGenerations::age() {
+  uint64_t hits = youngHits + oldHits;
+  klee_message("NOTE: %s generation %u: %.1f%% hits over %llu lookups "
+               "(%.1f%% from the previous generation), dropping %llu KiB",
+               name, generation, lookups ? 100.0 * hits / lookups : 0.0,
+               (unsigned long long)lookups,
+               hits ? 100.0 * oldHits / hits : 0.0,
+               (unsigned long long)(oldBytes >> 10));
+  oldBytes = dropOldGeneration();
+  youngBytes = 0;
+  ++generation;
+  lookups = youngHits = oldHits = 0;
+}
+
+uint64_t klee::getSolverCacheMemoryUsage() {
+  uint64_t bytes = 0;
+  for (CacheGenerations *cache : getCaches())
+    bytes += cache->getMemoryUsage();
+  return bytes;
+}
+
+uint64_t klee::shrinkSolverCaches(uint64_t bytes) {
+  // the old generations of all caches go first, then the young ones
+  uint64_t freed = 0;
+  for (unsigned round = 0; round != 2; ++round) {
+    for (CacheGenerations *cache : getCaches()) {
+      if (freed >= bytes)
+        return freed;
+      uint64_t before = cache->getMemoryUsage();
+      if (!before)
+        continue;
+      cache->age();
+      freed += before - std::min(before, cache->getMemoryUsage());
+    }
+  }
+  return freed;
+}
@@ -0,0 +1,78 @@
+//===-- CacheGenerations.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CACHEGENERATIONS_H
+#define KLEE_CACHEGENERATIONS_H
+
+#include <cstdint>
+
+namespace klee {
+
+/// The memory accounting and eviction of a query cache whose entries are
+/// kept in two generations.
+///
+/// New entries, and old entries found again, go to the young generation.
+/// Once the young generation uses half of the memory budget of the cache,
+/// the old generation is dropped and the young one becomes old. An entry
+/// thus stays while it is used about once per generation, which
+/// approximates LRU eviction without any bookkeeping on a young hit.
+///
+/// The caches are registered while they live, so that the executor can
+/// shed their memory before killing states, see shrinkSolverCaches().
+class CacheGenerations {
+  const char *name;
+  uint64_t budget;
+  unsigned generation;
+  uint64_t youngBytes, oldBytes;
+  /// The lookups since the young generation started, and the hits served
+  /// by each generation.
+  uint64_t lookups, youngHits, oldHits;
+
+protected:
+  /// Drops the entries of the old generation and makes the young ones old.
+  /// Returns the bytes still held, which are now all old.
+  virtual uint64_t dropOldGeneration() = 0;
+
+  uint64_t getYoungBytes() const { return youngBytes; }
+
+  /// Accounts \a bytes added to the young generation, for a new entry or
+  /// an old one moved there. The old generation is dropped when the young
+  /// one is full, which callers must only allow when they hold no pointer
+  /// into the old generation, see checkBudget().
+  void addYoung(uint64_t bytes) { youngBytes += bytes; }
+  void removeOld(uint64_t bytes) {
+    oldBytes -= bytes < oldBytes ? bytes : oldBytes;
+  }
+
+  void recordLookup() { ++lookups; }
+  void recordYoungHit() { ++youngHits; }
+  void recordOldHit() { ++oldHits; }
+
+  /// Drops the old generation if the young one is over its budget.
+  void checkBudget() {
+    if (budget && youngBytes > budget / 2)
+      age();
+  }
+
+public:
+  /// \param budget The bytes the cache may use, or zero for no limit other
+  /// than the executor's memory cap.
+  CacheGenerations(const char *name, uint64_t budget);
+  virtual ~CacheGenerations();
+
+  uint64_t getMemoryUsage() const { return youngBytes + oldBytes; }
+
+  /// Drops the old generation, reporting the hit rate of the generation
+  /// which ends.
+  void age();
+};
+
+} // namespace klee
+
+#endif /* KLEE_CACHEGENERATIONS_H */
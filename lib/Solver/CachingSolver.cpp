@@ -10,13 +10,19 @@
 
 #include "klee/Solver.h"
 
+#include "CacheGenerations.h"
+
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/IncompleteSolver.h"
+#include "klee/Internal/Support/Trace.h"
+#include "klee/OptionCategories.h"
 #include "klee/SolverImpl.h"
 
 #include "klee/SolverStats.h"
 
+#include "llvm/Support/CommandLine.h"
+
 #include <ciso646>
 #ifdef _LIBCPP_VERSION
 #include <unordered_map>
@@ -28,7 +34,16 @@
 
 using namespace klee;
 
-class CachingSolver : public SolverImpl {
+namespace {
+llvm::cl::opt<unsigned> BranchCacheMaxMemory(
+    "branch-cache-max-memory", llvm::cl::init(0),
+    llvm::cl::desc("The memory the branch cache may use, in MB, before it "
+                   "evicts the entries least recently used (default=0 (no "
+                   "limit))"),
+    llvm::cl::cat(SolvingCat));
+}
+
+class CachingSolver : public SolverImpl, public CacheGenerations {
 private:
   ref<Expr> canonicalizeQuery(ref<Expr> originalQuery,
                               bool &negationUsed);
@@ -71,11 +86,27 @@ private:
                         CacheEntryHash> cache_map;
   
   Solver *solver;
-  cache_map cache;
+  /// The young and the old generation of the entries.
+  cache_map cache, oldCache;
+
+  /// The bytes an entry holds, counting the constraints it keeps alive as
+  /// if it were their last holder.
+  static uint64_t getEntryBytes(const CacheEntry &ce) {
+    return sizeof(cache_map::value_type) + 4 * sizeof(void *) +
+           ce.constraints.size() * sizeof(ref<Expr>);
+  }
+
+  uint64_t dropOldGeneration() {
+    oldCache.clear();
+    oldCache.swap(cache);
+    return getYoungBytes();
+  }
 
 public:
-  CachingSolver(Solver *s) : solver(s) {}
-  ~CachingSolver() { cache.clear(); delete solver; }
+  CachingSolver(Solver *s)
+      : CacheGenerations("branch cache", uint64_t(BranchCacheMaxMemory) << 20),
+        solver(s) {}
+  ~CachingSolver() { cache.clear(); oldCache.clear(); delete solver; }
 
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeTruth(const Query&, bool &isValid);
@@ -83,6 +114,11 @@ public:
     ++stats::queryCacheMisses;
     return solver->impl->computeValue(query, result);
   }
+  bool computeBound(const Query& query, bool maximize,
+                    ref<ConstantExpr> &result) {
+    ++stats::queryCacheMisses;
+    return solver->impl->computeBound(query, maximize, result);
+  }
   bool computeInitialValues(const Query& query,
                             const std::vector<const Array*> &objects,
                             std::vector< std::vector<unsigned char> > &values,
@@ -91,6 +127,15 @@ public:
     return solver->impl->computeInitialValues(query, objects, values, 
                                               hasSolution);
   }
+  bool computeUniqueValue(const Query& query,
+                          const std::vector<const Array*> &objects,
+                          std::vector< std::vector<unsigned char> > &values,
+                          std::vector< std::vector<unsigned char> > &otherValues,
+                          bool &isUnique) {
+    ++stats::queryCacheMisses;
+    return solver->impl->computeUniqueValue(query, objects, values,
+                                            otherValues, isUnique);
+  }
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(time::Span timeout);
@@ -121,16 +166,30 @@ bool CachingSolver::cacheLookup(const Query& query,
   ref<Expr> canonicalQuery = canonicalizeQuery(query.expr, negationUsed);
 
   CacheEntry ce(query.constraints, canonicalQuery);
+  recordLookup();
   cache_map::iterator it = cache.find(ce);
   
   if (it != cache.end()) {
-    result = (negationUsed ?
-              IncompleteSolver::negatePartialValidity(it->second) :
-              it->second);
-    return true;
+    recordYoungHit();
+  } else {
+    it = oldCache.find(ce);
+    if (it == oldCache.end())
+      return false;
+
+    // an entry found again moves to the young generation
+    recordOldHit();
+    uint64_t bytes = getEntryBytes(ce);
+    IncompleteSolver::PartialValidity cachedResult = it->second;
+    oldCache.erase(it);
+    removeOld(bytes);
+    it = cache.insert(std::make_pair(ce, cachedResult)).first;
+    addYoung(bytes);
   }
-  
-  return false;
+
+  result = (negationUsed ?
+            IncompleteSolver::negatePartialValidity(it->second) :
+            it->second);
+  return true;
 }
 
 /// Inserts the given query, result pair into the cache.
@@ -143,11 +202,14 @@ void CachingSolver::cacheInsert(const Query& query,
   IncompleteSolver::PartialValidity cachedResult = 
     (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
   
-  cache.insert(std::make_pair(ce, cachedResult));
+  if (cache.insert(std::make_pair(ce, cachedResult)).second)
+    addYoung(getEntryBytes(ce));
+  checkBudget();
 }
 
 bool CachingSolver::computeValidity(const Query& query,
                                     Solver::Validity &result) {
+  KLEE_TRACE_SCOPE("CachingSolver");
   IncompleteSolver::PartialValidity cachedResult;
   bool tmp, cacheHit = cacheLookup(query, cachedResult);
   
@@ -217,6 +279,7 @@ bool CachingSolver::computeValidity(const Query& query,
 
 bool CachingSolver::computeTruth(const Query& query,
                                  bool &isValid) {
+  KLEE_TRACE_SCOPE("CachingSolver");
   IncompleteSolver::PartialValidity cachedResult;
   bool cacheHit = cacheLookup(query, cachedResult);
 
@@ -0,0 +1,54 @@
+//===-- CanonicalCachingSolver.cpp - Renaming-invariant query cache -------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "KeyedCachingSolver.h"
+
+#include "klee/Solver.h"
+
+#include "klee/SolverStats.h"
+
+#include <string>
+#include <unordered_map>
+
+using namespace klee;
+
+namespace {
+
+/// Keeps the results of queries in memory, keyed by their serialization.
+/// As the serialization numbers the arrays in the order they are first
+/// read, queries which only differ in the names of their arrays (arr, arr_1,
+/// ...) share an entry, and the cached models, stored per object position,
+/// map back onto the arrays of the query looking them up.
+class CanonicalCachingSolver : public KeyedCachingSolver {
+  std::unordered_map<std::string, std::string> cache;
+
+protected:
+  bool lookup(const std::string &key, std::string &result) {
+    auto it = cache.find(key);
+    if (it == cache.end())
+      return false;
+    result = it->second;
+    return true;
+  }
+
+  void insert(const std::string &key, const std::string &result) {
+    cache.emplace(key, result);
+  }
+
+  void countHit() { ++stats::queryCanonicalCacheHits; }
+  void countMiss() { ++stats::queryCanonicalCacheMisses; }
+
+public:
+  CanonicalCachingSolver(Solver *s) : KeyedCachingSolver(s) {}
+};
+}
+
+Solver *klee::createCanonicalCachingSolver(Solver *s) {
+  return new Solver(new CanonicalCachingSolver(s));
+}
@@ -9,20 +9,27 @@
 
 #include "klee/Solver.h"
 
+#include "CacheGenerations.h"
+
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Internal/ADT/MapOfSets.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/OptionCategories.h"
 #include "klee/SolverImpl.h"
 #include "klee/SolverStats.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/AssignmentPool.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 
 #include "llvm/Support/CommandLine.h"
 
+#include <iterator>
+#include <unordered_set>
+
 using namespace klee;
 using namespace llvm;
 
@@ -45,6 +52,20 @@ cl::opt<bool>
                               "before asking the SMT solver (default=false)"),
                      cl::cat(SolvingCat));
 
+cl::opt<unsigned> CexCachePoolSize(
+    "cex-cache-pool-size", cl::init(0),
+    cl::desc("Before asking the SMT solver, try the given number of most "
+             "recently used counterexamples, evaluated all at once (default=0 "
+             "(off), max=64)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CexCacheMaxMemory(
+    "cex-cache-max-memory", cl::init(0),
+    cl::desc("The memory the counterexample cache may use, in MB, before it "
+             "evicts the entries least recently used (default=0 (no "
+             "limit))"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> CexCacheExperimental(
     "cex-cache-exp", cl::init(false),
     cl::desc("Optimization for validity queries (default=false)"),
@@ -63,14 +84,43 @@ struct AssignmentLessThan {
 };
 
 
-class CexCachingSolver : public SolverImpl {
+class CexCachingSolver : public SolverImpl, public CacheGenerations {
   typedef std::set<Assignment*, AssignmentLessThan> assignmentsTable_ty;
+  typedef MapOfSets<ref<Expr>, Assignment *> cache_ty;
 
   Solver *solver;
   
-  MapOfSets<ref<Expr>, Assignment*> cache;
-  // memo table
+  /// The young and the old generation of the keys.
+  cache_ty cache, oldCache;
+  // memo table, of the assignments of both generations
   assignmentsTable_ty assignmentsTable;
+  /// The assignments the young keys map to, which survive the next drop of
+  /// the old generation.
+  std::unordered_set<Assignment *> youngAssignments;
+  uint64_t youngKeyBytes;
+  // recently used assignments, owned by assignmentsTable
+  AssignmentPool recent;
+  /// The programs the assignments are evaluated with, dropped with the old
+  /// generation.
+  CompiledExprCache compiled;
+  uint64_t compiledBytes;
+
+  /// Accounts the programs compiled since the last call to the young
+  /// generation, then drops the old one if the young one is full.
+  void checkBudget() {
+    uint64_t bytes = compiled.getMemoryUsage();
+    if (bytes > compiledBytes)
+      addYoung(bytes - compiledBytes);
+    compiledBytes = bytes;
+    CacheGenerations::checkBudget();
+  }
+
+  /// Adds a key to the young generation.
+  void insert(const KeyType &key, Assignment *a);
+
+  uint64_t dropOldGeneration() override;
+
+  Assignment **searchCache(cache_ty &c, KeyType &key);
 
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
@@ -83,18 +133,41 @@ class CexCachingSolver : public SolverImpl {
   }
 
   bool getAssignment(const Query& query, Assignment *&result);
+
+  /// Memoizes the assignment computed for the key.
+  Assignment *addAssignment(const Query &query, const KeyType &key,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values);
+
+  static void getValues(const Assignment *a,
+                        const std::vector<const Array *> &objects,
+                        std::vector<std::vector<unsigned char> > &values);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver)
+      : CacheGenerations("counterexample cache",
+                         uint64_t(CexCacheMaxMemory) << 20),
+        solver(_solver), youngKeyBytes(0), recent(CexCachePoolSize),
+        compiledBytes(0) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeValue(const Query&, ref<Expr> &result);
+  bool computeBound(const Query& query, bool maximize,
+                    ref<ConstantExpr> &result) {
+    // a cached assignment gives a value, not a bound
+    return solver->impl->computeBound(query, maximize, result);
+  }
   bool computeInitialValues(const Query&,
                             const std::vector<const Array*> &objects,
                             std::vector< std::vector<unsigned char> > &values,
                             bool &hasSolution);
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query& query);
   void setCoreSolverTimeout(time::Span timeout);
@@ -112,14 +185,97 @@ struct NonNullAssignment {
 
 struct NullOrSatisfyingAssignment {
   KeyType &key;
-  
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+  CompiledExprCache &compiled;
+
+  NullOrSatisfyingAssignment(KeyType &_key, CompiledExprCache &compiled)
+      : key(_key), compiled(compiled) {}
 
   bool operator()(Assignment *a) const { 
-    return !a || a->satisfies(key.begin(), key.end()); 
+    return !a || a->satisfies(key.begin(), key.end(), &compiled);
   }
 };
 
+/// The bytes a node of the key tries takes: a node of the map of children
+/// of its parent, holding its own map and value.
+static const uint64_t KeyNodeBytes = 4 * sizeof(void *) + sizeof(ref<Expr>) +
+                                     sizeof(std::map<ref<Expr>, int>) +
+                                     sizeof(Assignment *) + sizeof(void *);
+
+/// The bytes a key takes, if it shares no prefix with another key.
+static uint64_t getKeyBytes(const KeyType &key) {
+  return key.size() * KeyNodeBytes;
+}
+
+static uint64_t getAssignmentBytes(const Assignment &a) {
+  uint64_t bytes = sizeof(Assignment) + 4 * sizeof(void *);
+  for (auto const &binding : a.bindings)
+    bytes += sizeof(binding) + 4 * sizeof(void *) + binding.second.capacity();
+  return bytes;
+}
+
+void CexCachingSolver::insert(const KeyType &key, Assignment *a) {
+  cache.insert(key, a);
+  if (a)
+    youngAssignments.insert(a);
+  youngKeyBytes += getKeyBytes(key);
+  addYoung(getKeyBytes(key));
+}
+
+uint64_t CexCachingSolver::dropOldGeneration() {
+  oldCache.clear();
+  std::swap(oldCache, cache);
+
+  // The assignments only the dropped keys map to go with them.
+  uint64_t bytes = youngKeyBytes;
+  for (assignmentsTable_ty::iterator it = assignmentsTable.begin();
+       it != assignmentsTable.end();) {
+    Assignment *a = *it;
+    if (youngAssignments.count(a)) {
+      bytes += getAssignmentBytes(*a);
+      ++it;
+      continue;
+    }
+    recent.remove(a);
+    it = assignmentsTable.erase(it);
+    delete a;
+  }
+  youngAssignments.clear();
+  youngKeyBytes = 0;
+  compiled.clear();
+  compiledBytes = 0;
+  return bytes;
+}
+
+/// searchCache - Look for a cached solution for a query in one generation
+/// of the keys.
+Assignment **CexCachingSolver::searchCache(cache_ty &c, KeyType &key) {
+  Assignment **lookup = c.lookup(key);
+  if (lookup)
+    return lookup;
+
+  // FIXME: Which order? one is sure to be better.
+
+  // Look for a satisfying assignment for a superset, which is trivially an
+  // assignment for any subset.
+  if (CexCacheSuperSet)
+    lookup = c.findSuperset(key, NonNullAssignment());
+
+  // Otherwise, look for a subset which is unsatisfiable -- if the subset is
+  // unsatisfiable then no additional constraints can produce a valid
+  // assignment. While searching subsets, we also explicitly the solutions for
+  // satisfiable subsets to see if they solve the current query and return
+  // them if so. This is cheap and frequently succeeds. With
+  // --cex-cache-try-all, all the assignments are tried afterwards anyway.
+  if (!lookup) {
+    if (CexCacheTryAll)
+      lookup = c.findSubset(key, NullAssignment());
+    else
+      lookup = c.findSubset(key, NullOrSatisfyingAssignment(key, compiled));
+  }
+
+  return lookup;
+}
+
 /// searchForAssignment - Look for a cached solution for a query.
 ///
 /// \param key - The query to look up.
@@ -128,64 +284,41 @@ struct NullOrSatisfyingAssignment {
 /// unsatisfiable query).
 /// \return - True if a cached result was found.
 bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
-  Assignment * const *lookup = cache.lookup(key);
-  if (lookup) {
+  recordLookup();
+  if (Assignment **lookup = searchCache(cache, key)) {
+    recordYoungHit();
     result = *lookup;
     return true;
   }
 
-  if (CexCacheTryAll) {
-    // Look for a satisfying assignment for a superset, which is trivially an
-    // assignment for any subset.
-    Assignment **lookup = 0;
-    if (CexCacheSuperSet)
-      lookup = cache.findSuperset(key, NonNullAssignment());
-
-    // Otherwise, look for a subset which is unsatisfiable, see below.
-    if (!lookup) 
-      lookup = cache.findSubset(key, NullAssignment());
-
-    // If either lookup succeeded, then we have a cached solution.
-    if (lookup) {
-      result = *lookup;
-      return true;
-    }
-
-    // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
+  bool found = false;
+  if (Assignment **lookup = searchCache(oldCache, key)) {
+    result = *lookup;
+    found = true;
+  } else if (CexCacheTryAll) {
+    // Iterate through the set of current assignments to see if one of them
+    // satisfies the query.
     for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
            ie = assignmentsTable.end(); it != ie; ++it) {
       Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
+      if (a->satisfies(key.begin(), key.end(), &compiled)) {
         result = a;
-        return true;
+        found = true;
+        break;
       }
     }
-  } else {
-    // FIXME: Which order? one is sure to be better.
-
-    // Look for a satisfying assignment for a superset, which is trivially an
-    // assignment for any subset.
-    Assignment **lookup = 0;
-    if (CexCacheSuperSet)
-      lookup = cache.findSuperset(key, NonNullAssignment());
-
-    // Otherwise, look for a subset which is unsatisfiable -- if the subset is
-    // unsatisfiable then no additional constraints can produce a valid
-    // assignment. While searching subsets, we also explicitly the solutions for
-    // satisfiable subsets to see if they solve the current query and return
-    // them if so. This is cheap and frequently succeeds.
-    if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
-
-    // If either lookup succeeded, then we have a cached solution.
-    if (lookup) {
-      result = *lookup;
+    if (found && youngAssignments.count(result)) {
+      recordYoungHit();
       return true;
     }
   }
-  
-  return false;
+  if (!found)
+    return false;
+
+  // a result found in the old generation moves to the young one
+  recordOldHit();
+  insert(key, result);
+  return true;
 }
 
 /// lookupAssignment - Lookup a cached result for the given \arg query.
@@ -221,8 +354,29 @@ bool CexCachingSolver::lookupAssignment(const Query &query,
 
 bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   KeyType key;
-  if (lookupAssignment(query, key, result))
+  if (lookupAssignment(query, key, result)) {
+    if (result)
+      recent.add(result);
     return true;
+  }
+
+  // Try the recently used assignments. Check the query expression first and
+  // then the newest constraints, which are the ones most likely to fail.
+  if (!recent.empty()) {
+    typedef std::reverse_iterator<ConstraintManager::constraint_iterator>
+        newest_first;
+    ref<Expr> neg = Expr::createIsZero(query.expr);
+    if (isa<ConstantExpr>(neg))
+      neg = ref<Expr>();
+    if (Assignment *a = recent.findSatisfying(
+            neg, newest_first(query.constraints.end()),
+            newest_first(query.constraints.begin()))) {
+      ++stats::queryCexPoolHits;
+      result = a;
+      insert(key, a);
+      return true;
+    }
+  }
 
   std::vector<const Array*> objects;
   findSymbolicObjects(key.begin(), key.end(), objects);
@@ -235,36 +389,78 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
     
   Assignment *binding;
   if (hasSolution) {
-    binding = new Assignment(objects, values);
-
-    // Memoize the result.
-    std::pair<assignmentsTable_ty::iterator, bool>
-      res = assignmentsTable.insert(binding);
-    if (!res.second) {
-      delete binding;
-      binding = *res.first;
-    }
-    
-    if (DebugCexCacheCheckBinding)
-      if (!binding->satisfies(key.begin(), key.end())) {
-        query.dump();
-        binding->dump();
-        klee_error("Generated assignment doesn't match query");
-      }
+    binding = addAssignment(query, key, objects, values);
   } else {
     binding = (Assignment*) 0;
+
+    // The queries containing the conflicting subset are unsatisfiable too,
+    // which the subset lookups find.
+    std::vector< ref<Expr> > core;
+    if (solver->impl->getUnsatCore(core)) {
+      KeyType coreKey(core.begin(), core.end());
+      coreKey.erase(ConstantExpr::alloc(1, Expr::Bool));
+      if (!coreKey.empty() && coreKey.size() < key.size()) {
+        ++stats::queryCexCores;
+        insert(coreKey, binding);
+      }
+    }
   }
   
   result = binding;
-  cache.insert(key, binding);
+  insert(key, binding);
 
   return true;
 }
 
+Assignment *CexCachingSolver::addAssignment(
+    const Query &query, const KeyType &key,
+    const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values) {
+  Assignment *binding = new Assignment(objects, values);
+
+  // Memoize the result.
+  std::pair<assignmentsTable_ty::iterator, bool>
+    res = assignmentsTable.insert(binding);
+  if (!res.second) {
+    delete binding;
+    binding = *res.first;
+  } else {
+    addYoung(getAssignmentBytes(*binding));
+  }
+
+  if (DebugCexCacheCheckBinding)
+    if (!binding->satisfies(key.begin(), key.end(), &compiled)) {
+      query.dump();
+      binding->dump();
+      klee_error("Generated assignment doesn't match query");
+    }
+  recent.add(binding);
+  return binding;
+}
+
+void CexCachingSolver::getValues(
+    const Assignment *a, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values) {
+  // FIXME: We should use smarter assignment for result so we don't
+  // need redundant copy.
+  values = std::vector< std::vector<unsigned char> >(objects.size());
+  for (unsigned i=0; i < objects.size(); ++i) {
+    const Array *os = objects[i];
+    Assignment::bindings_ty::const_iterator it = a->bindings.find(os);
+    
+    if (it == a->bindings.end()) {
+      values[i] = std::vector<unsigned char>(os->size, 0);
+    } else {
+      values[i] = it->second;
+    }
+  }
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
   cache.clear();
+  oldCache.clear();
   delete solver;
   for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
          ie = assignmentsTable.end(); it != ie; ++it)
@@ -273,12 +469,14 @@ CexCachingSolver::~CexCachingSolver() {
 
 bool CexCachingSolver::computeValidity(const Query& query,
                                        Solver::Validity &result) {
+  KLEE_TRACE_SCOPE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
+  checkBudget();
   Assignment *a;
   if (!getAssignment(query.withFalse(), a))
     return false;
   assert(a && "computeValidity() must have assignment");
-  ref<Expr> q = a->evaluate(query.expr);
+  ref<Expr> q = a->evaluate(query.expr, &compiled);
   assert(isa<ConstantExpr>(q) && 
          "assignment evaluation did not result in constant");
 
@@ -297,7 +495,9 @@ bool CexCachingSolver::computeValidity(const Query& query,
 
 bool CexCachingSolver::computeTruth(const Query& query,
                                     bool &isValid) {
+  KLEE_TRACE_SCOPE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
+  checkBudget();
 
   // There is a small amount of redundancy here. We only need to know
   // truth and do not really need to compute an assignment. This means
@@ -324,13 +524,15 @@ bool CexCachingSolver::computeTruth(const Query& query,
 
 bool CexCachingSolver::computeValue(const Query& query,
                                     ref<Expr> &result) {
+  KLEE_TRACE_SCOPE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
+  checkBudget();
 
   Assignment *a;
   if (!getAssignment(query.withFalse(), a))
     return false;
   assert(a && "computeValue() must have assignment");
-  result = a->evaluate(query.expr);  
+  result = a->evaluate(query.expr, &compiled);  
   assert(isa<ConstantExpr>(result) && 
          "assignment evaluation did not result in constant");
   return true;
@@ -343,7 +545,9 @@ CexCachingSolver::computeInitialValues(const Query& query,
                                        std::vector< std::vector<unsigned char> >
                                          &values,
                                        bool &hasSolution) {
+  KLEE_TRACE_SCOPE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
+  checkBudget();
   Assignment *a;
   if (!getAssignment(query, a))
     return false;
@@ -352,20 +556,57 @@ CexCachingSolver::computeInitialValues(const Query& query,
   if (!a)
     return true;
 
-  // FIXME: We should use smarter assignment for result so we don't
-  // need redundant copy.
-  values = std::vector< std::vector<unsigned char> >(objects.size());
-  for (unsigned i=0; i < objects.size(); ++i) {
-    const Array *os = objects[i];
-    Assignment::bindings_ty::iterator it = a->bindings.find(os);
-    
-    if (it == a->bindings.end()) {
-      values[i] = std::vector<unsigned char>(os->size, 0);
-    } else {
-      values[i] = it->second;
-    }
+  getValues(a, objects, values);
+  return true;
+}
+
+bool CexCachingSolver::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  KLEE_TRACE_SCOPE("CexCachingSolver");
+  TimerStatIncrementer t(stats::cexCacheTime);
+  checkBudget();
+
+  // With a cached model of the constraints, the uniqueness is a plain
+  // truth query, which may well be cached too.
+  KeyType key;
+  Assignment *a, *other;
+  if (lookupAssignment(query.withFalse(), key, a)) {
+    assert(a && "computeUniqueValue() must have assignment");
+    recent.add(a);
+    ref<Expr> value = a->evaluate(query.expr, &compiled);
+    if (!getAssignment(query.withExpr(EqExpr::create(query.expr, value)),
+                       other))
+      return false;
+  } else {
+    // Otherwise ask both at once, and cache the two answers.
+    std::vector<ref<Expr> > exprs(key.begin(), key.end());
+    exprs.push_back(query.expr);
+    std::vector<const Array *> allObjects;
+    findSymbolicObjects(exprs.begin(), exprs.end(), allObjects);
+    std::vector<std::vector<unsigned char> > allValues, allOtherValues;
+    if (!solver->impl->computeUniqueValue(query, allObjects, allValues,
+                                          allOtherValues, isUnique))
+      return false;
+
+    a = addAssignment(query, key, allObjects, allValues);
+    insert(key, a);
+    ref<Expr> value = a->evaluate(query.expr, &compiled);
+    assert(isa<ConstantExpr>(value) &&
+           "assignment evaluation did not result in constant");
+    KeyType otherKey(key);
+    otherKey.insert(Expr::createIsZero(EqExpr::create(query.expr, value)));
+    other = isUnique ? (Assignment *)0
+                     : addAssignment(query, otherKey, allObjects,
+                                     allOtherValues);
+    insert(otherKey, other);
   }
-  
+
+  isUnique = !other;
+  getValues(a, objects, values);
+  if (other)
+    getValues(other, objects, otherValues);
   return true;
 }
 
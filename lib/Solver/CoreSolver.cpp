@@ -7,6 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "CaDiCaLSolver.h"
 #include "STPSolver.h"
 #include "Z3Solver.h"
 #include "MetaSMTSolver.h"
@@ -16,6 +17,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include <string>
+#include <vector>
 
 namespace klee {
 
@@ -24,6 +26,10 @@ Solver *createCoreSolver(CoreSolverType cst) {
   case STP_SOLVER:
 #ifdef ENABLE_STP
     klee_message("Using STP solver backend");
+    if (UseForkedCoreSolver && SolverWorkers)
+      return createWorkerPoolSolver(
+          new STPSolver(false, CoreSolverOptimizeDivides), SolverWorkers,
+          SpeculativeQueries);
     return new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides);
 #else
     klee_message("Not compiled with STP support");
@@ -47,6 +53,50 @@ Solver *createCoreSolver(CoreSolverType cst) {
     klee_message("Not compiled with Z3 support");
     return NULL;
 #endif
+  case CADICAL_SOLVER:
+#ifdef ENABLE_CADICAL
+    klee_message("Using CaDiCaL solver backend");
+    return new CaDiCaLSolver();
+#else
+    klee_message("Not compiled with CaDiCaL support");
+    return NULL;
+#endif
+  case PORTFOLIO_SOLVER: {
+    std::vector<CoreSolverType> types(PortfolioSolvers.begin(),
+                                      PortfolioSolvers.end());
+    if (types.empty()) {
+#ifdef ENABLE_STP
+      types.push_back(STP_SOLVER);
+#endif
+#ifdef ENABLE_Z3
+      types.push_back(Z3_SOLVER);
+#endif
+#ifdef ENABLE_METASMT
+      types.push_back(METASMT_SOLVER);
+#endif
+#ifdef ENABLE_CADICAL
+      types.push_back(CADICAL_SOLVER);
+#endif
+    }
+    std::vector<std::pair<std::string, Solver *> > backends;
+    for (CoreSolverType type : types) {
+      Solver *backend = createCoreSolver(type);
+      if (!backend)
+        continue;
+      const char *name =
+          type == STP_SOLVER
+              ? "stp"
+              : type == Z3_SOLVER
+                    ? "z3"
+                    : type == CADICAL_SOLVER ? "cadical" : "metasmt";
+      backends.push_back(std::make_pair(name, backend));
+    }
+    if (backends.empty())
+      return NULL;
+    klee_message("Using portfolio solver with %u backends",
+                 (unsigned)backends.size());
+    return createPortfolioSolver(backends);
+  }
   case NO_SOLVER:
     klee_message("Invalid solver");
     return NULL;
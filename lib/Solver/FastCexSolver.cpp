@@ -342,12 +342,10 @@ public:
   }
 };
 
+/// Evaluates ranges independently of the values propagated for a query, so
+/// that one evaluator, and the ranges it caches, serves all queries.
 class CexRangeEvaluator : public ExprRangeEvaluator<ValueRange> {
 public:
-  std::map<const Array*, CexObjectData*> &objects;
-  CexRangeEvaluator(std::map<const Array*, CexObjectData*> &_objects) 
-    : objects(_objects) {}
-
   ValueRange getInitialReadRange(const Array &array, ValueRange index) {
     // Check for a concrete read of a constant array.
     if (array.isConstantArray() && 
@@ -411,12 +409,13 @@ public:
 class CexData {
 public:
   std::map<const Array*, CexObjectData*> objects;
+  CexRangeEvaluator &ranges;
 
   CexData(const CexData&); // DO NOT IMPLEMENT
   void operator=(const CexData&); // DO NOT IMPLEMENT
 
 public:
-  CexData() {}
+  CexData(CexRangeEvaluator &_ranges) : ranges(_ranges) {}
   ~CexData() {
     for (std::map<const Array*, CexObjectData*>::iterator it = objects.begin(),
            ie = objects.end(); it != ie; ++it)
@@ -454,6 +453,10 @@ public:
 
     case Expr::NotOptimized: break;
 
+    case Expr::WideRead:
+      propogatePossibleValues(cast<WideReadExpr>(e)->lower(), range);
+      break;
+
     case Expr::Read: {
       ReadExpr *re = cast<ReadExpr>(e);
       const Array *array = re->updates.root;
@@ -791,6 +794,10 @@ public:
 
     case Expr::NotOptimized: break;
 
+    case Expr::WideRead:
+      propogateExactValues(cast<WideReadExpr>(e)->lower(), range);
+      break;
+
     case Expr::Read: {
       ReadExpr *re = cast<ReadExpr>(e);
       const Array *array = re->updates.root;
@@ -921,8 +928,7 @@ public:
   }
 
   ValueRange evalRangeForExpr(const ref<Expr> &e) {
-    CexRangeEvaluator ce(objects);
-    return ce.evaluate(e);
+    return ranges.evaluate(e);
   }
 
   /// evaluate - Try to evaluate the given expression using a consistent fixed
@@ -966,7 +972,16 @@ public:
 /* *** */
 
 
+/// The number of expression ranges cached before forgetting them all.
+static const size_t MaxCachedRanges = 1 << 16;
+
 class FastCexSolver : public IncompleteSolver {
+  CexRangeEvaluator ranges;
+
+  /// Returns the range evaluator for a new query, bounding the number of
+  /// ranges (and expressions) it keeps.
+  CexRangeEvaluator &getRanges();
+
 public:
   FastCexSolver();
   ~FastCexSolver();
@@ -983,6 +998,12 @@ FastCexSolver::FastCexSolver() { }
 
 FastCexSolver::~FastCexSolver() { }
 
+CexRangeEvaluator &FastCexSolver::getRanges() {
+  if (ranges.getCacheSize() > MaxCachedRanges)
+    ranges.clearCache();
+  return ranges;
+}
+
 /// propogateValues - Propogate value ranges for the given query and return the
 /// propogation results.
 ///
@@ -1047,7 +1068,7 @@ static bool propogateValues(const Query& query, CexData &cd,
 
 IncompleteSolver::PartialValidity 
 FastCexSolver::computeTruth(const Query& query) {
-  CexData cd;
+  CexData cd(getRanges());
 
   bool isValid;
   bool success = propogateValues(query, cd, true, isValid);
@@ -1059,7 +1080,7 @@ FastCexSolver::computeTruth(const Query& query) {
 }
 
 bool FastCexSolver::computeValue(const Query& query, ref<Expr> &result) {
-  CexData cd;
+  CexData cd(getRanges());
 
   bool isValid;
   bool success = propogateValues(query, cd, false, isValid);
@@ -1091,7 +1112,7 @@ FastCexSolver::computeInitialValues(const Query& query,
                                     std::vector< std::vector<unsigned char> >
                                       &values,
                                     bool &hasSolution) {
-  CexData cd;
+  CexData cd(getRanges());
 
   bool isValid;
   bool success = propogateValues(query, cd, true, isValid);
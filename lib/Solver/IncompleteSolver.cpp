@@ -61,7 +61,8 @@ IncompleteSolver::computeValidity(const Query& query) {
 StagedSolverImpl::StagedSolverImpl(IncompleteSolver *_primary, 
                                    Solver *_secondary) 
   : primary(_primary),
-    secondary(_secondary) {
+    secondary(_secondary),
+    secondaryAnswered(false) {
 }
 
 StagedSolverImpl::~StagedSolverImpl() {
@@ -121,6 +122,19 @@ bool StagedSolverImpl::computeValue(const Query& query,
   return secondary->impl->computeValue(query, result);
 }
 
+bool StagedSolverImpl::computeBound(const Query& query, bool maximize,
+                                    ref<ConstantExpr> &result) {
+  return secondary->impl->computeBound(query, maximize, result);
+}
+
+bool StagedSolverImpl::computeUniqueValue(
+    const Query& query, const std::vector<const Array*> &objects,
+    std::vector< std::vector<unsigned char> > &values,
+    std::vector< std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  return secondary->impl->computeUniqueValue(query, objects, values,
+                                             otherValues, isUnique);
+}
+
 bool 
 StagedSolverImpl::computeInitialValues(const Query& query,
                                        const std::vector<const Array*> 
@@ -128,13 +142,19 @@ StagedSolverImpl::computeInitialValues(const Query& query,
                                        std::vector< std::vector<unsigned char> >
                                          &values,
                                        bool &hasSolution) {
+  secondaryAnswered = false;
   if (primary->computeInitialValues(query, objects, values, hasSolution))
     return true;
   
+  secondaryAnswered = true;
   return secondary->impl->computeInitialValues(query, objects, values,
                                                hasSolution);
 }
 
+bool StagedSolverImpl::getUnsatCore(std::vector<ref<Expr> > &core) {
+  return secondaryAnswered && secondary->impl->getUnsatCore(core);
+}
+
 SolverImpl::SolverRunStatus StagedSolverImpl::getOperationStatusCode() {
   return secondary->impl->getOperationStatusCode();
 }
@@ -13,16 +13,20 @@
 #include "klee/Expr.h"
 #include "klee/Constraints.h"
 #include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/Internal/Support/Debug.h"
+#include "klee/Internal/Support/Trace.h"
 
 #include "klee/util/ExprUtil.h"
 #include "klee/util/Assignment.h"
 
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <ostream>
 #include <list>
+#include <unordered_map>
 
 using namespace klee;
 using namespace llvm;
@@ -264,93 +268,43 @@ static std::list<IndependentElementSet>*
 getAllIndependentConstraintsSets(const Query &query) {
   std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
+  ref<Expr> neg;
   if (CE) {
     assert(CE && CE->isFalse() && "the expr should always be false and "
                                   "therefore not included in factors");
   } else {
-    ref<Expr> neg = Expr::createIsZero(query.expr);
-    factors->push_back(IndependentElementSet(neg));
+    neg = Expr::createIsZero(query.expr);
   }
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    // iterate through all the previously separated constraints.  Until we
-    // actually return, factors is treated as a queue of expressions to be
-    // evaluated.  If the queue property isn't maintained, then the exprs
-    // could be returned in an order different from how they came it, negatively
-    // affecting later stages.
-    factors->push_back(IndependentElementSet(*it));
-  }
-
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
-      }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
+  // The partition itself is maintained incrementally by the constraint
+  // manager; only the element sets of the factors are computed here.
+  std::vector<ConstraintManager::constraints_ty> partition;
+  query.constraints.getIndependentFactors(query.expr, partition);
+  for (unsigned i = 0; i != partition.size(); ++i) {
+    if (i == 0 && CE) {
+      assert(partition[0].empty() && "constant expr depends on constraints");
+      continue;
     }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
+    IndependentElementSet factor;
+    if (i == 0)
+      factor = IndependentElementSet(neg);
+    for (const ref<Expr> &c : partition[i])
+      factor.add(IndependentElementSet(c));
+    factors->push_back(factor);
+  }
 
   return factors;
 }
 
 static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
-  IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
-    }
-    worklist.swap(newWorklist);
-  } while (!done);
+void getIndependentConstraints(const Query& query,
+                               ConstraintManager &result) {
+  query.constraints.getIndependentConstraints(query.expr, result);
 
   KLEE_DEBUG(
+    IndependentElementSet eltsClosure(query.expr);
+    for (const ref<Expr> &c : result)
+      eltsClosure.add(IndependentElementSet(c));
     std::set< ref<Expr> > reqset(result.begin(), result.end());
     errs() << "--\n";
     errs() << "Q: " << query.expr << "\n";
@@ -364,9 +318,6 @@ IndependentElementSet getIndependentConstraints(const Query& query,
     }
     errs() << "elts closure: " << eltsClosure << "\n";
  );
-
-
-  return eltsClosure;
 }
 
 
@@ -390,18 +341,70 @@ void calculateArrayReferences(const IndependentElementSet & ie,
   }
 }
 
+/// The constraints of an independent factor, in a canonical order.
+struct FactorKey {
+  std::vector<ref<Expr> > constraints;
+  unsigned hash;
+
+  explicit FactorKey(const std::vector<ref<Expr> > &exprs)
+      : constraints(exprs), hash(0) {
+    std::sort(constraints.begin(), constraints.end());
+    constraints.erase(std::unique(constraints.begin(), constraints.end()),
+                      constraints.end());
+    for (const ref<Expr> &c : constraints)
+      hash = hash * Expr::MAGIC_HASH_CONSTANT + c->hash();
+  }
+
+  bool operator==(const FactorKey &b) const {
+    return hash == b.hash && constraints == b.constraints;
+  }
+};
+
+struct FactorKeyHash {
+  size_t operator()(const FactorKey &key) const { return key.hash; }
+};
+
+/// The solution of a factor, by array, or no arrays if it has none.
+struct FactorSolution {
+  bool hasSolution;
+  std::vector<std::pair<const Array *, std::vector<unsigned char> > > values;
+};
+
 class IndependentSolver : public SolverImpl {
 private:
   Solver *solver;
 
+  /// Solutions of the factors solved so far. Most queries for initial
+  /// values share all but one of their factors with an earlier query, so
+  /// only the new factors go to the underlying solver.
+  std::unordered_map<FactorKey, FactorSolution, FactorKeyHash> factorCache;
+  enum : unsigned { MaxFactorCacheSize = 1 << 14 };
+
+  /// The last query for initial values was answered from the factor cache
+  /// alone, with this status.
+  bool lastFromCache;
+  SolverRunStatus lastStatus;
+
+  bool solveFactor(const IndependentElementSet &factor,
+                   const std::vector<const Array *> &arrays,
+                   std::vector<std::vector<unsigned char> > &values,
+                   bool &hasSolution, bool &cached);
+
 public:
   IndependentSolver(Solver *_solver) 
-    : solver(_solver) {}
+    : solver(_solver), lastFromCache(false),
+      lastStatus(SOLVER_RUN_STATUS_FAILURE) {}
   ~IndependentSolver() { delete solver; }
 
   bool computeTruth(const Query&, bool &isValid);
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeValue(const Query&, ref<Expr> &result);
+  bool computeBound(const Query&, bool maximize, ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query& query,
+                          const std::vector<const Array*> &objects,
+                          std::vector< std::vector<unsigned char> > &values,
+                          std::vector< std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
   bool computeInitialValues(const Query& query,
                             const std::vector<const Array*> &objects,
                             std::vector< std::vector<unsigned char> > &values,
@@ -413,31 +416,52 @@ public:
   
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
-  std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
-  ConstraintManager tmp(required);
+  KLEE_TRACE_SCOPE("IndependentSolver");
+  lastFromCache = false;
+  ConstraintManager tmp;
+  getIndependentConstraints(query, tmp);
   return solver->impl->computeValidity(Query(tmp, query.expr), 
                                        result);
 }
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
-  std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
-  ConstraintManager tmp(required);
+  KLEE_TRACE_SCOPE("IndependentSolver");
+  lastFromCache = false;
+  ConstraintManager tmp;
+  getIndependentConstraints(query, tmp);
   return solver->impl->computeTruth(Query(tmp, query.expr), 
                                     isValid);
 }
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
-  std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
-  ConstraintManager tmp(required);
+  KLEE_TRACE_SCOPE("IndependentSolver");
+  lastFromCache = false;
+  ConstraintManager tmp;
+  getIndependentConstraints(query, tmp);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
 
+bool IndependentSolver::computeBound(const Query& query, bool maximize,
+                                     ref<ConstantExpr> &result) {
+  KLEE_TRACE_SCOPE("IndependentSolver");
+  lastFromCache = false;
+  ConstraintManager tmp;
+  getIndependentConstraints(query, tmp);
+  return solver->impl->computeBound(Query(tmp, query.expr), maximize, result);
+}
+
+bool IndependentSolver::computeUniqueValue(
+    const Query& query, const std::vector<const Array*> &objects,
+    std::vector< std::vector<unsigned char> > &values,
+    std::vector< std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  KLEE_TRACE_SCOPE("IndependentSolver");
+  lastFromCache = false;
+  ConstraintManager tmp;
+  getIndependentConstraints(query, tmp);
+  return solver->impl->computeUniqueValue(Query(tmp, query.expr), objects,
+                                          values, otherValues, isUnique);
+}
+
 // Helper function used only for assertions to make sure point created
 // during computeInitialValues is in fact correct. The ``retMap`` is used
 // in the case ``objects`` doesn't contain all the assignments needed.
@@ -472,14 +496,57 @@ bool assertCreatedPointEvaluatesToTrue(const Query &query,
   return cast<ConstantExpr>(q)->isTrue();
 }
 
+bool IndependentSolver::solveFactor(
+    const IndependentElementSet &factor,
+    const std::vector<const Array *> &arrays,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    bool &cached) {
+  FactorKey key(factor.exprs);
+  auto it = factorCache.find(key);
+  if (it != factorCache.end()) {
+    // Arrays are listed by address, and a factor reads the same arrays
+    // whenever its constraints are the same.
+    const FactorSolution &solution = it->second;
+    hasSolution = solution.hasSolution;
+    if (hasSolution) {
+      assert(solution.values.size() == arrays.size() && "arrays differ");
+      for (const auto &v : solution.values)
+        values.push_back(v.second);
+    }
+    cached = true;
+    ++stats::queryFactorCacheHits;
+    return true;
+  }
+
+  ++stats::queryFactorCacheMisses;
+  cached = false;
+  ConstraintManager tmp(factor.exprs);
+  if (!solver->impl->computeInitialValues(
+          Query(tmp, ConstantExpr::alloc(0, Expr::Bool)), arrays, values,
+          hasSolution))
+    return false;
+
+  if (factorCache.size() >= MaxFactorCacheSize)
+    factorCache.clear();
+  FactorSolution &solution = factorCache[key];
+  solution.hasSolution = hasSolution;
+  if (hasSolution)
+    for (unsigned i = 0; i != arrays.size(); ++i)
+      solution.values.push_back(std::make_pair(arrays[i], values[i]));
+  return true;
+}
+
 bool IndependentSolver::computeInitialValues(const Query& query,
                                              const std::vector<const Array*> &objects,
                                              std::vector< std::vector<unsigned char> > &values,
                                              bool &hasSolution){
+  KLEE_TRACE_SCOPE("IndependentSolver");
   // We assume the query has a solution except proven differently
   // This is important in case we don't have any constraints but
   // we need initial values for requested array objects.
   hasSolution = true;
+  lastFromCache = false;
+  bool allCached = true;
   // FIXME: When we switch to C++11 this should be a std::unique_ptr so we don't need
   // to remember to manually call delete
   std::list<IndependentElementSet> *factors = getAllIndependentConstraintsSets(query);
@@ -495,16 +562,19 @@ bool IndependentSolver::computeInitialValues(const Query& query,
     if (arraysInFactor.size() == 0){
       continue;
     }
-    ConstraintManager tmp(it->exprs);
     std::vector<std::vector<unsigned char> > tempValues;
-    if (!solver->impl->computeInitialValues(Query(tmp, ConstantExpr::alloc(0, Expr::Bool)),
-                                            arraysInFactor, tempValues, hasSolution)){
+    bool cached;
+    if (!solveFactor(*it, arraysInFactor, tempValues, hasSolution, cached)) {
       values.clear();
       delete factors;
       return false;
-    } else if (!hasSolution){
+    }
+    allCached &= cached;
+    if (!hasSolution) {
       values.clear();
       delete factors;
+      lastFromCache = cached;
+      lastStatus = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
       return true;
     } else {
       assert(tempValues.size() == arraysInFactor.size() &&
@@ -544,11 +614,15 @@ bool IndependentSolver::computeInitialValues(const Query& query,
   }
   assert(assertCreatedPointEvaluatesToTrue(query, objects, values, retMap) && "should satisfy the equation");
   delete factors;
+  lastFromCache = allCached;
+  lastStatus = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
   return true;
 }
 
 SolverImpl::SolverRunStatus IndependentSolver::getOperationStatusCode() {
-  return solver->impl->getOperationStatusCode();      
+  if (lastFromCache)
+    return lastStatus;
+  return solver->impl->getOperationStatusCode();
 }
 
 char *IndependentSolver::getConstraintLog(const Query& query) {
@@ -0,0 +1,124 @@
+//===-- KeyedCachingSolver.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "KeyedCachingSolver.h"
+
+#include <cstring>
+
+using namespace klee;
+
+KeyedCachingSolver::KeyedCachingSolver(Solver *s)
+    : lastStatus(SOLVER_RUN_STATUS_FAILURE), lastWasHit(false), solver(s) {}
+
+KeyedCachingSolver::~KeyedCachingSolver() { delete solver; }
+
+bool KeyedCachingSolver::computeValidity(const Query &query,
+                                         Solver::Validity &result) {
+  std::string key = getKey('V', query), cached;
+  if (lookup(key, cached) && cached.size() == 1) {
+    result = static_cast<Solver::Validity>(cached[0] - 1);
+    return hit(result == Solver::True ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                                      : SOLVER_RUN_STATUS_SUCCESS_SOLVABLE);
+  }
+
+  miss();
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  insert(key, std::string(1, static_cast<char>(result + 1)));
+  return true;
+}
+
+bool KeyedCachingSolver::computeTruth(const Query &query, bool &isValid) {
+  std::string key = getKey('T', query), cached;
+  if (lookup(key, cached) && cached.size() == 1) {
+    isValid = cached[0];
+    return hit(isValid ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                       : SOLVER_RUN_STATUS_SUCCESS_SOLVABLE);
+  }
+
+  miss();
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  insert(key, std::string(1, isValid));
+  return true;
+}
+
+bool KeyedCachingSolver::computeValue(const Query &query,
+                                      ref<Expr> &result) {
+  Expr::Width width = query.expr->getWidth();
+  unsigned numWords = llvm::APInt::getNumWords(width);
+  std::string key = getKey('E', query), cached;
+  if (lookup(key, cached) && cached.size() == numWords * sizeof(uint64_t)) {
+    std::vector<uint64_t> words(numWords);
+    memcpy(&words[0], cached.data(), cached.size());
+    result = ConstantExpr::alloc(llvm::APInt(width, words));
+    return hit(SOLVER_RUN_STATUS_SUCCESS_SOLVABLE);
+  }
+
+  miss();
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  if (ConstantExpr *ce = dyn_cast<ConstantExpr>(result)) {
+    const llvm::APInt &value = ce->getAPValue();
+    if (value.getBitWidth() == width)
+      insert(key, std::string(reinterpret_cast<const char *>(value.getRawData()),
+                              numWords * sizeof(uint64_t)));
+  }
+  return true;
+}
+
+bool KeyedCachingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  uint64_t totalSize = 0;
+  for (const Array *array : objects)
+    totalSize += array->size;
+
+  std::string key = getKey('I', query, &objects), cached;
+  if (lookup(key, cached) && !cached.empty()) {
+    if (cached[0] == 0 && cached.size() == 1) {
+      hasSolution = false;
+      return hit(SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE);
+    }
+    if (cached[0] == 1 && cached.size() == totalSize + 1) {
+      hasSolution = true;
+      values.clear();
+      const unsigned char *data =
+          reinterpret_cast<const unsigned char *>(cached.data()) + 1;
+      for (const Array *array : objects) {
+        values.push_back(std::vector<unsigned char>(data, data + array->size));
+        data += array->size;
+      }
+      return hit(SOLVER_RUN_STATUS_SUCCESS_SOLVABLE);
+    }
+  }
+
+  miss();
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+    return false;
+  std::string result(1, hasSolution);
+  if (hasSolution)
+    for (const std::vector<unsigned char> &v : values)
+      result.append(v.begin(), v.end());
+  if (!hasSolution || result.size() == totalSize + 1)
+    insert(key, result);
+  return true;
+}
+
+SolverImpl::SolverRunStatus KeyedCachingSolver::getOperationStatusCode() {
+  return lastWasHit ? lastStatus : solver->impl->getOperationStatusCode();
+}
+
+char *KeyedCachingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void KeyedCachingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
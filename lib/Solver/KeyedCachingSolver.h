@@ -0,0 +1,103 @@
+//===-- KeyedCachingSolver.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_KEYEDCACHINGSOLVER_H
+#define KLEE_KEYEDCACHINGSOLVER_H
+
+#include "QuerySerializer.h"
+
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+
+#include <string>
+#include <vector>
+
+namespace klee {
+
+/// Base class of the solvers which cache query results in a store, possibly
+/// shared with other runs, looked up by the MD5 digest of the serialized
+/// query. Results are encoded as byte strings which do not depend on the
+/// process that computed them, nor on the names of the arrays.
+class KeyedCachingSolver : public SolverImpl {
+  // status of the last operation if it was answered from the cache
+  SolverRunStatus lastStatus;
+  bool lastWasHit;
+
+  std::string getKey(char tag, const Query &query,
+                     const std::vector<const Array *> *objects = nullptr) {
+    QuerySerializer serializer;
+    serializer.writeTag(tag);
+    serializer.visit(query);
+    if (objects)
+      serializer.visitObjects(*objects);
+    return serializer.getKey();
+  }
+
+  bool hit(SolverRunStatus status) {
+    countHit();
+    lastWasHit = true;
+    lastStatus = status;
+    return true;
+  }
+
+  void miss() {
+    countMiss();
+    lastWasHit = false;
+  }
+
+protected:
+  Solver *solver;
+
+  /// Look up the result stored for \a key by any run.
+  virtual bool lookup(const std::string &key, std::string &result) = 0;
+  /// Store \a result for \a key. Losing a result only costs a later miss.
+  virtual void insert(const std::string &key, const std::string &result) = 0;
+
+  /// Called for each query answered from the store, right after the
+  /// lookup which found it.
+  virtual void countHit() = 0;
+  /// Called for each query passed on to the underlying solver.
+  virtual void countMiss() = 0;
+
+public:
+  KeyedCachingSolver(Solver *s);
+  ~KeyedCachingSolver();
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeBound(const Query &query, bool maximize,
+                    ref<ConstantExpr> &result) {
+    miss();
+    return solver->impl->computeBound(query, maximize, result);
+  }
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique) {
+    miss();
+    return solver->impl->computeUniqueValue(query, objects, values,
+                                            otherValues, isUnique);
+  }
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    // a cached answer comes without its core
+    return !lastWasHit && solver->impl->getUnsatCore(core);
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+}
+
+#endif
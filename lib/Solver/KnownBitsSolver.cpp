@@ -0,0 +1,649 @@
+//===-- KnownBitsSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/IncompleteSolver.h"
+#include "klee/SolverStats.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace klee;
+
+namespace {
+
+/// The bits of a value known to be zero or one, in the spirit of LLVM's
+/// KnownBits. Values wider than 64 bits are never known.
+struct KnownBits {
+  Expr::Width width;
+  uint64_t zeros, ones;
+
+  KnownBits() : width(0), zeros(0), ones(0) {}
+  KnownBits(Expr::Width width, uint64_t zeros, uint64_t ones)
+      : width(width), zeros(zeros & mask(width)), ones(ones & mask(width)) {}
+
+  static uint64_t mask(Expr::Width w) {
+    return w >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+  }
+
+  static KnownBits unknown(Expr::Width w) { return KnownBits(w, 0, 0); }
+
+  static KnownBits constant(Expr::Width w, uint64_t value) {
+    return KnownBits(w, ~value, value);
+  }
+
+  bool isTracked() const { return width && width <= 64; }
+  uint64_t known() const { return zeros | ones; }
+  bool isConstant() const { return isTracked() && known() == mask(width); }
+  bool isConflict() const { return zeros & ones; }
+
+  uint64_t umin() const { return ones; }
+  uint64_t umax() const { return ~zeros & mask(width); }
+
+  int64_t sext(uint64_t v) const {
+    return width == 64 ? (int64_t)v
+                       : (int64_t)(v << (64 - width)) >> (64 - width);
+  }
+  uint64_t signBit() const { return UINT64_C(1) << (width - 1); }
+  int64_t smin() const {
+    // the sign bit set unless known zero, all other unknown bits clear
+    return sext(zeros & signBit() ? ones : ones | signBit());
+  }
+  int64_t smax() const {
+    uint64_t v = umax();
+    return sext(ones & signBit() ? v : v & ~signBit());
+  }
+
+  /// Returns true if this was refined by \a other.
+  bool refine(const KnownBits &other) {
+    uint64_t oldZeros = zeros, oldOnes = ones;
+    zeros |= other.zeros;
+    ones |= other.ones;
+    return zeros != oldZeros || ones != oldOnes;
+  }
+};
+
+/// Forward and backward propagation of known bits over the expressions of a
+/// query. The constraints are propagated backwards from being true, which
+/// records the known bits of their subexpressions; evaluating an expression
+/// forwards then combines the bits of its operands with those recorded for
+/// it.
+class KnownBitsAnalysis {
+  struct Fact {
+    KnownBits bits;
+    // the last round which propagated the bits to the operands
+    unsigned round;
+  };
+
+  ExprHashMap<Fact> facts;
+  ExprHashMap<KnownBits> cache;
+  unsigned round;
+  bool changed;
+  bool conflict;
+
+  void assume(const ref<Expr> &e, KnownBits kb);
+  void assumeUpperBound(const ref<Expr> &e, uint64_t bound);
+  KnownBits compute(const ref<Expr> &e);
+
+public:
+  KnownBitsAnalysis() : round(0), changed(false), conflict(false) {}
+
+  /// Returns false if the constraints are found to be unsatisfiable.
+  bool addConstraints(const ConstraintManager &constraints);
+
+  KnownBits evaluate(const ref<Expr> &e);
+
+  bool hasConflict() const { return conflict; }
+};
+
+KnownBits addWithCarry(const KnownBits &lhs, const KnownBits &rhs,
+                       bool carryZero, bool carryOne) {
+  // see llvm::KnownBits::computeForAddCarry
+  uint64_t possibleSumZero = ~lhs.zeros + ~rhs.zeros + !carryZero;
+  uint64_t possibleSumOne = lhs.ones + rhs.ones + carryOne;
+  uint64_t carryKnownZero = ~(possibleSumZero ^ lhs.zeros ^ rhs.zeros);
+  uint64_t carryKnownOne = possibleSumOne ^ lhs.ones ^ rhs.ones;
+  uint64_t known = lhs.known() & rhs.known() & (carryKnownZero | carryKnownOne);
+  return KnownBits(lhs.width, ~possibleSumZero & known,
+                   possibleSumOne & known);
+}
+
+unsigned countTrailingKnown(const KnownBits &kb) {
+  unsigned n = 0;
+  while (n != kb.width && (kb.known() >> n & 1))
+    ++n;
+  return n;
+}
+
+unsigned countTrailingZeros(const KnownBits &kb) {
+  unsigned n = 0;
+  while (n != kb.width && (kb.zeros >> n & 1))
+    ++n;
+  return n;
+}
+
+/// Returns the bits of \a bound and below, i.e. the bits a value no larger
+/// than \a bound may have set.
+uint64_t bitsUpTo(uint64_t bound) {
+  uint64_t bits = bound;
+  for (unsigned shift = 1; shift != 64; shift *= 2)
+    bits |= bits >> shift;
+  return bits;
+}
+}
+
+KnownBits KnownBitsAnalysis::evaluate(const ref<Expr> &e) {
+  auto it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+
+  KnownBits kb = compute(e);
+  auto fact = facts.find(e);
+  if (fact != facts.end() && kb.isTracked())
+    kb.refine(fact->second.bits);
+  if (kb.isConflict())
+    conflict = true;
+  cache.insert(std::make_pair(e, kb));
+  return kb;
+}
+
+KnownBits KnownBitsAnalysis::compute(const ref<Expr> &e) {
+  Expr::Width w = e->getWidth();
+  KnownBits top = KnownBits::unknown(w);
+  if (w > 64) {
+    // still visit the operands, whose bits may be tracked
+    for (unsigned i = 0; i != e->getNumKids(); ++i)
+      evaluate(e->getKid(i));
+    return top;
+  }
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return KnownBits::constant(w, cast<ConstantExpr>(e)->getZExtValue());
+
+  case Expr::NotOptimized:
+    return evaluate(e->getKid(0));
+
+  case Expr::Read:
+    // the index may be read elsewhere
+    evaluate(cast<ReadExpr>(e)->index);
+    return top;
+
+  case Expr::WideRead:
+    // the facts are about the bytes
+    return evaluate(cast<WideReadExpr>(e)->lower());
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    KnownBits c = evaluate(se->cond);
+    KnownBits t = evaluate(se->trueExpr), f = evaluate(se->falseExpr);
+    if (c.isConstant())
+      return c.ones ? t : f;
+    return KnownBits(w, t.zeros & f.zeros, t.ones & f.ones);
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    KnownBits l = evaluate(ce->getLeft()), r = evaluate(ce->getRight());
+    return KnownBits(w, l.zeros << r.width | r.zeros,
+                     l.ones << r.width | r.ones);
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    KnownBits x = evaluate(ee->expr);
+    if (!x.isTracked())
+      return top;
+    return KnownBits(w, x.zeros >> ee->offset, x.ones >> ee->offset);
+  }
+
+  case Expr::ZExt: {
+    KnownBits x = evaluate(e->getKid(0));
+    return KnownBits(w, x.zeros | ~KnownBits::mask(x.width), x.ones);
+  }
+
+  case Expr::SExt: {
+    KnownBits x = evaluate(e->getKid(0));
+    uint64_t high = ~KnownBits::mask(x.width);
+    if (x.zeros & x.signBit())
+      return KnownBits(w, x.zeros | high, x.ones);
+    if (x.ones & x.signBit())
+      return KnownBits(w, x.zeros, x.ones | high);
+    return KnownBits(w, x.zeros, x.ones);
+  }
+
+  case Expr::Not: {
+    KnownBits x = evaluate(e->getKid(0));
+    return KnownBits(w, x.ones, x.zeros);
+  }
+
+  case Expr::And: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    return KnownBits(w, l.zeros | r.zeros, l.ones & r.ones);
+  }
+
+  case Expr::Or: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    return KnownBits(w, l.zeros & r.zeros, l.ones | r.ones);
+  }
+
+  case Expr::Xor: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    uint64_t known = l.known() & r.known(), value = l.ones ^ r.ones;
+    return KnownBits(w, ~value & known, value & known);
+  }
+
+  case Expr::Add: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    return addWithCarry(l, r, true, false);
+  }
+
+  case Expr::Sub: {
+    // l - r is l + ~r + 1
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    return addWithCarry(l, KnownBits(w, r.ones, r.zeros), false, true);
+  }
+
+  case Expr::Mul: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    if (l.isConstant() && r.isConstant())
+      return KnownBits::constant(w, l.ones * r.ones);
+    // the trailing zeros add up, and the bits above them multiply
+    unsigned zeros = std::min(w, countTrailingZeros(l) + countTrailingZeros(r));
+    unsigned low = std::min(countTrailingKnown(l), countTrailingKnown(r));
+    uint64_t lowMask = KnownBits::mask(low);
+    uint64_t value = l.ones * r.ones;
+    return KnownBits(w, KnownBits::mask(zeros) | (~value & lowMask),
+                     value & lowMask);
+  }
+
+  case Expr::UDiv: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    // the quotient is no larger than the dividend, unless the divisor may be
+    // zero, which leaves it unconstrained
+    if (!r.umin())
+      return top;
+    return KnownBits(w, ~bitsUpTo(l.umax()), 0);
+  }
+
+  case Expr::URem: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    uint64_t bound = l.umax();
+    if (r.umin())
+      bound = std::min(bound, r.umax() - 1);
+    KnownBits kb(w, ~bitsUpTo(bound), 0);
+    // a power of two divisor keeps the low bits of the dividend
+    if (r.isConstant() && r.ones && !(r.ones & (r.ones - 1)))
+      kb.refine(KnownBits(w, l.zeros & (r.ones - 1), l.ones & (r.ones - 1)));
+    return kb;
+  }
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    if (!r.isConstant() || r.ones >= w)
+      return top;
+    unsigned shift = r.ones;
+    if (e->getKind() == Expr::Shl)
+      return KnownBits(w, l.zeros << shift | KnownBits::mask(shift),
+                       l.ones << shift);
+    uint64_t high = ~(KnownBits::mask(w) >> shift);
+    if (e->getKind() == Expr::LShr)
+      return KnownBits(w, l.zeros >> shift | high, l.ones >> shift);
+    KnownBits x(w, l.zeros >> shift, l.ones >> shift);
+    if (l.zeros & l.signBit())
+      x.zeros |= high & KnownBits::mask(w);
+    if (l.ones & l.signBit())
+      x.ones |= high & KnownBits::mask(w);
+    return x;
+  }
+
+  case Expr::Eq:
+  case Expr::Ne: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    bool isEq = e->getKind() == Expr::Eq;
+    if ((l.zeros & r.ones) || (l.ones & r.zeros))
+      return KnownBits::constant(w, !isEq);
+    if (l.isConstant() && r.isConstant())
+      return KnownBits::constant(w, isEq);
+    return top;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Ugt:
+  case Expr::Uge: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    if (!l.isTracked())
+      return top;
+    Expr::Kind k = e->getKind();
+    // normalize to l < r or l <= r
+    if (k == Expr::Ugt || k == Expr::Uge)
+      std::swap(l, r);
+    bool strict = k == Expr::Ult || k == Expr::Ugt;
+    if (strict ? l.umax() < r.umin() : l.umax() <= r.umin())
+      return KnownBits::constant(w, 1);
+    if (strict ? l.umin() >= r.umax() : l.umin() > r.umax())
+      return KnownBits::constant(w, 0);
+    return top;
+  }
+
+  case Expr::Slt:
+  case Expr::Sle:
+  case Expr::Sgt:
+  case Expr::Sge: {
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    if (!l.isTracked())
+      return top;
+    Expr::Kind k = e->getKind();
+    if (k == Expr::Sgt || k == Expr::Sge)
+      std::swap(l, r);
+    bool strict = k == Expr::Slt || k == Expr::Sgt;
+    if (strict ? l.smax() < r.smin() : l.smax() <= r.smin())
+      return KnownBits::constant(w, 1);
+    if (strict ? l.smin() >= r.smax() : l.smin() > r.smax())
+      return KnownBits::constant(w, 0);
+    return top;
+  }
+
+  default:
+    for (unsigned i = 0; i != e->getNumKids(); ++i)
+      evaluate(e->getKid(i));
+    return top;
+  }
+}
+
+void KnownBitsAnalysis::assumeUpperBound(const ref<Expr> &e,
+                                         uint64_t bound) {
+  Expr::Width w = e->getWidth();
+  assume(e, KnownBits(w, ~bitsUpTo(bound), 0));
+}
+
+void KnownBitsAnalysis::assume(const ref<Expr> &e, KnownBits kb) {
+  Expr::Width w = e->getWidth();
+  if (w > 64 || !kb.known() || isa<ConstantExpr>(e)) {
+    if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e))
+      if (w <= 64 && (kb.zeros & ce->getZExtValue() ||
+                      kb.ones & ~ce->getZExtValue()))
+        conflict = true;
+    return;
+  }
+
+  auto it = facts.find(e);
+  if (it == facts.end()) {
+    Fact fact = {KnownBits::unknown(w), round};
+    it = facts.insert(std::make_pair(e, fact)).first;
+  } else if (it->second.round == round) {
+    // nothing new to propagate
+    if (!KnownBits(it->second.bits).refine(kb))
+      return;
+  }
+  it->second.round = round;
+  if (it->second.bits.refine(kb))
+    changed = true;
+  if (it->second.bits.isConflict()) {
+    conflict = true;
+    return;
+  }
+  kb = it->second.bits;
+
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    assume(e->getKid(0), kb);
+    break;
+
+  case Expr::WideRead:
+    assume(cast<WideReadExpr>(e)->lower(), kb);
+    break;
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    KnownBits c = evaluate(se->cond);
+    if (c.isConstant())
+      assume(c.ones ? se->trueExpr : se->falseExpr, kb);
+    break;
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    Expr::Width rw = ce->getRight()->getWidth();
+    assume(ce->getLeft(),
+           KnownBits(ce->getLeft()->getWidth(), kb.zeros >> rw,
+                     kb.ones >> rw));
+    assume(ce->getRight(), KnownBits(rw, kb.zeros, kb.ones));
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    Expr::Width xw = ee->expr->getWidth();
+    if (xw <= 64)
+      assume(ee->expr, KnownBits(xw, kb.zeros << ee->offset,
+                                 kb.ones << ee->offset));
+    break;
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    Expr::Width xw = e->getKid(0)->getWidth();
+    assume(e->getKid(0), KnownBits(xw, kb.zeros, kb.ones));
+    break;
+  }
+
+  case Expr::Not:
+    assume(e->getKid(0), KnownBits(w, kb.ones, kb.zeros));
+    break;
+
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor: {
+    ref<Expr> kids[2] = {e->getKid(0), e->getKid(1)};
+    KnownBits bits[2] = {evaluate(kids[0]), evaluate(kids[1])};
+    for (unsigned i = 0; i != 2; ++i) {
+      const KnownBits &other = bits[1 - i];
+      if (e->getKind() == Expr::And)
+        // ones in both; a zero where the other operand is one
+        assume(kids[i], KnownBits(w, kb.zeros & other.ones, kb.ones));
+      else if (e->getKind() == Expr::Or)
+        assume(kids[i], KnownBits(w, kb.zeros, kb.ones & other.zeros));
+      else
+        assume(kids[i],
+               KnownBits(w, (kb.zeros & other.zeros) | (kb.ones & other.ones),
+                         (kb.ones & other.zeros) | (kb.zeros & other.ones)));
+    }
+    break;
+  }
+
+  case Expr::Add:
+  case Expr::Sub: {
+    // with one operand constant, the low bits of the other follow from the
+    // low bits of the result
+    unsigned low = countTrailingKnown(kb);
+    uint64_t lowMask = KnownBits::mask(low);
+    KnownBits l = evaluate(e->getKid(0)), r = evaluate(e->getKid(1));
+    bool isAdd = e->getKind() == Expr::Add;
+    if (r.isConstant()) {
+      uint64_t v = isAdd ? kb.ones - r.ones : kb.ones + r.ones;
+      assume(e->getKid(0), KnownBits(w, ~v & lowMask, v & lowMask));
+    } else if (l.isConstant()) {
+      uint64_t v = isAdd ? kb.ones - l.ones : l.ones - kb.ones;
+      assume(e->getKid(1), KnownBits(w, ~v & lowMask, v & lowMask));
+    }
+    break;
+  }
+
+  case Expr::Shl:
+  case Expr::LShr: {
+    KnownBits r = evaluate(e->getKid(1));
+    if (!r.isConstant() || r.ones >= w)
+      break;
+    unsigned shift = r.ones;
+    if (e->getKind() == Expr::Shl)
+      assume(e->getKid(0), KnownBits(w, kb.zeros >> shift, kb.ones >> shift));
+    else
+      assume(e->getKid(0), KnownBits(w, kb.zeros << shift, kb.ones << shift));
+    break;
+  }
+
+  case Expr::Eq: {
+    // only a known truth value of the comparison says something about its
+    // operands
+    if (!kb.isConstant())
+      break;
+    ref<Expr> l = e->getKid(0), r = e->getKid(1);
+    KnownBits lb = evaluate(l), rb = evaluate(r);
+    if (kb.ones) {
+      assume(l, rb);
+      assume(r, lb);
+    } else if (l->getWidth() == Expr::Bool) {
+      // a != b on booleans is a == !b
+      assume(l, KnownBits(Expr::Bool, rb.ones, rb.zeros));
+      assume(r, KnownBits(Expr::Bool, lb.ones, lb.zeros));
+    }
+    break;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule: {
+    if (!kb.isConstant())
+      break;
+    ref<Expr> l = e->getKid(0), r = e->getKid(1);
+    KnownBits lb = evaluate(l), rb = evaluate(r);
+    if (!lb.isTracked())
+      break;
+    bool strict = e->getKind() == Expr::Ult;
+    if (kb.ones) {
+      // l < r or l <= r bounds l from above
+      if (strict && !rb.umax())
+        conflict = true;
+      else
+        assumeUpperBound(l, strict ? rb.umax() - 1 : rb.umax());
+    } else {
+      // r <= l or r < l bounds r from above
+      if (!strict && !lb.umax())
+        conflict = true;
+      else
+        assumeUpperBound(r, strict ? lb.umax() : lb.umax() - 1);
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+bool KnownBitsAnalysis::addConstraints(const ConstraintManager &constraints) {
+  // Propagating a constraint may refine the operands used by an earlier
+  // one, so sweep until nothing changes, giving up after a few rounds.
+  for (round = 1; round != 5 && !conflict; ++round) {
+    changed = false;
+    cache.clear();
+    for (const ref<Expr> &c : constraints)
+      assume(c, KnownBits::constant(Expr::Bool, 1));
+    if (!changed)
+      break;
+  }
+  cache.clear();
+  for (const ref<Expr> &c : constraints) {
+    if (conflict)
+      break;
+    KnownBits kb = evaluate(c);
+    if (kb.isConstant() && !kb.ones)
+      conflict = true;
+  }
+  return !conflict;
+}
+
+/***/
+
+namespace {
+
+/// Proves or refutes queries by known bits propagation, e.g. queries over
+/// masked flags or checksums, which the range based FastCexSolver does not
+/// handle well. It relies on the constraints being satisfiable (unless it
+/// finds otherwise), like the rest of the solver chain.
+class KnownBitsSolver : public IncompleteSolver {
+  IncompleteSolver::PartialValidity evaluate(const Query &query);
+
+public:
+  IncompleteSolver::PartialValidity computeValidity(const Query &query);
+  IncompleteSolver::PartialValidity computeTruth(const Query &query);
+  bool computeValue(const Query &query, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+};
+}
+
+IncompleteSolver::PartialValidity
+KnownBitsSolver::evaluate(const Query &query) {
+  KnownBitsAnalysis analysis;
+  // unsatisfiable constraints imply anything
+  if (!analysis.addConstraints(query.constraints))
+    return MustBeTrue;
+  KnownBits kb = analysis.evaluate(query.expr);
+  if (analysis.hasConflict())
+    return MustBeTrue;
+  if (!kb.isConstant())
+    return None;
+  return kb.ones ? MustBeTrue : MustBeFalse;
+}
+
+IncompleteSolver::PartialValidity
+KnownBitsSolver::computeValidity(const Query &query) {
+  PartialValidity result = evaluate(query);
+  if (result == None)
+    ++stats::queryKnownBitsMisses;
+  else
+    ++stats::queryKnownBitsHits;
+  return result;
+}
+
+IncompleteSolver::PartialValidity
+KnownBitsSolver::computeTruth(const Query &query) {
+  return computeValidity(query);
+}
+
+bool KnownBitsSolver::computeValue(const Query &query, ref<Expr> &result) {
+  KnownBitsAnalysis analysis;
+  if (!analysis.addConstraints(query.constraints))
+    return false;
+  KnownBits kb = analysis.evaluate(query.expr);
+  if (analysis.hasConflict() || !kb.isConstant()) {
+    ++stats::queryKnownBitsMisses;
+    return false;
+  }
+  ++stats::queryKnownBitsHits;
+  result = ConstantExpr::create(kb.ones, kb.width);
+  return true;
+}
+
+bool KnownBitsSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  // Known bits cannot build an assignment, only rule one out.
+  if (evaluate(query) != MustBeTrue) {
+    ++stats::queryKnownBitsMisses;
+    return false;
+  }
+  ++stats::queryKnownBitsHits;
+  hasSolution = false;
+  return true;
+}
+
+Solver *klee::createKnownBitsSolver(Solver *s) {
+  return new Solver(new StagedSolverImpl(new KnownBitsSolver(), s));
+}
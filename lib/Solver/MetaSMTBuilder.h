@@ -693,6 +693,12 @@ MetaSMTBuilder<SolverContext>::constructActual(ref<Expr> e, int *width_out) {
     break;
   }
 
+  case Expr::WideRead: {
+    // the arrays hold bytes, read one at a time
+    res = construct(cast<WideReadExpr>(e)->lower(), width_out);
+    break;
+  }
+
   case Expr::Concat: {
     ConcatExpr *ce = cast<ConcatExpr>(e);
     assert(ce);
@@ -13,11 +13,15 @@
 #include "MetaSMTBuilder.h"
 #include "klee/Constraints.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Trace.h"
+#include "klee/OptionCategories.h"
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/ExprUtil.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 
 #include <metaSMT/DirectSolver_Context.hpp>
@@ -51,12 +55,29 @@
 #endif
 
 #include <errno.h>
+#include <memory>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 
+namespace {
+llvm::cl::opt<bool> MetaSMTIncremental(
+    "metasmt-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep the constraints encoded for metaSMT across queries, "
+                   "each asserted once behind a literal which the queries "
+                   "including it assume (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> MetaSMTIncrementalLimit(
+    "metasmt-incremental-limit", llvm::cl::init(10000),
+    llvm::cl::desc("Start over with a new metaSMT context once this many "
+                   "constraints have been asserted with "
+                   "-metasmt-incremental (default=10000)"),
+    llvm::cl::cat(klee::SolvingCat));
+}
+
 static unsigned char *shared_memory_ptr;
 static int shared_memory_id = 0;
 // Darwin by default has a very small limit on the maximum amount of shared
@@ -74,13 +95,28 @@ namespace klee {
 
 template <typename SolverContext> class MetaSMTSolverImpl : public SolverImpl {
 private:
-  SolverContext _meta_solver;
+  typedef typename SolverContext::result_type result_type;
+
+  std::unique_ptr<SolverContext> _meta_solver;
   MetaSMTSolver<SolverContext> *_solver;
-  MetaSMTBuilder<SolverContext> *_builder;
+  std::unique_ptr<MetaSMTBuilder<SolverContext> > _builder;
   time::Span _timeout;
   bool _useForked;
+  bool _optimizeDivides;
   SolverRunStatus _runStatusCode;
 
+  // With -metasmt-incremental: the literal each constraint encoded so far
+  // is asserted behind. Queries from one state, or from a state and its
+  // ancestors, share most of their constraints, which are then neither
+  // built nor asserted again.
+  ExprHashMap<result_type> _guards;
+
+  /// Drops everything built so far.
+  void resetContext();
+  result_type getGuard(ref<Expr> constraint);
+  /// Puts the constraints of the query into the context for the next solve.
+  void addConstraints(const Query &query, bool permanently);
+
 public:
   MetaSMTSolverImpl(MetaSMTSolver<SolverContext> *solver, bool useForked,
                     bool optimizeDivides);
@@ -110,17 +146,16 @@ public:
 
   SolverRunStatus getOperationStatusCode();
 
-  SolverContext &get_meta_solver() { return (_meta_solver); };
+  SolverContext &get_meta_solver() { return (*_meta_solver); };
 };
 
 template <typename SolverContext>
 MetaSMTSolverImpl<SolverContext>::MetaSMTSolverImpl(
     MetaSMTSolver<SolverContext> *solver, bool useForked, bool optimizeDivides)
-    : _solver(solver), _builder(new MetaSMTBuilder<SolverContext>(
-                           _meta_solver, optimizeDivides)),
-      _useForked(useForked) {
+    : _solver(solver), _useForked(useForked),
+      _optimizeDivides(optimizeDivides) {
   assert(_solver && "unable to create MetaSMTSolver");
-  assert(_builder && "unable to create MetaSMTBuilder");
+  resetContext();
 
   if (_useForked) {
     shared_memory_id =
@@ -133,7 +168,50 @@ MetaSMTSolverImpl<SolverContext>::MetaSMTSolverImpl(
 }
 
 template <typename SolverContext>
-MetaSMTSolverImpl<SolverContext>::~MetaSMTSolverImpl() {}
+MetaSMTSolverImpl<SolverContext>::~MetaSMTSolverImpl() {
+  // the builder refers to the context
+  _guards.clear();
+  _builder.reset();
+}
+
+template <typename SolverContext>
+void MetaSMTSolverImpl<SolverContext>::resetContext() {
+  _guards.clear();
+  _builder.reset();
+  _meta_solver.reset(new SolverContext());
+  _builder.reset(
+      new MetaSMTBuilder<SolverContext>(*_meta_solver, _optimizeDivides));
+  assert(_builder && "unable to create MetaSMTBuilder");
+}
+
+template <typename SolverContext>
+typename MetaSMTSolverImpl<SolverContext>::result_type
+MetaSMTSolverImpl<SolverContext>::getGuard(ref<Expr> constraint) {
+  typename ExprHashMap<result_type>::iterator it = _guards.find(constraint);
+  if (it != _guards.end())
+    return it->second;
+
+  result_type guard = evaluate(*_meta_solver, metaSMT::logic::new_variable());
+  assertion(*_meta_solver,
+            metaSMT::logic::implies(guard, _builder->construct(constraint)));
+  _guards.insert(std::make_pair(constraint, guard));
+  return guard;
+}
+
+template <typename SolverContext>
+void MetaSMTSolverImpl<SolverContext>::addConstraints(const Query &query,
+                                                      bool permanently) {
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie; ++it) {
+    if (MetaSMTIncremental)
+      assumption(*_meta_solver, getGuard(*it));
+    else if (permanently)
+      assertion(*_meta_solver, _builder->construct(*it));
+    else
+      assumption(*_meta_solver, _builder->construct(*it));
+  }
+}
 
 template <typename SolverContext>
 char *MetaSMTSolverImpl<SolverContext>::getConstraintLog(const Query &) {
@@ -190,12 +268,16 @@ bool MetaSMTSolverImpl<SolverContext>::computeInitialValues(
 
   _runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
+  KLEE_TRACE_SCOPE("MetaSMTSolver");
   TimerStatIncrementer t(stats::queryTime);
   assert(_builder);
 
   ++stats::queries;
   ++stats::queryCounterexamples;
 
+  if (MetaSMTIncremental && _guards.size() >= MetaSMTIncrementalLimit)
+    resetContext();
+
   bool success = true;
   if (_useForked) {
     _runStatusCode =
@@ -224,14 +306,11 @@ SolverImpl::SolverRunStatus MetaSMTSolverImpl<SolverContext>::runAndGetCex(
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
 
   // assume the constraints of the query
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    assumption(_meta_solver, _builder->construct(*it));
-  }
+  addConstraints(query, false);
   // assume the negation of the query
-  assumption(_meta_solver, _builder->construct(Expr::createIsZero(query.expr)));
-  hasSolution = solve(_meta_solver);
+  assumption(*_meta_solver,
+             _builder->construct(Expr::createIsZero(query.expr)));
+  hasSolution = solve(*_meta_solver);
 
   if (hasSolution) {
     values.reserve(objects.size());
@@ -249,9 +328,10 @@ SolverImpl::SolverRunStatus MetaSMTSolverImpl<SolverContext>::runAndGetCex(
 
       for (unsigned offset = 0; offset < array->size; offset++) {
         typename SolverContext::result_type elem_exp = evaluate(
-            _meta_solver, metaSMT::logic::Array::select(
-                              array_exp, bvuint(offset, array->getDomain())));
-        unsigned char elem_value = metaSMT::read_value(_meta_solver, elem_exp);
+            *_meta_solver, metaSMT::logic::Array::select(
+                               array_exp, bvuint(offset, array->getDomain())));
+        unsigned char elem_value =
+            metaSMT::read_value(*_meta_solver, elem_exp);
         data.push_back(elem_value);
       }
 
@@ -286,6 +366,14 @@ MetaSMTSolverImpl<SolverContext>::runAndGetCexForked(
   assert(sum < shared_memory_size &&
          "not enough shared memory for counterexample");
 
+  // The constraints are built, and asserted behind their literals, before
+  // forking so that the next queries find them.
+  if (MetaSMTIncremental)
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it)
+      getGuard(*it);
+
   fflush(stdout);
   fflush(stderr);
   int pid = fork();
@@ -302,17 +390,12 @@ MetaSMTSolverImpl<SolverContext>::runAndGetCexForked(
     }
 
     // assert constraints as we are in a child process
-    for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                           ie = query.constraints.end();
-         it != ie; ++it) {
-      assertion(_meta_solver, _builder->construct(*it));
-      // assumption(_meta_solver, _builder->construct(*it));
-    }
+    addConstraints(query, true);
 
     // asssert the negation of the query as we are in a child process
-    assertion(_meta_solver,
+    assertion(*_meta_solver,
               _builder->construct(Expr::createIsZero(query.expr)));
-    unsigned res = solve(_meta_solver);
+    unsigned res = solve(*_meta_solver);
 
     if (res) {
       for (std::vector<const Array *>::const_iterator it = objects.begin(),
@@ -327,10 +410,10 @@ MetaSMTSolverImpl<SolverContext>::runAndGetCexForked(
         for (unsigned offset = 0; offset < array->size; offset++) {
 
           typename SolverContext::result_type elem_exp = evaluate(
-              _meta_solver, metaSMT::logic::Array::select(
-                                array_exp, bvuint(offset, array->getDomain())));
+              *_meta_solver, metaSMT::logic::Array::select(
+                                 array_exp, bvuint(offset, array->getDomain())));
           unsigned char elem_value =
-              metaSMT::read_value(_meta_solver, elem_exp);
+              metaSMT::read_value(*_meta_solver, elem_exp);
           *pos++ = elem_value;
         }
       }
@@ -0,0 +1,128 @@
+//===-- PersistentCachingSolver.cpp - On-disk query cache -----------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "KeyedCachingSolver.h"
+
+#include "klee/Solver.h"
+
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <sqlite3.h>
+
+#include <string>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// Stores the results of successful queries in an SQLite database, so that
+/// they can be reused by later runs (or by concurrent ones sharing the
+/// file). Results are looked up by the MD5 digest of the serialized query.
+class PersistentCachingSolver : public KeyedCachingSolver {
+  sqlite3 *db;
+  sqlite3_stmt *lookupStmt;
+  sqlite3_stmt *insertStmt;
+  uint64_t hits, misses;
+  // SQLite connections must not be used across fork(), so forked children
+  // (as used for asynchronous branch queries) bypass the cache.
+  pid_t owner;
+
+protected:
+  bool lookup(const std::string &key, std::string &result);
+  void insert(const std::string &key, const std::string &result);
+
+  void countHit() {
+    ++hits;
+    ++stats::queryPersistentCacheHits;
+  }
+
+  void countMiss() {
+    ++misses;
+    ++stats::queryPersistentCacheMisses;
+  }
+
+public:
+  PersistentCachingSolver(Solver *s, sqlite3 *db);
+  ~PersistentCachingSolver();
+};
+}
+
+PersistentCachingSolver::PersistentCachingSolver(Solver *s, sqlite3 *db)
+    : KeyedCachingSolver(s), db(db), lookupStmt(nullptr), insertStmt(nullptr),
+      hits(0), misses(0), owner(getpid()) {
+  sqlite3_prepare_v2(db, "SELECT result FROM queries WHERE key = ?", -1,
+                     &lookupStmt, nullptr);
+  sqlite3_prepare_v2(
+      db, "INSERT OR IGNORE INTO queries (key, result) VALUES (?, ?)", -1,
+      &insertStmt, nullptr);
+}
+
+PersistentCachingSolver::~PersistentCachingSolver() {
+  if (hits + misses)
+    klee_message("Persistent query cache: %llu hits, %llu misses (%.1f%%)",
+                 (unsigned long long)hits, (unsigned long long)misses,
+                 100.0 * hits / (hits + misses));
+  sqlite3_finalize(lookupStmt);
+  sqlite3_finalize(insertStmt);
+  sqlite3_close(db);
+}
+
+bool PersistentCachingSolver::lookup(const std::string &key,
+                                     std::string &result) {
+  if (getpid() != owner)
+    return false;
+  sqlite3_reset(lookupStmt);
+  sqlite3_bind_blob(lookupStmt, 1, key.data(), key.size(), SQLITE_STATIC);
+  bool found = sqlite3_step(lookupStmt) == SQLITE_ROW;
+  if (found)
+    result.assign(static_cast<const char *>(sqlite3_column_blob(lookupStmt, 0)),
+                  sqlite3_column_bytes(lookupStmt, 0));
+  // ends the read transaction, so that it does not hold up checkpoints
+  sqlite3_reset(lookupStmt);
+  return found;
+}
+
+void PersistentCachingSolver::insert(const std::string &key,
+                                     const std::string &result) {
+  if (getpid() != owner)
+    return;
+  sqlite3_reset(insertStmt);
+  sqlite3_bind_blob(insertStmt, 1, key.data(), key.size(), SQLITE_STATIC);
+  sqlite3_bind_blob(insertStmt, 2, result.data(), result.size(),
+                    SQLITE_STATIC);
+  // Losing an insert to a concurrent writer only costs a later miss.
+  if (sqlite3_step(insertStmt) != SQLITE_DONE)
+    klee_warning_once(0, "Persistent query cache: cannot store result: %s",
+                      sqlite3_errmsg(db));
+}
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *s,
+                                            const std::string &path) {
+  sqlite3 *db = nullptr;
+  // WAL journaling lets any number of runs read the cache while one of them
+  // writes to it; without per-insert syncs a crash may at worst lose the
+  // most recent results.
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK ||
+      sqlite3_busy_timeout(db, 5000) != SQLITE_OK ||
+      sqlite3_exec(db, "PRAGMA journal_mode = WAL;"
+                       "PRAGMA synchronous = NORMAL;"
+                       "CREATE TABLE IF NOT EXISTS queries "
+                       "(key BLOB PRIMARY KEY, result BLOB NOT NULL)",
+                   nullptr, nullptr, nullptr) != SQLITE_OK) {
+    klee_warning("Cannot open persistent query cache %s: %s", path.c_str(),
+                 db ? sqlite3_errmsg(db) : "out of memory");
+    sqlite3_close(db);
+    return s;
+  }
+  return new Solver(new PersistentCachingSolver(s, db));
+}
@@ -0,0 +1,402 @@
+//===-- PortfolioSolver.cpp - Race several core solvers -------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/OptionCategories.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
+
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+llvm::cl::opt<unsigned> PortfolioLearnAfter(
+    "portfolio-learn-after", llvm::cl::init(32),
+    llvm::cl::desc("Number of races after which queries of a given shape only "
+                   "run on the backend that won at least three quarters of "
+                   "them; 0 always races all backends (default=32)"),
+    llvm::cl::cat(SolvingCat));
+
+// Every this many queries of a learned shape still race all backends, so
+// that the preference can change.
+const unsigned RaceEvery = 8;
+
+enum Operation { Truth, Validity, Value, InitialValues };
+
+/// Coarse classification of queries: backends differ mostly on whether
+/// arrays are accessed symbolically and on the size of the constraint set.
+struct QueryShape {
+  unsigned char operation;
+  bool symbolicArrays;
+  unsigned char sizeClass;
+
+  QueryShape(Operation op, const Query &query) : operation(op) {
+    std::vector<ref<ReadExpr> > reads;
+    for (const ref<Expr> &c : query.constraints)
+      findReads(c, /* visitUpdates= */ true, reads);
+    findReads(query.expr, /* visitUpdates= */ true, reads);
+    symbolicArrays = false;
+    for (const ref<ReadExpr> &re : reads)
+      if (re->updates.head || !isa<ConstantExpr>(re->index))
+        symbolicArrays = true;
+    sizeClass = 0;
+    for (size_t n = query.constraints.size(); n && sizeClass < 8; n >>= 2)
+      ++sizeClass;
+  }
+
+  bool operator<(const QueryShape &b) const {
+    if (operation != b.operation)
+      return operation < b.operation;
+    if (symbolicArrays != b.symbolicArrays)
+      return symbolicArrays < b.symbolicArrays;
+    return sizeClass < b.sizeClass;
+  }
+};
+
+struct ShapeHistory {
+  unsigned races = 0;
+  unsigned queries = 0;
+  std::vector<unsigned> wins;
+};
+
+/// Runs each query on all backends at once, each one in a forked child, and
+/// uses the first successful answer. The other children are killed. Results
+/// come back to the parent through pipes.
+class PortfolioSolver : public SolverImpl {
+  std::vector<std::pair<std::string, Solver *> > backends;
+  std::map<QueryShape, ShapeHistory> history;
+  std::vector<unsigned> wins;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+
+  /// Returns the backend queries of this shape are known to be fastest on,
+  /// or -1 if the backends should race.
+  int getPreferredBackend(ShapeHistory &h);
+
+  /// Runs \a op on a single backend and serializes the outcome.
+  std::string run(Solver *backend, Operation op, const Query &query,
+                  const std::vector<const Array *> *objects);
+
+  /// Runs \a op with the preferred backend or by racing all of them, and
+  /// returns the outcome serialized by run().
+  bool dispatch(Operation op, const Query &query,
+                const std::vector<const Array *> *objects,
+                std::string &result);
+  bool race(Operation op, const Query &query,
+            const std::vector<const Array *> *objects, std::string &result,
+            unsigned &winner);
+
+public:
+  PortfolioSolver(const std::vector<std::pair<std::string, Solver *> > &b)
+      : backends(b), wins(b.size()), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {}
+  ~PortfolioSolver();
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return backends[0].second->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span t) {
+    timeout = t;
+    for (auto &backend : backends)
+      backend.second->impl->setCoreSolverTimeout(t);
+  }
+};
+}
+
+PortfolioSolver::~PortfolioSolver() {
+  std::string summary;
+  for (unsigned i = 0; i != backends.size(); ++i) {
+    if (i)
+      summary += ", ";
+    summary += backends[i].first + " " + std::to_string(wins[i]);
+  }
+  klee_message("Portfolio solver wins: %s", summary.c_str());
+  for (auto &backend : backends)
+    delete backend.second;
+}
+
+// Layout: success flag, run status, then the operation specific payload.
+std::string PortfolioSolver::run(Solver *backend, Operation op,
+                                 const Query &query,
+                                 const std::vector<const Array *> *objects) {
+  std::string payload;
+  bool success = false;
+  switch (op) {
+  case Truth: {
+    bool isValid;
+    success = backend->impl->computeTruth(query, isValid);
+    payload.push_back(isValid);
+    break;
+  }
+  case Validity: {
+    Solver::Validity validity;
+    success = backend->impl->computeValidity(query, validity);
+    payload.push_back(validity + 1);
+    break;
+  }
+  case Value: {
+    ref<Expr> value;
+    success = backend->impl->computeValue(query, value);
+    if (success) {
+      const llvm::APInt &v = cast<ConstantExpr>(value)->getAPValue();
+      payload.assign(reinterpret_cast<const char *>(v.getRawData()),
+                     v.getNumWords() * sizeof(uint64_t));
+    }
+    break;
+  }
+  case InitialValues: {
+    std::vector<std::vector<unsigned char> > values;
+    bool hasSolution;
+    success = backend->impl->computeInitialValues(query, *objects, values,
+                                                  hasSolution);
+    payload.push_back(hasSolution);
+    if (success && hasSolution)
+      for (const std::vector<unsigned char> &v : values)
+        payload.append(v.begin(), v.end());
+    break;
+  }
+  }
+  std::string result;
+  result.push_back(success);
+  result.push_back(backend->impl->getOperationStatusCode());
+  return result + payload;
+}
+
+int PortfolioSolver::getPreferredBackend(ShapeHistory &h) {
+  ++h.queries;
+  if (!PortfolioLearnAfter || h.races < PortfolioLearnAfter ||
+      h.queries % RaceEvery == 0)
+    return -1;
+  for (unsigned i = 0; i != h.wins.size(); ++i)
+    if (4 * h.wins[i] >= 3 * h.races)
+      return i;
+  return -1;
+}
+
+bool PortfolioSolver::dispatch(Operation op, const Query &query,
+                               const std::vector<const Array *> *objects,
+                               std::string &result) {
+  if (backends.size() == 1) {
+    result = run(backends[0].second, op, query, objects);
+  } else {
+    ShapeHistory &h = history[QueryShape(op, query)];
+    h.wins.resize(backends.size());
+    int preferred = getPreferredBackend(h);
+    if (preferred >= 0) {
+      result = run(backends[preferred].second, op, query, objects);
+      ++wins[preferred];
+    } else {
+      unsigned winner;
+      if (!race(op, query, objects, result, winner))
+        return false;
+      ++h.races;
+      ++h.wins[winner];
+      ++wins[winner];
+    }
+  }
+  runStatusCode = static_cast<SolverRunStatus>(result[1]);
+  return result[0];
+}
+
+bool PortfolioSolver::race(Operation op, const Query &query,
+                           const std::vector<const Array *> *objects,
+                           std::string &result, unsigned &winner) {
+  struct Child {
+    pid_t pid;
+    int fd;
+    std::string output;
+  };
+  std::vector<Child> children;
+  for (auto &backend : backends) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      klee_warning("pipe failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    }
+    if (pid == 0) {
+      for (const Child &c : children)
+        close(c.fd);
+      close(fds[0]);
+      std::string out = run(backend.second, op, query, objects);
+      for (size_t written = 0; written < out.size();) {
+        ssize_t n = write(fds[1], out.data() + written, out.size() - written);
+        if (n <= 0)
+          _exit(1);
+        written += n;
+      }
+      _exit(0);
+    }
+    close(fds[1]);
+    Child c = {pid, fds[0], std::string()};
+    children.push_back(c);
+  }
+  if (children.empty()) {
+    result = run(backends[0].second, op, query, objects);
+    winner = 0;
+    return result[0];
+  }
+
+  // Backends enforce the timeout themselves; the grace period only guards
+  // against children that do not.
+  int pollTimeout = -1;
+  if (timeout)
+    pollTimeout = timeout.toMicroseconds() / 1000 + 1000;
+
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  bool found = false;
+  unsigned running = children.size();
+  while (running && !found) {
+    std::vector<pollfd> fds;
+    std::vector<unsigned> which;
+    for (unsigned i = 0; i != children.size(); ++i) {
+      if (children[i].fd < 0)
+        continue;
+      pollfd p = {children[i].fd, POLLIN, 0};
+      fds.push_back(p);
+      which.push_back(i);
+    }
+    int ready = poll(&fds[0], fds.size(), pollTimeout);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0) {
+      runStatusCode = ready == 0 ? SOLVER_RUN_STATUS_TIMEOUT
+                                 : SOLVER_RUN_STATUS_FAILURE;
+      break;
+    }
+    for (unsigned k = 0; k != fds.size() && !found; ++k) {
+      if (!fds[k].revents)
+        continue;
+      Child &c = children[which[k]];
+      char buffer[4096];
+      ssize_t n = read(c.fd, buffer, sizeof(buffer));
+      if (n > 0) {
+        c.output.append(buffer, n);
+        continue;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      // end of output
+      close(c.fd);
+      c.fd = -1;
+      --running;
+      if (c.output.size() >= 2) {
+        runStatusCode = static_cast<SolverRunStatus>(c.output[1]);
+        if (c.output[0]) {
+          found = true;
+          winner = which[k];
+          result = c.output;
+        }
+      } else {
+        runStatusCode = SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+      }
+    }
+  }
+
+  for (Child &c : children) {
+    if (c.fd >= 0) {
+      kill(c.pid, SIGKILL);
+      close(c.fd);
+    }
+    int status;
+    while (waitpid(c.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+  return found;
+}
+
+bool PortfolioSolver::computeTruth(const Query &query, bool &isValid) {
+  std::string result;
+  if (!dispatch(Truth, query, nullptr, result))
+    return false;
+  isValid = result[2];
+  return true;
+}
+
+bool PortfolioSolver::computeValidity(const Query &query,
+                                      Solver::Validity &validity) {
+  std::string result;
+  if (!dispatch(Validity, query, nullptr, result))
+    return false;
+  validity = static_cast<Solver::Validity>(result[2] - 1);
+  return true;
+}
+
+bool PortfolioSolver::computeValue(const Query &query, ref<Expr> &value) {
+  std::string result;
+  if (!dispatch(Value, query, nullptr, result))
+    return false;
+  Expr::Width width = query.expr->getWidth();
+  std::vector<uint64_t> words(llvm::APInt::getNumWords(width));
+  assert(result.size() == 2 + words.size() * sizeof(uint64_t) &&
+         "unexpected value size");
+  memcpy(&words[0], result.data() + 2, words.size() * sizeof(uint64_t));
+  value = ConstantExpr::alloc(llvm::APInt(width, words));
+  return true;
+}
+
+bool PortfolioSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  std::string result;
+  if (!dispatch(InitialValues, query, &objects, result))
+    return false;
+  hasSolution = result[2];
+  if (!hasSolution)
+    return true;
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(result.data()) + 3;
+  for (const Array *array : objects) {
+    values.push_back(std::vector<unsigned char>(data, data + array->size));
+    data += array->size;
+  }
+  assert(data == reinterpret_cast<const unsigned char *>(result.data()) +
+                     result.size() &&
+         "unexpected number of values");
+  return true;
+}
+
+///
+
+Solver *klee::createPortfolioSolver(
+    const std::vector<std::pair<std::string, Solver *> > &backends) {
+  assert(!backends.empty() && "portfolio without backends");
+  return new Solver(new PortfolioSolver(backends));
+}
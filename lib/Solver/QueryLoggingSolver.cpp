@@ -163,6 +163,48 @@ bool QueryLoggingSolver::computeValue(const Query &query, ref<Expr> &result) {
   return success;
 }
 
+bool QueryLoggingSolver::computeBound(const Query &query, bool maximize,
+                                      ref<ConstantExpr> &result) {
+  Query withFalse = query.withFalse();
+  startQuery(query, maximize ? "Maximum" : "Minimum", &withFalse);
+
+  bool success = solver->impl->computeBound(query, maximize, result);
+
+  finishQuery(success);
+
+  if (success) {
+    logBuffer << queryCommentSign << "   Result: " << result << "\n";
+  }
+  logBuffer << "\n";
+
+  flushBuffer();
+
+  return success;
+}
+
+bool QueryLoggingSolver::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  Query withFalse = query.withFalse();
+  startQuery(query, "UniqueValue", &withFalse, &objects);
+
+  bool success = solver->impl->computeUniqueValue(query, objects, values,
+                                                  otherValues, isUnique);
+
+  finishQuery(success);
+
+  if (success) {
+    logBuffer << queryCommentSign
+              << "   Is Unique: " << (isUnique ? "true" : "false") << "\n";
+  }
+  logBuffer << "\n";
+
+  flushBuffer();
+
+  return success;
+}
+
 bool QueryLoggingSolver::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
@@ -65,6 +65,16 @@ public:
   bool computeTruth(const Query &query, bool &isValid);
   bool computeValidity(const Query &query, Solver::Validity &result);
   bool computeValue(const Query &query, ref<Expr> &result);
+  bool computeBound(const Query &query, bool maximize,
+                    ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    return solver->impl->getUnsatCore(core);
+  }
   bool computeInitialValues(const Query &query,
                             const std::vector<const Array *> &objects,
                             std::vector<std::vector<unsigned char> > &values,
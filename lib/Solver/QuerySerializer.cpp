@@ -0,0 +1,285 @@
+//===-- QuerySerializer.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerializer.h"
+
+#include "klee/ExprBuilder.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+using namespace klee;
+
+bool QueryDeserializer::read(uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; shift < 64 && pos != end; shift += 7) {
+    unsigned char byte = *pos++;
+    v |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool QueryDeserializer::read(llvm::APInt &v) {
+  uint64_t width;
+  if (!read(width) || !width || width > (1u << 24))
+    return false;
+  std::vector<uint64_t> words(llvm::APInt::getNumWords(width));
+  for (uint64_t &word : words)
+    if (!read(word))
+      return false;
+  v = llvm::APInt(width, words);
+  return true;
+}
+
+bool QueryDeserializer::readArray() {
+  uint64_t size, domain, range, numValues;
+  if (!read(size) || !read(domain) || !read(range) || !read(numValues) ||
+      (numValues && numValues != size))
+    return false;
+  std::vector<ref<ConstantExpr> > values;
+  for (uint64_t i = 0; i != numValues; ++i) {
+    llvm::APInt v;
+    if (!read(v))
+      return false;
+    values.push_back(ConstantExpr::alloc(v));
+  }
+  // Unless named, named after their position, so that equal queries map to
+  // the same arrays.
+  std::string name = names && arrays.size() < names->size()
+                         ? (*names)[arrays.size()]
+                         : "arr" + llvm::utostr(arrays.size());
+  arrays.push_back(arrayCache.CreateArray(
+      name, size, values.empty() ? nullptr : &values[0],
+      values.empty() ? nullptr : &values[0] + values.size(), domain, range));
+  return true;
+}
+
+bool QueryDeserializer::readUpdate() {
+  uint64_t next, index, value;
+  if (!read(next) || !read(index) || !read(value) || next > updates.size() ||
+      index >= exprs.size() || value >= exprs.size())
+    return false;
+  updates.push_back(UpdateList(nullptr, next ? updates[next - 1].head
+                                             : nullptr));
+  updates.back().extend(exprs[index], exprs[value]);
+  return true;
+}
+
+/// Creates an expression as QuerySerializer saw it, without a builder.
+static ref<Expr> create(Expr::Kind kind, Expr::Width width,
+                        const ref<Expr> *kids) {
+  switch (kind) {
+  case Expr::Not:
+    return NotExpr::create(kids[0]);
+  case Expr::ZExt:
+  case Expr::SExt:
+    return Expr::createFromKind(kind, {kids[0], Expr::CreateArg(width)});
+  case Expr::NotOptimized:
+    return NotOptimizedExpr::create(kids[0]);
+  case Expr::Select:
+    return SelectExpr::create(kids[0], kids[1], kids[2]);
+  default:
+    return Expr::createFromKind(kind, {kids[0], kids[1]});
+  }
+}
+
+bool QueryDeserializer::readExpr() {
+  uint64_t kind, width;
+  if (!read(kind) || !read(width) || kind > Expr::LastKind)
+    return false;
+
+  ref<Expr> kids[3];
+  unsigned numKids = 0;
+  switch (kind) {
+  case Expr::Constant:
+    break;
+  case Expr::NotOptimized:
+  case Expr::Read:
+  case Expr::WideRead:
+  case Expr::Extract:
+  case Expr::ZExt:
+  case Expr::SExt:
+  case Expr::Not:
+    numKids = 1;
+    break;
+  case Expr::Select:
+    numKids = 3;
+    break;
+  default:
+    numKids = 2;
+    break;
+  }
+  for (unsigned i = 0; i != numKids; ++i) {
+    uint64_t kid;
+    if (!read(kid) || kid >= exprs.size())
+      return false;
+    kids[i] = exprs[kid];
+  }
+
+  ref<Expr> e;
+  switch (kind) {
+  case Expr::Constant: {
+    llvm::APInt v;
+    if (!read(v))
+      return false;
+    e = builder ? builder->Constant(v) : ref<Expr>(ConstantExpr::alloc(v));
+    break;
+  }
+  case Expr::Read: {
+    uint64_t array, head;
+    if (!read(array) || !read(head) || array >= arrays.size() ||
+        head > updates.size())
+      return false;
+    UpdateList ul(arrays[array], head ? updates[head - 1].head : nullptr);
+    e = builder ? builder->Read(ul, kids[0]) : ReadExpr::create(ul, kids[0]);
+    break;
+  }
+  case Expr::WideRead: {
+    uint64_t array, head, isLittleEndian;
+    if (!read(array) || !read(head) || !read(isLittleEndian) ||
+        array >= arrays.size() || head > updates.size())
+      return false;
+    UpdateList ul(arrays[array], head ? updates[head - 1].head : nullptr);
+    Expr::Width range = ul.root->getRange();
+    if (width % range || width < 2 * range)
+      return false;
+    e = builder ? buildWideRead(ul, kids[0], width, isLittleEndian)
+                : WideReadExpr::create(ul, kids[0], width, isLittleEndian);
+    break;
+  }
+  case Expr::Extract: {
+    uint64_t offset;
+    if (!read(offset))
+      return false;
+    e = builder ? builder->Extract(kids[0], offset, width)
+                : ExtractExpr::create(kids[0], offset, width);
+    break;
+  }
+  default:
+    e = builder ? build(static_cast<Expr::Kind>(kind), width, kids)
+                : create(static_cast<Expr::Kind>(kind), width, kids);
+    if (e.isNull())
+      return false;
+    break;
+  }
+  exprs.push_back(e);
+  return true;
+}
+
+ref<Expr> QueryDeserializer::build(Expr::Kind kind, Expr::Width width,
+                                   const ref<Expr> *kids) {
+  switch (kind) {
+  case Expr::NotOptimized: return builder->NotOptimized(kids[0]);
+  case Expr::Select: return builder->Select(kids[0], kids[1], kids[2]);
+  case Expr::Concat: return builder->Concat(kids[0], kids[1]);
+  case Expr::ZExt: return builder->ZExt(kids[0], width);
+  case Expr::SExt: return builder->SExt(kids[0], width);
+  case Expr::Not: return builder->Not(kids[0]);
+  case Expr::Add: return builder->Add(kids[0], kids[1]);
+  case Expr::Sub: return builder->Sub(kids[0], kids[1]);
+  case Expr::Mul: return builder->Mul(kids[0], kids[1]);
+  case Expr::UDiv: return builder->UDiv(kids[0], kids[1]);
+  case Expr::SDiv: return builder->SDiv(kids[0], kids[1]);
+  case Expr::URem: return builder->URem(kids[0], kids[1]);
+  case Expr::SRem: return builder->SRem(kids[0], kids[1]);
+  case Expr::And: return builder->And(kids[0], kids[1]);
+  case Expr::Or: return builder->Or(kids[0], kids[1]);
+  case Expr::Xor: return builder->Xor(kids[0], kids[1]);
+  case Expr::Shl: return builder->Shl(kids[0], kids[1]);
+  case Expr::LShr: return builder->LShr(kids[0], kids[1]);
+  case Expr::AShr: return builder->AShr(kids[0], kids[1]);
+  case Expr::Eq: return builder->Eq(kids[0], kids[1]);
+  case Expr::Ne: return builder->Ne(kids[0], kids[1]);
+  case Expr::Ult: return builder->Ult(kids[0], kids[1]);
+  case Expr::Ule: return builder->Ule(kids[0], kids[1]);
+  case Expr::Ugt: return builder->Ugt(kids[0], kids[1]);
+  case Expr::Uge: return builder->Uge(kids[0], kids[1]);
+  case Expr::Slt: return builder->Slt(kids[0], kids[1]);
+  case Expr::Sle: return builder->Sle(kids[0], kids[1]);
+  case Expr::Sgt: return builder->Sgt(kids[0], kids[1]);
+  case Expr::Sge: return builder->Sge(kids[0], kids[1]);
+  default: return nullptr;
+  }
+}
+
+/// The builders know of the reads of single bytes only.
+ref<Expr> QueryDeserializer::buildWideRead(const UpdateList &ul,
+                                           const ref<Expr> &index,
+                                           Expr::Width width,
+                                           bool isLittleEndian) {
+  unsigned n = width / ul.root->getRange();
+  ref<Expr> result;
+  for (unsigned byte = 0; byte != n; ++byte) {
+    unsigned offset = isLittleEndian ? byte : n - 1 - byte;
+    ref<Expr> byteIndex =
+        offset ? builder->Add(index, builder->Constant(offset,
+                                                       index->getWidth()))
+               : index;
+    ref<Expr> read = builder->Read(ul, byteIndex);
+    result = byte ? builder->Concat(read, result) : read;
+  }
+  return result;
+}
+
+bool QueryDeserializer::read(char &tag, std::vector<ref<Expr> > &constraints,
+                             ref<Expr> &expr,
+                             std::vector<const Array *> &objects) {
+  uint64_t v;
+  if (!read(v))
+    return false;
+  tag = v;
+
+  bool haveQuery = false;
+  while (pos != end) {
+    uint64_t record, id;
+    if (!read(record))
+      return false;
+    switch (record) {
+    case 'A':
+      if (!readArray())
+        return false;
+      break;
+    case 'U':
+      if (!readUpdate())
+        return false;
+      break;
+    case 'E':
+      if (!readExpr())
+        return false;
+      break;
+    case 'C':
+    case 'Q':
+      if (haveQuery || !read(id) || id >= exprs.size())
+        return false;
+      if (record == 'C') {
+        constraints.push_back(exprs[id]);
+      } else {
+        expr = exprs[id];
+        haveQuery = true;
+      }
+      break;
+    case 'O': {
+      uint64_t count;
+      if (!haveQuery || !read(count))
+        return false;
+      for (uint64_t i = 0; i != count; ++i) {
+        if (!read(id) || id >= arrays.size())
+          return false;
+        objects.push_back(arrays[id]);
+      }
+      return pos == end;
+    }
+    default:
+      return false;
+    }
+  }
+  return haveQuery;
+}
@@ -0,0 +1,216 @@
+//===-- QuerySerializer.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYSERIALIZER_H
+#define KLEE_QUERYSERIALIZER_H
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/Support/MD5.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+class ArrayCache;
+class ExprBuilder;
+
+/// Serializes queries into a byte string that does not depend on the names
+/// of the arrays involved, nor on where their nodes live in memory. Arrays,
+/// update nodes and expressions are numbered in the order they are first
+/// reached. Shared subexpressions are only written once, so queries
+/// differing only in their sharing serialize differently (which at worst
+/// costs a cache miss).
+///
+/// Every record starts with a tag, so that QueryDeserializer can read the
+/// string back.
+class QuerySerializer {
+  std::string buffer;
+  std::unordered_map<const Expr *, uint64_t> exprIds;
+  std::unordered_map<const UpdateNode *, uint64_t> updateIds;
+  std::unordered_map<const Array *, uint64_t> arrayIds;
+
+  void write(uint64_t v) {
+    // LEB128
+    do {
+      unsigned char byte = v & 0x7f;
+      v >>= 7;
+      if (v)
+        byte |= 0x80;
+      buffer.push_back(byte);
+    } while (v);
+  }
+
+  void write(const llvm::APInt &v) {
+    write(v.getBitWidth());
+    for (unsigned i = 0; i != v.getNumWords(); ++i)
+      write(v.getRawData()[i]);
+  }
+
+  uint64_t visitArray(const Array *array) {
+    auto it = arrayIds.find(array);
+    if (it != arrayIds.end())
+      return it->second;
+
+    write('A');
+    write(array->size);
+    write(array->domain);
+    write(array->range);
+    write(array->constantValues.size());
+    for (const ref<ConstantExpr> &ce : array->constantValues)
+      write(ce->getAPValue());
+    uint64_t id = arrayIds.size();
+    arrayIds[array] = id;
+    return id;
+  }
+
+  // Returns 0 for the empty list, or one more than the id of the head.
+  uint64_t visitUpdates(const UpdateNode *head) {
+    std::vector<const UpdateNode *> pending;
+    for (const UpdateNode *un = head; un && !updateIds.count(un); un = un->next)
+      pending.push_back(un);
+    for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+      const UpdateNode *un = *it;
+      uint64_t next = un->next ? updateIds[un->next] + 1 : 0;
+      uint64_t index = visit(un->index), value = visit(un->value);
+      write('U');
+      write(next);
+      write(index);
+      write(value);
+      uint64_t id = updateIds.size();
+      updateIds[un] = id;
+    }
+    return head ? updateIds[head] + 1 : 0;
+  }
+
+public:
+  uint64_t visit(const ref<Expr> &e) {
+    auto it = exprIds.find(e.get());
+    if (it != exprIds.end())
+      return it->second;
+
+    std::vector<uint64_t> kids;
+    for (unsigned i = 0; i != e->getNumKids(); ++i)
+      kids.push_back(visit(e->getKid(i)));
+
+    uint64_t array = 0, updates = 0;
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      array = visitArray(re->updates.root);
+      updates = visitUpdates(re->updates.head);
+    } else if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+      array = visitArray(wre->updates.root);
+      updates = visitUpdates(wre->updates.head);
+    }
+
+    write('E');
+    write(e->getKind());
+    write(e->getWidth());
+    for (uint64_t kid : kids)
+      write(kid);
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      write(ce->getAPValue());
+    } else if (isa<ReadExpr>(e)) {
+      write(array);
+      write(updates);
+    } else if (const WideReadExpr *wre = dyn_cast<WideReadExpr>(e)) {
+      write(array);
+      write(updates);
+      write(wre->isLittleEndian);
+    } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      write(ee->offset);
+    }
+    uint64_t id = exprIds.size();
+    exprIds[e.get()] = id;
+    return id;
+  }
+
+  void visit(const Query &query) {
+    for (const ref<Expr> &c : query.constraints) {
+      uint64_t id = visit(c);
+      write('C');
+      write(id);
+    }
+    uint64_t id = visit(query.expr);
+    write('Q');
+    write(id);
+  }
+
+  void visitObjects(const std::vector<const Array *> &objects) {
+    std::vector<uint64_t> ids;
+    for (const Array *array : objects)
+      ids.push_back(visitArray(array));
+    write('O');
+    write(ids.size());
+    for (uint64_t id : ids)
+      write(id);
+  }
+
+  void writeTag(char tag) { write(tag); }
+
+  const std::string &getBuffer() const { return buffer; }
+
+  /// Returns the arrays written so far, indexed by their number.
+  std::vector<const Array *> getArrays() const {
+    std::vector<const Array *> arrays(arrayIds.size());
+    for (const auto &entry : arrayIds)
+      arrays[entry.second] = entry.first;
+    return arrays;
+  }
+
+  /// Returns the content address of everything written so far.
+  std::string getKey() const {
+    llvm::MD5 hash;
+    hash.update(llvm::StringRef(buffer));
+    llvm::MD5::MD5Result digest;
+    hash.final(digest);
+    return std::string(reinterpret_cast<const char *>(&digest[0]), 16);
+  }
+};
+
+/// Reads back a query written by QuerySerializer, preceded by a tag and
+/// optionally followed by its objects, e.g. in another process solving it.
+/// The arrays are recreated in the given cache under the given names, or
+/// made-up ones, and the expressions with the given builder, if any.
+class QueryDeserializer {
+  const unsigned char *pos, *end;
+  ArrayCache &arrayCache;
+  const std::vector<std::string> *names;
+  ExprBuilder *builder;
+  std::vector<const Array *> arrays;
+  std::vector<UpdateList> updates;
+  std::vector<ref<Expr> > exprs;
+
+  bool read(uint64_t &v);
+  bool read(llvm::APInt &v);
+  bool readArray();
+  bool readUpdate();
+  bool readExpr();
+  ref<Expr> build(Expr::Kind kind, Expr::Width width, const ref<Expr> *kids);
+  ref<Expr> buildWideRead(const UpdateList &ul, const ref<Expr> &index,
+                          Expr::Width width, bool isLittleEndian);
+
+public:
+  QueryDeserializer(const std::string &buffer, ArrayCache &arrayCache,
+                    const std::vector<std::string> *names = nullptr,
+                    ExprBuilder *builder = nullptr)
+      : pos(reinterpret_cast<const unsigned char *>(buffer.data())),
+        end(pos + buffer.size()), arrayCache(arrayCache), names(names),
+        builder(builder) {}
+
+  /// Returns false if the buffer is not a well formed query.
+  bool read(char &tag, std::vector<ref<Expr> > &constraints, ref<Expr> &expr,
+            std::vector<const Array *> &objects);
+};
+}
+
+#endif
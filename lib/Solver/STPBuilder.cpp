@@ -480,11 +480,19 @@ ExprHandle STPBuilder::getInitialRead(const Array *root, unsigned index) {
       bool hashed = _arr_hash.lookupUpdateNodeExpr(un, un_expr);
       
       if (!hashed) {
-	un_expr = vc_writeExpr(vc,
-                               getArrayForUpdate(root, un->next),
-                               construct(un->index, 0),
-                               construct(un->value, 0));
-	
+        // Equal writes may have been allocated separately.
+        UpdateList updates(root, un);
+        auto it = constructedUpdates.find(updates);
+        if (it != constructedUpdates.end()) {
+          un_expr = it->second;
+        } else {
+          un_expr = vc_writeExpr(vc,
+                                 getArrayForUpdate(root, un->next),
+                                 construct(un->index, 0),
+                                 construct(un->value, 0));
+          constructedUpdates.insert(std::make_pair(updates, un_expr));
+        }
+
 	_arr_hash.hashUpdateNodeExpr(un, un_expr);
       }
       
@@ -565,6 +573,10 @@ ExprHandle STPBuilder::constructActual(ref<Expr> e, int *width_out) {
                        construct(re->index, 0));
   }
     
+  case Expr::WideRead:
+    // the arrays hold bytes, read one at a time
+    return construct(cast<WideReadExpr>(e)->lower(), width_out);
+
   case Expr::Select: {
     SelectExpr *se = cast<SelectExpr>(e);
     ExprHandle cond = construct(se->cond, 0);
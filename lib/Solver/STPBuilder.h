@@ -14,6 +14,7 @@
 #include "klee/util/ArrayExprHash.h"
 #include "klee/Config/config.h"
 
+#include <unordered_map>
 #include <vector>
 
 #define Expr VCExpr
@@ -65,6 +66,8 @@ namespace klee {
 class STPBuilder {
   ::VC vc;
   ExprHashMap< std::pair<ExprHandle, unsigned> > constructed;
+  std::unordered_map<UpdateList, ::VCExpr, UpdateListHashFn, UpdateListCmpFn>
+      constructedUpdates;
 
   /// optimizeDivides - Rewrite division and reminders by constants
   /// into multiplies and shifts. STP should probably handle this for
@@ -118,11 +121,24 @@ public:
   ExprHandle getTrue();
   ExprHandle getFalse();
   ExprHandle getInitialRead(const Array *os, unsigned index);
+  // The array variable holding the initial contents of os, or null for a
+  // constant array, whose contents are written into the variable.
+  ::VCExpr getInitialArrayVariable(const Array *os) {
+    return os->isConstantArray() ? nullptr : getInitialArray(os);
+  }
+
+  ExprHandle construct(ref<Expr> e) { return construct(e, 0); }
 
-  ExprHandle construct(ref<Expr> e) { 
-    ExprHandle res = construct(e, 0);
+  void clearConstructCache() {
     constructed.clear();
-    return res;
+    constructedUpdates.clear();
+  }
+
+  /// Clears the construct cache if it holds more than \a maxSize
+  /// expressions.
+  void boundConstructCache(size_t maxSize) {
+    if (constructed.size() > maxSize)
+      clearConstructCache();
   }
 };
 
@@ -13,15 +13,19 @@
 #include "STPSolver.h"
 #include "klee/Constraints.h"
 #include "klee/OptionCategories.h"
+#include "klee/SolverCmdLine.h"
 #include "klee/SolverImpl.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprUtil.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errno.h"
 
+#include <algorithm>
 #include <csignal>
+#include <cstdlib>
 #include <unistd.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -143,6 +147,7 @@ char *STPSolverImpl::getConstraintLog(const Query &query) {
   unsigned long length;
   vc_printQueryStateToBuffer(vc, builder->getFalse(), &buffer, &length, false);
   vc_pop(vc);
+  builder->boundConstructCache(ConstructCacheSize);
 
   return buffer;
 }
@@ -178,6 +183,36 @@ bool STPSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
   return true;
 }
 
+/// Writes the counterexample for \a object to \a data. The counterexample of
+/// an array variable lists the indices the model fixes, the others reading
+/// as zero, so only those need reading.
+static void getArrayCounterExample(::VC vc, STPBuilder *builder,
+                                   const Array *object, unsigned char *data) {
+  ::VCExpr array = builder->getInitialArrayVariable(object);
+  if (!array) {
+    for (unsigned offset = 0; offset < object->size; offset++) {
+      ExprHandle counter =
+          vc_getCounterExample(vc, builder->getInitialRead(object, offset));
+      data[offset] = static_cast<unsigned char>(getBVUnsigned(counter));
+    }
+    return;
+  }
+
+  std::fill(data, data + object->size, 0);
+  ::VCExpr *indices = nullptr, *values = nullptr;
+  int size = 0;
+  vc_getCounterExampleArray(vc, array, &indices, &values, &size);
+  for (int i = 0; i < size; i++) {
+    unsigned long long index = getBVUnsignedLongLong(indices[i]);
+    if (index < object->size)
+      data[index] = static_cast<unsigned char>(getBVUnsigned(values[i]));
+    vc_DeleteExpr(indices[i]);
+    vc_DeleteExpr(values[i]);
+  }
+  free(indices);
+  free(values);
+}
+
 static SolverImpl::SolverRunStatus
 runAndGetCex(::VC vc, STPBuilder *builder, ::VCExpr q,
              const std::vector<const Array *> &objects,
@@ -193,12 +228,7 @@ runAndGetCex(::VC vc, STPBuilder *builder, ::VCExpr q,
   unsigned i = 0; // FIXME C++17: use reference from emplace_back()
   for (const auto object : objects) {
     values.emplace_back(object->size);
-
-    for (unsigned offset = 0; offset < object->size; offset++) {
-      ExprHandle counter =
-          vc_getCounterExample(vc, builder->getInitialRead(object, offset));
-      values[i][offset] = static_cast<unsigned char>(getBVUnsigned(counter));
-    }
+    getArrayCounterExample(vc, builder, object, values[i].data());
     ++i;
   }
 
@@ -241,11 +271,8 @@ runAndGetCexForked(::VC vc, STPBuilder *builder, ::VCExpr q,
     int res = vc_query(vc, q);
     if (!res) {
       for (const auto object : objects) {
-        for (unsigned offset = 0; offset < object->size; offset++) {
-          ExprHandle counter =
-              vc_getCounterExample(vc, builder->getInitialRead(object, offset));
-          *pos++ = static_cast<unsigned char>(getBVUnsigned(counter));
-        }
+        getArrayCounterExample(vc, builder, object, pos);
+        pos += object->size;
       }
     }
     _exit(res);
@@ -317,6 +344,7 @@ bool STPSolverImpl::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  KLEE_TRACE_SCOPE("STPSolver");
   TimerStatIncrementer t(stats::queryTime);
 
   vc_push(vc);
@@ -357,6 +385,9 @@ bool STPSolverImpl::computeInitialValues(
   }
 
   vc_pop(vc);
+  // The encodings stay valid after the pop, as the expressions are owned by
+  // the validity checker rather than by its assertion scopes.
+  builder->boundConstructCache(ConstructCacheSize);
 
   return success;
 }
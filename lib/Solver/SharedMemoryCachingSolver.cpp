@@ -0,0 +1,287 @@
+//===-- SharedMemoryCachingSolver.cpp - Cross-process query cache ---------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "KeyedCachingSolver.h"
+
+#include "klee/Solver.h"
+
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+const char Magic[8] = {'K', 'L', 'E', 'E', 'S', 'Q', 'C', '1'};
+
+/// Slots per set. A key can only be stored in the slots of the set its hash
+/// selects, and evicts the least recently used of them.
+const unsigned Ways = 4;
+const unsigned SlotSize = 256;
+
+struct Header {
+  char magic[8];
+  uint32_t slotSize;
+  uint32_t numSets;
+  /// Set once the creator has initialized the header; the slots start out
+  /// zeroed, i.e. empty.
+  std::atomic<uint32_t> ready;
+  /// Logical time of the last access to any slot.
+  std::atomic<uint64_t> clock;
+};
+
+/// A cache entry. Readers copy the entry and only keep the copy if the
+/// sequence number was even (no write in progress) and unchanged around the
+/// copy. A sequence number of zero marks an empty slot.
+struct Slot {
+  std::atomic<uint32_t> seq;
+  uint32_t length;
+  std::atomic<uint64_t> stamp;
+  /// The run which computed the result.
+  int32_t writer;
+  char key[16];
+  char data[1];
+};
+
+const size_t HeaderSize = 64;
+const size_t MaxResultSize = SlotSize - offsetof(Slot, data);
+
+static_assert(sizeof(Header) <= HeaderSize, "header does not fit");
+static_assert(sizeof(Slot) <= SlotSize, "slot does not fit");
+
+/// Stores the results of successful queries in a set-associative hash table
+/// in POSIX shared memory, which concurrent runs (e.g. the runs of a
+/// parallel campaign on one machine) map to reuse each others' results.
+/// Results are looked up by the MD5 digest of the serialized query, so the
+/// runs need not name their arrays alike.
+///
+/// The table is lock-free: each slot is protected by its own sequence lock,
+/// and a writer which finds a slot being written to gives up on storing its
+/// result. Results too large for a slot are not shared.
+class SharedMemoryCachingSolver : public KeyedCachingSolver {
+  char *base;
+  size_t size;
+  Header *header;
+  // Forked children (as used for asynchronous branch queries) inherit the
+  // mapping, and count as the same run.
+  int32_t run;
+  uint64_t hits, foreignHits, misses;
+  bool lastHitForeign;
+
+  Slot &getSlot(uint64_t index) const {
+    return *reinterpret_cast<Slot *>(base + HeaderSize + index * SlotSize);
+  }
+
+  uint64_t getSet(const std::string &key) const {
+    uint64_t hash;
+    memcpy(&hash, key.data(), sizeof hash);
+    return hash % header->numSets;
+  }
+
+  uint64_t tick() {
+    return header->clock.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+protected:
+  bool lookup(const std::string &key, std::string &result);
+  void insert(const std::string &key, const std::string &result);
+
+  void countHit() {
+    ++hits;
+    ++stats::querySharedCacheHits;
+    if (lastHitForeign) {
+      ++foreignHits;
+      ++stats::querySharedCacheForeignHits;
+    }
+  }
+
+  void countMiss() {
+    ++misses;
+    ++stats::querySharedCacheMisses;
+  }
+
+public:
+  SharedMemoryCachingSolver(Solver *s, char *base, size_t size)
+      : KeyedCachingSolver(s), base(base), size(size),
+        header(reinterpret_cast<Header *>(base)), run(getpid()), hits(0),
+        foreignHits(0), misses(0), lastHitForeign(false) {}
+  ~SharedMemoryCachingSolver();
+};
+}
+
+SharedMemoryCachingSolver::~SharedMemoryCachingSolver() {
+  if (hits + misses)
+    klee_message("Shared query cache: %llu hits (%llu from other runs), "
+                 "%llu misses (%.1f%%)",
+                 (unsigned long long)hits, (unsigned long long)foreignHits,
+                 (unsigned long long)misses, 100.0 * hits / (hits + misses));
+  munmap(base, size);
+}
+
+bool SharedMemoryCachingSolver::lookup(const std::string &key,
+                                       std::string &result) {
+  uint64_t set = getSet(key);
+  for (unsigned way = 0; way != Ways; ++way) {
+    Slot &slot = getSlot(set * Ways + way);
+    uint32_t seq = slot.seq.load(std::memory_order_acquire);
+    if (!seq || (seq & 1) || memcmp(slot.key, key.data(), sizeof slot.key))
+      continue;
+
+    uint32_t length = slot.length;
+    int32_t writer = slot.writer;
+    char data[MaxResultSize];
+    if (length > MaxResultSize)
+      continue;
+    memcpy(data, slot.data, length);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The key may have been overwritten while it was compared as well.
+    if (slot.seq.load(std::memory_order_relaxed) != seq ||
+        memcmp(slot.key, key.data(), sizeof slot.key))
+      continue;
+
+    slot.stamp.store(tick(), std::memory_order_relaxed);
+    result.assign(data, length);
+    lastHitForeign = writer != run;
+    return true;
+  }
+  return false;
+}
+
+void SharedMemoryCachingSolver::insert(const std::string &key,
+                                       const std::string &result) {
+  if (result.size() > MaxResultSize)
+    return;
+
+  // Replace an entry for the same key, else fill an empty slot, else evict
+  // the least recently used slot of the set.
+  uint64_t set = getSet(key);
+  Slot *victim = nullptr;
+  uint64_t oldest = ~UINT64_C(0);
+  for (unsigned way = 0; way != Ways; ++way) {
+    Slot &slot = getSlot(set * Ways + way);
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    if (seq && !memcmp(slot.key, key.data(), sizeof slot.key)) {
+      victim = &slot;
+      break;
+    }
+    uint64_t stamp = seq ? slot.stamp.load(std::memory_order_relaxed) : 0;
+    if (stamp < oldest) {
+      victim = &slot;
+      oldest = stamp;
+    }
+  }
+
+  uint32_t seq = victim->seq.load(std::memory_order_relaxed);
+  if ((seq & 1) ||
+      !victim->seq.compare_exchange_strong(seq, seq + 1,
+                                           std::memory_order_acquire))
+    return;
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(victim->key, key.data(), sizeof victim->key);
+  victim->length = result.size();
+  victim->writer = run;
+  memcpy(victim->data, result.data(), result.size());
+  victim->stamp.store(tick(), std::memory_order_relaxed);
+  // skip zero, which marks empty slots
+  victim->seq.store(seq + 2 ? seq + 2 : 2, std::memory_order_release);
+}
+
+///
+
+Solver *klee::createSharedMemoryCachingSolver(Solver *s,
+                                              const std::string &name,
+                                              unsigned sizeMB) {
+  // POSIX requires portable names to start with a slash.
+  std::string shmName = name[0] == '/' ? name : "/" + name;
+  uint64_t numSets = (uint64_t)sizeMB * 1024 * 1024 / (Ways * SlotSize);
+  if (!numSets)
+    numSets = 1;
+  size_t size = HeaderSize + numSets * Ways * SlotSize;
+
+  // The first run creates and initializes the table, later ones wait until
+  // it is ready and use it at the size it was created with.
+  bool created = true;
+  int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    created = false;
+    fd = shm_open(shmName.c_str(), O_RDWR, 0600);
+  }
+  const char *error = nullptr;
+  if (fd < 0) {
+    error = strerror(errno);
+  } else if (created) {
+    if (ftruncate(fd, size))
+      error = strerror(errno);
+  } else {
+    struct stat st;
+    for (unsigned tries = 0; !error; ++tries) {
+      if (fstat(fd, &st)) {
+        error = strerror(errno);
+      } else if ((size_t)st.st_size >= HeaderSize) {
+        size = st.st_size;
+        break;
+      } else if (tries == 500) {
+        error = "not initialized by its creator";
+      } else {
+        usleep(10000);
+      }
+    }
+  }
+
+  char *base = nullptr;
+  if (!error) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      error = strerror(errno);
+    else
+      base = static_cast<char *>(p);
+  }
+  if (fd >= 0)
+    close(fd);
+
+  if (base) {
+    Header *header = reinterpret_cast<Header *>(base);
+    if (created) {
+      memcpy(header->magic, Magic, sizeof Magic);
+      header->slotSize = SlotSize;
+      header->numSets = numSets;
+      header->ready.store(1, std::memory_order_release);
+    } else {
+      for (unsigned tries = 0;
+           !header->ready.load(std::memory_order_acquire) && tries != 500;
+           ++tries)
+        usleep(10000);
+      if (!header->ready.load(std::memory_order_acquire) ||
+          memcmp(header->magic, Magic, sizeof Magic) ||
+          header->slotSize != SlotSize ||
+          size < HeaderSize + (uint64_t)header->numSets * Ways * SlotSize)
+        error = "not a compatible query cache";
+    }
+    if (error)
+      munmap(base, size);
+  }
+
+  if (error) {
+    klee_warning("Cannot open shared query cache %s: %s", shmName.c_str(),
+                 error);
+    return s;
+  }
+  return new Solver(new SharedMemoryCachingSolver(s, base, size));
+}
@@ -10,9 +10,13 @@
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
 #include "klee/Constraints.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
 
 using namespace klee;
 
+bool SpeculationScope::active = false;
+
 const char *Solver::validity_to_str(Validity v) {
   switch (v) {
   default:    return "Unknown";
@@ -77,6 +81,61 @@ bool Solver::mayBeFalse(const Query& query, bool &result) {
   return true;
 }
 
+bool Solver::mayBeTrue(const ConstraintManager &constraints,
+                       const std::vector< ref<Expr> > &conditions,
+                       std::vector<bool> &result) {
+  result.assign(conditions.size(), false);
+
+  std::vector<unsigned> undecided;
+  for (unsigned i = 0, e = conditions.size(); i != e; ++i) {
+    assert(conditions[i]->getWidth() == Expr::Bool && "Invalid expression type!");
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(conditions[i]))
+      result[i] = CE->isTrue();
+    else
+      undecided.push_back(i);
+  }
+  if (undecided.empty())
+    return true;
+
+  std::vector<const Array*> objects;
+  findSymbolicObjects(conditions.begin(), conditions.end(), objects);
+
+  while (!undecided.empty()) {
+    // Ask for a model of the disjunction of everything still undecided. If
+    // there is none, none of them is feasible.
+    ref<Expr> any = ConstantExpr::alloc(0, Expr::Bool);
+    for (unsigned i : undecided)
+      any = OrExpr::create(conditions[i], any);
+
+    std::vector< std::vector<unsigned char> > values;
+    bool hasSolution;
+    if (!impl->computeInitialValues(Query(constraints, Expr::createIsZero(any)),
+                                    objects, values, hasSolution))
+      return false;
+    if (!hasSolution)
+      break;
+
+    // Every condition the model satisfies is feasible. The model satisfies
+    // the disjunction, so at least one condition is decided per round.
+    Assignment model(objects, values);
+    std::vector<unsigned> remaining;
+    for (unsigned i : undecided) {
+      ref<ConstantExpr> value =
+          dyn_cast<ConstantExpr>(model.evaluate(conditions[i]));
+      assert(!value.isNull() && "model does not cover condition");
+      if (value->isTrue())
+        result[i] = true;
+      else
+        remaining.push_back(i);
+    }
+    if (remaining.size() == undecided.size())
+      return false;
+    undecided.swap(remaining);
+  }
+
+  return true;
+}
+
 bool Solver::getValue(const Query& query, ref<ConstantExpr> &result) {
   // Maintain invariants implementation expect.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr)) {
@@ -93,6 +152,23 @@ bool Solver::getValue(const Query& query, ref<ConstantExpr> &result) {
   return true;
 }
 
+bool Solver::getUniqueValue(const Query &query, ref<ConstantExpr> &result,
+                            bool &isUnique) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr)) {
+    result = CE;
+    isUnique = true;
+    return true;
+  }
+
+  std::vector<const Array *> objects;
+  findSymbolicObjects(query.expr, objects);
+  std::vector<std::vector<unsigned char> > values, otherValues;
+  if (!impl->computeUniqueValue(query, objects, values, otherValues, isUnique))
+    return false;
+  result = cast<ConstantExpr>(Assignment(objects, values).evaluate(query.expr));
+  return true;
+}
+
 bool 
 Solver::getInitialValues(const Query& query,
                          const std::vector<const Array*> &objects,
@@ -127,6 +203,12 @@ std::pair< ref<Expr>, ref<Expr> > Solver::getRange(const Query& query) {
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
     min = max = CE->getZExtValue();
   } else {
+    // a solver able to optimize finds each bound with a single query
+    ref<ConstantExpr> lower, upper;
+    if (impl->computeBound(query, false, lower) &&
+        impl->computeBound(query, true, upper))
+      return std::make_pair(lower, upper);
+
     // binary search for # of useful bits
     uint64_t lo=0, hi=width, mid, bits=0;
     while (lo<hi) {
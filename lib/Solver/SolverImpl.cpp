@@ -9,6 +9,7 @@
 
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
+#include "klee/util/Assignment.h"
 
 using namespace klee;
 
@@ -28,6 +29,25 @@ bool SolverImpl::computeValidity(const Query &query, Solver::Validity &result) {
   return true;
 }
 
+bool SolverImpl::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  bool hasSolution;
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution) ||
+      !hasSolution)
+    return false;
+  ref<Expr> value = Assignment(objects, values).evaluate(query.expr);
+  assert(isa<ConstantExpr>(value) &&
+         "objects do not cover the query expression");
+
+  if (!computeInitialValues(query.withExpr(EqExpr::create(query.expr, value)),
+                            objects, otherValues, hasSolution))
+    return false;
+  isUnique = !hasSolution;
+  return true;
+}
+
 const char *SolverImpl::getOperationStatusString(SolverRunStatus statusCode) {
   switch (statusCode) {
   case SOLVER_RUN_STATUS_SUCCESS_SOLVABLE:
@@ -15,14 +15,47 @@ Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
+Statistic stats::queriesZ3Arrays("QueriesZ3Arrays", "QZ3arrays");
+Statistic stats::queriesZ3BitVector("QueriesZ3BitVector", "QZ3bv");
+Statistic stats::queriesZ3Large("QueriesZ3Large", "QZ3large");
+Statistic stats::queriesZ3NonLinear("QueriesZ3NonLinear", "QZ3nonlinear");
 Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryCexPoolHits("QueryCexPoolHits", "QCexPoolHits");
+Statistic stats::queryCexCores("QueryCexCores", "QCexCores");
+Statistic stats::queryFactorCacheHits("QueryFactorCacheHits", "QFChits");
+Statistic stats::queryFactorCacheMisses("QueryFactorCacheMisses",
+                                        "QFCmisses");
+Statistic stats::queryKnownBitsHits("QueryKnownBitsHits", "QKBhits");
+Statistic stats::queryKnownBitsMisses("QueryKnownBitsMisses", "QKBmisses");
+Statistic stats::queryCanonicalCacheHits("QueryCanonicalCacheHits",
+                                         "QCCHits");
+Statistic stats::queryCanonicalCacheMisses("QueryCanonicalCacheMisses",
+                                           "QCCMisses");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits",
+                                          "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses",
+                                            "QPCmisses");
+Statistic stats::querySharedCacheHits("QuerySharedCacheHits", "QSChits");
+Statistic stats::querySharedCacheForeignHits("QuerySharedCacheForeignHits",
+                                             "QSCforeignHits");
+Statistic stats::querySharedCacheMisses("QuerySharedCacheMisses",
+                                        "QSCmisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryNodes("QueryNodes", "Qnodes");
+Statistic stats::queryMaxDepth("QueryMaxDepth", "Qdepth");
+Statistic stats::queryArrays("QueryArrays", "Qarrays");
+Statistic stats::queryUpdates("QueryUpdates", "Qupdates");
+Statistic stats::queryConstraints("QueryConstraints", "Qconstraints");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::queryTimeoutPredictions("QueryTimeoutPredictions",
+                                         "QTOpredicted");
+Statistic stats::speculativeQueries("SpeculativeQueries", "SpecQ");
+Statistic stats::speculativeQueryHits("SpeculativeQueryHits", "SpecQhits");
 
 #ifdef KLEE_ARRAY_DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
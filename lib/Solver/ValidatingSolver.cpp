@@ -9,6 +9,7 @@
 #include "klee/Constraints.h"
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
+#include "klee/util/Assignment.h"
 #include <vector>
 
 namespace klee {
@@ -25,6 +26,12 @@ public:
   bool computeValidity(const Query &, Solver::Validity &result);
   bool computeTruth(const Query &, bool &isValid);
   bool computeValue(const Query &, ref<Expr> &result);
+  bool computeBound(const Query &, bool maximize, ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query &query,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
   bool computeInitialValues(const Query &,
                             const std::vector<const Array *> &objects,
                             std::vector<std::vector<unsigned char> > &values,
@@ -80,6 +87,50 @@ bool ValidatingSolver::computeValue(const Query &query, ref<Expr> &result) {
   return true;
 }
 
+bool ValidatingSolver::computeBound(const Query &query, bool maximize,
+                                    ref<ConstantExpr> &result) {
+  bool isBound, isValue;
+
+  if (!solver->impl->computeBound(query, maximize, result))
+    return false;
+  // The bound must be a legal solution, and no solution may exceed it.
+  ref<Expr> inRange = maximize ? UleExpr::create(query.expr, result)
+                               : UleExpr::create(result, query.expr);
+  if (!oracle->impl->computeTruth(query.withExpr(inRange), isBound))
+    return false;
+  if (!oracle->impl->computeTruth(
+          query.withExpr(NeExpr::create(query.expr, result)), isValue))
+    return false;
+
+  if (!isBound || isValue)
+    assert(0 && "invalid solver result (computeBound)");
+
+  return true;
+}
+
+bool ValidatingSolver::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  bool isIllegal, answer;
+
+  if (!solver->impl->computeUniqueValue(query, objects, values, otherValues,
+                                        isUnique))
+    return false;
+  ref<Expr> value = Assignment(objects, values).evaluate(query.expr);
+  if (!oracle->impl->computeTruth(
+          query.withExpr(NeExpr::create(query.expr, value)), isIllegal))
+    return false;
+  if (!oracle->impl->computeTruth(
+          query.withExpr(EqExpr::create(query.expr, value)), answer))
+    return false;
+
+  if (isIllegal || isUnique != answer)
+    assert(0 && "invalid solver result (computeUniqueValue)");
+
+  return true;
+}
+
 bool ValidatingSolver::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
@@ -0,0 +1,624 @@
+//===-- WorkerPoolSolver.cpp - Core solver in long-lived processes --------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerializer.h"
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/Trace.h"
+#include "klee/Internal/System/NUMA.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+using namespace klee;
+
+namespace {
+
+enum Operation : char {
+  Truth = 'T',
+  Validity = 'V',
+  Value = 'E',
+  InitialValues = 'I'
+};
+
+/// Room for the serialized query, and then for the result.
+const size_t MailboxSize = 16 << 20;
+
+/// Workers are replaced after this many queries, as the expressions of all
+/// queries they have solved stay alive in the solver's caches.
+const unsigned RecycleAfter = 1000;
+
+/// The answers to speculative queries kept at most, the oldest are dropped.
+const unsigned MaxAnswers = 64;
+
+struct PoolHeader {
+  /// Posted to ask the spawner for the workers which are wanted.
+  sem_t spawn;
+  std::atomic<bool> shutdown;
+};
+
+/// Where the run and one worker exchange queries and results.
+struct Mailbox {
+  sem_t request, response;
+  /// The worker serving this mailbox, 0 while it is being started, or -1 if
+  /// it could not be started.
+  std::atomic<pid_t> pid;
+  std::atomic<bool> wanted;
+  uint64_t timeout;
+  uint64_t length;
+};
+
+const size_t HeaderSize = 128;
+const size_t MailboxHeaderSize = 256;
+
+static_assert(sizeof(PoolHeader) <= HeaderSize, "header does not fit");
+static_assert(sizeof(Mailbox) <= MailboxHeaderSize, "mailbox does not fit");
+
+void waitFor(sem_t *s) {
+  while (sem_wait(s) && errno == EINTR)
+    ;
+}
+
+/// Dies with the process which forked the caller.
+void dieWithParent(pid_t parent) {
+#ifdef __linux__
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+  if (getppid() != parent)
+    _exit(1);
+}
+
+/// Runs the core solver on queries handed over in shared memory by processes
+/// which are forked when the solver is created, before the run grows large.
+/// A small spawner process forks the workers, so that replacing one is as
+/// cheap as the first start. Timeouts are enforced by killing the worker,
+/// which then gets replaced. Only the process which created the solver uses
+/// the workers; processes forked from it solve their queries themselves.
+///
+/// Speculative queries (see SpeculationScope) are left running on their
+/// worker, which is polled for the answer whenever another query comes.
+class WorkerPoolSolver : public SolverImpl {
+  Solver *solver;
+  char *base;
+  size_t size;
+  unsigned numWorkers, maxSpeculative;
+  pid_t owner, spawner;
+  std::vector<unsigned> served;
+  /// The speculative request each worker is solving, empty if none, and
+  /// when it times out (the default point if never).
+  std::vector<std::string> speculating;
+  std::vector<time::Point> speculationDeadlines;
+  /// The successful answers to speculative requests, by request, and the
+  /// requests in the order they were answered.
+  std::unordered_map<std::string, std::string> answers;
+  std::deque<const std::string *> answerOrder;
+  time::Span timeout;
+  SolverRunStatus runStatusCode;
+
+  PoolHeader &getHeader() const {
+    return *reinterpret_cast<PoolHeader *>(base);
+  }
+
+  Mailbox &getMailbox(unsigned i) const {
+    return *reinterpret_cast<Mailbox *>(
+        base + HeaderSize + i * (MailboxHeaderSize + MailboxSize));
+  }
+
+  char *getData(unsigned i) const {
+    return reinterpret_cast<char *>(&getMailbox(i)) + MailboxHeaderSize;
+  }
+
+  [[noreturn]] void runSpawner(pid_t parent);
+  [[noreturn]] void runWorker(unsigned i);
+
+  /// Runs \a op on \a solver and serializes the outcome: success flag, run
+  /// status, then the operation specific payload.
+  static std::string run(Solver *solver, Operation op, const Query &query,
+                         const std::vector<const Array *> *objects);
+
+  /// Returns a mailbox with a live worker, or -1 if there is none.
+  int getWorker();
+  /// Kills the worker of mailbox \a i and asks for a new one.
+  void replaceWorker(unsigned i);
+
+  /// Hands \a request to the worker of mailbox \a i.
+  void post(unsigned i, const std::string &request);
+  /// Waits for the worker of mailbox \a i to answer.
+  bool await(unsigned i, std::string &result);
+
+  /// Keeps the answers of the speculative requests which are done, and
+  /// replaces the workers which crashed or timed out on one.
+  void collectSpeculations();
+  /// Starts \a request on an idle worker, if the budget allows.
+  void speculate(const std::string &request);
+  void keepAnswer(const std::string &request, const std::string &result);
+
+  bool dispatch(Operation op, const Query &query,
+                const std::vector<const Array *> *objects,
+                std::string &result);
+
+public:
+  WorkerPoolSolver(Solver *s, char *base, size_t size, unsigned numWorkers,
+                   unsigned maxSpeculative);
+  ~WorkerPoolSolver();
+
+  /// Forks the spawner, returns false if that fails.
+  bool start();
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span t) {
+    timeout = t;
+    solver->impl->setCoreSolverTimeout(t);
+  }
+};
+}
+
+WorkerPoolSolver::WorkerPoolSolver(Solver *s, char *base, size_t size,
+                                   unsigned numWorkers, unsigned maxSpeculative)
+    : solver(s), base(base), size(size), numWorkers(numWorkers),
+      maxSpeculative(maxSpeculative), owner(getpid()), spawner(0),
+      served(numWorkers), speculating(numWorkers),
+      speculationDeadlines(numWorkers),
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+  PoolHeader &header = getHeader();
+  sem_init(&header.spawn, 1, 0);
+  header.shutdown = false;
+  for (unsigned i = 0; i != numWorkers; ++i) {
+    Mailbox &m = getMailbox(i);
+    sem_init(&m.request, 1, 0);
+    sem_init(&m.response, 1, 0);
+    m.pid = 0;
+    m.wanted = true;
+  }
+}
+
+WorkerPoolSolver::~WorkerPoolSolver() {
+  if (spawner > 0 && getpid() == owner) {
+    getHeader().shutdown = true;
+    sem_post(&getHeader().spawn);
+    int status;
+    while (waitpid(spawner, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+  munmap(base, size);
+  delete solver;
+}
+
+bool WorkerPoolSolver::start() {
+  fflush(stdout);
+  fflush(stderr);
+  pid_t parent = getpid();
+  spawner = fork();
+  if (spawner == -1) {
+    klee_warning("fork failed (for solver workers) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  if (spawner == 0)
+    runSpawner(parent);
+  sem_post(&getHeader().spawn);
+  return true;
+}
+
+void WorkerPoolSolver::runSpawner(pid_t parent) {
+  dieWithParent(parent);
+  // reap the workers automatically
+  signal(SIGCHLD, SIG_IGN);
+  PoolHeader &header = getHeader();
+  for (;;) {
+    waitFor(&header.spawn);
+    if (header.shutdown) {
+      for (unsigned i = 0; i != numWorkers; ++i)
+        if (getMailbox(i).pid > 0)
+          kill(getMailbox(i).pid, SIGKILL);
+      // returns once all workers are gone
+      while (wait(nullptr) >= 0 || errno == EINTR)
+        ;
+      _exit(0);
+    }
+    for (unsigned i = 0; i != numWorkers; ++i) {
+      Mailbox &m = getMailbox(i);
+      if (!m.wanted.exchange(false))
+        continue;
+      pid_t self = getpid();
+      pid_t pid = fork();
+      if (pid == 0) {
+        signal(SIGCHLD, SIG_DFL);
+        dieWithParent(self);
+        runWorker(i);
+      }
+      m.pid = pid > 0 ? pid : -1;
+    }
+  }
+}
+
+void WorkerPoolSolver::runWorker(unsigned i) {
+  Mailbox &m = getMailbox(i);
+  char *data = getData(i);
+  // before the caches of the worker are allocated
+  numa::placeWorker(i);
+  ArrayCache arrays;
+  for (;;) {
+    waitFor(&m.request);
+    solver->impl->setCoreSolverTimeout(time::microseconds(m.timeout));
+
+    char op;
+    std::vector<ref<Expr> > constraints;
+    ref<Expr> expr;
+    std::vector<const Array *> objects;
+    std::string request(data, m.length);
+    QueryDeserializer deserializer(request, arrays);
+    std::string result;
+    if (deserializer.read(op, constraints, expr, objects)) {
+      ConstraintManager cm(constraints);
+      result = run(solver, static_cast<Operation>(op), Query(cm, expr),
+                   op == InitialValues ? &objects : nullptr);
+    }
+    if (result.size() > MailboxSize)
+      result.clear();
+    if (result.empty()) {
+      result.push_back(false);
+      result.push_back(SOLVER_RUN_STATUS_FAILURE);
+    }
+    memcpy(data, result.data(), result.size());
+    m.length = result.size();
+    sem_post(&m.response);
+  }
+}
+
+std::string WorkerPoolSolver::run(Solver *solver, Operation op,
+                                  const Query &query,
+                                  const std::vector<const Array *> *objects) {
+  std::string payload;
+  bool success = false;
+  switch (op) {
+  case Truth: {
+    bool isValid;
+    success = solver->impl->computeTruth(query, isValid);
+    payload.push_back(isValid);
+    break;
+  }
+  case Validity: {
+    Solver::Validity validity;
+    success = solver->impl->computeValidity(query, validity);
+    payload.push_back(validity + 1);
+    break;
+  }
+  case Value: {
+    ref<Expr> value;
+    success = solver->impl->computeValue(query, value);
+    if (success) {
+      const llvm::APInt &v = cast<ConstantExpr>(value)->getAPValue();
+      payload.assign(reinterpret_cast<const char *>(v.getRawData()),
+                     v.getNumWords() * sizeof(uint64_t));
+    }
+    break;
+  }
+  case InitialValues: {
+    std::vector<std::vector<unsigned char> > values;
+    bool hasSolution;
+    success = solver->impl->computeInitialValues(query, *objects, values,
+                                                 hasSolution);
+    payload.push_back(hasSolution);
+    if (success && hasSolution)
+      for (const std::vector<unsigned char> &v : values)
+        payload.append(v.begin(), v.end());
+    break;
+  }
+  }
+  std::string result;
+  result.push_back(success);
+  result.push_back(solver->impl->getOperationStatusCode());
+  return result + payload;
+}
+
+int WorkerPoolSolver::getWorker() {
+  // Wait a little for workers being started, e.g. after a timeout.
+  for (unsigned tries = 0; tries != 10000; ++tries) {
+    bool starting = false;
+    for (unsigned i = 0; i != numWorkers; ++i) {
+      pid_t pid = getMailbox(i).pid;
+      if (pid > 0 && speculating[i].empty())
+        return i;
+      starting |= pid == 0 || (pid > 0 && !speculating[i].empty());
+    }
+    if (!starting)
+      break;
+    usleep(1000);
+    collectSpeculations();
+  }
+  return -1;
+}
+
+void WorkerPoolSolver::replaceWorker(unsigned i) {
+  Mailbox &m = getMailbox(i);
+  pid_t pid = m.pid;
+  if (pid > 0) {
+    kill(pid, SIGKILL);
+    // The spawner reaps the worker, after which it cannot touch the mailbox
+    // anymore.
+    for (unsigned tries = 0; kill(pid, 0) == 0 && tries != 1000; ++tries)
+      usleep(1000);
+  }
+  sem_destroy(&m.request);
+  sem_destroy(&m.response);
+  sem_init(&m.request, 1, 0);
+  sem_init(&m.response, 1, 0);
+  served[i] = 0;
+  speculating[i].clear();
+  m.pid = 0;
+  m.wanted = true;
+  sem_post(&getHeader().spawn);
+}
+
+void WorkerPoolSolver::post(unsigned i, const std::string &request) {
+  Mailbox &m = getMailbox(i);
+  memcpy(getData(i), request.data(), request.size());
+  m.length = request.size();
+  m.timeout = timeout.toMicroseconds();
+  sem_post(&m.request);
+}
+
+bool WorkerPoolSolver::await(unsigned i, std::string &result) {
+  Mailbox &m = getMailbox(i);
+  // Poll for the answer, so that a crashed worker is noticed.
+  time::Point deadline = time::getWallTime() + timeout;
+  for (;;) {
+    struct timespec slice;
+    clock_gettime(CLOCK_REALTIME, &slice);
+    slice.tv_nsec += 100 * 1000 * 1000;
+    if (slice.tv_nsec >= 1000 * 1000 * 1000) {
+      slice.tv_nsec -= 1000 * 1000 * 1000;
+      ++slice.tv_sec;
+    }
+    if (!sem_timedwait(&m.response, &slice))
+      break;
+    if (errno == EINTR)
+      continue;
+    if (timeout && time::getWallTime() >= deadline) {
+      klee_warning("solver worker timed out");
+      replaceWorker(i);
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+      return false;
+    }
+    if (kill(m.pid, 0) != 0) {
+      klee_warning("solver worker did not return successfully. Most likely "
+                   "you forgot to run 'ulimit -s unlimited'");
+      replaceWorker(i);
+      runStatusCode = SOLVER_RUN_STATUS_INTERRUPTED;
+      return false;
+    }
+  }
+
+  result.assign(getData(i), m.length);
+  if (++served[i] == RecycleAfter)
+    replaceWorker(i);
+  runStatusCode = static_cast<SolverRunStatus>(result[1]);
+  return result[0];
+}
+
+void WorkerPoolSolver::collectSpeculations() {
+  for (unsigned i = 0; i != numWorkers; ++i) {
+    if (speculating[i].empty())
+      continue;
+    Mailbox &m = getMailbox(i);
+    if (!sem_trywait(&m.response)) {
+      std::string result(getData(i), m.length);
+      if (result[0])
+        keepAnswer(speculating[i], result);
+      speculating[i].clear();
+      if (++served[i] == RecycleAfter)
+        replaceWorker(i);
+    } else if (kill(m.pid, 0) != 0 ||
+               (speculationDeadlines[i] != time::Point() &&
+                time::getWallTime() >= speculationDeadlines[i])) {
+      replaceWorker(i);
+    }
+  }
+}
+
+void WorkerPoolSolver::speculate(const std::string &request) {
+  if (request.size() > MailboxSize || answers.count(request))
+    return;
+  unsigned busy = 0;
+  int idle = -1;
+  for (unsigned i = 0; i != numWorkers; ++i) {
+    if (!speculating[i].empty()) {
+      if (speculating[i] == request)
+        return;
+      ++busy;
+    } else if (idle < 0 && getMailbox(i).pid > 0) {
+      idle = i;
+    }
+  }
+  if (idle < 0 || busy >= maxSpeculative || busy + 1 >= numWorkers)
+    return;
+
+  post(idle, request);
+  speculating[idle] = request;
+  speculationDeadlines[idle] =
+      timeout ? time::getWallTime() + timeout : time::Point();
+  ++stats::speculativeQueries;
+}
+
+void WorkerPoolSolver::keepAnswer(const std::string &request,
+                                  const std::string &result) {
+  if (answers.size() == MaxAnswers) {
+    answers.erase(answers.find(*answerOrder.front()));
+    answerOrder.pop_front();
+  }
+  auto inserted = answers.emplace(request, result);
+  if (inserted.second)
+    answerOrder.push_back(&inserted.first->first);
+}
+
+bool WorkerPoolSolver::dispatch(Operation op, const Query &query,
+                                const std::vector<const Array *> *objects,
+                                std::string &result) {
+  KLEE_TRACE_SCOPE("WorkerPoolSolver");
+  int worker = -1;
+  QuerySerializer serializer;
+  if (spawner > 0 && getpid() == owner) {
+    serializer.writeTag(op);
+    serializer.visit(query);
+    if (objects)
+      serializer.visitObjects(*objects);
+    const std::string &request = serializer.getBuffer();
+
+    collectSpeculations();
+    if (SpeculationScope::isActive()) {
+      speculate(request);
+      runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+      return false;
+    }
+    auto answer = answers.find(request);
+    if (answer != answers.end()) {
+      ++stats::speculativeQueryHits;
+      result = answer->second;
+      answerOrder.erase(std::find(answerOrder.begin(), answerOrder.end(),
+                                  &answer->first));
+      answers.erase(answer);
+      runStatusCode = static_cast<SolverRunStatus>(result[1]);
+      return result[0];
+    }
+    for (unsigned i = 0; i != numWorkers; ++i) {
+      if (speculating[i] == request) {
+        ++stats::speculativeQueryHits;
+        speculating[i].clear();
+        return await(i, result);
+      }
+    }
+
+    if (request.size() > MailboxSize)
+      klee_warning_once(0, "query too large for the solver workers, solving "
+                           "it in the main process");
+    else if ((worker = getWorker()) < 0)
+      klee_warning_once(0, "no solver worker available, solving queries in "
+                           "the main process");
+  } else if (SpeculationScope::isActive()) {
+    runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+    return false;
+  }
+  if (worker < 0) {
+    result = run(solver, op, query, objects);
+    runStatusCode = static_cast<SolverRunStatus>(result[1]);
+    return result[0];
+  }
+
+  post(worker, serializer.getBuffer());
+  return await(worker, result);
+}
+
+bool WorkerPoolSolver::computeTruth(const Query &query, bool &isValid) {
+  std::string result;
+  if (!dispatch(Truth, query, nullptr, result))
+    return false;
+  isValid = result[2];
+  return true;
+}
+
+bool WorkerPoolSolver::computeValidity(const Query &query,
+                                       Solver::Validity &validity) {
+  std::string result;
+  if (!dispatch(Validity, query, nullptr, result))
+    return false;
+  validity = static_cast<Solver::Validity>(result[2] - 1);
+  return true;
+}
+
+bool WorkerPoolSolver::computeValue(const Query &query, ref<Expr> &value) {
+  std::string result;
+  if (!dispatch(Value, query, nullptr, result))
+    return false;
+  Expr::Width width = query.expr->getWidth();
+  std::vector<uint64_t> words(llvm::APInt::getNumWords(width));
+  assert(result.size() == 2 + words.size() * sizeof(uint64_t) &&
+         "unexpected value size");
+  memcpy(&words[0], result.data() + 2, words.size() * sizeof(uint64_t));
+  value = ConstantExpr::alloc(llvm::APInt(width, words));
+  return true;
+}
+
+bool WorkerPoolSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  std::string result;
+  if (!dispatch(InitialValues, query, &objects, result))
+    return false;
+  hasSolution = result[2];
+  if (!hasSolution)
+    return true;
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(result.data()) + 3;
+  for (const Array *array : objects) {
+    values.push_back(std::vector<unsigned char>(data, data + array->size));
+    data += array->size;
+  }
+  assert(data == reinterpret_cast<const unsigned char *>(result.data()) +
+                     result.size() &&
+         "unexpected number of values");
+  return true;
+}
+
+///
+
+Solver *klee::createWorkerPoolSolver(Solver *s, unsigned numWorkers,
+                                     unsigned maxSpeculative) {
+  assert(numWorkers && "worker pool without workers");
+  size_t size = HeaderSize + numWorkers * (MailboxHeaderSize + MailboxSize);
+  // Pages are only allocated once touched.
+  void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED) {
+    klee_warning("unable to allocate shared memory for solver workers - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return s;
+  }
+  WorkerPoolSolver *pool =
+      new WorkerPoolSolver(s, static_cast<char *>(p), size, numWorkers,
+                           maxSpeculative);
+  // Without a spawner, every query is solved in the main process.
+  pool->start();
+  return new Solver(pool);
+}
@@ -12,6 +12,7 @@
 
 #include "klee/Expr.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/OptionCategories.h"
 #include "klee/Solver.h"
 #include "klee/SolverStats.h"
 #include "klee/util/Bits.h"
@@ -28,6 +29,16 @@ llvm::cl::opt<bool> UseConstructHashZ3(
     llvm::cl::init(true),
     llvm::cl::cat(klee::ExprCat));
 
+#ifdef HAVE_Z3_MK_LAMBDA
+llvm::cl::opt<unsigned> Z3UpdateRuns(
+    "z3-update-runs", llvm::cl::init(16),
+    llvm::cl::desc("Encode runs of at least this many writes to consecutive "
+                   "constant indices, of one value or copied from another "
+                   "array, as a single array lambda instead of a store per "
+                   "byte. 0 disables it (default=16)"),
+    llvm::cl::cat(klee::SolvingCat));
+#endif
+
 // FIXME: This should be std::atomic<bool>. Need C++11 for that.
 bool Z3InterationLogOpen = false;
 }
@@ -102,6 +113,7 @@ Z3Builder::~Z3Builder() {
   // they aren associated with.
   clearConstructCache();
   _arr_hash.clear();
+  scalarReads.clear();
   constant_array_assertions.clear();
   Z3_del_context(ctx);
   if (z3LogInteractionFile.length() > 0) {
@@ -426,9 +438,172 @@ Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
 }
 
 Z3ASTHandle Z3Builder::getInitialRead(const Array *root, unsigned index) {
+  if (scalarArrays.count(root))
+    return getScalarRead(root, index);
   return readExpr(getInitialArray(root), bvConst32(32, index));
 }
 
+Z3ASTHandle Z3Builder::getScalarRead(const Array *root, uint64_t index) {
+  auto key = std::make_pair(root, index);
+  auto it = scalarReads.find(key);
+  if (it != scalarReads.end())
+    return it->second;
+
+  // Unique by the number of variables, as for arrays.
+  std::string name = root->name.substr(0, 24) + "!" +
+                     llvm::utostr(scalarReads.size());
+  Z3_symbol s = Z3_mk_string_symbol(ctx, name.c_str());
+  Z3ASTHandle var(Z3_mk_const(ctx, s, getBvSort(root->getRange())), ctx);
+  scalarReads.insert(std::make_pair(key, var));
+  return var;
+}
+
+Z3ASTHandle Z3Builder::constructScalarRead(const ReadExpr &re) {
+  const uint64_t index = cast<ConstantExpr>(re.index)->getZExtValue();
+
+  // Writes at other constant indices are skipped, and writes at symbolic
+  // indices become an ite chain down to the latest write at this index.
+  std::vector<const UpdateNode *> writes;
+  const UpdateNode *un = re.updates.head;
+  for (; un; un = un->next) {
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(un->index)) {
+      if (ce->getZExtValue() == index)
+        break;
+    } else {
+      writes.push_back(un);
+    }
+  }
+
+  Z3ASTHandle result = un ? construct(un->value, 0)
+                          : getScalarRead(re.updates.root, index);
+  Z3ASTHandle indexExpr = bvConst64(re.updates.root->getDomain(), index);
+  for (auto it = writes.rbegin(), ie = writes.rend(); it != ie; ++it)
+    result = iteExpr(eqExpr(construct((*it)->index, 0), indexExpr),
+                     construct((*it)->value, 0), result);
+  return result;
+}
+
+void Z3Builder::setScalarArrays(const std::set<const Array *> &arrays) {
+  if (arrays == scalarArrays)
+    return;
+  // The cached encodings may read the arrays the other way.
+  scalarArrays = arrays;
+  clearConstructCache();
+  _arr_hash._update_node_hash.clear();
+}
+
+#ifdef HAVE_Z3_MK_LAMBDA
+/// Writes at consecutive constant indices [lo, hi], all of the same value or
+/// all read from the same updates at the index plus a fixed delta, as left by
+/// memset and memcpy.
+struct UpdateRun {
+  uint64_t lo, hi;
+  /// The update after the run.
+  const UpdateNode *rest;
+  /// The value written, or null for a copy.
+  ref<Expr> fill;
+  const ReadExpr *source;
+  uint64_t delta;
+};
+
+namespace {
+ConstantExpr *getConstantIndex(const ref<Expr> &e) {
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(e);
+  return ce && ce->getWidth() <= Expr::Int64 ? ce : 0;
+}
+
+/// Returns true if the value written by \a un at \a index continues the
+/// copy \a run.
+bool continuesCopy(const UpdateRun &run, const UpdateNode *un,
+                   uint64_t index) {
+  const ReadExpr *re = dyn_cast<ReadExpr>(un->value);
+  if (!re || re->updates.root != run.source->updates.root ||
+      re->updates.head != run.source->updates.head)
+    return false;
+  ConstantExpr *ce = getConstantIndex(re->index);
+  return ce && ce->getZExtValue() - index == run.delta;
+}
+
+/// Finds the run starting with the latest update \a un, if it is at least
+/// \a minLength writes long.
+bool findUpdateRun(const Array *root, const UpdateNode *un,
+                   const std::set<const Array *> &scalarArrays,
+                   unsigned minLength, UpdateRun &run) {
+  ConstantExpr *first = getConstantIndex(un->index);
+  if (!first || !un->next)
+    return false;
+  ConstantExpr *second = getConstantIndex(un->next->index);
+  if (!second)
+    return false;
+  uint64_t index = first->getZExtValue();
+  // the direction in which the writes were made
+  int64_t step;
+  if (second->getZExtValue() + 1 == index)
+    step = 1;
+  else if (second->getZExtValue() == index + 1)
+    step = -1;
+  else
+    return false;
+
+  run.source = dyn_cast<ReadExpr>(un->value);
+  ConstantExpr *sourceIndex = run.source ? getConstantIndex(run.source->index)
+                                         : 0;
+  // Copies read through the theory of arrays, which scalarized arrays are
+  // not encoded with.
+  if (sourceIndex && run.source->updates.root->getDomain() ==
+                         root->getDomain() &&
+      !scalarArrays.count(run.source->updates.root)) {
+    run.delta = sourceIndex->getZExtValue() - index;
+  } else {
+    run.source = 0;
+    run.fill = un->value;
+  }
+
+  unsigned length = 1;
+  const UpdateNode *next = un->next;
+  for (; next; next = next->next, ++length) {
+    ConstantExpr *ce = getConstantIndex(next->index);
+    if (!ce || ce->getZExtValue() != index - step * length)
+      break;
+    if (run.source ? !continuesCopy(run, next, ce->getZExtValue())
+                   : next->value != run.fill)
+      break;
+  }
+  if (length < minLength)
+    return false;
+
+  run.rest = next;
+  run.lo = step > 0 ? index - (length - 1) : index;
+  run.hi = step > 0 ? index : index + (length - 1);
+  return true;
+}
+}
+
+Z3ASTHandle Z3Builder::constructUpdateRun(const Array *root,
+                                          const UpdateRun &run) {
+  unsigned width = root->getDomain();
+  Z3_symbol s = Z3_mk_string_symbol(ctx, "klee_update_index");
+  Z3ASTHandle i(Z3_mk_const(ctx, s, getBvSort(width)), ctx);
+
+  Z3ASTHandle value;
+  if (run.source) {
+    Z3ASTHandle sourceIndex(
+        Z3_mk_bvadd(ctx, i, bvConst64(width, run.delta)), ctx);
+    value = readExpr(getArrayForUpdate(run.source->updates.root,
+                                       run.source->updates.head),
+                     sourceIndex);
+  } else {
+    value = construct(run.fill, 0);
+  }
+  Z3ASTHandle inRun = andExpr(bvLeExpr(bvConst64(width, run.lo), i),
+                              bvLeExpr(i, bvConst64(width, run.hi)));
+  Z3ASTHandle body = iteExpr(inRun, value,
+                             readExpr(getArrayForUpdate(root, run.rest), i));
+  Z3_app bound = Z3_to_app(ctx, i);
+  return Z3ASTHandle(Z3_mk_lambda_const(ctx, 1, &bound, body), ctx);
+}
+#endif
+
 Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
                                          const UpdateNode *un) {
   if (!un) {
@@ -439,8 +614,24 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
     bool hashed = _arr_hash.lookupUpdateNodeExpr(un, un_expr);
 
     if (!hashed) {
-      un_expr = writeExpr(getArrayForUpdate(root, un->next),
-                          construct(un->index, 0), construct(un->value, 0));
+      // Equal writes may have been allocated separately.
+      UpdateList updates(root, un);
+      auto it = constructedUpdates.find(updates);
+      if (it != constructedUpdates.end()) {
+        un_expr = it->second;
+      } else {
+#ifdef HAVE_Z3_MK_LAMBDA
+        UpdateRun run;
+        if (Z3UpdateRuns &&
+            findUpdateRun(root, un, scalarArrays, Z3UpdateRuns, run))
+          un_expr = constructUpdateRun(root, run);
+        else
+#endif
+          un_expr = writeExpr(getArrayForUpdate(root, un->next),
+                              construct(un->index, 0),
+                              construct(un->value, 0));
+        constructedUpdates.insert(std::make_pair(updates, un_expr));
+      }
 
       _arr_hash.hashUpdateNodeExpr(un, un_expr);
     }
@@ -522,10 +713,16 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     ReadExpr *re = cast<ReadExpr>(e);
     assert(re && re->updates.root);
     *width_out = re->updates.root->getRange();
+    if (scalarArrays.count(re->updates.root))
+      return constructScalarRead(*re);
     return readExpr(getArrayForUpdate(re->updates.root, re->updates.head),
                     construct(re->index, 0));
   }
 
+  case Expr::WideRead:
+    // the arrays hold bytes, read one at a time
+    return construct(cast<WideReadExpr>(e)->lower(), width_out);
+
   case Expr::Select: {
     SelectExpr *se = cast<SelectExpr>(e);
     Z3ASTHandle cond = construct(se->cond, 0);
@@ -13,6 +13,8 @@
 #include "klee/Config/config.h"
 #include "klee/util/ArrayExprHash.h"
 #include "klee/util/ExprHashMap.h"
+#include <map>
+#include <set>
 #include <unordered_map>
 #include <z3.h>
 
@@ -100,10 +102,22 @@ public:
   void clear();
 };
 
+#ifdef HAVE_Z3_MK_LAMBDA
+struct UpdateRun;
+#endif
+
 class Z3Builder {
   ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  std::unordered_map<UpdateList, Z3ASTHandle, UpdateListHashFn,
+                     UpdateListCmpFn>
+      constructedUpdates;
   Z3ArrayExprHash _arr_hash;
 
+  // The arrays given to setScalarArrays, and the variables standing for
+  // their bytes.
+  std::set<const Array *> scalarArrays;
+  std::map<std::pair<const Array *, uint64_t>, Z3ASTHandle> scalarReads;
+
 private:
   Z3ASTHandle bvOne(unsigned width);
   Z3ASTHandle bvZero(unsigned width);
@@ -156,6 +170,11 @@ private:
 
   Z3ASTHandle getInitialArray(const Array *os);
   Z3ASTHandle getArrayForUpdate(const Array *root, const UpdateNode *un);
+#ifdef HAVE_Z3_MK_LAMBDA
+  Z3ASTHandle constructUpdateRun(const Array *root, const UpdateRun &run);
+#endif
+  Z3ASTHandle getScalarRead(const Array *root, uint64_t index);
+  Z3ASTHandle constructScalarRead(const ReadExpr &re);
 
   Z3ASTHandle constructActual(ref<Expr> e, int *width_out);
   Z3ASTHandle construct(ref<Expr> e, int *width_out);
@@ -178,6 +197,11 @@ public:
   Z3ASTHandle getTrue();
   Z3ASTHandle getFalse();
   Z3ASTHandle getInitialRead(const Array *os, unsigned index);
+  // The array variable holding the initial contents of os, or null if its
+  // bytes are scalar variables instead.
+  Z3ASTHandle getInitialArrayVariable(const Array *os) {
+    return scalarArrays.count(os) ? Z3ASTHandle() : getInitialArray(os);
+  }
 
   Z3ASTHandle construct(ref<Expr> e) {
     Z3ASTHandle res = construct(e, 0);
@@ -186,7 +210,22 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  /// Encodes the reads of the given arrays, which must all be at constant
+  /// indices, as variables and ite chains over their writes rather than
+  /// with the theory of arrays.
+  void setScalarArrays(const std::set<const Array *> &arrays);
+
+  void clearConstructCache() {
+    constructed.clear();
+    constructedUpdates.clear();
+  }
+
+  /// Clears the construct cache if it holds more than \a maxSize
+  /// expressions.
+  void boundConstructCache(size_t maxSize) {
+    if (constructed.size() > maxSize)
+      clearConstructCache();
+  }
 };
 }
 
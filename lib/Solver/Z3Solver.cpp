@@ -9,6 +9,7 @@
 #include "klee/Config/config.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/OptionCategories.h"
 
 #ifdef ENABLE_Z3
@@ -16,12 +17,17 @@
 #include "Z3Builder.h"
 #include "klee/Constraints.h"
 #include "klee/Solver.h"
+#include "klee/SolverCmdLine.h"
 #include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprUtil.h"
+#include "klee/util/ExprVisitor.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <unordered_set>
+
 namespace {
 // NOTE: Very useful for debugging Z3 behaviour. These files can be given to
 // the z3 binary to replay all Z3 API calls using its `-log` option.
@@ -40,6 +46,70 @@ llvm::cl::opt<bool> Z3ValidateModels(
     llvm::cl::desc("When generating Z3 models validate these against the query"),
     llvm::cl::cat(klee::SolvingCat));
 
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep one Z3 solver across queries and only assert the "
+                   "constraints not shared with the previous query, using "
+                   "push/pop. Z3 may use a slower incremental core in this "
+                   "mode (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<bool> Z3UnsatCores(
+    "z3-unsat-cores", llvm::cl::init(false),
+    llvm::cl::desc("Track the constraints of each query, so that the cex "
+                   "cache remembers the subset of them an unsatisfiable query "
+                   "conflicts on. Not used with -z3-incremental "
+                   "(default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<bool> Z3ScalarizeArrays(
+    "z3-scalarize-arrays", llvm::cl::init(true),
+    llvm::cl::desc("Encode the bytes of arrays which a query only reads at "
+                   "constant indices as bitvector variables, instead of "
+                   "using the theory of arrays. Not used with "
+                   "-z3-incremental (default=true)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3ScalarizeMaxUpdates(
+    "z3-scalarize-max-updates", llvm::cl::init(16),
+    llvm::cl::desc("Maximum number of writes to an array read through with "
+                   "-z3-scalarize-arrays (default=16)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> Z3TacticBitVector(
+    "z3-tactic-bv", llvm::cl::init("QF_BV"),
+    llvm::cl::desc("How to solve the queries in plain bitvector arithmetic "
+                   "once arrays read at constant indices are scalarized: a "
+                   "comma separated list of Z3 tactics applied in order "
+                   "(e.g. simplify,solve-eqs,bit-blast,sat), the SMT-LIB "
+                   "logic to solve them in (e.g. QF_BV), or empty for the "
+                   "default solver of Z3 (default=QF_BV)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> Z3TacticNonLinear(
+    "z3-tactic-nonlinear", llvm::cl::init(""),
+    llvm::cl::desc("As -z3-tactic-bv, for the queries multiplying or "
+                   "dividing two symbolic values (default=empty)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> Z3TacticArrays(
+    "z3-tactic-arrays", llvm::cl::init(""),
+    llvm::cl::desc("As -z3-tactic-bv, for the queries using the theory of "
+                   "arrays, whatever else they do (default=empty)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> Z3TacticLarge(
+    "z3-tactic-large", llvm::cl::init(""),
+    llvm::cl::desc("As -z3-tactic-bv, for the bitvector queries larger than "
+                   "-z3-large-query-size (default=empty)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3LargeQuerySize(
+    "z3-large-query-size", llvm::cl::init(10000),
+    llvm::cl::desc("Number of distinct expressions above which a bitvector "
+                   "query counts as large (default=10000)"),
+    llvm::cl::cat(klee::SolvingCat));
+
 llvm::cl::opt<unsigned>
     Z3VerbosityLevel("debug-z3-verbosity", llvm::cl::init(0),
                      llvm::cl::desc("Z3 verbosity level (default=0)"),
@@ -50,6 +120,66 @@ llvm::cl::opt<unsigned>
 
 namespace klee {
 
+/// The classes of queries which are each solved as configured by their own
+/// option.
+enum class Z3QueryClass { BitVector, NonLinear, Arrays, Large };
+static const unsigned NumZ3QueryClasses = 4;
+
+namespace {
+/// Sorts a query into its Z3QueryClass, given the arrays which are
+/// scalarized.
+class Z3QueryClassifier : public ExprVisitor {
+  const std::set<const Array *> &scalarArrays;
+  bool readsArrays, nonLinear;
+  unsigned size;
+
+  static bool isSymbolic(const ref<Expr> &e) { return !isa<ConstantExpr>(e); }
+
+  Action visitArithmetic(const Expr &e) {
+    if (isSymbolic(e.getKid(0)) && isSymbolic(e.getKid(1)))
+      nonLinear = true;
+    return Action::doChildren();
+  }
+
+protected:
+  Action visitExpr(const Expr &) {
+    ++size;
+    return Action::doChildren();
+  }
+
+  Action visitRead(const ReadExpr &re) {
+    for (const UpdateNode *un = re.updates.head; un; un = un->next) {
+      visit(un->index);
+      visit(un->value);
+    }
+    if (!scalarArrays.count(re.updates.root))
+      readsArrays = true;
+    return Action::doChildren();
+  }
+
+  Action visitMul(const MulExpr &e) { return visitArithmetic(e); }
+  Action visitUDiv(const UDivExpr &e) { return visitArithmetic(e); }
+  Action visitSDiv(const SDivExpr &e) { return visitArithmetic(e); }
+  Action visitURem(const URemExpr &e) { return visitArithmetic(e); }
+  Action visitSRem(const SRemExpr &e) { return visitArithmetic(e); }
+
+public:
+  explicit Z3QueryClassifier(const std::set<const Array *> &scalarArrays)
+      : scalarArrays(scalarArrays), readsArrays(false), nonLinear(false),
+        size(0) {}
+
+  Z3QueryClass getClass() const {
+    if (readsArrays)
+      return Z3QueryClass::Arrays;
+    if (nonLinear)
+      return Z3QueryClass::NonLinear;
+    if (size > Z3LargeQuerySize)
+      return Z3QueryClass::Large;
+    return Z3QueryClass::BitVector;
+  }
+};
+}
+
 class Z3SolverImpl : public SolverImpl {
 private:
   Z3Builder *builder;
@@ -60,6 +190,42 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  // With -z3-incremental: the solver kept across queries, the constraints
+  // asserted in it and, for each of its scopes, the index of the first
+  // constraint asserted in that scope.
+  ::Z3_solver incrementalSolver;
+  std::vector<ref<Expr> > assertedConstraints;
+  std::vector<unsigned> scopeStarts;
+
+  // How the queries of each Z3QueryClass are solved: by a tactic, by a
+  // solver for a logic, or, if neither is set, by the default solver.
+  struct Profile {
+    ::Z3_tactic tactic = nullptr;
+    std::string logic;
+  };
+  Profile profiles[NumZ3QueryClasses];
+
+  void initProfile(Profile &profile, const std::string &spec);
+  ::Z3_solver createSolver(Z3QueryClass queryClass, bool tracksCore);
+
+  // With -z3-unsat-cores: the unsatisfiable core of the last query, if it
+  // had no solution.
+  std::vector<ref<Expr> > unsatCore;
+  bool hasUnsatCore;
+
+  void assertConstantArrays(::Z3_solver theSolver,
+                            const ConstantArrayFinder &finder);
+  void assertConstantArrays(::Z3_optimize theOptimizer,
+                            const ConstantArrayFinder &finder);
+  ::Z3_solver getIncrementalSolver(const Query &);
+  ::Z3_solver openSolver(const Query &, ConstantArrayFinder &constantArrays,
+                        std::vector<Z3ASTHandle> *coreLiterals = nullptr);
+  Z3ASTHandle assertTracked(::Z3_solver theSolver, Z3ASTHandle formula);
+  void extractUnsatCore(::Z3_solver theSolver, const Query &,
+                        const std::vector<Z3ASTHandle> &coreLiterals);
+  void closeSolver(::Z3_solver theSolver);
+  void dumpQuery(::Z3_solver theSolver);
+
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
@@ -83,6 +249,12 @@ public:
 
   bool computeTruth(const Query &, bool &isValid);
   bool computeValue(const Query &, ref<Expr> &result);
+  bool computeBound(const Query &, bool maximize, ref<ConstantExpr> &result);
+  bool computeUniqueValue(const Query &,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &values,
+                          std::vector<std::vector<unsigned char> > &otherValues,
+                          bool &isUnique);
   bool computeInitialValues(const Query &,
                             const std::vector<const Array *> &objects,
                             std::vector<std::vector<unsigned char> > &values,
@@ -93,6 +265,18 @@ public:
                        std::vector<std::vector<unsigned char> > *values,
                        bool &hasSolution);
   SolverRunStatus getOperationStatusCode();
+
+  /// Reads the contents of \a array from the interpretation of its variable
+  /// in \a theModel, instead of evaluating a read of every byte. Returns
+  /// false if the interpretation has a form this does not handle.
+  bool getArrayModel(::Z3_model theModel, const Array *array,
+                     std::vector<unsigned char> &data);
+  bool getUnsatCore(std::vector<ref<Expr> > &core) {
+    if (!hasUnsatCore)
+      return false;
+    core = unsatCore;
+    return true;
+  }
 };
 
 Z3SolverImpl::Z3SolverImpl()
@@ -101,7 +285,8 @@ Z3SolverImpl::Z3SolverImpl()
           /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
               ? Z3LogInteractionFile.c_str()
               : NULL)),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incrementalSolver(NULL),
+      hasUnsatCore(false) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -118,6 +303,11 @@ Z3SolverImpl::Z3SolverImpl()
     klee_message("Dumping Z3 queries to \"%s\"", Z3QueryDumpFile.c_str());
   }
 
+  initProfile(profiles[unsigned(Z3QueryClass::BitVector)], Z3TacticBitVector);
+  initProfile(profiles[unsigned(Z3QueryClass::NonLinear)], Z3TacticNonLinear);
+  initProfile(profiles[unsigned(Z3QueryClass::Arrays)], Z3TacticArrays);
+  initProfile(profiles[unsigned(Z3QueryClass::Large)], Z3TacticLarge);
+
   // Set verbosity
   if (Z3VerbosityLevel > 0) {
     std::string underlyingString;
@@ -129,12 +319,73 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  if (incrementalSolver)
+    Z3_solver_dec_ref(builder->ctx, incrementalSolver);
+  for (Profile &profile : profiles)
+    if (profile.tactic)
+      Z3_tactic_dec_ref(builder->ctx, profile.tactic);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
 
 Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
 
+void Z3SolverImpl::initProfile(Profile &profile, const std::string &spec) {
+  if (spec.empty())
+    return;
+  if (spec.compare(0, 3, "QF_") == 0 || spec == "ALL") {
+    profile.logic = spec;
+    return;
+  }
+
+  std::unordered_set<std::string> known;
+  for (unsigned i = 0, e = Z3_get_num_tactics(builder->ctx); i != e; ++i)
+    known.insert(Z3_get_tactic_name(builder->ctx, i));
+
+  ::Z3_tactic tactic = nullptr;
+  for (size_t start = 0; start <= spec.size();) {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos)
+      end = spec.size();
+    std::string name = spec.substr(start, end - start);
+    start = end + 1;
+    if (!known.count(name))
+      klee_error("unknown Z3 tactic \"%s\" in \"%s\"", name.c_str(),
+                 spec.c_str());
+    ::Z3_tactic next = Z3_mk_tactic(builder->ctx, name.c_str());
+    Z3_tactic_inc_ref(builder->ctx, next);
+    if (tactic) {
+      ::Z3_tactic both = Z3_tactic_and_then(builder->ctx, tactic, next);
+      Z3_tactic_inc_ref(builder->ctx, both);
+      Z3_tactic_dec_ref(builder->ctx, tactic);
+      Z3_tactic_dec_ref(builder->ctx, next);
+      tactic = both;
+    } else {
+      tactic = next;
+    }
+  }
+  profile.tactic = tactic;
+}
+
+/// Returns a new solver for a query of class \a queryClass. Solvers made
+/// from tactics do not take assumptions, so a query tracking its core gets
+/// the default solver instead.
+::Z3_solver Z3SolverImpl::createSolver(Z3QueryClass queryClass,
+                                       bool tracksCore) {
+  static Statistic *const counters[NumZ3QueryClasses] = {
+      &stats::queriesZ3BitVector, &stats::queriesZ3NonLinear,
+      &stats::queriesZ3Arrays, &stats::queriesZ3Large};
+  ++*counters[unsigned(queryClass)];
+
+  const Profile &profile = profiles[unsigned(queryClass)];
+  if (profile.tactic && !tracksCore)
+    return Z3_mk_solver_from_tactic(builder->ctx, profile.tactic);
+  if (!profile.logic.empty())
+    return Z3_mk_solver_for_logic(
+        builder->ctx, Z3_mk_string_symbol(builder->ctx, profile.logic.c_str()));
+  return Z3_mk_solver(builder->ctx);
+}
+
 char *Z3Solver::getConstraintLog(const Query &query) {
   return impl->getConstraintLog(query);
 }
@@ -235,34 +486,163 @@ bool Z3SolverImpl::computeValue(const Query &query, ref<Expr> &result) {
   return true;
 }
 
+bool Z3SolverImpl::computeBound(const Query &query, bool maximize,
+                                ref<ConstantExpr> &result) {
+  Expr::Width width = query.expr->getWidth();
+  if (width > 64)
+    return false;
+
+  KLEE_TRACE_SCOPE("Z3Solver");
+  TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  // Z3's optimization context finds the bound in a single check, where the
+  // generic Solver::getRange needs a query per bit of the expression.
+  Z3_optimize theOptimizer = Z3_mk_optimize(builder->ctx);
+  Z3_optimize_inc_ref(builder->ctx, theOptimizer);
+  Z3_optimize_set_params(builder->ctx, theOptimizer, solverParameters);
+
+  if (!Z3Incremental && Z3ScalarizeArrays) {
+    ScalarArrayFinder scalar_arrays(Z3ScalarizeMaxUpdates);
+    for (auto const &constraint : query.constraints)
+      scalar_arrays.visit(constraint);
+    scalar_arrays.visit(query.expr);
+    builder->setScalarArrays(scalar_arrays.results);
+  }
+
+  ConstantArrayFinder constant_arrays_in_query;
+  for (auto const &constraint : query.constraints) {
+    Z3_optimize_assert(builder->ctx, theOptimizer,
+                       builder->construct(constraint));
+    constant_arrays_in_query.visit(constraint);
+  }
+  Z3ASTHandle z3QueryExpr =
+      Z3ASTHandle(builder->construct(query.expr), builder->ctx);
+  constant_arrays_in_query.visit(query.expr);
+  assertConstantArrays(theOptimizer, constant_arrays_in_query);
+  ++stats::queries;
+
+  // bit-vector objectives are optimized as unsigned numbers
+  if (maximize)
+    Z3_optimize_maximize(builder->ctx, theOptimizer, z3QueryExpr);
+  else
+    Z3_optimize_minimize(builder->ctx, theOptimizer, z3QueryExpr);
+
+#ifdef HAVE_Z3_OPTIMIZE_CHECK_ASSUMPTIONS
+  ::Z3_lbool satisfiable =
+      Z3_optimize_check(builder->ctx, theOptimizer, 0, nullptr);
+#else
+  ::Z3_lbool satisfiable = Z3_optimize_check(builder->ctx, theOptimizer);
+#endif
+
+  bool success = false;
+  if (satisfiable == Z3_L_TRUE) {
+    Z3_model theModel = Z3_optimize_get_model(builder->ctx, theOptimizer);
+    Z3_model_inc_ref(builder->ctx, theModel);
+    ::Z3_ast value;
+    uint64_t bound;
+    if (Z3_model_eval(builder->ctx, theModel, z3QueryExpr,
+                      /*model_completion=*/true, &value) &&
+        Z3_get_numeral_uint64(builder->ctx, value, &bound)) {
+      result = ConstantExpr::create(bound, width);
+      runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+      success = true;
+    }
+    Z3_model_dec_ref(builder->ctx, theModel);
+  } else if (satisfiable == Z3_L_UNDEF) {
+    ::Z3_string reason =
+        ::Z3_optimize_get_reason_unknown(builder->ctx, theOptimizer);
+    if (strcmp(reason, "timeout") == 0 || strcmp(reason, "canceled") == 0)
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    else if (strcmp(reason, "interrupted from keyboard") == 0)
+      runStatusCode = SOLVER_RUN_STATUS_INTERRUPTED;
+  }
+
+  Z3_optimize_dec_ref(builder->ctx, theOptimizer);
+  if (!Z3Incremental)
+    builder->boundConstructCache(ConstructCacheSize);
+  return success;
+}
+
 bool Z3SolverImpl::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
   return internalRunSolver(query, &objects, &values, hasSolution);
 }
 
+bool Z3SolverImpl::computeUniqueValue(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<std::vector<unsigned char> > &otherValues, bool &isUnique) {
+  KLEE_TRACE_SCOPE("Z3Solver");
+  TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  // Both checks share the solver: the first one finds a model of the
+  // constraints, the second one looks for another value with the
+  // disequality added.
+  hasUnsatCore = false;
+  ConstantArrayFinder constant_arrays_in_query;
+  Z3_solver theSolver = openSolver(query, constant_arrays_in_query);
+  ++stats::queries;
+  ++stats::queryCounterexamples;
+  Z3ASTHandle z3QueryExpr =
+      Z3ASTHandle(builder->construct(query.expr), builder->ctx);
+  constant_arrays_in_query.visit(query.expr);
+  assertConstantArrays(theSolver, constant_arrays_in_query);
+  dumpQuery(theSolver);
+
+  bool hasSolution = false;
+  runStatusCode =
+      handleSolverResponse(theSolver, Z3_solver_check(builder->ctx, theSolver),
+                           &objects, &values, hasSolution);
+  bool success = false;
+  if (runStatusCode == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE) {
+    ref<Expr> value = Assignment(objects, values).evaluate(query.expr);
+    assert(isa<ConstantExpr>(value) &&
+           "objects do not cover the query expression");
+    Z3_solver_assert(
+        builder->ctx, theSolver,
+        Z3ASTHandle(Z3_mk_not(builder->ctx,
+                              Z3_mk_eq(builder->ctx, z3QueryExpr,
+                                       builder->construct(value))),
+                    builder->ctx));
+    bool hasOther = false;
+    runStatusCode = handleSolverResponse(
+        theSolver, Z3_solver_check(builder->ctx, theSolver), &objects,
+        &otherValues, hasOther);
+    if (runStatusCode == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+        runStatusCode == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+      isUnique = !hasOther;
+      if (isUnique)
+        ++stats::queriesValid;
+      else
+        ++stats::queriesInvalid;
+      success = true;
+    }
+  }
+
+  closeSolver(theSolver);
+  return success;
+}
+
 bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
 
+  KLEE_TRACE_SCOPE("Z3Solver");
   TimerStatIncrementer t(stats::queryTime);
-  // NOTE: Z3 will switch to using a slower solver internally if push/pop are
-  // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
-  //
-  // TODO: Investigate using a custom tactic as described in
-  // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
-
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  hasUnsatCore = false;
 
+  // The formulas of the query are asserted as implied by a literal each,
+  // and the literals are assumed by the check, which gives the literals
+  // needed to reach a conflict.
+  bool trackCore = Z3UnsatCores && !Z3Incremental;
+  std::vector<Z3ASTHandle> coreLiterals;
   ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
-  }
+  Z3_solver theSolver = openSolver(query, constant_arrays_in_query,
+                                   trackCore ? &coreLiterals : nullptr);
   ++stats::queries;
   if (objects)
     ++stats::queryCounterexamples;
@@ -270,25 +650,125 @@ bool Z3SolverImpl::internalRunSolver(
   Z3ASTHandle z3QueryExpr =
       Z3ASTHandle(builder->construct(query.expr), builder->ctx);
   constant_arrays_in_query.visit(query.expr);
-
-  for (auto const &constant_array : constant_arrays_in_query.results) {
-    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
-           "Constant array found in query, but not handled by Z3Builder");
-    for (auto const &arrayIndexValueExpr :
-         builder->constant_array_assertions[constant_array]) {
-      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
-    }
-  }
+  assertConstantArrays(theSolver, constant_arrays_in_query);
 
   // KLEE Queries are validity queries i.e.
   // ∀ X Constraints(X) → query(X)
   // but Z3 works in terms of satisfiability so instead we ask the
   // negation of the equivalent i.e.
   // ∃ X Constraints(X) ∧ ¬ query(X)
+  Z3ASTHandle z3NegatedQueryExpr =
+      Z3ASTHandle(Z3_mk_not(builder->ctx, z3QueryExpr), builder->ctx);
+  if (trackCore)
+    coreLiterals.push_back(assertTracked(theSolver, z3NegatedQueryExpr));
+  else
+    Z3_solver_assert(builder->ctx, theSolver, z3NegatedQueryExpr);
+  dumpQuery(theSolver);
+
+  ::Z3_lbool satisfiable;
+  if (trackCore) {
+    std::vector<Z3_ast> assumptions(coreLiterals.begin(), coreLiterals.end());
+    satisfiable = Z3_solver_check_assumptions(
+        builder->ctx, theSolver, assumptions.size(), assumptions.data());
+  } else {
+    satisfiable = Z3_solver_check(builder->ctx, theSolver);
+  }
+  runStatusCode = handleSolverResponse(theSolver, satisfiable, objects, values,
+                                       hasSolution);
+  if (trackCore && runStatusCode == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE)
+    extractUnsatCore(theSolver, query, coreLiterals);
+  closeSolver(theSolver);
+
+  if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+      runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+    if (hasSolution) {
+      ++stats::queriesInvalid;
+    } else {
+      ++stats::queriesValid;
+    }
+    return true; // success
+  }
+  return false; // failed
+}
+
+/// Returns a solver with the query constraints asserted, collecting the
+/// constant arrays they read which still need asserting.
+::Z3_solver Z3SolverImpl::openSolver(const Query &query,
+                                     ConstantArrayFinder &constantArrays,
+                                     std::vector<Z3ASTHandle> *coreLiterals) {
+  Z3_solver theSolver;
+  if (Z3Incremental) {
+    // Only the query expression is asserted in a scope of its own; the
+    // constraints stay asserted for the next query.
+    theSolver = getIncrementalSolver(query);
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    // NOTE: Z3 will switch to using a slower solver internally if push/pop
+    // are used so by default a new solver is created for each query.
+    ScalarArrayFinder scalar_arrays(Z3ScalarizeMaxUpdates);
+    if (Z3ScalarizeArrays) {
+      for (auto const &constraint : query.constraints)
+        scalar_arrays.visit(constraint);
+      scalar_arrays.visit(query.expr);
+      builder->setScalarArrays(scalar_arrays.results);
+    }
+
+    Z3QueryClassifier classifier(scalar_arrays.results);
+    for (auto const &constraint : query.constraints)
+      classifier.visit(constraint);
+    classifier.visit(query.expr);
+    theSolver = createSolver(classifier.getClass(), coreLiterals != nullptr);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (auto const &constraint : query.constraints) {
+      if (coreLiterals)
+        coreLiterals->push_back(
+            assertTracked(theSolver, builder->construct(constraint)));
+      else
+        Z3_solver_assert(builder->ctx, theSolver,
+                         builder->construct(constraint));
+      constantArrays.visit(constraint);
+    }
+  }
+  return theSolver;
+}
+
+/// Asserts the formula as implied by a fresh literal, which is returned.
+Z3ASTHandle Z3SolverImpl::assertTracked(::Z3_solver theSolver,
+                                        Z3ASTHandle formula) {
+  Z3ASTHandle literal(
+      Z3_mk_fresh_const(builder->ctx, "core", Z3_mk_bool_sort(builder->ctx)),
+      builder->ctx);
   Z3_solver_assert(
       builder->ctx, theSolver,
-      Z3ASTHandle(Z3_mk_not(builder->ctx, z3QueryExpr), builder->ctx));
+      Z3ASTHandle(Z3_mk_implies(builder->ctx, literal, formula), builder->ctx));
+  return literal;
+}
 
+void Z3SolverImpl::extractUnsatCore(
+    ::Z3_solver theSolver, const Query &query,
+    const std::vector<Z3ASTHandle> &coreLiterals) {
+  Z3_ast_vector core = Z3_solver_get_unsat_core(builder->ctx, theSolver);
+  Z3_ast_vector_inc_ref(builder->ctx, core);
+  std::unordered_set<unsigned> inCore;
+  for (unsigned i = 0, e = Z3_ast_vector_size(builder->ctx, core); i != e; ++i)
+    inCore.insert(
+        Z3_get_ast_id(builder->ctx, Z3_ast_vector_get(builder->ctx, core, i)));
+  Z3_ast_vector_dec_ref(builder->ctx, core);
+
+  // the literals are those of the constraints, then of the query expression
+  unsatCore.clear();
+  unsigned i = 0;
+  for (auto const &constraint : query.constraints)
+    if (inCore.count(Z3_get_ast_id(builder->ctx, coreLiterals[i++])))
+      unsatCore.push_back(constraint);
+  if (inCore.count(Z3_get_ast_id(builder->ctx, coreLiterals[i])))
+    unsatCore.push_back(Expr::createIsZero(query.expr));
+  hasUnsatCore = true;
+}
+
+void Z3SolverImpl::dumpQuery(::Z3_solver theSolver) {
   if (dumpedQueriesFile) {
     *dumpedQueriesFile << "; start Z3 query\n";
     *dumpedQueriesFile << Z3_solver_to_string(builder->ctx, theSolver);
@@ -297,29 +777,95 @@ bool Z3SolverImpl::internalRunSolver(
     *dumpedQueriesFile << "; end Z3 query\n\n";
     dumpedQueriesFile->flush();
   }
+}
 
-  ::Z3_lbool satisfiable = Z3_solver_check(builder->ctx, theSolver);
-  runStatusCode = handleSolverResponse(theSolver, satisfiable, objects, values,
-                                       hasSolution);
+void Z3SolverImpl::closeSolver(::Z3_solver theSolver) {
+  if (Z3Incremental) {
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  } else {
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+    // Bound the builder's cache to prevent memory usage exploding.
+    // By using ``autoClearConstructCache=false`` and clearning now
+    // we allow Z3_ast expressions to be shared from an entire
+    // ``Query`` (and with -construct-cache-size, across queries) rather
+    // than only sharing within a single call to ``builder->construct()``.
+    builder->boundConstructCache(ConstructCacheSize);
+  }
+}
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
-  // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+void Z3SolverImpl::assertConstantArrays(::Z3_solver theSolver,
+                                        const ConstantArrayFinder &finder) {
+  for (auto const &constant_array : finder.results) {
+    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
+           "Constant array found in query, but not handled by Z3Builder");
+    for (auto const &arrayIndexValueExpr :
+         builder->constant_array_assertions[constant_array]) {
+      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+    }
+  }
+}
 
-  if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
-      runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
-    if (hasSolution) {
-      ++stats::queriesInvalid;
-    } else {
-      ++stats::queriesValid;
+void Z3SolverImpl::assertConstantArrays(::Z3_optimize theOptimizer,
+                                        const ConstantArrayFinder &finder) {
+  for (auto const &constant_array : finder.results) {
+    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
+           "Constant array found in query, but not handled by Z3Builder");
+    for (auto const &arrayIndexValueExpr :
+         builder->constant_array_assertions[constant_array]) {
+      Z3_optimize_assert(builder->ctx, theOptimizer, arrayIndexValueExpr);
     }
-    return true; // success
   }
-  return false; // failed
+}
+
+::Z3_solver Z3SolverImpl::getIncrementalSolver(const Query &query) {
+  if (!incrementalSolver) {
+    incrementalSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incrementalSolver);
+  }
+  // the timeout may have changed since the last query
+  Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
+
+  // Queries from the same state (and from its ancestors) share a prefix of
+  // their constraints. Pop the scopes holding constraints past that prefix.
+  const unsigned numConstraints = query.constraints.size();
+  ConstraintManager::const_iterator constraint = query.constraints.begin();
+  unsigned common = 0;
+  while (common < assertedConstraints.size() && common < numConstraints &&
+         assertedConstraints[common] == *constraint) {
+    ++common;
+    ++constraint;
+  }
+
+  unsigned pops = 0;
+  while (assertedConstraints.size() > common) {
+    assertedConstraints.resize(scopeStarts.back());
+    scopeStarts.pop_back();
+    ++pops;
+  }
+  if (pops)
+    Z3_solver_pop(builder->ctx, incrementalSolver, pops);
+
+  // Nothing asserted refers to the cached expressions anymore, so this is
+  // the point to keep the construct cache from growing without bounds.
+  if (assertedConstraints.empty())
+    builder->clearConstructCache();
+
+  if (assertedConstraints.size() < numConstraints) {
+    Z3_solver_push(builder->ctx, incrementalSolver);
+    scopeStarts.push_back(assertedConstraints.size());
+    ConstantArrayFinder constant_arrays;
+    // popping a scope may have dropped some of the common prefix as well
+    constraint = query.constraints.begin() + assertedConstraints.size();
+    for (ConstraintManager::const_iterator ie = query.constraints.end();
+         constraint != ie; ++constraint) {
+      Z3_solver_assert(builder->ctx, incrementalSolver,
+                       builder->construct(*constraint));
+      constant_arrays.visit(*constraint);
+      assertedConstraints.push_back(*constraint);
+    }
+    assertConstantArrays(incrementalSolver, constant_arrays);
+  }
+  return incrementalSolver;
 }
 
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
@@ -345,6 +891,11 @@ SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
       const Array *array = *it;
       std::vector<unsigned char> data;
 
+      if (getArrayModel(theModel, array, data)) {
+        values->push_back(data);
+        continue;
+      }
+
       data.reserve(array->size);
       for (unsigned offset = 0; offset < array->size; offset++) {
         // We can't use Z3ASTHandle here so have to do ref counting manually
@@ -405,6 +956,84 @@ SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
   }
 }
 
+/// Reads the byte value of a numeral from a model into \a value.
+static bool getByteNumeral(::Z3_context ctx, ::Z3_ast e, unsigned &value) {
+  return e && Z3_get_ast_kind(ctx, e) == Z3_NUMERAL_AST &&
+         Z3_get_numeral_uint(ctx, e, &value) && value <= 255;
+}
+
+bool Z3SolverImpl::getArrayModel(::Z3_model theModel, const Array *array,
+                                 std::vector<unsigned char> &data) {
+  Z3ASTHandle variable = builder->getInitialArrayVariable(array);
+  if (!variable)
+    return false;
+  ::Z3_context ctx = builder->ctx;
+  ::Z3_func_decl decl = Z3_get_app_decl(ctx, Z3_to_app(ctx, variable));
+  Z3ASTHandle interp(Z3_model_get_const_interp(ctx, theModel, decl), ctx);
+  if (!interp) {
+    // nothing constrains the array, and model completion gives zeros
+    data.assign(array->size, 0);
+    return true;
+  }
+
+  // The interpretation is either a function with an entry per constrained
+  // index and a default, or a chain of stores into a constant array. In
+  // either case, the earlier of two entries for an index wins.
+  std::vector<std::pair<unsigned, unsigned> > entries;
+  unsigned defaultValue;
+  if (Z3_is_as_array(ctx, interp)) {
+    ::Z3_func_interp f = Z3_model_get_func_interp(
+        ctx, theModel, Z3_get_as_array_func_decl(ctx, interp));
+    if (!f)
+      return false;
+    Z3_func_interp_inc_ref(ctx, f);
+    bool ok = getByteNumeral(ctx, Z3_func_interp_get_else(ctx, f),
+                             defaultValue);
+    for (unsigned i = 0, e = Z3_func_interp_get_num_entries(ctx, f);
+         ok && i != e; ++i) {
+      ::Z3_func_entry entry = Z3_func_interp_get_entry(ctx, f, i);
+      Z3_func_entry_inc_ref(ctx, entry);
+      unsigned index, value;
+      ok = Z3_func_entry_get_num_args(ctx, entry) == 1 &&
+           Z3_get_numeral_uint(ctx, Z3_func_entry_get_arg(ctx, entry, 0),
+                               &index) &&
+           getByteNumeral(ctx, Z3_func_entry_get_value(ctx, entry), value);
+      entries.push_back(std::make_pair(index, value));
+      Z3_func_entry_dec_ref(ctx, entry);
+    }
+    Z3_func_interp_dec_ref(ctx, f);
+    if (!ok)
+      return false;
+  } else {
+    Z3ASTHandle node = interp;
+    for (;;) {
+      if (Z3_get_ast_kind(ctx, node) != Z3_APP_AST)
+        return false;
+      ::Z3_app app = Z3_to_app(ctx, node);
+      Z3_decl_kind kind = Z3_get_decl_kind(ctx, Z3_get_app_decl(ctx, app));
+      if (kind == Z3_OP_CONST_ARRAY) {
+        if (!getByteNumeral(ctx, Z3_get_app_arg(ctx, app, 0), defaultValue))
+          return false;
+        break;
+      }
+      if (kind != Z3_OP_STORE)
+        return false;
+      unsigned index, value;
+      if (!Z3_get_numeral_uint(ctx, Z3_get_app_arg(ctx, app, 1), &index) ||
+          !getByteNumeral(ctx, Z3_get_app_arg(ctx, app, 2), value))
+        return false;
+      entries.push_back(std::make_pair(index, value));
+      node = Z3ASTHandle(Z3_get_app_arg(ctx, app, 0), ctx);
+    }
+  }
+
+  data.assign(array->size, defaultValue);
+  for (auto it = entries.rbegin(), ie = entries.rend(); it != ie; ++it)
+    if (it->first < array->size)
+      data[it->first] = it->second;
+  return true;
+}
+
 bool Z3SolverImpl::validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel) {
   bool success = true;
   ::Z3_ast_vector constraints =
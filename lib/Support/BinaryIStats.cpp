@@ -0,0 +1,375 @@
+//===-- BinaryIStats.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/BinaryIStats.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace klee;
+using namespace klee::istats;
+
+const char istats::Magic[8] = {'K', 'L', 'E', 'E', 'I', 'S', 'T', '1'};
+
+namespace {
+void appendNumber(std::string &out, uint64_t n) {
+  do {
+    uint8_t byte = n & 0x7f;
+    n >>= 7;
+    out.push_back(byte | (n ? 0x80 : 0));
+  } while (n);
+}
+
+bool readNumber(const uint8_t *&p, const uint8_t *end, uint64_t &n) {
+  n = 0;
+  for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    n |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool readNumber(const uint8_t *&p, const uint8_t *end, unsigned &n) {
+  uint64_t value;
+  if (!readNumber(p, end, value) || value > UINT32_MAX)
+    return false;
+  n = value;
+  return true;
+}
+}
+
+BinaryWriter::BinaryWriter(std::unique_ptr<llvm::raw_fd_ostream> os)
+    : os(std::move(os)) {
+  this->os->write(Magic, sizeof(Magic));
+}
+
+void BinaryWriter::record(RecordKind kind) {
+  std::string length;
+  appendNumber(length, payload.size());
+  *os << (char)kind << length << payload;
+  payload.clear();
+}
+
+unsigned BinaryWriter::string(const std::string &s) {
+  auto it = strings.find(s);
+  if (it != strings.end())
+    return it->second;
+  // Written right away, before the record being built which refers to it.
+  std::string length;
+  appendNumber(length, s.size());
+  *os << (char)StringRecord << length << s;
+  unsigned index = strings.size();
+  strings[s] = index;
+  return index;
+}
+
+void BinaryWriter::number(uint64_t n) { appendNumber(payload, n); }
+
+void BinaryWriter::difference(uint64_t value, uint64_t last) {
+  int64_t d = (int64_t)(value - last);
+  number(((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+}
+
+bool BinaryWriter::changes(uint64_t id, const uint64_t *values, uint64_t *last,
+                           unsigned n) {
+  uint64_t mask = 0;
+  for (unsigned i = 0; i != n; ++i)
+    if (values[i] != last[i])
+      mask |= uint64_t(1) << i;
+  if (!mask)
+    return false;
+  number(id);
+  number(mask);
+  for (unsigned i = 0; i != n; ++i) {
+    if (values[i] != last[i]) {
+      difference(values[i], last[i]);
+      last[i] = values[i];
+    }
+  }
+  ++entries;
+  return true;
+}
+
+void BinaryWriter::writeHeader(
+    uint64_t pid, const std::string &cmd, const std::string &object,
+    const std::vector<std::pair<std::string, std::string> > &events) {
+  unsigned cmdIndex = string(cmd), objectIndex = string(object);
+  std::vector<unsigned> names;
+  for (const auto &e : events) {
+    names.push_back(string(e.first));
+    names.push_back(string(e.second));
+  }
+  number(pid);
+  number(cmdIndex);
+  number(objectIndex);
+  assert(events.size() < 64 && "the changes of a dump are a 64 bit mask");
+  number(events.size());
+  for (unsigned n : names)
+    number(n);
+  record(HeaderRecord);
+  numEvents = events.size();
+}
+
+void BinaryWriter::writeFunction(unsigned id, const std::string &name,
+                                 const std::string &file, unsigned line,
+                                 unsigned assemblyLine) {
+  unsigned nameIndex = string(name), fileIndex = string(file);
+  number(id);
+  number(nameIndex);
+  number(fileIndex);
+  number(line);
+  number(assemblyLine);
+  record(FunctionRecord);
+}
+
+void BinaryWriter::writeInstruction(unsigned id, unsigned function,
+                                    const std::string &file, unsigned line,
+                                    unsigned assemblyLine) {
+  unsigned fileIndex = string(file);
+  number(id);
+  number(function);
+  number(fileIndex);
+  number(line);
+  number(assemblyLine);
+  record(InstructionRecord);
+}
+
+void BinaryWriter::addValues(unsigned id, const uint64_t *values,
+                             uint64_t *last) {
+  assert((!entries || id > lastID) && "values out of order");
+  if (changes(id - lastID, values, last, numEvents))
+    lastID = id;
+}
+
+void BinaryWriter::endValues() {
+  if (entries)
+    record(ValuesRecord);
+  entries = 0;
+  lastID = 0;
+}
+
+void BinaryWriter::addCall(unsigned caller, unsigned callee, uint64_t calls,
+                           const uint64_t *values, uint64_t *last) {
+  assert((!entries || caller >= lastID) && "calls out of order");
+  std::vector<uint64_t> current(1, calls);
+  current.insert(current.end(), values, values + numEvents);
+  // The callee goes before the changes, so build the entry apart.
+  std::string entry;
+  entry.swap(payload);
+  bool changed = changes(callee, current.data(), last, numEvents + 1);
+  entry.swap(payload);
+  if (changed) {
+    number(caller - lastID);
+    payload += entry;
+    lastID = caller;
+  }
+}
+
+void BinaryWriter::endCalls() {
+  if (entries)
+    record(CallsRecord);
+  entries = 0;
+  lastID = 0;
+}
+
+/* *** */
+
+bool BinaryReader::read(const std::string &path, std::string &error) {
+  // Large files are mapped rather than read.
+  auto file = llvm::MemoryBuffer::getFile(path, -1, false);
+  if (!file) {
+    error = file.getError().message();
+    return false;
+  }
+  buffer = std::move(*file);
+  const uint8_t *p = (const uint8_t *)buffer->getBufferStart();
+  const uint8_t *end = (const uint8_t *)buffer->getBufferEnd();
+  if (end - p < (ptrdiff_t)sizeof(Magic) || memcmp(p, Magic, sizeof(Magic))) {
+    error = "not a binary istats file";
+    return false;
+  }
+  p += sizeof(Magic);
+
+  while (p != end) {
+    RecordKind kind = (RecordKind)*p++;
+    uint64_t length;
+    if (!readNumber(p, end, length) || length > (uint64_t)(end - p))
+      break; // cut short
+    if (!parse(kind, p, p + length)) {
+      error = "malformed record";
+      return false;
+    }
+    p += length;
+  }
+  if (events.empty()) {
+    error = "no header";
+    return false;
+  }
+  return true;
+}
+
+bool BinaryReader::parse(RecordKind kind, const uint8_t *p,
+                         const uint8_t *end) {
+  auto str = [&](std::string &s) {
+    unsigned index;
+    if (!readNumber(p, end, index) || index >= strings.size())
+      return false;
+    s = strings[index];
+    return true;
+  };
+  auto changes = [&](std::vector<uint64_t> &values) {
+    uint64_t mask;
+    if (!readNumber(p, end, mask) || mask >> values.size())
+      return false;
+    for (unsigned i = 0; i != values.size(); ++i) {
+      if (mask & (uint64_t(1) << i)) {
+        uint64_t zigzag;
+        if (!readNumber(p, end, zigzag))
+          return false;
+        values[i] += (zigzag >> 1) ^ -(zigzag & 1);
+      }
+    }
+    return true;
+  };
+
+  switch (kind) {
+  case StringRecord:
+    strings.emplace_back((const char *)p, end - p);
+    return true;
+
+  case HeaderRecord: {
+    unsigned n;
+    if (!readNumber(p, end, pid) || !str(cmd) || !str(object) ||
+        !readNumber(p, end, n) || n >= 64)
+      return false;
+    events.resize(n);
+    for (auto &e : events)
+      if (!str(e.first) || !str(e.second))
+        return false;
+    return p == end;
+  }
+
+  case FunctionRecord: {
+    Function f;
+    functions.push_back(f);
+    Function &g = functions.back();
+    return readNumber(p, end, g.id) && str(g.name) && str(g.file) &&
+           readNumber(p, end, g.line) && readNumber(p, end, g.assemblyLine) &&
+           p == end;
+  }
+
+  case InstructionRecord: {
+    instructions.emplace_back();
+    Instruction &i = instructions.back();
+    return readNumber(p, end, i.id) && readNumber(p, end, i.function) &&
+           str(i.file) && readNumber(p, end, i.line) &&
+           readNumber(p, end, i.assemblyLine) && p == end;
+  }
+
+  case ValuesRecord: {
+    unsigned id = 0;
+    while (p != end) {
+      unsigned delta;
+      if (!readNumber(p, end, delta))
+        return false;
+      id += delta;
+      std::vector<uint64_t> &v = values[id];
+      v.resize(events.size());
+      if (!changes(v))
+        return false;
+    }
+    ++dumps;
+    return true;
+  }
+
+  case CallsRecord: {
+    unsigned caller = 0;
+    while (p != end) {
+      unsigned delta, callee;
+      if (!readNumber(p, end, delta) || !readNumber(p, end, callee))
+        return false;
+      caller += delta;
+      Call &c = calls[std::make_pair(caller, callee)];
+      std::vector<uint64_t> v(c.values);
+      v.resize(events.size());
+      v.insert(v.begin(), c.calls);
+      if (!changes(v))
+        return false;
+      c.calls = v[0];
+      c.values.assign(v.begin() + 1, v.end());
+    }
+    return true;
+  }
+  }
+  // Unknown records are skipped, for forward compatibility.
+  return true;
+}
+
+void BinaryReader::writeCallgrind(llvm::raw_ostream &os) const {
+  os << "version: 1\n";
+  os << "creator: klee\n";
+  os << "pid: " << pid << "\n";
+  os << "cmd: " << cmd << "\n\n";
+  os << "\n";
+  os << "positions: instr line\n";
+  for (const auto &e : events)
+    os << "event: " << e.first << " : " << e.second << "\n";
+  os << "events: ";
+  for (const auto &e : events)
+    os << e.first << " ";
+  os << "\n";
+  os << "ob=" << object << "\n";
+
+  std::unordered_map<unsigned, const Function *> functionsByID;
+  std::unordered_map<unsigned, std::vector<const Instruction *> > body;
+  for (const Function &f : functions)
+    functionsByID[f.id] = &f;
+  for (const Instruction &i : instructions)
+    body[i.function].push_back(&i);
+  const std::vector<uint64_t> zero(events.size());
+
+  std::string sourceFile;
+  for (const Function &f : functions) {
+    if (f.file != sourceFile) {
+      os << "fl=" << f.file << "\n";
+      sourceFile = f.file;
+    }
+    os << "fn=" << f.name << "\n";
+    for (const Instruction *i : body[f.id]) {
+      if (i->file != sourceFile) {
+        os << "fl=" << i->file << "\n";
+        sourceFile = i->file;
+      }
+      auto v = values.find(i->id);
+      os << i->assemblyLine << " " << i->line << " ";
+      for (uint64_t value : v == values.end() ? zero : v->second)
+        os << value << " ";
+      os << "\n";
+
+      for (auto it = calls.lower_bound(std::make_pair(i->id, 0u));
+           it != calls.end() && it->first.first == i->id; ++it) {
+        auto callee = functionsByID.find(it->first.second);
+        if (callee == functionsByID.end())
+          continue;
+        const Function &fi = *callee->second;
+        if (fi.file != "" && fi.file != sourceFile)
+          os << "cfl=" << fi.file << "\n";
+        os << "cfn=" << fi.name << "\n";
+        os << "calls=" << it->second.calls << " " << fi.assemblyLine << " "
+           << fi.line << "\n";
+        os << i->assemblyLine << " " << i->line << " ";
+        for (uint64_t value : it->second.values)
+          os << value << " ";
+        os << "\n";
+      }
+    }
+  }
+}
@@ -0,0 +1,187 @@
+//===-- BranchPath.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/BranchPath.h"
+
+#include <cassert>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+
+using namespace klee;
+
+#define BRANCHPATH_MAGIC "KPATH\1"
+#define BRANCHPATH_MAGIC_SIZE 6
+
+BranchPath::BranchPath()
+    : literalSize(0), runValue(false), runSize(0), count(0) {}
+
+void BranchPath::push_back(bool decision) {
+  ++count;
+  if (runSize && decision == runValue) {
+    ++runSize;
+    return;
+  }
+  endRun();
+  runValue = decision;
+  runSize = 1;
+}
+
+void BranchPath::endRun() {
+  if (runSize >= minRun) {
+    endLiteral();
+    appendHeader(data, (runSize << 2) | (runValue << 1));
+  } else {
+    for (std::uint64_t i = 0; i != runSize; ++i)
+      appendLiteral(runValue);
+  }
+  runSize = 0;
+}
+
+void BranchPath::appendLiteral(bool decision) {
+  if (literalSize % 8 == 0)
+    literal.push_back(0);
+  if (decision)
+    literal.back() |= 1 << (literalSize % 8);
+  if (++literalSize == maxLiteral)
+    endLiteral();
+}
+
+void BranchPath::endLiteral() {
+  if (!literalSize)
+    return;
+  appendHeader(data, ((std::uint64_t)literalSize << 1) | 1);
+  data.insert(data.end(), literal.begin(), literal.end());
+  literal.clear();
+  literalSize = 0;
+}
+
+void BranchPath::appendHeader(std::vector<unsigned char> &out,
+                              std::uint64_t header) {
+  do {
+    unsigned char byte = header & 0x7f;
+    header >>= 7;
+    out.push_back(byte | (header ? 0x80 : 0));
+  } while (header);
+}
+
+BranchPath::Cursor::Cursor(const BranchPath &path)
+    : path(&path), position(0), phase(0), consumed(0), isRun(true),
+      value(false), left(0), bits(0), bit(0) {}
+
+void BranchPath::Cursor::load() {
+  const std::vector<unsigned char> &data = path->data;
+  if (phase == 0 && position != data.size()) {
+    std::uint64_t header = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      unsigned char byte = data[position++];
+      header |= (std::uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        break;
+    }
+    isRun = !(header & 1);
+    if (isRun) {
+      value = (header >> 1) & 1;
+      left = header >> 2;
+    } else {
+      left = header >> 1;
+      bits = &data[position];
+      bit = 0;
+      position += (left + 7) / 8;
+    }
+  } else if (phase == 0) {
+    phase = 1;
+    isRun = false;
+    left = path->literalSize;
+    bits = path->literal.data();
+    bit = 0;
+  } else {
+    assert(phase == 1 && "read past the end of a branch path");
+    phase = 2;
+    isRun = true;
+    value = path->runValue;
+    left = path->runSize;
+  }
+}
+
+bool BranchPath::Cursor::next() {
+  assert(!atEnd() && "read past the end of a branch path");
+  while (!left)
+    load();
+  --left;
+  ++consumed;
+  if (isRun)
+    return value;
+  bool decision = (bits[bit / 8] >> (bit % 8)) & 1;
+  ++bit;
+  return decision;
+}
+
+void BranchPath::write(std::ostream &os) const {
+  // the pending decisions as the records they would end up as
+  BranchPath tail;
+  tail.literal = literal;
+  tail.literalSize = literalSize;
+  tail.runValue = runValue;
+  tail.runSize = runSize;
+  tail.endRun();
+  tail.endLiteral();
+
+  unsigned char size[8];
+  for (unsigned i = 0; i != 8; ++i)
+    size[i] = count >> (8 * i);
+  os.write(BRANCHPATH_MAGIC, BRANCHPATH_MAGIC_SIZE);
+  os.write(reinterpret_cast<const char *>(size), 8);
+  os.write(reinterpret_cast<const char *>(data.data()), data.size());
+  os.write(reinterpret_cast<const char *>(tail.data.data()), tail.data.size());
+}
+
+bool BranchPath::read(std::istream &is, BranchPath &path) {
+  char magic[BRANCHPATH_MAGIC_SIZE];
+  unsigned char size[8];
+  if (!is.read(magic, BRANCHPATH_MAGIC_SIZE) ||
+      memcmp(magic, BRANCHPATH_MAGIC, BRANCHPATH_MAGIC_SIZE) ||
+      !is.read(reinterpret_cast<char *>(size), 8))
+    return false;
+
+  BranchPath res;
+  for (unsigned i = 0; i != 8; ++i)
+    res.count |= (std::uint64_t)size[i] << (8 * i);
+  res.data.assign(std::istreambuf_iterator<char>(is),
+                  std::istreambuf_iterator<char>());
+
+  // the records must hold exactly count decisions
+  std::uint64_t decisions = 0;
+  for (size_t pos = 0; pos != res.data.size();) {
+    std::uint64_t header = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      if (pos == res.data.size() || shift > 63)
+        return false;
+      unsigned char byte = res.data[pos++];
+      header |= (std::uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        break;
+    }
+    if (header & 1) {
+      std::uint64_t bytes = ((header >> 1) + 7) / 8;
+      if (res.data.size() - pos < bytes)
+        return false;
+      pos += bytes;
+      decisions += header >> 1;
+    } else {
+      decisions += header >> 2;
+    }
+  }
+  if (decisions != res.count)
+    return false;
+
+  path = res;
+  return true;
+}
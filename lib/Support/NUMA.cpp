@@ -0,0 +1,162 @@
+//===-- NUMA.cpp ----------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/System/NUMA.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+enum class Placement { None, Spread, Pack };
+
+cl::OptionCategory NUMACat("NUMA options",
+                           "These options control where the worker "
+                           "processes run on machines with several NUMA "
+                           "nodes.");
+
+cl::opt<Placement> NUMAPlacement(
+    "numa-placement", cl::init(Placement::None),
+    cl::desc("Bind each solver, seed and kleaver worker to the CPUs and "
+             "memory of one NUMA node (default=none)"),
+    cl::values(clEnumValN(Placement::None, "none", "Leave it to the kernel"),
+               clEnumValN(Placement::Spread, "spread",
+                          "Deal the workers out over the nodes in turn"),
+               clEnumValN(Placement::Pack, "pack",
+                          "Fill the CPUs of each node before the next")),
+    cl::cat(NUMACat));
+
+std::vector<std::vector<unsigned> > readNodes() {
+  std::vector<std::vector<unsigned> > nodes;
+#ifdef __linux__
+  // Node numbers may have gaps; a missing node has no CPUs.
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string list;
+  std::vector<unsigned> ids;
+  if (online && std::getline(online, list) && numa::parseCPUList(list, ids)) {
+    for (unsigned id : ids) {
+      std::ifstream cpulist("/sys/devices/system/node/node" +
+                            std::to_string(id) + "/cpulist");
+      std::vector<unsigned> cpus;
+      if (!cpulist || !std::getline(cpulist, list) ||
+          !numa::parseCPUList(list, cpus))
+        continue;
+      if (nodes.size() <= id)
+        nodes.resize(id + 1);
+      nodes[id] = cpus;
+    }
+  }
+#endif
+  if (nodes.empty())
+    nodes.resize(1);
+  return nodes;
+}
+} // namespace
+
+const std::vector<std::vector<unsigned> > &numa::getNodes() {
+  static const std::vector<std::vector<unsigned> > nodes = readNodes();
+  return nodes;
+}
+
+bool numa::parseCPUList(const std::string &list, std::vector<unsigned> &cpus) {
+  cpus.clear();
+  const char *p = list.c_str();
+  while (*p && *p != '\n') {
+    char *end;
+    errno = 0;
+    unsigned long first = strtoul(p, &end, 10), last = first;
+    if (end == p || errno || first > UINT_MAX)
+      return false;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      last = strtoul(p, &end, 10);
+      if (end == p || errno || last > UINT_MAX || last < first)
+        return false;
+      p = end;
+    }
+    for (unsigned long cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+    if (*p == ',')
+      ++p;
+    else if (*p && *p != '\n')
+      return false;
+  }
+  return true;
+}
+
+int numa::getWorkerNode(unsigned worker) {
+  const std::vector<std::vector<unsigned> > &nodes = getNodes();
+  // The nodes with memory only take no workers.
+  std::vector<unsigned> candidates;
+  unsigned cpus = 0;
+  for (unsigned node = 0; node != nodes.size(); ++node) {
+    if (nodes[node].empty())
+      continue;
+    candidates.push_back(node);
+    cpus += nodes[node].size();
+  }
+  if (NUMAPlacement == Placement::None || candidates.size() < 2)
+    return -1;
+
+  if (NUMAPlacement == Placement::Spread)
+    return candidates[worker % candidates.size()];
+
+  // Beyond one worker per CPU, the nodes are filled again from the first.
+  unsigned slot = worker % cpus;
+  for (unsigned node : candidates) {
+    if (slot < nodes[node].size())
+      return node;
+    slot -= nodes[node].size();
+  }
+  return -1;
+}
+
+void numa::placeWorker(unsigned worker) {
+  int node = getWorkerNode(worker);
+  if (node < 0)
+    return;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned cpu : getNodes()[node])
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set))
+    klee_warning_once(0, "unable to bind a worker to NUMA node %d - %s", node,
+                      sys::StrError(errno).c_str());
+
+  // The pages inherited from the parent stay where they are until the
+  // worker writes them, which copies them to its node; those it only reads
+  // are shared with the parent and would be duplicated by migrating them.
+  const unsigned bits = sizeof(unsigned long) * CHAR_BIT;
+  std::vector<unsigned long> mask(node / bits + 2);
+  mask[node / bits] |= 1UL << (node % bits);
+  if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(),
+              (unsigned long)(mask.size() * bits)))
+    klee_warning_once(0, "unable to prefer the memory of NUMA node %d - %s",
+                      node, sys::StrError(errno).c_str());
+#endif
+}
@@ -0,0 +1,257 @@
+//===-- PTreeLog.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/PTreeLog.h"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace klee;
+using namespace klee::ptreelog;
+
+const char ptreelog::Magic[8] = {'K', 'L', 'E', 'E', 'P', 'T', 'R', '1'};
+
+namespace {
+void appendNumber(std::string &out, uint64_t n) {
+  do {
+    uint8_t byte = n & 0x7f;
+    n >>= 7;
+    out.push_back(byte | (n ? 0x80 : 0));
+  } while (n);
+}
+
+bool readNumber(const uint8_t *&p, const uint8_t *end, uint64_t &n) {
+  n = 0;
+  for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    n |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/// The number of rows of the depth histograms printed.
+const unsigned DepthRows = 32;
+} // namespace
+
+Writer::Writer(std::unique_ptr<llvm::raw_fd_ostream> os) : os(std::move(os)) {
+  this->os->write(Magic, sizeof(Magic));
+}
+
+void Writer::number(uint64_t n) { appendNumber(event, n); }
+
+void Writer::string(const std::string &s) {
+  number(s.size());
+  event += s;
+}
+
+void Writer::leaf(const void *leaf) {
+  auto it = leaves.find(leaf);
+  assert(it != leaves.end() && "unknown leaf");
+  number(next - it->second);
+  leaves.erase(it);
+}
+
+void Writer::write(EventKind kind, uint64_t instructions) {
+  number(instructions - lastInstructions);
+  lastInstructions = instructions;
+  *os << (char)kind << event;
+  event.clear();
+}
+
+void Writer::tree(const void *root, uint64_t instructions) {
+  leaves.clear();
+  leaves[root] = next++;
+  write(TreeEvent, instructions);
+}
+
+void Writer::split(const void *leaf, const void *left, const void *right,
+                   unsigned site, uint64_t instructions) {
+  assert((!site || isDescribed(site)) && "site not described");
+  this->leaf(leaf);
+  number(site);
+  leaves[left] = next++;
+  leaves[right] = next++;
+  write(SplitEvent, instructions);
+}
+
+void Writer::remove(const void *leaf, uint64_t instructions) {
+  this->leaf(leaf);
+  write(RemoveEvent, instructions);
+}
+
+void Writer::describe(unsigned site, const std::string &function,
+                      const std::string &file, unsigned line) {
+  assert(site && "site 0 stands for none");
+  described.insert(site);
+  number(site);
+  string(function);
+  string(file);
+  number(line);
+  *os << (char)SiteEvent << event;
+  event.clear();
+}
+
+/* *** */
+
+bool Reader::read(const std::string &path, std::string &error) {
+  // Large files are mapped rather than read.
+  auto file = llvm::MemoryBuffer::getFile(path, -1, false);
+  if (!file) {
+    error = file.getError().message();
+    return false;
+  }
+  const uint8_t *p = (const uint8_t *)(*file)->getBufferStart();
+  const uint8_t *end = (const uint8_t *)(*file)->getBufferEnd();
+  if (end - p < (ptrdiff_t)sizeof(Magic) || memcmp(p, Magic, sizeof(Magic))) {
+    error = "not a process tree log";
+    return false;
+  }
+  p += sizeof(Magic);
+
+  auto count = [](std::vector<uint64_t> &histogram, unsigned depth) {
+    if (histogram.size() <= depth)
+      histogram.resize(depth + 1);
+    ++histogram[depth];
+  };
+  auto str = [&](std::string &s) {
+    uint64_t length;
+    if (!readNumber(p, end, length) || length > (uint64_t)(end - p))
+      return false;
+    s.assign((const char *)p, length);
+    p += length;
+    return true;
+  };
+
+  // The events are read whole before they are applied, so that one cut
+  // short ends the file.
+  while (p != end) {
+    EventKind kind = (EventKind)*p++;
+    uint64_t distance, site, delta, line;
+    switch (kind) {
+    case TreeEvent:
+      if (!readNumber(p, end, delta))
+        return true;
+      leaves.clear();
+      leaves[next++] = 0;
+      ++trees;
+      break;
+
+    case SplitEvent:
+    case RemoveEvent: {
+      if (!readNumber(p, end, distance) ||
+          (kind == SplitEvent && !readNumber(p, end, site)) ||
+          !readNumber(p, end, delta))
+        return true;
+      auto it = leaves.find(next - distance);
+      if (!distance || it == leaves.end() ||
+          (kind == SplitEvent && site && !sites.count(site))) {
+        error = "malformed event";
+        return false;
+      }
+      unsigned depth = it->second;
+      leaves.erase(it);
+      if (kind == RemoveEvent) {
+        count(removeDepths, depth);
+        ++removes;
+        break;
+      }
+      count(splitDepths, depth);
+      Site &s = sites[site];
+      ++s.splits;
+      s.depths += depth;
+      leaves[next++] = depth + 1;
+      leaves[next++] = depth + 1;
+      ++splits;
+      break;
+    }
+
+    case SiteEvent: {
+      Site s;
+      if (!readNumber(p, end, site) || !str(s.function) || !str(s.file) ||
+          !readNumber(p, end, line))
+        return true;
+      if (!site || sites.count(site)) {
+        error = "malformed event";
+        return false;
+      }
+      s.line = line;
+      sites[site] = s;
+      continue;
+    }
+
+    default:
+      error = "unknown event";
+      return false;
+    }
+    instructions += delta;
+    maxLeaves = std::max(maxLeaves, (uint64_t)leaves.size());
+  }
+  return true;
+}
+
+void Reader::print(llvm::raw_ostream &os, unsigned top) const {
+  os << "trees: " << trees << "\n";
+  os << "splits: " << splits << "\n";
+  os << "removes: " << removes << "\n";
+  os << "leaves: " << getLeaves() << "\n";
+  os << "most leaves: " << maxLeaves << "\n";
+  os << "instructions: " << instructions << "\n";
+
+  // The depths are grouped into ranges of equal width.
+  size_t depths = std::max(splitDepths.size(), removeDepths.size());
+  if (depths) {
+    size_t width = (depths + DepthRows - 1) / DepthRows;
+    os << "\ndepth              splits      removes\n";
+    for (size_t first = 0; first < depths; first += width) {
+      uint64_t s = 0, r = 0;
+      for (size_t d = first; d != std::min(first + width, depths); ++d) {
+        s += d < splitDepths.size() ? splitDepths[d] : 0;
+        r += d < removeDepths.size() ? removeDepths[d] : 0;
+      }
+      std::string range = std::to_string(first);
+      if (width > 1)
+        range += "-" + std::to_string(first + width - 1);
+      os << llvm::format("%-12s %12llu %12llu", range.c_str(),
+                         (unsigned long long)s, (unsigned long long)r)
+         << "\n";
+    }
+  }
+
+  std::vector<std::pair<unsigned, const Site *> > hot;
+  for (const auto &s : sites)
+    if (s.second.splits)
+      hot.emplace_back(s.first, &s.second);
+  std::sort(hot.begin(), hot.end(),
+            [](const std::pair<unsigned, const Site *> &a,
+               const std::pair<unsigned, const Site *> &b) {
+              return a.second->splits != b.second->splits
+                         ? a.second->splits > b.second->splits
+                         : a.first < b.first;
+            });
+  if (hot.size() > top)
+    hot.resize(top);
+  if (hot.empty())
+    return;
+  os << "\n      splits   mean depth  site\n";
+  for (const auto &h : hot) {
+    const Site &s = *h.second;
+    os << llvm::format("%12llu %12.1f  ", (unsigned long long)s.splits,
+                       (double)s.depths / s.splits);
+    if (h.first)
+      os << s.function << " (" << s.file << ":" << s.line << ")\n";
+    else
+      os << "(unknown)\n";
+  }
+}
@@ -10,15 +10,30 @@
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/System/Time.h"
 
+#include "llvm/Support/CommandLine.h"
 
 #include <cstdint>
 #include <regex>
 #include <sstream>
 #include <tuple>
 #include <sys/resource.h>
+#include <time.h>
 
 
 using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::OptionCategory TimeCat("Time measurement options",
+                           "These options control how KLEE reads the clock.");
+
+cl::opt<bool> CoarseStatTime(
+    "coarse-stat-time", cl::init(false),
+    cl::desc("Measure the time statistics (solver, fork, resolve time, ..) "
+             "with a coarse clock, which is much cheaper to read but only "
+             "has a resolution of a few milliseconds (default=false)"),
+    cl::cat(TimeCat));
+} // namespace
 
 
 /* Why std::chrono:
@@ -30,6 +45,9 @@ using namespace klee;
  * - clock_gettime(CLOCK_MONOTONIC): slowest on macOS, C-like API
  * - gettimeofday: C-like API, non-monotonic
  *
+ * CLOCK_MONOTONIC_COARSE is still used by getCoarseTime where the resolution
+ * does not matter, i.e. for timers and optionally for the time statistics.
+ *
  * TODO: add time literals with C++14
  */
 
@@ -183,6 +201,16 @@ std::string time::getClockInfo() {
          << '/'
          << std::chrono::steady_clock::period::den
          << "s resolution\n";
+  if (CoarseStatTime) {
+    buffer << "Using coarse clock for time statistics";
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+    timespec res{};
+    if (!::clock_getres(CLOCK_MONOTONIC_COARSE, &res))
+      buffer << " with " << res.tv_sec * 1000 + res.tv_nsec / 1000000
+             << "ms resolution";
+#endif
+    buffer << '\n';
+  }
   return buffer.str();
 }
 
@@ -207,3 +235,23 @@ time::Point time::getWallTime() {
   return time::Point(std::chrono::steady_clock::now());
 }
 
+
+/// Returns point in time using a monotonic clock of a few milliseconds
+/// resolution, which Linux reads without entering the kernel or the TSC
+time::Point time::getCoarseTime() {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+  // the steady clock counts from the same epoch, CLOCK_MONOTONIC
+  timespec ts{};
+  if (!::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts))
+    return time::Point(Point::SteadyTimePoint(
+        std::chrono::duration_cast<Duration>(std::chrono::seconds(ts.tv_sec) +
+                                             std::chrono::nanoseconds(ts.tv_nsec))));
+#endif
+  return getWallTime();
+}
+
+
+/// Returns point in time for the time statistics
+time::Point time::getStatTime() {
+  return CoarseStatTime ? getCoarseTime() : getWallTime();
+}
@@ -0,0 +1,118 @@
+//===-- Trace.cpp ---------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/Trace.h"
+
+#include "klee/Internal/Support/FileHandling.h"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+struct Event {
+  const char *name;
+  std::uint64_t start, duration;
+};
+
+/// The events kept per thread, the most recent ones.
+const std::uint64_t BufferSize = 1 << 16;
+
+/// Only its thread writes to a buffer, so recording takes no lock.
+struct Buffer {
+  unsigned thread;
+  /// The number of events recorded, of which the last BufferSize are kept.
+  std::atomic<std::uint64_t> head{0};
+  Event events[BufferSize];
+};
+
+std::mutex buffersMutex;
+/// Kept until the process exits, for the threads which ended before the
+/// trace is written.
+std::vector<Buffer *> buffers;
+thread_local Buffer *threadBuffer = nullptr;
+
+std::atomic<bool> writeRequested{false};
+
+Buffer &getBuffer() {
+  if (!threadBuffer) {
+    std::unique_ptr<Buffer> buffer(new Buffer());
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->thread = buffers.size();
+    buffers.push_back(buffer.get());
+    threadBuffer = buffer.release();
+  }
+  return *threadBuffer;
+}
+
+void handleWriteSignal(int) { writeRequested = true; }
+
+/// Formats nanoseconds as microseconds, keeping the fraction.
+llvm::format_object<unsigned long long, unsigned long long>
+microseconds(std::uint64_t ns) {
+  return llvm::format("%llu.%03llu", (unsigned long long)(ns / 1000),
+                      (unsigned long long)(ns % 1000));
+}
+} // namespace
+
+std::uint64_t trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void trace::record(const char *name, std::uint64_t start, std::uint64_t end) {
+  Buffer &buffer = getBuffer();
+  std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.events[head % BufferSize] = {name, start, end - start};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool trace::write(const std::string &path, std::string &error) {
+  std::unique_ptr<llvm::raw_fd_ostream> os = klee_open_output_file(path, error);
+  if (!os)
+    return false;
+
+  // timestamps in microseconds, as the format expects
+  *os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  pid_t pid = getpid();
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const Buffer *buffer : buffers) {
+    std::uint64_t head = buffer->head.load(std::memory_order_acquire);
+    std::uint64_t begin = head > BufferSize ? head - BufferSize : 0;
+    for (std::uint64_t i = begin; i != head; ++i) {
+      const Event &e = buffer->events[i % BufferSize];
+      *os << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name
+          << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":"
+          << buffer->thread << ",\"ts\":" << microseconds(e.start)
+          << ",\"dur\":" << microseconds(e.duration) << '}';
+      first = false;
+    }
+  }
+  *os << "\n]}\n";
+  return true;
+}
+
+void trace::writeOnSignal(int signum) { signal(signum, handleWriteSignal); }
+
+bool trace::takeWriteRequest() {
+  return writeRequested.load(std::memory_order_relaxed) &&
+         writeRequested.exchange(false);
+}
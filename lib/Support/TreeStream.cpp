@@ -10,8 +10,14 @@
 #define DEBUG_TYPE "TreeStreamWriter"
 #include "klee/Internal/ADT/TreeStream.h"
 
+#include "klee/Config/config.h"
 #include "klee/Internal/Support/Debug.h"
 
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <fstream>
@@ -31,7 +37,11 @@ TreeStreamWriter::TreeStreamWriter(const std::string &_path)
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
-    ids(1) {
+    ids(1),
+    streams(1),
+    blockStart(0),
+    fileSize(0),
+    cachedIndex(static_cast<size_t>(-1)) {
   if (!output->good()) {
     delete output;
     output = 0;
@@ -39,7 +49,8 @@ TreeStreamWriter::TreeStreamWriter(const std::string &_path)
 }
 
 TreeStreamWriter::~TreeStreamWriter() {
-  flush();
+  if (output)
+    flush();
   delete output;
 }
 
@@ -55,9 +66,12 @@ TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   assert(output && os.writer==this);
   flushBuffer();
   unsigned id = ids++;
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
   unsigned tag = id | (1<<31);
-  output->write(reinterpret_cast<const char*>(&tag), 4);
+  append(os.id, tag, 0, 0);
+  Stream stream;
+  stream.parent = os.id;
+  stream.forkedAt = streams[os.id].chunks.size();
+  streams.push_back(stream);
   return TreeOStream(*this, id);
 }
 
@@ -73,91 +87,145 @@ void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
     memcpy(buffer, s, size);
     bufferCount = size;
   } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(s, size);
+    append(os.id, size, s, size);
   }
 }
 
 void TreeStreamWriter::flushBuffer() {
   if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
+    append(lastID, bufferCount, buffer, bufferCount);
     bufferCount = 0;
   }
 }
 
+void TreeStreamWriter::append(TreeStreamID id, unsigned tag, const char *s,
+                              unsigned size) {
+  block.append(reinterpret_cast<const char*>(&id), 4);
+  block.append(reinterpret_cast<const char*>(&tag), 4);
+  if (size) {
+    Chunk chunk = {blockStart + block.size(), size};
+    streams[id].chunks.push_back(chunk);
+    block.append(s, size);
+  }
+  if (block.size() >= blockSize)
+    writeBlock();
+}
+
+void TreeStreamWriter::writeBlock() {
+  if (block.empty())
+    return;
+
+  // Each block is its uncompressed and stored sizes followed by its data,
+  // which is the records as they are stored without compression.
+  unsigned rawSize = block.size();
+  const char *data = block.data();
+  unsigned storedSize = rawSize;
+#ifdef HAVE_ZLIB_H
+  std::vector<Bytef> compressed(compressBound(rawSize));
+  uLongf compressedSize = compressed.size();
+  if (compress2(compressed.data(), &compressedSize,
+                reinterpret_cast<const Bytef*>(block.data()), rawSize,
+                Z_BEST_SPEED) == Z_OK && compressedSize < rawSize) {
+    data = reinterpret_cast<const char*>(compressed.data());
+    storedSize = compressedSize;
+  }
+#endif
+  output->write(reinterpret_cast<const char*>(&rawSize), 4);
+  output->write(reinterpret_cast<const char*>(&storedSize), 4);
+  output->write(data, storedSize);
+  // the block is read back from the file
+  output->flush();
+
+  blocks.push_back(std::make_pair(blockStart, fileSize));
+  fileSize += 8 + storedSize;
+  blockStart += rawSize;
+  block.clear();
+}
+
 void TreeStreamWriter::flush() {
   flushBuffer();
+  writeBlock();
   output->flush();
 }
 
+bool TreeStreamWriter::readChunk(const Chunk &chunk,
+                                 std::vector<unsigned char> &out) {
+  if (chunk.offset >= blockStart) {
+    const char *data = &block[chunk.offset - blockStart];
+    out.insert(out.end(), data, data + chunk.size);
+    return true;
+  }
+
+  size_t index =
+      std::upper_bound(blocks.begin(), blocks.end(),
+                       std::make_pair(chunk.offset, UINT64_MAX)) -
+      blocks.begin() - 1;
+  if (index != cachedIndex) {
+    std::ifstream is(path.c_str(), std::ios::in | std::ios::binary);
+    unsigned rawSize, storedSize;
+    is.seekg(blocks[index].second);
+    is.read(reinterpret_cast<char*>(&rawSize), 4);
+    is.read(reinterpret_cast<char*>(&storedSize), 4);
+    std::string stored(storedSize, 0);
+    is.read(&stored[0], storedSize);
+    if (!is.good())
+      return false;
+
+    cachedIndex = static_cast<size_t>(-1);
+    if (storedSize == rawSize) {
+      cachedBlock.swap(stored);
+    } else {
+#ifdef HAVE_ZLIB_H
+      cachedBlock.assign(rawSize, 0);
+      uLongf size = rawSize;
+      if (uncompress(reinterpret_cast<Bytef*>(&cachedBlock[0]), &size,
+                     reinterpret_cast<const Bytef*>(stored.data()),
+                     storedSize) != Z_OK || size != rawSize)
+        return false;
+#else
+      return false;
+#endif
+    }
+    cachedIndex = index;
+  }
+
+  const char *data = &cachedBlock[chunk.offset - blocks[index].first];
+  out.insert(out.end(), data, data + chunk.size);
+  return true;
+}
+
 void TreeStreamWriter::readStream(TreeStreamID streamID,
                                   std::vector<unsigned char> &out) {
   assert(streamID>0 && streamID<ids);
-  flush();
-  
-  std::ifstream is(path.c_str(),
-                   std::ios::in | std::ios::binary);
-  assert(is.good());
+  flushBuffer();
   KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
 
-  std::map<unsigned,unsigned> parents;
-  std::vector<unsigned> roots;
-  for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-
-      if (child==streamID) {
-        roots.push_back(child);
-        while (id) {
-          roots.push_back(id);
-          std::map<unsigned, unsigned>::iterator it = parents.find(id);
-          assert(it!=parents.end());
-          id = it->second;
-        } 
-        break;
-      } else {
-        parents.insert(std::make_pair(child,id));
-      }
-    } else {
-      unsigned size = tag;
-      while (size--) is.get();
-    }
+  // The stream is the chunks its ancestors had when it was forked from
+  // them, followed by its own.
+  std::vector<std::pair<TreeStreamID, size_t> > chain;
+  TreeStreamID id = streamID;
+  size_t limit = streams[id].chunks.size();
+  while (id) {
+    chain.push_back(std::make_pair(id, limit));
+    limit = streams[id].forkedAt;
+    id = streams[id].parent;
   }
   KLEE_DEBUG({
       llvm::errs() << "roots: ";
-      for (size_t i = 0, e = roots.size(); i < e; ++i) {
-        llvm::errs() << roots[i] << " ";
+      for (size_t i = 0, e = chain.size(); i < e; ++i) {
+        llvm::errs() << chain[i].first << " ";
       }
       llvm::errs() << "\n";
     });
-  is.seekg(0, std::ios::beg);
-  for (;;) {
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-      if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
-        roots.pop_back();
-    } else {
-      unsigned size = tag;
-      if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
-      } else {
-        while (size--) is.get();
-      }
+
+  for (auto it = chain.rbegin(), ie = chain.rend(); it != ie; ++it) {
+    const std::vector<Chunk> &chunks = streams[it->first].chunks;
+    for (size_t i = 0; i != it->second; ++i) {
+      bool success = readChunk(chunks[i], out);
+      assert(success && "unable to read back a tree stream");
+      (void) success;
     }
-  }  
+  }
 }
 
 ///
@@ -29,9 +29,18 @@
 #include <sys/mtio.h>
 #include <termios.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <klee/klee.h>
 #include <sys/time.h>
 
+/* Returns symbolic file i, made now if it was left to its first use */
+static exe_disk_file_t *__get_sym_file_at(unsigned i) {
+  exe_disk_file_t *df = &__exe_fs.sym_files[i];
+  if (!df->stat)
+    __fd_init_sym_file(i);
+  return df;
+}
+
 /* Returns pointer to the symbolic file structure fs the pathname is symbolic */
 static exe_disk_file_t *__get_sym_file(const char *pathname) {
   if (!pathname)
@@ -45,7 +54,7 @@ static exe_disk_file_t *__get_sym_file(const char *pathname) {
 
   for (i=0; i<__exe_fs.n_sym_files; ++i) {
     if (c == 'A' + (char) i) {
-      exe_disk_file_t *df = &__exe_fs.sym_files[i];
+      exe_disk_file_t *df = __get_sym_file_at(i);
       if (df->stat->st_ino == 0)
         return NULL;
       return df;
@@ -59,6 +68,13 @@ static void *__concretize_ptr(const void *p);
 static size_t __concretize_size(size_t s);
 static const char *__concretize_string(const char *s);
 
+/* Copies between the program and the symbolic files in bulk when KLEE can,
+   instead of interpreting a byte loop. */
+void __fd_copy(void *dst, const void *src, size_t n) {
+  if (!klee_copy_memory(dst, src, n))
+    memcpy(dst, src, n);
+}
+
 /* Returns pointer to the file entry for a valid fd */
 static exe_file_t *__get_file(int fd) {
   if (fd>=0 && fd<MAX_FDS) {
@@ -350,6 +366,9 @@ ssize_t read(int fd, void *buf, size_t count) {
     errno = EIO;
     return -1;
   }
+
+  if (f->flags & eSocket)
+    return __fd_socket_read(f, buf, count, 0);
   
   if (!f->dfile) {
     /* concrete file */
@@ -382,7 +401,7 @@ ssize_t read(int fd, void *buf, size_t count) {
       count = f->dfile->size - f->off;
     }
     
-    memcpy(buf, f->dfile->contents + f->off, count);
+    __fd_copy(buf, f->dfile->contents + f->off, count);
     f->off += count;
     
     return count;
@@ -409,6 +428,15 @@ ssize_t write(int fd, const void *buf, size_t count) {
     return -1;
   }
 
+  if (f->flags & eSocket) {
+    /* the peers of the model discard what they are sent */
+    if (!f->dfile && !(f->flags & eDatagram)) {
+      errno = ENOTCONN;
+      return -1;
+    }
+    return count;
+  }
+
   if (!f->dfile) {
     int r;
 
@@ -446,7 +474,7 @@ ssize_t write(int fd, const void *buf, size_t count) {
     }
     
     if (actual_count)
-      memcpy(f->dfile->contents + f->off, buf, actual_count);
+      __fd_copy(f->dfile->contents + f->off, buf, actual_count);
     
     if (count != actual_count)
       klee_warning("write() ignores bytes.\n");
@@ -518,7 +546,7 @@ off64_t __fd_lseek(int fd, off64_t offset, int whence) {
 int __fd_stat(const char *path, struct stat64 *buf) {  
   exe_disk_file_t *dfile = __get_sym_file(path);
   if (dfile) {
-    memcpy(buf, dfile->stat, sizeof(*dfile->stat));
+    __fd_copy(buf, dfile->stat, sizeof(*dfile->stat));
     return 0;
   } 
 
@@ -547,7 +575,7 @@ int fstatat(int fd, const char *path, struct stat *buf, int flags) {
   }
   exe_disk_file_t *dfile = __get_sym_file(path);
   if (dfile) {
-    memcpy(buf, dfile->stat, sizeof(*dfile->stat));
+    __fd_copy(buf, dfile->stat, sizeof(*dfile->stat));
     return 0;
   } 
 
@@ -564,7 +592,7 @@ int fstatat(int fd, const char *path, struct stat *buf, int flags) {
 int __fd_lstat(const char *path, struct stat64 *buf) {
   exe_disk_file_t *dfile = __get_sym_file(path);
   if (dfile) {
-    memcpy(buf, dfile->stat, sizeof(*dfile->stat));
+    __fd_copy(buf, dfile->stat, sizeof(*dfile->stat));
     return 0;
   } 
 
@@ -714,6 +742,13 @@ int __fd_fstat(int fd, struct stat64 *buf) {
     return -1;
   }
   
+  if (f->flags & eSocket) {
+    /* also before the socket is connected */
+    exe_disk_file_t *df = f->dfile ? f->dfile : &__exe_fs.sym_sockets[0];
+    __fd_copy(buf, df->stat, sizeof(*df->stat));
+    return 0;
+  }
+
   if (!f->dfile) {
 #if __WORDSIZE == 64
     return syscall(__NR_fstat, f->fd, buf);
@@ -722,7 +757,7 @@ int __fd_fstat(int fd, struct stat64 *buf) {
 #endif
   }
   
-  memcpy(buf, f->dfile->stat, sizeof(*f->dfile->stat));
+  __fd_copy(buf, f->dfile->stat, sizeof(*f->dfile->stat));
   return 0;
 }
 
@@ -780,7 +815,7 @@ int __fd_getdents(unsigned int fd, struct dirent64 *dirp, unsigned int count) {
         return -1;
       } 
       for (; i<__exe_fs.n_sym_files; ++i) {
-        exe_disk_file_t *df = &__exe_fs.sym_files[i];
+        exe_disk_file_t *df = __get_sym_file_at(i);
         dirp->d_ino = df->stat->st_ino;
         dirp->d_reclen = sizeof(*dirp);
         dirp->d_type = IFTODT(df->stat->st_mode);
@@ -1012,7 +1047,7 @@ int fcntl(int fd, int cmd, ...) {
     va_end(ap);
   }
 
-  if (f->dfile) {
+  if (f->dfile || (f->flags & eSocket)) {
     switch(cmd) {
     case F_GETFD: {
       int flags = 0;
@@ -1033,6 +1068,17 @@ int fcntl(int fd, int cmd, ...) {
 	 return them here.  These same flags can be set by F_SETFL,
 	 which we could also handle properly. 
       */
+      return (f->flags & eNonBlocking) ? O_NONBLOCK : 0;
+    }
+    case F_SETFL: {
+      if (!(f->flags & eSocket)) {
+        klee_warning("symbolic file, ignoring (EINVAL)");
+        errno = EINVAL;
+        return -1;
+      }
+      f->flags &= ~eNonBlocking;
+      if (arg & O_NONBLOCK)
+        f->flags |= eNonBlocking;
       return 0;
     }
     default:
@@ -1255,6 +1301,17 @@ int select(int nfds, fd_set *read, fd_set *write,
       if (!f) {
         errno = EBADF;
         return -1;
+      } else if (f->flags & eSocket) {
+        int ready = __fd_socket_poll(f, POLLIN | POLLOUT), set = 0;
+        if (FD_ISSET(i, &in_read) && (ready & (POLLIN | POLLHUP))) {
+          FD_SET(i, read);
+          set = 1;
+        }
+        if (FD_ISSET(i, &in_write) && (ready & POLLOUT)) {
+          FD_SET(i, write);
+          set = 1;
+        }
+        count += set;
       } else if (f->dfile) {
         /* Operations on this fd will never block... */
         if (FD_ISSET(i, &in_read)) FD_SET(i, read);
@@ -1288,7 +1345,7 @@ int select(int nfds, fd_set *read, fd_set *write,
       /* Translate resulting sets back */
       for (i=0; i<nfds; i++) {
         exe_file_t *f = __get_file(i);
-        if (f && !f->dfile) {
+        if (f && !f->dfile && !(f->flags & eSocket)) {
           if (read && FD_ISSET(f->fd, &os_read)) FD_SET(i, read);
           if (write && FD_ISSET(f->fd, &os_write)) FD_SET(i, write);
           if (except && FD_ISSET(f->fd, &os_except)) FD_SET(i, except);
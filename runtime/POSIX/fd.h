@@ -47,7 +47,11 @@ typedef enum {
   eOpen         = (1 << 0),
   eCloseOnExec  = (1 << 1),
   eReadable     = (1 << 2),
-  eWriteable    = (1 << 3)
+  eWriteable    = (1 << 3),
+  eSocket       = (1 << 4), /* a socket of the model, see socket.c */
+  eListening    = (1 << 5),
+  eDatagram     = (1 << 6),
+  eNonBlocking  = (1 << 7)
 } exe_file_flag_t;
 
 typedef struct {      
@@ -71,6 +75,12 @@ typedef struct {
   /* Which read, write etc. call should fail */
   int *read_fail, *write_fail, *close_fail, *ftruncate_fail, *getcwd_fail;
   int *chmod_fail, *fchmod_fail;
+
+  /* incoming data of the connections and datagrams of the sockets, taken
+     in order as they are accepted, connected or received */
+  unsigned n_sym_sockets;
+  exe_disk_file_t *sym_sockets;
+  unsigned next_sym_socket;
 } exe_file_system_t;
 
 #define MAX_FDS 32
@@ -93,7 +103,10 @@ extern exe_sym_env_t __exe_env;
 
 void klee_init_fds(unsigned n_files, unsigned file_length,
                    unsigned stdin_length, int sym_stdout_flag,
-                   int do_all_writes_flag, unsigned max_failures);
+                   int do_all_writes_flag, unsigned max_failures,
+                   unsigned n_sockets, unsigned socket_length,
+                   int lazy_files_flag);
+void __fd_init_sym_file(unsigned k);
 void klee_init_env(int *argcPtr, char ***argvPtr);
 
 /* *** */
@@ -107,5 +120,9 @@ int __fd_fstat(int fd, struct stat64 *buf);
 int __fd_ftruncate(int fd, off64_t length);
 int __fd_statfs(const char *path, struct statfs *buf);
 int __fd_getdents(unsigned int fd, struct dirent64 *dirp, unsigned int count);
+void __fd_copy(void *dst, const void *src, size_t n);
+
+ssize_t __fd_socket_read(exe_file_t *f, void *buf, size_t count, int flags);
+int __fd_socket_poll(exe_file_t *f, short events);
 
 #endif /* __EXE_FD__ */
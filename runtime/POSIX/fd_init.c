@@ -94,6 +94,20 @@ static void __create_new_dfile(exe_disk_file_t *dfile, unsigned size,
   dfile->stat = s;
 }
 
+/* Makes the contents and the stat of symbolic file k, which are left out
+   by klee_init_fds with lazy_files_flag until the file is first looked up.
+   The paths which never use a file then have no objects for it: they are
+   not in their queries nor in their tests. */
+void __fd_init_sym_file(unsigned k) {
+  char name[7] = "?-data";
+  struct stat64 s;
+
+  stat64(".", &s);
+  name[0] = 'A' + k;
+  __create_new_dfile(&__exe_fs.sym_files[k], __exe_fs.sym_files[k].size, name,
+                     &s);
+}
+
 static unsigned __sym_uint32(const char *name) {
   unsigned x;
   klee_make_symbolic(&x, sizeof x, name);
@@ -106,12 +120,19 @@ static unsigned __sym_uint32(const char *name) {
    save_all_writes_flag: 1 if all writes are executed as expected, 0 if 
                          writes past the initial file size are discarded 
 			 (file offset is always incremented)
-   max_failures: maximum number of system call failures */
+   max_failures: maximum number of system call failures
+   n_sockets: number of connections and datagrams the sockets receive
+   socket_length: size in bytes of the data of each of them
+   lazy_files_flag: 1 if the symbolic files are only made on their first
+                    use, see __fd_init_sym_file */
 void klee_init_fds(unsigned n_files, unsigned file_length,
                    unsigned stdin_length, int sym_stdout_flag,
-                   int save_all_writes_flag, unsigned max_failures) {
+                   int save_all_writes_flag, unsigned max_failures,
+                   unsigned n_sockets, unsigned socket_length,
+                   int lazy_files_flag) {
   unsigned k;
   char name[7] = "?-data";
+  char socket_name[13] = "socket?-data";
   struct stat64 s;
 
   stat64(".", &s);
@@ -119,6 +140,12 @@ void klee_init_fds(unsigned n_files, unsigned file_length,
   __exe_fs.n_sym_files = n_files;
   __exe_fs.sym_files = malloc(sizeof(*__exe_fs.sym_files) * n_files);
   for (k=0; k < n_files; k++) {
+    if (lazy_files_flag) {
+      __exe_fs.sym_files[k].size = file_length;
+      __exe_fs.sym_files[k].contents = NULL;
+      __exe_fs.sym_files[k].stat = NULL;
+      continue;
+    }
     name[0] = 'A' + k;
     __create_new_dfile(&__exe_fs.sym_files[k], file_length, name, &s);
   }
@@ -154,6 +181,17 @@ void klee_init_fds(unsigned n_files, unsigned file_length,
     __exe_fs.stdout_writes = 0;
   }
   else __exe_fs.sym_stdout = NULL;
+
+  /* setting symbolic sockets */
+  __exe_fs.n_sym_sockets = n_sockets;
+  __exe_fs.next_sym_socket = 0;
+  __exe_fs.sym_sockets = malloc(sizeof(*__exe_fs.sym_sockets) * n_sockets);
+  for (k=0; k < n_sockets; k++) {
+    socket_name[6] = 'A' + k;
+    __create_new_dfile(&__exe_fs.sym_sockets[k], socket_length, socket_name,
+                       &s);
+    __exe_fs.sym_sockets[k].stat->st_mode = S_IFSOCK | 0777;
+  }
   
   __exe_env.save_all_writes = save_all_writes_flag;
   __exe_env.version = __sym_uint32("model_version");
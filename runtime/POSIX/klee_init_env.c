@@ -90,7 +90,9 @@ void klee_init_env(int *argcPtr, char ***argvPtr) {
   char *new_argv[1024];
   unsigned max_len, min_argvs, max_argvs;
   unsigned sym_files = 0, sym_file_len = 0;
+  int lazy_files_flag = 0;
   unsigned sym_stdin_len = 0;
+  unsigned sym_sockets = 0, sym_socket_len = 0;
   int sym_stdout_flag = 0;
   int save_all_writes_flag = 0;
   int fd_fail = 0;
@@ -110,8 +112,11 @@ usage: (klee_init_env) [options] [program arguments]\n\
                               MAX arguments, each with maximum length N\n\
   -sym-files <NUM> <N>      - Make NUM symbolic files ('A', 'B', 'C', etc.),\n\
                               each with size N\n\
+  -lazy-sym-files           - Make the symbolic files on their first use\n\
   -sym-stdin <N>            - Make stdin symbolic with size N.\n\
   -sym-stdout               - Make stdout symbolic.\n\
+  -sym-sockets <NUM> <N>    - Sockets receive NUM symbolic connections or\n\
+                              datagrams, each with N bytes of data\n\
   -save-all-writes          - Allow write operations to execute as expected\n\
                               even if they exceed the file size. If set to 0, all\n\
                               writes exceeding the initial file size are discarded.\n\
@@ -188,6 +193,10 @@ usage: (klee_init_env) [options] [program arguments]\n\
         __emit_error("The second argument to --sym-files (file size) "
                      "cannot be 0\n");
 
+    } else if (__streq(argv[k], "--lazy-sym-files") ||
+               __streq(argv[k], "-lazy-sym-files")) {
+      lazy_files_flag = 1;
+      k++;
     } else if (__streq(argv[k], "--sym-stdin") ||
                __streq(argv[k], "-sym-stdin")) {
       const char *msg =
@@ -197,6 +206,29 @@ usage: (klee_init_env) [options] [program arguments]\n\
         __emit_error(msg);
 
       sym_stdin_len = __str_to_int(argv[k++], msg);
+    } else if (__streq(argv[k], "--sym-sockets") ||
+               __streq(argv[k], "-sym-sockets")) {
+      const char *msg = "--sym-sockets expects two integer arguments "
+                        "<no-sym-sockets> <sym-socket-len>";
+
+      if (k + 2 >= argc)
+        __emit_error(msg);
+
+      if (sym_sockets != 0)
+        __emit_error("Multiple --sym-sockets are not allowed.\n");
+
+      k++;
+      sym_sockets = __str_to_int(argv[k++], msg);
+      sym_socket_len = __str_to_int(argv[k++], msg);
+
+      if (sym_sockets == 0)
+        __emit_error("The first argument to --sym-sockets (number of "
+                     "connections) cannot be 0\n");
+
+      if (sym_socket_len == 0)
+        __emit_error("The second argument to --sym-sockets (data size) "
+                     "cannot be 0\n");
+
     } else if (__streq(argv[k], "--sym-stdout") ||
                __streq(argv[k], "-sym-stdout")) {
       sym_stdout_flag = 1;
@@ -230,7 +262,8 @@ usage: (klee_init_env) [options] [program arguments]\n\
   *argvPtr = final_argv;
 
   klee_init_fds(sym_files, sym_file_len, sym_stdin_len, sym_stdout_flag,
-                save_all_writes_flag, fd_fail);
+                save_all_writes_flag, fd_fail, sym_sockets, sym_socket_len,
+                lazy_files_flag);
 }
 
 /* The following function represents the main function of the user application
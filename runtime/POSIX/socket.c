@@ -0,0 +1,363 @@
+//===-- socket.c ----------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+/* A model of the sockets of a program which talks to symbolic peers.
+
+   The data the sockets receive comes from the symbolic streams of
+   --sym-sockets, in order: each connection accepted or made by a stream
+   socket, and each datagram received, takes the next stream. Receiving
+   copies the stream in bulk, and the streams are objects like any other, so
+   the states forked while serving a connection share its data until they
+   change it. What the program sends is discarded.
+
+   Waiting for a connection or a datagram which never comes ends the path,
+   as the program would block forever. */
+
+#define _LARGEFILE64_SOURCE
+#include "fd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <klee/klee.h>
+
+/* Returns the file entry of a socket of the model */
+static exe_file_t *__get_socket(int fd) {
+  exe_file_t *f;
+
+  if (fd < 0 || fd >= MAX_FDS || !(__exe_env.fds[fd].flags & eOpen)) {
+    errno = EBADF;
+    return 0;
+  }
+
+  f = &__exe_env.fds[fd];
+  if (!(f->flags & eSocket)) {
+    errno = ENOTSOCK;
+    return 0;
+  }
+  return f;
+}
+
+static int __sockets_left(void) {
+  return __exe_fs.next_sym_socket < __exe_fs.n_sym_sockets;
+}
+
+static exe_disk_file_t *__next_stream(void) {
+  if (!__sockets_left())
+    return NULL;
+  return &__exe_fs.sym_sockets[__exe_fs.next_sym_socket++];
+}
+
+/* Nothing will ever arrive: fail a non-blocking call, else end the path. */
+static int __would_block(exe_file_t *f, int flags) {
+  if ((f->flags & eNonBlocking) || (flags & MSG_DONTWAIT)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  klee_warning("blocking forever on a socket, ending the path");
+  _exit(0);
+}
+
+/* The peers have no address in the model. */
+static void __peer_address(struct sockaddr *addr, socklen_t *addrlen) {
+  if (addr && addrlen)
+    memset(addr, 0, *addrlen);
+}
+
+int socket(int domain, int type, int protocol) {
+  int fd, kind = type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
+  exe_file_t *f;
+
+  if (!__exe_fs.n_sym_sockets) {
+    klee_warning("ignoring (EAFNOSUPPORT), see --sym-sockets");
+    errno = EAFNOSUPPORT;
+    return -1;
+  }
+
+  if (kind != SOCK_STREAM && kind != SOCK_DGRAM) {
+    errno = EPROTONOSUPPORT;
+    return -1;
+  }
+
+  for (fd = 0; fd < MAX_FDS; ++fd)
+    if (!(__exe_env.fds[fd].flags & eOpen))
+      break;
+  if (fd == MAX_FDS) {
+    errno = EMFILE;
+    return -1;
+  }
+
+  f = &__exe_env.fds[fd];
+  memset(f, 0, sizeof *f);
+  f->fd = -1;
+  f->flags = eOpen | eReadable | eWriteable | eSocket;
+  if (kind == SOCK_DGRAM)
+    f->flags |= eDatagram;
+  if (type & SOCK_NONBLOCK)
+    f->flags |= eNonBlocking;
+  if (type & SOCK_CLOEXEC)
+    f->flags |= eCloseOnExec;
+  return fd;
+}
+
+int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
+  return __get_socket(sockfd) ? 0 : -1;
+}
+
+int listen(int sockfd, int backlog) {
+  exe_file_t *f = __get_socket(sockfd);
+
+  if (!f)
+    return -1;
+  if (f->flags & eDatagram) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  f->flags |= eListening;
+  return 0;
+}
+
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+            int flags) {
+  exe_file_t *f = __get_socket(sockfd), *c;
+  exe_disk_file_t *stream;
+  int fd;
+
+  if (!f)
+    return -1;
+  if (!(f->flags & eListening)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (!__sockets_left())
+    return __would_block(f, 0);
+
+  fd = socket(AF_INET, SOCK_STREAM | flags, 0);
+  if (fd == -1)
+    return -1;
+  stream = __next_stream();
+  c = &__exe_env.fds[fd];
+  c->dfile = stream;
+  __peer_address(addr, addrlen);
+  return fd;
+}
+
+int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
+  return accept4(sockfd, addr, addrlen, 0);
+}
+
+int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
+  exe_file_t *f = __get_socket(sockfd);
+
+  if (!f)
+    return -1;
+  /* a datagram socket only gets a default peer */
+  if (f->flags & eDatagram)
+    return 0;
+  if (f->dfile || (f->flags & eListening)) {
+    errno = EISCONN;
+    return -1;
+  }
+  if (!__sockets_left()) {
+    errno = ECONNREFUSED;
+    return -1;
+  }
+  f->dfile = __next_stream();
+  f->off = 0;
+  return 0;
+}
+
+ssize_t __fd_socket_read(exe_file_t *f, void *buf, size_t count, int flags) {
+  size_t size;
+
+  if (f->flags & eDatagram) {
+    if (!f->dfile || f->off >= (off64_t)f->dfile->size) {
+      if (!__sockets_left())
+        return __would_block(f, flags);
+      f->dfile = __next_stream();
+      f->off = 0;
+    }
+    /* one datagram per call, the rest of it is lost */
+    size = f->dfile->size;
+    if (count > size)
+      count = size;
+    __fd_copy(buf, f->dfile->contents, count);
+    if (!(flags & MSG_PEEK))
+      f->off = size;
+    return count;
+  }
+
+  if (!f->dfile) {
+    errno = ENOTCONN;
+    return -1;
+  }
+
+  /* the peer closes the connection after its data */
+  size = f->dfile->size;
+  if (f->off >= (off64_t)size)
+    return 0;
+  if (f->off + count > size)
+    count = size - f->off;
+  __fd_copy(buf, f->dfile->contents + f->off, count);
+  if (!(flags & MSG_PEEK))
+    f->off += count;
+  return count;
+}
+
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
+                 struct sockaddr *src_addr, socklen_t *addrlen) {
+  exe_file_t *f = __get_socket(sockfd);
+  ssize_t r;
+
+  if (!f)
+    return -1;
+  if (len == 0)
+    return 0;
+  if (buf == NULL) {
+    errno = EFAULT;
+    return -1;
+  }
+
+  r = __fd_socket_read(f, buf, len, flags);
+  if (r != -1)
+    __peer_address(src_addr, addrlen);
+  return r;
+}
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
+  return recvfrom(sockfd, buf, len, flags, NULL, NULL);
+}
+
+ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
+               const struct sockaddr *dest_addr, socklen_t addrlen) {
+  exe_file_t *f = __get_socket(sockfd);
+
+  if (!f)
+    return -1;
+  if (!f->dfile && !(f->flags & eDatagram)) {
+    errno = ENOTCONN;
+    return -1;
+  }
+  return len;
+}
+
+ssize_t send(int sockfd, const void *buf, size_t len, int flags) {
+  return sendto(sockfd, buf, len, flags, NULL, 0);
+}
+
+int shutdown(int sockfd, int how) {
+  exe_file_t *f = __get_socket(sockfd);
+
+  if (!f)
+    return -1;
+  if (!f->dfile || (f->flags & eDatagram)) {
+    errno = ENOTCONN;
+    return -1;
+  }
+  /* nothing more is received */
+  if (how == SHUT_RD || how == SHUT_RDWR)
+    f->off = f->dfile->size;
+  return 0;
+}
+
+int setsockopt(int sockfd, int level, int optname, const void *optval,
+               socklen_t optlen) {
+  return __get_socket(sockfd) ? 0 : -1;
+}
+
+int getsockopt(int sockfd, int level, int optname, void *optval,
+               socklen_t *optlen) {
+  if (!__get_socket(sockfd))
+    return -1;
+  /* every option is off, and there is no pending error */
+  if (optval && optlen)
+    memset(optval, 0, *optlen);
+  return 0;
+}
+
+int getsockname(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
+  if (!__get_socket(sockfd))
+    return -1;
+  __peer_address(addr, addrlen);
+  return 0;
+}
+
+int getpeername(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
+  exe_file_t *f = __get_socket(sockfd);
+
+  if (!f)
+    return -1;
+  if (!f->dfile || (f->flags & eDatagram)) {
+    errno = ENOTCONN;
+    return -1;
+  }
+  __peer_address(addr, addrlen);
+  return 0;
+}
+
+/* Returns which of the events are ready on a socket, with POLLHUP */
+int __fd_socket_poll(exe_file_t *f, short events) {
+  int ready = POLLOUT;
+
+  if (f->flags & eListening)
+    ready = __sockets_left() ? POLLIN : 0;
+  else if (f->flags & eDatagram) {
+    if ((f->dfile && f->off < (off64_t)f->dfile->size) || __sockets_left())
+      ready |= POLLIN;
+  } else if (f->dfile)
+    /* data, or the end of the connection */
+    ready |= POLLIN;
+  else
+    ready = POLLHUP;
+
+  return (ready & events) | (ready & POLLHUP);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+  nfds_t i;
+  int count = 0;
+
+  for (i = 0; i < nfds; ++i) {
+    int fd = fds[i].fd;
+    exe_file_t *f;
+
+    fds[i].revents = 0;
+    if (fd < 0)
+      continue;
+
+    if (fd >= MAX_FDS || !(__exe_env.fds[fd].flags & eOpen)) {
+      fds[i].revents = POLLNVAL;
+    } else if ((f = &__exe_env.fds[fd])->flags & eSocket) {
+      fds[i].revents = __fd_socket_poll(f, fds[i].events);
+    } else if (f->dfile) {
+      /* Operations on this fd will never block... */
+      fds[i].revents = fds[i].events & (POLLIN | POLLOUT);
+    } else {
+      /* Never allow blocking poll, like select. */
+      struct pollfd os_fd = { f->fd, fds[i].events, 0 };
+      if (syscall(__NR_poll, &os_fd, 1, 0) == 1)
+        fds[i].revents = os_fd.revents;
+    }
+
+    if (fds[i].revents)
+      ++count;
+  }
+
+  if (!count && timeout < 0) {
+    klee_warning("blocking forever in poll, ending the path");
+    _exit(0);
+  }
+  return count;
+}
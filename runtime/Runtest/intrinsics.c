@@ -10,13 +10,16 @@
 /* Straight C for linking simplicity */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "klee/klee.h"
 
@@ -49,6 +52,68 @@ static void report_internal_error(const char *msg, ...) {
   }
 }
 
+/* Replays each test case of a .ktests container in a process forked here,
+   at the first klee_make_symbolic call, so that the program starts up only
+   once for all of them. Returns in each of those processes with testData
+   set, the parent exits once they all finished. */
+static void replay_container(const char *path) {
+  KTestReader *reader = kTestReader_open(path);
+  const char *timeout = getenv("KLEE_REPLAY_TIMEOUT");
+  unsigned i, n;
+  int failed = 0;
+
+  if (!reader) {
+    fprintf(stderr, "KLEE-RUNTIME: unable to open .ktests container\n");
+    exit(1);
+  }
+
+  for (i = 0, n = kTestReader_numTests(reader); i != n; ++i) {
+    unsigned id = kTestReader_getId(reader, i);
+    pid_t pid;
+    int status;
+
+    testData = kTestReader_get(reader, i);
+    if (!testData) {
+      fprintf(stderr, "KLEE-RUNTIME: unable to read test case %s:%u\n", path,
+              id);
+      failed = 1;
+      continue;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(1);
+    }
+    if (pid == 0) {
+      if (timeout)
+        alarm(atoi(timeout));
+      return;
+    }
+
+    while (waitpid(pid, &status, 0) < 0) {
+      if (errno != EINTR) {
+        perror("waitpid");
+        exit(1);
+      }
+    }
+    if (WIFSIGNALED(status))
+      fprintf(stderr, "KLEE-RUNTIME: test case %s:%u: killed by signal %d\n",
+              path, id, WTERMSIG(status));
+    else
+      fprintf(stderr, "KLEE-RUNTIME: test case %s:%u: exit status %d\n", path,
+              id, WEXITSTATUS(status));
+  }
+
+  /* without the exit handlers of the program, which ran in each test case */
+  kTestReader_close(reader);
+  fflush(stdout);
+  fflush(stderr);
+  _exit(failed);
+}
+
 void klee_make_symbolic(void *array, size_t nbytes, const char *name) {
 
   if (!name)
@@ -95,7 +160,10 @@ void klee_make_symbolic(void *array, size_t nbytes, const char *name) {
       }
       tmp[strlen(tmp)-1] = '\0'; /* kill newline */
     }
-    testData = kTest_fromFile(name);
+    if (kTest_isKTestContainer(name))
+      replay_container(name);
+    else
+      testData = kTest_fromFile(name);
     if (!testData) {
       fprintf(stderr, "KLEE-RUNTIME: unable to open .ktest file\n");
       exit(1);
@@ -178,6 +246,11 @@ int klee_range(int begin, int end, const char* name) {
 
 void klee_prefer_cex(void *object, uintptr_t condition) { }
 
+int klee_copy_memory(void *dst, const void *src, size_t n) {
+  memmove(dst, src, n);
+  return 1;
+}
+
 void klee_abort() {
   abort();
 }
@@ -0,0 +1,42 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --write-kqueries --output-dir=%t.klee-out --optimize-array=value %t.bc > %t.log 2>&1
+// RUN: FileCheck %s -input-file=%t.log -check-prefix=CHECK-OPT_V
+// RUN: FileCheck %s -input-file=%t.log
+// RUN: test -f %t.klee-out/test000001.kquery
+// RUN: test -f %t.klee-out/test000002.kquery
+// RUN: not FileCheck %s -input-file=%t.klee-out/test000001.kquery -check-prefix=CHECK-CONST_ARR
+// RUN: not FileCheck %s -input-file=%t.klee-out/test000002.kquery -check-prefix=CHECK-CONST_ARR
+
+// Tables whose values are all different but affine in the index, or which
+// repeat with a power of two period, are read as arithmetic on the index.
+
+// CHECK-OPT_V: KLEE: WARNING: OPT_V: successful
+// CHECK-CONST_ARR: const_arr
+
+#include <stdio.h>
+#include "klee/klee.h"
+
+unsigned char stepped[16] = {1,  4,  7,  10, 13, 16, 19, 22,
+                              25, 28, 31, 34, 37, 40, 43, 46};
+unsigned char lanes[16] = {0, 8, 16, 24, 0, 8, 16, 24,
+                           0, 8, 16, 24, 0, 8, 16, 24};
+
+int main() {
+  unsigned a, b;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_assume(a < 16);
+  klee_assume(b < 16);
+
+  // CHECK-DAG: Match
+  // CHECK-DAG: No match
+  if (stepped[a] + lanes[b] == 70)
+    printf("Match\n");
+  else
+    printf("No match\n");
+
+  // CHECK: KLEE: done: completed paths = 2
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --write-kqueries --output-dir=%t.klee-out --optimize-array=value %t.bc > %t.log 2>&1
+// RUN: FileCheck %s -input-file=%t.log -check-prefix=CHECK-OPT_V
+// RUN: FileCheck %s -input-file=%t.log
+// RUN: test -f %t.klee-out/test000001.kquery
+// RUN: test -f %t.klee-out/test000002.kquery
+// RUN: not FileCheck %s -input-file=%t.klee-out/test000001.kquery -check-prefix=CHECK-CONST_ARR
+// RUN: not FileCheck %s -input-file=%t.klee-out/test000002.kquery -check-prefix=CHECK-CONST_ARR
+
+// A table read at several symbolic indices is analysed once and each read
+// still becomes a select over the ranges of its values.
+
+// CHECK-OPT_V: KLEE: WARNING: OPT_V: successful
+// CHECK-CONST_ARR: const_arr
+
+#include <stdio.h>
+#include "klee/klee.h"
+
+unsigned char classes[16] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+
+int main() {
+  unsigned a, b, c;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_make_symbolic(&c, sizeof(c), "c");
+  klee_assume(a < 16);
+  klee_assume(b < 16);
+  klee_assume(c < 16);
+
+  // CHECK-DAG: Highest
+  // CHECK-DAG: Lower
+  if (classes[a] + classes[b] + classes[c] == 9)
+    printf("Highest\n");
+  else
+    printf("Lower\n");
+
+  // CHECK: KLEE: done: completed paths = 2
+
+  return 0;
+}
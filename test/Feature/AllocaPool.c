@@ -0,0 +1,36 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --alloca-pool-size=4 %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --alloca-pool-size=0 %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+// The locals of the frames alive at once never share an object, even as
+// the objects of returned frames are reused.
+int depth(int n, int *outer) {
+  int local = n;
+  if (outer)
+    assert(&local != outer && *outer == n + 1);
+  if (n == 0)
+    return 0;
+  return depth(n - 1, &local) + local;
+}
+
+int main() {
+  int n;
+  klee_make_symbolic(&n, sizeof n, "n");
+  klee_assume(n >= 0 & n < 3);
+
+  for (int i = 0; i < 100; ++i)
+    assert(depth(4, 0) == 10);
+  if (n == 1)
+    return 1;
+  // the objects reused in one state are not those of another
+  assert(depth(n, 0) == n * (n + 1) / 2);
+  return 0;
+}
+
+// CHECK: KLEE: done: completed paths = 3
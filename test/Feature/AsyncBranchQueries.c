@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --async-branch-queries=4 %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.det1.klee-out %t.det2.klee-out
+// RUN: %klee --output-dir=%t.det1.klee-out --async-branch-queries=4 --deterministic-async-queries --search=random-state %t1.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.det2.klee-out --async-branch-queries=4 --deterministic-async-queries --search=random-state %t1.bc 2>&1 | FileCheck %s
+// RUN: %ktest-tool %t.det1.klee-out/test*.ktest | grep -v "^ktest file" > %t.det1.txt
+// RUN: %ktest-tool %t.det2.klee-out/test*.ktest | grep -v "^ktest file" > %t.det2.txt
+// RUN: diff %t.det1.txt %t.det2.txt
+// A deferred branch is counted once, as when it is not deferred.
+// RUN: rm -rf %t.sync.klee-out %t.async.klee-out
+// RUN: %klee --output-dir=%t.sync.klee-out %t1.bc 2>&1 | grep "total instructions" > %t.sync.txt
+// RUN: %klee --output-dir=%t.async.klee-out --async-branch-queries=4 --deterministic-async-queries %t1.bc 2>&1 | grep "total instructions" > %t.async.txt
+// RUN: diff %t.sync.txt %t.async.txt
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  unsigned char x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  int paths = 0;
+  if (x > 10)
+    paths |= 1;
+  if (y < 5)
+    paths |= 2;
+  // not feasible together with x <= 10 && y < 5
+  if (x + y == 42)
+    paths |= 4;
+  // infeasible in every path that took the first two branches
+  if ((paths & 3) == 3 && x + y < 11)
+    assert(0 && "infeasible");
+
+  return paths;
+}
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 7
@@ -0,0 +1,38 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --istats-format=binary --istats-write-after-instructions=10 %t1.bc 2>&1 | FileCheck %s
+// RUN: not test -f %t.klee-out/run.istats
+// RUN: %klee-istats %t.klee-out/run.istats.bin -o %t.istats
+// RUN: FileCheck --check-prefix=CHECK-ISTATS --input-file=%t.istats %s
+// RUN: not %klee-istats %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-ERROR %s
+
+#include "klee/klee.h"
+
+int count(int n) {
+  int c = 0;
+  for (int i = 0; i < n; ++i)
+    c += i & 1;
+  return c;
+}
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 3)
+    return count(10);
+  return count(20);
+}
+// CHECK: KLEE: done: completed paths = 2
+
+// CHECK-ISTATS: version: 1
+// CHECK-ISTATS: positions: instr line
+// CHECK-ISTATS: event: I : Instructions
+// CHECK-ISTATS: fl={{.*}}BinaryIStats.c
+// CHECK-ISTATS: fn=count
+// CHECK-ISTATS: fn=main
+// CHECK-ISTATS: cfn=count
+// CHECK-ISTATS-NEXT: calls=1 {{[0-9]+}} 11
+// CHECK-ISTATS: cfn=count
+// CHECK-ISTATS-NEXT: calls=1 {{[0-9]+}} 11
+
+// CHECK-ERROR: not a binary istats file
@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-cex-cache=false --use-query-log=all:kquery,all:bin %t1.bc 2>&1 | FileCheck %s
+// RUN: %kleaver --print-query-log %t.klee-out/all-queries.kqlog > %t.kquery
+// RUN: grep -v Elapsed %t.klee-out/all-queries.kquery > %t.text
+// RUN: grep -v Elapsed %t.kquery > %t.binary
+// RUN: diff %t.text %t.binary
+// RUN: %kleaver -print-ast %t.kquery > /dev/null
+// RUN: %kleaver -evaluate %t.klee-out/all-queries.kquery > %t.text-results
+// RUN: %kleaver -evaluate %t.klee-out/all-queries.kqlog > %t.binary-results
+// RUN: diff %t.text-results %t.binary-results
+
+// The binary log prints as the KQuery log, but for the timings, and
+// evaluates as it.
+// CHECK: Logging all queries in .kqlog format
+
+#include "klee/klee.h"
+
+int main() {
+  char buf[4];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  if (buf[0] == 'a' && buf[1] > buf[2])
+    return 1;
+  if ((unsigned)buf[3] * 3 == 99)
+    return 2;
+  return 0;
+}
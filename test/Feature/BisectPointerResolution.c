@@ -0,0 +1,35 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --bisect-pointer-resolution %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+int *make_int(int i) {
+  int *x = malloc(sizeof(*x));
+  *x = i;
+  return x;
+}
+
+int main() {
+  int *buf[16];
+  int i;
+
+  for (i = 0; i < 16; i++)
+    buf[i] = make_int(i * 3);
+
+  unsigned s;
+  klee_make_symbolic(&s, sizeof s, "s");
+  klee_assume(s >= 5);
+  klee_assume(s < 8);
+
+  // Only the objects pointed to by buf[5..7] are feasible targets.
+  int x = *buf[s];
+  assert(x == s * 3);
+
+  return 0;
+}
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 3
@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --checkpoint --max-instructions=2000 --dump-states-on-halt=false %t.bc 2>&1 | FileCheck --check-prefix=CHECK-HALT %s
+// RUN: test -f %t.klee-out/checkpoint.ktree
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --resume-from=%t.klee-out/checkpoint.ktree %t.bc 2>&1 | FileCheck --check-prefix=CHECK-RESUME %s
+
+// Both states are inside the loop when execution halts, and the resumed run
+// explores all paths below them.
+// CHECK-HALT: KLEE: checkpointed 2 states
+// CHECK-RESUME: KLEE: done: completed paths = 8
+
+#include "klee/klee.h"
+
+int main() {
+  int x, i;
+  int res = 0;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1) res += 1;
+  for (i = 0; i < 10000; ++i)
+    res ^= i;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  return res;
+}
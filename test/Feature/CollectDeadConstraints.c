@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --collect-dead-constraints %t.bc 2>&1 | FileCheck --check-prefix=KLEE %s
+// RUN: %ktest-tool %t.klee-out/test000001.ktest | FileCheck %s
+
+// The constraints over the locals of the returned calls are dropped from
+// the queries, but the test case still satisfies them.
+
+#include "klee/klee.h"
+
+void constrain(const char *name, unsigned char value) {
+  unsigned char x;
+  klee_make_symbolic(&x, sizeof(x), name);
+  klee_assume(x == value);
+}
+
+int main() {
+  constrain("first", 42);
+  for (int i = 0; i < 100; ++i)
+    constrain("x", i);
+  constrain("last", 43);
+  return 0;
+}
+// KLEE: KLEE: done: completed paths = 1
+
+// CHECK: name: 'first'
+// CHECK: hex : 0x2a
+// CHECK: name: 'last'
+// CHECK: hex : 0x2b
@@ -0,0 +1,36 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc initial
+// RUN: test -f %t.klee-out/test000001.ktest
+// RUN: not test -f %t.klee-out/test000002.ktest
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --concolic --seed-file=%t.klee-out/test000001.ktest %t.bc 2>&1 | FileCheck %s
+// RUN: not %klee --output-dir=%t.klee-out-3 --concolic %t.bc 2>&1 | FileCheck --check-prefix=NOSEED %s
+
+// The seed takes the first branch one way. Negating it gives an input
+// taking the second branch, and so on, each path being executed once.
+// CHECK: KLEE: concolic search done after 4 inputs (0 left)
+// CHECK: KLEE: done: completed paths = 4
+// CHECK: KLEE: done: generated tests = 4
+
+// NOSEED: --concolic needs seeds
+
+#include "klee/klee.h"
+
+int main(int argc, char **argv) {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (argc == 2) {
+    klee_assume(x == 0);
+    return 0;
+  }
+
+  if (x > 10) {
+    if (x < 20) {
+      if (x == 15)
+        return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck --check-prefix=FORK %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --symbolic-pointer-policy=bounded --pointer-fork-bound=3 %t1.bc 2>&1 | FileCheck --check-prefix=BOUNDED %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --symbolic-pointer-policy=concretize --symbolic-size-policy=concretize %t1.bc 2>&1 | FileCheck --check-prefix=CONCRETIZE %s
+// RUN: ls %t.klee-out | not grep err
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --symbolic-pointer-policy=merge %t1.bc 2>&1 | FileCheck --check-prefix=MERGE %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+int *make_int(int i) {
+  int *x = malloc(sizeof(*x));
+  *x = i;
+  return x;
+}
+
+int main() {
+  int *buf[8];
+  int i;
+
+  for (i = 0; i < 8; i++)
+    buf[i] = make_int(i * 3);
+
+  unsigned s;
+  klee_make_symbolic(&s, sizeof s, "s");
+  klee_assume(s < 8);
+
+  int x = *buf[s];
+  assert(x == s * 3);
+
+  unsigned n;
+  klee_make_symbolic(&n, sizeof n, "n");
+  klee_assume(n >= 1);
+  klee_assume(n <= 64);
+  char *p = malloc(n);
+  p[n - 1] = 0;
+  free(p);
+
+  return 0;
+}
+// CONCRETIZE: silently concretizing (reason: symbolic pointer)
+// CONCRETIZE: silently concretizing (reason: symbolic size)
+// CONCRETIZE: KLEE: done: completed paths = 1
+
+// Each object is a path, which forks in turn on a concretized size error.
+// FORK: KLEE: done: completed paths = 16
+
+// Three objects are forked over, and the pointer is concretized in the
+// state left.
+// BOUNDED: silently concretizing (reason: symbolic pointer)
+// BOUNDED: KLEE: done: completed paths = 8
+
+// The read through the pointer is a choice over the eight objects, so
+// only the size forks.
+// MERGE-NOT: silently concretizing
+// MERGE-NOT: ASSERTION FAIL
+// MERGE: KLEE: done: completed paths = 2
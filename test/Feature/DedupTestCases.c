@@ -0,0 +1,19 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --dedup-test-cases %t.bc 2>&1 | FileCheck %s
+
+// The paths running the loop once or more take the same edges, so only one
+// of them gets a test case.
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned n, i = 0;
+  klee_make_symbolic(&n, sizeof(n), "n");
+  n &= 3;
+  while (i < n)
+    ++i;
+  return i;
+}
+// CHECK: KLEE: done: completed paths = 4
+// CHECK: KLEE: done: generated tests = 2
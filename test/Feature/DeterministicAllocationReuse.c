@@ -0,0 +1,35 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-determ --allocate-determ-size=1 --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main() {
+  // fifty times the deterministic space, which only fits if the freed
+  // memory is reused
+  for (int i = 0; i < 100; ++i) {
+    char *p = malloc(512 * 1024 - 4096);
+    assert(p);
+    p[0] = 1;
+    free(p);
+  }
+
+  // the lowest free slot of the size is reused
+  char *a = malloc(100), *b = malloc(100);
+  free(b);
+  free(a);
+  char *c = malloc(90);
+  assert(c == a);
+
+  // reused slots keep their red zone
+  char *d = malloc(100);
+  assert(d == b);
+  assert(d - c >= 100 + 10);
+
+  free(c);
+  free(d);
+  return 0;
+}
+// CHECK-NOT: Not enough deterministic space
+// CHECK: KLEE: done: completed paths = 1
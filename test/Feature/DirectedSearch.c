@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --target=DirectedSearch.c:29 %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: not %klee --output-dir=%t.klee-out --target=DirectedSearch.c:1 %t.bc 2>&1 | FileCheck --check-prefix=NONE %s
+
+// The states which miss the target are dropped, the one reaching it runs
+// on to the end of its paths.
+// CHECK: KLEE: WARNING: reached
+// CHECK: KLEE: done: generated tests = 2
+
+// NONE: no instructions at target DirectedSearch.c:1
+
+#include "klee/klee.h"
+
+int check(unsigned x) {
+  if (x & 4)
+    return 1;
+  return 0;
+}
+
+int main() {
+  unsigned x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1)
+    if (x & 2)
+      if (check(x))
+        klee_warning("reached");
+
+  if (x & 8)
+    x++;
+  return x;
+}
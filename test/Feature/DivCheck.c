@@ -1,7 +1,7 @@
-// Check if div-instructions are correctly instrumented:
-// * unoptimized code will contain a call to klee_div_zero_check
-// * optimized code will have this check inlined
-// In both cases, the `div` instruction should have been marked with meta-data: klee.check.div
+// Check if div-instructions are correctly instrumented: in unoptimized and
+// optimized code alike, the `div` instruction should have been marked with
+// meta-data: klee.check.div, which the executor checks, unless its divisor is
+// known not to be zero
 //
 // RUN: %clang %s -emit-llvm -g -c -o %t.bc
 // RUN: rm -rf %t.klee-out
@@ -29,10 +29,8 @@ int main(int argc, char **argv) {
   // Validate
   if (argc / c == 5)
     return 1;
-  // Check that div has been instrumented once
-  // DIV-ENABLED: call {{.*}}void @klee_div_zero_check({{.+}} %{{.+}})
+  // Check that no call is inserted, and that div has the proper metadata
   // DIV-ENABLED-NOT: call {{.*}}void @klee_div_zero_check
-  // Check that div has the proper metadata
   // DIV-ENABLED: sdiv {{.*}} !klee.check.div
   // DIV-ENABLED-OPT: sdiv {{.*}} !klee.check.div
 
@@ -40,7 +38,13 @@ int main(int argc, char **argv) {
   if (argc / 5 == 5)
     return 1;
   // Check that div has not been instrumented
-  // DIV-ENABLED-NOT: call {{.*}}void @klee_div_zero_check(i64 5)
+  // DIV-ENABLED-NOT: sdiv {{.*}} !klee.check.div
+  // DIV-ENABLED-OPT-NOT: sdiv {{.*}} !klee.check.div
+
+  // Validate
+  if (argc / (c | 1) == 5)
+    return 1;
+  // Check that a divisor known not to be zero is not instrumented either
   // DIV-ENABLED-NOT: sdiv {{.*}} !klee.check.div
   // DIV-ENABLED-OPT-NOT: sdiv {{.*}} !klee.check.div
 
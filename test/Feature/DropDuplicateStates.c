@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --drop-duplicate-states %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck --check-prefix=OFF %s
+
+#include "klee/klee.h"
+
+int flag;
+
+// The branch on a local which is gone once it returns leaves two states
+// alike in everything the paths from the caller depend on.
+void twin(void) {
+  unsigned char c;
+  klee_make_symbolic(&c, sizeof(c), "c");
+  if (c & 1)
+    flag = 2;
+  else
+    flag = 2;
+}
+
+int main() {
+  unsigned char x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  // Both states reach the join block with the same memory, hence the same
+  // fingerprint, but x is still live and constrained differently on each:
+  // they are not duplicates.
+  if (x > 100)
+    flag = 1;
+  else
+    flag = 1;
+
+  // Each call forks the two states, whose halves are exact duplicates at
+  // the loop header.
+  for (int i = 0; i < 2; ++i)
+    twin();
+  return flag + x;
+}
+
+// CHECK: KLEE: done: generated tests = 2
+// OFF: KLEE: done: generated tests = 8
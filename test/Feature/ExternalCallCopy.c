@@ -0,0 +1,43 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls-copy-reachable --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+// States share the native memory of their objects, so each external call
+// must see the contents of its own state, also through pointers in memory.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+int main() {
+  char *buf = malloc(8192);
+  memset(buf, 'x', 8191);
+  buf[8191] = 0;
+  assert(strlen(buf) == 8191);
+
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x) {
+    buf[10] = 0;
+    assert(strlen(buf) == 10);
+  } else {
+    buf[5000] = 0;
+    assert(strlen(buf) == 5000);
+  }
+  // unchanged since the last call of this state
+  assert(strlen(buf) == (x ? 10 : 5000));
+
+  char hello[] = "hello ", world[] = "world\n";
+  struct iovec iov[2] = {{hello, 6}, {world, 6}};
+  // CHECK: hello world
+  writev(1, iov, 2);
+
+  free(buf);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
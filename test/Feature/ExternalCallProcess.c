@@ -0,0 +1,32 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls-process --allocate-determ %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls-process --allocate-virtual %t1.bc 2>&1 | FileCheck %s
+
+// External calls in their own process see and update the objects, and a
+// crash only fails the call which caused it.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+int main() {
+  char buf[16];
+  sprintf(buf, "%d", 42);
+  assert(strcmp(buf, "42") == 0);
+
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x) {
+    // CHECK: failed external call: strlen
+    strlen((char *)1);
+  }
+
+  // run by a new process after the crash
+  assert(strlen(buf) == 2);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 1
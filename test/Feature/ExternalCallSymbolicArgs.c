@@ -0,0 +1,22 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls=all %t.bc > %t.out 2> %t.log
+// RUN: FileCheck -input-file=%t.log %s
+
+#include "klee/klee.h"
+#include <stdio.h>
+
+// The arguments of the external call are concretized together, and kept
+// at the values it was called with: there is no path where they differ.
+int main() {
+  int a, b;
+  klee_make_symbolic(&a, sizeof a, "a");
+  klee_make_symbolic(&b, sizeof b, "b");
+  klee_assume(a > b);
+  printf("%d %d\n", a, b);
+  if (a != klee_get_value_i32(a) || b != klee_get_value_i32(b))
+    return 1;
+  return 0;
+}
+
+// CHECK: KLEE: done: completed paths = 1
@@ -0,0 +1,52 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --fast-mem-functions %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | grep -c err | FileCheck --check-prefix=CHECK-ERR %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <string.h>
+
+int main() {
+  char buf[8] = "abcdefg";
+  char dst[8];
+  unsigned char s, n;
+  klee_make_symbolic(&s, sizeof(s), "s");
+  klee_make_symbolic(&n, sizeof(n), "n");
+
+  memcpy(dst, buf, sizeof(buf));
+  assert(dst[0] == 'a' && dst[6] == 'g' && dst[7] == 0);
+
+  // overlapping moves in both directions
+  memmove(buf + 1, buf, 4);
+  assert(buf[0] == 'a' && buf[1] == 'a' && buf[4] == 'd' && buf[5] == 'f');
+  memmove(buf, buf + 2, 3);
+  assert(buf[0] == 'b' && buf[2] == 'd' && buf[3] == 'd');
+
+  // symbolic contents are copied as they are
+  memset(dst, s, 4);
+  memcpy(buf, dst, 2);
+  if (buf[1] == 'x')
+    assert(s == 'x');
+  assert(dst[4] == 'e');
+
+  // a symbolic size within bounds does not fork either
+  memset(dst, 0, n % 4);
+  if (n % 4 == 3)
+    assert(dst[2] == 0 && dst[3] == (char)s);
+
+  // a whole object copy shares the contents, which stay separate after
+  char whole[16], copy[16];
+  klee_make_symbolic(whole, sizeof(whole), "whole");
+  memcpy(copy, whole, sizeof(whole));
+  copy[1] = 'z';
+  assert(copy[0] == whole[0] && copy[15] == whole[15]);
+  if (whole[1] != 'z')
+    assert(copy[1] != whole[1]);
+
+  // CHECK: memory error: out of bound pointer
+  memcpy(dst + 4, buf, 5);
+  return 0;
+}
+// CHECK-ERR: 1
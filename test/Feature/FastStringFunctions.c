@@ -0,0 +1,46 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --libc=klee --fast-string-functions --fast-mem-functions --max-instructions=50000 --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | not grep early
+
+// Concrete strings are handled natively: the loops of klee-libc over these
+// 64 KiB would take far more instructions than the limit. Symbolic bytes
+// are left to the bodies.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <string.h>
+
+static char big[65536], other[65536];
+
+int main() {
+  memset(big, 'a', sizeof(big) - 1);
+  memset(other, 'a', sizeof(other) - 1);
+  big[sizeof(big) - 2] = 'b';
+
+  assert(strlen(big) == sizeof(big) - 1);
+  assert(strcmp(big, other) > 0 && strcmp(other, big) < 0);
+  assert(strncmp(big, other, sizeof(big) - 2) == 0);
+  assert(memcmp(big, other, 10) == 0);
+  assert(strchr(big, 'b') == big + sizeof(big) - 2);
+  assert(strchr(big, 'c') == 0);
+  assert(strchr(big, 0) == big + sizeof(big) - 1);
+  assert(strrchr(big, 'a') == big + sizeof(big) - 3);
+  assert(memchr(big, 'b', sizeof(big)) == big + sizeof(big) - 2);
+  assert(memchr(big, 'b', 100) == 0);
+
+  // unsigned comparison of the characters
+  assert(strcmp("\x80", "a") > 0);
+
+  char s[4];
+  klee_make_symbolic(s, sizeof(s), "s");
+  s[3] = 0;
+  if (strcmp(s, "ab") == 0) {
+    // CHECK-DAG: equal
+    klee_warning("equal");
+    assert(strlen(s) == 2);
+  }
+  return 0;
+}
+// CHECK-DAG: KLEE: done: completed paths = {{[1-9][0-9]*}}
@@ -0,0 +1,50 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --summarize-functions %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+unsigned table[4] = {3, 5, 7, 11};
+unsigned calls;
+
+unsigned hash(unsigned v) {
+  unsigned h = 0;
+  for (int i = 0; i < 4; ++i)
+    h = h * 31 + (table[i] ^ v);
+  return h;
+}
+
+void count(void) { ++calls; }
+
+unsigned scale(unsigned v, unsigned *factor) { return v * *factor; }
+
+int main() {
+  unsigned x, factor = 2;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  unsigned expected = hash(1);
+  // both paths call again with the same arguments and memory
+  if (x > 10)
+    assert(hash(1) == expected);
+  else
+    assert(hash(1) == expected);
+
+  // the writes of a summary are replayed
+  count();
+  count();
+  assert(calls == 2);
+
+  // different memory contents do not match the summary
+  table[2] = 8;
+  assert(hash(1) != expected);
+
+  // nor do symbolic ones
+  assert(scale(3, &factor) == 6);
+  factor = x;
+  if (x == 5)
+    assert(scale(3, &factor) == 15);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 3
@@ -0,0 +1,31 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.queue %t.export %t.export-2 %t.bitmap
+// RUN: mkdir -p %t.queue
+// RUN: printf 'DCBA' > '%t.queue/id:000000,orig:a'
+// RUN: %klee --output-dir=%t.klee-out --fuzzer-queue=%t.queue --fuzzer-export-dir=%t.export --fuzzer-bitmap=%t.bitmap %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.export | FileCheck --check-prefix=EXPORT %s
+// RUN: grep -q DCBA %t.export/*
+// RUN: wc -c %t.bitmap | FileCheck --check-prefix=BITMAP %s
+
+// The edges are in the bitmap already, so nothing is exported again.
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --fuzzer-export-dir=%t.export-2 --fuzzer-bitmap=%t.bitmap %t.bc
+// RUN: ls %t.export-2 | not grep id
+
+// CHECK: KLEE: importing 1 inputs from the fuzzer
+// CHECK: KLEE: done: completed paths = 2
+
+// EXPORT: id:000000,src:klee
+// EXPORT: id:000001,src:klee
+
+// BITMAP: 65536
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x == 0x41424344)
+    return 1;
+  return 0;
+}
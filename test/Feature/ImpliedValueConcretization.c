@@ -0,0 +1,36 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --implied-value-concretization=false %t1.bc 2>&1 | FileCheck --check-prefix=OFF %s
+
+// The bytes of a symbolic object fixed by a constraint are concrete from
+// then on, unless they have been overwritten since it was read.
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned char buf[4];
+  klee_make_symbolic(buf, sizeof(buf), "buf");
+
+  if (*(unsigned short *)buf == 0x1234) {
+    // CHECK-DAG: low bytes concrete
+    // OFF-DAG: low bytes symbolic
+    if (!klee_is_symbolic(buf[0]) && !klee_is_symbolic(buf[1]))
+      klee_warning("low bytes concrete");
+    else
+      klee_warning("low bytes symbolic");
+    // CHECK-DAG: high bytes symbolic
+    if (klee_is_symbolic(buf[2]))
+      klee_warning("high bytes symbolic");
+  }
+
+  unsigned char c = buf[3];
+  buf[3] = c + 1;
+  if (c == 7)
+    // CHECK-DAG: overwritten byte symbolic
+    if (klee_is_symbolic(buf[3]))
+      klee_warning("overwritten byte symbolic");
+  return 0;
+}
+// CHECK-DAG: KLEE: done: completed paths = 4
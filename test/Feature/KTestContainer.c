@@ -0,0 +1,26 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-seeded
+// RUN: %klee --output-dir=%t.klee-out --write-ktest-container --compress-ktest-container %t.bc
+// RUN: ls %t.klee-out | not grep "\.ktest$"
+// RUN: %ktest-tool %t.klee-out/tests.ktests | FileCheck --check-prefix=TOOL %s
+
+// The test cases are appended to a single container, which seeds as the
+// separate files would.
+// RUN: %klee --output-dir=%t.klee-out-seeded --seed-file=%t.klee-out/tests.ktests --only-seed %t.bc 2>&1 | FileCheck --check-prefix=SEED %s
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
+// TOOL: ktest file : '{{.*}}tests.ktests:1'
+// TOOL: name: 'x'
+// TOOL: ktest file : '{{.*}}tests.ktests:2'
+// TOOL: name: 'x'
+
+// SEED: using 2 seeds
+// SEED: KLEE: done: completed paths = 2
@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  char buf[4];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  // a conjunction of truth values, assumed conjunct by conjunct
+  int ok = 1;
+  for (unsigned i = 0; i < sizeof buf; ++i)
+    ok &= (buf[i] >= 'a') & (buf[i] <= 'z');
+  klee_assume(ok);
+  assert(buf[2] >= 'a' && buf[2] <= 'z');
+
+  // the first conjunct is implied by the constraints
+  klee_assume(ok & (buf[1] == 'q'));
+  assert(buf[1] == 'q');
+
+  // CHECK: KLEE: ERROR: {{.*}}KleeAssumeConjunction.c:[[@LINE+1]]: invalid klee_assume call (provably false)
+  klee_assume((buf[0] >= 'a') & (buf[3] == '0'));
+  return 0;
+}
+// CHECK-NOT: ASSERTION FAIL
@@ -0,0 +1,33 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.runs
+// RUN: mkdir %t.runs
+// RUN: %klee --output-dir=%t.runs/one %t.bc 2> %t.log
+// RUN: %klee --output-dir=%t.runs/two %t.bc 2> %t.log
+// RUN: klee-stats --aggregate percentiles %t.runs > %t.stats
+// RUN: FileCheck -check-prefix=CHECK-PERCENTILES -input-file=%t.stats %s
+// RUN: klee-stats --aggregate-only --timeline 1000 %t.runs > %t.timeline
+// RUN: FileCheck -check-prefix=CHECK-TIMELINE -input-file=%t.timeline %s
+// RUN: klee-stats --to-json %t.runs > %t.json
+// RUN: FileCheck -check-prefix=CHECK-JSON -input-file=%t.json %s
+#include "klee/klee.h"
+#include <stdlib.h>
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(int), "a");
+  if (a)
+    abort();
+  return 0;
+}
+// CHECK-PERCENTILES: |{{ *}}one{{ *}}|
+// CHECK-PERCENTILES: |{{ *}}two{{ *}}|
+// CHECK-PERCENTILES: |{{ *}}P50 (2){{ *}}|
+// CHECK-PERCENTILES: |{{ *}}P90 (2){{ *}}|
+// CHECK-PERCENTILES: |{{ *}}Max (2){{ *}}|
+
+// Both runs end in the first interval.
+// CHECK-TIMELINE: |{{ *}}Time(s)|{{ *}}Runs|
+// CHECK-TIMELINE-NEXT: ---
+// CHECK-TIMELINE-NEXT: |{{ *}}1000.00|{{ *}}2|
+
+// CHECK-JSON-DAG: {"Instructions": {{[1-9][0-9]*}},{{.*}}"Path": "{{.*}}one"}
+// CHECK-JSON-DAG: {"Instructions": {{[1-9][0-9]*}},{{.*}}"Path": "{{.*}}two"}
@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2> %t.log
+// RUN: klee-stats --print-call-paths --sort-call-paths-by Forks %t.klee-out > %t.stats
+// RUN: FileCheck -input-file=%t.stats %s
+#include "klee/klee.h"
+
+#include <stdlib.h>
+
+int choose(int a) {
+  if (a > 10)
+    return 1;
+  if (a > 5)
+    return 2;
+  return 3;
+}
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(int), "a");
+  char *buf = malloc(100);
+  buf[0] = choose(a);
+  return buf[0];
+}
+// CHECK: |Call path
+// The caller includes the forks of its callees.
+// CHECK: |main{{ *}}|
+// CHECK-NEXT: |main;choose{{ *}}|{{ *}}1|
@@ -0,0 +1,19 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2> %t.log
+// RUN: klee-stats --print-query-latency %t.klee-out > %t.stats
+// RUN: FileCheck -input-file=%t.stats %s
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(int), "a");
+  if (a > 10)
+    return 1;
+  return 0;
+}
+// CHECK: Origin
+// CHECK-DAG: Fork
+// CHECK-DAG: Solution
+// CHECK: Instruction
+// CHECK: main (KleeStatsQueryLatency.c:11)
@@ -0,0 +1,36 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-globals %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-globals=false %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+// never accessed, and so never written
+static const unsigned untouched[1 << 16] = {1, 2, 3};
+static const unsigned table[4] = {10, 20, 30, 40};
+static const char *names[] = {"zero", "one"};
+static const char **first = &names[0];
+int counter = 5;
+
+int main() {
+  unsigned i;
+  klee_make_symbolic(&i, sizeof i, "i");
+  klee_assume(i < 4);
+
+  // a symbolic read of a lazy global, in every state
+  assert(table[i] == 10 * (i + 1));
+  // the contents of a global referring to another
+  assert((*first)[0] == 'z' && names[1][0] == 'o');
+
+  counter += i;
+  if (counter == 8)
+    // CHECK: counter 8
+    printf("counter %d\n", counter);
+  return 0;
+}
+
+// CHECK: KLEE: done: completed paths = 2
@@ -0,0 +1,35 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-init %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | not grep err
+
+// A list given as a symbolic pointer is built on demand as it is walked:
+// its nodes may be null, earlier nodes or new ones.
+
+#include "klee/klee.h"
+
+struct node {
+  int value;
+  struct node *next;
+};
+
+static int sum(struct node *l) {
+  int s = 0;
+  for (int i = 0; l && i < 3; ++i, l = l->next)
+    s += l->value;
+  return s;
+}
+
+int main() {
+  struct node *head;
+  klee_make_symbolic(&head, sizeof(head), "head");
+
+  if (head && head->next == head)
+    // CHECK-DAG: cycle
+    klee_warning("cycle");
+  if (head && head->next && head->next != head && sum(head) == 42)
+    // CHECK-DAG: sum of 42
+    klee_warning("sum of 42");
+  return 0;
+}
+// CHECK-DAG: KLEE: done: completed paths = {{[1-9][0-9]*}}
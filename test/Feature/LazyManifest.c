@@ -0,0 +1,34 @@
+// Without statistics, functions are only manifested once called.
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --output-stats=false --output-istats=false --search=dfs %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static const char message[] = "never printed";
+
+int unused(int x) {
+  // constants of functions never called are not needed
+  return x * 1234567 + message[3];
+}
+
+int twice(int x) { return 2 * x + 11; }
+
+int later(int x) { return x - 7; }
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  int (*fn)(int) = x > 0 ? twice : later;
+
+  assert(twice(3) == 17);
+  if (fn(x) == 13)
+    assert(x == 1);
+  else
+    assert(later(twice(x)) == 2 * x + 4);
+  return 0;
+}
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 3
@@ -0,0 +1,35 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --library-entry-points=first,second,count_args %t.bc one two 2>&1 | FileCheck %s
+// RUN: not ls %t.klee-out | grep assert.err
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int counter = 5;
+
+// CHECK: running entry point first
+void first() {
+  int x;
+  klee_make_symbolic(&x, sizeof x, "x");
+  counter += 10;
+  if (x > 0)
+    counter = 1;
+}
+
+// every entry point starts from the globals as initialized
+// CHECK: running entry point second
+void second() {
+  assert(counter == 5);
+  counter = 0;
+}
+
+// CHECK: running entry point count_args
+int count_args(int argc, char **argv) {
+  assert(counter == 5);
+  assert(argc == 3 && argv[1][0] == 'o' && argv[2][1] == 'w');
+  return 0;
+}
+
+// CHECK: KLEE: done: completed paths = 4
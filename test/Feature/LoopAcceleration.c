@@ -0,0 +1,26 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize --libc=klee --fast-mem-functions --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+char buf[32];
+
+int main() {
+  unsigned n;
+  klee_make_symbolic(&n, sizeof(n), "n");
+  if (n > sizeof(buf))
+    return 1;
+
+  // becomes a memset of a symbolic size, instead of forking on each
+  // iteration
+  for (unsigned i = 0; i < n; ++i)
+    buf[i] = 'a';
+
+  assert((n < 8) | (buf[7] == 'a'));
+  assert((n == sizeof(buf)) | (buf[n % sizeof(buf)] == 0));
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
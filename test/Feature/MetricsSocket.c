@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.sock
+// RUN: %klee --output-dir=%t.klee-out --external-calls=all --metrics-socket=%t.sock %t1.bc %t.sock 2>&1 | FileCheck %s
+// RUN: not test -e %t.sock
+
+// The program scrapes the metrics of its own run, which are served while
+// the interpreter waits for the external calls.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, argv[1]);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+    return 1;
+  const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+  write(fd, request, sizeof(request) - 1);
+
+  static char response[1 << 16];
+  int n, size = 0;
+  while ((n = read(fd, response + size, sizeof(response) - 1 - size)) > 0)
+    size += n;
+  close(fd);
+  response[size] = 0;
+  puts(response);
+  fflush(stdout);
+  return 0;
+}
+// CHECK: HTTP/1.0 200 OK
+// CHECK: # TYPE klee_instructions counter
+// CHECK: klee_instructions {{[1-9][0-9]*}}
+// CHECK: klee_states 1
+// CHECK: klee_query_latency_seconds_bucket{origin="Fork",le="+Inf"}
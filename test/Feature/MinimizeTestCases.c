@@ -0,0 +1,19 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --minimize-test-cases %t.bc
+// RUN: %ktest-tool %t.klee-out/test00000[123].ktest | FileCheck %s
+
+// The bytes the paths leave free are zero.
+
+#include "klee/klee.h"
+
+int main() {
+  char buf[4];
+  klee_make_symbolic(buf, sizeof(buf), "buf");
+  if (buf[0] == 'a' && buf[2] != 0)
+    return 1;
+  return 0;
+}
+// CHECK-DAG: hex : 0x00000000
+// CHECK-DAG: hex : 0x61000000
+// CHECK-DAG: hex : 0x6100{{[0-9a-f][1-9a-f]|[1-9a-f][0-9a-f]}}00
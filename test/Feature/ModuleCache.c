@@ -0,0 +1,26 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.cache
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-FIRST %s
+// RUN: ls %t.cache | grep -c "\.bc$" | FileCheck --check-prefix=CHECK-ONE %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-SECOND %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache --check-div-zero=false %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-FIRST %s
+// RUN: ls %t.cache | grep -c "\.bc$" | FileCheck --check-prefix=CHECK-TWO %s
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 42)
+    return 1;
+  return 0;
+}
+
+// CHECK-FIRST-NOT: Using prepared module
+// CHECK-FIRST: KLEE: done: completed paths = 2
+// CHECK-SECOND: Using prepared module
+// CHECK-SECOND: KLEE: done: completed paths = 2
+// CHECK-ONE: 1
+// CHECK-TWO: 2
@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize --optimize-pipeline=symbolic %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+static int clamp(int x) {
+  if (x > 100)
+    x = 100;
+  return x;
+}
+
+// The branches on the symbolic values become selects, hence one path.
+int sum_positive(const int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; ++i)
+    if (a[i] > 0)
+      s += clamp(a[i] * 3 - (a[i] >> 2));
+  return s;
+}
+
+int main() {
+  int a[3];
+  klee_make_symbolic(a, sizeof a, "a");
+  return sum_positive(a, 3) > 300;
+}
+
+// CHECK: KLEE: done: completed paths = 1
@@ -0,0 +1,27 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-ptree-log %t.bc 2> %t.log
+// RUN: %klee-ptree %t.klee-out/ptree.bin | FileCheck %s
+
+#include "klee/klee.h"
+
+// Two forks in a row, hence three splits and four paths.
+int main() {
+  int a, b;
+  klee_make_symbolic(&a, sizeof a, "a");
+  klee_make_symbolic(&b, sizeof b, "b");
+  int n = 0;
+  if (a > 0)
+    ++n;
+  if (b > 0)
+    ++n;
+  return n;
+}
+
+// CHECK: trees: 1
+// CHECK: splits: 3
+// CHECK: removes: 4
+// CHECK: leaves: 0
+// CHECK: splits   mean depth  site
+// CHECK: 2          1.0  main ({{.*}}PTreeLog.c:16)
+// CHECK: 1          0.0  main ({{.*}}PTreeLog.c:14)
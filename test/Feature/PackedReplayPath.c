@@ -0,0 +1,25 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-paths --pack-paths %t.bc 2>&1 | FileCheck --check-prefix=CHECK-FULL %s
+// RUN: head -c 5 %t.klee-out/test000001.path | grep KPATH
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.klee-out/test000001.path %t.bc 2>&1 | FileCheck --check-prefix=CHECK-REPLAY %s
+
+// A packed .path file replays like a text one.
+// CHECK-FULL: KLEE: done: completed paths = 8
+// CHECK-REPLAY: KLEE: done: completed paths = 1
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  int res = 0;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1) res += 1;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  return res;
+}
@@ -0,0 +1,21 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize --prove-in-bounds %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | grep ptr.err
+
+#include "klee/klee.h"
+
+int table[16];
+
+int main() {
+  unsigned i, j;
+  klee_make_symbolic(&i, sizeof i, "i");
+  klee_make_symbolic(&j, sizeof j, "j");
+
+  // proved in bounds: the index is masked to the size of the table
+  table[i & 15] = 1;
+
+  // not proved, and still checked at run time
+  // CHECK: ProveInBounds.c:[[@LINE+1]]: memory error: out of bound pointer
+  return table[j & 31];
+}
@@ -0,0 +1,21 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --prune-covered-states=silent --uncovered-update-interval=0s %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+// Every instruction is covered by the first two paths, out of 2^16: once
+// the distances to the uncovered instructions are updated, the states
+// left are terminated instead of running to the end.
+int main() {
+  unsigned char in[16];
+  klee_make_symbolic(in, sizeof in, "in");
+  int n = 0;
+  for (int i = 0; i < 16; ++i)
+    if (in[i] & 1)
+      ++n;
+  return n;
+}
+
+// CHECK-NOT: completed paths = 65536
+// CHECK: KLEE: done: completed paths = {{[0-9]+$}}
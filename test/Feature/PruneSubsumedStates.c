@@ -0,0 +1,30 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --prune-subsumed-states %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs %t1.bc 2>&1 | FileCheck --check-prefix=OFF %s
+
+#include "klee/klee.h"
+
+int flag;
+
+// Forks on a local which is gone once it returns, leaving the same
+// memory on both paths.
+void noise(void) {
+  unsigned char c;
+  klee_make_symbolic(&c, sizeof(c), "c");
+  if (c > 100)
+    flag = 0;
+  else
+    flag = 0;
+}
+
+int main() {
+  for (int i = 0; i < 3; ++i)
+    noise();
+  return flag;
+}
+
+// Only the first path through each call is explored further.
+// CHECK: KLEE: done: completed paths = 4
+// OFF: KLEE: done: completed paths = 8
@@ -0,0 +1,25 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-paths %t.bc 2>&1 | FileCheck --check-prefix=CHECK-FULL %s
+// RUN: head -n 1 %t.klee-out/test000001.path > %t.prefix
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.prefix --replay-path-prefix %t.bc 2>&1 | FileCheck --check-prefix=CHECK-PREFIX %s
+
+// Only the subtree below the first branch decision is explored.
+// CHECK-FULL: KLEE: done: completed paths = 8
+// CHECK-PREFIX: KLEE: done: completed paths = 4
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  int res = 0;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1) res += 1;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  return res;
+}
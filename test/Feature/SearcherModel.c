@@ -0,0 +1,33 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.model %t.bad-model
+// RUN: %klee --output-dir=%t.klee-out --write-searcher-features %t.bc
+// RUN: FileCheck --check-prefix=FEATURES %s < %t.klee-out/searcher-features.csv
+// RUN: printf 'bias 1 # all states alike\nmd2u -0.5\ninsts_since_cov_new -0.001\n' > %t.model
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=nurs:model --searcher-model=%t.model %t.bc 2>&1 | FileCheck %s
+// RUN: printf 'depth\n' > %t.bad-model
+// RUN: rm -rf %t.klee-out
+// RUN: not %klee --output-dir=%t.klee-out --search=nurs:model --searcher-model=%t.bad-model %t.bc 2>&1 | FileCheck --check-prefix=BAD %s
+
+// FEATURES: depth,query_cost,insts_since_cov_new,stack_depth,constraints,md2u,fork_rate,covered_new
+// FEATURES-NEXT: {{^[0-9.e+-]+(,[0-9.e+-]+){7}$}}
+// FEATURES-NEXT: {{^[0-9.e+-]+(,[0-9.e+-]+){7}$}}
+// FEATURES-NEXT: {{^[0-9.e+-]+(,[0-9.e+-]+){7}$}}
+// FEATURES-NEXT: {{^[0-9.e+-]+(,[0-9.e+-]+){7}$}}
+
+// CHECK: KLEE: done: completed paths = 4
+
+// BAD: bad-model:1: expected a feature and its weight
+
+#include "klee/klee.h"
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+  if (x > 0)
+    x = 1;
+  if (y > 0)
+    y = 1;
+  return x + y;
+}
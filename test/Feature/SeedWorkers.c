@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --seed-dir=%t.klee-out --seed-workers=3 %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out-2 | not grep ktree
+
+// The seeds of the first run cover all paths. Their workers share them,
+// and the main process re-creates each path once and outputs its test.
+// CHECK: KLEE: replaying 8 seeds in 3 seed workers
+// CHECK: KLEE: re-creating the states of the seed workers from {{[0-9]+}} paths
+// CHECK: KLEE: done: completed paths = 8
+// CHECK: KLEE: done: generated tests = 8
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  int res = 0;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1) res += 1;
+  if (x & 2) res += 2;
+  if (x & 4) res += 4;
+
+  return res;
+}
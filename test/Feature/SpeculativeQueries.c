@@ -0,0 +1,33 @@
+// REQUIRES: stp
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=stp --solver-workers=2 --speculative-queries=1 --search=random-state %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+// The states are switched at every instruction, leaving them at branches
+// and returns whose queries the spare worker solves meanwhile.
+int main() {
+  unsigned char x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  int paths = 0;
+  if (x > 10)
+    paths |= 1;
+  if (y < 5)
+    paths |= 2;
+  // not feasible together with x <= 10 && y < 5
+  if (x + y == 42)
+    paths |= 4;
+  // infeasible in every path that took the first two branches
+  if ((paths & 3) == 3 && x + y < 11)
+    assert(0 && "infeasible");
+
+  return paths;
+}
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 7
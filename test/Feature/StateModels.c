@@ -0,0 +1,39 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-state-models=true %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-state-models=false %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-state-models=true --model-trie-size=0 %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-state-models=true --model-trie-size=2 %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  unsigned char x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  // Each branch is feasible on the side the previous model took, so
+  // the models decide one side of most branches.
+  int paths = 0;
+  if (x > 100)
+    paths |= 1;
+  if (x > 50)
+    paths |= 2;
+  if (y == x)
+    paths |= 4;
+  // infeasible in every path
+  if ((paths & 3) == 1)
+    assert(0 && "infeasible");
+  if ((paths & 4) && y != x)
+    assert(0 && "infeasible");
+
+  return paths;
+}
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 6
@@ -0,0 +1,21 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=subpath --subpath-length=2 %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=INFO %s < %t.klee-out/info
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=subpath --search=dfs %t.bc 2>&1 | FileCheck %s
+
+// CHECK: KLEE: done: completed paths = 16
+
+// INFO: SubpathSearcher
+
+#include "klee/klee.h"
+
+int main() {
+  int x[4], sum = 0;
+  klee_make_symbolic(x, sizeof x, "x");
+  for (int i = 0; i < 4; i++)
+    if (x[i] > 0)
+      sum += x[i];
+  return sum > 0;
+}
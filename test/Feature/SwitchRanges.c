@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --switch-type=internal %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+// A dispatch table with many cases but few distinct successors forks once
+// per successor, the default one included.
+int main() {
+  unsigned char op;
+  klee_make_symbolic(&op, sizeof op, "op");
+
+  int r;
+  switch (op) {
+  case 0 ... 63:
+  case 128:
+    r = 1;
+    break;
+  case 64 ... 127:
+  case 130:
+    r = 2;
+    break;
+  case 200 ... 254:
+    r = 3;
+    break;
+  case 129:
+  default:
+    r = 0;
+    break;
+  }
+  return r;
+}
+
+// CHECK: KLEE: done: completed paths = 4
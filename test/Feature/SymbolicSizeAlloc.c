@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --symbolic-size-policy=symbolic %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | not grep err
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --symbolic-size-policy=symbolic --max-symbolic-alloc-size=32 %t1.bc 2>&1 | FileCheck --check-prefix=BOUND %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main() {
+  unsigned n;
+  klee_make_symbolic(&n, sizeof n, "n");
+  klee_assume(n >= 1);
+  klee_assume(n <= 64);
+
+  char *p = malloc(n);
+  if (!p)
+    return 0;
+  p[n - 1] = 0;
+  assert(klee_get_obj_size(p) == n);
+  free(p);
+
+  return 0;
+}
+// A single object serves every size.
+// CHECK-NOT: concretizing
+// CHECK: KLEE: done: completed paths = 1
+
+// The sizes above the bound fail to allocate.
+// BOUND: found huge malloc, returning 0
+// BOUND: KLEE: done: completed paths = 2
@@ -0,0 +1,19 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --test-case-workers=2 --write-kqueries %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | grep -c "\.ktest$" | grep 4
+// RUN: ls %t.klee-out | grep -c "\.kquery$" | grep 4
+
+// Test cases are written by worker processes, all of them before klee is
+// done.
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return x > 20 ? 2 : 1;
+  return x < -10 ? -1 : 0;
+}
+// CHECK: KLEE: done: generated tests = 4
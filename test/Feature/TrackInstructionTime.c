@@ -0,0 +1,22 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --track-instruction-time --instruction-time-sample-interval=1ms %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-FOLDED --input-file=%t.klee-out/run.folded %s
+// RUN: FileCheck --check-prefix=CHECK-ISTATS --input-file=%t.klee-out/run.istats %s
+
+unsigned work(unsigned n) {
+  unsigned sum = 0;
+  for (unsigned i = 0; i < n; ++i)
+    sum += i * i;
+  return sum;
+}
+
+int main() {
+  return work(1000000) == 0;
+}
+// CHECK: KLEE: done: completed paths = 1
+
+// Interpreting the loop takes well over a millisecond of CPU time.
+// CHECK-FOLDED: {{^main;work [0-9]+$}}
+
+// CHECK-ISTATS: event: Itime : InstructionTimes
@@ -0,0 +1,39 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --trim-dead-registers=false %t1.bc 2>&1 | FileCheck %s
+
+// States fork deep in recursive calls, in loops and before phi nodes: the
+// registers they copy when they write to them must still hold every value
+// they read later, in the frames of the callers too.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static int fib(int n, int x) {
+  int a = n * 3, b = (x > 0) + 1;
+  if (n < 2)
+    return x > 0 ? a + b : b - a;
+  int r = fib(n - 1, x) + fib(n - 2, x);
+  return r + a - b;
+}
+
+int main() {
+  int x, sum = 0;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_assume(x > -4 & x < 4);
+
+  for (int i = 0; i < 3; ++i)
+    sum += (x & (1 << i)) ? i : -i;
+
+  int r = fib(5, x);
+  if (x > 0)
+    assert(r == fib(5, 1));
+  else
+    assert(r == fib(5, 0));
+  assert(sum == ((x & 2) ? 1 : -1) + ((x & 4) ? 2 : -2));
+  // CHECK: KLEE: done: completed paths = {{[1-9][0-9]*}}
+  return 0;
+}
@@ -0,0 +1,24 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -check-div-zero -check-overshift %t.bc 2> %t.log
+// RUN: FileCheck --input-file %t.log %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -check-div-zero -check-overshift --optimize %t.bc 2> %t.opt.log
+// RUN: FileCheck --input-file %t.opt.log %s
+
+/* The optimiser deletes a division or a shift whose result is unused,
+ * which must not take its check with it.
+ */
+#include "klee/klee.h"
+int main() {
+  unsigned int x = 15;
+  unsigned int y;
+
+  klee_make_symbolic(&y, sizeof(y), "y");
+  // CHECK: UnusedCheckedOperations.c:[[@LINE+1]]: divide by zero
+  (void)(x / y);
+  // CHECK: UnusedCheckedOperations.c:[[@LINE+1]]: overshift error
+  (void)(x << y);
+
+  return 0;
+}
@@ -0,0 +1,32 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-virtual --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-virtual --allocate-determ --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+// Objects only have host memory once passed to external calls, which
+// must see and update their contents.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main() {
+  // large, and never passed to an external call
+  char *big = malloc(256 * 1024 * 1024);
+  big[0] = 1;
+
+  char *buf = malloc(8192);
+  memset(buf, 'x', 8191);
+  buf[8191] = 0;
+  assert(strlen(buf) == 8191);
+
+  sprintf(buf + 4096, "%d", 42);
+  assert(buf[4096] == '4' && buf[4097] == '2' && buf[4098] == 0);
+
+  free(buf);
+  free(big);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 1
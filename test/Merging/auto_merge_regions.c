@@ -0,0 +1,42 @@
+// RUN: %clang -emit-llvm -g -c -o %t.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge --debug-log-merge --auto-merge-max-blocks=8 --search=dfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge --auto-merge-max-blocks=8 --search=nurs:covnew %t.bc 2>&1 | FileCheck --check-prefix=CHECK-TESTS %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge --auto-merge-max-blocks=2 --search=dfs %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SMALL %s
+
+// CHECK: open merge region:
+// CHECK: close merge region:
+// CHECK: close merge region:
+// CHECK: close merge region:
+// CHECK: close merge region:
+// CHECK: generated tests = 1{{$}}
+// CHECK-TESTS: generated tests = 1{{$}}
+// Only the region of the innermost branch is small enough to merge.
+// CHECK-SMALL: generated tests = 3{{$}}
+#include <klee/klee.h>
+
+static int classify(int a, int x) {
+  int foo = 0;
+  if (a == 0) {
+    if (x == 1) {
+      foo = 5;
+    } else if (x == 2) {
+      foo = 6;
+    } else {
+      foo = 7;
+    }
+  }
+  return foo;
+}
+
+int main(int argc, char** args){
+  int x;
+  int a;
+
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&a, sizeof(a), "a");
+
+  return classify(a, x);
+}
@@ -0,0 +1,31 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-ktest-container %t.bc
+
+// All test cases of the container are replayed by one run, each in a
+// process forked at the first klee_make_symbolic.
+// RUN: %cc %s %libkleeruntest -Wl,-rpath %libkleeruntestdir -o %t_runner
+// RUN: env KTEST_FILE=%t.klee-out/tests.ktests %t_runner 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+  int x = 0;
+  printf("started\n");
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  if (x == 0) {
+    printf("x is 0\n");
+  } else {
+    printf("x is not 0\n");
+  }
+  return 0;
+}
+
+// CHECK: started
+// CHECK-NOT: started
+// CHECK-DAG: x is 0
+// CHECK-DAG: x is not 0
+// CHECK-DAG: tests.ktests:1: exit status 0
+// CHECK-DAG: tests.ktests:2: exit status 0
@@ -0,0 +1,38 @@
+// RUN: rm -rf %t.out %t.corpus
+// RUN: mkdir -p %t.out %t.corpus && cd %t.out
+// RUN: echo -n a > %t.corpus/1
+// RUN: echo -n bb > %t.corpus/2
+// RUN: echo -n ccc > %t.corpus/3
+// RUN: %gen-bout -o --corpus-stdin %t.corpus
+// RUN: not test -f file.bout
+// RUN: %ktest-tool --jobs 2 file.ktests | FileCheck --check-prefix=TOOL %s
+// RUN: %cc %s -O0 -o %t
+// RUN: %klee-replay %t file.ktests 2>&1 | grep -c "klee-replay: EXIT STATUS: NORMAL" | grep 3
+
+// Each file of the corpus becomes the stdin of one test case.
+// TOOL: ktest file : 'file.ktests:1'
+// TOOL: object 1: name: 'stdin'
+// TOOL-NEXT: object 1: size: 1
+// TOOL: ktest file : 'file.ktests:2'
+// TOOL: object 1: name: 'stdin'
+// TOOL-NEXT: object 1: size: 2
+// TOOL: ktest file : 'file.ktests:3'
+// TOOL: object 1: name: 'stdin'
+// TOOL-NEXT: object 1: size: 3
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  struct stat fs;
+  char buf[4];
+
+  if (argc != 2 || strcmp(argv[1], "-o"))
+    return 1;
+  if (fstat(0, &fs) < 0 || fs.st_size < 1 || fs.st_size > 3)
+    return 1;
+  if (read(0, buf, sizeof(buf)) != fs.st_size)
+    return 1;
+  return 0;
+}
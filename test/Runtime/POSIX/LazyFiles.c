@@ -0,0 +1,40 @@
+// RUN: %clang -DKLEE_EXECUTION %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --posix-runtime %t.bc --sym-files 3 3 --lazy-sym-files
+// RUN: %ktest-tool %t.klee-out/test000001.ktest | FileCheck --check-prefix=OBJECTS %s
+
+// Only the file which was used has objects.
+// OBJECTS-NOT: A-data
+// OBJECTS: C-data
+// OBJECTS-NOT: B-data
+
+// RUN: %cc %s -O0 -o %t2
+// RUN: %klee-replay %t2 %t.klee-out/test000001.ktest | FileCheck --check-prefix=REPLAY %s
+// REPLAY: Yes
+
+#ifdef KLEE_EXECUTION
+#define EXIT klee_silent_exit
+#else
+#include <stdlib.h>
+#define EXIT exit
+#endif
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  char buf[3];
+  int fd = open("C", O_RDONLY);
+  assert(fd != -1);
+  assert(read(fd, buf, 3) == 3);
+
+  if (buf[0] == 'a' && buf[1] == 'b' && buf[2] == 'c')
+    printf("Yes\n");
+  else
+    EXIT(0);
+  return 0;
+}
@@ -0,0 +1,65 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --libc=uclibc --posix-runtime --max-instructions=500000 %t.bc --sym-sockets 3 65536 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | not grep early
+
+// A server accepts the connections of --sym-sockets and receives their
+// data in bulk: byte loops over 64 KiB would take far more instructions
+// than the limit.
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static char buf[65536];
+
+int main(int argc, char **argv) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  assert(s != -1);
+
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(8080);
+  assert(bind(s, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  assert(listen(s, 8) == 0);
+
+  struct pollfd pfd = {s, POLLIN, 0};
+  assert(poll(&pfd, 1, -1) == 1 && (pfd.revents & POLLIN));
+
+  int c = accept(s, NULL, NULL);
+  assert(c != -1);
+  assert(recv(c, buf, 16, MSG_PEEK) == 16);
+  char first = buf[0];
+  assert(recv(c, buf, sizeof(buf), 0) == sizeof(buf) && buf[0] == first);
+  // the peer closed the connection after its data
+  assert(read(c, buf, 1) == 0);
+  assert(send(c, "ok", 2, 0) == 2);
+  assert(close(c) == 0);
+
+  // each connection has its own data
+  c = accept(s, NULL, NULL);
+  assert(c != -1);
+  assert(recv(c, buf, 1, 0) == 1);
+  if (buf[0] == 'G')
+    // CHECK-DAG: got a GET
+    printf("got a GET\n");
+  close(c);
+
+  int d = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(d != -1);
+  // one datagram per call, the rest of it is lost
+  assert(recvfrom(d, buf, 100, 0, NULL, NULL) == 100);
+  assert(fcntl(d, F_SETFL, O_NONBLOCK) == 0);
+  assert(recv(d, buf, 100, 0) == -1 && errno == EAGAIN);
+
+  // CHECK-DAG: blocking forever on a socket, ending the path
+  accept(s, NULL, NULL);
+  assert(0 && "no more connections");
+  return 0;
+}
+// CHECK-DAG: KLEE: done: completed paths = 2
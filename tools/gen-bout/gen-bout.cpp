@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include <assert.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -62,112 +63,93 @@ void print_usage_and_exit(char *program_name) {
   fprintf(stderr, "       --sym-file <filename>       - Specifying a file that "
                   "is the content of a file named A provided for the program "
                   "(only once).\n");
+  fprintf(stderr, "       --corpus-stdin <dir>        - Generating one test "
+                  "case for each file in the directory, as the content of the "
+                  "stdin, into file.ktests.\n");
+  fprintf(stderr, "       --corpus-file <dir>         - As above, with each "
+                  "file as the content of the file named A.\n");
   fprintf(stderr, "   Ex: %s -o -p -q file1 --sym-stdin file2 --sym-file file3 "
                   "--sym-stdout file4\n",
           program_name);
   exit(1);
 }
 
-int main(int argc, char *argv[]) {
+/* Reads the content and status of a file, or exits. */
+static unsigned char *read_file(const char *filename, struct stat64 *file_stat,
+                                char *program_name) {
+  FILE *fp;
+  unsigned char *file_content;
+
+  if ((fp = fopen(filename, "r")) == NULL || stat64(filename, file_stat) < 0) {
+    fprintf(stderr, "Failure opening %s\n", filename);
+    print_usage_and_exit(program_name);
+  }
+
+  if ((file_content = (unsigned char *)malloc(file_stat->st_size + 1)) ==
+      NULL) {
+    fprintf(stderr, "Memory allocation failure\n");
+    exit(1);
+  }
+  if (file_stat->st_size &&
+      fread(file_content, file_stat->st_size, 1, fp) != 1) {
+    fprintf(stderr, "Failure reading %s\n", filename);
+    exit(1);
+  }
+  fclose(fp);
+
+  return file_content;
+}
+
+/* Fills b with the test case for the program arguments args, and the
+   contents of the files which are not NULL. */
+static void gen_test(KTest *b, char *program_name, char **args,
+                     unsigned num_args, const char *content_filename,
+                     const char *stdin_content_filename,
+                     const char *stdout_content_filename) {
   unsigned i, argv_copy_idx;
-  unsigned file_counter = 0;
-  char *stdout_content_filename = NULL;
-  char *stdin_content_filename = NULL;
-  char *content_filenames_list[1024];
   char **argv_copy;
 
-  if (argc < 2)
-    print_usage_and_exit(argv[0]);
+  b->symArgvs = 0;
+  b->symArgvLen = 0;
 
-  KTest b;
-  b.symArgvs = 0;
-  b.symArgvLen = 0;
+  b->numObjects = 0;
+  b->objects = (KTestObject *)malloc(MAX * sizeof *b->objects);
 
-  b.numObjects = 0;
-  b.objects = (KTestObject *)malloc(MAX * sizeof *b.objects);
-
-  if ((argv_copy = (char **)malloc(sizeof(char *) * argc * 2)) == NULL) {
+  if ((argv_copy = (char **)malloc(sizeof(char *) * (num_args * 2 + 8))) ==
+      NULL) {
     fprintf(stderr, "Could not allocate more memory\n");
-    return 1;
+    exit(1);
   }
 
-  argv_copy[0] = (char *)malloc(strlen(argv[0]) + 1);
-  strcpy(argv_copy[0], argv[0]);
+  argv_copy[0] = (char *)malloc(strlen(program_name) + 1);
+  strcpy(argv_copy[0], program_name);
   argv_copy_idx = 1;
 
-  for (i = 1; i < (unsigned)argc; i++) {
-    if (strcmp(argv[i], "--sym-stdout") == 0 ||
-        strcmp(argv[i], "-sym-stdout") == 0) {
-      if (++i == (unsigned)argc || argv[i][0] == '-')
-        print_usage_and_exit(argv[0]);
-
-      if (stdout_content_filename)
-        print_usage_and_exit(argv[0]);
-
-      stdout_content_filename = argv[i];
-
-    } else if (strcmp(argv[i], "--sym-stdin") == 0 ||
-               strcmp(argv[i], "-sym-stdin") == 0) {
-      if (++i == (unsigned)argc || argv[i][0] == '-')
-        print_usage_and_exit(argv[0]);
-
-      if (stdin_content_filename)
-        print_usage_and_exit(argv[0]);
+  for (i = 0; i < num_args; i++) {
+    long nbytes = strlen(args[i]) + 1;
 
-      stdin_content_filename = argv[i];
-    } else if (strcmp(argv[i], "--sym-file") == 0 ||
-               strcmp(argv[i], "-sym-file") == 0) {
-      if (++i == (unsigned)argc || argv[i][0] == '-')
-        print_usage_and_exit(argv[0]);
+    char arg[1024];
+    sprintf(arg, "arg%u", i);
+    push_obj(b, (const char *)arg, nbytes, (unsigned char *)args[i]);
 
-      content_filenames_list[file_counter++] = argv[i];
-    } else {
-      long nbytes = strlen(argv[i]) + 1;
-      static int total_args = 0;
-
-      char arg[1024];
-      sprintf(arg, "arg%d", total_args++);
-      push_obj(&b, (const char *)arg, nbytes, (unsigned char *)argv[i]);
-
-      char *buf1 = (char *)malloc(1024);
-      char *buf2 = (char *)malloc(1024);
-      strcpy(buf1, "-sym-arg");
-      sprintf(buf2, "%ld", nbytes - 1);
-      argv_copy[argv_copy_idx++] = buf1;
-      argv_copy[argv_copy_idx++] = buf2;
-    }
+    char *buf1 = (char *)malloc(1024);
+    char *buf2 = (char *)malloc(1024);
+    strcpy(buf1, "-sym-arg");
+    sprintf(buf2, "%ld", nbytes - 1);
+    argv_copy[argv_copy_idx++] = buf1;
+    argv_copy[argv_copy_idx++] = buf2;
   }
 
-  if (file_counter > 0) {
-    FILE *fp;
+  if (content_filename) {
     struct stat64 file_stat;
-    char *content_filename = content_filenames_list[file_counter - 1];
-
-    if ((fp = fopen(content_filename, "r")) == NULL ||
-        stat64(content_filename, &file_stat) < 0) {
-      fprintf(stderr, "Failure opening %s\n", content_filename);
-      print_usage_and_exit(argv[0]);
-    }
-
+    unsigned char *file_content =
+        read_file(content_filename, &file_stat, program_name);
     long nbytes = file_stat.st_size;
     char filename[7] = "A-data";
     char statname[12] = "A-data-stat";
 
-    unsigned char *file_content, *fptr;
-    if ((file_content = (unsigned char *)malloc(nbytes)) == NULL) {
-      fprintf(stderr, "Memory allocation failure\n");
-      exit(1);
-    }
-
-    int read_char;
-    fptr = file_content;
-    while ((read_char = fgetc(fp)) != EOF) {
-      *fptr = (unsigned char)read_char;
-      fptr++;
-    }
-
-    push_obj(&b, filename, nbytes, file_content);
-    push_obj(&b, statname, sizeof(struct stat64), (unsigned char *)&file_stat);
+    push_obj(b, filename, nbytes, file_content);
+    push_obj(b, statname, sizeof(struct stat64), (unsigned char *)&file_stat);
 
     free(file_content);
 
@@ -183,39 +165,21 @@ int main(int argc, char *argv[]) {
   }
 
   if (stdin_content_filename) {
-    FILE *fp;
     struct stat64 file_stat;
+    unsigned char *file_content =
+        read_file(stdin_content_filename, &file_stat, program_name);
     char filename[6] = "stdin";
     char statname[11] = "stdin-stat";
 
-    if ((fp = fopen(stdin_content_filename, "r")) == NULL ||
-        stat64(stdin_content_filename, &file_stat) < 0) {
-      fprintf(stderr, "Failure opening %s\n", stdin_content_filename);
-      print_usage_and_exit(argv[0]);
-    }
-
-    unsigned char *file_content, *fptr;
-    if ((file_content = (unsigned char *)malloc(file_stat.st_size)) == NULL) {
-      fprintf(stderr, "Memory allocation failure\n");
-      exit(1);
-    }
-
-    int read_char;
-    fptr = file_content;
-    while ((read_char = fgetc(fp)) != EOF) {
-      *fptr = (unsigned char)read_char;
-      fptr++;
-    }
-
-    push_obj(&b, filename, file_stat.st_size, file_content);
-    push_obj(&b, statname, sizeof(struct stat64), (unsigned char *)&file_stat);
+    push_obj(b, filename, file_stat.st_size, file_content);
+    push_obj(b, statname, sizeof(struct stat64), (unsigned char *)&file_stat);
 
     free(file_content);
 
     char *buf1 = (char *)malloc(1024);
     char *buf2 = (char *)malloc(1024);
     sprintf(buf1, "-sym-stdin");
-    sprintf(buf2, "%ld", file_stat.st_size);
+    sprintf(buf2, "%ld", (long)file_stat.st_size);
     argv_copy[argv_copy_idx++] = buf1;
     argv_copy[argv_copy_idx++] = buf2;
   }
@@ -230,7 +194,7 @@ int main(int argc, char *argv[]) {
     if ((fp = fopen(stdout_content_filename, "r")) == NULL ||
         stat64(stdout_content_filename, &file_stat) < 0) {
       fprintf(stderr, "Failure opening %s\n", stdout_content_filename);
-      print_usage_and_exit(argv[0]);
+      print_usage_and_exit(program_name);
     }
 
     int read_char;
@@ -242,11 +206,12 @@ int main(int argc, char *argv[]) {
     for (int i = file_stat.st_size; i < 1024; ++i) {
       file_content[i] = 0;
     }
+    fclose(fp);
 
     file_stat.st_size = 1024;
 
-    push_obj(&b, filename, 1024, file_content);
-    push_obj(&b, statname, sizeof(struct stat64), (unsigned char *)&file_stat);
+    push_obj(b, filename, 1024, file_content);
+    push_obj(b, statname, sizeof(struct stat64), (unsigned char *)&file_stat);
 
     char *buf = (char *)malloc(1024);
     sprintf(buf, "-sym-stdout");
@@ -255,24 +220,163 @@ int main(int argc, char *argv[]) {
 
   argv_copy[argv_copy_idx] = 0;
 
-  b.numArgs = argv_copy_idx;
-  b.args = argv_copy;
+  b->numArgs = argv_copy_idx;
+  b->args = argv_copy;
 
-  push_range(&b, "model_version", 1);
+  push_range(b, "model_version", 1);
+}
 
-  if (!kTest_toFile(&b, "file.bout"))
-    assert(0);
+static void free_test(KTest *b) {
+  for (int i = 0; i < (int)b->numObjects; ++i) {
+    free(b->objects[i].name);
+    free(b->objects[i].bytes);
+  }
+  free(b->objects);
 
-  for (int i = 0; i < (int)b.numObjects; ++i) {
-    free(b.objects[i].name);
-    free(b.objects[i].bytes);
+  for (int i = 0; i < (int)b->numArgs; ++i) {
+    free(b->args[i]);
   }
-  free(b.objects);
+  free(b->args);
+}
 
-  for (int i = 0; i < (int)argv_copy_idx; ++i) {
-    free(argv_copy[i]);
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Appends a test case for each regular file of corpus_dir, in the order of
+   their names, to file.ktests. */
+static void gen_corpus(char *program_name, char **args, unsigned num_args,
+                       const char *corpus_dir, int corpus_is_file,
+                       const char *content_filename,
+                       const char *stdin_content_filename,
+                       const char *stdout_content_filename) {
+  DIR *dir = opendir(corpus_dir);
+  struct dirent *entry;
+  char **paths = NULL;
+  unsigned num_paths = 0, capacity = 0, i;
+
+  if (!dir) {
+    fprintf(stderr, "Failure opening %s\n", corpus_dir);
+    print_usage_and_exit(program_name);
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    struct stat64 file_stat;
+    char *path = (char *)malloc(strlen(corpus_dir) + strlen(entry->d_name) + 2);
+    sprintf(path, "%s/%s", corpus_dir, entry->d_name);
+    if (stat64(path, &file_stat) < 0 || !S_ISREG(file_stat.st_mode)) {
+      free(path);
+      continue;
+    }
+    if (num_paths == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      paths = (char **)realloc(paths, capacity * sizeof *paths);
+    }
+    paths[num_paths++] = path;
+  }
+  closedir(dir);
+  qsort(paths, num_paths, sizeof *paths, compare_names);
+
+  unlink("file.ktests");
+  KTestWriter *w = kTestWriter_open("file.ktests", 0);
+  if (!w) {
+    fprintf(stderr, "Failure opening file.ktests\n");
+    exit(1);
+  }
+  for (i = 0; i < num_paths; ++i) {
+    KTest b;
+    gen_test(&b, program_name, args, num_args,
+             corpus_is_file ? paths[i] : content_filename,
+             corpus_is_file ? stdin_content_filename : paths[i],
+             stdout_content_filename);
+    if (!kTestWriter_append(w, &b, i + 1))
+      assert(0);
+    free_test(&b);
+    free(paths[i]);
+  }
+  kTestWriter_close(w);
+  free(paths);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned i, num_args = 0;
+  unsigned file_counter = 0;
+  char *stdout_content_filename = NULL;
+  char *stdin_content_filename = NULL;
+  char *content_filenames_list[1024];
+  char *corpus_dir = NULL;
+  int corpus_is_file = 0;
+  char **args;
+
+  if (argc < 2)
+    print_usage_and_exit(argv[0]);
+
+  if ((args = (char **)malloc(sizeof(char *) * argc)) == NULL) {
+    fprintf(stderr, "Could not allocate more memory\n");
+    return 1;
+  }
+
+  for (i = 1; i < (unsigned)argc; i++) {
+    if (strcmp(argv[i], "--sym-stdout") == 0 ||
+        strcmp(argv[i], "-sym-stdout") == 0) {
+      if (++i == (unsigned)argc || argv[i][0] == '-')
+        print_usage_and_exit(argv[0]);
+
+      if (stdout_content_filename)
+        print_usage_and_exit(argv[0]);
+
+      stdout_content_filename = argv[i];
+
+    } else if (strcmp(argv[i], "--sym-stdin") == 0 ||
+               strcmp(argv[i], "-sym-stdin") == 0) {
+      if (++i == (unsigned)argc || argv[i][0] == '-')
+        print_usage_and_exit(argv[0]);
+
+      if (stdin_content_filename)
+        print_usage_and_exit(argv[0]);
+
+      stdin_content_filename = argv[i];
+    } else if (strcmp(argv[i], "--sym-file") == 0 ||
+               strcmp(argv[i], "-sym-file") == 0) {
+      if (++i == (unsigned)argc || argv[i][0] == '-')
+        print_usage_and_exit(argv[0]);
+
+      content_filenames_list[file_counter++] = argv[i];
+    } else if (strcmp(argv[i], "--corpus-stdin") == 0 ||
+               strcmp(argv[i], "--corpus-file") == 0) {
+      corpus_is_file = strcmp(argv[i], "--corpus-file") == 0;
+      if (++i == (unsigned)argc || argv[i][0] == '-')
+        print_usage_and_exit(argv[0]);
+
+      if (corpus_dir)
+        print_usage_and_exit(argv[0]);
+
+      corpus_dir = argv[i];
+    } else {
+      args[num_args++] = argv[i];
+    }
+  }
+
+  char *content_filename =
+      file_counter > 0 ? content_filenames_list[file_counter - 1] : NULL;
+
+  if (corpus_dir) {
+    if (corpus_is_file ? content_filename != NULL
+                       : stdin_content_filename != NULL)
+      print_usage_and_exit(argv[0]);
+    gen_corpus(argv[0], args, num_args, corpus_dir, corpus_is_file,
+               content_filename, stdin_content_filename,
+               stdout_content_filename);
+  } else {
+    KTest b;
+    gen_test(&b, argv[0], args, num_args, content_filename,
+             stdin_content_filename, stdout_content_filename);
+
+    if (!kTest_toFile(&b, "file.bout"))
+      assert(0);
+
+    free_test(&b);
   }
-  free(argv_copy);
+  free(args);
 
   return 0;
 }
@@ -17,21 +17,36 @@
 #include "klee/ExprBuilder.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/OptionCategories.h"
+#include "klee/QueryLog.h"
 #include "klee/Solver.h"
 #include "klee/SolverCmdLine.h"
 #include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/Statistics.h"
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/Support/Timer.h"
+#include "klee/Internal/System/NUMA.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprSMTLIBPrinter.h"
+#include "klee/util/ArrayCache.h"
 #include "klee/util/ExprVisitor.h"
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 
@@ -46,7 +61,14 @@ llvm::cl::opt<std::string> InputFile(llvm::cl::desc("<input query log>"),
                                      llvm::cl::Positional, llvm::cl::init("-"),
                                      llvm::cl::cat(klee::ExprCat));
 
-enum ToolActions { PrintTokens, PrintAST, PrintSMTLIBv2, Evaluate };
+enum ToolActions {
+  PrintTokens,
+  PrintAST,
+  PrintSMTLIBv2,
+  Evaluate,
+  Benchmark,
+  PrintQueryLog
+};
 
 static llvm::cl::opt<ToolActions> ToolAction(
     llvm::cl::desc("Tool actions:"), llvm::cl::init(Evaluate),
@@ -57,7 +79,16 @@ static llvm::cl::opt<ToolActions> ToolAction(
                      clEnumValN(PrintAST, "print-ast",
                                 "Print parsed AST nodes from the input file."),
                      clEnumValN(Evaluate, "evaluate",
-                                "Evaluate parsed AST nodes from the input file.")
+                                "Evaluate parsed AST nodes from the input file."),
+                     clEnumValN(Benchmark, "benchmark",
+                                "Time the queries of the input file through "
+                                "the solver chain and report the results "
+                                "as JSON."),
+                     clEnumValN(PrintQueryLog, "print-query-log",
+                                "Print the binary query log (.kqlog) of "
+                                "--use-query-log=all:bin or solver:bin as "
+                                "KQuery. Evaluate and benchmark also take "
+                                "such logs, which load faster than KQuery.")
                          KLEE_LLVM_CL_VAL_END),
     llvm::cl::cat(klee::SolvingCat));
 
@@ -85,6 +116,23 @@ llvm::cl::opt<std::string> DirectoryToWriteQueryLogs(
         "The folder to write query logs to (default=current directory)"),
     llvm::cl::init("."), llvm::cl::cat(klee::ExprCat));
 
+llvm::cl::opt<unsigned> BenchmarkPasses(
+    "benchmark-passes",
+    llvm::cl::desc("Number of times to replay the queries with --benchmark, "
+                   "through the same solver chain (default=1)"),
+    llvm::cl::init(1), llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> BenchmarkOutput(
+    "benchmark-output",
+    llvm::cl::desc("File to write the --benchmark report to (default=stdout)"),
+    llvm::cl::init("-"), llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Jobs(
+    "j",
+    llvm::cl::desc("Number of processes to evaluate the queries in, each "
+                   "with its own solver chain (default=1)"),
+    llvm::cl::init(1), llvm::cl::cat(klee::SolvingCat));
+
 llvm::cl::opt<bool> ClearArrayAfterQuery(
     "clear-array-decls-after-query",
     llvm::cl::desc("Discard the previous array declarations after a query "
@@ -184,25 +232,55 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
-static bool EvaluateInputAST(const char *Filename,
-                             const MemoryBuffer *MB,
-                             ExprBuilder *Builder) {
-  std::vector<Decl*> Decls;
-  Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
+/// Reads the queries of a binary query log (.kqlog) as the query commands
+/// the parser makes of their KQuery, skipping the parsing. The arrays are
+/// created in the given cache.
+static bool readQueryLog(const char *Filename, const MemoryBuffer *MB,
+                         ExprBuilder *Builder, ArrayCache &Arrays,
+                         std::vector<Decl*> &Decls) {
+  QueryLogReader reader(MB->getBuffer(), Arrays, Builder);
+  LoggedQuery q;
+  while (reader.next(q)) {
+    std::vector<ExprHandle> Values;
+    ExprHandle Query = q.expr;
+    if (q.kind == LoggedQuery::Value) {
+      Values.push_back(q.expr);
+      Query = Builder->False();
+    }
+    Decls.push_back(new QueryCommand(q.constraints, Query, Values, q.objects));
+  }
+  if (!reader.getError().empty()) {
+    llvm::errs() << Filename << ": " << reader.getError() << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// Reads the query commands of a KQuery file or binary query log. The
+/// parser of a KQuery file is returned in \a P, to be deleted after the
+/// commands.
+static bool readInput(const char *Filename, const MemoryBuffer *MB,
+                      ExprBuilder *Builder, ArrayCache &Arrays,
+                      std::vector<Decl*> &Decls, Parser *&P) {
+  P = 0;
+  if (QueryLogReader::isQueryLog(MB->getBuffer()))
+    return readQueryLog(Filename, MB, Builder, Arrays, Decls);
+
+  P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
   P->SetMaxErrors(20);
   while (Decl *D = P->ParseTopLevelDecl()) {
     Decls.push_back(D);
   }
 
-  bool success = true;
   if (unsigned N = P->GetNumErrors()) {
     llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
-    success = false;
-  }  
-
-  if (!success)
     return false;
+  }
+  return true;
+}
 
+/// Creates the solver chain configured by the solver options.
+static Solver *createSolverChain() {
   Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
 
   if (CoreSolverToUse != DUMMY_SOLVER) {
@@ -212,111 +290,526 @@ static bool EvaluateInputAST(const char *Filename,
     }
   }
 
-  Solver *S = constructSolverChain(coreSolver,
-                                   getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
+  return constructSolverChain(coreSolver,
+                              getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_BINARY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_BINARY_FILE_NAME));
+}
 
-  unsigned Index = 0;
-  for (std::vector<Decl*>::iterator it = Decls.begin(),
-         ie = Decls.end(); it != ie; ++it) {
-    Decl *D = *it;
-    if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
-      llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintManager(QC->Constraints), 
-                              QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
+/// Evaluates a query command, printing its result.
+static void evaluateQuery(Solver *S, QueryCommand *QC, llvm::raw_ostream &os) {
+  assert("FIXME: Support counterexample query commands!");
+  if (QC->Values.empty() && QC->Objects.empty()) {
+    bool result;
+    if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
+                      result)) {
+      os << (result ? "VALID" : "INVALID");
+    } else {
+      os << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else if (!QC->Values.empty()) {
+    assert(QC->Objects.empty() && 
+           "FIXME: Support counterexamples for values and objects!");
+    assert(QC->Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(QC->Query->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S->getValue(Query(ConstraintManager(QC->Constraints), 
+                          QC->Values[0]),
+                    result)) {
+      os << "INVALID\n";
+      os << "\tExpr 0:\t" << result;
+    } else {
+      os << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else {
+    std::vector< std::vector<unsigned char> > result;
+    
+    if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
+                                  QC->Query),
+                            QC->Objects, result)) {
+      os << "INVALID\n";
+
+      for (unsigned i = 0, e = result.size(); i != e; ++i) {
+        os << "\tArray " << i << ":\t"
+                   << QC->Objects[i]->name
+                   << "[";
+        for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
+          os << (unsigned) result[i][j];
+          if (j + 1 != QC->Objects[i]->size)
+            os << ", ";
         }
-      } else {
-        std::vector< std::vector<unsigned char> > result;
-        
-        if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
-                                      QC->Query),
-                                QC->Objects, result)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = result.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result[i][j];
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
+        os << "]";
+        if (i + 1 != e)
+          os << "\n";
+      }
+    } else {
+      SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
+      if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+        os << " FAIL (reason: "
+                  << SolverImpl::getOperationStatusString(retCode)
+                  << ")";
+      }           
+      else {
+        os << "VALID (counterexample request ignored)";
+      }
+    }
+  }
+
+}
+
+/// The statistics summed up after the results.
+static const char *const SummaryStatistics[] = {
+    "Queries", "QueriesConstructs", "QueriesValid", "QueriesInvalid",
+    "QueriesCEX"};
+static const unsigned NumSummaryStatistics =
+    sizeof(SummaryStatistics) / sizeof(SummaryStatistics[0]);
+
+static bool readFully(int fd, void *buffer, size_t size) {
+  char *p = static_cast<char *>(buffer);
+  while (size) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool writeFully(int fd, const void *buffer, size_t size) {
+  const char *p = static_cast<const char *>(buffer);
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/// Evaluates the queries in one process of -j, taking the next query not
+/// taken by another from \a next, and writing the result of each to \a
+/// fd as its index, evaluation microseconds, length and text. The
+/// statistics follow under an index past the queries.
+static void runEvaluationWorker(const std::vector<QueryCommand *> &Queries,
+                                std::atomic<size_t> *next, int fd) {
+  Solver *S = createSolverChain();
+  for (;;) {
+    uint64_t header[3] = {next->fetch_add(1), 0, 0};
+    if (header[0] >= Queries.size())
+      break;
+    std::string result;
+    llvm::raw_string_ostream os(result);
+    WallTimer timer;
+    evaluateQuery(S, Queries[header[0]], os);
+    os.flush();
+    header[1] = timer.check().toMicroseconds();
+    header[2] = result.size();
+    if (!writeFully(fd, header, sizeof(header)) ||
+        !writeFully(fd, result.data(), result.size()))
+      _exit(1);
+  }
+  delete S;
+
+  uint64_t stats[NumSummaryStatistics + 1] = {Queries.size()};
+  for (unsigned i = 0; i != NumSummaryStatistics; ++i)
+    stats[i + 1] = *theStatisticManager->getStatisticByName(
+        SummaryStatistics[i]);
+  writeFully(fd, stats, sizeof(stats));
+  _exit(0);
+}
+
+/// Evaluates the queries in -j processes forked now, each with its solver
+/// chain, which take the queries as they become idle. The results are
+/// printed in the order of the queries as soon as all before them are.
+static bool evaluateInParallel(const std::vector<QueryCommand *> &Queries,
+                               uint64_t stats[], uint64_t &queryTime) {
+  void *shared = mmap(nullptr, sizeof(std::atomic<size_t>),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+                      0);
+  if (shared == MAP_FAILED) {
+    llvm::errs() << "error: mmap: " << strerror(errno) << "\n";
+    return false;
+  }
+  std::atomic<size_t> *next = new (shared) std::atomic<size_t>(0);
+
+  llvm::outs().flush();
+  std::vector<pid_t> workers;
+  std::vector<int> fds;
+  for (unsigned i = 0; i != Jobs; ++i) {
+    int pipefd[2];
+    if (pipe(pipefd) != 0)
+      break;
+    pid_t pid = fork();
+    if (pid == 0) {
+      for (int fd : fds)
+        close(fd);
+      close(pipefd[0]);
+      numa::placeWorker(i);
+      runEvaluationWorker(Queries, next, pipefd[1]);
+    }
+    close(pipefd[1]);
+    if (pid < 0) {
+      close(pipefd[0]);
+      break;
+    }
+    workers.push_back(pid);
+    fds.push_back(pipefd[0]);
+  }
+  if (workers.empty()) {
+    llvm::errs() << "error: could not fork the evaluation processes\n";
+    munmap(shared, sizeof(std::atomic<size_t>));
+    return false;
+  }
+
+  // each process writes its results in turn, so they are read in turn
+  std::vector<std::string> results(Queries.size());
+  std::vector<bool> done(Queries.size());
+  std::vector<pollfd> pending;
+  for (int fd : fds)
+    pending.push_back({fd, POLLIN, 0});
+  size_t printed = 0;
+  bool success = true;
+  while (!pending.empty()) {
+    if (poll(pending.data(), pending.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    for (size_t i = 0; i != pending.size();) {
+      if (!pending[i].revents) {
+        ++i;
+        continue;
+      }
+      uint64_t header[3];
+      int fd = pending[i].fd;
+      bool ok = readFully(fd, header, sizeof(header[0]));
+      if (ok && header[0] < Queries.size()) {
+        ok = readFully(fd, header + 1, sizeof(header) - sizeof(header[0]));
+        std::string &result = results[header[0]];
+        result.resize(ok ? header[2] : 0);
+        if (ok && readFully(fd, &result[0], result.size())) {
+          done[header[0]] = true;
+          queryTime += header[1];
+          ++i;
+          continue;
         }
+      } else if (ok) {
+        // the statistics, after all the results of the process
+        uint64_t values[NumSummaryStatistics];
+        if (readFully(fd, values, sizeof(values)))
+          for (unsigned j = 0; j != NumSummaryStatistics; ++j)
+            stats[j] += values[j];
       }
+      close(fd);
+      pending.erase(pending.begin() + i);
+    }
+
+    for (; printed != Queries.size() && done[printed]; ++printed)
+      llvm::outs() << "Query " << printed << ":\t" << results[printed]
+                   << "\n";
+    llvm::outs().flush();
+  }
 
-      llvm::outs() << "\n";
-      ++Index;
+  for (pid_t pid : workers) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+  munmap(shared, sizeof(std::atomic<size_t>));
+
+  // the queries of a process which died
+  for (; printed != Queries.size(); ++printed) {
+    if (done[printed]) {
+      llvm::outs() << "Query " << printed << ":\t" << results[printed] << "\n";
+    } else {
+      llvm::outs() << "Query " << printed
+                   << ":\tFAIL (reason: evaluation process died)\n";
+      success = false;
     }
   }
+  return success;
+}
+
+static bool EvaluateInputAST(const char *Filename,
+                             const MemoryBuffer *MB,
+                             ExprBuilder *Builder) {
+  std::vector<Decl*> Decls;
+  ArrayCache Arrays;
+  Parser *P;
+  bool success = readInput(Filename, MB, Builder, Arrays, Decls, P);
+
+  if (!success)
+    return false;
+
+  uint64_t stats[NumSummaryStatistics] = {0};
+  uint64_t queryTime = 0;
+  WallTimer total;
+  if (Jobs > 1) {
+    if (QueryLoggingOptions.getBits()) {
+      llvm::errs() << "error: queries cannot be logged with -j\n";
+      return false;
+    }
+    std::vector<QueryCommand *> Queries;
+    for (Decl *D : Decls)
+      if (QueryCommand *QC = dyn_cast<QueryCommand>(D))
+        Queries.push_back(QC);
+    success = evaluateInParallel(Queries, stats, queryTime);
+  } else {
+    Solver *S = createSolverChain();
+
+    unsigned Index = 0;
+    for (std::vector<Decl*>::iterator it = Decls.begin(),
+           ie = Decls.end(); it != ie; ++it) {
+      Decl *D = *it;
+      if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
+        llvm::outs() << "Query " << Index << ":\t";
+        evaluateQuery(S, QC, llvm::outs());
+        llvm::outs() << "\n";
+        ++Index;
+      }
+    }
+
+    delete S;
+    for (unsigned i = 0; i != NumSummaryStatistics; ++i)
+      stats[i] = *theStatisticManager->getStatisticByName(SummaryStatistics[i]);
+  }
 
   for (std::vector<Decl*>::iterator it = Decls.begin(),
          ie = Decls.end(); it != ie; ++it)
     delete *it;
   delete P;
 
-  delete S;
-
-  if (uint64_t queries = *theStatisticManager->getStatisticByName("Queries")) {
+  if (uint64_t queries = stats[0]) {
     llvm::outs()
       << "--\n"
       << "total queries = " << queries << "\n"
-      << "total queries constructs = " 
-      << *theStatisticManager->getStatisticByName("QueriesConstructs") << "\n"
-      << "valid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesValid") << "\n"
-      << "invalid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesInvalid") << "\n"
-      << "query cex = " 
-      << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
+      << "total queries constructs = " << stats[1] << "\n"
+      << "valid queries = " << stats[2] << "\n"
+      << "invalid queries = " << stats[3] << "\n"
+      << "query cex = " << stats[4] << "\n";
+  }
+  if (Jobs > 1) {
+    // the evaluation time summed over the processes, against the elapsed
+    llvm::outs()
+      << "evaluation time = "
+      << format("%.3f", (double)queryTime / 1000000) << " s\n"
+      << "wall time = "
+      << format("%.3f", (double)total.check().toMicroseconds() / 1000000)
+      << " s (" << Jobs << " processes)\n";
   }
 
   return success;
 }
 
+/// Runs a query command without printing the result, returning whether the
+/// solver succeeded.
+static bool runQuery(Solver *S, QueryCommand *QC) {
+  ConstraintManager constraints(QC->Constraints);
+  if (QC->Values.empty() && QC->Objects.empty()) {
+    bool result;
+    return S->mustBeTrue(Query(constraints, QC->Query), result);
+  }
+  if (!QC->Values.empty()) {
+    ref<ConstantExpr> result;
+    return S->getValue(Query(constraints, QC->Values[0]), result);
+  }
+  std::vector<std::vector<unsigned char> > result;
+  if (S->getInitialValues(Query(constraints, QC->Query), QC->Objects, result))
+    return true;
+  // a valid query has no counterexample, which is not a failure
+  return S->impl->getOperationStatusCode() != SolverImpl::SOLVER_RUN_STATUS_TIMEOUT;
+}
+
+/// Returns the given percentile of the sorted latencies.
+static uint64_t getPercentile(const std::vector<uint64_t> &sorted,
+                              unsigned percent) {
+  if (sorted.empty())
+    return 0;
+  size_t index = (sorted.size() * percent + 99) / 100;
+  return sorted[index ? index - 1 : 0];
+}
+
+static void printLayer(llvm::raw_ostream &os, const char *name,
+                       uint64_t hits, uint64_t misses, bool last = false) {
+  os << "    \"" << name << "\": {\"hits\": " << hits
+     << ", \"misses\": " << misses << ", \"hit-rate\": ";
+  if (hits + misses)
+    os << format("%.4f", (double)hits / (hits + misses));
+  else
+    os << "null";
+  os << (last ? "}\n" : "},\n");
+}
+
+/// Replays the queries through the solver chain configured by the solver
+/// options, and reports the throughput, the latency distribution and the
+/// hits of the caching layers as JSON, for comparing solver configurations
+/// or changes to the solver chain on a corpus of logged queries.
+static bool benchmarkInputAST(const char *Filename,
+                              const MemoryBuffer *MB,
+                              ExprBuilder *Builder) {
+  std::vector<Decl*> Decls;
+  ArrayCache Arrays;
+  Parser *P;
+  if (!readInput(Filename, MB, Builder, Arrays, Decls, P)) {
+    for (Decl *D : Decls)
+      delete D;
+    delete P;
+    return false;
+  }
+
+  std::string error;
+  std::unique_ptr<llvm::raw_fd_ostream> os =
+      klee_open_output_file(BenchmarkOutput, error);
+  if (!os) {
+    llvm::errs() << "error: " << error << "\n";
+    for (Decl *D : Decls)
+      delete D;
+    delete P;
+    return false;
+  }
+
+  Solver *S = createSolverChain();
+
+  std::vector<uint64_t> latencies;
+  uint64_t failures = 0;
+  WallTimer total;
+  for (unsigned pass = 0; pass != BenchmarkPasses; ++pass) {
+    for (Decl *D : Decls) {
+      QueryCommand *QC = dyn_cast<QueryCommand>(D);
+      if (!QC)
+        continue;
+      WallTimer timer;
+      if (!runQuery(S, QC))
+        ++failures;
+      latencies.push_back(timer.check().toMicroseconds());
+    }
+  }
+  double seconds = (double)total.check().toMicroseconds() / 1000000;
+  delete S;
+
+  std::vector<uint64_t> sorted(latencies);
+  std::sort(sorted.begin(), sorted.end());
+  uint64_t sum = 0;
+  for (uint64_t latency : latencies)
+    sum += latency;
+
+  *os << "{\n"
+      << "  \"input\": \"" << escapedString(Filename, strlen(Filename))
+      << "\",\n"
+      << "  \"passes\": " << BenchmarkPasses << ",\n"
+      << "  \"queries\": " << latencies.size() << ",\n"
+      << "  \"failures\": " << failures << ",\n"
+      << "  \"seconds\": " << format("%.6f", seconds) << ",\n"
+      << "  \"queries-per-second\": "
+      << format("%.2f", seconds ? latencies.size() / seconds : 0.0) << ",\n"
+      << "  \"latency-us\": {\"mean\": "
+      << (latencies.empty() ? 0 : sum / latencies.size())
+      << ", \"p50\": " << getPercentile(sorted, 50)
+      << ", \"p90\": " << getPercentile(sorted, 90)
+      << ", \"p99\": " << getPercentile(sorted, 99)
+      << ", \"max\": " << (sorted.empty() ? 0 : sorted.back()) << "},\n"
+      << "  \"core-solver-queries\": " << stats::queries << ",\n"
+      << "  \"layers\": {\n";
+  printLayer(*os, "independent-factor-cache", stats::queryFactorCacheHits,
+             stats::queryFactorCacheMisses);
+  printLayer(*os, "branch-cache", stats::queryCacheHits,
+             stats::queryCacheMisses);
+  printLayer(*os, "known-bits", stats::queryKnownBitsHits,
+             stats::queryKnownBitsMisses);
+  printLayer(*os, "cex-cache", stats::queryCexCacheHits,
+             stats::queryCexCacheMisses);
+  printLayer(*os, "shared-cache", stats::querySharedCacheHits,
+             stats::querySharedCacheMisses);
+  printLayer(*os, "persistent-cache", stats::queryPersistentCacheHits,
+             stats::queryPersistentCacheMisses, true);
+  *os << "  }\n"
+      << "}\n";
+
+  for (Decl *D : Decls)
+    delete D;
+  delete P;
+  return true;
+}
+
+/// Prints the queries of a binary query log as KQueryLoggingSolver would
+/// have logged them.
+static bool printQueryLog(const char *Filename, const MemoryBuffer *MB,
+                          ExprBuilder *Builder) {
+  ArrayCache arrays;
+  QueryLogReader reader(MB->getBuffer(), arrays, Builder);
+  llvm::raw_ostream &os = llvm::outs();
+
+  LoggedQuery q;
+  while (reader.next(q)) {
+    os << "# Query " << q.number << " -- "
+       << "Type: " << q.getKindName() << ", "
+       << "Instructions: " << q.instructions << "\n";
+
+    ConstraintManager constraints(q.constraints);
+    Query query(constraints, q.expr);
+    if (q.kind == LoggedQuery::Value) {
+      Query withFalse = query.withFalse();
+      ExprPPrinter::printQuery(os, withFalse.constraints, withFalse.expr,
+                               &query.expr, &query.expr + 1);
+    } else {
+      const Array *const *objects = q.objects.empty() ? 0 : &q.objects[0];
+      ExprPPrinter::printQuery(os, query.constraints, query.expr, 0, 0,
+                               objects, objects + q.objects.size());
+    }
+
+    os << "#   " << (q.success ? "OK" : "FAIL") << " -- "
+       << "Elapsed: " << q.elapsed << "\n";
+    if (!q.success) {
+      os << "#   Failure reason: "
+         << SolverImpl::getOperationStatusString(q.status) << "\n";
+    } else {
+      switch (q.kind) {
+      case LoggedQuery::Truth:
+        os << "#   Is Valid: " << (q.isValid ? "true" : "false") << "\n";
+        break;
+      case LoggedQuery::Validity:
+        os << "#   Validity: " << q.validity << "\n";
+        break;
+      case LoggedQuery::Value:
+        os << "#   Result: " << q.value << "\n";
+        break;
+      case LoggedQuery::InitialValues:
+        os << "#   Solvable: " << (q.hasSolution ? "true" : "false") << "\n";
+        for (unsigned i = 0; i != q.values.size() && i != q.objects.size();
+             ++i) {
+          os << "#     " << q.objects[i]->name << " = [";
+          for (unsigned j = 0; j != q.values[i].size(); ++j)
+            os << (j ? "," : "") << (int)q.values[i][j];
+          os << "]\n";
+        }
+        break;
+      }
+    }
+    os << "\n";
+  }
+
+  if (!reader.getError().empty()) {
+    llvm::errs() << Filename << ": " << reader.getError() << "\n";
+    return false;
+  }
+  return true;
+}
+
 static bool printInputAsSMTLIBv2(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder)
@@ -440,6 +933,14 @@ int main(int argc, char **argv) {
     success = EvaluateInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
                                MB.get(), Builder);
     break;
+  case Benchmark:
+    success = benchmarkInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
+                                MB.get(), Builder);
+    break;
+  case PrintQueryLog:
+    success = printQueryLog(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
+                            MB.get(), Builder);
+    break;
   case PrintSMTLIBv2:
     success = printInputAsSMTLIBv2(InputFile=="-"? "<stdin>" : InputFile.c_str(), MB.get(),Builder);
     break;
@@ -0,0 +1,64 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Converts the run.istats.bin written with --istats-format=binary to the
+// callgrind format of run.istats, as of its last complete dump.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/Version.h"
+#include "klee/Internal/Support/BinaryIStats.h"
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/Support/PrintVersion.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+cl::opt<std::string> InputFile(cl::desc("<run.istats.bin>"), cl::Positional,
+                               cl::Required);
+
+cl::opt<std::string>
+    OutputFile("o", cl::desc("Output file, or - for standard output "
+                             "(default=-)"),
+               cl::value_desc("filename"), cl::init("-"));
+} // namespace
+
+int main(int argc, char **argv) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+#else
+  llvm::sys::PrintStackTraceOnErrorSignal();
+#endif
+  cl::SetVersionPrinter(klee::printVersion);
+  cl::ParseCommandLineOptions(argc, argv, " klee-istats\n");
+
+  istats::BinaryReader reader;
+  std::string error;
+  if (!reader.read(InputFile, error)) {
+    errs() << argv[0] << ": error: " << InputFile << ": " << error << "\n";
+    return 1;
+  }
+
+  if (OutputFile == "-") {
+    reader.writeCallgrind(outs());
+    return 0;
+  }
+  auto os = klee_open_output_file(OutputFile, error);
+  if (!os) {
+    errs() << argv[0] << ": error: " << OutputFile << ": " << error << "\n";
+    return 1;
+  }
+  reader.writeCallgrind(*os);
+  return 0;
+}
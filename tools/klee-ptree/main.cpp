@@ -0,0 +1,52 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Summarizes the ptree.bin written with --write-ptree-log: the depths the
+// states were forked and removed at, and the fork sites splitting the most.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/Version.h"
+#include "klee/Internal/Support/PTreeLog.h"
+#include "klee/Internal/Support/PrintVersion.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+cl::opt<std::string> InputFile(cl::desc("<ptree.bin>"), cl::Positional,
+                               cl::Required);
+
+cl::opt<unsigned> Top("top",
+                      cl::desc("Number of fork sites to print (default=10)"),
+                      cl::init(10));
+} // namespace
+
+int main(int argc, char **argv) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 9)
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+#else
+  llvm::sys::PrintStackTraceOnErrorSignal();
+#endif
+  cl::SetVersionPrinter(klee::printVersion);
+  cl::ParseCommandLineOptions(argc, argv, " klee-ptree\n");
+
+  ptreelog::Reader reader;
+  std::string error;
+  if (!reader.read(InputFile, error)) {
+    errs() << argv[0] << ": error: " << InputFile << ": " << error << "\n";
+    return 1;
+  }
+  reader.print(outs(), Top);
+  return 0;
+}
@@ -447,7 +447,15 @@ void replay_create_files(exe_file_system_t *exe_fs) {
   umask(0);
   for (k=0; k < exe_fs->n_sym_files; k++) {
     char name[2];
+    char data_name[7];
     sprintf(name, "%c", 'A' + k);
+    /* files made on their first use are only in the tests which used them */
+    if (!exe_fs->sym_files[k].stat) {
+      sprintf(data_name, "%c-data", 'A' + k);
+      if (!replay_has_object(data_name))
+        continue;
+      __fd_init_sym_file(k);
+    }
     create_file(-1, name, &exe_fs->sym_files[k], tmpdir);
   }
 
@@ -464,7 +472,8 @@ void replay_create_files(exe_file_system_t *exe_fs) {
     check_file(__STDOUT, exe_fs->sym_stdout);
 
   for (k=0; k<exe_fs->n_sym_files; ++k)
-    check_file(k, &exe_fs->sym_files[k]);
+    if (exe_fs->sym_files[k].stat)
+      check_file(k, &exe_fs->sym_files[k]);
 }
 
 static void check_file(int index, exe_disk_file_t *dfile) {
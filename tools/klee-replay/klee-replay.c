@@ -256,6 +256,7 @@ void ensure_capsyschroot(const char *executable) {
 
 static void usage(void) {
   fprintf(stderr, "Usage: %s [option]... <executable> <ktest-file>...\n", progname);
+  fprintf(stderr, "       (a .ktests container replays all of its test cases)\n");
   fprintf(stderr, "   or: %s --create-files-only <ktest-file>\n", progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n");
@@ -265,6 +266,59 @@ static void usage(void) {
   exit(1);
 }
 
+/* Runs the program on input, the test case read from name. */
+static void replay_test_case(char *executable, char *program,
+                             const char *name) {
+  static int first = 1;
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  prg_argv[0] = program;
+  klee_init_env(&prg_argc, &prg_argv);
+
+  if (!first)
+    fprintf(stderr, "\n");
+  first = 0;
+  fprintf(stderr, "%s: TEST CASE: %s\n", progname, name);
+  fprintf(stderr, "%s: ARGS: ", progname);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]);
+  }
+  fprintf(stderr, "\n");
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Create the input files, pipes, etc., and run the process. */
+    replay_create_files(&__exe_fs);
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the test case. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   int prg_argc;
   char ** prg_argv;
@@ -334,7 +388,33 @@ int main(int argc, char** argv) {
   int idx = 0;
   for (idx = optind + 1; idx != argc; ++idx) {
     char* input_fname = argv[idx];
-    unsigned i;
+
+    /* Replay each test case of a .ktests container in turn. */
+    if (kTest_isKTestContainer(input_fname)) {
+      KTestReader *reader = kTestReader_open(input_fname);
+      unsigned i, n;
+      if (!reader) {
+        fprintf(stderr, "%s: error: input file %s not valid.\n", progname,
+                input_fname);
+        exit(1);
+      }
+      for (i = 0, n = kTestReader_numTests(reader); i != n; ++i) {
+        size_t size = strlen(input_fname) + 16;
+        char *name = malloc(size);
+        snprintf(name, size, "%s:%u", input_fname,
+                 kTestReader_getId(reader, i));
+        input = kTestReader_get(reader, i);
+        if (!input) {
+          fprintf(stderr, "%s: error: test case %s not valid.\n", progname,
+                  name);
+          exit(1);
+        }
+        replay_test_case(executable, argv[optind], name);
+        free(name);
+      }
+      kTestReader_close(reader);
+      continue;
+    }
 
     input = kTest_fromFile(input_fname);
     if (!input) {
@@ -342,49 +422,7 @@ int main(int argc, char** argv) {
               input_fname);
       exit(1);
     }
-
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    prg_argv[0] = argv[optind];
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fprintf(stderr, "\n");
-    fprintf(stderr, "%s: TEST CASE: %s\n", progname, input_fname);
-    fprintf(stderr, "%s: ARGS: ", progname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]);
-    }
-    fprintf(stderr, "\n");
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Create the input files, pipes, etc., and run the process. */
-      replay_create_files(&__exe_fs);
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the test case. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-    }
+    replay_test_case(executable, argv[optind], input_fname);
   }
 
   return 0;
@@ -432,7 +470,30 @@ void klee_posix_prefer_cex(void *buffer, uintptr_t condition) {
   ;
 }
 
+int replay_has_object(const char *name) {
+  unsigned i;
+  for (i = 0; i < input->numObjects; ++i)
+    if (strcmp(input->objects[i].name, name) == 0)
+      return 1;
+  return 0;
+}
+
 void klee_make_symbolic(void *addr, size_t nbytes, const char *name) {
+  unsigned i;
+
+  /* The files made on their first use come in the order the program used
+     them, after the objects of klee_init_env. */
+  if (obj_index < input->numObjects &&
+      strcmp(input->objects[obj_index].name, name) != 0) {
+    for (i = obj_index + 1; i < input->numObjects; ++i) {
+      KTestObject *obj = &input->objects[i];
+      if (strcmp(obj->name, name) == 0 && obj->numBytes == nbytes) {
+        memcpy(addr, obj->bytes, nbytes);
+        return;
+      }
+    }
+  }
+
   /* XXX remove model version code once new tests gen'd */
   if (obj_index >= input->numObjects) {
     if (strcmp("model_version", name) == 0) {
@@ -20,6 +20,9 @@
 
 void replay_create_files(exe_file_system_t *exe_fs);
 
+/* Returns 1 if the test case has an object named name */
+int replay_has_object(const char *name);
+
 void process_status(int status,
 		    time_t elapsed,
 		    const char *pfx)
@@ -12,6 +12,7 @@
 #include "klee/Config/Version.h"
 #include "klee/ExecutionState.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/BranchPath.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/TreeStream.h"
 #include "klee/Internal/Support/Debug.h"
@@ -19,6 +20,7 @@
 #include "klee/Internal/Support/FileHandling.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/Support/PrintVersion.h"
+#include "klee/Internal/Support/Trace.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Interpreter.h"
 #include "klee/OptionCategories.h"
@@ -60,6 +62,7 @@
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <set>
 #include <sstream>
 
 
@@ -86,6 +89,33 @@ namespace {
             cl::desc("Do not generate any test files (default=false)"),
             cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  WriteKTestContainer("write-ktest-container",
+                      cl::init(false),
+                      cl::desc("Append the test data of all test cases to a "
+                               "single tests.ktests container instead of "
+                               "writing a .ktest file for each (default=false)"),
+                      cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  CompressKTestContainer("compress-ktest-container",
+                         cl::init(false),
+                         cl::desc("Compress the test cases written to the "
+                                  "--write-ktest-container container, if "
+                                  "built with zlib (default=false)"),
+                         cl::cat(TestCaseCat));
+
+  cl::opt<unsigned>
+  TestCaseWorkers("test-case-workers",
+                  cl::init(0),
+                  cl::desc("Solve for and write test cases in up to this "
+                           "many worker processes, each forked with a copy of "
+                           "the terminated state, so that exploration goes on "
+                           "meanwhile. Exploration waits while all are busy. "
+                           "Not used with --write-ktest-container "
+                           "(default=0 (off))"),
+                  cl::cat(TestCaseCat));
+
   cl::opt<bool>
   WriteCVCs("write-cvcs",
             cl::desc("Write .cvc files for each test case (default=false)"),
@@ -116,6 +146,12 @@ namespace {
              cl::desc("Write .path files for each test case (default=false)"),
              cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  PackPaths("pack-paths",
+            cl::desc("Write .path files in the packed binary format, which "
+                     "--replay-path also reads (default=false)"),
+            cl::cat(TestCaseCat));
+
   cl::opt<bool>
   WriteSymPaths("write-sym-paths",
                 cl::desc("Write .sym.path files for each test case (default=false)"),
@@ -133,6 +169,15 @@ namespace {
              cl::init("main"),
              cl::cat(StartCat));
 
+  cl::list<std::string> LibraryEntryPoints(
+      "library-entry-points", cl::CommaSeparated,
+      cl::desc("Explore each of these functions in turn instead of the entry "
+               "point, from one prepared module and one state with the "
+               "globals initialized. Each takes at most the arguments of "
+               "main, and is called directly, hence neither libc nor the "
+               "POSIX runtime start-up code runs (default=off)"),
+      cl::value_desc("function,..."), cl::cat(StartCat));
+
   cl::opt<std::string>
   RunInDir("run-in-dir",
            cl::desc("Change to the given directory before starting execution (default=location of tested file)."),
@@ -155,6 +200,14 @@ namespace {
 		 cl::init(false),
                  cl::cat(StartCat));
 
+  cl::opt<std::string>
+  ModuleCacheDir("module-cache-dir",
+                 cl::desc("Keep the prepared module in this directory, keyed "
+                          "by the loaded bitcode and the command line, and "
+                          "skip linking and optimising it when run again on "
+                          "the same input (default=off)"),
+                 cl::cat(StartCat));
+
   cl::opt<bool>
   WarnAllExternals("warn-all-external-symbols",
                    cl::desc("Issue a warning on startup for all external symbols (default=false)."),
@@ -252,16 +305,25 @@ namespace {
                  cl::value_desc("path file"),
                  cl::cat(ReplayCat));
 
+  cl::opt<bool>
+  ReplayPathPrefix("replay-path-prefix",
+                   cl::desc("Treat the --replay-path file as a prefix: follow "
+                            "its branch decisions, then explore the subtree "
+                            "below it normally (default=false)"),
+                   cl::init(false),
+                   cl::cat(ReplayCat));
+
 
 
   cl::list<std::string>
   SeedOutFile("seed-file",
-              cl::desc(".ktest file to be used as seed"),
+              cl::desc(".ktest file or .ktests container to be used as seed"),
               cl::cat(SeedingCat));
 
   cl::list<std::string>
   SeedOutDir("seed-dir",
-             cl::desc("Directory with .ktest files to be used as seeds"),
+             cl::desc("Directory with .ktest files or .ktests containers "
+                      "to be used as seeds"),
              cl::cat(SeedingCat));
 
   cl::opt<unsigned>
@@ -301,6 +363,8 @@ class KleeHandler : public InterpreterHandler {
 private:
   Interpreter *m_interpreter;
   TreeStreamWriter *m_pathWriter, *m_symPathWriter;
+  KTestWriter *m_kTestWriter; // tests.ktests, for --write-ktest-container
+  std::vector<pid_t> m_testCaseWorkers; // for --test-case-workers
   std::unique_ptr<llvm::raw_ostream> m_infoFile;
 
   SmallString<128> m_outputDirectory;
@@ -329,23 +393,45 @@ public:
                        const char *errorMessage,
                        const char *errorSuffix);
 
+  /// Writes the files of a test case, returning whether its .ktest was
+  /// written.
+  bool writeTestCase(const ExecutionState &state, const char *errorMessage,
+                     const char *errorSuffix, unsigned id);
+
+  /// Forks a worker to write a test case if --test-case-workers allows,
+  /// returning false if this process should write it. The worker returns
+  /// with no workers of its own.
+  bool forkTestCaseWorker();
+
+  /// Counts the test cases of finished workers, waiting for one if block.
+  void reapTestCaseWorkers(bool block);
+
+  /// Waits until all test cases handed to workers are written.
+  void waitForTestCases();
+
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream> openOutputFile(const std::string &filename);
   std::string getTestFilename(const std::string &suffix, unsigned id);
   std::unique_ptr<llvm::raw_fd_ostream> openTestFile(const std::string &suffix, unsigned id);
 
   // load a .path file
-  static void loadPathFile(std::string name,
-                           std::vector<bool> &buffer);
+  static void loadPathFile(std::string name, BranchPath &buffer);
 
   static void getKTestFilesInDir(std::string directoryPath,
                                  std::vector<std::string> &results);
 
+  // load the tests of a .ktest file or a .ktests container, whose tests
+  // stay owned by its reader in containers
+  static bool loadKTests(const std::string &path, std::vector<KTest *> &tests,
+                         std::vector<KTestReader *> &containers);
+  static void freeKTests(std::vector<KTest *> &tests,
+                         std::vector<KTestReader *> &containers);
+
   static std::string getRunTimeLibraryPath(const char *argv0);
 };
 
 KleeHandler::KleeHandler(int argc, char **argv)
-    : m_interpreter(0), m_pathWriter(0), m_symPathWriter(0),
+    : m_interpreter(0), m_pathWriter(0), m_symPathWriter(0), m_kTestWriter(0),
       m_outputDirectory(), m_numTotalTests(0), m_numGeneratedTests(0),
       m_pathsExplored(0), m_argc(argc), m_argv(argv) {
 
@@ -412,11 +498,22 @@ KleeHandler::KleeHandler(int argc, char **argv)
 
   // open info
   m_infoFile = openOutputFile("info");
+
+  if (WriteKTestContainer) {
+    file_path = getOutputFilename("tests.ktests");
+    m_kTestWriter =
+        kTestWriter_open(file_path.c_str(), CompressKTestContainer);
+    if (!m_kTestWriter)
+      klee_error("cannot open file \"%s\": %s", file_path.c_str(),
+                 strerror(errno));
+  }
 }
 
 KleeHandler::~KleeHandler() {
   delete m_pathWriter;
   delete m_symPathWriter;
+  if (m_kTestWriter)
+    kTestWriter_close(m_kTestWriter);
   fclose(klee_warning_file);
   fclose(klee_message_file);
 }
@@ -474,90 +571,35 @@ KleeHandler::openTestFile(const std::string &suffix, unsigned id) {
 void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorMessage,
                                   const char *errorSuffix) {
+  KLEE_TRACE_SCOPE("KleeHandler::processTestCase");
   if (!WriteNone) {
-    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
-    bool success = m_interpreter->getSymbolicSolution(state, out);
-
-    if (!success)
-      klee_warning("unable to get symbolic solution, losing test case");
-
-    const auto start_time = time::getWallTime();
-
     unsigned id = ++m_numTotalTests;
 
-    if (success) {
-      KTest b;
-      b.numArgs = m_argc;
-      b.args = m_argv;
-      b.symArgvs = 0;
-      b.symArgvLen = 0;
-      b.numObjects = out.size();
-      b.objects = new KTestObject[b.numObjects];
-      assert(b.objects);
-      for (unsigned i=0; i<b.numObjects; i++) {
-        KTestObject *o = &b.objects[i];
-        o->name = const_cast<char*>(out[i].first.c_str());
-        o->numBytes = out[i].second.size();
-        o->bytes = new unsigned char[o->numBytes];
-        assert(o->bytes);
-        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-      }
-
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-        klee_warning("unable to write output test case, losing it");
-      } else {
-        ++m_numGeneratedTests;
-      }
-
-      for (unsigned i=0; i<b.numObjects; i++)
-        delete[] b.objects[i].bytes;
-      delete[] b.objects;
-    }
-
-    if (errorMessage) {
-      auto f = openTestFile(errorSuffix, id);
-      if (f)
-        *f << errorMessage;
-    }
-
+    // The path streams are written by this process, so are read here.
     if (m_pathWriter) {
       std::vector<unsigned char> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
-      auto f = openTestFile("path", id);
-      if (f) {
-        for (const auto &branch : concreteBranches) {
-          *f << branch << '\n';
+      if (PackPaths) {
+        BranchPath path;
+        for (const auto &branch : concreteBranches)
+          path.push_back(branch == '1');
+        std::string name = getOutputFilename(getTestFilename("path", id));
+        std::ofstream f(name.c_str(), std::ios::out | std::ios::binary);
+        if (f)
+          path.write(f);
+        else
+          klee_warning("unable to write path file: %s", name.c_str());
+      } else {
+        auto f = openTestFile("path", id);
+        if (f) {
+          for (const auto &branch : concreteBranches) {
+            *f << branch << '\n';
+          }
         }
       }
     }
 
-    if (errorMessage || WriteKQueries) {
-      std::string constraints;
-      m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
-      auto f = openTestFile("kquery", id);
-      if (f)
-        *f << constraints;
-    }
-
-    if (WriteCVCs) {
-      // FIXME: If using Z3 as the core solver the emitted file is actually
-      // SMT-LIBv2 not CVC which is a bit confusing
-      std::string constraints;
-      m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
-      auto f = openTestFile("cvc", id);
-      if (f)
-        *f << constraints;
-    }
-
-    if (WriteSMT2s) {
-      std::string constraints;
-        m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
-        auto f = openTestFile("smt2", id);
-        if (f)
-          *f << constraints;
-    }
-
     if (m_symPathWriter) {
       std::vector<unsigned char> symbolicBranches;
       m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
@@ -570,44 +612,188 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       }
     }
 
-    if (WriteCov) {
-      std::map<const std::string*, std::set<unsigned> > cov;
-      m_interpreter->getCoveredLines(state, cov);
-      auto f = openTestFile("cov", id);
-      if (f) {
-        for (const auto &entry : cov) {
-          for (const auto &line : entry.second) {
-            *f << *entry.first << ':' << line << '\n';
-          }
-        }
-      }
+    if (!forkTestCaseWorker()) {
+      if (writeTestCase(state, errorMessage, errorSuffix, id))
+        ++m_numGeneratedTests;
+    } else if (m_testCaseWorkers.empty()) {
+      // the worker, which solves for the test case in its copy of the state
+      _exit(writeTestCase(state, errorMessage, errorSuffix, id) ? 0 : 1);
     }
 
     if (m_numGeneratedTests == MaxTests)
       m_interpreter->setHaltExecution(true);
-
-    if (WriteTestInfo) {
-      time::Span elapsed_time(time::getWallTime() - start_time);
-      auto f = openTestFile("info", id);
-      if (f)
-        *f << "Time to generate test case: " << elapsed_time << '\n';
-    }
   } // if (!WriteNone)
 
   if (errorMessage && OptExitOnError) {
+    waitForTestCases();
     m_interpreter->prepareForEarlyExit();
     klee_error("EXITING ON ERROR:\n%s\n", errorMessage);
   }
 }
 
+bool KleeHandler::writeTestCase(const ExecutionState &state,
+                                const char *errorMessage,
+                                const char *errorSuffix, unsigned id) {
+  std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
+  bool success = m_interpreter->getSymbolicSolution(state, out);
+
+  if (!success)
+    klee_warning("unable to get symbolic solution, losing test case");
+
+  const auto start_time = time::getWallTime();
+
+  bool written = false;
+  if (success) {
+    KTest b;
+    b.numArgs = m_argc;
+    b.args = m_argv;
+    b.symArgvs = 0;
+    b.symArgvLen = 0;
+    b.numObjects = out.size();
+    b.objects = new KTestObject[b.numObjects];
+    assert(b.objects);
+    for (unsigned i=0; i<b.numObjects; i++) {
+      KTestObject *o = &b.objects[i];
+      o->name = const_cast<char*>(out[i].first.c_str());
+      o->numBytes = out[i].second.size();
+      o->bytes = new unsigned char[o->numBytes];
+      assert(o->bytes);
+      std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
+    }
+
+    written =
+        m_kTestWriter
+            ? kTestWriter_append(m_kTestWriter, &b, id)
+            : kTest_toFile(
+                  &b, getOutputFilename(getTestFilename("ktest", id)).c_str());
+    if (!written)
+      klee_warning("unable to write output test case, losing it");
+
+    for (unsigned i=0; i<b.numObjects; i++)
+      delete[] b.objects[i].bytes;
+    delete[] b.objects;
+  }
+
+  if (errorMessage) {
+    auto f = openTestFile(errorSuffix, id);
+    if (f)
+      *f << errorMessage;
+  }
+
+  if (errorMessage || WriteKQueries) {
+    std::string constraints;
+    m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
+    auto f = openTestFile("kquery", id);
+    if (f)
+      *f << constraints;
+  }
+
+  if (WriteCVCs) {
+    // FIXME: If using Z3 as the core solver the emitted file is actually
+    // SMT-LIBv2 not CVC which is a bit confusing
+    std::string constraints;
+    m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
+    auto f = openTestFile("cvc", id);
+    if (f)
+      *f << constraints;
+  }
+
+  if (WriteSMT2s) {
+    std::string constraints;
+      m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
+      auto f = openTestFile("smt2", id);
+      if (f)
+        *f << constraints;
+  }
+
+  if (WriteCov) {
+    std::map<const std::string*, std::set<unsigned> > cov;
+    m_interpreter->getCoveredLines(state, cov);
+    auto f = openTestFile("cov", id);
+    if (f) {
+      for (const auto &entry : cov) {
+        for (const auto &line : entry.second) {
+          *f << *entry.first << ':' << line << '\n';
+        }
+      }
+    }
+  }
+
+  if (WriteTestInfo) {
+    time::Span elapsed_time(time::getWallTime() - start_time);
+    auto f = openTestFile("info", id);
+    if (f)
+      *f << "Time to generate test case: " << elapsed_time << '\n';
+  }
+
+  return written;
+}
+
+bool KleeHandler::forkTestCaseWorker() {
+  // Appends to the container from several processes would interleave.
+  if (!TestCaseWorkers || m_kTestWriter)
+    return false;
+
+  reapTestCaseWorkers(false);
+  // the backpressure: wait for a worker once all are busy
+  while (m_testCaseWorkers.size() >= TestCaseWorkers)
+    reapTestCaseWorkers(true);
+
+  fflush(stdout);
+  fflush(stderr);
+  fflush(klee_warning_file);
+  fflush(klee_message_file);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for a test case worker) - %s, generating the "
+                 "test case in this process", sys::StrError(errno).c_str());
+    return false;
+  }
+
+  if (pid == 0)
+    m_testCaseWorkers.clear();
+  else
+    m_testCaseWorkers.push_back(pid);
+  return true;
+}
+
+void KleeHandler::reapTestCaseWorkers(bool block) {
+  for (auto it = m_testCaseWorkers.begin(); it != m_testCaseWorkers.end();) {
+    int status;
+    pid_t res = waitpid(*it, &status, block ? 0 : WNOHANG);
+    if (res == 0 || (res < 0 && errno == EINTR)) {
+      ++it;
+      continue;
+    }
+    if (res > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+      ++m_numGeneratedTests;
+    it = m_testCaseWorkers.erase(it);
+    // one is enough to make room
+    if (block)
+      return;
+  }
+}
+
+void KleeHandler::waitForTestCases() {
+  while (!m_testCaseWorkers.empty())
+    reapTestCaseWorkers(true);
+  if (MaxTests && m_numGeneratedTests >= MaxTests)
+    m_interpreter->setHaltExecution(true);
+}
+
   // load a .path file
-void KleeHandler::loadPathFile(std::string name,
-                                     std::vector<bool> &buffer) {
+void KleeHandler::loadPathFile(std::string name, BranchPath &buffer) {
   std::ifstream f(name.c_str(), std::ios::in | std::ios::binary);
 
   if (!f.good())
     assert(0 && "unable to open path file");
 
+  // packed paths (--pack-paths) start with a magic, text ones with a digit
+  if (BranchPath::read(f, buffer))
+    return;
+  f.clear();
+  f.seekg(0);
+
   while (f.good()) {
     unsigned value;
     f >> value;
@@ -622,7 +808,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   llvm::sys::fs::directory_iterator i(directoryPath, ec), e;
   for (; i != e && !ec; i.increment(ec)) {
     auto f = i->path();
-    if (f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") {
+    if ((f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") ||
+        (f.size() >= 7 && f.substr(f.size()-7,f.size()) == ".ktests")) {
       results.push_back(f);
     }
   }
@@ -634,6 +821,45 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   }
 }
 
+bool KleeHandler::loadKTests(const std::string &path,
+                             std::vector<KTest *> &tests,
+                             std::vector<KTestReader *> &containers) {
+  if (!kTest_isKTestContainer(path.c_str())) {
+    KTest *out = kTest_fromFile(path.c_str());
+    if (!out)
+      return false;
+    tests.push_back(out);
+    return true;
+  }
+
+  KTestReader *reader = kTestReader_open(path.c_str());
+  if (!reader)
+    return false;
+  containers.push_back(reader);
+  for (unsigned i = 0, e = kTestReader_numTests(reader); i != e; ++i) {
+    if (KTest *out = kTestReader_get(reader, i))
+      tests.push_back(out);
+    else
+      klee_warning("unable to read test %u of: %s", i, path.c_str());
+  }
+  return true;
+}
+
+void KleeHandler::freeKTests(std::vector<KTest *> &tests,
+                             std::vector<KTestReader *> &containers) {
+  std::set<KTest *> contained;
+  for (auto reader : containers)
+    for (unsigned i = 0, e = kTestReader_numTests(reader); i != e; ++i)
+      contained.insert(kTestReader_get(reader, i));
+  for (auto test : tests)
+    if (!contained.count(test))
+      kTest_free(test);
+  for (auto reader : containers)
+    kTestReader_close(reader);
+  tests.clear();
+  containers.clear();
+}
+
 std::string KleeHandler::getRunTimeLibraryPath(const char *argv0) {
   // allow specifying the path to the runtime library
   const char *env = getenv("KLEE_RUNTIME_LIBRARY_PATH");
@@ -757,6 +983,7 @@ static const char *modelledExternals[] = {
   "klee_abort",
   "klee_assume",
   "klee_check_memory_access",
+  "klee_copy_memory",
   "klee_define_fixed_object",
   "klee_get_errno",
   "klee_get_valuef",
@@ -1209,6 +1436,20 @@ int main(int argc, char **argv, char **envp) {
   }
 
   sys::SetInterruptFunction(interrupt_handle);
+#ifdef ENABLE_KLEE_TRACING
+  // kill -USR2 writes the trace recorded so far
+  trace::writeOnSignal(SIGUSR2);
+#endif
+
+  if (!LibraryEntryPoints.empty()) {
+    if (EntryPoint.getNumOccurrences())
+      klee_error("--library-entry-points replaces --entry-point");
+    if (WithPOSIXRuntime || Libc == LibcType::UcLibc)
+      klee_error("--library-entry-points does not support --posix-runtime or "
+                 "--libc=uclibc, whose start-up code only runs from main");
+    // the first entry point is linked and prepared as the entry point
+    EntryPoint = LibraryEntryPoints.front();
+  }
 
   // Load the bytecode...
   std::string errorMsg;
@@ -1237,6 +1478,23 @@ int main(int argc, char **argv, char **envp) {
                                   /*Optimize=*/OptimizeModule,
                                   /*CheckDivZero=*/CheckDivZero,
                                   /*CheckOvershift=*/CheckOvershift);
+  Opts.ExtraEntryPoints.assign(LibraryEntryPoints.begin(),
+                               LibraryEntryPoints.end());
+  if (!ModuleCacheDir.empty()) {
+    // Any option before the program may affect the prepared module, except
+    // for where the results go.
+    Opts.CacheDir = ModuleCacheDir;
+    for (int i = 1; i < argc && argv[i] != InputFile; ++i) {
+      StringRef arg = StringRef(argv[i]).ltrim('-');
+      if (arg.startswith("output-dir")) {
+        if (arg == "output-dir")
+          ++i;
+        continue;
+      }
+      Opts.CacheSalt += arg;
+      Opts.CacheSalt += '\n';
+    }
+  }
 
   if (WithPOSIXRuntime) {
     SmallString<128> Path(Opts.LibraryDir);
@@ -1336,7 +1594,7 @@ int main(int argc, char **argv, char **envp) {
     pArgv[i] = pArg;
   }
 
-  std::vector<bool> replayPath;
+  BranchPath replayPath;
 
   if (ReplayPathFile != "") {
     KleeHandler::loadPathFile(ReplayPathFile, replayPath);
@@ -1363,11 +1621,20 @@ int main(int argc, char **argv, char **envp) {
   if (!mainFn) {
     klee_error("Entry function '%s' not found in module.", EntryPoint.c_str());
   }
+  std::vector<Function *> libraryFns;
+  for (const std::string &name : LibraryEntryPoints) {
+    Function *f = finalModule->getFunction(name);
+    if (!f || f->isDeclaration())
+      klee_error("Entry function '%s' not found in module.", name.c_str());
+    libraryFns.push_back(f);
+  }
 
   externalsAndGlobalsCheck(finalModule);
 
   if (ReplayPathFile != "") {
-    interpreter->setReplayPath(&replayPath);
+    interpreter->setReplayPath(&replayPath, ReplayPathPrefix);
+  } else if (ReplayPathPrefix) {
+    klee_error("--replay-path-prefix requires --replay-path");
   }
 
 
@@ -1391,15 +1658,12 @@ int main(int argc, char **argv, char **envp) {
          it != ie; ++it)
       KleeHandler::getKTestFilesInDir(*it, kTestFiles);
     std::vector<KTest*> kTests;
+    std::vector<KTestReader*> kTestContainers;
     for (std::vector<std::string>::iterator
            it = kTestFiles.begin(), ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!KleeHandler::loadKTests(*it, kTests, kTestContainers))
         klee_warning("unable to open: %s\n", (*it).c_str());
-      }
     }
 
     if (RunInDir != "") {
@@ -1418,26 +1682,22 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayKTest(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(mainFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
     }
     interpreter->setReplayKTest(0);
-    while (!kTests.empty()) {
-      kTest_free(kTests.back());
-      kTests.pop_back();
-    }
+    KleeHandler::freeKTests(kTests, kTestContainers);
   } else {
     std::vector<KTest *> seeds;
+    std::vector<KTestReader *> seedContainers;
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!KleeHandler::loadKTests(*it, seeds, seedContainers)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1447,11 +1707,9 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = kTestFiles.begin(), ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!KleeHandler::loadKTests(*it2, seeds, seedContainers)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
@@ -1469,13 +1727,21 @@ int main(int argc, char **argv, char **envp) {
                    sys::StrError(errno).c_str());
       }
     }
-    interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
+    if (libraryFns.empty())
+      interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
+    else
+      interpreter->runFunctionsAsMain(libraryFns, pArgc, pArgv, pEnvp);
 
-    while (!seeds.empty()) {
-      kTest_free(seeds.back());
-      seeds.pop_back();
-    }
+    KleeHandler::freeKTests(seeds, seedContainers);
   }
+  handler->waitForTestCases();
+#ifdef ENABLE_KLEE_TRACING
+  {
+    std::string error;
+    if (!trace::write(handler->getOutputFilename("trace.json"), error))
+      klee_warning("unable to write the trace: %s", error.c_str());
+  }
+#endif
 
   auto endTime = std::time(nullptr);
   { // output end and elapsed time
@@ -1513,6 +1779,10 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("QueriesCEX");
   uint64_t queryConstructs =
     *theStatisticManager->getStatisticByName("QueriesConstructs");
+  uint64_t speculativeQueries =
+    *theStatisticManager->getStatisticByName("SpeculativeQueries");
+  uint64_t speculativeQueryHits =
+    *theStatisticManager->getStatisticByName("SpeculativeQueryHits");
   uint64_t instructions =
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
@@ -1532,6 +1802,10 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (speculativeQueries)
+    handler->getInfoStream()
+      << "KLEE: done: speculative queries = " << speculativeQueries
+      << " (" << speculativeQueryHits << " used)\n";
 
   std::stringstream stats;
   stats << "\n";
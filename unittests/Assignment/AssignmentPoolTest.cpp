@@ -0,0 +1,112 @@
+//===-- AssignmentPoolTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/AssignmentPool.h"
+#include "gtest/gtest.h"
+
+#include "RandomExpr.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(AssignmentPoolTest, MatchesAssignmentEvaluation) {
+  std::mt19937 rng(7);
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  arrays.push_back(ac.CreateArray("a", 8));
+  arrays.push_back(ac.CreateArray("b", 4));
+
+  std::vector<std::unique_ptr<Assignment> > models;
+  for (unsigned i = 0; i < 40; ++i) {
+    std::vector<std::vector<unsigned char> > values;
+    for (const Array *array : arrays) {
+      values.push_back(std::vector<unsigned char>(array->size));
+      for (unsigned char &v : values.back())
+        v = rng() % 4 ? rng() % 256 : rng() % 4;
+    }
+    // Some models leave the second array unbound.
+    std::vector<const Array *> objects(arrays.begin(),
+                                       arrays.begin() + 1 + i % 2);
+    values.resize(objects.size());
+    models.emplace_back(new Assignment(objects, values));
+  }
+
+  RandomExprGenerator gen(rng, arrays);
+  unsigned hits = 0;
+  for (unsigned trial = 0; trial < 2000; ++trial) {
+    AssignmentPool pool(AssignmentPool::MaxCapacity);
+    unsigned first = rng() % models.size(), count = 1 + rng() % 40;
+    for (unsigned i = 0; i < count; ++i)
+      pool.add(models[(first + i) % models.size()].get());
+
+    std::vector<ref<Expr> > constraints;
+    gen.divides = false;
+    for (unsigned i = 1 + rng() % 3; i; --i)
+      constraints.push_back(gen.generate(Expr::Bool));
+
+    // The most recently added model comes first.
+    Assignment *expected = 0;
+    for (unsigned i = count; i-- > 0;) {
+      Assignment *a = models[(first + i) % models.size()].get();
+      if (a->satisfies(constraints.begin(), constraints.end())) {
+        expected = a;
+        break;
+      }
+    }
+    Assignment *found = pool.findSatisfying(constraints);
+    if (found)
+      ASSERT_TRUE(found->satisfies(constraints.begin(), constraints.end()));
+    if (!gen.divides)
+      ASSERT_EQ(expected, found) << "trial " << trial;
+    hits += found != 0;
+  }
+  // Make sure the generator does not only produce trivial answers.
+  EXPECT_LT(200u, hits);
+  EXPECT_GT(1800u, hits);
+}
+
+TEST(AssignmentPoolTest, RecencyAndCapacity) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("x", 1);
+  std::vector<const Array *> objects(1, array);
+  std::vector<std::unique_ptr<Assignment> > models;
+  for (unsigned v = 0; v < 4; ++v) {
+    std::vector<std::vector<unsigned char> > values(
+        1, std::vector<unsigned char>(1, v));
+    models.emplace_back(new Assignment(objects, values));
+  }
+
+  AssignmentPool pool(3);
+  for (auto &m : models)
+    pool.add(m.get());
+  EXPECT_EQ(3u, pool.size());
+
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int8);
+  std::vector<ref<Expr> > any(
+      1, UltExpr::create(x, ConstantExpr::create(4, Expr::Int8)));
+  std::vector<ref<Expr> > isZero(
+      1, EqExpr::create(x, ConstantExpr::create(0, Expr::Int8)));
+  std::vector<ref<Expr> > isOne(
+      1, EqExpr::create(x, ConstantExpr::create(1, Expr::Int8)));
+
+  // The first model was evicted.
+  EXPECT_EQ(nullptr, pool.findSatisfying(isZero));
+  EXPECT_EQ(models[3].get(), pool.findSatisfying(any));
+  EXPECT_EQ(models[1].get(), pool.findSatisfying(isOne));
+  // A hit makes the model the most recently used one.
+  EXPECT_EQ(models[1].get(), pool.findSatisfying(any));
+}
+}
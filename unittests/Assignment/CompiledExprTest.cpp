@@ -0,0 +1,150 @@
+//===-- CompiledExprTest.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/CompiledExpr.h"
+#include "gtest/gtest.h"
+
+#include "RandomExpr.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(CompiledExprTest, MatchesExprEvaluator) {
+  std::mt19937 rng(3);
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  arrays.push_back(ac.CreateArray("a", 8));
+  arrays.push_back(ac.CreateArray("b", 4));
+  std::vector<ref<ConstantExpr> > constants;
+  for (unsigned i = 0; i < 6; ++i)
+    constants.push_back(ConstantExpr::create(rng() % 256, Expr::Int8));
+  arrays.push_back(ac.CreateArray("c", 6, &constants[0], &constants[0] + 6));
+
+  RandomExprGenerator gen(rng, arrays);
+  unsigned compared = 0;
+  for (unsigned trial = 0; trial < 2000; ++trial) {
+    std::vector<std::vector<unsigned char> > values;
+    for (unsigned k = 0; k < 2; ++k) {
+      values.push_back(std::vector<unsigned char>(arrays[k]->size));
+      for (unsigned char &v : values.back())
+        v = rng() % 4 ? rng() % 256 : rng() % 4;
+    }
+    // Leave the second array unbound in some assignments, with and without
+    // free values.
+    std::vector<const Array *> objects(arrays.begin(),
+                                       arrays.begin() + 1 + trial % 2);
+    values.resize(objects.size());
+    Assignment a(objects, values, /*_allowFreeValues=*/trial % 4 == 0);
+
+    gen.divides = false;
+    static const Expr::Width widths[] = {Expr::Bool, Expr::Int8, Expr::Int16,
+                                         Expr::Int32, Expr::Int64};
+    Expr::Width w = widths[rng() % 5];
+    ref<Expr> e = gen.generate(w);
+
+    std::unique_ptr<CompiledExpr> program(CompiledExpr::compile(e));
+    ASSERT_TRUE(program != nullptr);
+    AssignmentEvaluator evaluator(a);
+    ref<Expr> expected = evaluator.visit(e);
+    uint64_t value;
+    if (program->run(a, value)) {
+      ASSERT_TRUE(isa<ConstantExpr>(expected)) << "trial " << trial;
+      EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), value)
+          << "trial " << trial;
+      ++compared;
+    } else if (!gen.divides) {
+      ASSERT_FALSE(isa<ConstantExpr>(expected)) << "trial " << trial;
+    }
+  }
+  EXPECT_LT(1000u, compared);
+}
+
+TEST(CompiledExprTest, Cache) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("x", 16);
+  ref<Expr> wide = ConcatExpr::create(Expr::createTempRead(array, Expr::Int64),
+                                      Expr::createTempRead(array, Expr::Int64));
+  CompiledExprCache cache;
+  EXPECT_EQ(nullptr, cache.get(wide));
+
+  ref<Expr> e = AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                                ConstantExpr::create(1, Expr::Int32));
+  const CompiledExpr *program = cache.get(e);
+  ASSERT_TRUE(program != nullptr);
+  EXPECT_EQ(program, cache.get(e));
+  EXPECT_LT(program->getMemoryUsage(), cache.getMemoryUsage());
+
+  std::vector<const Array *> objects(1, array);
+  std::vector<std::vector<unsigned char> > values(
+      1, std::vector<unsigned char>(16, 0));
+  values[0][0] = 0xff;
+  values[0][1] = 0xff;
+  Assignment a(objects, values);
+  uint64_t value;
+  ASSERT_TRUE(cache.evaluate(e, a, value));
+  EXPECT_EQ(0x10000u, value);
+  EXPECT_EQ(0x10000u,
+            cast<ConstantExpr>(a.evaluate(e, &cache))->getZExtValue());
+  EXPECT_EQ(0x10000u, cast<ConstantExpr>(a.evaluate(e))->getZExtValue());
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.getMemoryUsage());
+}
+
+TEST(CompiledExprTest, RunAllMatchesRun) {
+  std::mt19937 rng(5);
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  arrays.push_back(ac.CreateArray("a", 8));
+  arrays.push_back(ac.CreateArray("b", 4));
+  RandomExprGenerator gen(rng, arrays);
+
+  for (unsigned trial = 0; trial < 200; ++trial) {
+    // Assignments with and without the second array, some of which fail
+    std::vector<std::unique_ptr<Assignment> > owned;
+    std::vector<const Assignment *> as;
+    for (unsigned k = 0; k < 8; ++k) {
+      std::vector<const Array *> objects(arrays.begin(),
+                                         arrays.begin() + 1 + k % 2);
+      std::vector<std::vector<unsigned char> > values;
+      for (const Array *array : objects) {
+        values.push_back(std::vector<unsigned char>(array->size));
+        for (unsigned char &v : values.back())
+          v = rng() % 4 ? rng() % 256 : rng() % 4;
+      }
+      owned.emplace_back(new Assignment(objects, values,
+                                        /*_allowFreeValues=*/k % 4 == 0));
+      as.push_back(owned.back().get());
+    }
+
+    ref<Expr> e = gen.generate(Expr::Int32);
+    std::unique_ptr<CompiledExpr> program(CompiledExpr::compile(e));
+    ASSERT_TRUE(program != nullptr);
+    std::vector<uint64_t> results;
+    std::vector<char> evaluated;
+    program->runAll(as, results, evaluated);
+    ASSERT_EQ(as.size(), results.size());
+    ASSERT_EQ(as.size(), evaluated.size());
+    for (unsigned k = 0; k < as.size(); ++k) {
+      uint64_t value;
+      bool ok = program->run(*as[k], value);
+      EXPECT_EQ(ok, (bool)evaluated[k]) << "trial " << trial;
+      if (ok && evaluated[k])
+        EXPECT_EQ(value, results[k]) << "trial " << trial;
+    }
+  }
+}
+}
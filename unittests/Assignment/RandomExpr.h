@@ -0,0 +1,117 @@
+//===-- RandomExpr.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UNITTESTS_RANDOMEXPR_H
+#define KLEE_UNITTESTS_RANDOMEXPR_H
+
+#include "klee/Expr.h"
+
+#include <random>
+#include <vector>
+
+namespace klee {
+
+/// Generates random expressions of at most 64 bits over the given arrays,
+/// for comparing evaluators against each other.
+class RandomExprGenerator {
+  std::mt19937 &rng;
+  std::vector<const Array *> arrays;
+
+  ref<Expr> read(unsigned depth) {
+    const Array *array = arrays[rng() % arrays.size()];
+    UpdateList ul(array, 0);
+    for (unsigned i = rng() % 3; i; --i)
+      ul.extend(ConstantExpr::create(rng() % 8, Expr::Int32),
+                ConstantExpr::create(rng() % 256, Expr::Int8));
+    ref<Expr> index = ConstantExpr::create(rng() % 8, Expr::Int32);
+    if (rng() % 2)
+      index = ZExtExpr::create(generate(Expr::Int8, depth + 1), Expr::Int32);
+    return ReadExpr::create(ul, index);
+  }
+
+public:
+  /// Set whenever a division is generated. Evaluators may give up on a zero
+  /// divisor even where ExprEvaluator folds the division away.
+  bool divides;
+
+  RandomExprGenerator(std::mt19937 &rng,
+                      const std::vector<const Array *> &arrays)
+      : rng(rng), arrays(arrays), divides(false) {}
+
+  ref<Expr> generate(Expr::Width w, unsigned depth = 0) {
+    if (depth > 3 || rng() % 4 == 0) {
+      if (w == Expr::Int8 && rng() % 2)
+        return read(depth);
+      return ConstantExpr::create(rng() & ((UINT64_C(1) << (w - 1)) * 2 - 1), w);
+    }
+    if (w == Expr::Bool) {
+      Expr::Width ow = rng() % 2 ? Expr::Int8 : Expr::Int16;
+      ref<Expr> l = generate(ow, depth + 1), r = generate(ow, depth + 1);
+      switch (rng() % 6) {
+      case 0: return EqExpr::create(l, r);
+      case 1: return UltExpr::create(l, r);
+      case 2: return UleExpr::create(l, r);
+      case 3: return SltExpr::create(l, r);
+      case 4: return SleExpr::create(l, r);
+      default: return NotExpr::create(EqExpr::create(l, r));
+      }
+    }
+    switch (rng() % 20) {
+    case 0:
+      if (w > Expr::Int8)
+        return ConcatExpr::create(generate(w - Expr::Int8, depth + 1),
+                                  generate(Expr::Int8, depth + 1));
+      return read(depth);
+    case 1:
+      return ExtractExpr::create(generate(Expr::Int64, depth + 1),
+                                 rng() % (Expr::Int64 - w + 1), w);
+    case 2:
+      if (w > Expr::Int8)
+        return ZExtExpr::create(generate(Expr::Int8, depth + 1), w);
+      return read(depth);
+    case 3:
+      if (w > Expr::Int8)
+        return SExtExpr::create(generate(Expr::Int8, depth + 1), w);
+      return read(depth);
+    case 4:
+      return SelectExpr::create(generate(Expr::Bool, depth + 1),
+                                generate(w, depth + 1), generate(w, depth + 1));
+    case 5:
+      return NotExpr::create(generate(w, depth + 1));
+    default:
+      break;
+    }
+    ref<Expr> l = generate(w, depth + 1), r = generate(w, depth + 1);
+    // Constant folding cannot divide by zero.
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(r))
+      if (CE->isZero())
+        r = ConstantExpr::create(1, w);
+    unsigned kind = rng() % 14;
+    divides |= kind >= 3 && kind <= 6;
+    switch (kind) {
+    case 0: return AddExpr::create(l, r);
+    case 1: return SubExpr::create(l, r);
+    case 2: return MulExpr::create(l, r);
+    case 3: return UDivExpr::create(l, r);
+    case 4: return SDivExpr::create(l, r);
+    case 5: return URemExpr::create(l, r);
+    case 6: return SRemExpr::create(l, r);
+    case 7: return AndExpr::create(l, r);
+    case 8: return OrExpr::create(l, r);
+    case 9: return XorExpr::create(l, r);
+    case 10: return ShlExpr::create(l, r);
+    case 11: return LShrExpr::create(l, r);
+    case 12: return AShrExpr::create(l, r);
+    default: return SelectExpr::create(EqExpr::create(l, r), r, l);
+    }
+  }
+};
+}
+
+#endif
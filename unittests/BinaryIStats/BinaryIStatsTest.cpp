@@ -0,0 +1,123 @@
+#include "klee/Internal/Support/BinaryIStats.h"
+#include "klee/Internal/Support/FileHandling.h"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <iterator>
+
+using namespace klee;
+using namespace klee::istats;
+
+namespace {
+/* Two dumps of a function with two instructions, the first of which calls
+   the function. */
+void writeRun(const std::string &path) {
+  std::string error;
+  BinaryWriter w(klee_open_output_file(path, error));
+  w.writeHeader(42, "prog.bc", "prog.bc",
+                {{"Icov", "CoveredInstructions"}, {"I", "Instructions"}});
+  w.writeFunction(0, "main", "prog.c", 3, 10);
+  w.writeInstruction(1, 0, "prog.c", 4, 11);
+  w.writeInstruction(2, 0, "prog.c", 5, 12);
+
+  uint64_t last[2][2] = {}, callLast[3] = {};
+  uint64_t first[2][2] = {{1, 100}, {0, 0}};
+  w.addValues(1, first[0], last[0]);
+  w.addValues(2, first[1], last[1]);
+  w.endValues();
+  uint64_t firstCall[2] = {1, 7};
+  w.addCall(1, 0, 1, firstCall, callLast);
+  w.endCalls();
+
+  // counters may go down, e.g. the number of states
+  uint64_t second[2][2] = {{1, 90}, {1, 1}};
+  w.addValues(1, second[0], last[0]);
+  w.addValues(2, second[1], last[1]);
+  w.endValues();
+  uint64_t secondCall[2] = {1, 7};
+  w.addCall(1, 0, 3, secondCall, callLast);
+  w.endCalls();
+  w.flush();
+}
+} // namespace
+
+TEST(BinaryIStatsTest, RoundTrip) {
+  writeRun("bistats1.bin");
+  BinaryReader r;
+  std::string error;
+  ASSERT_TRUE(r.read("bistats1.bin", error)) << error;
+
+  EXPECT_EQ(42u, r.pid);
+  EXPECT_EQ("prog.bc", r.cmd);
+  ASSERT_EQ(2u, r.events.size());
+  EXPECT_EQ("Icov", r.events[0].first);
+  EXPECT_EQ("Instructions", r.events[1].second);
+  ASSERT_EQ(1u, r.functions.size());
+  EXPECT_EQ("main", r.functions[0].name);
+  ASSERT_EQ(2u, r.instructions.size());
+  EXPECT_EQ(2u, r.dumps);
+
+  EXPECT_EQ(std::vector<uint64_t>({1, 90}), r.values[1]);
+  EXPECT_EQ(std::vector<uint64_t>({1, 1}), r.values[2]);
+  auto &call = r.calls[std::make_pair(1u, 0u)];
+  EXPECT_EQ(3u, call.calls);
+  EXPECT_EQ(std::vector<uint64_t>({1, 7}), call.values);
+}
+
+TEST(BinaryIStatsTest, Callgrind) {
+  writeRun("bistats2.bin");
+  BinaryReader r;
+  std::string error;
+  ASSERT_TRUE(r.read("bistats2.bin", error)) << error;
+
+  std::string out;
+  llvm::raw_string_ostream os(out);
+  r.writeCallgrind(os);
+  EXPECT_EQ("version: 1\n"
+            "creator: klee\n"
+            "pid: 42\n"
+            "cmd: prog.bc\n"
+            "\n"
+            "\n"
+            "positions: instr line\n"
+            "event: Icov : CoveredInstructions\n"
+            "event: I : Instructions\n"
+            "events: Icov I \n"
+            "ob=prog.bc\n"
+            "fl=prog.c\n"
+            "fn=main\n"
+            "11 4 1 90 \n"
+            "cfn=main\n"
+            "calls=3 10 3\n"
+            "11 4 1 7 \n"
+            "12 5 1 1 \n",
+            os.str());
+}
+
+/* A record cut short by an interrupted run is ignored, with the values of
+   the dumps before it. */
+TEST(BinaryIStatsTest, Truncated) {
+  writeRun("bistats3.bin");
+  std::ifstream in("bistats3.bin", std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  // the last record is the calls of the second dump
+  std::ofstream("bistats3.bin", std::ios::binary)
+      << contents.substr(0, contents.size() - 2);
+
+  BinaryReader r;
+  std::string error;
+  ASSERT_TRUE(r.read("bistats3.bin", error)) << error;
+  EXPECT_EQ(2u, r.dumps);
+  EXPECT_EQ(std::vector<uint64_t>({1, 90}), r.values[1]);
+  EXPECT_EQ(1u, r.calls[std::make_pair(1u, 0u)].calls);
+}
+
+TEST(BinaryIStatsTest, NotBinary) {
+  std::ofstream("bistats4.bin") << "version: 1\n";
+  BinaryReader r;
+  std::string error;
+  EXPECT_FALSE(r.read("bistats4.bin", error));
+  EXPECT_FALSE(error.empty());
+}
@@ -0,0 +1,79 @@
+//===-- BranchPathTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/BranchPath.h"
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Mixed stretches of alternating decisions and long runs.
+std::vector<bool> makeDecisions() {
+  std::vector<bool> decisions;
+  for (unsigned i = 0; i < 10000; ++i)
+    decisions.push_back(i % 3 == 0);
+  decisions.insert(decisions.end(), 100000, true);
+  for (unsigned i = 0; i < 31; ++i)
+    decisions.push_back(false);
+  decisions.push_back(true);
+  decisions.insert(decisions.end(), 5000, false);
+  return decisions;
+}
+
+void expectDecisions(const BranchPath &path,
+                     const std::vector<bool> &decisions) {
+  ASSERT_EQ(decisions.size(), path.size());
+  BranchPath::Cursor cursor(path);
+  for (bool expected : decisions) {
+    ASSERT_FALSE(cursor.atEnd());
+    ASSERT_EQ(expected, cursor.next());
+  }
+  ASSERT_TRUE(cursor.atEnd());
+}
+
+TEST(BranchPathTest, ReadsBackAsWritten) {
+  std::vector<bool> decisions = makeDecisions();
+  BranchPath path;
+  for (bool decision : decisions)
+    path.push_back(decision);
+  expectDecisions(path, decisions);
+}
+
+TEST(BranchPathTest, RoundTripsThroughStreams) {
+  std::vector<bool> decisions = makeDecisions();
+  BranchPath path;
+  for (bool decision : decisions)
+    path.push_back(decision);
+
+  std::stringstream ss;
+  path.write(ss);
+  // the runs take a few bytes, the rest one bit per decision
+  EXPECT_LT(ss.str().size(), 10000u / 8 + 100);
+
+  BranchPath read;
+  ASSERT_TRUE(BranchPath::read(ss, read));
+  expectDecisions(read, decisions);
+}
+
+TEST(BranchPathTest, RejectsOtherData) {
+  std::stringstream ss("1\n0\n1\n");
+  BranchPath path;
+  EXPECT_FALSE(BranchPath::read(ss, path));
+}
+
+TEST(BranchPathTest, Empty) {
+  BranchPath path;
+  EXPECT_TRUE(BranchPath::Cursor(path).atEnd());
+  EXPECT_TRUE(BranchPath::Cursor().atEnd());
+}
+}
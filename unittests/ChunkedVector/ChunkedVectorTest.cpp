@@ -0,0 +1,129 @@
+//===-- ChunkedVectorTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/ChunkedVector.h"
+#include "gtest/gtest.h"
+
+#include <iterator>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+std::vector<int> contents(const ChunkedVector<int> &v) {
+  return std::vector<int>(v.begin(), v.end());
+}
+
+TEST(ChunkedVectorTest, AppendInPlace) {
+  ChunkedVector<int> v;
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(v.begin(), v.end());
+  for (int i = 0; i < 100; i++)
+    v.push_back(i);
+  EXPECT_EQ(100u, v.size());
+  EXPECT_EQ(1u, v.chunks());
+  EXPECT_EQ(99, v.back());
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(i, v[i]);
+}
+
+TEST(ChunkedVectorTest, CopiesShareTheirPrefix) {
+  ChunkedVector<int> a;
+  for (int i = 0; i < 10; i++)
+    a.push_back(i);
+  ChunkedVector<int> b(a);
+  a.push_back(10);
+  b.push_back(20);
+  EXPECT_EQ(2u, a.chunks());
+  EXPECT_EQ(&a[0], &b[0]);
+  EXPECT_EQ(10, a.back());
+  EXPECT_EQ(20, b.back());
+  EXPECT_EQ(11u, a.size());
+  EXPECT_EQ(11u, b.size());
+  EXPECT_NE(a, b);
+
+  std::vector<int> expected;
+  for (int i = 0; i < 10; i++)
+    expected.push_back(i);
+  expected.push_back(20);
+  EXPECT_EQ(expected, contents(b));
+}
+
+TEST(ChunkedVectorTest, ForkEveryAppend) {
+  // a copy kept before every append, as a state forking at every branch
+  ChunkedVector<int> v;
+  std::vector<ChunkedVector<int> > ancestors;
+  std::vector<int> expected;
+  for (int i = 0; i < 1000; i++) {
+    ancestors.push_back(v);
+    v.push_back(i);
+    expected.push_back(i);
+    EXPECT_LE(v.chunks(), 11u);
+  }
+  EXPECT_EQ(expected, contents(v));
+  for (int i = 0; i < 1000; i++)
+    EXPECT_EQ(unsigned(i), ancestors[i].size());
+  EXPECT_EQ(std::vector<int>(expected.begin(), expected.begin() + 500),
+            contents(ancestors[500]));
+}
+
+TEST(ChunkedVectorTest, Iterators) {
+  ChunkedVector<int> v;
+  std::vector<ChunkedVector<int> > ancestors;
+  for (int i = 0; i < 37; i++) {
+    ancestors.push_back(v);
+    v.push_back(i);
+  }
+  ASSERT_GT(v.chunks(), 1u);
+
+  ChunkedVector<int>::const_iterator it = v.end();
+  for (int i = 36; i >= 0; i--)
+    EXPECT_EQ(i, *--it);
+  EXPECT_EQ(v.begin(), it);
+  for (int i = 0; i < 37; i++) {
+    EXPECT_EQ(i, v.begin()[i]);
+    EXPECT_EQ(i, *(v.end() - (37 - i)));
+  }
+  EXPECT_EQ(37, v.end() - v.begin());
+
+  std::vector<int> reversed(
+      std::reverse_iterator<ChunkedVector<int>::const_iterator>(v.end()),
+      std::reverse_iterator<ChunkedVector<int>::const_iterator>(v.begin()));
+  for (int i = 0; i < 37; i++)
+    EXPECT_EQ(36 - i, reversed[i]);
+}
+
+TEST(ChunkedVectorTest, SetCopiesSharedChunk) {
+  ChunkedVector<int> a(std::vector<int>{1, 2, 3});
+  ChunkedVector<int> b(a);
+  b.set(1, 5);
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), contents(a));
+  EXPECT_EQ(std::vector<int>({1, 5, 3}), contents(b));
+  const int *first = &b[0];
+  b.set(2, 6);
+  EXPECT_EQ(first, &b[0]);
+  EXPECT_EQ(std::vector<int>({1, 5, 6}), contents(b));
+}
+
+TEST(ChunkedVectorTest, AssignAndClear) {
+  ChunkedVector<int> v(std::vector<int>{1, 2});
+  ChunkedVector<int> w(v);
+  w.push_back(3);
+  v.assign(w.begin() + 1, w.end());
+  EXPECT_EQ(std::vector<int>({2, 3}), contents(v));
+  EXPECT_EQ(ChunkedVector<int>(std::vector<int>{2, 3}), v);
+  v.clear();
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(0u, v.chunks());
+  v.push_back(4);
+  EXPECT_EQ(std::vector<int>({4}), contents(v));
+}
+
+} // namespace
@@ -0,0 +1,53 @@
+//===-- CopyOnWriteTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/CopyOnWrite.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(CopyOnWriteTest, EmptyDoesNotAllocate) {
+  CopyOnWrite<std::vector<int> > a;
+  EXPECT_EQ(nullptr, a.getIdentity());
+  EXPECT_TRUE(a->empty());
+
+  CopyOnWrite<std::vector<int> > b(a);
+  b.mutate().push_back(1);
+  EXPECT_NE(nullptr, b.getIdentity());
+  EXPECT_TRUE(a->empty());
+}
+
+TEST(CopyOnWriteTest, SharedUntilWritten) {
+  CopyOnWrite<std::vector<int> > a;
+  a.mutate().push_back(1);
+  CopyOnWrite<std::vector<int> > b(a), c(a);
+  EXPECT_EQ(a.getIdentity(), b.getIdentity());
+  EXPECT_EQ(a.getIdentity(), c.getIdentity());
+
+  // Writing to a shared value detaches only the writer.
+  b.mutate().push_back(2);
+  EXPECT_NE(a.getIdentity(), b.getIdentity());
+  EXPECT_EQ(a.getIdentity(), c.getIdentity());
+  EXPECT_EQ(1u, a->size());
+  EXPECT_EQ(2u, b->size());
+
+  // A value which is no longer shared is written in place.
+  const void *id = b.getIdentity();
+  b.mutate().push_back(3);
+  EXPECT_EQ(id, b.getIdentity());
+
+  c.reset();
+  EXPECT_TRUE(c->empty());
+  EXPECT_EQ(1u, a->size());
+}
+}
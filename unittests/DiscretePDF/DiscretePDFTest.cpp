@@ -1,6 +1,10 @@
 #include "klee/Internal/ADT/DiscretePDF.h"
+#include "klee/Internal/ADT/FenwickPDF.h"
 #include "gtest/gtest.h"
+#include <chrono>
 #include <iostream>
+#include <map>
+#include <random>
 #include <vector>
 
 int finished = 0;
@@ -56,3 +60,133 @@ TEST(DiscretePDFTest, Rotatation) {
   ASSERT_EQ(1, testTree.getWeight(1));
   ASSERT_EQ(2, testTree.getWeight(2));
 }
+
+TEST(FenwickPDFTest, Choose) {
+  FenwickPDF<int> pdf;
+  ASSERT_TRUE(pdf.empty());
+
+  // the items cover [0,1), [1,3), [3,6) and [6,10) of the total
+  for (int i = 1; i <= 4; ++i)
+    pdf.insert(i, i);
+  ASSERT_EQ(1, pdf.choose(0));
+  ASSERT_EQ(1, pdf.choose(0.09));
+  ASSERT_EQ(2, pdf.choose(0.1));
+  ASSERT_EQ(3, pdf.choose(0.5));
+  ASSERT_EQ(4, pdf.choose(0.9999999));
+
+  // zero weights are never chosen
+  pdf.update(1, 0);
+  pdf.update(3, 0);
+  ASSERT_EQ(0, pdf.getWeight(1));
+  ASSERT_EQ(2, pdf.choose(0));
+  ASSERT_EQ(4, pdf.choose(0.5));
+
+  pdf.remove(2);
+  ASSERT_FALSE(pdf.inTree(2));
+  ASSERT_EQ(4, pdf.choose(0));
+  pdf.insert(2, 4);
+  ASSERT_EQ(2, pdf.choose(0.5));
+
+  pdf.updateAll([](int i) { return i == 3 ? 1. : 0.; });
+  ASSERT_EQ(3, pdf.choose(0.5));
+  ASSERT_EQ(0, pdf.getWeight(4));
+
+#ifndef NDEBUG
+  ASSERT_DEATH({ pdf.insert(3, 0); }, "already in tree");
+#endif
+
+  while (!pdf.empty())
+    pdf.remove(pdf.choose(0));
+}
+
+TEST(FenwickPDFTest, AgainstDiscretePDF) {
+  DiscretePDF<int> reference;
+  FenwickPDF<int> pdf;
+  std::map<int, double> weights;
+  std::mt19937 rng(1);
+
+  for (unsigned step = 0; step < 20000; ++step) {
+    unsigned op = rng() % 4;
+    int item = rng() % 500;
+    double weight = (rng() % 1000) / 100.;
+    if (op < 2 && !weights.count(item)) {
+      reference.insert(item, weight);
+      pdf.insert(item, weight);
+      weights[item] = weight;
+    } else if (op == 2 && weights.count(item)) {
+      reference.update(item, weight);
+      pdf.update(item, weight);
+      weights[item] = weight;
+    } else if (op == 3 && weights.count(item)) {
+      reference.remove(item);
+      pdf.remove(item);
+      weights.erase(item);
+    }
+
+    ASSERT_EQ(reference.empty(), pdf.empty());
+    if (weights.empty() || step % 16)
+      continue;
+    double total = 0;
+    for (auto &w : weights)
+      total += w.second;
+    if (total == 0)
+      continue;
+    // the chosen items have weight, and their share of it
+    std::map<int, unsigned> counts;
+    const unsigned draws = 400;
+    for (unsigned i = 0; i < draws; ++i) {
+      int chosen = pdf.choose((i + .5) / draws);
+      ASSERT_TRUE(weights.count(chosen));
+      ASSERT_EQ(weights[chosen], pdf.getWeight(chosen));
+      ASSERT_GT(weights[chosen], 0);
+      ++counts[chosen];
+    }
+    for (auto &c : counts)
+      ASSERT_LE(c.second, weights[c.first] / total * draws + 1);
+  }
+}
+
+template <class PDF>
+void benchmarkPDF(const char *name, unsigned n, unsigned rounds) {
+  typedef std::chrono::steady_clock clock;
+  std::mt19937 rng(1);
+  PDF pdf;
+
+  clock::time_point start = clock::now();
+  for (unsigned i = 0; i < n; ++i)
+    pdf.insert(i, 1 + rng() % 100);
+  double insertTime =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+  // after each coverage event, every state gets a new weight
+  start = clock::now();
+  unsigned sum = 0;
+  for (unsigned r = 0; r < rounds; ++r) {
+    for (unsigned i = 0; i < n; ++i)
+      pdf.update(i, 1 + rng() % 100);
+    sum += pdf.choose((rng() % 1000) / 1000.);
+  }
+  double reweightTime =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+  // in between, only the current state changes
+  start = clock::now();
+  for (unsigned i = 0; i < n; ++i) {
+    unsigned item = pdf.choose((rng() % 1000) / 1000.);
+    pdf.update(item, 1 + rng() % 100);
+    sum += item;
+  }
+  double stepTime =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+  std::cout << name << " (" << n << " states): insert "
+            << insertTime * 1e9 / n << " ns, reweight all "
+            << reweightTime * 1e3 / rounds << " ms, step "
+            << stepTime * 1e9 / n << " ns (" << sum << ")\n";
+}
+
+TEST(FenwickPDFTest, DISABLED_Benchmark) {
+  const unsigned n = 1000000, rounds = 10;
+  benchmarkPDF<DiscretePDF<unsigned> >("DiscretePDF", n, rounds);
+  benchmarkPDF<FenwickPDF<unsigned> >("FenwickPDF", n, rounds);
+}
@@ -0,0 +1,112 @@
+//===-- AssignmentGeneratorTest.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "AssignmentGenerator.h"
+
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+/// The little endian 16 bits at offset \a index of \a array.
+ref<Expr> read16(const Array *array, unsigned index) {
+  return ConcatExpr::create(readByte(array, index + 1),
+                            readByte(array, index));
+}
+
+ref<Expr> getConstant(uint64_t value, Expr::Width width) {
+  return ConstantExpr::create(value, width);
+}
+
+TEST(AssignmentGeneratorTest, Batch) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 8);
+  const Array *b = ac.CreateArray("b", 2);
+
+  std::vector<AssignmentGenerator::Target> targets;
+  // x + 5 == 0x1234 and (ZExt y) * 3 == 21, over the same array
+  targets.push_back(std::make_pair(
+      AddExpr::create(getConstant(5, Expr::Int16), read16(a, 2)),
+      getConstant(0x1234, Expr::Int16)));
+  targets.push_back(std::make_pair(
+      MulExpr::create(getConstant(3, Expr::Int32),
+                      ZExtExpr::create(readByte(a, 5), Expr::Int32)),
+      getConstant(21, Expr::Int32)));
+  targets.push_back(std::make_pair(readByte(b, 1), getConstant(9, 8)));
+
+  Assignment assignment;
+  ASSERT_TRUE(AssignmentGenerator::generateAssignment(targets, assignment));
+  for (auto &target : targets)
+    EXPECT_EQ(target.second, assignment.evaluate(target.first));
+  ASSERT_EQ(8u, assignment.bindings[a].size());
+  EXPECT_EQ(0, assignment.bindings[a][0]);
+  EXPECT_EQ(0x2f, assignment.bindings[a][2]);
+  EXPECT_EQ(0x12, assignment.bindings[a][3]);
+  EXPECT_EQ(7, assignment.bindings[a][5]);
+  ASSERT_EQ(2u, assignment.bindings[b].size());
+  EXPECT_EQ(9, assignment.bindings[b][1]);
+}
+
+TEST(AssignmentGeneratorTest, InPlace) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+
+  Assignment assignment;
+  assignment.bindings[a] = std::vector<unsigned char>(4, 0xff);
+  const unsigned char *data = assignment.bindings[a].data();
+
+  ref<Expr> x = read16(a, 1);
+  for (unsigned value : {1u, 0x4321u}) {
+    ASSERT_TRUE(AssignmentGenerator::generateAssignment(
+        AssignmentGenerator::Target(x, getConstant(value, Expr::Int16)),
+        assignment));
+    EXPECT_EQ(getConstant(value, Expr::Int16), assignment.evaluate(x));
+  }
+  // the binding is reused, and the bytes not needed left as they were
+  EXPECT_EQ(data, assignment.bindings[a].data());
+  EXPECT_EQ(0xff, assignment.bindings[a][0]);
+  EXPECT_EQ(0xff, assignment.bindings[a][3]);
+}
+
+TEST(AssignmentGeneratorTest, Failures) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  Assignment assignment;
+
+  // two values for the same byte
+  std::vector<AssignmentGenerator::Target> conflicting;
+  conflicting.push_back(std::make_pair(readByte(a, 0), getConstant(1, 8)));
+  conflicting.push_back(std::make_pair(
+      ZExtExpr::create(readByte(a, 0), Expr::Int32), getConstant(2, 32)));
+  EXPECT_FALSE(AssignmentGenerator::generateAssignment(conflicting,
+                                                       assignment));
+
+  // not reversible
+  ref<Expr> sum = AddExpr::create(readByte(a, 0), readByte(a, 1));
+  EXPECT_FALSE(AssignmentGenerator::generateAssignment(
+      AssignmentGenerator::Target(sum, getConstant(3, 8)), assignment));
+
+  // beyond the end of the array
+  EXPECT_FALSE(AssignmentGenerator::generateAssignment(
+      AssignmentGenerator::Target(read16(a, 3), getConstant(3, 16)),
+      assignment));
+}
+}
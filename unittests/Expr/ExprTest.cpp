@@ -7,11 +7,20 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <iostream>
+#include <set>
 #include "gtest/gtest.h"
 
+#include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprAllocator.h"
+#include "klee/util/ExprUtil.h"
+#include "klee/util/ExprVisitor.h"
+
+#include "llvm/Support/CommandLine.h"
 
 using namespace klee;
 
@@ -113,6 +122,180 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, ConcatLanes) {
+  ArrayCache ac;
+  // not a read, whose extracts would become reads of its bytes
+  ref<Expr> vec = AddExpr::create(
+      Expr::createTempRead(ac.CreateArray("vec", 8), 64),
+      ConstantExpr::create(1, 64));
+  ref<Expr> other = Expr::createTempRead(ac.CreateArray("elt", 2), 16);
+
+  // the lanes of a vector, from the most significant, with lane 1 replaced
+  ref<Expr> lanes[4] = {ExtractExpr::create(vec, 48, 16),
+                        ExtractExpr::create(vec, 32, 16), other,
+                        ExtractExpr::create(vec, 0, 16)};
+  ref<Expr> inserted = ConcatExpr::createN(4, lanes);
+  ASSERT_EQ(Expr::Concat, inserted->getKind());
+  EXPECT_EQ(ExtractExpr::create(vec, 32, 32), inserted->getKid(0));
+
+  // putting the lane back gives the vector
+  lanes[2] = ExtractExpr::create(vec, 16, 16);
+  EXPECT_EQ(vec, ConcatExpr::createN(4, lanes));
+
+  // concrete lanes fold
+  ref<Expr> constant = ConstantExpr::create(0x0102030405060708ULL, 64);
+  ref<Expr> swapped[2] = {ExtractExpr::create(constant, 0, 32),
+                          ExtractExpr::create(constant, 32, 32)};
+  ref<Expr> expected = ConstantExpr::create(0x0506070801020304ULL, 64);
+  EXPECT_EQ(expected, ConcatExpr::createN(2, swapped));
+}
+
+TEST(ExprTest, WideReads) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 16);
+  UpdateList ul(array, 0);
+  ref<Expr> index = Expr::createTempRead(ac.CreateArray("i", 4), Expr::Int32);
+  auto byte = [&](unsigned k) {
+    return ReadExpr::create(
+        ul, AddExpr::create(index, ConstantExpr::create(k, Expr::Int32)));
+  };
+
+  // concatenated as ObjectState::read does, in either byte order
+  ref<Expr> le = byte(0), be = byte(3);
+  for (unsigned k = 1; k != 4; ++k) {
+    le = ConcatExpr::create(byte(k), le);
+    be = ConcatExpr::create(byte(3 - k), be);
+  }
+  ASSERT_EQ(Expr::WideRead, le->getKind());
+  ASSERT_EQ(Expr::WideRead, be->getKind());
+  const WideReadExpr *wle = cast<WideReadExpr>(le);
+  EXPECT_TRUE(wle->isLittleEndian);
+  EXPECT_FALSE(cast<WideReadExpr>(be)->isLittleEndian);
+  EXPECT_EQ(4u, wle->getNumBytes());
+  EXPECT_EQ(index, wle->index);
+  EXPECT_EQ(index, cast<WideReadExpr>(be)->index);
+  EXPECT_NE(le, be);
+  EXPECT_EQ(le, WideReadExpr::create(ul, index, Expr::Int32, true));
+
+  // an equivalent tree of concatenations
+  ref<Expr> lowered = wle->lower();
+  EXPECT_EQ(Expr::Concat, lowered->getKind());
+  EXPECT_EQ(byte(3), lowered->getKid(0));
+
+  // the bytes come apart again
+  EXPECT_EQ(byte(1), ExtractExpr::create(le, 8, 8));
+  EXPECT_EQ(byte(2), ExtractExpr::create(be, 8, 8));
+  ref<Expr> high = ExtractExpr::create(le, 16, 16);
+  ASSERT_EQ(Expr::WideRead, high->getKind());
+  EXPECT_EQ(ConcatExpr::create(byte(3), byte(2)), high);
+  EXPECT_EQ(ConcatExpr::create(byte(1), byte(2)),
+            ExtractExpr::create(be, 8, 16));
+  EXPECT_NE(Expr::WideRead, ExtractExpr::create(le, 4, 16)->getKind());
+
+  // and evaluate as the concatenations did
+  std::vector<const Array *> objects(1, array);
+  objects.push_back(cast<ReadExpr>(ExtractExpr::create(index, 0, 8))
+                        ->updates.root);
+  std::vector<std::vector<unsigned char> > values(2);
+  for (unsigned k = 0; k != 16; ++k)
+    values[0].push_back(k + 1);
+  values[1] = {2, 0, 0, 0};
+  Assignment a(objects, values);
+  EXPECT_EQ(0x06050403u, cast<ConstantExpr>(a.evaluate(le))->getZExtValue());
+  EXPECT_EQ(0x03040506u, cast<ConstantExpr>(a.evaluate(be))->getZExtValue());
+  EXPECT_EQ(a.evaluate(lowered), a.evaluate(le));
+}
+
+TEST(ExprTest, ByteLevelFolds) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr4", 256);
+  ref<Expr> read8 = Expr::createTempRead(array, 8);
+  ref<Expr> read16 = Expr::createTempRead(array, 16);
+
+  // extension chains
+  ref<Expr> zext = ZExtExpr::create(ZExtExpr::create(read8, 16), 32);
+  EXPECT_EQ(Expr::ZExt, zext->getKind());
+  EXPECT_EQ(read8, zext->getKid(0));
+  ref<Expr> sext = SExtExpr::create(SExtExpr::create(read8, 16), 32);
+  EXPECT_EQ(Expr::SExt, sext->getKind());
+  EXPECT_EQ(read8, sext->getKid(0));
+  EXPECT_EQ(Expr::ZExt,
+            SExtExpr::create(ZExtExpr::create(read8, 16), 32)->getKind());
+
+  // extracts of extensions
+  EXPECT_EQ(read8, ExtractExpr::create(zext, 0, 8));
+  EXPECT_EQ(getConstant(0, 8), ExtractExpr::create(zext, 16, 8));
+  ref<Expr> narrower = ExtractExpr::create(sext, 0, 16);
+  EXPECT_EQ(Expr::SExt, narrower->getKind());
+  EXPECT_EQ(16U, narrower->getWidth());
+
+  // concrete zero high bytes
+  ref<Expr> concat = ConcatExpr::create(
+      getConstant(0, 8), ConcatExpr::create(getConstant(0, 8), read16));
+  EXPECT_EQ(Expr::ZExt, concat->getKind());
+  EXPECT_EQ(read16, concat->getKid(0));
+
+  // comparing assembled bytes
+  ref<Expr> eq = EqExpr::create(getConstant(0x1234, 16),
+                                ConcatExpr::create(read8, read8));
+  EXPECT_EQ(Expr::And, eq->getKind());
+  EXPECT_EQ(EqExpr::create(getConstant(0x12, 8), read8), eq->getKid(0));
+  EXPECT_EQ(EqExpr::create(getConstant(0x34, 8), read8), eq->getKid(1));
+  EXPECT_EQ(getConstant(0, Expr::Bool),
+            EqExpr::create(getConstant(0x1234, 16),
+                           ConcatExpr::create(getConstant(0x13, 8), read8)));
+}
+
+TEST(ExprTest, ConstantArrayCaching) {
+  unsigned size = 5;
+  std::vector<ref<ConstantExpr> > Contents(size);
+  for (unsigned i = 0; i < size; ++i)
+    Contents[i] = ConstantExpr::create(i + 1, Expr::Int8);
+  ArrayCache ac;
+  const Array *array = ac.CreateSharedConstantArray("arr", size, &Contents[0],
+                                                    &Contents[0] + size);
+
+  // the same contents under another name share the array
+  EXPECT_EQ(array, ac.CreateSharedConstantArray("tbl", size, &Contents[0],
+                                                &Contents[0] + size));
+
+  // but the arrays created by name keep it
+  const Array *named =
+      ac.CreateArray("tbl", size, &Contents[0], &Contents[0] + size);
+  EXPECT_NE(array, named);
+  EXPECT_EQ("tbl", named->name);
+
+  // other contents or sizes do not
+  Contents[2] = ConstantExpr::create(42, Expr::Int8);
+  EXPECT_NE(array, ac.CreateSharedConstantArray("arr", size, &Contents[0],
+                                                &Contents[0] + size));
+  EXPECT_NE(array, ac.CreateSharedConstantArray("arr", 2, &Contents[0],
+                                                &Contents[0] + 2));
+
+  // nor do symbolic arrays
+  EXPECT_NE(array, ac.CreateArray("arr", size));
+}
+
+TEST(ExprTest, ArrayNameInterning) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("arr", 4);
+  const Array *b = ac.CreateArray("arr", 8);
+  const Array *c = ac.CreateArray("other", 4);
+
+  // arrays of the same name share its number and its copy
+  EXPECT_EQ(a->nameId, b->nameId);
+  EXPECT_EQ(&a->name, &b->name);
+  EXPECT_NE(a->nameId, c->nameId);
+  EXPECT_EQ("other", c->getName());
+  EXPECT_EQ(Array::internName("arr").second, a->nameId);
+
+  // the ids follow the order of creation
+  EXPECT_LT(a->id, b->id);
+  EXPECT_LT(b->id, c->id);
+  EXPECT_EQ(-1, UpdateList(a, 0).compare(UpdateList(b, 0)));
+  EXPECT_EQ(1, UpdateList(c, 0).compare(UpdateList(b, 0)));
+}
+
 TEST(ExprTest, ReadExprFoldingBasic) {
   unsigned size = 5;
 
@@ -264,4 +447,492 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, ReadExprFoldingIndexedUpdates) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 64);
+  auto byte = [](unsigned v) -> ref<Expr> {
+    return ConstantExpr::create(v, Expr::Int8);
+  };
+  UpdateList ul(array, 0);
+  for (unsigned i = 0; i < 100; ++i)
+    ul.extend(ConstantExpr::create(i % 50, Expr::Int32),
+              ConstantExpr::create(i, Expr::Int8));
+  for (unsigned i = 0; i < 50; ++i)
+    EXPECT_EQ(byte(50 + i),
+              ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32)));
+  EXPECT_EQ(Expr::Read,
+            ReadExpr::create(ul, ConstantExpr::create(60, Expr::Int32))
+                ->getKind());
+
+  // Lists diverging from a shared one see their own writes
+  UpdateList ul2(ul);
+  ul.extend(ConstantExpr::create(3, Expr::Int32),
+            ConstantExpr::create(200, Expr::Int8));
+  ul2.extend(ConstantExpr::create(3, Expr::Int32),
+             ConstantExpr::create(201, Expr::Int8));
+  EXPECT_EQ(byte(200),
+            ReadExpr::create(ul, ConstantExpr::create(3, Expr::Int32)));
+  EXPECT_EQ(byte(201),
+            ReadExpr::create(ul2, ConstantExpr::create(3, Expr::Int32)));
+  EXPECT_EQ(byte(54),
+            ReadExpr::create(ul2, ConstantExpr::create(4, Expr::Int32)));
+
+  // Writes below a symbolic index are not found
+  const Array *array2 = ac.CreateArray("arr2", 256);
+  ul.extend(ReadExpr::createTempRead(array2, Expr::Int32),
+            ConstantExpr::create(7, Expr::Int8));
+  for (unsigned i = 0; i < 20; ++i)
+    ul.extend(ConstantExpr::create(i, Expr::Int32),
+              ConstantExpr::create(100 + i, Expr::Int8));
+  EXPECT_EQ(byte(119),
+            ReadExpr::create(ul, ConstantExpr::create(19, Expr::Int32)));
+  EXPECT_EQ(Expr::Read,
+            ReadExpr::create(ul, ConstantExpr::create(30, Expr::Int32))
+                ->getKind());
+}
+
+TEST(ExprTest, UpdateListCompaction) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 64);
+  const Array *array2 = ac.CreateArray("arr2", 256);
+  ref<Expr> sym = ReadExpr::createTempRead(array2, Expr::Int32);
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::create(1, Expr::Int32),
+            ConstantExpr::create(1, Expr::Int8));
+  ul.extend(ConstantExpr::create(2, Expr::Int32),
+            ConstantExpr::create(2, Expr::Int8));
+  UpdateList base(ul);
+  for (unsigned i = 0; i < 3; ++i) {
+    ul.extend(ConstantExpr::create(5, Expr::Int32),
+              ConstantExpr::create(i, Expr::Int8));
+    ul.extend(ConstantExpr::create(3, Expr::Int32),
+              ConstantExpr::create(i, Expr::Int8));
+  }
+  ul.extend(sym, ConstantExpr::create(9, Expr::Int8));
+  ul.extend(ConstantExpr::create(1, Expr::Int32),
+            ConstantExpr::create(10, Expr::Int8));
+
+  std::vector<ref<Expr> > before;
+  for (unsigned i = 0; i < 6; ++i)
+    before.push_back(ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32)));
+
+  ul.compact();
+  // the first write of 1, and all but the last writes of 5 and 3, are gone
+  EXPECT_EQ(5u, ul.getSize());
+  for (unsigned i = 0; i < 6; ++i)
+    if (isa<ConstantExpr>(before[i]))
+      EXPECT_EQ(before[i],
+                ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32)));
+
+  // nothing to drop, nothing changes
+  const UpdateNode *head = base.head;
+  base.compact();
+  EXPECT_EQ(head, base.head);
+}
+
+TEST(ExprTest, StructuralHashes) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+
+  // writes of i to index i used to hash the same whatever i
+  std::set<unsigned> hashes;
+  for (unsigned i = 0; i != 16; ++i) {
+    UpdateList ul(array, 0);
+    ul.extend(ConstantExpr::create(i, Expr::Int32),
+              ConstantExpr::create(i, Expr::Int8));
+    hashes.insert(ul.hash());
+  }
+  EXPECT_EQ(16u, hashes.size());
+
+  // the order of the kids matters
+  ref<Expr> a = Expr::createTempRead(array, 8);
+  ref<Expr> b = ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::create(1, Expr::Int32));
+  EXPECT_NE(ConcatExpr::create(a, b)->hash(),
+            ConcatExpr::create(b, a)->hash());
+
+  // structurally equal expressions still hash and compare equal
+  ref<Expr> c = ConcatExpr::create(a, b);
+  ref<Expr> d = ConcatExpr::create(
+      Expr::createTempRead(array, 8),
+      ReadExpr::create(UpdateList(array, 0),
+                       ConstantExpr::create(1, Expr::Int32)));
+  EXPECT_EQ(c->hash(), d->hash());
+  EXPECT_EQ(0, c->compare(*d));
+}
+
+TEST(ExprTest, ExprHashMap) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  auto read = [&](unsigned i) {
+    return ReadExpr::create(UpdateList(array, 0),
+                            ConstantExpr::create(i, Expr::Int32));
+  };
+  auto key = [&](unsigned i) {
+    return AddExpr::create(ConstantExpr::create(i, Expr::Int32),
+                           ZExtExpr::create(read(i % 256), Expr::Int32));
+  };
+
+  ExprHashMap<unsigned> map;
+  const unsigned n = 1000;
+  for (unsigned i = 0; i != n; ++i)
+    EXPECT_TRUE(map.insert(std::make_pair(key(i), i)).second);
+  EXPECT_EQ(n, map.size());
+  // keys are compared structurally
+  EXPECT_FALSE(map.insert(std::make_pair(key(3), 0)).second);
+  for (unsigned i = 0; i != n; ++i) {
+    auto it = map.find(key(i));
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(i, it->second);
+  }
+
+  // erasing keeps the other entries reachable
+  for (unsigned i = 0; i < n; i += 2)
+    EXPECT_EQ(1u, map.erase(key(i)));
+  EXPECT_EQ(0u, map.erase(read(0)));
+  EXPECT_EQ(n / 2, map.size());
+  unsigned visited = 0;
+  for (auto &entry : map) {
+    EXPECT_EQ(1u, entry.second % 2);
+    ++visited;
+  }
+  EXPECT_EQ(n / 2, visited);
+  for (unsigned i = 0; i != n; ++i)
+    EXPECT_EQ(i % 2, map.count(key(i)));
+
+  map[read(7)] = 42;
+  EXPECT_EQ(42u, map.find(read(7))->second);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.find(read(7)) == map.end());
+
+  ExprHashSet set;
+  EXPECT_TRUE(set.insert(read(1)).second);
+  EXPECT_FALSE(set.insert(read(1)).second);
+  EXPECT_EQ(1u, set.count(read(1)));
+}
+
+class ReadReplacer : public ExprVisitor {
+  ref<Expr> src, dst;
+
+public:
+  unsigned posts = 0;
+
+  ReadReplacer(ref<Expr> src, ref<Expr> dst) : src(src), dst(dst) {}
+
+  Action visitRead(const ReadExpr &re) {
+    if (re == *src.get())
+      return Action::changeTo(dst);
+    return Action::doChildren();
+  }
+  Action visitExprPost(const Expr &) {
+    ++posts;
+    return Action::skipChildren();
+  }
+};
+
+TEST(ExprTest, DeepVisit) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> x = Expr::createTempRead(array, 8);
+  ref<Expr> y = ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::create(1, Expr::Int32));
+
+  // far deeper than a recursive visit could go
+  const unsigned depth = 100000;
+  ref<Expr> e = x;
+  for (unsigned i = 0; i != depth; ++i)
+    e = XorExpr::create(y, e);
+
+  ref<Expr> z = ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::create(2, Expr::Int32));
+  ReadReplacer replacer(x, z);
+  ref<Expr> r = replacer.visit(e);
+  // every Xor was rebuilt and post visited once, as was the shared y
+  EXPECT_EQ(depth + 1, replacer.posts);
+  const Expr *kid = r.get();
+  for (unsigned i = 0; i != depth; ++i) {
+    ASSERT_EQ(Expr::Xor, kid->getKind());
+    EXPECT_EQ(y, kid->getKid(0));
+    kid = kid->getKid(1).get();
+  }
+  EXPECT_EQ(z.get(), kid);
+}
+
+TEST(ExprTest, ConstantAssignment) {
+  // Runs before interning is enabled, which rules out updates in place.
+  ref<Expr> e = ConstantExpr::alloc(1000, Expr::Int64);
+  const Expr *node = e.get();
+  ConstantExpr::assign(e, llvm::APInt(64, 2000));
+  EXPECT_EQ(node, e.get());
+  EXPECT_EQ(2000u, cast<ConstantExpr>(e)->getZExtValue());
+  EXPECT_EQ(ConstantExpr::alloc(2000, Expr::Int64)->hash(), e->hash());
+
+  // A constant referred to elsewhere keeps its value.
+  ref<Expr> other = e;
+  ConstantExpr::assign(e, llvm::APInt(64, 3000));
+  EXPECT_NE(other.get(), e.get());
+  EXPECT_EQ(2000u, cast<ConstantExpr>(other)->getZExtValue());
+  EXPECT_EQ(3000u, cast<ConstantExpr>(e)->getZExtValue());
+
+  // Small values are the shared nodes.
+  ConstantExpr::assign(other, llvm::APInt(32, 3));
+  EXPECT_EQ(ConstantExpr::alloc(3, Expr::Int32).get(), other.get());
+}
+
+TEST(ExprTest, Interning) {
+  // Interning stays enabled for the tests that follow, which is harmless as
+  // it must not change the result of any expression construction.
+  const char *argv[] = {"ExprTest", "-intern-exprs"};
+  llvm::cl::ParseCommandLineOptions(2, argv);
+
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> read32a = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> read32b = Expr::createTempRead(array, Expr::Int32);
+  EXPECT_EQ(read32a.get(), read32b.get());
+
+  ref<Expr> adda = AddExpr::create(read32a, getConstant(1, Expr::Int32));
+  ref<Expr> addb = AddExpr::create(read32b, getConstant(1, Expr::Int32));
+  EXPECT_EQ(adda.get(), addb.get());
+
+  // Nodes differing only in their contents or kids must stay distinct.
+  ref<Expr> addc = AddExpr::create(read32a, getConstant(2, Expr::Int32));
+  EXPECT_NE(adda.get(), addc.get());
+  ref<Expr> ext0 = ExtractExpr::create(read32a, 0, Expr::Int8);
+  ref<Expr> ext8 = ExtractExpr::create(read32a, 8, Expr::Int8);
+  EXPECT_NE(ext0.get(), ext8.get());
+  EXPECT_EQ(ConstantExpr::alloc(7, Expr::Int8).get(),
+            ConstantExpr::alloc(7, Expr::Int8).get());
+  EXPECT_NE(ConstantExpr::alloc(7, Expr::Int8).get(),
+            ConstantExpr::alloc(7, Expr::Int16).get());
+
+  // Once all references are gone the node is released and a fresh one is
+  // interned in its place.
+  unsigned live = Expr::count;
+  {
+    ref<Expr> tmp = SubExpr::create(read32a, getConstant(5, Expr::Int32));
+    EXPECT_GT(Expr::count, live);
+  }
+  EXPECT_EQ(live, Expr::count);
+  ref<Expr> sub = SubExpr::create(read32a, getConstant(5, Expr::Int32));
+  EXPECT_EQ(sub, SubExpr::create(read32b, getConstant(5, Expr::Int32)));
+}
+
+TEST(ExprTest, ArenaAllocation) {
+  const char *argv[] = {"ExprTest", "-expr-arena"};
+  llvm::cl::ParseCommandLineOptions(2, argv);
+
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arena", 256);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+  EXPECT_TRUE(ExprAllocator::isArenaEnabled());
+  EXPECT_GT(ExprAllocator::getReservedBytes(), 0u);
+
+  uint64_t live = ExprAllocator::getLiveBytes();
+  const Expr *freed;
+  {
+    ref<Expr> e = ZExtExpr::create(read, Expr::Int32);
+    freed = e.get();
+    EXPECT_GT(ExprAllocator::getLiveBytes(), live);
+  }
+  EXPECT_EQ(live, ExprAllocator::getLiveBytes());
+
+  // Freed nodes are recycled for nodes of the same size.
+  ref<Expr> e = SExtExpr::create(read, Expr::Int32);
+  EXPECT_EQ(freed, e.get());
+  EXPECT_EQ(Expr::SExt, e->getKind());
+}
+
+TEST(ExprTest, SmallConstantSharing) {
+  // Small constants of the common widths are shared without interning...
+  EXPECT_EQ(ConstantExpr::alloc(42, Expr::Int32).get(),
+            ConstantExpr::alloc(42, Expr::Int32).get());
+  EXPECT_EQ(ConstantExpr::alloc(1, Expr::Bool).get(),
+            ConstantExpr::alloc(1, Expr::Bool).get());
+  EXPECT_NE(ConstantExpr::alloc(42, Expr::Int32).get(),
+            ConstantExpr::alloc(42, Expr::Int64).get());
+
+  // ...and stay alive once they are no longer referenced.
+  unsigned live = Expr::count;
+  {
+    ref<ConstantExpr> tmp = ConstantExpr::alloc(255, Expr::Int16);
+    EXPECT_EQ(255u, tmp->getZExtValue());
+  }
+  EXPECT_EQ(live, Expr::count);
+  EXPECT_EQ(256u, ConstantExpr::alloc(256, Expr::Int64)->getZExtValue());
+  EXPECT_EQ(7u, ConstantExpr::alloc(7, 24)->getZExtValue());
+}
+
+ref<Expr> readByte(const Array *array, ref<Expr> index) {
+  return ReadExpr::create(UpdateList(array, 0), index);
+}
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return readByte(array, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+TEST(ExprTest, ConstraintIndependence) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 16);
+  const Array *b = ac.CreateArray("b", 16);
+  const Array *c = ac.CreateArray("c", 16);
+  const Array *d = ac.CreateArray("d", 16);
+
+  ref<Expr> c0 = UltExpr::create(readByte(a, 0), getConstant(5, 8));
+  ref<Expr> c1 = UltExpr::create(readByte(a, 1), readByte(b, 0));
+  ref<Expr> c2 = UltExpr::create(readByte(b, 0), getConstant(7, 8));
+  ref<Expr> c3 = UltExpr::create(readByte(c, 3), getConstant(2, 8));
+  ref<Expr> symIndex = ZExtExpr::create(readByte(a, 5), Expr::Int32);
+  ref<Expr> c4 = UltExpr::create(readByte(d, symIndex), getConstant(3, 8));
+
+  ConstraintManager cm;
+  for (const ref<Expr> &e : {c0, c1, c2, c3, c4})
+    cm.addConstraint(e);
+
+  ConstraintManager::constraints_ty required;
+  cm.getIndependentConstraints(
+      UltExpr::create(readByte(b, 0), readByte(a, 0)), required);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c0, c1, c2}), required);
+
+  // A read at a constant index of an array that is also read symbolically
+  // depends on every constraint reading the array.
+  required.clear();
+  cm.getIndependentConstraints(
+      EqExpr::create(readByte(d, 7), getConstant(1, 8)), required);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c4}), required);
+
+  // The subset can be taken as a manager of its own as well, which is the
+  // original one when every constraint is required.
+  ConstraintManager subset;
+  cm.getIndependentConstraints(readByte(b, 0), subset);
+  EXPECT_EQ(ConstraintManager(ConstraintManager::constraints_ty({c1, c2})),
+            subset);
+  cm.getIndependentConstraints(
+      AndExpr::create(AndExpr::create(readByte(a, 0), readByte(b, 0)),
+                      AndExpr::create(readByte(c, 3), readByte(d, 0))),
+      subset);
+  EXPECT_EQ(cm, subset);
+  EXPECT_EQ(&*cm.begin(), &*subset.begin());
+
+  std::vector<ConstraintManager::constraints_ty> factors;
+  cm.getIndependentFactors(readByte(c, 3), factors);
+  ASSERT_EQ(4u, factors.size());
+  EXPECT_EQ(ConstraintManager::constraints_ty({c3}), factors[0]);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c0}), factors[1]);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c1, c2}), factors[2]);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c4}), factors[3]);
+
+  // Adding to a copy must not affect the original.
+  ConstraintManager copy(cm);
+  ref<Expr> c5 = UltExpr::create(readByte(c, 3), readByte(a, 0));
+  copy.addConstraint(c5);
+  required.clear();
+  copy.getIndependentConstraints(readByte(a, 0), required);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c0, c3, c5}), required);
+  required.clear();
+  cm.getIndependentConstraints(readByte(a, 0), required);
+  EXPECT_EQ(ConstraintManager::constraints_ty({c0}), required);
+
+  // Rewriting with an equality renumbers the constraints.
+  copy.addConstraint(EqExpr::create(getConstant(3, 8), readByte(b, 0)));
+  required.clear();
+  copy.getIndependentConstraints(readByte(a, 1), required);
+  ASSERT_EQ(1u, required.size());
+  EXPECT_EQ(UltExpr::create(readByte(a, 1), getConstant(3, 8)), required[0]);
+}
+
+TEST(ExprTest, ConstraintRanges) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 16);
+  ref<Expr> x = readByte(a, 0);
+  ref<Expr> y = readByte(a, 1);
+  ref<Expr> True = ConstantExpr::alloc(1, Expr::Bool);
+  ref<Expr> False = ConstantExpr::alloc(0, Expr::Bool);
+
+  ConstraintManager cm;
+  cm.addConstraint(UltExpr::create(x, getConstant(100, 8)));
+  // implied by x < 100
+  cm.addConstraint(UleExpr::create(x, getConstant(200, 8)));
+  ASSERT_EQ(1u, cm.size());
+
+  // replaces the looser bound in place
+  ref<Expr> tighter = UltExpr::create(x, getConstant(50, 8));
+  cm.addConstraint(tighter);
+  ASSERT_EQ(1u, cm.size());
+  EXPECT_EQ(tighter, *cm.begin());
+
+  // a new kind of bound is added
+  ref<Expr> lower = UltExpr::create(getConstant(10, 8), x);
+  cm.addConstraint(lower);
+  ASSERT_EQ(2u, cm.size());
+
+  // comparisons decided by the bounds fold to constants
+  EXPECT_EQ(True, cm.simplifyExpr(UltExpr::create(x, getConstant(60, 8))));
+  EXPECT_EQ(False, cm.simplifyExpr(EqExpr::create(getConstant(5, 8), x)));
+  EXPECT_EQ(True, cm.simplifyExpr(SltExpr::create(x, getConstant(50, 8))));
+  ref<Expr> open = UltExpr::create(x, getConstant(30, 8));
+  EXPECT_EQ(open, cm.simplifyExpr(open));
+
+  // bounds pinning a term turn into an equality
+  ConstraintManager copy(cm);
+  copy.addConstraint(UltExpr::create(x, getConstant(12, 8)));
+  ConstraintManager::constraints_ty required;
+  copy.getIndependentConstraints(x, required);
+  EXPECT_NE(required.end(),
+            std::find(required.begin(), required.end(),
+                      EqExpr::create(getConstant(11, 8), x)));
+  EXPECT_EQ(getConstant(11, 8), copy.simplifyExpr(x));
+  // the original is unaffected
+  EXPECT_EQ(2u, cm.size());
+  EXPECT_EQ(x, cm.simplifyExpr(x));
+
+  // signed bounds are tracked as well
+  cm.addConstraint(SltExpr::create(y, getConstant(0, 8)));
+  EXPECT_EQ(True, cm.simplifyExpr(UleExpr::create(getConstant(128, 8), y)));
+
+  // down to the full width of 64 bits
+  ref<Expr> z = Expr::createTempRead(ac.CreateArray("z", 8), 64);
+  cm.addConstraint(SltExpr::create(z, getConstant(0, 64)));
+  EXPECT_EQ(True, cm.simplifyExpr(UleExpr::create(
+                      ConstantExpr::create(UINT64_C(1) << 63, 64), z)));
+  EXPECT_EQ(True, cm.simplifyExpr(SleExpr::create(
+                      ConstantExpr::create(UINT64_C(1) << 63, 64), z)));
+  EXPECT_EQ(True, cm.simplifyExpr(SleExpr::create(
+                      z, ConstantExpr::create(~UINT64_C(0), 64))));
+}
+
+TEST(ExprTest, ShapeMeasurer) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 16);
+  const Array *b = ac.CreateArray("b", 16);
+  ref<Expr> x = readByte(a, 0);
+  ref<Expr> y = readByte(b, 0);
+
+  UpdateList ul(a, 0);
+  ul.extend(getConstant(1, 32), y);
+  ul.extend(getConstant(2, 32), getConstant(7, 8));
+  ref<Expr> index = ZExtExpr::create(x, Expr::Int32);
+  ref<Expr> r = ReadExpr::create(ul, index);
+  ASSERT_EQ(Expr::Read, r->getKind());
+  ref<Expr> sum = AddExpr::create(r, y);
+
+  ExprShapeMeasurer measurer;
+  measurer.add(sum);
+  // x, the extension, y, the read and the sum
+  EXPECT_EQ(5u, measurer.getNodes());
+  // the sum, the read, the extension and x
+  EXPECT_EQ(4u, measurer.getDepth());
+  EXPECT_EQ(2u, measurer.getArrays());
+  EXPECT_EQ(2u, measurer.getUpdates());
+
+  // the nodes shared with the expressions added before count once
+  ul.extend(getConstant(3, 32), getConstant(8, 8));
+  measurer.add(ReadExpr::create(ul, index));
+  EXPECT_EQ(6u, measurer.getNodes());
+  EXPECT_EQ(4u, measurer.getDepth());
+  EXPECT_EQ(2u, measurer.getArrays());
+  EXPECT_EQ(3u, measurer.getUpdates());
+}
 }
@@ -0,0 +1,283 @@
+//===-- ImmutableBTreeMapTest.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/ImmutableBTreeMap.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef std::shared_ptr<int> Value;
+// A small fan-out exercises splits and merges with few elements.
+typedef ImmutableBTreeMap<int, Value, std::less<int>, 4> SmallBTree;
+typedef ImmutableMap<int, Value> Reference;
+
+template <class Map>
+std::vector<int> keysForward(const Map &m) {
+  std::vector<int> res;
+  for (typename Map::iterator it = m.begin(), ie = m.end(); it != ie; ++it)
+    res.push_back(it->first);
+  return res;
+}
+
+template <class Map>
+std::vector<int> keysBackward(const Map &m) {
+  std::vector<int> res;
+  typename Map::iterator it = m.end(), ib = m.begin();
+  while (it != ib) {
+    --it;
+    res.insert(res.begin(), it->first);
+  }
+  return res;
+}
+
+void checkEqual(const SmallBTree &a, const Reference &b) {
+  ASSERT_EQ(b.size(), a.size());
+  ASSERT_EQ(keysForward(b), keysForward(a));
+  ASSERT_EQ(keysForward(b), keysBackward(a));
+  for (int k = -1; k <= 201; ++k) {
+    const Reference::value_type *rb = b.lookup_previous(k);
+    const SmallBTree::value_type *ra = a.lookup_previous(k);
+    ASSERT_EQ(rb == nullptr, ra == nullptr);
+    if (rb) {
+      ASSERT_EQ(rb->first, ra->first);
+      ASSERT_EQ(rb->second, ra->second);
+    }
+    ASSERT_EQ(b.count(k), a.count(k));
+
+    Reference::iterator lb = b.lower_bound(k), ub = b.upper_bound(k);
+    SmallBTree::iterator la = a.lower_bound(k), ua = a.upper_bound(k);
+    ASSERT_EQ(lb == b.end(), la == a.end());
+    if (lb != b.end())
+      ASSERT_EQ(lb->first, la->first);
+    ASSERT_EQ(ub == b.end(), ua == a.end());
+    if (ub != b.end())
+      ASSERT_EQ(ub->first, ua->first);
+  }
+}
+
+TEST(ImmutableBTreeMapTest, Empty) {
+  SmallBTree m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.begin() == m.end());
+  EXPECT_EQ(nullptr, m.lookup(1));
+  EXPECT_EQ(nullptr, m.lookup_previous(1));
+  EXPECT_TRUE(m.remove(1).empty());
+}
+
+TEST(ImmutableBTreeMapTest, MatchesImmutableMap) {
+  std::mt19937 rng(42);
+  std::vector<SmallBTree> trees(1);
+  std::vector<Reference> refs(1);
+
+  for (unsigned step = 0; step < 4000; ++step) {
+    unsigned which = rng() % trees.size();
+    int key = rng() % 200;
+    switch (rng() % 8) {
+    case 0: // fork
+      if (trees.size() < 16) {
+        trees.push_back(trees[which]);
+        refs.push_back(refs[which]);
+      }
+      break;
+    case 1:
+    case 2: {
+      Value v = std::make_shared<int>(step);
+      trees[which] = trees[which].insert(std::make_pair(key, v));
+      refs[which] = refs[which].insert(std::make_pair(key, v));
+      break;
+    }
+    case 3:
+    case 4: {
+      Value v = std::make_shared<int>(step);
+      trees[which] = trees[which].replace(std::make_pair(key, v));
+      refs[which] = refs[which].replace(std::make_pair(key, v));
+      break;
+    }
+    default:
+      trees[which] = trees[which].remove(key);
+      refs[which] = refs[which].remove(key);
+      break;
+    }
+    if (step % 97 == 0)
+      for (unsigned i = 0; i < trees.size(); ++i)
+        checkEqual(trees[i], refs[i]);
+  }
+  for (unsigned i = 0; i < trees.size(); ++i)
+    checkEqual(trees[i], refs[i]);
+
+  refs.clear();
+  trees.clear();
+  EXPECT_EQ(0u, SmallBTree::getAllocated());
+}
+
+TEST(ImmutableBTreeMapTest, ReleasesValues) {
+  Value v = std::make_shared<int>(0);
+  {
+    SmallBTree m;
+    for (int i = 0; i < 100; ++i)
+      m = m.insert(std::make_pair(i, v));
+    SmallBTree copy = m;
+    for (int i = 0; i < 100; i += 2)
+      m = m.remove(i);
+    EXPECT_EQ(50u, m.size());
+    EXPECT_EQ(100u, copy.size());
+  }
+  EXPECT_EQ(1, v.use_count());
+}
+
+TEST(ImmutableBTreeMapTest, ForEachNode) {
+  Value v = std::make_shared<int>(0);
+  SmallBTree m;
+  for (int i = 0; i < 100; ++i)
+    m = m.insert(std::make_pair(i, v));
+
+  auto count = [](const SmallBTree &t, unsigned &values, unsigned &exclusive) {
+    values = exclusive = 0;
+    t.forEachNode([&](const void *, size_t bytes, bool excl,
+                      const SmallBTree::value_type *, unsigned n) {
+      EXPECT_GT(bytes, 0u);
+      values += n;
+      exclusive += excl;
+      return true;
+    });
+  };
+  unsigned values, exclusive, nodes;
+  count(m, values, nodes);
+  EXPECT_EQ(100u, values);
+  EXPECT_GT(nodes, 1u);
+
+  // A copy shares every node, until it is modified along one path.
+  SmallBTree copy = m;
+  count(m, values, exclusive);
+  EXPECT_EQ(0u, exclusive);
+  copy = copy.replace(std::make_pair(50, v));
+  count(copy, values, exclusive);
+  EXPECT_EQ(100u, values);
+  EXPECT_GT(exclusive, 0u);
+  EXPECT_LT(exclusive, nodes);
+}
+
+TEST(ImmutableBTreeMapTest, ForEachUnshared) {
+  Value v = std::make_shared<int>(0), w = std::make_shared<int>(1);
+  SmallBTree m;
+  for (int i = 0; i < 200; ++i)
+    m = m.insert(std::make_pair(i, v));
+
+  auto unshared = [](const SmallBTree &a, const SmallBTree &b) {
+    std::vector<int> keys;
+    bool same = a.forEachUnshared(b, [&](const SmallBTree::value_type &x,
+                                         const SmallBTree::value_type &y) {
+      EXPECT_EQ(x.first, y.first);
+      keys.push_back(x.first);
+      return true;
+    });
+    EXPECT_TRUE(same);
+    return keys;
+  };
+  EXPECT_TRUE(unshared(m, m).empty());
+
+  // Only the leaves along the modified paths are compared.
+  SmallBTree copy = m.replace(std::make_pair(17, w));
+  copy = copy.replace(std::make_pair(150, w));
+  std::vector<int> keys = unshared(m, copy);
+  EXPECT_LT(keys.size(), 20u);
+  EXPECT_EQ(1, std::count(keys.begin(), keys.end(), 17));
+  EXPECT_EQ(1, std::count(keys.begin(), keys.end(), 150));
+  EXPECT_EQ(keys, unshared(copy, m));
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+  // Maps built apart share nothing, so every entry is compared.
+  SmallBTree apart;
+  for (int i = 199; i >= 0; --i)
+    apart = apart.insert(std::make_pair(i, v));
+  EXPECT_EQ(200u, unshared(m, apart).size());
+
+  // The walk stops when asked to, or at once for maps of different sizes.
+  unsigned calls = 0;
+  EXPECT_FALSE(m.forEachUnshared(apart, [&](const SmallBTree::value_type &,
+                                            const SmallBTree::value_type &) {
+    return ++calls < 3;
+  }));
+  EXPECT_EQ(3u, calls);
+  EXPECT_FALSE(m.forEachUnshared(
+      m.remove(3), [](const SmallBTree::value_type &,
+                      const SmallBTree::value_type &) { return true; }));
+}
+
+// Compares the two map implementations on the operations the address space
+// relies on: lookup_previous() for AddressSpace::resolveOne() and replace()
+// for AddressSpace::bindObject(), with keys ordered through a pointer like
+// MemoryObjectLT. Run with --gtest_also_run_disabled_tests.
+struct FakeObject {
+  uint64_t address;
+};
+struct FakeObjectLT {
+  bool operator()(const FakeObject *a, const FakeObject *b) const {
+    return a->address < b->address;
+  }
+};
+
+template <class Map>
+void benchmark(const char *name, const std::vector<FakeObject> &objects) {
+  typedef std::chrono::steady_clock clock;
+  const unsigned rounds = 200;
+  std::mt19937 rng(1);
+
+  clock::time_point start = clock::now();
+  std::vector<Map> states;
+  for (unsigned r = 0; r < rounds; ++r) {
+    Map m;
+    for (const FakeObject &o : objects)
+      m = m.replace(std::make_pair(&o, (int)r));
+    states.push_back(m);
+  }
+  double bindTime =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+  start = clock::now();
+  uint64_t found = 0;
+  for (unsigned r = 0; r < rounds; ++r) {
+    const Map &m = states[r];
+    for (unsigned i = 0; i < objects.size(); ++i) {
+      FakeObject hack = {objects[rng() % objects.size()].address + 3};
+      found += m.lookup_previous(&hack) != nullptr;
+    }
+  }
+  double resolveTime =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+  std::cout << name << " (" << objects.size() << " objects): bind "
+            << bindTime * 1e9 / (rounds * objects.size()) << " ns, resolve "
+            << resolveTime * 1e9 / (rounds * objects.size()) << " ns ("
+            << found << ")\n";
+}
+
+TEST(ImmutableBTreeMapTest, DISABLED_Benchmark) {
+  for (unsigned n : {16u, 128u, 512u, 4096u}) {
+    std::vector<FakeObject> objects(n);
+    for (unsigned i = 0; i < n; ++i)
+      objects[i].address = 0x10000 + 64 * i;
+    benchmark<ImmutableMap<const FakeObject *, int, FakeObjectLT> >(
+        "ImmutableMap", objects);
+    benchmark<ImmutableBTreeMap<const FakeObject *, int, FakeObjectLT> >(
+        "ImmutableBTreeMap", objects);
+  }
+}
+}
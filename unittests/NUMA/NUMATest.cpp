@@ -0,0 +1,32 @@
+#include "klee/Internal/System/NUMA.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+std::vector<unsigned> parse(const std::string &list) {
+  std::vector<unsigned> cpus;
+  EXPECT_TRUE(numa::parseCPUList(list, cpus)) << list;
+  return cpus;
+}
+} // namespace
+
+TEST(NUMATest, ParseCPUList) {
+  EXPECT_EQ(std::vector<unsigned>(), parse(""));
+  EXPECT_EQ(std::vector<unsigned>({5}), parse("5\n"));
+  EXPECT_EQ(std::vector<unsigned>({0, 1, 2, 3, 8, 9}), parse("0-3,8-9"));
+  EXPECT_EQ(std::vector<unsigned>({1, 4, 5, 7}), parse("1,4-5,7\n"));
+
+  std::vector<unsigned> cpus;
+  EXPECT_FALSE(numa::parseCPUList("3-1", cpus));
+  EXPECT_FALSE(numa::parseCPUList("0-", cpus));
+  EXPECT_FALSE(numa::parseCPUList("a", cpus));
+  EXPECT_FALSE(numa::parseCPUList("1;2", cpus));
+}
+
+TEST(NUMATest, Nodes) {
+  // Every machine has at least one node, whether or not it has NUMA.
+  ASSERT_FALSE(numa::getNodes().empty());
+  // Without --numa-placement, the workers are not placed.
+  EXPECT_EQ(-1, numa::getWorkerNode(0));
+}
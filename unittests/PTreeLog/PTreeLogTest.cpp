@@ -0,0 +1,107 @@
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/Support/PTreeLog.h"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <iterator>
+
+using namespace klee;
+using namespace klee::ptreelog;
+
+namespace {
+/* A tree whose root forks twice at one site, the second time on its right
+   side, then once elsewhere after two leaves are removed. Nodes stand for
+   themselves by their addresses. */
+void writeRun(const std::string &path) {
+  std::string error;
+  Writer w(klee_open_output_file(path, error));
+  int n[7];
+  w.tree(&n[0], 0);
+  w.describe(5, "main", "prog.c", 12);
+  w.split(&n[0], &n[1], &n[2], 5, 100);
+  w.split(&n[2], &n[3], &n[4], 5, 150);
+  w.remove(&n[1], 200);
+  w.remove(&n[3], 300);
+  // the address of a removed leaf is reused
+  w.split(&n[4], &n[1], &n[5], 0, 310);
+  w.flush();
+}
+} // namespace
+
+TEST(PTreeLogTest, RoundTrip) {
+  writeRun("ptree1.bin");
+  Reader r;
+  std::string error;
+  ASSERT_TRUE(r.read("ptree1.bin", error)) << error;
+
+  EXPECT_EQ(1u, r.trees);
+  EXPECT_EQ(3u, r.splits);
+  EXPECT_EQ(2u, r.removes);
+  EXPECT_EQ(2u, r.getLeaves());
+  EXPECT_EQ(3u, r.maxLeaves);
+  EXPECT_EQ(310u, r.instructions);
+  EXPECT_EQ(std::vector<uint64_t>({1, 1, 1}), r.splitDepths);
+  EXPECT_EQ(std::vector<uint64_t>({0, 1, 1}), r.removeDepths);
+
+  ASSERT_EQ(2u, r.sites.size());
+  const Reader::Site &site = r.sites[5];
+  EXPECT_EQ("main", site.function);
+  EXPECT_EQ("prog.c", site.file);
+  EXPECT_EQ(12u, site.line);
+  EXPECT_EQ(2u, site.splits);
+  EXPECT_EQ(1u, site.depths);
+  EXPECT_EQ(1u, r.sites[0].splits);
+}
+
+TEST(PTreeLogTest, Print) {
+  writeRun("ptree2.bin");
+  Reader r;
+  std::string error;
+  ASSERT_TRUE(r.read("ptree2.bin", error)) << error;
+
+  std::string out;
+  llvm::raw_string_ostream os(out);
+  r.print(os, 1);
+  EXPECT_EQ("trees: 1\n"
+            "splits: 3\n"
+            "removes: 2\n"
+            "leaves: 2\n"
+            "most leaves: 3\n"
+            "instructions: 310\n"
+            "\n"
+            "depth              splits      removes\n"
+            "0                       1            0\n"
+            "1                       1            1\n"
+            "2                       1            1\n"
+            "\n"
+            "      splits   mean depth  site\n"
+            "           2          0.5  main (prog.c:12)\n",
+            os.str());
+}
+
+/* An event cut short by an interrupted run ends the file. */
+TEST(PTreeLogTest, Truncated) {
+  writeRun("ptree3.bin");
+  std::ifstream in("ptree3.bin", std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  // the last event is the split elsewhere, with one byte per number
+  std::ofstream("ptree3.bin", std::ios::binary)
+      << contents.substr(0, contents.size() - 1);
+
+  Reader r;
+  std::string error;
+  ASSERT_TRUE(r.read("ptree3.bin", error)) << error;
+  EXPECT_EQ(2u, r.splits);
+  EXPECT_EQ(2u, r.removes);
+  EXPECT_EQ(1u, r.getLeaves());
+}
+
+TEST(PTreeLogTest, NotPTreeLog) {
+  std::ofstream("ptree4.bin") << "digraph G {\n";
+  Reader r;
+  std::string error;
+  EXPECT_FALSE(r.read("ptree4.bin", error));
+  EXPECT_FALSE(error.empty());
+}
@@ -0,0 +1,232 @@
+//===-- PagedArrayTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr.h"
+#include "klee/Internal/ADT/PagedArray.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(PagedArrayTest, FillAndWrite) {
+  PagedArray<uint8_t> a(10000, 7);
+  EXPECT_EQ(10000u, a.getSize());
+  EXPECT_EQ(7, a.get(0));
+  EXPECT_EQ(7, a.get(9999));
+
+  a.set(5000, 42);
+  EXPECT_EQ(42, a.get(5000));
+  EXPECT_EQ(7, a.get(4999));
+  EXPECT_EQ(7, a.get(5001));
+
+  a.reset(0);
+  EXPECT_EQ(0, a.get(5000));
+}
+
+TEST(PagedArrayTest, CopyOnWrite) {
+  PagedArray<uint8_t> a(3 * 4096 + 10);
+  for (unsigned i = 0; i < a.getSize(); ++i)
+    a.set(i, i % 251);
+
+  PagedArray<uint8_t> b(a);
+  b.set(4096, 1);
+  b.set(3 * 4096 + 9, 2);
+  EXPECT_EQ(4096 % 251, a.get(4096));
+  EXPECT_EQ((3 * 4096 + 9) % 251, a.get(3 * 4096 + 9));
+  EXPECT_EQ(1, b.get(4096));
+  EXPECT_EQ(2, b.get(3 * 4096 + 9));
+
+  // Writes to the original must not be visible through the copy either.
+  a.set(0, 3);
+  EXPECT_EQ(3, a.get(0));
+  EXPECT_EQ(0, b.get(0));
+}
+
+TEST(PagedArrayTest, Assign) {
+  PagedArray<uint8_t> a(2 * 4096, 1), b(2 * 4096, 2);
+  a.set(4096, 5);
+  b.set(0, 6);
+  b = a;
+  EXPECT_EQ(1, b.get(0));
+  EXPECT_EQ(5, b.get(4096));
+
+  // the shared pages are copied on the first write to either
+  b.set(4096, 7);
+  EXPECT_EQ(5, a.get(4096));
+}
+
+TEST(PagedArrayTest, CopyInAndOut) {
+  std::vector<uint8_t> raw(5000);
+  for (unsigned i = 0; i < raw.size(); ++i)
+    raw[i] = i % 13;
+
+  PagedArray<uint8_t> a(raw.size());
+  EXPECT_FALSE(a.equals(raw.data()));
+  a.copyFrom(raw.data());
+  EXPECT_TRUE(a.equals(raw.data()));
+
+  std::vector<uint8_t> out(raw.size());
+  PagedArray<uint8_t> b(a);
+  b.copyTo(out.data());
+  EXPECT_EQ(raw, out);
+
+  raw[4500] = 99;
+  b.copyFrom(raw.data());
+  EXPECT_EQ(99, b.get(4500));
+  EXPECT_EQ(4500 % 13, a.get(4500));
+}
+
+TEST(PagedArrayTest, Refs) {
+  ref<Expr> e = ConstantExpr::create(1, Expr::Int8);
+  PagedArray<ref<Expr> > a(2000);
+  EXPECT_TRUE(a.get(1999).isNull());
+  a.set(1999, e);
+
+  {
+    PagedArray<ref<Expr> > b(a);
+    b.set(1999, ref<Expr>());
+    EXPECT_TRUE(b.get(1999).isNull());
+  }
+  EXPECT_EQ(e.get(), a.get(1999).get());
+}
+
+TEST(PagedArrayTest, BitArray) {
+  PagedBitArray a(100000, true);
+  EXPECT_TRUE(a.get(0));
+  EXPECT_TRUE(a.get(99999));
+
+  PagedBitArray b(a);
+  b.unset(65000);
+  EXPECT_FALSE(b.get(65000));
+  EXPECT_TRUE(b.get(64999));
+  EXPECT_TRUE(a.get(65000));
+
+  b.set(65000, true);
+  EXPECT_TRUE(b.get(65000));
+}
+TEST(PagedArrayTest, Ranges) {
+  PagedArray<uint8_t> a(3 * 4096, 5);
+  std::vector<uint8_t> src(5000);
+  for (unsigned i = 0; i < src.size(); ++i)
+    src[i] = i % 7;
+  a.copyFrom(4000, src.size(), src.data());
+
+  PagedArray<uint8_t> b(a);
+  std::vector<uint8_t> out(6000);
+  b.copyTo(3000, out.size(), out.data());
+  for (unsigned i = 0; i < out.size(); ++i) {
+    unsigned idx = 3000 + i;
+    EXPECT_EQ(idx >= 4000 && idx < 9000 ? (idx - 4000) % 7 : 5, out[i]);
+  }
+}
+
+TEST(PagedArrayTest, BitArrayRanges) {
+  std::mt19937 rng(5);
+  const unsigned size = 70000;
+  PagedBitArray a(size, false);
+  std::vector<bool> reference(size, false);
+
+  for (unsigned step = 0; step < 300; ++step) {
+    unsigned begin = rng() % size, end = begin + rng() % 200;
+    if (end > size)
+      end = size;
+    bool value = rng() % 2;
+    if (step % 3) {
+      a.set(begin, end, value);
+      for (unsigned i = begin; i < end; ++i)
+        reference[i] = value;
+    } else {
+      a.set(begin, value);
+      reference[begin] = value;
+    }
+
+    unsigned qBegin = rng() % size, qEnd = qBegin + rng() % 300;
+    if (qEnd > size)
+      qEnd = size;
+    unsigned expectedNext = qEnd, expectedCount = 0;
+    for (unsigned i = qEnd; i-- > qBegin;) {
+      if (reference[i] == value)
+        expectedNext = i;
+      expectedCount += reference[i];
+    }
+    ASSERT_EQ(expectedNext, a.findNext(qBegin, qEnd, value));
+    ASSERT_EQ(expectedNext == qEnd, a.all(qBegin, qEnd, !value));
+    ASSERT_EQ(expectedCount, a.count(qBegin, qEnd));
+  }
+  for (unsigned i = 0; i < size; ++i)
+    ASSERT_EQ(reference[i], a.get(i));
+
+  // Range writes that change nothing keep pages shared.
+  PagedBitArray b(size, true);
+  PagedBitArray c(b);
+  c.set(100, 60000, true);
+  c.set(100, 200, false);
+  EXPECT_FALSE(c.get(150));
+  EXPECT_TRUE(b.get(150));
+}
+TEST(PagedArrayTest, ForEachPage) {
+  PagedArray<uint8_t> a(3 * 4096);
+  unsigned pages = 0, exclusive = 0;
+  auto count = [&](const PagedArray<uint8_t> &x) {
+    pages = exclusive = 0;
+    x.forEachPage([&](const void *, size_t bytes, bool excl) {
+      EXPECT_GT(bytes, 4096u - 1);
+      ++pages;
+      exclusive += excl;
+    });
+  };
+  // pages never written are not allocated
+  count(a);
+  EXPECT_EQ(0u, pages);
+
+  a.set(0, 1);
+  a.set(3 * 4096 - 1, 1);
+  count(a);
+  EXPECT_EQ(2u, pages);
+  EXPECT_EQ(2u, exclusive);
+
+  PagedArray<uint8_t> b(a);
+  b.set(0, 2);
+  count(b);
+  EXPECT_EQ(2u, pages);
+  EXPECT_EQ(1u, exclusive);
+}
+
+TEST(PagedArrayTest, CopyChangedTo) {
+  const unsigned size = 3 * 4096 + 10;
+  PagedArray<uint8_t> a(size);
+  a.set(0, 1);
+  a.set(size - 1, 2);
+  std::vector<uint8_t> dst(size, 0xAA);
+  a.copyTo(dst.data());
+  PagedArray<uint8_t> base(a);
+
+  // pages still shared with the base are not copied
+  std::fill(dst.begin(), dst.end(), 0xAA);
+  a.set(4096, 3);
+  a.copyChangedTo(base, dst.data());
+  EXPECT_EQ(0xAA, dst[0]);
+  EXPECT_EQ(3, dst[4096]);
+  EXPECT_EQ(0, dst[4097]);
+  EXPECT_EQ(0xAA, dst[2 * 4096]);
+  EXPECT_EQ(0xAA, dst[size - 1]);
+
+  // nor are unallocated pages of the same fill, unlike after a reset
+  a.reset(7);
+  a.copyChangedTo(base, dst.data());
+  for (unsigned i = 0; i < size; ++i)
+    ASSERT_EQ(7, dst[i]);
+}
+
+}
@@ -12,6 +12,9 @@
 
 #include "gtest/gtest.h"
 #include <iostream>
+#include <thread>
+#include <vector>
+#include "klee/util/BiasedRefCount.h"
 #include "klee/util/Ref.h"
 using klee::ref;
 
@@ -38,3 +41,61 @@ TEST(RefTest, SelfAssign)
   EXPECT_EQ(r_e->refCount, 1);
   finished = 1;
 }
+
+namespace {
+int biasedDeleted = 0;
+
+struct BiasedObj {
+  klee::BiasedRefCount refCount;
+  ~BiasedObj() { ++biasedDeleted; }
+};
+}
+
+TEST(RefTest, BiasedConfined) {
+  biasedDeleted = 0;
+  BiasedObj *o = new BiasedObj();
+  {
+    ref<BiasedObj> r1(o);
+    EXPECT_EQ(o->refCount.getCount(), 1u);
+    ref<BiasedObj> r2 = r1;
+    EXPECT_EQ(o->refCount.getCount(), 2u);
+    r2 = r2;
+    EXPECT_EQ(o->refCount.getCount(), 2u);
+    EXPECT_FALSE(o->refCount.isShared());
+  }
+  EXPECT_EQ(biasedDeleted, 1);
+}
+
+TEST(RefTest, BiasedShared) {
+  biasedDeleted = 0;
+  BiasedObj *o = new BiasedObj();
+  ref<BiasedObj> r(o);
+  ref<BiasedObj> keep = r;
+  o->refCount.makeShared();
+  EXPECT_TRUE(o->refCount.isShared());
+  EXPECT_EQ(o->refCount.getCount(), 2u);
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < 4; ++i) {
+    threads.emplace_back([r]() {
+      for (unsigned j = 0; j < 10000; ++j) {
+        ref<BiasedObj> copy = r;
+        (void) copy;
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  threads.clear();
+
+  EXPECT_EQ(o->refCount.getCount(), 2u);
+  keep = ref<BiasedObj>();
+  EXPECT_EQ(biasedDeleted, 0);
+
+  // Drop the last reference on another thread.
+  ref<BiasedObj> *last = new ref<BiasedObj>(r);
+  r = ref<BiasedObj>();
+  EXPECT_EQ(biasedDeleted, 0);
+  std::thread([last]() { delete last; }).join();
+  EXPECT_EQ(biasedDeleted, 1);
+}
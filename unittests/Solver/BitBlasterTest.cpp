@@ -0,0 +1,240 @@
+//===-- BitBlasterTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BitBlaster.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "gtest/gtest.h"
+
+#include "RandomExpr.h"
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Keeps the clauses, and evaluates them by unit propagation, which derives
+/// the value of every gate once the bytes of the arrays are fixed.
+class Propagator : public BitBlaster::ClauseSink {
+  std::vector<std::vector<int> > clauses;
+
+public:
+  void addClause(const int *literals, unsigned count) override {
+    clauses.push_back(std::vector<int>(literals, literals + count));
+  }
+
+  /// Extends \a values, indexed by variable: 1 true, -1 false, 0 unknown.
+  /// Returns false on a conflict.
+  bool propagate(std::vector<int> &values) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (const std::vector<int> &clause : clauses) {
+        int unknown = 0, unknowns = 0;
+        bool satisfied = false;
+        for (int literal : clause) {
+          int value = values[std::abs(literal)] * (literal < 0 ? -1 : 1);
+          if (value > 0)
+            satisfied = true;
+          else if (!value) {
+            unknown = literal;
+            ++unknowns;
+          }
+        }
+        if (satisfied || unknowns > 1)
+          continue;
+        if (!unknowns)
+          return false;
+        values[std::abs(unknown)] = unknown < 0 ? -1 : 1;
+        changed = true;
+      }
+    }
+    return true;
+  }
+};
+
+/// Fixes the bytes of the arrays as in \a a, and propagates. Returns
+/// false on a conflict.
+bool evaluate(Propagator &propagator, const BitBlaster &blaster,
+              const std::vector<const Array *> &arrays, const Assignment &a,
+              std::vector<int> &values) {
+  values.assign(blaster.getNumVariables() + 1, 0);
+  for (const Array *array : arrays) {
+    const BitBlaster::Bits *bits = blaster.getArrayBits(array);
+    if (!bits)
+      continue;
+    for (unsigned i = 0; i != array->size; ++i) {
+      uint64_t byte = cast<ConstantExpr>(a.evaluate(array, i))->getZExtValue();
+      for (unsigned j = 0; j != 8; ++j)
+        if (int literal = (*bits)[i * 8 + j])
+          values[literal] = (byte >> j) & 1 ? 1 : -1;
+    }
+  }
+  return propagator.propagate(values);
+}
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+/// Returns the value of \a bits, or false if some bit is unknown.
+bool getValue(const BitBlaster::Bits &bits, const std::vector<int> &values,
+              uint64_t &result) {
+  result = 0;
+  for (unsigned i = 0, e = bits.size(); i != e; ++i) {
+    int value = values[std::abs(bits[i])] * (bits[i] < 0 ? -1 : 1);
+    if (!value)
+      return false;
+    if (value > 0)
+      result |= UINT64_C(1) << i;
+  }
+  return true;
+}
+
+TEST(BitBlasterTest, MatchesExprEvaluator) {
+  std::mt19937 rng(7);
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  arrays.push_back(ac.CreateArray("a", 8));
+  arrays.push_back(ac.CreateArray("b", 4));
+  std::vector<ref<ConstantExpr> > constants;
+  for (unsigned i = 0; i < 6; ++i)
+    constants.push_back(ConstantExpr::create(rng() % 256, Expr::Int8));
+  arrays.push_back(ac.CreateArray("c", 6, &constants[0], &constants[0] + 6));
+
+  RandomExprGenerator gen(rng, arrays);
+  unsigned compared = 0;
+  for (unsigned trial = 0; trial < 500; ++trial) {
+    std::vector<const Array *> objects(arrays.begin(), arrays.begin() + 2);
+    std::vector<std::vector<unsigned char> > bytes;
+    for (const Array *array : objects) {
+      bytes.push_back(std::vector<unsigned char>(array->size));
+      for (unsigned char &v : bytes.back())
+        v = rng() % 4 ? rng() % 256 : rng() % 4;
+    }
+    Assignment a(objects, bytes);
+
+    static const Expr::Width widths[] = {Expr::Bool, Expr::Int8, Expr::Int16,
+                                         Expr::Int32, Expr::Int64};
+    ref<Expr> e = gen.generate(widths[rng() % 5]);
+    // the evaluator gives up on a zero divisor
+    ref<Expr> expected = AssignmentEvaluator(a).visit(e);
+    if (!isa<ConstantExpr>(expected))
+      continue;
+
+    Propagator propagator;
+    BitBlaster blaster(propagator);
+    const BitBlaster::Bits &bits = blaster.blast(e);
+    ASSERT_EQ(e->getWidth(), bits.size());
+
+    std::vector<int> values;
+    ASSERT_TRUE(evaluate(propagator, blaster, objects, a, values))
+        << "trial " << trial;
+    uint64_t value;
+    ASSERT_TRUE(getValue(bits, values, value)) << "trial " << trial;
+    EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), value)
+        << "trial " << trial;
+    ++compared;
+  }
+  EXPECT_LT(300u, compared);
+}
+
+TEST(BitBlasterTest, DivisionByZero) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("x", 2);
+  ref<Expr> x = readByte(array, 0), zero = readByte(array, 1);
+  // SMT-LIB: the quotient is all ones, the remainder the dividend, and the
+  // signed quotient of a negative dividend one
+  struct {
+    ref<Expr> e;
+    uint64_t value;
+  } cases[] = {{UDivExpr::create(x, zero), 0xff},
+               {URemExpr::create(x, zero), 0xf0},
+               {SDivExpr::create(x, zero), 0x01},
+               {SRemExpr::create(x, zero), 0xf0}};
+
+  std::vector<const Array *> objects(1, array);
+  std::vector<std::vector<unsigned char> > bytes(1);
+  bytes[0].push_back(0xf0);
+  bytes[0].push_back(0);
+  Assignment a(objects, bytes);
+  for (auto const &c : cases) {
+    Propagator propagator;
+    BitBlaster blaster(propagator);
+    const BitBlaster::Bits &bits = blaster.blast(c.e);
+    std::vector<int> values;
+    ASSERT_TRUE(evaluate(propagator, blaster, objects, a, values));
+    uint64_t value;
+    ASSERT_TRUE(getValue(bits, values, value));
+    EXPECT_EQ(c.value, value);
+  }
+}
+
+TEST(BitBlasterTest, SymbolicUpdates) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("x", 4);
+  UpdateList ul(array, 0);
+  ul.extend(ZExtExpr::create(readByte(array, 0), Expr::Int32),
+            ConstantExpr::create(42, Expr::Int8));
+  ul.extend(ConstantExpr::create(3, Expr::Int32),
+            ConstantExpr::create(7, Expr::Int8));
+  ref<Expr> read = ReadExpr::create(
+      ul, ZExtExpr::create(readByte(array, 1), Expr::Int32));
+
+  std::vector<const Array *> objects(1, array);
+  for (unsigned written = 0; written != 4; ++written) {
+    for (unsigned index = 0; index != 6; ++index) {
+      std::vector<std::vector<unsigned char> > bytes(1);
+      bytes[0] = {(unsigned char)written, (unsigned char)index, 5, 6};
+      Assignment a(objects, bytes);
+      ref<Expr> expected = a.evaluate(read);
+      ASSERT_TRUE(isa<ConstantExpr>(expected));
+
+      Propagator propagator;
+      BitBlaster blaster(propagator);
+      const BitBlaster::Bits &bits = blaster.blast(read);
+      std::vector<int> values;
+      ASSERT_TRUE(evaluate(propagator, blaster, objects, a, values));
+      uint64_t value;
+      ASSERT_TRUE(getValue(bits, values, value));
+      EXPECT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), value)
+          << "written " << written << ", index " << index;
+    }
+  }
+}
+
+TEST(BitBlasterTest, Cache) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("x", 8);
+  ref<Expr> wide = Expr::createTempRead(array, Expr::Int64);
+  ref<Expr> x = ExtractExpr::create(wide, 0, Expr::Int32);
+  ref<Expr> y = ExtractExpr::create(wide, 32, Expr::Int32);
+  ref<Expr> product = MulExpr::create(x, y);
+
+  Propagator propagator;
+  BitBlaster blaster(propagator);
+  const BitBlaster::Bits &bits = blaster.blast(product);
+  unsigned variables = blaster.getNumVariables();
+  EXPECT_EQ(&bits, &blaster.blast(product));
+  EXPECT_EQ(variables, blaster.getNumVariables());
+
+  // a query sharing the product only encodes the comparison
+  blaster.blast(UltExpr::create(product, x));
+  EXPECT_LT(blaster.getNumVariables(), variables + 100);
+
+  const BitBlaster::Bits *arrayBits = blaster.getArrayBits(array);
+  ASSERT_TRUE(arrayBits != nullptr);
+  EXPECT_EQ(64u, arrayBits->size());
+  EXPECT_EQ(nullptr, blaster.getArrayBits(ac.CreateArray("y", 1)));
+}
+}
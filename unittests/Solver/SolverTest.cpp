@@ -13,9 +13,19 @@
 #include "klee/SolverCmdLine.h"
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/ExprBuilder.h"
+#include "klee/QueryLog.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/util/ArrayCache.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 using namespace klee;
 
@@ -166,4 +176,1059 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+
+
+TEST(SolverTest, BatchFeasibility) {
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 2);
+  ref<Expr> x = Expr::createTempRead(a, 8);
+  ref<Expr> y = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(UltExpr::create(x, getConstant(3, 8)));
+  ConstraintManager cm(constraints);
+
+  std::vector<ref<Expr> > conditions;
+  for (unsigned v = 0; v < 5; ++v)
+    conditions.push_back(EqExpr::create(x, getConstant(v, 8)));
+  conditions.push_back(EqExpr::create(y, getConstant(9, 8)));
+  conditions.push_back(ConstantExpr::alloc(0, Expr::Bool));
+  conditions.push_back(ConstantExpr::alloc(1, Expr::Bool));
+
+  std::vector<bool> result;
+  ASSERT_TRUE(solver->mayBeTrue(cm, conditions, result));
+  ASSERT_EQ(conditions.size(), result.size());
+  for (unsigned i = 0; i < conditions.size(); ++i) {
+    bool expected;
+    ASSERT_TRUE(solver->mayBeTrue(Query(cm, conditions[i]), expected));
+    EXPECT_EQ(expected, result[i]) << "condition " << i;
+  }
+  EXPECT_TRUE(result[2]);
+  EXPECT_FALSE(result[3]);
+  delete solver;
+}
+/// Answers every query the same way and counts how often it was asked.
+class CountingSolver : public SolverImpl {
+public:
+  unsigned &calls;
+  CountingSolver(unsigned &calls) : calls(calls) {}
+
+  bool computeTruth(const Query &, bool &isValid) {
+    ++calls;
+    isValid = true;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    ++calls;
+    result = ConstantExpr::create(42, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    ++calls;
+    for (const Array *array : objects)
+      values.push_back(std::vector<unsigned char>(array->size, 7));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+TEST(SolverTest, PersistentCache) {
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(
+      llvm::sys::fs::createTemporaryFile("query-cache", "sqlite", path));
+  std::string cachePath(path.c_str());
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 4);
+  const Array *b = arrays.CreateArray("b", 4);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(
+      UltExpr::create(Expr::createTempRead(a, 8), getConstant(3, 8)));
+  ConstraintManager cm(constraints);
+  ref<Expr> query =
+      EqExpr::create(Expr::createTempRead(a, 8), getConstant(1, 8));
+  std::vector<const Array *> objects(1, a);
+
+  unsigned calls = 0;
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(calls)), cachePath);
+    bool result;
+    ASSERT_TRUE(solver->mustBeTrue(Query(cm, query), result));
+    ASSERT_TRUE(solver->mustBeTrue(Query(cm, query), result));
+    std::vector<std::vector<unsigned char> > values;
+    ASSERT_TRUE(solver->getInitialValues(Query(cm, query), objects, values));
+    EXPECT_EQ(2u, calls);
+    delete solver;
+  }
+
+  // A later run may use different array names for the same query.
+  std::vector<ref<Expr> > renamedConstraints;
+  renamedConstraints.push_back(
+      UltExpr::create(Expr::createTempRead(b, 8), getConstant(3, 8)));
+  ConstraintManager renamed(renamedConstraints);
+  ref<Expr> renamedQuery =
+      EqExpr::create(Expr::createTempRead(b, 8), getConstant(1, 8));
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(calls)), cachePath);
+    bool result = false;
+    ASSERT_TRUE(solver->mustBeTrue(Query(renamed, renamedQuery), result));
+    EXPECT_TRUE(result);
+    std::vector<std::vector<unsigned char> > values;
+    ASSERT_TRUE(solver->getInitialValues(Query(renamed, renamedQuery),
+                                         std::vector<const Array *>(1, b),
+                                         values));
+    ASSERT_EQ(1u, values.size());
+    EXPECT_EQ(std::vector<unsigned char>(4, 7), values[0]);
+
+    ref<ConstantExpr> value;
+    ASSERT_TRUE(solver->getValue(
+        Query(renamed, Expr::createTempRead(b, 32)), value));
+    EXPECT_EQ(2u + 1u, calls);
+    delete solver;
+  }
+
+  llvm::sys::fs::remove(cachePath);
+  llvm::sys::fs::remove(cachePath + "-wal");
+  llvm::sys::fs::remove(cachePath + "-shm");
+}
+
+TEST(SolverTest, CanonicalCache) {
+  Solver *solver =
+      createCanonicalCachingSolver(klee::createCoreSolver(CoreSolverToUse));
+
+  // the arrays of two states, made symbolic by the same code
+  ArrayCache arrays;
+  const Array *names[2][2] = {
+      {arrays.CreateArray("arr", 2), arrays.CreateArray("buf", 2)},
+      {arrays.CreateArray("arr_1", 2), arrays.CreateArray("buf_1", 2)}};
+  uint64_t hits = stats::queryCanonicalCacheHits;
+  for (unsigned state = 0; state != 2; ++state) {
+    const Array *p = names[state][0], *q = names[state][1];
+    std::vector<ref<Expr> > constraints;
+    constraints.push_back(EqExpr::create(
+        getConstant(1, 8),
+        ReadExpr::create(UpdateList(p, 0), getConstant(0, 32))));
+    constraints.push_back(EqExpr::create(
+        getConstant(2, 8),
+        ReadExpr::create(UpdateList(q, 0), getConstant(0, 32))));
+    ConstraintManager cm(constraints);
+
+    bool result;
+    ASSERT_TRUE(solver->mayBeTrue(
+        Query(cm, UltExpr::create(Expr::createTempRead(p, 16),
+                                  Expr::createTempRead(q, 16))),
+        result));
+    EXPECT_TRUE(result);
+
+    // the model is mapped back onto the arrays asked for, in their order
+    std::vector<const Array *> objects;
+    objects.push_back(q);
+    objects.push_back(p);
+    std::vector<std::vector<unsigned char> > values;
+    ASSERT_TRUE(solver->getInitialValues(
+        Query(cm, ConstantExpr::alloc(0, Expr::Bool)), objects, values));
+    ASSERT_EQ(2u, values.size());
+    EXPECT_EQ(2u, values[0][0]);
+    EXPECT_EQ(1u, values[1][0]);
+  }
+  EXPECT_EQ(hits + 2, stats::queryCanonicalCacheHits);
+  delete solver;
+}
+
+TEST(SolverTest, IndependentFactorCache) {
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 1);
+  const Array *b = arrays.CreateArray("b", 1);
+  ref<Expr> aSmall =
+      UltExpr::create(Expr::createTempRead(a, 8), getConstant(8, 8));
+  ref<Expr> bSmall =
+      UltExpr::create(Expr::createTempRead(b, 8), getConstant(9, 8));
+  ref<Expr> bLarge =
+      UgtExpr::create(Expr::createTempRead(b, 8), getConstant(3, 8));
+  std::vector<const Array *> objects;
+  objects.push_back(a);
+  objects.push_back(b);
+
+  unsigned calls = 0;
+  Solver *solver =
+      createIndependentSolver(new Solver(new CountingSolver(calls)));
+  std::vector<std::vector<unsigned char> > values;
+  ConstraintManager first;
+  first.addConstraint(aSmall);
+  first.addConstraint(bSmall);
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(first, ConstantExpr::alloc(0, Expr::Bool)), objects, values));
+  EXPECT_EQ(2u, calls);
+
+  // Only the factor over b changed.
+  values.clear();
+  ConstraintManager second;
+  second.addConstraint(aSmall);
+  second.addConstraint(bLarge);
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(second, ConstantExpr::alloc(0, Expr::Bool)), objects, values));
+  EXPECT_EQ(3u, calls);
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ(std::vector<unsigned char>(1, 7), values[0]);
+  EXPECT_EQ(std::vector<unsigned char>(1, 7), values[1]);
+  delete solver;
+}
+
+TEST(SolverTest, ShrinkCaches) {
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 1);
+  ref<Expr> small =
+      UltExpr::create(Expr::createTempRead(a, 8), getConstant(8, 8));
+  std::vector<const Array *> objects(1, a);
+
+  unsigned calls = 0;
+  Solver *solver = createCachingSolver(
+      createCexCachingSolver(new Solver(new CountingSolver(calls))));
+  ConstraintManager constraints;
+  constraints.addConstraint(small);
+  Query query(constraints, ConstantExpr::alloc(0, Expr::Bool));
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(query, objects, values));
+  EXPECT_EQ(1u, calls);
+  values.clear();
+  ASSERT_TRUE(solver->getInitialValues(query, objects, values));
+  EXPECT_EQ(1u, calls);
+  EXPECT_LT(0u, getSolverCacheMemoryUsage());
+
+  // the cached assignment is gone with its generation
+  EXPECT_LT(0u, shrinkSolverCaches(UINT64_MAX));
+  EXPECT_EQ(0u, getSolverCacheMemoryUsage());
+  values.clear();
+  ASSERT_TRUE(solver->getInitialValues(query, objects, values));
+  EXPECT_EQ(2u, calls);
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(std::vector<unsigned char>(1, 7), values[0]);
+  delete solver;
+}
+
+TEST(SolverTest, SharedMemoryCache) {
+  std::string name = "/klee-solver-test-" + llvm::utostr(getpid());
+  shm_unlink(name.c_str());
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 4);
+  const Array *b = arrays.CreateArray("b", 4);
+  ConstraintManager cm;
+  ref<Expr> query =
+      EqExpr::create(Expr::createTempRead(a, 8), getConstant(1, 8));
+  ref<Expr> renamedQuery =
+      EqExpr::create(Expr::createTempRead(b, 8), getConstant(1, 8));
+
+  // Two solvers mapping the same object stand in for two runs.
+  unsigned calls = 0;
+  Solver *first = createSharedMemoryCachingSolver(
+      new Solver(new CountingSolver(calls)), name, 1);
+  Solver *second = createSharedMemoryCachingSolver(
+      new Solver(new CountingSolver(calls)), name, 1);
+  bool result;
+  ASSERT_TRUE(first->mustBeTrue(Query(cm, query), result));
+  ASSERT_TRUE(second->mustBeTrue(Query(cm, renamedQuery), result));
+  EXPECT_TRUE(result);
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(first->getInitialValues(Query(cm, query),
+                                      std::vector<const Array *>(1, a),
+                                      values));
+  ASSERT_TRUE(second->getInitialValues(Query(cm, renamedQuery),
+                                       std::vector<const Array *>(1, b),
+                                       values));
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(std::vector<unsigned char>(4, 7), values[0]);
+  EXPECT_EQ(2u, calls);
+  delete first;
+  delete second;
+
+  shm_unlink(name.c_str());
+}
+
+TEST(SolverTest, WorkerPool) {
+  // The queries cross into the worker serialized, and must come out the same.
+  Solver *solver =
+      createWorkerPoolSolver(klee::createCoreSolver(CoreSolverToUse), 1);
+
+  testOpcode<SelectExpr>(*solver);
+  testOpcode<SExtExpr>(*solver);
+  testOpcode<AddExpr>(*solver);
+  testOpcode<UDivExpr>(*solver, false, false, 8);
+  testOpcode<AShrExpr>(*solver, false);
+  testOpcode<XorExpr>(*solver);
+  testOpcode<UltExpr>(*solver);
+  testOpcode<SgeExpr>(*solver);
+
+  const Array *a = ac.CreateArray("pool", 4);
+  ConstraintManager cm;
+  cm.addConstraint(
+      EqExpr::create(Expr::createTempRead(a, 32), getConstant(17, 32)));
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)),
+      std::vector<const Array *>(1, a), values));
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(17, values[0][0]);
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(
+      Query(cm, AddExpr::create(Expr::createTempRead(a, 32),
+                                getConstant(1, 32))),
+      value));
+  EXPECT_EQ(18u, value->getZExtValue());
+  delete solver;
+}
+
+TEST(SolverTest, WorkerPoolSpeculation) {
+  // One of the two workers may solve speculative queries.
+  Solver *solver = createWorkerPoolSolver(
+      klee::createCoreSolver(CoreSolverToUse), 2, 1);
+
+  const Array *a = ac.CreateArray("speculated", 4);
+  ref<Expr> read = Expr::createTempRead(a, 32);
+  ConstraintManager cm;
+  cm.addConstraint(UltExpr::create(read, getConstant(100, 32)));
+  Query query(cm, EqExpr::create(read, getConstant(42, 32)));
+  Query other(cm, EqExpr::create(read, getConstant(43, 32)));
+
+  // the workers are started in the background
+  bool result;
+  ASSERT_TRUE(solver->mayBeTrue(other, result));
+  uint64_t started = stats::speculativeQueries;
+  uint64_t hits = stats::speculativeQueryHits;
+  {
+    SpeculationScope speculation;
+    for (unsigned tries = 0;
+         stats::speculativeQueries == started && tries != 1000; ++tries) {
+      EXPECT_FALSE(solver->mayBeTrue(query, result));
+      usleep(1000);
+    }
+    ASSERT_EQ(started + 1, stats::speculativeQueries);
+  }
+
+  // answered by the speculation, whether it is still running or not
+  result = false;
+  ASSERT_TRUE(solver->mayBeTrue(query, result));
+  EXPECT_TRUE(result);
+  EXPECT_EQ(hits + 1, stats::speculativeQueryHits);
+  // the answer is only used once
+  ASSERT_TRUE(solver->mayBeTrue(query, result));
+  EXPECT_EQ(hits + 1, stats::speculativeQueryHits);
+  delete solver;
+}
+
+/// Never answers queries with constraints.
+class HangingSolver : public SolverImpl {
+public:
+  bool computeTruth(const Query &query, bool &isValid) {
+    while (!query.constraints.empty())
+      pause();
+    isValid = true;
+    return true;
+  }
+  bool computeValue(const Query &, ref<Expr> &) { return false; }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &,
+                            std::vector<std::vector<unsigned char> > &,
+                            bool &) {
+    return false;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  }
+};
+
+TEST(SolverTest, WorkerPoolTimeout) {
+  Solver *solver = createWorkerPoolSolver(new Solver(new HangingSolver()), 1);
+  solver->setCoreSolverTimeout(time::milliseconds(300));
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 1);
+  ref<Expr> query =
+      EqExpr::create(Expr::createTempRead(a, 8), getConstant(1, 8));
+  ConstraintManager empty, constrained;
+  constrained.addConstraint(
+      UltExpr::create(Expr::createTempRead(a, 8), getConstant(3, 8)));
+
+  bool result = false;
+  ASSERT_TRUE(solver->mustBeTrue(Query(empty, query), result));
+  EXPECT_TRUE(result);
+  EXPECT_FALSE(solver->mustBeTrue(Query(constrained, query), result));
+  EXPECT_EQ(SolverImpl::SOLVER_RUN_STATUS_TIMEOUT,
+            solver->impl->getOperationStatusCode());
+  // The hanging worker has been replaced.
+  result = false;
+  ASSERT_TRUE(solver->mustBeTrue(Query(empty, query), result));
+  EXPECT_TRUE(result);
+  delete solver;
+}
+
+/// Times out on queries with constraints, recording the timeout each query
+/// was given.
+class TimingOutSolver : public SolverImpl {
+public:
+  time::Span timeout;
+  time::Span &queryTimeout;
+  bool timedOut;
+  TimingOutSolver(time::Span &queryTimeout)
+      : queryTimeout(queryTimeout), timedOut(false) {}
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    queryTimeout = timeout;
+    timedOut = !query.constraints.empty();
+    isValid = true;
+    return !timedOut;
+  }
+  bool computeValue(const Query &, ref<Expr> &) { return false; }
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &,
+                            std::vector<std::vector<unsigned char> > &,
+                            bool &) {
+    return false;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return timedOut ? SOLVER_RUN_STATUS_TIMEOUT
+                    : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  }
+  void setCoreSolverTimeout(time::Span t) { timeout = t; }
+};
+
+TEST(SolverTest, AdaptiveTimeout) {
+  time::Span timeout;
+  Solver *solver =
+      createAdaptiveTimeoutSolver(new Solver(new TimingOutSolver(timeout)));
+  solver->setCoreSolverTimeout(time::seconds(10));
+
+  ArrayCache arrays;
+  ConstraintManager empty;
+  bool result;
+  for (unsigned i = 0; i != 4; ++i) {
+    // The same shape each time, over other arrays and constants.
+    const Array *a = arrays.CreateArray("a" + llvm::utostr(i), 1);
+    ref<Expr> x = Expr::createTempRead(a, 8);
+    ConstraintManager cm;
+    cm.addConstraint(UltExpr::create(x, getConstant(3 + i, 8)));
+    EXPECT_FALSE(solver->mustBeTrue(
+        Query(cm, EqExpr::create(getConstant(i, 8), x)), result));
+    // The first three time out with the full timeout.
+    EXPECT_EQ(i < 3 ? time::seconds(10) : time::seconds(1), timeout);
+  }
+
+  // Other shapes keep the full timeout.
+  const Array *b = arrays.CreateArray("b", 1);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(empty, EqExpr::create(getConstant(1, 8),
+                                  Expr::createTempRead(b, 8))),
+      result));
+  EXPECT_EQ(time::seconds(10), timeout);
+  delete solver;
+}
+
+TEST(SolverTest, KnownBits) {
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 3);
+  ref<Expr> x = ReadExpr::create(UpdateList(a, 0), getConstant(0, 32));
+  ref<Expr> y = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  ref<Expr> z = ReadExpr::create(UpdateList(a, 0), getConstant(2, 32));
+  std::vector<ref<Expr> > constraints;
+  // the sign and low bits of x are clear, and x ^ y is a known checksum of
+  // the low nibble of y
+  constraints.push_back(EqExpr::create(
+      getConstant(0x5b, 8), XorExpr::create(x, y)));
+  constraints.push_back(EqExpr::create(
+      getConstant(0, 8), AndExpr::create(x, getConstant(0x83, 8))));
+  constraints.push_back(EqExpr::create(
+      getConstant(0x0f, 8), AndExpr::create(y, getConstant(0x0f, 8))));
+  ConstraintManager cm(constraints);
+
+  unsigned calls = 0;
+  Solver *solver = createKnownBitsSolver(new Solver(new CountingSolver(calls)));
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, UltExpr::create(x, getConstant(128, 8))), result));
+  EXPECT_TRUE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(0x80, 8),
+                               AndExpr::create(x, getConstant(0x80, 8)))),
+      result));
+  EXPECT_FALSE(result);
+  // the low nibble of x follows from the checksum once y's is known
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(4, 8),
+                               AndExpr::create(x, getConstant(0x0f, 8)))),
+      result));
+  EXPECT_TRUE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(
+                    getConstant(3, 8),
+                    AndExpr::create(AddExpr::create(getConstant(3, 8), x),
+                                    getConstant(3, 8)))),
+      result));
+  EXPECT_TRUE(result);
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(
+      Query(cm, AndExpr::create(x, getConstant(0x8f, 8))), value));
+  EXPECT_EQ(4u, value->getZExtValue());
+  // y cannot be zero, so x / y is no larger than x
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, UltExpr::create(UDivExpr::create(x, y), getConstant(128, 8))),
+      result));
+  EXPECT_TRUE(result);
+  EXPECT_EQ(0u, calls);
+
+  // Undecided queries are passed on.
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(0x14, 8), x)), result));
+  EXPECT_EQ(1u, calls);
+  // z may be zero, which tells nothing about x / z
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, UltExpr::create(UDivExpr::create(x, z), getConstant(128, 8))),
+      result));
+  EXPECT_EQ(2u, calls);
+
+  // Contradicting bits rule out any assignment.
+  std::vector<ref<Expr> > contradiction(constraints);
+  contradiction.push_back(UltExpr::create(getConstant(0x0f, 8), x));
+  contradiction.push_back(UltExpr::create(x, getConstant(0x10, 8)));
+  ConstraintManager unsat(contradiction);
+  std::vector<std::vector<unsigned char> > values;
+  EXPECT_FALSE(solver->getInitialValues(
+      Query(unsat, ConstantExpr::alloc(0, Expr::Bool)),
+      std::vector<const Array *>(1, a), values));
+  EXPECT_EQ(2u, calls);
+  delete solver;
+}
+
+TEST(SolverTest, FastCexAcrossQueries) {
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 2);
+  ref<Expr> x = ReadExpr::create(UpdateList(a, 0), getConstant(0, 32));
+  ref<Expr> y = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  ref<Expr> sum = AddExpr::create(x, y);
+
+  unsigned calls = 0;
+  Solver *solver = createFastCexSolver(new Solver(new CountingSolver(calls)));
+  // the ranges evaluated for one query are reused by the next ones, which
+  // must still be answered according to their own constraints
+  for (unsigned v = 0; v != 3; ++v) {
+    std::vector<ref<Expr> > constraints;
+    constraints.push_back(EqExpr::create(getConstant(4 + v, 8), x));
+    constraints.push_back(EqExpr::create(getConstant(6, 8), y));
+    ConstraintManager cm(constraints);
+    for (unsigned repeat = 0; repeat != 2; ++repeat) {
+      ref<ConstantExpr> value;
+      ASSERT_TRUE(solver->getValue(Query(cm, sum), value));
+      EXPECT_EQ(10 + v, value->getZExtValue());
+      bool result;
+      ASSERT_TRUE(solver->mustBeTrue(
+          Query(cm, EqExpr::create(getConstant(10 + v, 8), sum)), result));
+      EXPECT_TRUE(result);
+    }
+  }
+  EXPECT_EQ(0u, calls);
+  delete solver;
+}
+
+TEST(SolverTest, ScalarArrays) {
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 4);
+  const Array *idx = arrays.CreateArray("idx", 1);
+  ref<Expr> i = ZExtExpr::create(
+      ReadExpr::create(UpdateList(idx, 0), getConstant(0, 32)), Expr::Int32);
+  // a[i] = 5, then a[1] = 9
+  UpdateList updates(a, 0);
+  updates.extend(i, getConstant(5, 8));
+  updates.extend(getConstant(1, 32), getConstant(9, 8));
+  ref<Expr> a0 = ReadExpr::create(updates, getConstant(0, 32));
+  ref<Expr> a1 = ReadExpr::create(updates, getConstant(1, 32));
+  ref<Expr> a2 = ReadExpr::create(updates, getConstant(2, 32));
+  ref<Expr> a3 = ReadExpr::create(UpdateList(a, 0), getConstant(3, 32));
+
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(EqExpr::create(getConstant(2, 32), i));
+  constraints.push_back(EqExpr::create(getConstant(42, 8), a3));
+  ConstraintManager cm(constraints);
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(5, 8), a2)), result));
+  EXPECT_TRUE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(9, 8), a1)), result));
+  EXPECT_TRUE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(5, 8), a0)), result));
+  EXPECT_FALSE(result);
+
+  std::vector<const Array *> objects(1, a);
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, EqExpr::create(getConstant(7, 8), a0)).negateExpr(), objects,
+      values));
+  EXPECT_EQ(7u, values[0][0]);
+  EXPECT_EQ(42u, values[0][3]);
+
+  // A read at a symbolic index needs the array itself, with the same bytes.
+  ref<Expr> ai = ReadExpr::create(UpdateList(a, 0), i);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(5, 8), ai)), result));
+  EXPECT_FALSE(result);
+  values.clear();
+  std::vector<ref<Expr> > symbolic(constraints);
+  symbolic.push_back(EqExpr::create(getConstant(6, 8), ai));
+  ConstraintManager symbolicCm(symbolic);
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(symbolicCm, ConstantExpr::alloc(0, Expr::Bool)), objects,
+      values));
+  EXPECT_EQ(6u, values[0][2]);
+  EXPECT_EQ(42u, values[0][3]);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(9, 8), a1)), result));
+  EXPECT_TRUE(result);
+  delete solver;
+}
+
+TEST(SolverTest, UpdateRuns) {
+  ArrayCache arrays;
+  const Array *src = arrays.CreateArray("src", 64);
+  const Array *dst = arrays.CreateArray("dst", 64);
+  const Array *idx = arrays.CreateArray("idx", 1);
+  ref<Expr> k = ZExtExpr::create(
+      ReadExpr::create(UpdateList(idx, 0), getConstant(0, 32)), Expr::Int32);
+  // memcpy(dst, src + 8, 32), then memset(dst + 40, 'A', 20)
+  UpdateList updates(dst, 0);
+  for (unsigned i = 0; i != 32; ++i)
+    updates.extend(getConstant(i, 32),
+                   ReadExpr::create(UpdateList(src, 0), getConstant(i + 8, 32)));
+  for (unsigned i = 40; i != 60; ++i)
+    updates.extend(getConstant(i, 32), getConstant('A', 8));
+  ref<Expr> read = ReadExpr::create(updates, k);
+  // read symbolically, so that src is not scalarized
+  ref<Expr> shifted = AddExpr::create(k, getConstant(8, 32));
+
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+  bool result;
+  struct {
+    unsigned index;
+    ref<Expr> expected;
+    bool mustBe;
+  } cases[] = {
+      {10, ReadExpr::create(UpdateList(src, 0), shifted), true},
+      {31, ReadExpr::create(UpdateList(src, 0), shifted), true},
+      {5, ReadExpr::create(UpdateList(src, 0), k), false},
+      {45, getConstant('A', 8), true},
+      {35, ReadExpr::create(UpdateList(dst, 0), getConstant(35, 32)), true},
+      {60, getConstant('A', 8), false},
+  };
+  for (const auto &c : cases) {
+    std::vector<ref<Expr> > constraints;
+    constraints.push_back(EqExpr::create(getConstant(c.index, 32), k));
+    ConstraintManager cm(constraints);
+    ASSERT_TRUE(solver->mustBeTrue(
+        Query(cm, EqExpr::create(c.expected, read)), result));
+    EXPECT_EQ(c.mustBe, result) << "at index " << c.index;
+  }
+
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(EqExpr::create(getConstant(3, 32), k));
+  constraints.push_back(EqExpr::create(getConstant(7, 8), read));
+  constraints.push_back(EqExpr::create(
+      getConstant(9, 8), ReadExpr::create(UpdateList(src, 0), k)));
+  ConstraintManager cm(constraints);
+  std::vector<const Array *> objects(1, src);
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)), objects, values));
+  EXPECT_EQ(7u, values[0][11]);
+  EXPECT_EQ(9u, values[0][3]);
+  delete solver;
+}
+
+TEST(SolverTest, LargeArrayModel) {
+  // a model the size of a file, with few bytes constrained
+  ArrayCache arrays;
+  const Array *buf = arrays.CreateArray("buf", 1 << 16);
+  const Array *idx = arrays.CreateArray("idx", 2);
+  ref<Expr> i = ZExtExpr::create(
+      ReadExpr::create(UpdateList(idx, 0), getConstant(0, 32)), Expr::Int32);
+
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(EqExpr::create(getConstant(100, 32), i));
+  constraints.push_back(EqExpr::create(
+      getConstant(3, 8), ReadExpr::create(UpdateList(buf, 0), i)));
+  constraints.push_back(EqExpr::create(
+      getConstant(200, 8),
+      ReadExpr::create(UpdateList(buf, 0), getConstant(60000, 32))));
+  ConstraintManager cm(constraints);
+  std::vector<const Array *> objects;
+  objects.push_back(buf);
+  objects.push_back(idx);
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)), objects, values));
+  ASSERT_EQ(1u << 16, values[0].size());
+  EXPECT_EQ(3u, values[0][100]);
+  EXPECT_EQ(200u, values[0][60000]);
+  EXPECT_EQ(100u, values[1][0]);
+  delete solver;
+}
+
+TEST(SolverTest, Portfolio) {
+  // The dummy backend fails every query, so the answers must come from the
+  // core solver.
+  std::vector<std::pair<std::string, Solver *> > backends;
+  backends.push_back(std::make_pair("dummy", createDummySolver()));
+  backends.push_back(
+      std::make_pair("core", klee::createCoreSolver(CoreSolverToUse)));
+  Solver *solver = createPortfolioSolver(backends);
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 2);
+  ref<Expr> x = Expr::createTempRead(a, 8);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(UltExpr::create(x, getConstant(3, 8)));
+  constraints.push_back(UltExpr::create(getConstant(1, 8), x));
+  ConstraintManager cm(constraints);
+
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(x, getConstant(2, 8))), result));
+  EXPECT_TRUE(result);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(x, getConstant(1, 8))), result));
+  EXPECT_FALSE(result);
+
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(cm, x), value));
+  EXPECT_EQ(2u, value->getZExtValue());
+
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)),
+      std::vector<const Array *>(1, a), values));
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(2u, values[0][0]);
+  delete solver;
+}
+
+TEST(SolverTest, AsyncCrossCheck) {
+  // The primary solver answers every query the same way, so the checker
+  // process must report each of its wrong answers.
+  unsigned calls = 0;
+  // The checker is forked with the solver, and reports to this stderr.
+  testing::internal::CaptureStderr();
+  Solver *solver =
+      createAsyncValidatingSolver(new Solver(new CountingSolver(calls)),
+                                  klee::createCoreSolver(CoreSolverToUse),
+                                  /*sampleRatio=*/1.0, /*maxBacklog=*/16);
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 1);
+  ref<Expr> x = Expr::createTempRead(a, 8);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(UltExpr::create(x, getConstant(3, 8)));
+  constraints.push_back(UltExpr::create(getConstant(1, 8), x));
+  ConstraintManager cm(constraints);
+
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(x, getConstant(2, 8))), result));
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(x, getConstant(1, 8))), result));
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(cm, x), value));
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)),
+      std::vector<const Array *>(1, a), values));
+  // The answers do not wait for the checker.
+  EXPECT_EQ(4u, calls);
+
+  // Deleting the solver waits for the checker to finish.
+  delete solver;
+  std::string output = testing::internal::GetCapturedStderr();
+  EXPECT_EQ(std::string::npos, output.find("(computeValidity)"));
+  EXPECT_NE(std::string::npos, output.find("(computeTruth)"));
+  EXPECT_NE(std::string::npos, output.find("(computeValue)"));
+  EXPECT_NE(std::string::npos, output.find("(computeInitialValues)"));
+  EXPECT_NE(std::string::npos, output.find("array a[1]"));
+  EXPECT_NE(std::string::npos,
+            output.find("cross-checked 4 queries (3 mismatches"));
+}
+
+TEST(SolverTest, BinaryQueryLog) {
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("queries", "kqlog", path));
+  std::string logPath(path.c_str());
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 4);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(
+      UltExpr::create(Expr::createTempRead(a, 8), getConstant(3, 8)));
+  ConstraintManager cm(constraints);
+  ref<Expr> query =
+      EqExpr::create(Expr::createTempRead(a, 8), getConstant(1, 8));
+  std::vector<const Array *> objects(1, a);
+
+  unsigned calls = 0;
+  {
+    Solver *solver = createBinaryQueryLoggingSolver(
+        new Solver(new CountingSolver(calls)), logPath, time::Span(), false);
+    bool result;
+    ASSERT_TRUE(solver->mustBeTrue(Query(cm, query), result));
+    ref<ConstantExpr> value;
+    ASSERT_TRUE(
+        solver->getValue(Query(cm, Expr::createTempRead(a, 32)), value));
+    std::vector<std::vector<unsigned char> > values;
+    ASSERT_TRUE(solver->getInitialValues(Query(cm, query), objects, values));
+    // more queries than fit in one batch of the writer
+    for (unsigned i = 0; i != 5000; ++i)
+      ASSERT_TRUE(solver->mustBeTrue(
+          Query(cm, EqExpr::create(Expr::createTempRead(a, 32),
+                                   getConstant(i, 32))),
+          result));
+    delete solver;
+  }
+
+  auto buffer = llvm::MemoryBuffer::getFile(logPath);
+  ASSERT_TRUE(bool(buffer));
+  ArrayCache readArrays;
+  QueryLogReader reader((*buffer)->getBuffer(), readArrays);
+  LoggedQuery q;
+
+  ASSERT_TRUE(reader.next(q));
+  EXPECT_EQ(LoggedQuery::Truth, q.kind);
+  EXPECT_EQ(0u, q.number);
+  EXPECT_TRUE(q.success && q.isValid);
+  ASSERT_EQ(1u, q.constraints.size());
+  EXPECT_EQ(Expr::Eq, q.expr->getKind());
+
+  ASSERT_TRUE(reader.next(q));
+  EXPECT_EQ(LoggedQuery::Value, q.kind);
+  ASSERT_FALSE(q.value.isNull());
+  EXPECT_EQ(42u, cast<ConstantExpr>(q.value)->getZExtValue());
+  EXPECT_EQ(32u, q.value->getWidth());
+
+  ASSERT_TRUE(reader.next(q));
+  EXPECT_EQ(LoggedQuery::InitialValues, q.kind);
+  EXPECT_TRUE(q.hasSolution);
+  ASSERT_EQ(1u, q.objects.size());
+  EXPECT_EQ("a", q.objects[0]->name);
+  ASSERT_EQ(1u, q.values.size());
+  EXPECT_EQ(std::vector<unsigned char>(4, 7), q.values[0]);
+
+  unsigned rest = 0;
+  while (reader.next(q))
+    ++rest;
+  EXPECT_EQ(5000u, rest);
+  EXPECT_EQ(5002u, q.number);
+  EXPECT_TRUE(reader.getError().empty());
+
+  // Through a builder, and cut short as by a crash of the writer.
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  llvm::StringRef contents = (*buffer)->getBuffer();
+  QueryLogReader truncated(contents.substr(0, contents.size() / 2),
+                           readArrays, builder.get());
+  unsigned count = 0;
+  while (truncated.next(q))
+    ++count;
+  EXPECT_TRUE(truncated.getError().empty());
+  EXPECT_LT(0u, count);
+  EXPECT_GT(5003u, count);
+
+  llvm::sys::fs::remove(logPath);
+}
+
+TEST(SolverTest, Range) {
+  Solver *solver = createValidatingSolver(
+      klee::createCoreSolver(CoreSolverToUse),
+      klee::createCoreSolver(CoreSolverToUse));
+  solver = createCexCachingSolver(solver);
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 8);
+  const Array *b = arrays.CreateArray("b", 1);
+  ref<Expr> x = Expr::createTempRead(a, 32);
+  ref<Expr> y = Expr::createTempRead(b, 8);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(UleExpr::create(getConstant(100, 32), x));
+  constraints.push_back(UltExpr::create(x, getConstant(5000, 32)));
+  constraints.push_back(NeExpr::create(x, getConstant(4999, 32)));
+  constraints.push_back(UltExpr::create(y, getConstant(3, 8)));
+  ConstraintManager cm(constraints);
+
+  std::pair<ref<Expr>, ref<Expr> > range =
+      solver->getRange(Query(cm, AddExpr::create(x, getConstant(1, 32))));
+  EXPECT_EQ(101u, cast<ConstantExpr>(range.first)->getZExtValue());
+  EXPECT_EQ(4999u, cast<ConstantExpr>(range.second)->getZExtValue());
+
+  // unsigned bounds, with an unconstrained sign bit
+  range = solver->getRange(Query(cm, SExtExpr::create(y, Expr::Int64)));
+  EXPECT_EQ(0u, cast<ConstantExpr>(range.first)->getZExtValue());
+  EXPECT_EQ(2u, cast<ConstantExpr>(range.second)->getZExtValue());
+  range = solver->getRange(Query(cm, Expr::createTempRead(a, 64)));
+  EXPECT_EQ(100u, cast<ConstantExpr>(range.first)->getZExtValue());
+  EXPECT_EQ(UINT64_MAX - UINT32_MAX + 4998,
+            cast<ConstantExpr>(range.second)->getZExtValue());
+
+  ref<Expr> bit = ExtractExpr::create(x, 0, Expr::Bool);
+  range = solver->getRange(Query(cm, bit));
+  EXPECT_EQ(0u, cast<ConstantExpr>(range.first)->getZExtValue());
+  EXPECT_EQ(1u, cast<ConstantExpr>(range.second)->getZExtValue());
+  delete solver;
+}
+
+TEST(SolverTest, UniqueValue) {
+  Solver *solver = createValidatingSolver(
+      klee::createCoreSolver(CoreSolverToUse),
+      klee::createCoreSolver(CoreSolverToUse));
+  solver = createCexCachingSolver(solver);
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 2);
+  ref<Expr> x = ReadExpr::create(UpdateList(a, 0), getConstant(0, 32));
+  ref<Expr> y = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(EqExpr::create(getConstant(3, 8), x));
+  constraints.push_back(UltExpr::create(y, getConstant(2, 8)));
+  ConstraintManager cm(constraints);
+
+  ref<ConstantExpr> value;
+  bool isUnique;
+  ASSERT_TRUE(solver->getUniqueValue(
+      Query(cm, AddExpr::create(x, getConstant(1, 8))), value, isUnique));
+  EXPECT_EQ(4u, value->getZExtValue());
+  EXPECT_TRUE(isUnique);
+  ASSERT_TRUE(solver->getUniqueValue(Query(cm, AddExpr::create(x, y)), value,
+                                     isUnique));
+  EXPECT_TRUE(value->getZExtValue() == 3 || value->getZExtValue() == 4);
+  EXPECT_FALSE(isUnique);
+  delete solver;
+
+  // the cex cache keeps both answers
+  unsigned calls = 0;
+  solver = createCexCachingSolver(new Solver(new CountingSolver(calls)));
+  for (unsigned repeat = 0; repeat != 2; ++repeat) {
+    ASSERT_TRUE(solver->getUniqueValue(Query(cm, y), value, isUnique));
+    EXPECT_EQ(7u, value->getZExtValue());
+    EXPECT_FALSE(isUnique);
+  }
+  EXPECT_EQ(2u, calls);
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(cm, EqExpr::create(getConstant(7, 8), y)), result));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(2u, calls);
+  delete solver;
+}
+
+TEST(SolverTest, Z3QueryClasses) {
+  // The profiles stay set for the tests that follow, which is harmless as
+  // they must not change any query result.
+  const char *argv[] = {"SolverTest",
+                        "-z3-tactic-bv=simplify,solve-eqs,bit-blast,sat",
+                        "-z3-tactic-arrays=QF_ABV"};
+  llvm::cl::ParseCommandLineOptions(3, argv);
+  if (CoreSolverToUse != Z3_SOLVER)
+    return;
+
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 4);
+  ref<Expr> x = ReadExpr::create(UpdateList(a, 0), getConstant(0, 32));
+  ref<Expr> y = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  ref<Expr> i = ZExtExpr::create(y, Expr::Int32);
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(UltExpr::create(getConstant(2, 8), x));
+  constraints.push_back(EqExpr::create(getConstant(3, 8), y));
+  ConstraintManager cm(constraints);
+
+  struct {
+    ref<Expr> query;
+    bool mustBe;
+    Statistic &counter;
+  } cases[] = {
+      {UltExpr::create(getConstant(1, 8), x), true, stats::queriesZ3BitVector},
+      {EqExpr::create(getConstant(3, 8), MulExpr::create(getConstant(1, 8), y)),
+       true, stats::queriesZ3BitVector},
+      {EqExpr::create(getConstant(9, 8), MulExpr::create(y, y)), true,
+       stats::queriesZ3NonLinear},
+      {EqExpr::create(getConstant(3, 8),
+                      ReadExpr::create(UpdateList(a, 0), i)),
+       false, stats::queriesZ3Arrays},
+  };
+  for (const auto &c : cases) {
+    uint64_t before = c.counter;
+    bool result;
+    ASSERT_TRUE(solver->mustBeTrue(Query(cm, c.query), result));
+    EXPECT_EQ(c.mustBe, result) << c.query;
+    EXPECT_EQ(before + 1, c.counter.getValue()) << c.query;
+  }
+
+  // the model of a query solved by the tactics
+  std::vector<const Array *> objects(1, a);
+  std::vector<std::vector<unsigned char> > values;
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(cm, ConstantExpr::alloc(0, Expr::Bool)), objects, values));
+  EXPECT_LT(2u, values[0][0]);
+  EXPECT_EQ(3u, values[0][1]);
+  delete solver;
+}
+
+TEST(SolverTest, UnsatCores) {
+  // Tracking stays enabled for the tests that follow, which is harmless as
+  // it must not change any query result.
+  const char *argv[] = {"SolverTest", "-z3-unsat-cores"};
+  llvm::cl::ParseCommandLineOptions(2, argv);
+  if (CoreSolverToUse != Z3_SOLVER)
+    return;
+
+  Solver *solver = createCexCachingSolver(
+      klee::createCoreSolver(CoreSolverToUse));
+  ArrayCache arrays;
+  const Array *a = arrays.CreateArray("a", 3);
+  ref<Expr> x = ReadExpr::create(UpdateList(a, 0), getConstant(0, 32));
+  ref<Expr> y = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  ref<Expr> z = ReadExpr::create(UpdateList(a, 0), getConstant(2, 32));
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(UltExpr::create(getConstant(2, 8), x));
+  constraints.push_back(UltExpr::create(y, getConstant(2, 8)));
+  ConstraintManager cm(constraints);
+  ref<Expr> query = UltExpr::create(getConstant(1, 8), x);
+
+  uint64_t cores = stats::queryCexCores, queries = stats::queries;
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(Query(cm, query), result));
+  EXPECT_TRUE(result);
+  EXPECT_EQ(cores + 1, stats::queryCexCores);
+  EXPECT_EQ(queries + 1, stats::queries);
+
+  // another state with more constraints hits the same conflict
+  constraints.push_back(EqExpr::create(getConstant(5, 8), z));
+  ConstraintManager more(constraints);
+  ASSERT_TRUE(solver->mustBeTrue(Query(more, query), result));
+  EXPECT_TRUE(result);
+  EXPECT_EQ(queries + 1, stats::queries);
+
+  // while a satisfiable query is still solved
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(more, UltExpr::create(getConstant(3, 8), x)), result));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(queries + 2, stats::queries);
+  delete solver;
+}
 }
@@ -0,0 +1,83 @@
+//===-- StatisticsTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Statistic.h"
+#include "klee/Statistics.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+Statistic counter("TestCounter", "TCnt");
+Statistic other("TestOther", "TOth");
+
+TEST(StatisticsTest, Increment) {
+  uint64_t start = counter;
+  ++counter;
+  counter += 41;
+  EXPECT_EQ(start + 42, counter.getValue());
+  EXPECT_EQ(&counter,
+            theStatisticManager->getStatisticByName("TestCounter"));
+}
+
+TEST(StatisticsTest, Threads) {
+  const unsigned threads = 4, increments = 100000;
+  uint64_t start = counter, otherStart = other;
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t != threads; ++t)
+    workers.emplace_back([&]() {
+      for (unsigned i = 0; i != increments; ++i)
+        ++counter;
+      other += 2;
+    });
+  for (std::thread &w : workers)
+    w.join();
+
+  // The shards of the threads which ended are still summed.
+  EXPECT_EQ(start + threads * increments, counter.getValue());
+  EXPECT_EQ(otherStart + 2 * threads, other.getValue());
+  ++counter;
+  EXPECT_EQ(start + threads * increments + 1, counter.getValue());
+}
+
+TEST(StatisticsTest, Indexed) {
+  StatisticManager &sm = *theStatisticManager;
+  sm.useIndexedStats(100000);
+  EXPECT_EQ(0u, sm.getIndexedValue(counter, 99999));
+  sm.setIndexedValue(counter, 12345, 0);
+
+  sm.setIndex(70000);
+  counter += 3;
+  sm.setIndex(3);
+  ++counter;
+  sm.incrementIndexedValue(other, 99999, 5);
+  sm.setIndexedValue(other, 99998, 7);
+  EXPECT_EQ(3u, sm.getIndexedValue(counter, 70000));
+  EXPECT_EQ(1u, sm.getIndexedValue(counter, 3));
+  EXPECT_EQ(0u, sm.getIndexedValue(counter, 70001));
+  EXPECT_EQ(0u, sm.getIndexedValue(other, 70000));
+  EXPECT_EQ(5u, sm.getIndexedValue(other, 99999));
+  EXPECT_EQ(7u, sm.getIndexedValue(other, 99998));
+
+  sm.setIndex(0);
+  sm.useIndexedStats(0);
+}
+
+TEST(StatisticsTest, ShardPerThread) {
+  StatisticShard *shards[2];
+  std::thread t([&]() { shards[0] = &theStatisticManager->getLocalShard(); });
+  t.join();
+  shards[1] = &theStatisticManager->getLocalShard();
+  ASSERT_NE(shards[0], shards[1]);
+  EXPECT_EQ(shards[1], &theStatisticManager->getLocalShard());
+}
+}
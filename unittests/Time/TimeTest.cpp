@@ -21,6 +21,17 @@ TEST(TimeTest, TimingFunctions) {
   ASSERT_GT(p1, time::Point());
   ASSERT_LE(p0, p1);
 
+  // the coarse clock may lag behind, but is monotonic on its own
+  auto c0 = time::getCoarseTime();
+  auto c1 = time::getCoarseTime();
+  ASSERT_GT(c0, time::Point());
+  ASSERT_LE(c0, c1);
+  ASSERT_LE(c0 - p0, time::seconds(1));
+  ASSERT_LE(p0 - c0, time::seconds(1));
+  auto s0 = time::getStatTime();
+  auto s1 = time::getStatTime();
+  ASSERT_LE(s0, s1);
+
   time::getUserTime();
 }
 
@@ -46,3 +46,43 @@ TEST(TreeStreamTest, WriteLargerThanBufferSize) {
   for (unsigned i=0; i<out.size(); i++)
     ASSERT_EQ('A', out[i]);
 }
+
+/* A stream opened from another starts with what the other held then, but
+   not with what it got later. */
+TEST(TreeStreamTest, Fork) {
+  TreeStreamWriter tsw("tsw3.out");
+  ASSERT_TRUE(tsw.good());
+
+  TreeOStream parent = tsw.open();
+  parent.write("ab", 2);
+  TreeOStream child = tsw.open(parent);
+  parent.write("c", 1);
+  child.write("d", 1);
+
+  std::vector<unsigned char> out;
+  tsw.readStream(parent.getID(), out);
+  ASSERT_EQ(std::string("abc"), std::string(out.begin(), out.end()));
+  out.clear();
+  tsw.readStream(child.getID(), out);
+  ASSERT_EQ(std::string("abd"), std::string(out.begin(), out.end()));
+}
+
+/* Streams spanning many blocks are read back from the file. */
+TEST(TreeStreamTest, ManyBlocks) {
+  TreeStreamWriter tsw("tsw4.out");
+  ASSERT_TRUE(tsw.good());
+
+  // alternating, so that each write is a record of its own
+  TreeOStream a = tsw.open(), b = tsw.open();
+  for (unsigned i = 0; i < 100000; ++i) {
+    char c = '0' + i % 10;
+    a.write(&c, 1);
+    b.write(&c, 1);
+  }
+
+  std::vector<unsigned char> out;
+  tsw.readStream(a.getID(), out);
+  ASSERT_EQ(100000u, out.size());
+  for (unsigned i = 0; i < out.size(); i++)
+    ASSERT_EQ('0' + i % 10, out[i]);
+}